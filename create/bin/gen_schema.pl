@@ -21,8 +21,8 @@ use File::Basename;
 
 my $file = dirname($0)."/../src/schema.tmpl";	# name the file
 
-my ($state, %output, $eol, $fk_bol, $fk_eol, $ltab, $pkey, $table_name);
-my ($szcol1, $szcol2, $szcol3, $szcol4, $sequences, $sql_suffix);
+my ($state, %output, $eol, $fk_bol, $fk_eol, $ltab, $pkey, $pkey_name, $table_name);
+my ($szcol1, $szcol2, $szcol3, $szcol4, $sequences, $triggers, $sql_suffix);
 my ($fkeys, $fkeys_prefix, $fkeys_suffix, $uniq);
 
 my %c = (
@@ -210,6 +210,7 @@ sub process_table
 	newstate("table");
 
 	($table_name, $pkey, $flags) = split(/\|/, $line, 3);
+	$pkey_name = $pkey;
 
 	if ($output{"type"} eq "code")
 	{
@@ -401,7 +402,7 @@ sub process_field
 				$sequences = "${sequences}BEFORE INSERT ON ${table_name}${eol}\n";
 				$sequences = "${sequences}FOR EACH ROW${eol}\n";
 				$sequences = "${sequences}BEGIN${eol}\n";
-				$sequences = "${sequences}SELECT ${table_name}_seq.nextval INTO :new.id FROM dual;${eol}\n";
+				$sequences = "${sequences}SELECT ${table_name}_seq.nextval INTO :new.${name} FROM dual;${eol}\n";
 				$sequences = "${sequences}END;${eol}\n/${eol}\n";
 			}
 		}
@@ -472,6 +473,60 @@ sub process_field
 	}
 }
 
+sub process_changelog
+{
+	my $line = $_[0];
+	my $object = rtrim($line);
+	my ($op, $operation, $row);
+	my %operations = ("insert" => 1, "update" => 2, "delete" => 3);
+
+	return if ($output{"type"} ne "sql");
+
+	foreach $op ("insert", "update", "delete")
+	{
+		$operation = $operations{$op};
+		$row = ($op eq "delete" ? "old" : "new");
+
+		if ($output{"database"} eq "postgresql")
+		{
+			$triggers = "${triggers}CREATE FUNCTION changelog_${table_name}_${op}() RETURNS TRIGGER AS \$\$${eol}\n";
+			$triggers = "${triggers}BEGIN${eol}\n";
+			$triggers = "${triggers}INSERT INTO changelog (object,objectid,operation)${eol}\n";
+			$triggers = "${triggers}VALUES (${object},${row}.${pkey_name},${operation});${eol}\n";
+			$triggers = "${triggers}RETURN ${row};${eol}\n";
+			$triggers = "${triggers}END;${eol}\n";
+			$triggers = "${triggers}\$\$ LANGUAGE plpgsql;${eol}\n";
+			$triggers = "${triggers}CREATE TRIGGER ${table_name}_${op} AFTER \U${op}\E ON ${table_name}${eol}\n";
+			$triggers = "${triggers}FOR EACH ROW EXECUTE PROCEDURE changelog_${table_name}_${op}();${eol}\n";
+		}
+		elsif ($output{"database"} eq "mysql")
+		{
+			$triggers = "${triggers}CREATE TRIGGER `${table_name}_${op}` AFTER \U${op}\E ON `${table_name}`${eol}\n";
+			$triggers = "${triggers}FOR EACH ROW${eol}\n";
+			$triggers = "${triggers}INSERT INTO changelog (object,objectid,operation)${eol}\n";
+			$triggers = "${triggers}VALUES (${object},${row}.${pkey_name},${operation});${eol}\n";
+		}
+		elsif ($output{"database"} eq "oracle")
+		{
+			$triggers = "${triggers}CREATE TRIGGER ${table_name}_${op} AFTER \U${op}\E ON ${table_name}${eol}\n";
+			$triggers = "${triggers}FOR EACH ROW${eol}\n";
+			$triggers = "${triggers}BEGIN${eol}\n";
+			$triggers = "${triggers}INSERT INTO changelog (object,objectid,operation)${eol}\n";
+			$triggers = "${triggers}VALUES (${object},:${row}.${pkey_name},${operation});${eol}\n";
+			$triggers = "${triggers}END;${eol}\n/${eol}\n";
+		}
+		elsif ($output{"database"} eq "sqlite3")
+		{
+			$triggers = "${triggers}CREATE TRIGGER ${table_name}_${op} AFTER \U${op}\E ON ${table_name}${eol}\n";
+			$triggers = "${triggers}FOR EACH ROW${eol}\n";
+			$triggers = "${triggers}BEGIN${eol}\n";
+			$triggers = "${triggers}INSERT INTO changelog (object,objectid,operation)${eol}\n";
+			$triggers = "${triggers}VALUES (${object},${row}.${pkey_name},${operation});${eol}\n";
+			$triggers = "${triggers}END;${eol}\n";
+		}
+	}
+}
+
 sub process_index
 {
 	my $line = $_[0];
@@ -704,6 +759,7 @@ sub process
 	$state = "bof";
 	$fkeys = "";
 	$sequences = "";
+	$triggers = "";
 	$uniq = "";
 	my ($type, $line);
 
@@ -724,13 +780,14 @@ sub process
 			elsif ($type eq 'INDEX')	{ process_index($line, 0); }
 			elsif ($type eq 'TABLE')	{ process_table($line); }
 			elsif ($type eq 'UNIQUE')	{ process_index($line, 1); }
+			elsif ($type eq 'CHANGELOG')	{ process_changelog($line); }
 			elsif ($type eq 'ROW' && $output{"type"} ne "code")		{ process_row($line); }
 		}
 	}
 
 	newstate("table");
 
-	print $sequences.$sql_suffix;
+	print $sequences.$triggers.$sql_suffix;
 	print $fkeys_prefix.$fkeys.$fkeys_suffix;
 	print $output{"after"};
 }
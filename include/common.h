@@ -566,7 +566,10 @@ const char	*get_program_type_string(unsigned char program_type);
 #define ZBX_PROCESS_TYPE_REPORTWRITER		34
 #define ZBX_PROCESS_TYPE_SERVICEMAN		35
 #define ZBX_PROCESS_TYPE_PROBLEMHOUSEKEEPER	36
-#define ZBX_PROCESS_TYPE_COUNT		37	/* number of process types */
+#define ZBX_PROCESS_TYPE_AGENTPOLLER		37
+#define ZBX_PROCESS_TYPE_SNMPPOLLER		38
+#define ZBX_PROCESS_TYPE_HTTPAGENTPOLLER	39
+#define ZBX_PROCESS_TYPE_COUNT		40	/* number of process types */
 #define ZBX_PROCESS_TYPE_UNKNOWN	255
 const char	*get_process_type_string(unsigned char proc_type);
 int		get_process_type_by_name(const char *proc_type_str);
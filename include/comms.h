@@ -113,6 +113,10 @@ int	zbx_tcp_connect(zbx_socket_t *s, const char *source_ip, const char *ip, unsi
 
 #define ZBX_TCP_PROTOCOL		0x01
 #define ZBX_TCP_COMPRESS		0x02
+#define ZBX_TCP_COMPRESS_ZSTD		0x10		/* compressed data uses zstd instead of zlib */
+#define ZBX_TCP_COMPRESS_LZ4		0x20		/* compressed data uses LZ4 instead of zlib */
+#define ZBX_TCP_ACCEPT_ZSTD		0x40		/* sender is able to uncompress zstd data */
+#define ZBX_TCP_ACCEPT_LZ4		0x80		/* sender is able to uncompress LZ4 data */
 
 #define ZBX_TCP_SEC_UNENCRYPTED		1		/* do not use encryption with this socket */
 #define ZBX_TCP_SEC_TLS_PSK		2		/* use TLS with pre-shared key (PSK) with this socket */
@@ -129,6 +133,7 @@ const char	*zbx_tcp_connection_type_name(unsigned int type);
 #define zbx_tcp_send_raw(s, d)				zbx_tcp_send_ext((s), (d), strlen(d), 0, 0)
 
 int	zbx_tcp_send_ext(zbx_socket_t *s, const char *data, size_t len, unsigned char flags, int timeout);
+int	zbx_tcp_compress_flags(int peer_protocol);
 
 void	zbx_tcp_close(zbx_socket_t *s);
 
@@ -724,6 +724,8 @@ typedef struct
 	zbx_vector_ptr_t	rows;
 	/* index of autoincrement field */
 	int			autoincrement;
+	/* insert rows in binary format (PostgreSQL binary copy, MySQL prepared statements) */
+	int			binary;
 }
 zbx_db_insert_t;
 
@@ -735,6 +737,7 @@ void	zbx_db_insert_add_values(zbx_db_insert_t *self, ...);
 int	zbx_db_insert_execute(zbx_db_insert_t *self);
 void	zbx_db_insert_clean(zbx_db_insert_t *self);
 void	zbx_db_insert_autoincrement(zbx_db_insert_t *self, const char *field_name);
+void	zbx_db_insert_binary(zbx_db_insert_t *self);
 int	zbx_db_get_database_type(void);
 
 /* agent (ZABBIX, SNMP, IPMI, JMX) availability data */
@@ -831,6 +834,7 @@ typedef struct
 {
 	zbx_uint64_t		hostid;
 	unsigned char		compress;
+	int			codecs;
 	int			version;
 	int			lastaccess;
 	int			last_version_error_time;
@@ -847,10 +851,12 @@ typedef struct
 #define ZBX_FLAGS_PROXY_DIFF_UPDATE_SUPPRESS_WIN		__UINT64_C(0x0020)
 #define ZBX_FLAGS_PROXY_DIFF_UPDATE_HEARTBEAT			__UINT64_C(0x0040)
 #define ZBX_FLAGS_PROXY_DIFF_UPDATE_CONFIG			__UINT64_C(0x0080)
+#define ZBX_FLAGS_PROXY_DIFF_UPDATE_CODECS			__UINT64_C(0x0100)
 #define ZBX_FLAGS_PROXY_DIFF_UPDATE (			\
 		ZBX_FLAGS_PROXY_DIFF_UPDATE_COMPRESS |	\
 		ZBX_FLAGS_PROXY_DIFF_UPDATE_VERSION |	\
-		ZBX_FLAGS_PROXY_DIFF_UPDATE_LASTACCESS)
+		ZBX_FLAGS_PROXY_DIFF_UPDATE_LASTACCESS |	\
+		ZBX_FLAGS_PROXY_DIFF_UPDATE_CODECS)
 	zbx_uint64_t	flags;
 }
 zbx_proxy_diff_t;
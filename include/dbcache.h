@@ -38,7 +38,10 @@
 #define	ZBX_POLLER_TYPE_PINGER		3
 #define	ZBX_POLLER_TYPE_JAVA		4
 #define	ZBX_POLLER_TYPE_HISTORY		5
-#define	ZBX_POLLER_TYPE_COUNT		6	/* number of poller types */
+#define	ZBX_POLLER_TYPE_AGENT		6
+#define	ZBX_POLLER_TYPE_SNMP		7
+#define	ZBX_POLLER_TYPE_HTTPAGENT	8
+#define	ZBX_POLLER_TYPE_COUNT		9	/* number of poller types */
 
 #define MAX_JAVA_ITEMS		32
 #define MAX_SNMP_ITEMS		128
@@ -57,6 +60,7 @@ extern int	CONFIG_TIMEOUT;
 extern zbx_uint64_t	CONFIG_CONF_CACHE_SIZE;
 extern zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE;
 extern zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE;
+extern int		CONFIG_HISTORY_CACHE_SHARDS;
 extern zbx_uint64_t	CONFIG_TRENDS_CACHE_SIZE;
 
 extern int	CONFIG_POLLER_FORKS;
@@ -71,6 +75,9 @@ extern int	CONFIG_HISTSYNCER_FORKS;
 extern int	CONFIG_PROXYCONFIG_FREQUENCY;
 extern int	CONFIG_PROXYDATA_FREQUENCY;
 extern int	CONFIG_HISTORYPOLLER_FORKS;
+extern int	CONFIG_AGENTPOLLER_FORKS;
+extern int	CONFIG_SNMPPOLLER_FORKS;
+extern int	CONFIG_HTTPAGENTPOLLER_FORKS;
 
 typedef struct
 {
@@ -281,6 +288,7 @@ typedef struct
 						/* or 0 if no error */
 	int		version;
 	int		lastaccess;
+	int		accept_codecs;		/* compression codecs advertised by proxy as protocol accept flags */
 	char		addr_orig[INTERFACE_ADDR_LEN_MAX];
 	char		port_orig[INTERFACE_PORT_LEN_MAX];
 	char		*addr;
@@ -605,6 +613,8 @@ typedef struct
 	zbx_uint64_t	index_total;
 	zbx_uint64_t	trend_free;
 	zbx_uint64_t	trend_total;
+	zbx_uint64_t	trend_queue;	/* the number of closed hour trends waiting to be flushed */
+	zbx_uint64_t	trend_lag;	/* seconds from the hour end till all its trends were flushed */
 }
 zbx_wcache_info_t;
 
@@ -642,9 +652,15 @@ void	free_database_cache(void);
 #define ZBX_STATS_HISTORY_INDEX_FREE	19
 #define ZBX_STATS_HISTORY_INDEX_PUSED	20
 #define ZBX_STATS_HISTORY_INDEX_PFREE	21
+#define ZBX_STATS_TREND_QUEUE		22
+#define ZBX_STATS_TREND_LAG		23
 void	*DCget_stats(int request);
+void	*DCget_shard_stats(int request, int index);
 void	DCget_stats_all(zbx_wcache_info_t *wcache_info);
 
+#define ZBX_HC_SHARDS_MAX	ZBX_MUTEX_CACHE_SHARDS_MAX
+#define ZBX_HC_SHARD_ALL	-1
+
 zbx_uint64_t	DCget_nextid(const char *table_name, int num);
 
 /* initial sync, get all data */
@@ -704,7 +720,7 @@ int	DCconfig_get_suggested_snmp_vars(zbx_uint64_t interfaceid, int *bulk);
 int	DCconfig_get_interface_by_type(DC_INTERFACE *interface, zbx_uint64_t hostid, unsigned char type);
 int	DCconfig_get_interface(DC_INTERFACE *interface, zbx_uint64_t hostid, zbx_uint64_t itemid);
 int	DCconfig_get_poller_nextcheck(unsigned char poller_type);
-int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items);
+int	DCconfig_get_poller_items(unsigned char poller_type, int free_slots, DC_ITEM **items);
 int	DCconfig_get_ipmi_poller_items(int now, DC_ITEM *items, int items_num, int *nextcheck);
 int	DCconfig_get_snmp_interfaceids_by_addr(const char *addr, zbx_uint64_t **interfaceids);
 size_t	DCconfig_get_snmp_items_by_interfaceid(zbx_uint64_t interfaceid, DC_ITEM **items);
@@ -726,6 +742,7 @@ void	DCrequeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 void	DCpoller_requeue_items(const zbx_uint64_t *itemids, const int *lastclocks,
 		const int *errcodes, size_t num, unsigned char poller_type, int *nextcheck);
 void	zbx_dc_requeue_unreachable_items(zbx_uint64_t *itemids, size_t itemids_num);
+void	zbx_dc_requeue_unchecked_items(const zbx_uint64_t *itemids, size_t itemids_num);
 int	DCconfig_activate_host(DC_ITEM *item);
 int	DCconfig_deactivate_host(DC_ITEM *item, int now);
 
@@ -851,6 +868,7 @@ void	zbx_dc_get_hostids_by_group_name(const char *name, zbx_vector_uint64_t *hos
 #define ZBX_DC_FLAG_UNDEF	0x08	/* unsupported or undefined (delta calculation failed) value */
 #define ZBX_DC_FLAG_NOHISTORY	0x10	/* values should not be kept in history */
 #define ZBX_DC_FLAG_NOTRENDS	0x20	/* values should not be kept in trends */
+#define ZBX_DC_FLAG_NOITEM	0x40	/* value of missing or inactive item, or discarded value */
 
 typedef struct zbx_hc_data
 {
@@ -1008,7 +1026,9 @@ int	zbx_dc_expand_user_macros_len(const char *text, size_t text_len, zbx_uint64_
 
 /* diagnostic data */
 void	zbx_hc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num);
+void	zbx_hc_get_shard_diag_stats(int index, zbx_uint64_t *items_num, zbx_uint64_t *values_num);
 void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index);
+void	zbx_hc_get_shard_mem_stats(int index, zbx_mem_stats_t *data, zbx_mem_stats_t *index_mem);
 void	zbx_hc_get_items(zbx_vector_uint64_pair_t *items);
 
 typedef struct
@@ -25,6 +25,8 @@
 #include "dbcache.h"
 #include "zbxvariant.h"
 
+#define ZBX_PREPROCESSING_MANAGERS_MAX	16
+
 /* preprocessing step execution result */
 typedef struct
 {
@@ -47,6 +49,7 @@ zbx_preproc_item_stats_t;
 void	zbx_preprocess_item_value(zbx_uint64_t itemid, zbx_uint64_t hostid, unsigned char item_value_type, unsigned char item_flags,
 		AGENT_RESULT *result, zbx_timespec_t *ts, unsigned char state, char *error);
 void	zbx_preprocessor_flush(void);
+int	zbx_preprocessor_ring_init(char **error);
 zbx_uint64_t	zbx_preprocessor_get_queue_size(void);
 
 void	zbx_preproc_op_free(zbx_preproc_op_t *op);
@@ -33,6 +33,9 @@
 #define ZBX_PROXY_DATA_DONE	0
 #define ZBX_PROXY_DATA_MORE	1
 
+/* the maximum number of proxy data batches sent without waiting for acknowledgement */
+#define ZBX_PROXY_DATA_BATCHES_MAX	4
+
 #define ZBX_PROXY_UPLOAD_UNDEFINED	0
 #define ZBX_PROXY_UPLOAD_DISABLED	1
 #define ZBX_PROXY_UPLOAD_ENABLED	2
@@ -48,12 +51,14 @@ void	process_proxyconfig(struct zbx_json_parse *jp_data);
 
 int	get_interface_availability_data(struct zbx_json *json, int *ts);
 
-int	proxy_get_hist_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more);
+int	proxy_get_hist_data(struct zbx_json *j, char **history, size_t *history_len, zbx_uint64_t *lastid, int *more);
 int	proxy_get_dhis_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more);
 int	proxy_get_areg_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more);
 void	proxy_set_hist_lastid(const zbx_uint64_t lastid);
 void	proxy_set_dhis_lastid(const zbx_uint64_t lastid);
 void	proxy_set_areg_lastid(const zbx_uint64_t lastid);
+void	proxy_set_sent_lastids(zbx_uint64_t history_lastid, zbx_uint64_t discovery_lastid, zbx_uint64_t areg_lastid);
+void	proxy_reset_sent_lastids(void);
 
 void	calc_timestamp(const char *line, int *timestamp, const char *format);
 
@@ -66,13 +71,22 @@ int	proxy_get_history_count(void);
 int	proxy_get_delay(zbx_uint64_t lastid);
 
 int	zbx_get_proxy_protocol_version(struct zbx_json_parse *jp);
-void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int compress, zbx_uint64_t flags_add);
+void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int compress, int codecs,
+		zbx_uint64_t flags_add);
+int	zbx_proxy_compress_flags(const DC_PROXY *proxy, int peer_protocol);
+void	zbx_proxy_add_compression(struct zbx_json *j);
+int	zbx_proxy_get_compression(const struct zbx_json_parse *jp);
+void	zbx_proxy_add_history_format(const DC_PROXY *proxy, struct zbx_json *j);
+int	zbx_proxy_history_binary_accepted(const char *buffer);
+void	zbx_proxy_add_data_pipeline(const DC_PROXY *proxy, struct zbx_json *j);
+int	zbx_proxy_data_pipeline_accepted(const char *buffer);
+void	zbx_proxy_data_join(const struct zbx_json *j, char **data, size_t *size);
 
 int	process_proxy_history_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, zbx_timespec_t *ts, char **info);
 int	process_agent_history_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_timespec_t *ts, char **info);
 int	process_sender_history_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_timespec_t *ts, char **info);
-int	process_proxy_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, zbx_timespec_t *ts,
-		unsigned char proxy_status, int *more, char **error);
+int	process_proxy_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, const char *data, size_t size,
+		zbx_timespec_t *ts, unsigned char proxy_status, int *more, char **error);
 int	zbx_check_protocol_version(DC_PROXY *proxy, int version);
 
 #endif
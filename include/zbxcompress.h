@@ -20,8 +20,25 @@
 #ifndef ZABBIX_COMPRESS_H
 #define ZABBIX_COMPRESS_H
 
+/* compression codecs, zlib is always available when compression is supported */
+#define ZBX_COMPRESS_ZLIB	0
+#define ZBX_COMPRESS_ZSTD	1
+#define ZBX_COMPRESS_LZ4	2
+
+typedef struct zbx_uncompress_stream zbx_uncompress_stream_t;
+
+int	zbx_compress_init(const char *codec, const char *dictionary, char **error);
+unsigned char	zbx_compress_codec(void);
+int	zbx_compress_codec_supported(unsigned char codec);
+
 int	zbx_compress(const char *in, size_t size_in, char **out, size_t *size_out);
+int	zbx_compress_ext(unsigned char codec, const char *in, size_t size_in, char **out, size_t *size_out);
 int	zbx_uncompress(const char *in, size_t size_in, char *out, size_t *size_out);
 const char	*zbx_compress_strerror(void);
 
+zbx_uncompress_stream_t	*zbx_uncompress_stream_create(unsigned char codec, char *out, size_t out_size);
+int	zbx_uncompress_stream_write(zbx_uncompress_stream_t *stream, const char *in, size_t size_in);
+int	zbx_uncompress_stream_finish(zbx_uncompress_stream_t *stream, size_t *size_out);
+void	zbx_uncompress_stream_free(zbx_uncompress_stream_t *stream);
+
 #endif
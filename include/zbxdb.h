@@ -88,6 +88,7 @@ void	zbx_db_init_autoincrement_options(void);
 int	zbx_db_connect(char *host, char *user, char *password, char *dbname, char *dbschema, char *dbsocket, int port,
 			char *tls_connect, char *cert, char *key, char *ca, char *cipher, char *cipher_13);
 void	zbx_db_close(void);
+void	zbx_db_thread_end(void);
 
 int	zbx_db_begin(void);
 int	zbx_db_commit(void);
@@ -126,6 +127,13 @@ int		zbx_db_bind_parameter_dyn(zbx_db_bind_context_t *context, int position, uns
 void		zbx_db_clean_bind_context(zbx_db_bind_context_t *context);
 int		zbx_db_statement_execute(int iters);
 #endif
+#ifdef HAVE_POSTGRESQL
+int		zbx_db_copy_binary(const char *sql, const char *data, size_t size);
+#endif
+#ifdef HAVE_MYSQL
+int		zbx_db_execute_prepared(const char *sql, const unsigned char *types, int fields_num,
+				zbx_db_value_t **rows, int rows_num);
+#endif
 int		zbx_db_vexecute(const char *fmt, va_list args);
 DB_RESULT	zbx_db_vselect(const char *fmt, va_list args);
 DB_RESULT	zbx_db_select_n(const char *query, int n);
@@ -33,6 +33,20 @@ zbx_history_record_t;
 
 ZBX_VECTOR_DECL(history_record, zbx_history_record_t)
 
+/* the item history request, used to read history of several items at once */
+typedef struct
+{
+	zbx_uint64_t			itemid;
+	int				value_type;
+
+	/* the period ]start,end] to read values from */
+	int				start;
+	int				end;
+
+	zbx_vector_history_record_t	values;
+}
+zbx_history_request_t;
+
 void	zbx_history_record_vector_clean(zbx_vector_history_record_t *vector, int value_type);
 void	zbx_history_record_vector_destroy(zbx_vector_history_record_t *vector, int value_type);
 void	zbx_history_record_clear(zbx_history_record_t *value, int value_type);
@@ -57,6 +71,12 @@ void	zbx_history_destroy(void);
 int	zbx_history_add_values(const zbx_vector_ptr_t *history);
 int	zbx_history_get_values(zbx_uint64_t itemid, int value_type, int start, int count, int end,
 		zbx_vector_history_record_t *values);
+int	zbx_history_get_values_multi(zbx_vector_ptr_t *requests);
+
+int		zbx_history_pipeline_begin(void);
+zbx_uint64_t	zbx_history_pipeline_seq(void);
+int		zbx_history_pipeline_wait(zbx_uint64_t seq);
+void		zbx_history_pipeline_end(void);
 
 int	zbx_history_requires_trends(int value_type);
 void	zbx_history_check_version(struct zbx_json *json);
@@ -177,6 +177,10 @@
 #define ZBX_PROTO_TAG_DETAIL			"detail"
 #define ZBX_PROTO_TAG_RECIPIENT			"recipient"
 #define ZBX_PROTO_TAG_RECIPIENTS		"recipients"
+#define ZBX_PROTO_TAG_HISTORY_FORMAT		"history format"
+#define ZBX_PROTO_TAG_PIPELINE			"pipeline"
+#define ZBX_PROTO_TAG_BATCH			"batch"
+#define ZBX_PROTO_TAG_COMPRESSION		"compression"
 
 #define ZBX_PROTO_VALUE_FAILED		"failed"
 #define ZBX_PROTO_VALUE_SUCCESS		"success"
@@ -212,6 +216,11 @@
 #define ZBX_PROTO_VALUE_PROXY_UPLOAD_ENABLED	"enabled"
 #define ZBX_PROTO_VALUE_PROXY_UPLOAD_DISABLED	"disabled"
 
+#define ZBX_PROTO_VALUE_HISTORY_FORMAT_BINARY	"binary"
+
+#define ZBX_PROTO_VALUE_COMPRESSION_ZSTD	"zstd"
+#define ZBX_PROTO_VALUE_COMPRESSION_LZ4		"lz4"
+
 #define ZBX_PROTO_VALUE_REPORT_TEST		"report.test"
 
 typedef enum
@@ -306,8 +315,16 @@ typedef struct
 }
 zbx_jsonpath_t;
 
+/* structural index of json document, filled by queries performed with it */
+typedef struct zbx_jsonpath_index zbx_jsonpath_index_t;
+
 void	zbx_jsonpath_clear(zbx_jsonpath_t *jsonpath);
 int	zbx_jsonpath_compile(const char *path, zbx_jsonpath_t *jsonpath);
 int	zbx_jsonpath_query(const struct zbx_json_parse *jp, const char *path, char **output);
+int	zbx_jsonpath_query_compiled(const struct zbx_json_parse *jp, const zbx_jsonpath_t *jsonpath,
+		zbx_jsonpath_index_t *index, char **output);
+
+zbx_jsonpath_index_t	*zbx_jsonpath_index_create(void);
+void	zbx_jsonpath_index_free(zbx_jsonpath_index_t *index);
 
 #endif /* ZABBIX_ZJSON_H */
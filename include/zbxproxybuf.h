@@ -0,0 +1,102 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef ZABBIX_ZBXPROXYBUF_H
+#define ZABBIX_ZBXPROXYBUF_H
+
+#include "common.h"
+
+/* proxy history record, string pointers are valid until the next buffer read */
+typedef struct
+{
+	zbx_uint64_t	id;
+	zbx_uint64_t	itemid;
+	zbx_uint64_t	lastlogsize;
+	const char	*source;
+	const char	*value;
+	int		clock;
+	int		ns;
+	int		timestamp;
+	int		severity;
+	int		logeventid;
+	int		mtime;
+	int		write_clock;
+	unsigned char	state;
+	unsigned char	flags;
+}
+zbx_pb_history_t;
+
+int	zbx_pb_init(const char *dir, zbx_uint64_t segment_size, int local_buffer, char **error);
+void	zbx_pb_destroy(void);
+
+int	zbx_pb_history_enabled(void);
+int	zbx_pb_history_write(zbx_pb_history_t *records, int records_num, char **error);
+int	zbx_pb_history_read(zbx_uint64_t lastid, zbx_pb_history_t *records, int records_max);
+zbx_uint64_t	zbx_pb_history_get_lastid(void);
+void	zbx_pb_history_set_lastid(zbx_uint64_t lastid);
+int	zbx_pb_history_get_delay(zbx_uint64_t lastid);
+int	zbx_pb_history_get_count(void);
+int	zbx_pb_history_housekeep(int local_clock, int offline_clock);
+
+/* proxy memory buffer tables */
+#define ZBX_PMB_HISTORY		0
+#define ZBX_PMB_DISCOVERY	1
+#define ZBX_PMB_AUTOREG		2
+#define ZBX_PMB_TABLE_COUNT	3
+
+/* data source for the next proxy data batch, see zbx_pmb_read_begin() */
+#define ZBX_PMB_READ_NONE	0
+#define ZBX_PMB_READ_MEMORY	1
+#define ZBX_PMB_READ_DATABASE	2
+
+#define ZBX_PMB_FIELDS_MAX	8
+
+/* discovery and autoregistration record, fields are in proxy_dhistory (clock,druleid,dcheckid,ip,dns,port,  */
+/* value,status) and proxy_autoreg_host (clock,host,listen_ip,listen_dns,listen_port,host_metadata,flags,    */
+/* tls_accepted) column order, NULL fields correspond to NULL column values                                */
+typedef struct
+{
+	zbx_uint64_t	id;
+	const char	*fields[ZBX_PMB_FIELDS_MAX];
+	int		write_clock;
+}
+zbx_pmb_row_t;
+
+int	zbx_pmb_init(zbx_uint64_t size, int max_age, char **error);
+void	zbx_pmb_destroy(void);
+void	zbx_pmb_flush(void);
+
+int	zbx_pmb_enabled(void);
+int	zbx_pmb_history_write(const zbx_pb_history_t *records, int records_num);
+int	zbx_pmb_discovery_write(int clock, zbx_uint64_t druleid, zbx_uint64_t dcheckid, const char *ip,
+		const char *dns, int port, const char *value, int status);
+int	zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted);
+void	zbx_pmb_db_release(void);
+
+int	zbx_pmb_read_begin(unsigned char table, zbx_uint64_t *lastid);
+const char	*zbx_pmb_get_session_token(void);
+int	zbx_pmb_history_read(zbx_uint64_t lastid, zbx_pb_history_t *records, int records_max);
+int	zbx_pmb_rows_read(unsigned char table, zbx_uint64_t lastid, zbx_pmb_row_t *rows, int rows_max);
+void	zbx_pmb_database_drained(unsigned char table);
+int	zbx_pmb_set_lastid(unsigned char table, zbx_uint64_t lastid);
+int	zbx_pmb_history_get_delay(zbx_uint64_t lastid, int *delay);
+int	zbx_pmb_history_get_count(int *count);
+
+#endif
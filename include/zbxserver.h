@@ -67,6 +67,10 @@ int	evaluate_function2(zbx_variant_t *value, DC_ITEM *item, const char *function
 		const zbx_timespec_t *ts, char **error);
 
 int	zbx_is_trigger_function(const char *name, size_t len);
+int	zbx_get_function_history_period(const char *function, const char *parameter, const zbx_timespec_t *ts,
+		int *seconds, zbx_timespec_t *ts_end);
+int	zbx_get_function_trends_period(const char *function, const char *parameter, const zbx_timespec_t *ts,
+		int *start, int *end);
 
 int	substitute_simple_macros(const zbx_uint64_t *actionid, const DB_EVENT *event, const DB_EVENT *r_event,
 		const zbx_uint64_t *userid, const zbx_uint64_t *hostid, const DC_HOST *dc_host, const DC_ITEM *dc_item,
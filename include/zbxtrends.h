@@ -37,6 +37,21 @@ int	zbx_trends_eval_max(const char *table, zbx_uint64_t itemid, int start, int e
 int	zbx_trends_eval_min(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error);
 int	zbx_trends_eval_sum(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error);
 
+/* trend function evaluation request, used to evaluate functions of multiple items at once */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	const char	*table;
+	const char	*function;	/* function name without the 'trend' prefix */
+	int		start;
+	int		end;
+}
+zbx_trend_prefetch_t;
+
+ZBX_VECTOR_DECL(trend_prefetch, zbx_trend_prefetch_t)
+
+void	zbx_trends_prefetch_values(zbx_vector_trend_prefetch_t *requests);
+
 /* trends function cache */
 typedef struct
 {
@@ -25,15 +25,13 @@
 #if defined(_WINDOWS)
 #	define ZBX_THREAD_LOCAL __declspec(thread)
 #else
-/* for non windows build thread local storage is required only for agent2 */
-#	if defined(ZBX_BUILD_AGENT2)
-#		if defined(HAVE_THREAD_LOCAL) && (defined(__GNUC__) || defined(__clang__) || defined(__MINGW32__))
-#			define ZBX_THREAD_LOCAL __thread
-#		else
-#			error "C compiler is not compatible with agent2 assembly"
-#		endif
-#	endif
-#	if !defined(ZBX_THREAD_LOCAL)
+/* for non windows build thread local storage is required for agent2 and threaded configuration cache sync */
+#	if defined(HAVE_THREAD_LOCAL) && (defined(__GNUC__) || defined(__clang__) || defined(__MINGW32__))
+#		define ZBX_THREAD_LOCAL __thread
+#		define ZBX_HAVE_THREAD_LOCAL
+#	elif defined(ZBX_BUILD_AGENT2)
+#		error "C compiler is not compatible with agent2 assembly"
+#	else
 #		define ZBX_THREAD_LOCAL
 #	endif
 #endif
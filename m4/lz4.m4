@@ -0,0 +1,113 @@
+# LZ4_CHECK_CONFIG ([DEFAULT-ACTION])
+# ----------------------------------------------------------
+#
+# Checks for LZ4.  DEFAULT-ACTION is the string yes or no to
+# specify whether to default to --with-lz4 or --without-lz4.
+# If not supplied, DEFAULT-ACTION is no.
+#
+# The LZ4 frame API (lz4frame.h) is required.
+#
+# This macro #defines HAVE_LZ4 if required header files are
+# found, and sets @LZ4_LDFLAGS@, @LZ4_CFLAGS@ and @LZ4_LIBS@
+# to the necessary values.
+#
+# This macro is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+AC_DEFUN([LZ4_TRY_LINK],
+[
+AC_TRY_LINK(
+[
+#include <lz4frame.h>
+],
+[
+	LZ4F_cctx	*cctx;
+
+	LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+	LZ4F_freeCompressionContext(cctx);
+],
+found_lz4="yes",)
+])dnl
+
+AC_DEFUN([LZ4_CHECK_CONFIG],
+[
+  AC_ARG_WITH(lz4,[
+If you want to use LZ4 compression for server-proxy communications:
+AC_HELP_STRING([--with-lz4@<:@=DIR@:>@],[use LZ4 library @<:@default=no@:>@, DIR is the LZ4 library install directory.])],
+    [
+	if test "$withval" = "no"; then
+	    want_lz4="no"
+	    _lz4_dir="no"
+	elif test "$withval" = "yes"; then
+	    want_lz4="yes"
+	    _lz4_dir="no"
+	else
+	    want_lz4="yes"
+	    _lz4_dir=$withval
+	fi
+    ],[want_lz4=ifelse([$1],,[no],[$1])]
+  )
+
+  if test "x$want_lz4" = "xyes"; then
+     AC_MSG_CHECKING(for LZ4 support)
+     if test "x$_lz4_dir" = "xno"; then
+       if test -f /usr/include/lz4frame.h; then
+         LZ4_CFLAGS=-I/usr/include
+         LZ4_LDFLAGS=-L/usr/lib
+         LZ4_LIBS="-llz4"
+         found_lz4="yes"
+       elif test -f /usr/local/include/lz4frame.h; then
+         LZ4_CFLAGS=-I/usr/local/include
+         LZ4_LDFLAGS=-L/usr/local/lib
+         LZ4_LIBS="-llz4"
+         found_lz4="yes"
+       else #libraries are not found in default directories
+         found_lz4="no"
+         AC_MSG_RESULT(no)
+       fi
+     else
+       if test -f $_lz4_dir/include/lz4frame.h; then
+         LZ4_CFLAGS=-I$_lz4_dir/include
+         LZ4_LDFLAGS=-L$_lz4_dir/lib
+         LZ4_LIBS="-llz4"
+         found_lz4="yes"
+       else
+         found_lz4="no"
+         AC_MSG_RESULT(no)
+       fi
+     fi
+  fi
+
+  if test "x$found_lz4" = "xyes"; then
+    am_save_cflags="$CFLAGS"
+    am_save_ldflags="$LDFLAGS"
+    am_save_libs="$LIBS"
+
+    CFLAGS="$CFLAGS $LZ4_CFLAGS"
+    LDFLAGS="$LDFLAGS $LZ4_LDFLAGS"
+    LIBS="$LIBS $LZ4_LIBS"
+
+    found_lz4="no"
+    LZ4_TRY_LINK([no])
+
+    CFLAGS="$am_save_cflags"
+    LDFLAGS="$am_save_ldflags"
+    LIBS="$am_save_libs"
+
+    if test "x$found_lz4" = "xyes"; then
+      AC_DEFINE([HAVE_LZ4], 1, [Define to 1 if you have the 'lz4' library (-llz4)])
+      AC_MSG_RESULT(yes)
+    else
+      AC_MSG_RESULT(no)
+      LZ4_CFLAGS=""
+      LZ4_LDFLAGS=""
+      LZ4_LIBS=""
+    fi
+  fi
+
+  AC_SUBST(LZ4_CFLAGS)
+  AC_SUBST(LZ4_LDFLAGS)
+  AC_SUBST(LZ4_LIBS)
+
+])dnl
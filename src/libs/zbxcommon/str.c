@@ -1423,6 +1423,12 @@ const char	*get_process_type_string(unsigned char proc_type)
 			return "service manager";
 		case ZBX_PROCESS_TYPE_PROBLEMHOUSEKEEPER:
 			return "problem housekeeper";
+		case ZBX_PROCESS_TYPE_AGENTPOLLER:
+			return "agent poller";
+		case ZBX_PROCESS_TYPE_SNMPPOLLER:
+			return "snmp poller";
+		case ZBX_PROCESS_TYPE_HTTPAGENTPOLLER:
+			return "http agent poller";
 	}
 
 	THIS_SHOULD_NEVER_HAPPEN;
@@ -792,6 +792,114 @@ static ssize_t	zbx_tcp_write(zbx_socket_t *s, const char *buf, size_t len)
 	return res;
 }
 
+#define ZBX_TCP_CODEC_MASK	(ZBX_TCP_COMPRESS_ZSTD | ZBX_TCP_COMPRESS_LZ4)
+#define ZBX_TCP_ACCEPT_MASK	(ZBX_TCP_ACCEPT_ZSTD | ZBX_TCP_ACCEPT_LZ4)
+
+/******************************************************************************
+ *                                                                            *
+ * Function: tcp_compress_codec                                               *
+ *                                                                            *
+ * Purpose: get compression codec from protocol flags                         *
+ *                                                                            *
+ ******************************************************************************/
+static unsigned char	tcp_compress_codec(int flags)
+{
+	if (0 != (flags & ZBX_TCP_COMPRESS_ZSTD))
+		return ZBX_COMPRESS_ZSTD;
+
+	if (0 != (flags & ZBX_TCP_COMPRESS_LZ4))
+		return ZBX_COMPRESS_LZ4;
+
+	return ZBX_COMPRESS_ZLIB;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: tcp_accept_flags                                                 *
+ *                                                                            *
+ * Purpose: get protocol flags of compression codecs supported locally        *
+ *                                                                            *
+ ******************************************************************************/
+static int	tcp_accept_flags(void)
+{
+	int	flags = 0;
+
+	if (SUCCEED == zbx_compress_codec_supported(ZBX_COMPRESS_ZSTD))
+		flags |= ZBX_TCP_ACCEPT_ZSTD;
+
+	if (SUCCEED == zbx_compress_codec_supported(ZBX_COMPRESS_LZ4))
+		flags |= ZBX_TCP_ACCEPT_LZ4;
+
+	return flags;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: tcp_check_protocol                                               *
+ *                                                                            *
+ * Purpose: validate protocol flags of received message                       *
+ *                                                                            *
+ * Return value: SUCCEED - the message can be received                        *
+ *               FAIL    - unknown flags or unsupported compression codec     *
+ *                                                                            *
+ ******************************************************************************/
+static int	tcp_check_protocol(int flags)
+{
+	if (0 == (flags & ZBX_TCP_PROTOCOL))
+		return FAIL;
+
+	if (0 != (flags & ~(ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS | ZBX_TCP_CODEC_MASK | ZBX_TCP_ACCEPT_MASK)))
+		return FAIL;
+
+	if (0 == (flags & ZBX_TCP_CODEC_MASK))
+		return SUCCEED;
+
+	if (0 == (flags & ZBX_TCP_COMPRESS) || ZBX_TCP_CODEC_MASK == (flags & ZBX_TCP_CODEC_MASK))
+		return FAIL;
+
+	return zbx_compress_codec_supported(tcp_compress_codec(flags));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tcp_compress_flags                                           *
+ *                                                                            *
+ * Purpose: get protocol flags for compressed message sent to peer            *
+ *                                                                            *
+ * Parameters: peer_protocol - [IN] protocol flags of the last message        *
+ *                                  received from peer or the codecs peer has *
+ *                                  advertised, 0 if not known                *
+ *                                                                            *
+ * Return value: The protocol flags with the preferred compression codec if   *
+ *               peer is able to uncompress it, zlib otherwise.               *
+ *                                                                            *
+ * Comments: Older peers reject messages with unknown protocol flags, so      *
+ *           local codecs are advertised only after peer has advertised its   *
+ *           codecs.                                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tcp_compress_flags(int peer_protocol)
+{
+	int	flags = ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS;
+
+	if (0 != (peer_protocol & ZBX_TCP_ACCEPT_MASK))
+		flags |= tcp_accept_flags();
+
+	switch (zbx_compress_codec())
+	{
+		case ZBX_COMPRESS_ZSTD:
+			if (0 != (peer_protocol & ZBX_TCP_ACCEPT_ZSTD))
+				flags |= ZBX_TCP_COMPRESS_ZSTD;
+			break;
+		case ZBX_COMPRESS_LZ4:
+			if (0 != (peer_protocol & ZBX_TCP_ACCEPT_LZ4))
+				flags |= ZBX_TCP_COMPRESS_LZ4;
+			break;
+	}
+
+	return flags;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_tcp_send_ext                                                 *
@@ -838,9 +946,14 @@ int	zbx_tcp_send_ext(zbx_socket_t *s, const char *data, size_t len, unsigned cha
 								/* will be short-lived in CPU cache. Static buffer is */
 								/* not used on purpose.				      */
 
+		/* responses echoing peer flags must advertise local codecs, not the peer ones */
+		if (0 != (flags & ZBX_TCP_ACCEPT_MASK))
+			flags = (unsigned char)((flags & ~ZBX_TCP_ACCEPT_MASK) | tcp_accept_flags());
+
 		if (0 != (flags & ZBX_TCP_COMPRESS))
 		{
-			if (SUCCEED != zbx_compress(data, len, &compressed_data, &send_len))
+			if (SUCCEED != zbx_compress_ext(tcp_compress_codec(flags), data, len, &compressed_data,
+					&send_len))
 			{
 				zbx_set_socket_strerror("cannot compress data: %s", zbx_compress_strerror());
 				ret = FAIL;
@@ -1736,11 +1849,12 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 #define ZBX_TCP_EXPECT_LENGTH		4
 #define ZBX_TCP_EXPECT_SIZE		5
 
-	ssize_t		nbytes;
-	size_t		buf_dyn_bytes = 0, buf_stat_bytes = 0, offset = 0;
-	zbx_uint32_t	expected_len = 16 * ZBX_MEBIBYTE, reserved = 0;
-	unsigned char	expect = ZBX_TCP_EXPECT_HEADER;
-	int		protocol_version;
+	ssize_t			nbytes;
+	size_t			buf_dyn_bytes = 0, buf_stat_bytes = 0, offset = 0, read_len;
+	zbx_uint32_t		expected_len = 16 * ZBX_MEBIBYTE, reserved = 0;
+	unsigned char		expect = ZBX_TCP_EXPECT_HEADER;
+	int			protocol_version = 0;
+	zbx_uncompress_stream_t	*stream = NULL;
 
 	if (0 != timeout)
 		zbx_socket_timeout_set(s, timeout);
@@ -1750,8 +1864,20 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 	s->buf_type = ZBX_BUF_TYPE_STAT;
 	s->buffer = s->buf_stat;
 
-	while (0 != (nbytes = zbx_tcp_read(s, s->buf_stat + buf_stat_bytes, sizeof(s->buf_stat) - buf_stat_bytes)))
+	while (1)
 	{
+		/* do not read past the message, peer might have already sent the next one on the same connection */
+		if (ZBX_TCP_EXPECT_SIZE != expect)
+			read_len = ZBX_TCP_HEADER_LEN + 1 + 2 * sizeof(zbx_uint32_t) - buf_stat_bytes;
+		else
+		{
+			read_len = MIN(sizeof(s->buf_stat) - buf_stat_bytes,
+					expected_len - buf_stat_bytes - buf_dyn_bytes);
+		}
+
+		if (0 == (nbytes = zbx_tcp_read(s, s->buf_stat + buf_stat_bytes, read_len)))
+			break;
+
 		if (ZBX_PROTO_ERROR == nbytes)
 			goto out;
 
@@ -1760,7 +1886,18 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 		else
 		{
 			if (buf_dyn_bytes + nbytes <= expected_len)
-				memcpy(s->buffer + buf_dyn_bytes, s->buf_stat, nbytes);
+			{
+				if (NULL == stream)
+				{
+					memcpy(s->buffer + buf_dyn_bytes, s->buf_stat, nbytes);
+				}
+				else if (SUCCEED != zbx_uncompress_stream_write(stream, s->buf_stat, (size_t)nbytes))
+				{
+					zbx_set_socket_strerror("cannot uncompress data: %s", zbx_compress_strerror());
+					nbytes = ZBX_PROTO_ERROR;
+					goto out;
+				}
+			}
 			buf_dyn_bytes += nbytes;
 		}
 
@@ -1795,10 +1932,9 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 				continue;
 
 			expect = ZBX_TCP_EXPECT_VERSION_VALIDATE;
-			protocol_version = s->buf_stat[ZBX_TCP_HEADER_LEN];
+			protocol_version = (unsigned char)s->buf_stat[ZBX_TCP_HEADER_LEN];
 
-			if (0 == (protocol_version & ZBX_TCP_PROTOCOL) ||
-					protocol_version > (ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS))
+			if (SUCCEED != tcp_check_protocol(protocol_version))
 			{
 				/* invalid protocol version, abort receiving */
 				break;
@@ -1842,7 +1978,26 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 				goto out;
 			}
 
-			if (sizeof(s->buf_stat) > expected_len)
+			if (0 != (protocol_version & ZBX_TCP_COMPRESS))
+			{
+				/* compressed data is uncompressed while being received into buffer of */
+				/* uncompressed size, so the whole compressed message is never kept    */
+				s->buf_type = ZBX_BUF_TYPE_DYN;
+				s->buffer = (char *)zbx_malloc(NULL, reserved + 1);
+				buf_dyn_bytes = buf_stat_bytes - offset;
+				buf_stat_bytes = 0;
+
+				if (NULL == (stream = zbx_uncompress_stream_create(tcp_compress_codec(protocol_version),
+						s->buffer, reserved)) ||
+						SUCCEED != zbx_uncompress_stream_write(stream, s->buf_stat + offset,
+						MIN(buf_dyn_bytes, expected_len)))
+				{
+					zbx_set_socket_strerror("cannot uncompress data: %s", zbx_compress_strerror());
+					nbytes = ZBX_PROTO_ERROR;
+					goto out;
+				}
+			}
+			else if (sizeof(s->buf_stat) > expected_len)
 			{
 				buf_stat_bytes -= offset;
 				memmove(s->buf_stat, s->buf_stat + offset, buf_stat_bytes);
@@ -1867,15 +2022,12 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 	{
 		if (buf_stat_bytes + buf_dyn_bytes == expected_len)
 		{
-			if (0 != (protocol_version & ZBX_TCP_COMPRESS))
+			if (NULL != stream)
 			{
-				char	*out;
-				size_t	out_size = reserved;
+				size_t	out_size;
 
-				out = (char *)zbx_malloc(NULL, reserved + 1);
-				if (FAIL == zbx_uncompress(s->buffer, buf_stat_bytes + buf_dyn_bytes, out, &out_size))
+				if (SUCCEED != zbx_uncompress_stream_finish(stream, &out_size))
 				{
-					zbx_free(out);
 					zbx_set_socket_strerror("cannot uncompress data: %s", zbx_compress_strerror());
 					nbytes = ZBX_PROTO_ERROR;
 					goto out;
@@ -1883,17 +2035,11 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 
 				if (out_size != reserved)
 				{
-					zbx_free(out);
 					zbx_set_socket_strerror("size of uncompressed data is less than expected");
 					nbytes = ZBX_PROTO_ERROR;
 					goto out;
 				}
 
-				if (ZBX_BUF_TYPE_DYN == s->buf_type)
-					zbx_free(s->buffer);
-
-				s->buf_type = ZBX_BUF_TYPE_DYN;
-				s->buffer = out;
 				s->read_bytes = reserved;
 
 				zabbix_log(LOG_LEVEL_TRACE, "%s(): received " ZBX_FS_SIZE_T " bytes with"
@@ -1950,6 +2096,9 @@ ssize_t	zbx_tcp_recv_ext(zbx_socket_t *s, int timeout)
 		s->buffer[s->read_bytes] = '\0';
 	}
 out:
+	if (NULL != stream)
+		zbx_uncompress_stream_free(stream);
+
 	if (0 != timeout)
 		zbx_socket_timeout_cleanup(s);
 
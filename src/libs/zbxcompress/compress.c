@@ -17,6 +17,7 @@
 ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 **/
 
+
 #include "common.h"
 #include "log.h"
 #include "zbxcompress.h"
@@ -24,9 +25,64 @@
 #ifdef HAVE_ZLIB
 #include "zlib.h"
 
+#ifdef HAVE_ZSTD
+#	include <zstd.h>
+#endif
+
+#ifdef HAVE_LZ4
+#	include <lz4frame.h>
+#endif
+
 #define ZBX_COMPRESS_STRERROR_LEN	512
 
-static int	zbx_zlib_errno = 0;
+/* input is processed and output buffer is grown in chunks of this size */
+#define ZBX_COMPRESS_CHUNK_SIZE		(64 * ZBX_KIBIBYTE)
+
+/* the maximum accepted zstd dictionary size */
+#define ZBX_COMPRESS_DICT_MAX		(8 * ZBX_MEBIBYTE)
+
+struct zbx_uncompress_stream
+{
+	unsigned char	codec;
+	int		finished;
+	char		*out;
+	size_t		out_size;
+	size_t		out_offset;
+	z_stream	zstream;
+#ifdef HAVE_ZSTD
+	ZSTD_DCtx	*zstd_dctx;
+#endif
+#ifdef HAVE_LZ4
+	LZ4F_dctx	*lz4_dctx;
+#endif
+};
+
+static int		zbx_zlib_errno = 0;
+
+/* the codec and message of the last error not described by zlib error code */
+static unsigned char	zbx_compress_errcodec = ZBX_COMPRESS_ZLIB;
+static const char	*zbx_codec_error = NULL;
+
+/* the codec preferred for outgoing data when peer supports it */
+static unsigned char	zbx_compress_preferred = ZBX_COMPRESS_ZLIB;
+
+#ifdef HAVE_ZSTD
+static ZSTD_CCtx	*zstd_cctx = NULL;
+static ZSTD_CDict	*zstd_cdict = NULL;
+static ZSTD_DDict	*zstd_ddict = NULL;
+#endif
+
+static void	compress_set_zlib_error(int errnum)
+{
+	zbx_zlib_errno = errnum;
+	zbx_codec_error = NULL;
+}
+
+static void	compress_set_error(unsigned char codec, const char *message)
+{
+	zbx_compress_errcodec = codec;
+	zbx_codec_error = message;
+}
 
 /******************************************************************************
  *                                                                            *
@@ -39,6 +95,29 @@ const char	*zbx_compress_strerror(void)
 {
 	static char	message[ZBX_COMPRESS_STRERROR_LEN];
 
+	if (NULL != zbx_codec_error)
+	{
+		const char	*codec;
+
+		switch (zbx_compress_errcodec)
+		{
+			case ZBX_COMPRESS_ZLIB:
+				codec = "zlib";
+				break;
+			case ZBX_COMPRESS_ZSTD:
+				codec = "zstd";
+				break;
+			case ZBX_COMPRESS_LZ4:
+				codec = "lz4";
+				break;
+			default:
+				codec = "unknown codec";
+		}
+
+		zbx_snprintf(message, sizeof(message), "%s: %s", codec, zbx_codec_error);
+		return message;
+	}
+
 	switch (zbx_zlib_errno)
 	{
 		case Z_ERRNO:
@@ -61,13 +140,366 @@ const char	*zbx_compress_strerror(void)
 	return message;
 }
 
+#ifdef HAVE_ZSTD
 /******************************************************************************
  *                                                                            *
- * Function: zbx_compress                                                     *
+ * Function: compress_load_dictionary                                         *
  *                                                                            *
- * Purpose: compress data                                                     *
+ * Purpose: load zstd dictionary used for compression and decompression       *
  *                                                                            *
- * Parameters: in       - [IN] the data to compress                           *
+ * Parameters: path  - [IN] the dictionary file                               *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - the dictionary was loaded successfully             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: The dictionary is expected to be trained on proxy data (for      *
+ *           example with 'zstd --train') and must be the same on server and  *
+ *           all proxies using zstd codec.                                    *
+ *                                                                            *
+ ******************************************************************************/
+static int	compress_load_dictionary(const char *path, char **error)
+{
+	zbx_stat_t	st;
+	int		fd, ret = FAIL;
+	char		*buf = NULL;
+	size_t		offset = 0;
+	ssize_t		nbytes;
+
+	if (-1 == (fd = zbx_open(path, O_RDONLY)))
+	{
+		*error = zbx_dsprintf(*error, "cannot open compression dictionary \"%s\": %s", path,
+				zbx_strerror(errno));
+		return FAIL;
+	}
+
+	if (0 != zbx_fstat(fd, &st))
+	{
+		*error = zbx_dsprintf(*error, "cannot obtain compression dictionary \"%s\" information: %s", path,
+				zbx_strerror(errno));
+		goto out;
+	}
+
+	if (0 == st.st_size || ZBX_COMPRESS_DICT_MAX < st.st_size)
+	{
+		*error = zbx_dsprintf(*error, "invalid compression dictionary \"%s\" size " ZBX_FS_UI64, path,
+				(zbx_uint64_t)st.st_size);
+		goto out;
+	}
+
+	buf = (char *)zbx_malloc(NULL, (size_t)st.st_size);
+
+	while (offset < (size_t)st.st_size && 0 < (nbytes = read(fd, buf + offset, (size_t)st.st_size - offset)))
+		offset += (size_t)nbytes;
+
+	if (offset != (size_t)st.st_size)
+	{
+		*error = zbx_dsprintf(*error, "cannot read compression dictionary \"%s\"", path);
+		goto out;
+	}
+
+	if (NULL == (zstd_cdict = ZSTD_createCDict(buf, offset, ZSTD_CLEVEL_DEFAULT)) ||
+			NULL == (zstd_ddict = ZSTD_createDDict(buf, offset)))
+	{
+		*error = zbx_dsprintf(*error, "cannot load compression dictionary \"%s\"", path);
+		goto out;
+	}
+
+	ret = SUCCEED;
+out:
+	if (SUCCEED != ret)
+	{
+		ZSTD_freeCDict(zstd_cdict);
+		zstd_cdict = NULL;
+		ZSTD_freeDDict(zstd_ddict);
+		zstd_ddict = NULL;
+	}
+
+	zbx_free(buf);
+	close(fd);
+
+	return ret;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_compress_init                                                *
+ *                                                                            *
+ * Purpose: select the preferred compression codec                            *
+ *                                                                            *
+ * Parameters: codec      - [IN] the codec name (zlib, zstd or lz4), NULL or  *
+ *                               empty string selects zlib                    *
+ *             dictionary - [IN] the zstd dictionary file, optional           *
+ *             error      - [OUT] the error message                           *
+ *                                                                            *
+ * Return value: SUCCEED - the codec was initialized successfully             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_compress_init(const char *codec, const char *dictionary, char **error)
+{
+	if (NULL == codec || '\0' == *codec || 0 == strcmp(codec, "zlib"))
+	{
+		zbx_compress_preferred = ZBX_COMPRESS_ZLIB;
+	}
+	else if (0 == strcmp(codec, "zstd"))
+	{
+		if (SUCCEED != zbx_compress_codec_supported(ZBX_COMPRESS_ZSTD))
+		{
+			*error = zbx_strdup(*error, "zstd compression support was not compiled in");
+			return FAIL;
+		}
+
+		zbx_compress_preferred = ZBX_COMPRESS_ZSTD;
+	}
+	else if (0 == strcmp(codec, "lz4"))
+	{
+		if (SUCCEED != zbx_compress_codec_supported(ZBX_COMPRESS_LZ4))
+		{
+			*error = zbx_strdup(*error, "LZ4 compression support was not compiled in");
+			return FAIL;
+		}
+
+		zbx_compress_preferred = ZBX_COMPRESS_LZ4;
+	}
+	else
+	{
+		*error = zbx_dsprintf(*error, "unknown compression codec \"%s\"", codec);
+		return FAIL;
+	}
+
+	if (NULL != dictionary && '\0' != *dictionary)
+	{
+#ifdef HAVE_ZSTD
+		return compress_load_dictionary(dictionary, error);
+#else
+		*error = zbx_strdup(*error, "compression dictionary requires zstd support, which was not compiled in");
+		return FAIL;
+#endif
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_compress_codec                                               *
+ *                                                                            *
+ * Purpose: returns the preferred compression codec                           *
+ *                                                                            *
+ ******************************************************************************/
+unsigned char	zbx_compress_codec(void)
+{
+	return zbx_compress_preferred;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_compress_codec_supported                                     *
+ *                                                                            *
+ * Purpose: checks if the compression codec was compiled in                   *
+ *                                                                            *
+ * Return value: SUCCEED - the codec is supported                             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_compress_codec_supported(unsigned char codec)
+{
+	switch (codec)
+	{
+		case ZBX_COMPRESS_ZLIB:
+			return SUCCEED;
+#ifdef HAVE_ZSTD
+		case ZBX_COMPRESS_ZSTD:
+			return SUCCEED;
+#endif
+#ifdef HAVE_LZ4
+		case ZBX_COMPRESS_LZ4:
+			return SUCCEED;
+#endif
+		default:
+			return FAIL;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: compress_reserve                                                 *
+ *                                                                            *
+ * Purpose: ensure the output buffer has at least the specified free space    *
+ *                                                                            *
+ ******************************************************************************/
+static void	compress_reserve(char **out, size_t *out_alloc, size_t out_offset, size_t size)
+{
+	if (*out_alloc - out_offset >= size)
+		return;
+
+	while (*out_alloc - out_offset < size)
+		*out_alloc += MAX(*out_alloc / 2, ZBX_COMPRESS_CHUNK_SIZE);
+
+	*out = (char *)zbx_realloc(*out, *out_alloc);
+}
+
+static int	compress_zlib(const char *in, size_t size_in, char **out, size_t *out_alloc, size_t *out_offset)
+{
+	z_stream	zs;
+	int		ret;
+
+	memset(&zs, 0, sizeof(zs));
+
+	if (Z_OK != (ret = deflateInit(&zs, Z_DEFAULT_COMPRESSION)))
+	{
+		compress_set_zlib_error(ret);
+		return FAIL;
+	}
+
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = (uInt)size_in;
+
+	do
+	{
+		compress_reserve(out, out_alloc, *out_offset, ZBX_COMPRESS_CHUNK_SIZE);
+
+		zs.next_out = (Bytef *)*out + *out_offset;
+		zs.avail_out = (uInt)(*out_alloc - *out_offset);
+
+		ret = deflate(&zs, Z_FINISH);
+		*out_offset = zs.total_out;
+	}
+	while (Z_OK == ret);
+
+	deflateEnd(&zs);
+
+	if (Z_STREAM_END != ret)
+	{
+		compress_set_zlib_error(ret);
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+#ifdef HAVE_ZSTD
+static int	compress_zstd(const char *in, size_t size_in, char **out, size_t *out_alloc, size_t *out_offset)
+{
+	ZSTD_inBuffer	input;
+	ZSTD_outBuffer	output;
+	size_t		ret;
+
+	input.src = in;
+	input.size = size_in;
+	input.pos = 0;
+
+	if (NULL == zstd_cctx)
+	{
+		if (NULL == (zstd_cctx = ZSTD_createCCtx()))
+		{
+			compress_set_error(ZBX_COMPRESS_ZSTD, "cannot create compression context");
+			return FAIL;
+		}
+
+		/* unlike zlib stream zstd frame has no checksum by default, corrupted data would go undetected */
+		ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_checksumFlag, 1);
+
+		if (NULL != zstd_cdict)
+			ZSTD_CCtx_refCDict(zstd_cctx, zstd_cdict);
+	}
+
+	ZSTD_CCtx_reset(zstd_cctx, ZSTD_reset_session_only);
+	ZSTD_CCtx_setPledgedSrcSize(zstd_cctx, size_in);
+
+	do
+	{
+		compress_reserve(out, out_alloc, *out_offset, ZBX_COMPRESS_CHUNK_SIZE);
+
+		output.dst = *out;
+		output.size = *out_alloc;
+		output.pos = *out_offset;
+
+		ret = ZSTD_compressStream2(zstd_cctx, &output, &input, ZSTD_e_end);
+		*out_offset = output.pos;
+
+		if (0 != ZSTD_isError(ret))
+		{
+			compress_set_error(ZBX_COMPRESS_ZSTD, ZSTD_getErrorName(ret));
+			return FAIL;
+		}
+	}
+	while (0 != ret);
+
+	return SUCCEED;
+}
+#endif
+
+#ifdef HAVE_LZ4
+static int	compress_lz4(const char *in, size_t size_in, char **out, size_t *out_alloc, size_t *out_offset)
+{
+	LZ4F_cctx		*cctx;
+	LZ4F_preferences_t	prefs;
+	size_t			ret, offset = 0, chunk;
+
+	ret = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+
+	if (0 != LZ4F_isError(ret))
+	{
+		compress_set_error(ZBX_COMPRESS_LZ4, LZ4F_getErrorName(ret));
+		return FAIL;
+	}
+
+	memset(&prefs, 0, sizeof(prefs));
+	prefs.frameInfo.contentSize = size_in;
+	prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+	compress_reserve(out, out_alloc, *out_offset, LZ4F_HEADER_SIZE_MAX);
+	ret = LZ4F_compressBegin(cctx, *out + *out_offset, *out_alloc - *out_offset, &prefs);
+
+	while (0 == LZ4F_isError(ret))
+	{
+		*out_offset += ret;
+
+		if (offset == size_in)
+			break;
+
+		chunk = MIN(size_in - offset, ZBX_COMPRESS_CHUNK_SIZE);
+		compress_reserve(out, out_alloc, *out_offset, LZ4F_compressBound(chunk, &prefs));
+
+		ret = LZ4F_compressUpdate(cctx, *out + *out_offset, *out_alloc - *out_offset, in + offset, chunk,
+				NULL);
+		offset += chunk;
+	}
+
+	if (0 == LZ4F_isError(ret))
+	{
+		compress_reserve(out, out_alloc, *out_offset, LZ4F_compressBound(0, &prefs));
+
+		if (0 == LZ4F_isError(ret = LZ4F_compressEnd(cctx, *out + *out_offset, *out_alloc - *out_offset,
+				NULL)))
+		{
+			*out_offset += ret;
+		}
+	}
+
+	LZ4F_freeCompressionContext(cctx);
+
+	if (0 != LZ4F_isError(ret))
+	{
+		compress_set_error(ZBX_COMPRESS_LZ4, LZ4F_getErrorName(ret));
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_compress_ext                                                 *
+ *                                                                            *
+ * Purpose: compress data with the specified codec                            *
+ *                                                                            *
+ * Parameters: codec    - [IN] the compression codec                          *
+ *             in       - [IN] the data to compress                           *
  *             size_in  - [IN] the input data size                            *
  *             out      - [OUT] the compressed data                           *
  *             size_out - [OUT] the compressed data size                      *
@@ -77,28 +509,75 @@ const char	*zbx_compress_strerror(void)
  *                                                                            *
  * Comments: In the case of success the output buffer must be freed by the    *
  *           caller.                                                          *
+ *           The input is compressed as a stream into output buffer growing   *
+ *           on demand instead of allocating the worst case compressed size   *
+ *           upfront.                                                         *
  *                                                                            *
  ******************************************************************************/
-int	zbx_compress(const char *in, size_t size_in, char **out, size_t *size_out)
+int	zbx_compress_ext(unsigned char codec, const char *in, size_t size_in, char **out, size_t *size_out)
 {
-	Bytef	*buf;
-	uLongf	buf_size;
+	char	*buf;
+	size_t	buf_alloc, buf_offset = 0;
+	int	ret;
 
-	buf_size = compressBound(size_in);
-	buf = (Bytef *)zbx_malloc(NULL, buf_size);
+	buf_alloc = MIN(size_in / 4 + ZBX_COMPRESS_CHUNK_SIZE, 4 * ZBX_MEBIBYTE);
+	buf = (char *)zbx_malloc(NULL, buf_alloc);
 
-	if (Z_OK != (zbx_zlib_errno = compress(buf, &buf_size, (const Bytef *)in, size_in)))
+	switch (codec)
+	{
+		case ZBX_COMPRESS_ZLIB:
+			ret = compress_zlib(in, size_in, &buf, &buf_alloc, &buf_offset);
+			break;
+#ifdef HAVE_ZSTD
+		case ZBX_COMPRESS_ZSTD:
+			ret = compress_zstd(in, size_in, &buf, &buf_alloc, &buf_offset);
+			break;
+#endif
+#ifdef HAVE_LZ4
+		case ZBX_COMPRESS_LZ4:
+			ret = compress_lz4(in, size_in, &buf, &buf_alloc, &buf_offset);
+			break;
+#endif
+		default:
+			compress_set_error(codec, "codec is not supported");
+			ret = FAIL;
+	}
+
+	if (SUCCEED != ret)
 	{
 		zbx_free(buf);
 		return FAIL;
 	}
 
-	*out = (char *)buf;
-	*size_out = buf_size;
+	*out = buf;
+	*size_out = buf_offset;
 
 	return SUCCEED;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_compress                                                     *
+ *                                                                            *
+ * Purpose: compress data                                                     *
+ *                                                                            *
+ * Parameters: in       - [IN] the data to compress                           *
+ *             size_in  - [IN] the input data size                            *
+ *             out      - [OUT] the compressed data                           *
+ *             size_out - [OUT] the compressed data size                      *
+ *                                                                            *
+ * Return value: SUCCEED - the data was compressed successfully               *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: In the case of success the output buffer must be freed by the    *
+ *           caller.                                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_compress(const char *in, size_t size_in, char **out, size_t *size_out)
+{
+	return zbx_compress_ext(ZBX_COMPRESS_ZLIB, in, size_in, out, size_out);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_uncompress                                                   *
@@ -117,17 +596,345 @@ int	zbx_compress(const char *in, size_t size_in, char **out, size_t *size_out)
 int	zbx_uncompress(const char *in, size_t size_in, char *out, size_t *size_out)
 {
 	uLongf	size_o = *size_out;
+	int	ret;
 
-	if (Z_OK != (zbx_zlib_errno = uncompress((Bytef *)out, &size_o, (const Bytef *)in, size_in)))
+	if (Z_OK != (ret = uncompress((Bytef *)out, &size_o, (const Bytef *)in, size_in)))
+	{
+		compress_set_zlib_error(ret);
 		return FAIL;
+	}
 
 	*size_out = size_o;
 
 	return SUCCEED;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_uncompress_stream_create                                     *
+ *                                                                            *
+ * Purpose: create stream to uncompress data received in chunks               *
+ *                                                                            *
+ * Parameters: codec    - [IN] the compression codec                          *
+ *             out      - [IN] the output buffer                              *
+ *             out_size - [IN] the output buffer size                         *
+ *                                                                            *
+ * Return value: The created stream or NULL in the case of failure.           *
+ *                                                                            *
+ * Comments: The output buffer must not be freed while the stream is used.    *
+ *                                                                            *
+ ******************************************************************************/
+zbx_uncompress_stream_t	*zbx_uncompress_stream_create(unsigned char codec, char *out, size_t out_size)
+{
+	zbx_uncompress_stream_t	*stream;
+	int			ret = SUCCEED, err;
+
+	stream = (zbx_uncompress_stream_t *)zbx_malloc(NULL, sizeof(zbx_uncompress_stream_t));
+	memset(stream, 0, sizeof(zbx_uncompress_stream_t));
+
+	stream->codec = codec;
+	stream->out = out;
+	stream->out_size = out_size;
+
+	switch (codec)
+	{
+		case ZBX_COMPRESS_ZLIB:
+			if (Z_OK != (err = inflateInit(&stream->zstream)))
+			{
+				compress_set_zlib_error(err);
+				ret = FAIL;
+			}
+			break;
+#ifdef HAVE_ZSTD
+		case ZBX_COMPRESS_ZSTD:
+			if (NULL == (stream->zstd_dctx = ZSTD_createDCtx()))
+			{
+				compress_set_error(ZBX_COMPRESS_ZSTD, "cannot create decompression context");
+				ret = FAIL;
+			}
+			else if (NULL != zstd_ddict)
+				ZSTD_DCtx_refDDict(stream->zstd_dctx, zstd_ddict);
+			break;
+#endif
+#ifdef HAVE_LZ4
+		case ZBX_COMPRESS_LZ4:
+		{
+			LZ4F_errorCode_t	lz4_err;
+
+			lz4_err = LZ4F_createDecompressionContext(&stream->lz4_dctx, LZ4F_VERSION);
+
+			if (0 != LZ4F_isError(lz4_err))
+			{
+				compress_set_error(ZBX_COMPRESS_LZ4, LZ4F_getErrorName(lz4_err));
+				ret = FAIL;
+			}
+			break;
+		}
+#endif
+		default:
+			compress_set_error(codec, "codec is not supported");
+			ret = FAIL;
+	}
+
+	if (SUCCEED != ret)
+		zbx_free(stream);
+
+	return stream;
+}
+
+static int	uncompress_write_zlib(zbx_uncompress_stream_t *stream, const char *in, size_t size_in)
+{
+	int	ret;
+
+	stream->zstream.next_in = (Bytef *)in;
+	stream->zstream.avail_in = (uInt)size_in;
+
+	while (0 != stream->zstream.avail_in)
+	{
+		stream->zstream.next_out = (Bytef *)stream->out + stream->out_offset;
+		stream->zstream.avail_out = (uInt)(stream->out_size - stream->out_offset);
+
+		ret = inflate(&stream->zstream, Z_NO_FLUSH);
+		stream->out_offset = stream->zstream.total_out;
+
+		if (Z_STREAM_END == ret)
+		{
+			stream->finished = 1;
+			break;
+		}
+
+		if (Z_OK != ret)
+		{
+			compress_set_zlib_error(Z_NEED_DICT == ret ? Z_DATA_ERROR : ret);
+			return FAIL;
+		}
+	}
+
+	return SUCCEED;
+}
+
+#ifdef HAVE_ZSTD
+static int	uncompress_write_zstd(zbx_uncompress_stream_t *stream, const char *in, size_t size_in)
+{
+	ZSTD_inBuffer	input;
+	ZSTD_outBuffer	output;
+	size_t		ret, pos_in, pos_out;
+
+	input.src = in;
+	input.size = size_in;
+	input.pos = 0;
+
+	output.dst = stream->out;
+	output.size = stream->out_size;
+	output.pos = stream->out_offset;
+
+	while (input.pos < input.size)
+	{
+		pos_in = input.pos;
+		pos_out = output.pos;
+
+		ret = ZSTD_decompressStream(stream->zstd_dctx, &output, &input);
+		stream->out_offset = output.pos;
+
+		if (0 != ZSTD_isError(ret))
+		{
+			compress_set_error(ZBX_COMPRESS_ZSTD, ZSTD_getErrorName(ret));
+			return FAIL;
+		}
+
+		if (0 == ret)
+		{
+			stream->finished = 1;
+			break;
+		}
+
+		if (pos_in == input.pos && pos_out == output.pos)
+		{
+			compress_set_error(ZBX_COMPRESS_ZSTD, "not enough space in output buffer");
+			return FAIL;
+		}
+	}
+
+	/* the remaining input after the end of frame is rejected by caller */
+	return input.pos == input.size ? SUCCEED : FAIL;
+}
+#endif
+
+#ifdef HAVE_LZ4
+static int	uncompress_write_lz4(zbx_uncompress_stream_t *stream, const char *in, size_t size_in)
+{
+	size_t	ret, size_src, size_dst, offset = 0;
+
+	while (offset < size_in)
+	{
+		size_src = size_in - offset;
+		size_dst = stream->out_size - stream->out_offset;
+
+		ret = LZ4F_decompress(stream->lz4_dctx, stream->out + stream->out_offset, &size_dst, in + offset,
+				&size_src, NULL);
+
+		if (0 != LZ4F_isError(ret))
+		{
+			compress_set_error(ZBX_COMPRESS_LZ4, LZ4F_getErrorName(ret));
+			return FAIL;
+		}
+
+		stream->out_offset += size_dst;
+		offset += size_src;
+
+		if (0 == ret)
+		{
+			stream->finished = 1;
+			break;
+		}
+
+		if (0 == size_src && 0 == size_dst)
+		{
+			compress_set_error(ZBX_COMPRESS_LZ4, "not enough space in output buffer");
+			return FAIL;
+		}
+	}
+
+	return offset == size_in ? SUCCEED : FAIL;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_uncompress_stream_write                                      *
+ *                                                                            *
+ * Purpose: uncompress the next chunk of data                                 *
+ *                                                                            *
+ * Parameters: stream  - [IN] the uncompress stream                           *
+ *             in      - [IN] the compressed data chunk                       *
+ *             size_in - [IN] the chunk size                                  *
+ *                                                                            *
+ * Return value: SUCCEED - the chunk was uncompressed successfully            *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_uncompress_stream_write(zbx_uncompress_stream_t *stream, const char *in, size_t size_in)
+{
+	int	ret;
+
+	if (0 != stream->finished)
+	{
+		if (0 == size_in)
+			return SUCCEED;
+
+		compress_set_error(stream->codec, "unexpected data after the end of compressed stream");
+		return FAIL;
+	}
+
+	switch (stream->codec)
+	{
+		case ZBX_COMPRESS_ZLIB:
+			ret = uncompress_write_zlib(stream, in, size_in);
+			break;
+#ifdef HAVE_ZSTD
+		case ZBX_COMPRESS_ZSTD:
+			ret = uncompress_write_zstd(stream, in, size_in);
+			break;
+#endif
+#ifdef HAVE_LZ4
+		case ZBX_COMPRESS_LZ4:
+			ret = uncompress_write_lz4(stream, in, size_in);
+			break;
+#endif
+		default:
+			compress_set_error(stream->codec, "codec is not supported");
+			return FAIL;
+	}
+
+	if (ZBX_COMPRESS_ZLIB == stream->codec && 0 != stream->finished && 0 != stream->zstream.avail_in)
+		ret = FAIL;
+
+	if (SUCCEED != ret && 0 != stream->finished)
+		compress_set_error(stream->codec, "unexpected data after the end of compressed stream");
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_uncompress_stream_finish                                     *
+ *                                                                            *
+ * Purpose: check that the whole compressed stream was uncompressed           *
+ *                                                                            *
+ * Parameters: stream   - [IN] the uncompress stream                          *
+ *             size_out - [OUT] the uncompressed data size                    *
+ *                                                                            *
+ * Return value: SUCCEED - the stream was completed                           *
+ *               FAIL    - the compressed data was truncated                  *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_uncompress_stream_finish(zbx_uncompress_stream_t *stream, size_t *size_out)
+{
+	if (0 == stream->finished)
+	{
+		if (ZBX_COMPRESS_ZLIB == stream->codec)
+			compress_set_zlib_error(Z_DATA_ERROR);
+		else
+			compress_set_error(stream->codec, "unexpected end of compressed stream");
+
+		return FAIL;
+	}
+
+	*size_out = stream->out_offset;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_uncompress_stream_free                                       *
+ *                                                                            *
+ * Purpose: free the uncompress stream, the output buffer is not freed        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_uncompress_stream_free(zbx_uncompress_stream_t *stream)
+{
+	switch (stream->codec)
+	{
+		case ZBX_COMPRESS_ZLIB:
+			inflateEnd(&stream->zstream);
+			break;
+#ifdef HAVE_ZSTD
+		case ZBX_COMPRESS_ZSTD:
+			ZSTD_freeDCtx(stream->zstd_dctx);
+			break;
+#endif
+#ifdef HAVE_LZ4
+		case ZBX_COMPRESS_LZ4:
+			LZ4F_freeDecompressionContext(stream->lz4_dctx);
+			break;
+#endif
+	}
+
+	zbx_free(stream);
+}
+
 #else
 
+int	zbx_compress_init(const char *codec, const char *dictionary, char **error)
+{
+	ZBX_UNUSED(codec);
+	ZBX_UNUSED(dictionary);
+	ZBX_UNUSED(error);
+	return SUCCEED;
+}
+
+unsigned char	zbx_compress_codec(void)
+{
+	return ZBX_COMPRESS_ZLIB;
+}
+
+int	zbx_compress_codec_supported(unsigned char codec)
+{
+	ZBX_UNUSED(codec);
+	return FAIL;
+}
+
 int zbx_compress(const char *in, size_t size_in, char **out, size_t *size_out)
 {
 	ZBX_UNUSED(in);
@@ -137,6 +944,16 @@ int zbx_compress(const char *in, size_t size_in, char **out, size_t *size_out)
 	return FAIL;
 }
 
+int	zbx_compress_ext(unsigned char codec, const char *in, size_t size_in, char **out, size_t *size_out)
+{
+	ZBX_UNUSED(codec);
+	ZBX_UNUSED(in);
+	ZBX_UNUSED(size_in);
+	ZBX_UNUSED(out);
+	ZBX_UNUSED(size_out);
+	return FAIL;
+}
+
 int zbx_uncompress(const char *in, size_t size_in, char *out, size_t *size_out)
 {
 	ZBX_UNUSED(in);
@@ -151,4 +968,32 @@ const char	*zbx_compress_strerror(void)
 	return "";
 }
 
+zbx_uncompress_stream_t	*zbx_uncompress_stream_create(unsigned char codec, char *out, size_t out_size)
+{
+	ZBX_UNUSED(codec);
+	ZBX_UNUSED(out);
+	ZBX_UNUSED(out_size);
+	return NULL;
+}
+
+int	zbx_uncompress_stream_write(zbx_uncompress_stream_t *stream, const char *in, size_t size_in)
+{
+	ZBX_UNUSED(stream);
+	ZBX_UNUSED(in);
+	ZBX_UNUSED(size_in);
+	return FAIL;
+}
+
+int	zbx_uncompress_stream_finish(zbx_uncompress_stream_t *stream, size_t *size_out)
+{
+	ZBX_UNUSED(stream);
+	ZBX_UNUSED(size_out);
+	return FAIL;
+}
+
+void	zbx_uncompress_stream_free(zbx_uncompress_stream_t *stream)
+{
+	ZBX_UNUSED(stream);
+}
+
 #endif
@@ -64,20 +64,34 @@ struct zbx_db_result
 #endif
 };
 
-static int	txn_level = 0;	/* transaction level, nested transactions are not supported */
-static int	txn_error = ZBX_DB_OK;	/* failed transaction */
-static int	txn_end_error = ZBX_DB_OK;	/* transaction result */
+/* connection and transaction state is thread local to allow several connections in threaded processes */
+static ZBX_THREAD_LOCAL int	txn_level = 0;	/* transaction level, nested transactions are not supported */
+static ZBX_THREAD_LOCAL int	txn_error = ZBX_DB_OK;	/* failed transaction */
+static ZBX_THREAD_LOCAL int	txn_end_error = ZBX_DB_OK;	/* transaction result */
 
-static char	*last_db_strerror = NULL;	/* last database error message */
+static ZBX_THREAD_LOCAL char	*last_db_strerror = NULL;	/* last database error message */
 
 extern int	CONFIG_LOG_SLOW_QUERIES;
 
 static int	db_auto_increment;
 
 #if defined(HAVE_MYSQL)
-static MYSQL			*conn = NULL;
+static ZBX_THREAD_LOCAL MYSQL	*conn = NULL;
 static zbx_uint32_t		ZBX_MYSQL_SVERSION = ZBX_DBVERSION_UNDEFINED;
 static int			ZBX_MARIADB_SFORK = OFF;
+
+#define ZBX_MYSQL_STMT_CACHE_SIZE	8
+
+/* prepared statement, kept while the connection is open */
+typedef struct
+{
+	char		*sql;
+	MYSQL_STMT	*stmt;
+}
+zbx_mysql_stmt_t;
+
+static ZBX_THREAD_LOCAL zbx_mysql_stmt_t	mysql_stmts[ZBX_MYSQL_STMT_CACHE_SIZE];
+static ZBX_THREAD_LOCAL int			mysql_stmts_next = 0;
 #elif defined(HAVE_ORACLE)
 #include "zbxalgo.h"
 
@@ -99,7 +113,7 @@ static zbx_oracle_db_handle_t	oracle;
 static ub4	OCI_DBserver_status(void);
 
 #elif defined(HAVE_POSTGRESQL)
-static PGconn			*conn = NULL;
+static ZBX_THREAD_LOCAL PGconn	*conn = NULL;
 static unsigned int		ZBX_PG_BYTEAOID = 0;
 static int			ZBX_TSDB_VERSION = -1;
 static zbx_uint32_t		ZBX_PG_SVERSION = ZBX_DBVERSION_UNDEFINED;
@@ -297,9 +311,9 @@ static DB_RESULT	zbx_db_select(const char *fmt, ...)
 }
 
 #if defined(HAVE_MYSQL)
-static int	is_recoverable_mysql_error(void)
+static int	is_recoverable_mysql_errno(unsigned int err)
 {
-	switch (mysql_errno(conn))
+	switch (err)
 	{
 		case CR_CONN_HOST_ERROR:
 		case CR_SERVER_GONE_ERROR:
@@ -326,6 +340,22 @@ static int	is_recoverable_mysql_error(void)
 
 	return FAIL;
 }
+
+static int	is_recoverable_mysql_error(void)
+{
+	return is_recoverable_mysql_errno(mysql_errno(conn));
+}
+
+static void	mysql_statement_close(zbx_mysql_stmt_t *entry)
+{
+	if (NULL != entry->stmt)
+	{
+		mysql_stmt_close(entry->stmt);
+		entry->stmt = NULL;
+	}
+
+	zbx_free(entry->sql);
+}
 #elif defined(HAVE_POSTGRESQL)
 static int	is_recoverable_postgresql_error(const PGconn *pg_conn, const PGresult *pg_result)
 {
@@ -931,6 +961,11 @@ void	zbx_db_close(void)
 #if defined(HAVE_MYSQL)
 	if (NULL != conn)
 	{
+		int	i;
+
+		for (i = 0; i < ZBX_MYSQL_STMT_CACHE_SIZE; i++)
+			mysql_statement_close(&mysql_stmts[i]);
+
 		mysql_close(conn);
 		conn = NULL;
 	}
@@ -996,6 +1031,22 @@ void	zbx_db_close(void)
 #endif
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_thread_end                                                *
+ *                                                                            *
+ * Purpose: releases database client library resources of calling thread      *
+ *                                                                            *
+ * Comments: Must be called by additional threads after closing connection.   *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_db_thread_end(void)
+{
+#if defined(HAVE_MYSQL)
+	mysql_thread_end();
+#endif
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_begin                                                     *
@@ -1570,6 +1621,301 @@ clean:
 	return ret;
 }
 
+#if defined(HAVE_POSTGRESQL)
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_copy_binary                                               *
+ *                                                                            *
+ * Purpose: copy rows in PostgreSQL binary copy format into table             *
+ *                                                                            *
+ * Parameters: sql  - [IN] the copy from stdin statement                      *
+ *             data - [IN] the rows in binary copy format                     *
+ *             size - [IN] the data size                                      *
+ *                                                                            *
+ * Return value: ZBX_DB_FAIL (on error) or ZBX_DB_DOWN (on recoverable error) *
+ *               or number of rows copied (on success)                        *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_copy_binary(const char *sql, const char *data, size_t size)
+{
+	PGresult	*result;
+	char		*error = NULL;
+	int		ret = ZBX_DB_OK, rows = 0;
+	size_t		offset, len;
+	double		sec = 0;
+
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+		sec = zbx_time();
+
+	if (0 == txn_level)
+		zabbix_log(LOG_LEVEL_DEBUG, "query without transaction detected");
+
+	if (ZBX_DB_OK != txn_error)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "ignoring query [txnlev:%d] [%s] within failed transaction", txn_level, sql);
+		return ZBX_DB_FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "query [txnlev:%d] [%s] size:" ZBX_FS_SIZE_T, txn_level, sql,
+			(zbx_fs_size_t)size);
+
+	if (NULL == (result = PQexec(conn, sql)))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, "result is NULL", sql);
+		ret = (CONNECTION_OK == PQstatus(conn) ? ZBX_DB_FAIL : ZBX_DB_DOWN);
+		goto out;
+	}
+
+	if (PGRES_COPY_IN != PQresultStatus(result))
+	{
+		zbx_postgresql_error(&error, result);
+		zbx_db_errlog(ERR_Z3005, 0, error, sql);
+		zbx_free(error);
+
+		ret = (SUCCEED == is_recoverable_postgresql_error(conn, result) ? ZBX_DB_DOWN : ZBX_DB_FAIL);
+		PQclear(result);
+		goto out;
+	}
+
+	PQclear(result);
+
+	/* send data in limited size pieces as libpq accepts int sized buffers */
+	for (offset = 0; offset < size; offset += len)
+	{
+		len = MIN(size - offset, ZBX_MEBIBYTE);
+
+		if (1 != PQputCopyData(conn, data + offset, (int)len))
+			break;
+	}
+
+	if (offset < size || 1 != PQputCopyEnd(conn, NULL))
+	{
+		zbx_db_errlog(ERR_Z3005, 0, PQerrorMessage(conn), sql);
+		ret = (CONNECTION_OK == PQstatus(conn) ? ZBX_DB_FAIL : ZBX_DB_DOWN);
+	}
+
+	/* the copy result must be read even if sending data failed */
+	while (NULL != (result = PQgetResult(conn)))
+	{
+		if (ZBX_DB_OK == ret)
+		{
+			if (PGRES_COMMAND_OK != PQresultStatus(result))
+			{
+				zbx_postgresql_error(&error, result);
+				zbx_db_errlog(ERR_Z3005, 0, error, sql);
+				zbx_free(error);
+
+				ret = (SUCCEED == is_recoverable_postgresql_error(conn, result) ? ZBX_DB_DOWN :
+						ZBX_DB_FAIL);
+			}
+			else
+				rows += atoi(PQcmdTuples(result));
+		}
+
+		PQclear(result);
+	}
+out:
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+	{
+		sec = zbx_time() - sec;
+		if (sec > (double)CONFIG_LOG_SLOW_QUERIES / 1000.0)
+			zabbix_log(LOG_LEVEL_WARNING, "slow query: " ZBX_FS_DBL " sec, \"%s\"", sec, sql);
+	}
+
+	if (ZBX_DB_FAIL == ret && 0 < txn_level)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "query [%s] failed, setting transaction as failed", sql);
+		txn_error = ZBX_DB_FAIL;
+	}
+
+	return ZBX_DB_OK == ret ? rows : ret;
+}
+#endif
+
+#if defined(HAVE_MYSQL)
+/******************************************************************************
+ *                                                                            *
+ * Function: mysql_statement_get                                              *
+ *                                                                            *
+ * Purpose: gets prepared statement from cache or prepares a new one          *
+ *                                                                            *
+ * Parameters: sql - [IN] the statement to prepare                            *
+ *             err - [OUT] the error number on failure                        *
+ *                                                                            *
+ * Return value: the prepared statement or NULL on error                      *
+ *                                                                            *
+ * Comments: The least recently prepared statement is closed when the cache   *
+ *           is full. Statements are closed together with the connection.     *
+ *                                                                            *
+ ******************************************************************************/
+static MYSQL_STMT	*mysql_statement_get(const char *sql, unsigned int *err)
+{
+	int			i;
+	zbx_mysql_stmt_t	*entry;
+
+	for (i = 0; i < ZBX_MYSQL_STMT_CACHE_SIZE; i++)
+	{
+		if (NULL != mysql_stmts[i].sql && 0 == strcmp(mysql_stmts[i].sql, sql))
+			return mysql_stmts[i].stmt;
+	}
+
+	entry = &mysql_stmts[mysql_stmts_next];
+	mysql_stmts_next = (mysql_stmts_next + 1) % ZBX_MYSQL_STMT_CACHE_SIZE;
+
+	mysql_statement_close(entry);
+
+	if (NULL == (entry->stmt = mysql_stmt_init(conn)))
+	{
+		*err = mysql_errno(conn);
+		zbx_db_errlog(ERR_Z3005, *err, mysql_error(conn), sql);
+		return NULL;
+	}
+
+	if (0 != mysql_stmt_prepare(entry->stmt, sql, strlen(sql)))
+	{
+		*err = mysql_stmt_errno(entry->stmt);
+		zbx_db_errlog(ERR_Z3005, *err, mysql_stmt_error(entry->stmt), sql);
+		mysql_statement_close(entry);
+		return NULL;
+	}
+
+	entry->sql = zbx_strdup(NULL, sql);
+
+	return entry->stmt;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_execute_prepared                                          *
+ *                                                                            *
+ * Purpose: executes prepared statement with rows of bound parameters         *
+ *                                                                            *
+ * Parameters: sql        - [IN] the statement with fields_num * rows_num     *
+ *                               parameter markers                            *
+ *             types      - [IN] the parameter types (ZBX_TYPE_*) of row      *
+ *             fields_num - [IN] the number of parameters in row              *
+ *             rows       - [IN] the parameter values                         *
+ *             rows_num   - [IN] the number of rows                           *
+ *                                                                            *
+ * Return value: ZBX_DB_FAIL (on error) or ZBX_DB_DOWN (on recoverable error) *
+ *               or number of rows affected (on success)                      *
+ *                                                                            *
+ * Comments: Values are sent in binary protocol, so they are neither          *
+ *           formatted as text nor parsed by the database. Zero identifiers   *
+ *           are bound as null values.                                        *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_db_execute_prepared(const char *sql, const unsigned char *types, int fields_num, zbx_db_value_t **rows,
+		int rows_num)
+{
+	MYSQL_STMT	*stmt;
+	MYSQL_BIND	*binds;
+	int		i, j, ret = ZBX_DB_OK;
+	unsigned int	err;
+	double		sec = 0;
+
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+		sec = zbx_time();
+
+	if (0 == txn_level)
+		zabbix_log(LOG_LEVEL_DEBUG, "query without transaction detected");
+
+	if (ZBX_DB_OK != txn_error)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "ignoring query [txnlev:%d] [%s] within failed transaction", txn_level, sql);
+		return ZBX_DB_FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "query [txnlev:%d] [%s] rows:%d", txn_level, sql, rows_num);
+
+	if (NULL == conn)
+	{
+		zbx_db_errlog(ERR_Z3003, 0, NULL, NULL);
+		return ZBX_DB_FAIL;
+	}
+
+	if (NULL == (stmt = mysql_statement_get(sql, &err)))
+	{
+		ret = (SUCCEED == is_recoverable_mysql_errno(err) ? ZBX_DB_DOWN : ZBX_DB_FAIL);
+		goto out;
+	}
+
+	binds = (MYSQL_BIND *)zbx_malloc(NULL, sizeof(MYSQL_BIND) * (size_t)(fields_num * rows_num));
+	memset(binds, 0, sizeof(MYSQL_BIND) * (size_t)(fields_num * rows_num));
+
+	for (i = 0; i < rows_num; i++)
+	{
+		for (j = 0; j < fields_num; j++)
+		{
+			MYSQL_BIND	*bind = &binds[i * fields_num + j];
+			zbx_db_value_t	*value = &rows[i][j];
+
+			switch (types[j])
+			{
+				case ZBX_TYPE_CHAR:
+				case ZBX_TYPE_TEXT:
+				case ZBX_TYPE_SHORTTEXT:
+				case ZBX_TYPE_LONGTEXT:
+				case ZBX_TYPE_CUID:
+					bind->buffer_type = MYSQL_TYPE_STRING;
+					bind->buffer = value->str;
+					bind->buffer_length = strlen(value->str);
+					break;
+				case ZBX_TYPE_INT:
+					bind->buffer_type = MYSQL_TYPE_LONG;
+					bind->buffer = &value->i32;
+					break;
+				case ZBX_TYPE_FLOAT:
+					bind->buffer_type = MYSQL_TYPE_DOUBLE;
+					bind->buffer = &value->dbl;
+					break;
+				case ZBX_TYPE_ID:
+					if (0 == value->ui64)
+					{
+						bind->buffer_type = MYSQL_TYPE_NULL;
+						break;
+					}
+					ZBX_FALLTHROUGH;
+				case ZBX_TYPE_UINT:
+					bind->buffer_type = MYSQL_TYPE_LONGLONG;
+					bind->buffer = &value->ui64;
+					bind->is_unsigned = 1;
+					break;
+				default:
+					THIS_SHOULD_NEVER_HAPPEN;
+					exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (0 != mysql_stmt_bind_param(stmt, binds) || 0 != mysql_stmt_execute(stmt))
+	{
+		err = mysql_stmt_errno(stmt);
+		zbx_db_errlog(ERR_Z3005, err, mysql_stmt_error(stmt), sql);
+		ret = (SUCCEED == is_recoverable_mysql_errno(err) ? ZBX_DB_DOWN : ZBX_DB_FAIL);
+	}
+	else
+		ret = (int)mysql_stmt_affected_rows(stmt);
+
+	zbx_free(binds);
+out:
+	if (0 != CONFIG_LOG_SLOW_QUERIES)
+	{
+		sec = zbx_time() - sec;
+		if (sec > (double)CONFIG_LOG_SLOW_QUERIES / 1000.0)
+			zabbix_log(LOG_LEVEL_WARNING, "slow query: " ZBX_FS_DBL " sec, \"%s\"", sec, sql);
+	}
+
+	if (ZBX_DB_FAIL == ret && 0 < txn_level)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "query [%s] failed, setting transaction as failed", sql);
+		txn_error = ZBX_DB_FAIL;
+	}
+
+	return ret;
+}
+#endif
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_vselect                                                   *
@@ -39,21 +39,23 @@
 #include "daemon.h"
 #include "zbxavailability.h"
 #include "zbxtrends.h"
+#include "zbxproxybuf.h"
 #include "zbxalgo.h"
 #include "../zbxalgo/vectorimpl.h"
 
+/* history cache and history index memory of the currently locked history cache shard */
 static zbx_mem_info_t	*hc_index_mem = NULL;
 static zbx_mem_info_t	*hc_mem = NULL;
 static zbx_mem_info_t	*trend_mem = NULL;
 
-#define	LOCK_CACHE	zbx_mutex_lock(cache_lock)
-#define	UNLOCK_CACHE	zbx_mutex_unlock(cache_lock)
+/* the first history cache shard lock also protects the global history cache data */
+#define	LOCK_CACHE	hc_lock_shard(0)
+#define	UNLOCK_CACHE	hc_unlock_shard(0)
 #define	LOCK_TRENDS	zbx_mutex_lock(trends_lock)
 #define	UNLOCK_TRENDS	zbx_mutex_unlock(trends_lock)
 #define	LOCK_CACHE_IDS		zbx_mutex_lock(cache_ids_lock)
 #define	UNLOCK_CACHE_IDS	zbx_mutex_unlock(cache_ids_lock)
 
-static zbx_mutex_t	cache_lock = ZBX_MUTEX_NULL;
 static zbx_mutex_t	trends_lock = ZBX_MUTEX_NULL;
 static zbx_mutex_t	cache_ids_lock = ZBX_MUTEX_NULL;
 
@@ -63,12 +65,29 @@ static size_t		sql_alloc = 4 * ZBX_KIBIBYTE;
 extern unsigned char	program_type;
 extern int		CONFIG_DOUBLE_PRECISION;
 extern char		*CONFIG_EXPORT_DIR;
+extern int		CONFIG_HISTORY_PIPELINE;
 
 #define ZBX_IDS_SIZE	10
 
 #define ZBX_HC_ITEMS_INIT_SIZE	1000
 
-#define ZBX_TRENDS_CLEANUP_TIME	((SEC_PER_HOUR * 55) / 60)
+/* the time after hour end when trends of items without values in the new hour are closed */
+#define ZBX_TRENDS_CLEANUP_TIME	(SEC_PER_MIN * 5)
+
+/* the time after hour end by which closed trends are flushed, before hourly trend functions are calculated */
+#define ZBX_TRENDS_FLUSH_PERIOD	(SEC_PER_MIN * 10)
+
+/* closed trends are flushed right away when trend cache free memory drops below 1/N of its size */
+#define ZBX_TRENDS_QUEUE_MEMORY_MIN	8
+
+#if defined(HAVE_POSTGRESQL) || defined(HAVE_MYSQL)
+#	define ZBX_TRENDS_UPSERT
+#endif
+
+#if defined(HAVE_MYSQL)
+/* the first MySQL version supporting row alias in insert ... on duplicate key update statements */
+#	define ZBX_MYSQL_ROW_ALIAS_MIN_VERSION	80019
+#endif
 
 /* the maximum time spent synchronizing history */
 #define ZBX_HC_SYNC_TIME_MAX	10
@@ -115,17 +134,60 @@ typedef struct
 }
 zbx_hc_proxyqueue_t;
 
+/* history cache shard - the part of history cache containing items with itemid % shards number equal */
+/* to the shard index, protected by its own lock and stored in its own history (index) cache memory      */
 typedef struct
 {
-	zbx_hashset_t		trends;
-	ZBX_DC_STATS		stats;
-
 	zbx_hashset_t		history_items;
 	zbx_binary_heap_t	history_queue;
 
+	ZBX_DC_STATS		stats;
+	int			history_num;
+}
+zbx_hc_shard_t;
+
+/* process local history cache shard references */
+typedef struct
+{
+	zbx_mutex_t	lock;
+	zbx_mem_info_t	*data_mem;
+	zbx_mem_info_t	*index_mem;
+	zbx_hc_shard_t	*shard;
+}
+zbx_hc_shard_ref_t;
+
+static zbx_hc_shard_ref_t	hc_shards[ZBX_HC_SHARDS_MAX];
+
+/* the next shard to be synced by history syncer, process local */
+static int	hc_sync_shard = -1;
+
+/* history sync batch - values taken from history cache with their items and locked triggers, */
+/* with history pipeline the batch is kept until its values are written                      */
+typedef struct
+{
+	/* the history pipeline sequence number of the batch values, 0 if no values were queued */
+	zbx_uint64_t		seq;
+	int			shard_index;
 	int			history_num;
+	ZBX_DC_HISTORY		*history;
+	DC_ITEM			*items;
+	int			*errcodes;
+	zbx_vector_uint64_t	itemids;
+	zbx_vector_ptr_t	history_items;
+	zbx_vector_uint64_t	triggerids;
+}
+zbx_hc_sync_batch_t;
+
+typedef struct
+{
+	zbx_hashset_t		trends;
+	zbx_hashset_t		trends_closed;	/* trends of closed hours waiting to be flushed */
+
 	int			trends_num;
 	int			trends_last_cleanup_hour;
+	int			trends_lag_hour;
+	int			trends_flush_lag;
+	double			trends_flush_time;
 	int			history_num_total;
 	int			history_progress_ts;
 
@@ -180,12 +242,17 @@ static size_t		string_values_alloc = 0, string_values_offset = 0;
 static dc_item_value_t	*item_values = NULL;
 static size_t		item_values_alloc = 0, item_values_num = 0;
 
-static void	hc_add_item_values(dc_item_value_t *values, int values_num);
-static void	hc_pop_items(zbx_vector_ptr_t *history_items);
+static int	hc_get_shard_index(zbx_uint64_t itemid);
+static zbx_hc_shard_t	*hc_lock_shard(int index);
+static void	hc_unlock_shard(int index);
+static zbx_hc_shard_t	*hc_claim_shard(int *index);
+static int	hc_get_history_num(void);
+static int	hc_add_item_values(zbx_hc_shard_t *shard, dc_item_value_t *values, int values_num);
+static void	hc_pop_items(zbx_hc_shard_t *shard, zbx_vector_ptr_t *history_items);
 static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *history_items);
-static void	hc_push_items(zbx_vector_ptr_t *history_items);
+static void	hc_push_items(zbx_hc_shard_t *shard, zbx_vector_ptr_t *history_items);
 static void	hc_free_item_values(ZBX_DC_HISTORY *history, int history_num);
-static void	hc_queue_item(zbx_hc_item_t *item);
+static void	hc_queue_item(zbx_hc_shard_t *shard, zbx_hc_item_t *item);
 static int	hc_queue_elem_compare_func(const void *d1, const void *d2);
 static int	hc_queue_get_size(void);
 static int	hc_get_history_compression_age(void);
@@ -197,30 +264,78 @@ ZBX_PTR_VECTOR_IMPL(tags, zbx_tag_t*)
 
 /******************************************************************************
  *                                                                            *
- * Function: DCget_stats_all                                                  *
+ * Function: hc_get_shards_stats                                              *
  *                                                                            *
- * Purpose: retrieves all internal metrics of the database cache              *
+ * Purpose: sums internal metrics of the specified history cache shards       *
  *                                                                            *
- * Parameters: stats - [OUT] write cache metrics                              *
+ * Parameters: index       - [IN] the shard index or ZBX_HC_SHARD_ALL         *
+ *             wcache_info - [OUT] write cache metrics                        *
  *                                                                            *
  ******************************************************************************/
-void	DCget_stats_all(zbx_wcache_info_t *wcache_info)
+static void	hc_get_shards_stats(int index, zbx_wcache_info_t *wcache_info)
 {
-	LOCK_CACHE;
+	int	i, from, to;
+
+	memset(wcache_info, 0, sizeof(zbx_wcache_info_t));
+
+	if (ZBX_HC_SHARD_ALL == index)
+	{
+		from = 0;
+		to = CONFIG_HISTORY_CACHE_SHARDS;
+	}
+	else
+	{
+		from = index;
+		to = index + 1;
+	}
+
+	for (i = from; i < to; i++)
+	{
+		zbx_hc_shard_t	*shard;
 
-	wcache_info->stats = cache->stats;
-	wcache_info->history_free = hc_mem->free_size;
-	wcache_info->history_total = hc_mem->total_size;
-	wcache_info->index_free = hc_index_mem->free_size;
-	wcache_info->index_total = hc_index_mem->total_size;
+		shard = hc_lock_shard(i);
+
+		wcache_info->stats.history_counter += shard->stats.history_counter;
+		wcache_info->stats.history_float_counter += shard->stats.history_float_counter;
+		wcache_info->stats.history_uint_counter += shard->stats.history_uint_counter;
+		wcache_info->stats.history_str_counter += shard->stats.history_str_counter;
+		wcache_info->stats.history_log_counter += shard->stats.history_log_counter;
+		wcache_info->stats.history_text_counter += shard->stats.history_text_counter;
+		wcache_info->stats.notsupported_counter += shard->stats.notsupported_counter;
+
+		wcache_info->history_free += hc_mem->free_size;
+		wcache_info->history_total += hc_mem->total_size;
+		wcache_info->index_free += hc_index_mem->free_size;
+		wcache_info->index_total += hc_index_mem->total_size;
+
+		hc_unlock_shard(i);
+	}
 
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
 	{
+		LOCK_TRENDS;
+
 		wcache_info->trend_free = trend_mem->free_size;
 		wcache_info->trend_total = trend_mem->orig_size;
+		wcache_info->trend_queue = (zbx_uint64_t)cache->trends_closed.num_data;
+		wcache_info->trend_lag = (zbx_uint64_t)cache->trends_flush_lag;
+
+		UNLOCK_TRENDS;
 	}
+}
 
-	UNLOCK_CACHE;
+/******************************************************************************
+ *                                                                            *
+ * Function: DCget_stats_all                                                  *
+ *                                                                            *
+ * Purpose: retrieves all internal metrics of the database cache              *
+ *                                                                            *
+ * Parameters: stats - [OUT] write cache metrics                              *
+ *                                                                            *
+ ******************************************************************************/
+void	DCget_stats_all(zbx_wcache_info_t *wcache_info)
+{
+	hc_get_shards_stats(ZBX_HC_SHARD_ALL, wcache_info);
 }
 
 /******************************************************************************
@@ -233,111 +348,143 @@ void	DCget_stats_all(zbx_wcache_info_t *wcache_info)
  *                                                                            *
  ******************************************************************************/
 void	*DCget_stats(int request)
+{
+	return DCget_shard_stats(request, ZBX_HC_SHARD_ALL);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DCget_shard_stats                                                *
+ *                                                                            *
+ * Purpose: get statistics of the database cache for the specified history    *
+ *          cache shard                                                       *
+ *                                                                            *
+ * Parameters: request - [IN] the requested statistics (ZBX_STATS_*)          *
+ *             index   - [IN] the history cache shard index or                *
+ *                            ZBX_HC_SHARD_ALL to get statistics of all       *
+ *                            shards                                          *
+ *                                                                            *
+ * Return value: pointer to the requested value or NULL if the request or     *
+ *               shard index is not valid                                     *
+ *                                                                            *
+ ******************************************************************************/
+void	*DCget_shard_stats(int request, int index)
 {
 	static zbx_uint64_t	value_uint;
 	static double		value_double;
 	void			*ret;
+	zbx_wcache_info_t	wcache_info;
 
-	LOCK_CACHE;
+	if (ZBX_HC_SHARD_ALL != index && (0 > index || CONFIG_HISTORY_CACHE_SHARDS <= index))
+		return NULL;
+
+	hc_get_shards_stats(index, &wcache_info);
 
 	switch (request)
 	{
 		case ZBX_STATS_HISTORY_COUNTER:
-			value_uint = cache->stats.history_counter;
+			value_uint = wcache_info.stats.history_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_FLOAT_COUNTER:
-			value_uint = cache->stats.history_float_counter;
+			value_uint = wcache_info.stats.history_float_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_UINT_COUNTER:
-			value_uint = cache->stats.history_uint_counter;
+			value_uint = wcache_info.stats.history_uint_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_STR_COUNTER:
-			value_uint = cache->stats.history_str_counter;
+			value_uint = wcache_info.stats.history_str_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_LOG_COUNTER:
-			value_uint = cache->stats.history_log_counter;
+			value_uint = wcache_info.stats.history_log_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_TEXT_COUNTER:
-			value_uint = cache->stats.history_text_counter;
+			value_uint = wcache_info.stats.history_text_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_NOTSUPPORTED_COUNTER:
-			value_uint = cache->stats.notsupported_counter;
+			value_uint = wcache_info.stats.notsupported_counter;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_TOTAL:
-			value_uint = hc_mem->total_size;
+			value_uint = wcache_info.history_total;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_USED:
-			value_uint = hc_mem->total_size - hc_mem->free_size;
+			value_uint = wcache_info.history_total - wcache_info.history_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_FREE:
-			value_uint = hc_mem->free_size;
+			value_uint = wcache_info.history_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_PUSED:
-			value_double = 100 * (double)(hc_mem->total_size - hc_mem->free_size) / hc_mem->total_size;
+			value_double = 100 * (double)(wcache_info.history_total - wcache_info.history_free) /
+					wcache_info.history_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_HISTORY_PFREE:
-			value_double = 100 * (double)hc_mem->free_size / hc_mem->total_size;
+			value_double = 100 * (double)wcache_info.history_free / wcache_info.history_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_TREND_TOTAL:
-			value_uint = trend_mem->orig_size;
+			value_uint = wcache_info.trend_total;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_TREND_USED:
-			value_uint = trend_mem->orig_size - trend_mem->free_size;
+			value_uint = wcache_info.trend_total - wcache_info.trend_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_TREND_FREE:
-			value_uint = trend_mem->free_size;
+			value_uint = wcache_info.trend_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_TREND_PUSED:
-			value_double = 100 * (double)(trend_mem->orig_size - trend_mem->free_size) /
-					trend_mem->orig_size;
+			value_double = 100 * (double)(wcache_info.trend_total - wcache_info.trend_free) /
+					wcache_info.trend_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_TREND_PFREE:
-			value_double = 100 * (double)trend_mem->free_size / trend_mem->orig_size;
+			value_double = 100 * (double)wcache_info.trend_free / wcache_info.trend_total;
 			ret = (void *)&value_double;
 			break;
+		case ZBX_STATS_TREND_QUEUE:
+			value_uint = wcache_info.trend_queue;
+			ret = (void *)&value_uint;
+			break;
+		case ZBX_STATS_TREND_LAG:
+			value_uint = wcache_info.trend_lag;
+			ret = (void *)&value_uint;
+			break;
 		case ZBX_STATS_HISTORY_INDEX_TOTAL:
-			value_uint = hc_index_mem->total_size;
+			value_uint = wcache_info.index_total;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_USED:
-			value_uint = hc_index_mem->total_size - hc_index_mem->free_size;
+			value_uint = wcache_info.index_total - wcache_info.index_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_FREE:
-			value_uint = hc_index_mem->free_size;
+			value_uint = wcache_info.index_free;
 			ret = (void *)&value_uint;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_PUSED:
-			value_double = 100 * (double)(hc_index_mem->total_size - hc_index_mem->free_size) /
-					hc_index_mem->total_size;
+			value_double = 100 * (double)(wcache_info.index_total - wcache_info.index_free) /
+					wcache_info.index_total;
 			ret = (void *)&value_double;
 			break;
 		case ZBX_STATS_HISTORY_INDEX_PFREE:
-			value_double = 100 * (double)hc_index_mem->free_size / hc_index_mem->total_size;
+			value_double = 100 * (double)wcache_info.index_free / wcache_info.index_total;
 			ret = (void *)&value_double;
 			break;
 		default:
 			ret = NULL;
 	}
 
-	UNLOCK_CACHE;
-
 	return ret;
 }
 
@@ -393,6 +540,41 @@ static void	DCupdate_trends(zbx_vector_uint64_pair_t *trends_diff)
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trend_merge                                                   *
+ *                                                                            *
+ * Purpose: merge trend of the same item hour into another trend              *
+ *                                                                            *
+ * Parameters: dst - [IN/OUT] the trend to merge into                         *
+ *             src - [IN] the trend to merge                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_trend_merge(ZBX_DC_TREND *dst, const ZBX_DC_TREND *src)
+{
+	switch (dst->value_type)
+	{
+		case ITEM_VALUE_TYPE_FLOAT:
+			if (src->value_min.dbl < dst->value_min.dbl)
+				dst->value_min.dbl = src->value_min.dbl;
+			if (src->value_max.dbl > dst->value_max.dbl)
+				dst->value_max.dbl = src->value_max.dbl;
+			dst->value_avg.dbl = dst->value_avg.dbl / (dst->num + src->num) * dst->num +
+					src->value_avg.dbl / (dst->num + src->num) * src->num;
+			break;
+		case ITEM_VALUE_TYPE_UINT64:
+			if (src->value_min.ui64 < dst->value_min.ui64)
+				dst->value_min.ui64 = src->value_min.ui64;
+			if (src->value_max.ui64 > dst->value_max.ui64)
+				dst->value_max.ui64 = src->value_max.ui64;
+			uinc128_128(&dst->value_avg.ui64, &src->value_avg.ui64);
+			break;
+	}
+
+	dst->num += src->num;
+}
+
+#if !defined(ZBX_TRENDS_UPSERT)
 /******************************************************************************
  *                                                                            *
  * Function: dc_insert_trends_in_db                                           *
@@ -790,6 +972,169 @@ static void	DBflush_trends(ZBX_DC_TREND *trends, int *trends_num, zbx_vector_uin
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
+#else
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trends_upsert_execute                                         *
+ *                                                                            *
+ * Purpose: finish trends insert statement with merging of existing records   *
+ *          and execute it                                                    *
+ *                                                                            *
+ * Parameters: sql_offset - [IN/OUT] the statement length                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_trends_upsert_execute(size_t *sql_offset)
+{
+#if defined(HAVE_POSTGRESQL)
+	zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset,
+			" on conflict (itemid,clock) do update set"
+			" num=t.num+excluded.num,"
+			"value_min=least(t.value_min,excluded.value_min),"
+			"value_max=greatest(t.value_max,excluded.value_max),"
+			"value_avg=t.value_avg/(t.num+excluded.num)*t.num+"
+				"excluded.value_avg/(t.num+excluded.num)*excluded.num");
+#else
+	/* the assignments are done from left to right, so num must be updated last */
+	if (ON != zbx_dbms_mariadb_used() && ZBX_MYSQL_ROW_ALIAS_MIN_VERSION <= zbx_dbms_version_get())
+	{
+		zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset,
+				" as new on duplicate key update"
+				" value_min=least(value_min,new.value_min),"
+				"value_max=greatest(value_max,new.value_max),"
+				"value_avg=value_avg/(num+new.num)*num+new.value_avg/(num+new.num)*new.num,"
+				"num=num+new.num");
+	}
+	else
+	{
+		/* VALUES() is deprecated since MySQL 8.0.20, older versions and MariaDB do not support row aliases */
+		zbx_strcpy_alloc(&sql, &sql_alloc, sql_offset,
+				" on duplicate key update"
+				" value_min=least(value_min,values(value_min)),"
+				"value_max=greatest(value_max,values(value_max)),"
+				"value_avg=value_avg/(num+values(num))*num+values(value_avg)/(num+values(num))*values(num),"
+				"num=num+values(num)");
+	}
+#endif
+	DBexecute("%s", sql);
+	*sql_offset = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trends_upsert                                                 *
+ *                                                                            *
+ * Purpose: insert trends of the specified value type, merging them with      *
+ *          the existing records of the same hour                             *
+ *                                                                            *
+ * Parameters: trends     - [IN] the trends to flush                          *
+ *             trends_num - [IN] the number of trends                         *
+ *             value_type - [IN] the value type of trends to flush            *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_trends_upsert(const ZBX_DC_TREND *trends, int trends_num, unsigned char value_type)
+{
+	int		i, rows_num = 0;
+	size_t		sql_offset = 0;
+	const char	*table_name;
+
+	table_name = (ITEM_VALUE_TYPE_FLOAT == value_type ? "trends" : "trends_uint");
+
+	for (i = 0; i < trends_num; i++)
+	{
+		const ZBX_DC_TREND	*trend = &trends[i];
+
+		if (value_type != trend->value_type)
+			continue;
+
+		if (0 == rows_num)
+		{
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "insert into %s"
+#if defined(HAVE_POSTGRESQL)
+					" as t"
+#endif
+					" (itemid,clock,num,value_min,value_avg,value_max) values ", table_name);
+		}
+		else
+			zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ',');
+
+		if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		{
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "(" ZBX_FS_UI64 ",%d,%d," ZBX_FS_DBL64_SQL
+					"," ZBX_FS_DBL64_SQL "," ZBX_FS_DBL64_SQL ")", trend->itemid, trend->clock,
+					trend->num, trend->value_min.dbl, trend->value_avg.dbl, trend->value_max.dbl);
+		}
+		else
+		{
+			zbx_uint128_t	avg;
+
+			/* calculate the trend average value */
+			udiv128_64(&avg, &trend->value_avg.ui64, trend->num);
+
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "(" ZBX_FS_UI64 ",%d,%d," ZBX_FS_UI64 ","
+					ZBX_FS_UI64 "," ZBX_FS_UI64 ")", trend->itemid, trend->clock, trend->num,
+					trend->value_min.ui64, avg.lo, trend->value_max.ui64);
+		}
+
+		if (ZBX_HC_SYNC_MAX == ++rows_num)
+		{
+			dc_trends_upsert_execute(&sql_offset);
+			rows_num = 0;
+		}
+	}
+
+	if (0 != rows_num)
+		dc_trends_upsert_execute(&sql_offset);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DBflush_trends                                                   *
+ *                                                                            *
+ * Purpose: flush trends to the database                                      *
+ *                                                                            *
+ * Parameters: trends      - [IN] the trends sorted by itemid, clock and      *
+ *                                value type                                  *
+ *             trends_num  - [IN/OUT] the number of trends, set to 0 after    *
+ *                                    all trends are flushed                  *
+ *             trends_diff - [OUT] disable_from updates, not used             *
+ *                                                                            *
+ * Comments: Trends are inserted with upserts, merging them with the existing *
+ *           records instead of selecting and updating the existing records.  *
+ *           Trends of the same item hour are merged beforehand because the   *
+ *           same record cannot be updated twice by one statement.            *
+ *                                                                            *
+ ******************************************************************************/
+static void	DBflush_trends(ZBX_DC_TREND *trends, int *trends_num, zbx_vector_uint64_pair_t *trends_diff)
+{
+	int	i, num = 0;
+
+	ZBX_UNUSED(trends_diff);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() trends_num:%d", __func__, *trends_num);
+
+	for (i = 0; i < *trends_num; i++)
+	{
+		if (0 != num && trends[num - 1].itemid == trends[i].itemid && trends[num - 1].clock == trends[i].clock
+				&& trends[num - 1].value_type == trends[i].value_type)
+		{
+			dc_trend_merge(&trends[num - 1], &trends[i]);
+			continue;
+		}
+
+		if (num != i)
+			memcpy(&trends[num], &trends[i], sizeof(ZBX_DC_TREND));
+
+		num++;
+	}
+
+	dc_trends_upsert(trends, num, ITEM_VALUE_TYPE_FLOAT);
+	dc_trends_upsert(trends, num, ITEM_VALUE_TYPE_UINT64);
+
+	*trends_num = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() trends_num:%d", __func__, num);
+}
+#endif
 
 /******************************************************************************
  *                                                                            *
@@ -818,6 +1163,99 @@ static void	DCflush_trend(ZBX_DC_TREND *trend, ZBX_DC_TREND **trends, int *trend
 	memset(&trend->value_max, 0, sizeof(history_value_t));
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trend_close                                                   *
+ *                                                                            *
+ * Purpose: move trend of closed hour to the queue of trends waiting to be    *
+ *          flushed                                                           *
+ *                                                                            *
+ * Parameters: trend        - [IN/OUT] the trend to close                     *
+ *             trends       - [OUT] the trends for flushing to database       *
+ *             trends_alloc - [IN/OUT]                                        *
+ *             trends_num   - [IN/OUT]                                        *
+ *                                                                            *
+ * Comments: The trend is moved to the array of trends for flushing right     *
+ *           away if trend cache is running out of memory.                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_trend_close(ZBX_DC_TREND *trend, ZBX_DC_TREND **trends, int *trends_alloc, int *trends_num)
+{
+	ZBX_DC_TREND	*closed;
+
+	if (trend_mem->free_size < trend_mem->orig_size / ZBX_TRENDS_QUEUE_MEMORY_MIN)
+	{
+		DCflush_trend(trend, trends, trends_alloc, trends_num);
+		return;
+	}
+
+	if (NULL != (closed = (ZBX_DC_TREND *)zbx_hashset_search(&cache->trends_closed, trend)))
+		dc_trend_merge(closed, trend);
+	else
+		zbx_hashset_insert(&cache->trends_closed, trend, sizeof(ZBX_DC_TREND));
+
+	trend->clock = 0;
+	trend->num = 0;
+	memset(&trend->value_min, 0, sizeof(history_value_t));
+	memset(&trend->value_avg, 0, sizeof(value_avg_t));
+	memset(&trend->value_max, 0, sizeof(history_value_t));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dc_trends_pop_closed                                             *
+ *                                                                            *
+ * Purpose: take part of closed trends for flushing, spreading the flush of   *
+ *          closed hour trends over the flush period                          *
+ *                                                                            *
+ * Parameters: trends       - [OUT] the trends for flushing to database       *
+ *             trends_alloc - [IN/OUT]                                        *
+ *             trends_num   - [IN/OUT]                                        *
+ *             now          - [IN] the current time                           *
+ *             hour         - [IN] the current hour start time                *
+ *                                                                            *
+ * Comments: The number of trends taken is proportional to the time passed    *
+ *           since the last call, so that all closed trends are flushed by    *
+ *           the end of flush period. Trends closed after the flush period    *
+ *           are flushed right away.                                          *
+ *                                                                            *
+ ******************************************************************************/
+static void	dc_trends_pop_closed(ZBX_DC_TREND **trends, int *trends_alloc, int *trends_num, double now, int hour)
+{
+	zbx_hashset_iter_t	iter;
+	ZBX_DC_TREND		*trend;
+	double			elapsed, remaining;
+	int			num;
+
+	elapsed = now - cache->trends_flush_time;
+	remaining = hour + ZBX_TRENDS_FLUSH_PERIOD - now;
+	cache->trends_flush_time = now;
+
+	if (0 != cache->trends_closed.num_data)
+	{
+		if (elapsed >= remaining)
+			num = cache->trends_closed.num_data;
+		else
+			num = (int)(cache->trends_closed.num_data * elapsed / remaining) + 1;
+
+		zbx_hashset_iter_reset(&cache->trends_closed, &iter);
+
+		while (0 < num-- && NULL != (trend = (ZBX_DC_TREND *)zbx_hashset_iter_next(&iter)))
+		{
+			DCflush_trend(trend, trends, trends_alloc, trends_num);
+			zbx_hashset_iter_remove(&iter);
+		}
+	}
+
+	/* all trends of the previous hour are closed after cleanup and flushed when the queue is empty */
+	if (0 == cache->trends_closed.num_data && cache->trends_last_cleanup_hour == hour &&
+			cache->trends_lag_hour != hour)
+	{
+		cache->trends_flush_lag = (int)now - hour;
+		cache->trends_lag_hour = hour;
+	}
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DCadd_trend                                                      *
@@ -839,7 +1277,7 @@ static void	DCadd_trend(const ZBX_DC_HISTORY *history, ZBX_DC_TREND **trends, in
 	if (trend->num > 0 && (trend->clock != hour || trend->value_type != history->value_type) &&
 			SUCCEED == zbx_history_requires_trends(trend->value_type))
 	{
-		DCflush_trend(trend, trends, trends_alloc, trends_num);
+		dc_trend_close(trend, trends, trends_alloc, trends_num);
 	}
 
 	trend->value_type = history->value_type;
@@ -872,6 +1310,10 @@ static void	DCadd_trend(const ZBX_DC_HISTORY *history, ZBX_DC_TREND **trends, in
  *                                                                            *
  * Purpose: update trends cache and get list of trends to flush into database *
  *                                                                            *
+ * Comments: Trends of closed hours are queued in trend cache and flushed in  *
+ *           parts with every history synchronization batch to spread the     *
+ *           database load instead of flushing all trends at the hour start.  *
+ *                                                                            *
  * Parameters: history         - [IN]  array of history data                  *
  *             history_num     - [IN]  number of history structures           *
  *             trends          - [OUT] list of trends to flush into database  *
@@ -929,7 +1371,7 @@ static void	DCmass_update_trends(const ZBX_DC_HISTORY *history, int history_num,
 				}
 			}
 			else if (SUCCEED == zbx_history_requires_trends(trend->value_type))
-				DCflush_trend(trend, trends, &trends_alloc, trends_num);
+				dc_trend_close(trend, trends, &trends_alloc, trends_num);
 
 			zbx_hashset_iter_remove(&iter);
 		}
@@ -937,6 +1379,8 @@ static void	DCmass_update_trends(const ZBX_DC_HISTORY *history, int history_num,
 		cache->trends_last_cleanup_hour = hour;
 	}
 
+	dc_trends_pop_closed(trends, &trends_alloc, trends_num, ts.sec + ts.ns / 1e9, hour);
+
 	UNLOCK_TRENDS;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
@@ -949,6 +1393,7 @@ static int	zbx_trend_compare(const void *d1, const void *d2)
 
 	ZBX_RETURN_IF_NOT_EQUAL(p1->itemid, p2->itemid);
 	ZBX_RETURN_IF_NOT_EQUAL(p1->clock, p2->clock);
+	ZBX_RETURN_IF_NOT_EQUAL(p1->value_type, p2->value_type);
 
 	return 0;
 }
@@ -1580,6 +2025,14 @@ static void	DCsync_trends(void)
 			DCflush_trend(trend, &trends, &trends_alloc, &trends_num);
 	}
 
+	zbx_hashset_iter_reset(&cache->trends_closed, &iter);
+
+	while (NULL != (trend = (ZBX_DC_TREND *)zbx_hashset_iter_next(&iter)))
+	{
+		DCflush_trend(trend, &trends, &trends_alloc, &trends_num);
+		zbx_hashset_iter_remove(&iter);
+	}
+
 	UNLOCK_TRENDS;
 
 	if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_TRENDS) && 0 != trends_num)
@@ -2481,42 +2934,192 @@ static void	dc_add_proxy_history_notsupported(ZBX_DC_HISTORY *history, int histo
 	zbx_db_insert_clean(&db_insert);
 }
 
+static void	DBmass_proxy_add_history(ZBX_DC_HISTORY *history, int history_num);
+
 /******************************************************************************
  *                                                                            *
- * Function: DCmass_proxy_add_history                                         *
+ * Function: dc_add_proxy_history_buffer                                      *
  *                                                                            *
- * Purpose: inserting new history data after new value is received            *
+ * Purpose: appends history data to proxy memory buffer or proxy history      *
+ *          buffer, falling back to proxy_history table when memory buffer    *
+ *          does not accept the data and history buffer is not used           *
  *                                                                            *
  * Parameters: history     - array of history data                            *
  *             history_num - number of history structures                     *
  *                                                                            *
- * Author: Alexander Vladishev                                                *
+ * Return value: ZBX_DB_OK   - the history data was written                   *
+ *               ZBX_DB_FAIL - otherwise                                      *
+ *                                                                            *
+ * Comments: records are stored with the same fields and flags as in          *
+ *           proxy_history table, see dc_add_proxy_history*() functions       *
  *                                                                            *
  ******************************************************************************/
-static void	DBmass_proxy_add_history(ZBX_DC_HISTORY *history, int history_num)
+static int	dc_add_proxy_history_buffer(ZBX_DC_HISTORY *history, int history_num)
 {
-	int	i, h_num = 0, h_meta_num = 0, hlog_num = 0, notsupported_num = 0;
+	int			i, records_num = 0, ret = ZBX_DB_OK;
+	zbx_pb_history_t	*records, *r;
+	char			(*numbers)[64], *error = NULL;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
+	records = (zbx_pb_history_t *)zbx_malloc(NULL, sizeof(zbx_pb_history_t) * history_num);
+	numbers = (char (*)[64])zbx_malloc(NULL, sizeof(*numbers) * history_num);
+
 	for (i = 0; i < history_num; i++)
 	{
 		const ZBX_DC_HISTORY	*h = &history[i];
 
+		r = &records[records_num];
+		memset(r, 0, sizeof(zbx_pb_history_t));
+		r->itemid = h->itemid;
+		r->clock = h->ts.sec;
+		r->ns = h->ts.ns;
+		r->source = "";
+		r->value = "";
+
 		if (ITEM_STATE_NOTSUPPORTED == h->state)
 		{
-			notsupported_num++;
+			r->value = ZBX_NULL2EMPTY_STR(h->value.err);
+			r->state = h->state;
+			records_num++;
 			continue;
 		}
 
-		switch (h->value_type)
+		if (ITEM_VALUE_TYPE_LOG == h->value_type)
 		{
-			case ITEM_VALUE_TYPE_LOG:
-				hlog_num++;
-				break;
-			case ITEM_VALUE_TYPE_FLOAT:
-			case ITEM_VALUE_TYPE_UINT64:
-			case ITEM_VALUE_TYPE_STR:
+			if (0 == (h->flags & ZBX_DC_FLAG_NOVALUE))
+			{
+				const zbx_log_value_t	*log = h->value.log;
+
+				r->timestamp = log->timestamp;
+				r->source = ZBX_NULL2EMPTY_STR(log->source);
+				r->severity = log->severity;
+				r->value = log->value;
+				r->logeventid = log->logeventid;
+
+				if (0 != (h->flags & ZBX_DC_FLAG_META))
+				{
+					r->flags = PROXY_HISTORY_FLAG_META;
+					r->lastlogsize = h->lastlogsize;
+					r->mtime = h->mtime;
+				}
+			}
+			else
+			{
+				r->flags = PROXY_HISTORY_FLAG_META | PROXY_HISTORY_FLAG_NOVALUE;
+				r->lastlogsize = h->lastlogsize;
+				r->mtime = h->mtime;
+			}
+
+			records_num++;
+			continue;
+		}
+
+		if (0 != (h->flags & ZBX_DC_FLAG_UNDEF))
+			continue;
+
+		if (0 != (h->flags & ZBX_DC_FLAG_META))
+		{
+			r->flags = PROXY_HISTORY_FLAG_META;
+			r->lastlogsize = h->lastlogsize;
+			r->mtime = h->mtime;
+		}
+
+		if (0 == (h->flags & ZBX_DC_FLAG_NOVALUE))
+		{
+			switch (h->value_type)
+			{
+				case ITEM_VALUE_TYPE_FLOAT:
+					zbx_snprintf(numbers[i], sizeof(numbers[i]), ZBX_FS_DBL64, h->value.dbl);
+					r->value = numbers[i];
+					break;
+				case ITEM_VALUE_TYPE_UINT64:
+					zbx_snprintf(numbers[i], sizeof(numbers[i]), ZBX_FS_UI64, h->value.ui64);
+					r->value = numbers[i];
+					break;
+				case ITEM_VALUE_TYPE_STR:
+				case ITEM_VALUE_TYPE_TEXT:
+					r->value = h->value.str;
+					break;
+				default:
+					THIS_SHOULD_NEVER_HAPPEN;
+					continue;
+			}
+		}
+		else
+			r->flags |= PROXY_HISTORY_FLAG_NOVALUE;
+
+		records_num++;
+	}
+
+	if (0 != records_num && SUCCEED != zbx_pmb_history_write(records, records_num))
+	{
+		if (SUCCEED == zbx_pb_history_enabled())
+		{
+			if (SUCCEED != zbx_pb_history_write(records, records_num, &error))
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "cannot write proxy history buffer: %s", error);
+				zbx_free(error);
+				ret = ZBX_DB_FAIL;
+			}
+		}
+		else
+		{
+			do
+			{
+				DBbegin();
+				DBmass_proxy_add_history(history, history_num);
+			}
+			while (ZBX_DB_DOWN == (ret = DBcommit()));
+		}
+
+		zbx_pmb_db_release();
+	}
+
+	zbx_free(numbers);
+	zbx_free(records);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%d records:%d", __func__, ret, records_num);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DBmass_proxy_add_history                                         *
+ *                                                                            *
+ * Purpose: inserting new history data after new value is received            *
+ *                                                                            *
+ * Parameters: history     - array of history data                            *
+ *             history_num - number of history structures                     *
+ *                                                                            *
+ * Author: Alexander Vladishev                                                *
+ *                                                                            *
+ ******************************************************************************/
+static void	DBmass_proxy_add_history(ZBX_DC_HISTORY *history, int history_num)
+{
+	int	i, h_num = 0, h_meta_num = 0, hlog_num = 0, notsupported_num = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	for (i = 0; i < history_num; i++)
+	{
+		const ZBX_DC_HISTORY	*h = &history[i];
+
+		if (ITEM_STATE_NOTSUPPORTED == h->state)
+		{
+			notsupported_num++;
+			continue;
+		}
+
+		switch (h->value_type)
+		{
+			case ITEM_VALUE_TYPE_LOG:
+				hlog_num++;
+				break;
+			case ITEM_VALUE_TYPE_FLOAT:
+			case ITEM_VALUE_TYPE_UINT64:
+			case ITEM_VALUE_TYPE_STR:
 			case ITEM_VALUE_TYPE_TEXT:
 				if (0 != (h->flags & ZBX_DC_FLAG_META))
 					h_meta_num++;
@@ -2550,9 +3153,7 @@ static void	DBmass_proxy_add_history(ZBX_DC_HISTORY *history, int history_num)
  *                                                                            *
  * Function: DCmass_prepare_history                                           *
  *                                                                            *
- * Purpose: prepare history data using items from configuration cache and     *
- *          generate item changes to be applied and host inventory values to  *
- *          be added                                                          *
+ * Purpose: prepare history data using items from configuration cache         *
  *                                                                            *
  * Parameters: history             - [IN/OUT] array of history data           *
  *             itemids             - [IN] the item identifiers                *
@@ -2560,15 +3161,16 @@ static void	DBmass_proxy_add_history(ZBX_DC_HISTORY *history, int history_num)
  *             items               - [IN] the items                           *
  *             errcodes            - [IN] item error codes                    *
  *             history_num         - [IN] number of history structures        *
- *             item_diff           - [OUT] the changes in item data           *
- *             inventory_values    - [OUT] the inventory values to add        *
  *             compression_age     - [IN] history compression age             *
  *             proxy_subscribtions - [IN] history compression age             *
  *                                                                            *
+ * Comments: Values without active item are marked with ZBX_DC_FLAG_NOITEM    *
+ *           flag and skipped by DCmass_prepare_item_updates().               *
+ *                                                                            *
  ******************************************************************************/
 static void	DCmass_prepare_history(ZBX_DC_HISTORY *history, const zbx_vector_uint64_t *itemids,
-		const DC_ITEM *items, const int *errcodes, int history_num, zbx_vector_ptr_t *item_diff,
-		zbx_vector_ptr_t *inventory_values, int compression_age, zbx_vector_uint64_pair_t *proxy_subscribtions)
+		const DC_ITEM *items, const int *errcodes, int history_num, int compression_age,
+		zbx_vector_uint64_pair_t *proxy_subscribtions)
 {
 	static time_t	last_history_discard = 0;
 	time_t		now;
@@ -2582,7 +3184,6 @@ static void	DCmass_prepare_history(ZBX_DC_HISTORY *history, const zbx_vector_uin
 	{
 		ZBX_DC_HISTORY	*h = &history[i];
 		const DC_ITEM	*item;
-		zbx_item_diff_t	*diff;
 		int		index;
 
 		/* discard history items that are older than compression age */
@@ -2595,20 +3196,20 @@ static void	DCmass_prepare_history(ZBX_DC_HISTORY *history, const zbx_vector_uin
 				last_history_discard = now;
 			}
 
-			h->flags |= ZBX_DC_FLAG_UNDEF;
+			h->flags |= ZBX_DC_FLAG_UNDEF | ZBX_DC_FLAG_NOITEM;
 			continue;
 		}
 
 		if (FAIL == (index = zbx_vector_uint64_bsearch(itemids, h->itemid, ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
 		{
 			THIS_SHOULD_NEVER_HAPPEN;
-			h->flags |= ZBX_DC_FLAG_UNDEF;
+			h->flags |= ZBX_DC_FLAG_UNDEF | ZBX_DC_FLAG_NOITEM;
 			continue;
 		}
 
 		if (SUCCEED != errcodes[index])
 		{
-			h->flags |= ZBX_DC_FLAG_UNDEF;
+			h->flags |= ZBX_DC_FLAG_UNDEF | ZBX_DC_FLAG_NOITEM;
 			continue;
 		}
 
@@ -2616,7 +3217,7 @@ static void	DCmass_prepare_history(ZBX_DC_HISTORY *history, const zbx_vector_uin
 
 		if (ITEM_STATUS_ACTIVE != item->status || HOST_STATUS_MONITORED != item->host.status)
 		{
-			h->flags |= ZBX_DC_FLAG_UNDEF;
+			h->flags |= ZBX_DC_FLAG_UNDEF | ZBX_DC_FLAG_NOITEM;
 			continue;
 		}
 
@@ -2651,11 +3252,6 @@ static void	DCmass_prepare_history(ZBX_DC_HISTORY *history, const zbx_vector_uin
 
 		normalize_item_value(item, h);
 
-		if (NULL != (diff = calculate_item_update(item, h)))
-			zbx_vector_ptr_append(item_diff, diff);
-
-		DCinventory_value_add(inventory_values, item, h);
-
 		if (0 != item->host.proxy_hostid && FAIL == is_item_processed_by_server(item->type, item->key_orig))
 		{
 			zbx_uint64_pair_t	p = {item->host.proxy_hostid, h->ts.sec};
@@ -2664,6 +3260,54 @@ static void	DCmass_prepare_history(ZBX_DC_HISTORY *history, const zbx_vector_uin
 		}
 	}
 
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: DCmass_prepare_item_updates                                      *
+ *                                                                            *
+ * Purpose: generate item changes to be applied and host inventory values to  *
+ *          be added for history data prepared by DCmass_prepare_history()    *
+ *                                                                            *
+ * Parameters: history          - [IN] array of history data                  *
+ *             itemids          - [IN] the item identifiers                   *
+ *                                     (used for item lookup)                 *
+ *             items            - [IN] the items                              *
+ *             history_num      - [IN] number of history structures           *
+ *             item_diff        - [OUT] the changes in item data              *
+ *             inventory_values - [OUT] the inventory values to add           *
+ *                                                                            *
+ * Comments: Generates internal events when item state switches, so it must   *
+ *           be called right before the item changes are saved.               *
+ *                                                                            *
+ ******************************************************************************/
+static void	DCmass_prepare_item_updates(ZBX_DC_HISTORY *history, const zbx_vector_uint64_t *itemids,
+		const DC_ITEM *items, int history_num, zbx_vector_ptr_t *item_diff, zbx_vector_ptr_t *inventory_values)
+{
+	int	i;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, history_num);
+
+	for (i = 0; i < history_num; i++)
+	{
+		ZBX_DC_HISTORY	*h = &history[i];
+		const DC_ITEM	*item;
+		zbx_item_diff_t	*diff;
+		int		index;
+
+		if (0 != (ZBX_DC_FLAG_NOITEM & h->flags))
+			continue;
+
+		index = zbx_vector_uint64_bsearch(itemids, h->itemid, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+		item = &items[index];
+
+		if (NULL != (diff = calculate_item_update(item, h)))
+			zbx_vector_ptr_append(item_diff, diff);
+
+		DCinventory_value_add(inventory_values, item, h);
+	}
+
 	zbx_vector_ptr_sort(inventory_values, ZBX_DEFAULT_UINT64_PTR_COMPARE_FUNC);
 	zbx_vector_ptr_sort(item_diff, ZBX_DEFAULT_UINT64_PTR_COMPARE_FUNC);
 
@@ -2923,7 +3567,8 @@ static void	proxy_prepare_history(ZBX_DC_HISTORY *history, int history_num)
 
 static void	sync_proxy_history(int *total_num, int *more)
 {
-	int			history_num, txn_rc;
+	int			history_num, txn_rc, shard_index;
+	zbx_hc_shard_t		*shard;
 	time_t			sync_start;
 	zbx_vector_ptr_t	history_items;
 	zbx_vector_ptr_t	item_diff;
@@ -2939,12 +3584,13 @@ static void	sync_proxy_history(int *total_num, int *more)
 	{
 		*more = ZBX_SYNC_DONE;
 
-		LOCK_CACHE;
+		if (NULL == (shard = hc_claim_shard(&shard_index)))
+			break;
 
-		hc_pop_items(&history_items);		/* select and take items out of history cache */
+		hc_pop_items(shard, &history_items);	/* select and take items out of history cache */
 		history_num = history_items.values_num;
 
-		UNLOCK_CACHE;
+		hc_unlock_shard(shard_index);
 
 		if (0 == history_num)
 			break;
@@ -2954,31 +3600,53 @@ static void	sync_proxy_history(int *total_num, int *more)
 
 		DCmass_proxy_prepare_itemdiff(history, history_num, &item_diff);
 
-		do
+		if (SUCCEED != zbx_pb_history_enabled() && SUCCEED != zbx_pmb_enabled())
+		{
+			do
+			{
+				DBbegin();
+
+				DBmass_proxy_add_history(history, history_num);
+				DBmass_proxy_update_items(&item_diff);
+			}
+			while (ZBX_DB_DOWN == (txn_rc = DBcommit()));
+		}
+		else
 		{
-			DBbegin();
+			/* update items first - if buffer write fails the values are synced again */
+			/* and applying the same item changes twice is harmless                     */
+			txn_rc = ZBX_DB_OK;
+
+			if (0 != item_diff.values_num)
+			{
+				do
+				{
+					DBbegin();
+					DBmass_proxy_update_items(&item_diff);
+				}
+				while (ZBX_DB_DOWN == (txn_rc = DBcommit()));
+			}
 
-			DBmass_proxy_add_history(history, history_num);
-			DBmass_proxy_update_items(&item_diff);
+			if (ZBX_DB_FAIL != txn_rc)
+				txn_rc = dc_add_proxy_history_buffer(history, history_num);
 		}
-		while (ZBX_DB_DOWN == (txn_rc = DBcommit()));
 
-		LOCK_CACHE;
+		shard = hc_lock_shard(shard_index);
 
-		hc_push_items(&history_items);	/* return items to history cache */
+		hc_push_items(shard, &history_items);	/* return items to history cache */
 
 		if (ZBX_DB_FAIL != txn_rc)
 		{
 			if (0 != item_diff.values_num)
 				DCconfig_items_apply_changes(&item_diff);
 
-			cache->history_num -= history_num;
+			shard->history_num -= history_num;
+
+			hc_unlock_shard(shard_index);
 
 			if (0 != hc_queue_get_size())
 				*more = ZBX_SYNC_MORE;
 
-			UNLOCK_CACHE;
-
 			*total_num += history_num;
 
 			hc_free_item_values(history, history_num);
@@ -2986,7 +3654,7 @@ static void	sync_proxy_history(int *total_num, int *more)
 		else
 		{
 			*more = ZBX_SYNC_MORE;
-			UNLOCK_CACHE;
+			hc_unlock_shard(shard_index);
 		}
 
 		zbx_vector_ptr_clear(&history_items);
@@ -3004,45 +3672,132 @@ static void	sync_proxy_history(int *total_num, int *more)
 
 /******************************************************************************
  *                                                                            *
- * Function: sync_server_history                                              *
+ * Function: sync_server_history_release                                      *
  *                                                                            *
- * Purpose: flush history cache to database, process triggers of flushed      *
- *          and timer triggers from timer queue                               *
+ * Purpose: unlocks triggers and returns processed items to history cache     *
  *                                                                            *
- * Parameters: sync_timeout - [IN] the timeout in seconds                     *
- *             values_num   - [IN/OUT] the number of synced values            *
- *             triggers_num - [IN/OUT] the number of processed timers         *
- *             more         - [OUT] a flag indicating the cache emptiness:    *
- *                               ZBX_SYNC_DONE - nothing to sync, go idle     *
- *                               ZBX_SYNC_MORE - more data to sync            *
+ * Parameters: shard_index   - [IN] the history cache shard the items were    *
+ *                                  taken from                                *
+ *             history_items - [IN/OUT] the processed items, cleared on exit  *
+ *             history_num   - [IN] the number of processed values            *
+ *             triggerids    - [IN/OUT] the locked triggers, cleared on exit  *
+ *             triggers_num  - [IN/OUT] the number of processed triggers      *
  *                                                                            *
- * Comments: This function loops syncing history values by 1k batches and     *
- *           processing timer triggers by batches of 500 triggers.            *
- *           Unless full sync is being done the loop is aborted if either     *
- *           timeout has passed or there are no more data to process.         *
- *           The last is assumed when the following is true:                  *
- *            a) history cache is empty or less than 10% of batch values were *
- *               processed (the other items were locked by triggers)          *
- *            b) less than 500 (full batch) timer triggers were processed     *
+ ******************************************************************************/
+static void	sync_server_history_release(int shard_index, zbx_vector_ptr_t *history_items, int history_num,
+		zbx_vector_uint64_t *triggerids, int *triggers_num)
+{
+	zbx_hc_shard_t	*shard;
+
+	if (0 != triggerids->values_num)
+	{
+		*triggers_num += triggerids->values_num;
+		DCconfig_unlock_triggers(triggerids);
+		zbx_vector_uint64_clear(triggerids);
+	}
+
+	if (0 != history_num)
+	{
+		shard = hc_lock_shard(shard_index);
+		hc_push_items(shard, history_items);	/* return items to history cache */
+		shard->history_num -= history_num;
+		hc_unlock_shard(shard_index);
+	}
+
+	zbx_vector_ptr_clear(history_items);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_sync_batch_init                                               *
+ *                                                                            *
+ * Purpose: initializes history sync batch                                    *
  *                                                                            *
  ******************************************************************************/
-static void	sync_server_history(int *values_num, int *triggers_num, int *more)
+static void	hc_sync_batch_init(zbx_hc_sync_batch_t *batch)
+{
+	memset(batch, 0, sizeof(zbx_hc_sync_batch_t));
+
+	batch->history = (ZBX_DC_HISTORY *)zbx_malloc(NULL, ZBX_HC_SYNC_MAX * sizeof(ZBX_DC_HISTORY));
+
+	zbx_vector_uint64_create(&batch->itemids);
+	zbx_vector_ptr_create(&batch->history_items);
+	zbx_vector_ptr_reserve(&batch->history_items, ZBX_HC_SYNC_MAX);
+	zbx_vector_uint64_create(&batch->triggerids);
+	zbx_vector_uint64_reserve(&batch->triggerids, ZBX_HC_SYNC_MAX);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_sync_batch_destroy                                            *
+ *                                                                            *
+ * Purpose: frees resources allocated by history sync batch                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_sync_batch_destroy(zbx_hc_sync_batch_t *batch)
+{
+	zbx_vector_uint64_destroy(&batch->triggerids);
+	zbx_vector_ptr_destroy(&batch->history_items);
+	zbx_vector_uint64_destroy(&batch->itemids);
+
+	zbx_free(batch->history);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_sync_batch_wait                                               *
+ *                                                                            *
+ * Purpose: waits until history sync batch values queued to history pipeline  *
+ *          are written                                                       *
+ *                                                                            *
+ * Return value: SUCCEED - the values were written                            *
+ *               FAIL    - the values could not be written                    *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_sync_batch_wait(const zbx_hc_sync_batch_t *batch)
+{
+	if (0 == batch->seq || SUCCEED == zbx_history_pipeline_wait(batch->seq))
+		return SUCCEED;
+
+	/* the values were added to value cache when queued, drop them so the items are read from database */
+	zbx_vc_remove_items_by_ids(&batch->itemids);
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: sync_server_history_commit                                       *
+ *                                                                            *
+ * Purpose: applies item changes and trends of history sync batch, processes  *
+ *          triggers of the batch and trigger timers and returns the batch    *
+ *          items to history cache                                            *
+ *                                                                            *
+ * Parameters: batch           - [IN/OUT] the history sync batch, cleared on  *
+ *                                        exit                                *
+ *             ret             - [IN] SUCCEED - the batch values were stored  *
+ *                                    FAIL    - the batch values could not be *
+ *                                              stored, items, trends and     *
+ *                                              triggers are left unchanged   *
+ *             compression_age - [IN] history compression age                 *
+ *             triggers_num    - [IN/OUT] the number of processed triggers    *
+ *             more            - [OUT] set to ZBX_SYNC_MORE if there are more *
+ *                                     trigger timers to process              *
+ *                                                                            *
+ ******************************************************************************/
+static void	sync_server_history_commit(zbx_hc_sync_batch_t *batch, int ret, int compression_age,
+		int *triggers_num, int *more)
 {
 	static ZBX_HISTORY_FLOAT	*history_float;
 	static ZBX_HISTORY_INTEGER	*history_integer;
 	static ZBX_HISTORY_STRING	*history_string;
 	static ZBX_HISTORY_TEXT		*history_text;
 	static ZBX_HISTORY_LOG		*history_log;
-	int				i, history_num, history_float_num, history_integer_num, history_string_num,
-					history_text_num, history_log_num, txn_error, compression_age;
-	unsigned int			item_retrieve_mode;
-	time_t				sync_start;
-	zbx_vector_uint64_t		triggerids ;
-	zbx_vector_ptr_t		history_items, trigger_diff, item_diff, inventory_values, trigger_timers;
-	zbx_vector_uint64_pair_t	trends_diff, proxy_subscribtions;
-	ZBX_DC_HISTORY			history[ZBX_HC_SYNC_MAX];
-
-	item_retrieve_mode = NULL == CONFIG_EXPORT_DIR ? ZBX_ITEM_GET_SYNC : ZBX_ITEM_GET_SYNC_EXPORT;
+	int				i, history_float_num, history_integer_num, history_string_num,
+					history_text_num, history_log_num, txn_error, trends_num = 0, timers_num = 0;
+	ZBX_DC_TREND			*trends = NULL;
+	zbx_vector_ptr_t		trigger_diff, item_diff, inventory_values, trigger_timers;
+	zbx_vector_uint64_pair_t	trends_diff;
 
 	if (NULL == history_float && NULL != history_float_cbs)
 	{
@@ -3074,182 +3829,280 @@ static void	sync_server_history(int *values_num, int *triggers_num, int *more)
 				ZBX_HC_SYNC_MAX * sizeof(ZBX_HISTORY_LOG));
 	}
 
-	compression_age = hc_get_history_compression_age();
-
 	zbx_vector_ptr_create(&inventory_values);
 	zbx_vector_ptr_create(&item_diff);
 	zbx_vector_ptr_create(&trigger_diff);
 	zbx_vector_uint64_pair_create(&trends_diff);
-	zbx_vector_uint64_pair_create(&proxy_subscribtions);
-
-	zbx_vector_uint64_create(&triggerids);
-	zbx_vector_uint64_reserve(&triggerids, ZBX_HC_SYNC_MAX);
 
 	zbx_vector_ptr_create(&trigger_timers);
 	zbx_vector_ptr_reserve(&trigger_timers, ZBX_HC_TIMER_MAX);
 
-	zbx_vector_ptr_create(&history_items);
-	zbx_vector_ptr_reserve(&history_items, ZBX_HC_SYNC_MAX);
+	if (0 != batch->history_num)
+	{
+		if (SUCCEED == ret)
+		{
+			DCmass_prepare_item_updates(batch->history, &batch->itemids, batch->items, batch->history_num,
+					&item_diff, &inventory_values);
 
-	sync_start = time(NULL);
+			DCconfig_items_apply_changes(&item_diff);
+			DCmass_update_trends(batch->history, batch->history_num, &trends, &trends_num, compression_age);
 
-	do
-	{
-		DC_ITEM			*items;
-		int			*errcodes, trends_num = 0, timers_num = 0, ret = SUCCEED;
-		zbx_vector_uint64_t	itemids;
-		ZBX_DC_TREND		*trends = NULL;
+			if (0 != trends_num)
+				zbx_tfc_invalidate_trends(trends, trends_num);
 
-		zbx_vector_uint64_create(&itemids);
+			do
+			{
+				DBbegin();
 
-		*more = ZBX_SYNC_DONE;
+				DBmass_update_items(&item_diff, &inventory_values);
+				DBmass_update_trends(trends, trends_num, &trends_diff);
 
-		LOCK_CACHE;
-		hc_pop_items(&history_items);		/* select and take items out of history cache */
-		UNLOCK_CACHE;
+				/* process internal events generated by DCmass_prepare_item_updates() */
+				zbx_process_events(NULL, NULL);
 
-		if (0 != history_items.values_num)
-		{
-			if (0 == (history_num = DCconfig_lock_triggers_by_history_items(&history_items, &triggerids)))
-			{
-				LOCK_CACHE;
-				hc_push_items(&history_items);
-				UNLOCK_CACHE;
-				zbx_vector_ptr_clear(&history_items);
+				if (ZBX_DB_OK == (txn_error = DBcommit()))
+					DCupdate_trends(&trends_diff);
+				else
+					zbx_reset_event_recovery();
+
+				zbx_vector_uint64_pair_clear(&trends_diff);
 			}
+			while (ZBX_DB_DOWN == txn_error);
 		}
-		else
-			history_num = 0;
 
-		if (0 != history_num)
-		{
-			hc_get_item_values(history, &history_items);	/* copy item data from history cache */
+		zbx_clean_events();
 
-			items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * (size_t)history_num);
-			errcodes = (int *)zbx_malloc(NULL, sizeof(int) * (size_t)history_num);
+		zbx_vector_ptr_clear_ext(&inventory_values, (zbx_clean_func_t)DCinventory_value_free);
+		zbx_vector_ptr_clear_ext(&item_diff, (zbx_clean_func_t)zbx_ptr_free);
+	}
 
-			zbx_vector_uint64_reserve(&itemids, history_num);
+	if (SUCCEED == ret)
+	{
+		/* don't process trigger timers when server is shutting down */
+		if (ZBX_IS_RUNNING())
+		{
+			zbx_dc_get_trigger_timers(&trigger_timers, time(NULL), ZBX_HC_TIMER_SOFT_MAX,
+					ZBX_HC_TIMER_MAX);
+		}
 
-			for (i = 0; i < history_num; i++)
-				zbx_vector_uint64_append(&itemids, history[i].itemid);
+		timers_num = trigger_timers.values_num;
 
-			zbx_vector_uint64_sort(&itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+		if (ZBX_HC_TIMER_SOFT_MAX <= timers_num)
+			*more = ZBX_SYNC_MORE;
 
-			DCconfig_get_items_by_itemids_partial(items, itemids.values, errcodes, history_num,
-					item_retrieve_mode);
+		if (0 != batch->history_num || 0 != timers_num)
+		{
+			for (i = 0; i < trigger_timers.values_num; i++)
+			{
+				zbx_trigger_timer_t	*timer = (zbx_trigger_timer_t *)trigger_timers.values[i];
 
-			DCmass_prepare_history(history, &itemids, items, errcodes, history_num, &item_diff,
-					&inventory_values, compression_age, &proxy_subscribtions);
+				if (0 != timer->lock)
+					zbx_vector_uint64_append(&batch->triggerids, timer->triggerid);
+			}
 
-			if (FAIL != (ret = DBmass_add_history(history, history_num)))
+			do
 			{
-				DCconfig_items_apply_changes(&item_diff);
-				DCmass_update_trends(history, history_num, &trends, &trends_num, compression_age);
+				DBbegin();
 
-				if (0 != trends_num)
-					zbx_tfc_invalidate_trends(trends, trends_num);
+				recalculate_triggers(batch->history, batch->history_num, &batch->itemids, batch->items,
+						batch->errcodes, &trigger_timers, &trigger_diff);
 
-				do
-				{
-					DBbegin();
+				/* process trigger events generated by recalculate_triggers() */
+				zbx_process_events(&trigger_diff, &batch->triggerids);
+				if (0 != trigger_diff.values_num)
+					zbx_db_save_trigger_changes(&trigger_diff);
 
-					DBmass_update_items(&item_diff, &inventory_values);
-					DBmass_update_trends(trends, trends_num, &trends_diff);
+				if (ZBX_DB_OK == (txn_error = DBcommit()))
+					DCconfig_triggers_apply_changes(&trigger_diff);
+				else
+					zbx_clean_events();
 
-					/* process internal events generated by DCmass_prepare_history() */
-					zbx_process_events(NULL, NULL);
+				zbx_vector_ptr_clear_ext(&trigger_diff, (zbx_clean_func_t)zbx_trigger_diff_free);
+			}
+			while (ZBX_DB_DOWN == txn_error);
 
-					if (ZBX_DB_OK == (txn_error = DBcommit()))
-						DCupdate_trends(&trends_diff);
-					else
-						zbx_reset_event_recovery();
+			if (ZBX_DB_OK == txn_error)
+				zbx_events_update_itservices();
+		}
+	}
 
-					zbx_vector_uint64_pair_clear(&trends_diff);
-				}
-				while (ZBX_DB_DOWN == txn_error);
-			}
+	sync_server_history_release(batch->shard_index, &batch->history_items, batch->history_num,
+			&batch->triggerids, triggers_num);
 
-			zbx_clean_events();
+	if (0 != trigger_timers.values_num)
+		zbx_dc_reschedule_trigger_timers(&trigger_timers, time(NULL));
 
-			zbx_vector_ptr_clear_ext(&inventory_values, (zbx_clean_func_t)DCinventory_value_free);
-			zbx_vector_ptr_clear_ext(&item_diff, (zbx_clean_func_t)zbx_ptr_free);
+	if (SUCCEED == ret)
+	{
+		if (0 != batch->history_num)
+		{
+			DCmodule_prepare_history(batch->history, batch->history_num, history_float,
+					&history_float_num, history_integer, &history_integer_num, history_string,
+					&history_string_num, history_text, &history_text_num, history_log,
+					&history_log_num);
+
+			DCmodule_sync_history(history_float_num, history_integer_num, history_string_num,
+					history_text_num, history_log_num, history_float, history_integer,
+					history_string, history_text, history_log);
 		}
 
-		if (FAIL != ret)
+		if (0 != batch->history_num)
 		{
-			/* don't process trigger timers when server is shutting down */
-			if (ZBX_IS_RUNNING())
+			const ZBX_DC_HISTORY	*phistory = NULL;
+			const ZBX_DC_TREND	*ptrends = NULL;
+			int			history_num_loc = 0, trends_num_loc = 0;
+
+			if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_HISTORY))
 			{
-				zbx_dc_get_trigger_timers(&trigger_timers, time(NULL), ZBX_HC_TIMER_SOFT_MAX,
-						ZBX_HC_TIMER_MAX);
+				phistory = batch->history;
+				history_num_loc = batch->history_num;
 			}
 
-			timers_num = trigger_timers.values_num;
-
-			if (ZBX_HC_TIMER_SOFT_MAX <= timers_num)
-				*more = ZBX_SYNC_MORE;
+			if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_TRENDS))
+			{
+				ptrends = trends;
+				trends_num_loc = trends_num;
+			}
 
-			if (0 != history_num || 0 != timers_num)
+			if (NULL != phistory || NULL != ptrends)
 			{
-				for (i = 0; i < trigger_timers.values_num; i++)
-				{
-					zbx_trigger_timer_t	*timer = (zbx_trigger_timer_t *)trigger_timers.values[i];
+				DCexport_history_and_trends(phistory, history_num_loc, &batch->itemids, batch->items,
+						batch->errcodes, ptrends, trends_num_loc);
+			}
+		}
 
-					if (0 != timer->lock)
-						zbx_vector_uint64_append(&triggerids, timer->triggerid);
-				}
+		if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_EVENTS))
+			zbx_export_events();
+	}
 
-				do
-				{
-					DBbegin();
+	if (0 != batch->history_num || 0 != timers_num)
+		zbx_clean_events();
 
-					recalculate_triggers(history, history_num, &itemids, items, errcodes,
-							&trigger_timers, &trigger_diff);
+	if (0 != batch->history_num)
+	{
+		zbx_free(trends);
+		DCconfig_clean_items(batch->items, batch->errcodes, batch->history_num);
+		zbx_free(batch->errcodes);
+		zbx_free(batch->items);
 
-					/* process trigger events generated by recalculate_triggers() */
-					zbx_process_events(&trigger_diff, &triggerids);
-					if (0 != trigger_diff.values_num)
-						zbx_db_save_trigger_changes(&trigger_diff);
+		hc_free_item_values(batch->history, batch->history_num);
+	}
 
-					if (ZBX_DB_OK == (txn_error = DBcommit()))
-						DCconfig_triggers_apply_changes(&trigger_diff);
-					else
-						zbx_clean_events();
+	zbx_vector_uint64_clear(&batch->itemids);
+	batch->history_num = 0;
+	batch->seq = 0;
 
-					zbx_vector_ptr_clear_ext(&trigger_diff, (zbx_clean_func_t)zbx_trigger_diff_free);
-				}
-				while (ZBX_DB_DOWN == txn_error);
+	zbx_vector_ptr_destroy(&inventory_values);
+	zbx_vector_ptr_destroy(&item_diff);
+	zbx_vector_ptr_destroy(&trigger_diff);
+	zbx_vector_uint64_pair_destroy(&trends_diff);
+	zbx_vector_ptr_destroy(&trigger_timers);
+}
 
-				if (ZBX_DB_OK == txn_error)
-					zbx_events_update_itservices();
-			}
-		}
+/******************************************************************************
+ *                                                                            *
+ * Function: sync_server_history                                              *
+ *                                                                            *
+ * Purpose: flush history cache to database, process triggers of flushed      *
+ *          and timer triggers from timer queue                               *
+ *                                                                            *
+ * Parameters: sync_timeout - [IN] the timeout in seconds                     *
+ *             values_num   - [IN/OUT] the number of synced values            *
+ *             triggers_num - [IN/OUT] the number of processed timers         *
+ *             more         - [OUT] a flag indicating the cache emptiness:    *
+ *                               ZBX_SYNC_DONE - nothing to sync, go idle     *
+ *                               ZBX_SYNC_MORE - more data to sync            *
+ *                                                                            *
+ * Comments: This function loops syncing history values by 1k batches and     *
+ *           processing timer triggers by batches of 500 triggers.            *
+ *           Unless full sync is being done the loop is aborted if either     *
+ *           timeout has passed or there are no more data to process.         *
+ *           The last is assumed when the following is true:                  *
+ *            a) history cache is empty or less than 10% of batch values were *
+ *               processed (the other items were locked by triggers)          *
+ *            b) less than 500 (full batch) timer triggers were processed     *
+ *                                                                            *
+ *           With history pipeline the batch values are queued for writing    *
+ *           and the previous batch is committed while they are written.      *
+ *           Items, trends and triggers of a batch are processed only after   *
+ *           its values are written, the same as with synchronous writes.     *
+ *                                                                            *
+ ******************************************************************************/
+static void	sync_server_history(int *values_num, int *triggers_num, int *more)
+{
+	int				i, compression_age, shard_index = 0, pipeline, ret;
+	zbx_hc_shard_t			*shard;
+	zbx_hc_sync_batch_t		batches[2], *batch = &batches[0], *inflight = &batches[1], *tmp;
+	unsigned int			item_retrieve_mode;
+	time_t				sync_start;
+	zbx_vector_uint64_pair_t	proxy_subscribtions;
 
-		if (0 != triggerids.values_num)
-		{
-			*triggers_num += triggerids.values_num;
-			DCconfig_unlock_triggers(&triggerids);
-			zbx_vector_uint64_clear(&triggerids);
-		}
+	item_retrieve_mode = NULL == CONFIG_EXPORT_DIR ? ZBX_ITEM_GET_SYNC : ZBX_ITEM_GET_SYNC_EXPORT;
+
+	compression_age = hc_get_history_compression_age();
+
+	zbx_vector_uint64_pair_create(&proxy_subscribtions);
+
+	hc_sync_batch_init(batch);
+
+	if (0 != CONFIG_HISTORY_PIPELINE && SUCCEED == (pipeline = zbx_history_pipeline_begin()))
+		hc_sync_batch_init(inflight);
+	else
+		pipeline = FAIL;
+
+	sync_start = time(NULL);
+
+	do
+	{
+		ret = SUCCEED;
+		*more = ZBX_SYNC_DONE;
 
-		if (0 != trigger_timers.values_num)
+		if (NULL != (shard = hc_claim_shard(&shard_index)))
 		{
-			zbx_dc_reschedule_trigger_timers(&trigger_timers, time(NULL));
-			zbx_vector_ptr_clear(&trigger_timers);
+			hc_pop_items(shard, &batch->history_items);	/* select and take items out of history cache */
+			hc_unlock_shard(shard_index);
 		}
 
-		if (0 != proxy_subscribtions.values_num)
+		batch->shard_index = shard_index;
+
+		if (0 != batch->history_items.values_num && 0 == (batch->history_num =
+				DCconfig_lock_triggers_by_history_items(&batch->history_items, &batch->triggerids)))
 		{
-			zbx_vector_uint64_pair_sort(&proxy_subscribtions, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
-			zbx_dc_proxy_update_nodata(&proxy_subscribtions);
-			zbx_vector_uint64_pair_clear(&proxy_subscribtions);
+			shard = hc_lock_shard(shard_index);
+			hc_push_items(shard, &batch->history_items);
+			hc_unlock_shard(shard_index);
+			zbx_vector_ptr_clear(&batch->history_items);
 		}
 
-		if (0 != history_num)
+		if (0 != batch->history_num)
 		{
-			LOCK_CACHE;
-			hc_push_items(&history_items);	/* return items to history cache */
-			cache->history_num -= history_num;
+			zbx_uint64_t	seq;
+
+			/* copy item data from history cache */
+			hc_get_item_values(batch->history, &batch->history_items);
+
+			batch->items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * (size_t)batch->history_num);
+			batch->errcodes = (int *)zbx_malloc(NULL, sizeof(int) * (size_t)batch->history_num);
+
+			zbx_vector_uint64_reserve(&batch->itemids, batch->history_num);
+
+			for (i = 0; i < batch->history_num; i++)
+				zbx_vector_uint64_append(&batch->itemids, batch->history[i].itemid);
+
+			zbx_vector_uint64_sort(&batch->itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+			DCconfig_get_items_by_itemids_partial(batch->items, batch->itemids.values, batch->errcodes,
+					batch->history_num, item_retrieve_mode);
+
+			DCmass_prepare_history(batch->history, &batch->itemids, batch->items, batch->errcodes,
+					batch->history_num, compression_age, &proxy_subscribtions);
+
+			seq = zbx_history_pipeline_seq();
+			ret = DBmass_add_history(batch->history, batch->history_num);
+
+			/* no values are queued if none of them must be kept in history */
+			if (seq != zbx_history_pipeline_seq())
+				batch->seq = zbx_history_pipeline_seq();
 
 			if (0 != hc_queue_get_size())
 			{
@@ -3258,88 +4111,53 @@ static void	sync_server_history(int *values_num, int *triggers_num, int *more)
 				/* Otherwise better to wait a bit for other syncers to unlock      */
 				/* items rather than trying and failing to sync locked items over  */
 				/* and over again.                                                 */
-				if (ZBX_HC_SYNC_MIN_PCNT <= history_num * 100 / history_items.values_num)
+				if (ZBX_HC_SYNC_MIN_PCNT <= batch->history_num * 100 / batch->history_items.values_num)
 					*more = ZBX_SYNC_MORE;
 			}
-
-			UNLOCK_CACHE;
-
-			*values_num += history_num;
 		}
 
-		if (FAIL != ret)
-		{
-			if (0 != history_num)
-			{
-				DCmodule_prepare_history(history, history_num, history_float, &history_float_num,
-						history_integer, &history_integer_num, history_string,
-						&history_string_num, history_text, &history_text_num, history_log,
-						&history_log_num);
-
-				DCmodule_sync_history(history_float_num, history_integer_num, history_string_num,
-						history_text_num, history_log_num, history_float, history_integer,
-						history_string, history_text, history_log);
-			}
-
-			if (0 != history_num)
-			{
-				const ZBX_DC_HISTORY	*phistory = NULL;
-				const ZBX_DC_TREND	*ptrends = NULL;
-				int			history_num_loc = 0, trends_num_loc = 0;
-
-				if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_HISTORY))
-				{
-					phistory = history;
-					history_num_loc = history_num;
-				}
-
-				if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_TRENDS))
-				{
-					ptrends = trends;
-					trends_num_loc = trends_num;
-				}
+		*values_num += batch->history_num;
 
-				if (NULL != phistory || NULL != ptrends)
-				{
-					DCexport_history_and_trends(phistory, history_num_loc, &itemids, items,
-							errcodes, ptrends, trends_num_loc);
-				}
-			}
+		if (SUCCEED == pipeline && 0 != batch->history_num && SUCCEED == ret)
+		{
+			/* keep the batch items and triggers locked while its values are written, */
+			/* committing the previous batch instead                                  */
+			tmp = inflight;
+			inflight = batch;
+			batch = tmp;
 
-			if (SUCCEED == zbx_is_export_enabled(ZBX_FLAG_EXPTYPE_EVENTS))
-				zbx_export_events();
+			ret = hc_sync_batch_wait(batch);
 		}
 
-		if (0 != history_num || 0 != timers_num)
-			zbx_clean_events();
+		sync_server_history_commit(batch, ret, compression_age, triggers_num, more);
 
-		if (0 != history_num)
+		if (0 != proxy_subscribtions.values_num)
 		{
-			zbx_free(trends);
-			DCconfig_clean_items(items, errcodes, history_num);
-			zbx_free(errcodes);
-			zbx_free(items);
-
-			zbx_vector_ptr_clear(&history_items);
-			hc_free_item_values(history, history_num);
+			zbx_vector_uint64_pair_sort(&proxy_subscribtions, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+			zbx_dc_proxy_update_nodata(&proxy_subscribtions);
+			zbx_vector_uint64_pair_clear(&proxy_subscribtions);
 		}
 
-		zbx_vector_uint64_destroy(&itemids);
-
 		/* Exit from sync loop if we have spent too much time here.       */
 		/* This is done to allow syncer process to update its statistics. */
 	}
-	while (ZBX_SYNC_MORE == *more && ZBX_HC_SYNC_TIME_MAX >= time(NULL) - sync_start);
+	while (ZBX_SYNC_MORE == *more && ZBX_HC_SYNC_TIME_MAX >= time(NULL) - sync_start);
+
+	if (SUCCEED == pipeline)
+	{
+		if (0 != inflight->history_num)
+		{
+			sync_server_history_commit(inflight, hc_sync_batch_wait(inflight), compression_age,
+					triggers_num, more);
+		}
+
+		zbx_history_pipeline_end();
+		hc_sync_batch_destroy(inflight);
+	}
 
-	zbx_vector_ptr_destroy(&history_items);
-	zbx_vector_ptr_destroy(&inventory_values);
-	zbx_vector_ptr_destroy(&item_diff);
-	zbx_vector_ptr_destroy(&trigger_diff);
-	zbx_vector_uint64_pair_destroy(&trends_diff);
-	zbx_vector_uint64_pair_destroy(&proxy_subscribtions);
+	hc_sync_batch_destroy(batch);
 
-	zbx_vector_ptr_destroy(&trigger_timers);
-	zbx_vector_uint64_destroy(&triggerids);
+	zbx_vector_uint64_pair_destroy(&proxy_subscribtions);
 }
 
 /******************************************************************************
@@ -3356,12 +4174,12 @@ static void	sync_server_history(int *values_num, int *triggers_num, int *more)
  ******************************************************************************/
 static void	sync_history_cache_full(void)
 {
-	int			values_num = 0, triggers_num = 0, more;
+	int			values_num = 0, triggers_num = 0, more, i;
 	zbx_hashset_iter_t	iter;
 	zbx_hc_item_t		*item;
-	zbx_binary_heap_t	tmp_history_queue;
+	zbx_binary_heap_t	tmp_history_queue[ZBX_HC_SHARDS_MAX];
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, cache->history_num);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, hc_get_history_num());
 
 	/* History index cache might be full without any space left for queueing items from history index to  */
 	/* history queue. The solution: replace the shared-memory history queue with heap-allocated one. Add  */
@@ -3380,18 +4198,24 @@ static void	sync_history_cache_full(void)
 		DCconfig_unlock_all_triggers();
 	}
 
-	tmp_history_queue = cache->history_queue;
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_hc_shard_t	*shard = hc_shards[i].shard;
+
+		tmp_history_queue[i] = shard->history_queue;
 
-	zbx_binary_heap_create(&cache->history_queue, hc_queue_elem_compare_func, ZBX_BINARY_HEAP_OPTION_EMPTY);
-	zbx_hashset_iter_reset(&cache->history_items, &iter);
+		zbx_binary_heap_create(&shard->history_queue, hc_queue_elem_compare_func,
+				ZBX_BINARY_HEAP_OPTION_EMPTY);
+		zbx_hashset_iter_reset(&shard->history_items, &iter);
 
-	/* add all items from history index to the new history queue */
-	while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
-	{
-		if (NULL != item->tail)
+		/* add all items from history index to the new history queue */
+		while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
 		{
-			item->status = ZBX_HC_ITEM_STATUS_NORMAL;
-			hc_queue_item(item);
+			if (NULL != item->tail)
+			{
+				item->status = ZBX_HC_ITEM_STATUS_NORMAL;
+				hc_queue_item(shard, item);
+			}
 		}
 	}
 
@@ -3407,15 +4231,18 @@ static void	sync_history_cache_full(void)
 				sync_proxy_history(&values_num, &more);
 
 			zabbix_log(LOG_LEVEL_WARNING, "syncing history data... " ZBX_FS_DBL "%%",
-					(double)values_num / (cache->history_num + values_num) * 100);
+					(double)values_num / (hc_get_history_num() + values_num) * 100);
 		}
 		while (0 != hc_queue_get_size());
 
 		zabbix_log(LOG_LEVEL_WARNING, "syncing history data done");
 	}
 
-	zbx_binary_heap_destroy(&cache->history_queue);
-	cache->history_queue = tmp_history_queue;
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_binary_heap_destroy(&hc_shards[i].shard->history_queue);
+		hc_shards[i].shard->history_queue = tmp_history_queue[i];
+	}
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
@@ -3430,7 +4257,9 @@ static void	sync_history_cache_full(void)
 void	zbx_log_sync_history_cache_progress(void)
 {
 	double		pcnt = -1.0;
-	int		ts_last, ts_next, sec;
+	int		ts_last, ts_next, sec, history_num;
+
+	history_num = hc_get_history_num();
 
 	LOCK_CACHE;
 
@@ -3445,16 +4274,16 @@ void	zbx_log_sync_history_cache_progress(void)
 
 	if (0 == cache->history_progress_ts)
 	{
-		cache->history_num_total = cache->history_num;
+		cache->history_num_total = history_num;
 		cache->history_progress_ts = sec;
 	}
 
-	if (ZBX_HC_SYNC_TIME_MAX <= sec - cache->history_progress_ts || 0 == cache->history_num)
+	if (ZBX_HC_SYNC_TIME_MAX <= sec - cache->history_progress_ts || 0 == history_num)
 	{
 		if (0 != cache->history_num_total)
-			pcnt = 100 * (double)(cache->history_num_total - cache->history_num) / cache->history_num_total;
+			pcnt = 100 * (double)(cache->history_num_total - history_num) / cache->history_num_total;
 
-		cache->history_progress_ts = (0 == cache->history_num ? INT_MAX : sec);
+		cache->history_progress_ts = (0 == history_num ? INT_MAX : sec);
 	}
 
 	ts_next = cache->history_progress_ts;
@@ -3477,7 +4306,7 @@ void	zbx_log_sync_history_cache_progress(void)
  *                                                                            *
  * Purpose: writes updates and new data from history cache to database        *
  *                                                                            *
- * Parameters: values_num - [OUT] the number of synced values                  *
+ * Parameters: values_num - [OUT] the number of synced values                 *
  *             more      - [OUT] a flag indicating the cache emptiness:       *
  *                                ZBX_SYNC_DONE - nothing to sync, go idle    *
  *                                ZBX_SYNC_MORE - more data to sync           *
@@ -3485,7 +4314,7 @@ void	zbx_log_sync_history_cache_progress(void)
  ******************************************************************************/
 void	zbx_sync_history_cache(int *values_num, int *triggers_num, int *more)
 {
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, cache->history_num);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() history_num:%d", __func__, hc_get_history_num());
 
 	*values_num = 0;
 	*triggers_num = 0;
@@ -3845,16 +4674,74 @@ void	dc_add_history(zbx_uint64_t itemid, unsigned char item_value_type, unsigned
 
 void	dc_flush_history(void)
 {
+	static dc_item_value_t	*shard_values;
+	static size_t		shard_values_alloc;
+	int			i, values_num[ZBX_HC_SHARDS_MAX] = {0}, offsets[ZBX_HC_SHARDS_MAX], pending;
+	dc_item_value_t		*values;
+	zbx_hc_shard_t		*shard;
+	size_t			j;
+
 	if (0 == item_values_num)
 		return;
 
-	LOCK_CACHE;
+	if (1 == CONFIG_HISTORY_CACHE_SHARDS)
+	{
+		values = item_values;
+		values_num[0] = (int)item_values_num;
+		offsets[0] = 0;
+	}
+	else
+	{
+		if (shard_values_alloc < item_values_num)
+		{
+			shard_values_alloc = item_values_alloc;
+			shard_values = (dc_item_value_t *)zbx_realloc(shard_values,
+					shard_values_alloc * sizeof(dc_item_value_t));
+		}
 
-	hc_add_item_values(item_values, item_values_num);
+		/* group values by shards, keeping the order of values of the same item */
+		for (j = 0; j < item_values_num; j++)
+			values_num[hc_get_shard_index(item_values[j].itemid)]++;
 
-	cache->history_num += item_values_num;
+		for (offsets[0] = 0, i = 1; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+			offsets[i] = offsets[i - 1] + values_num[i - 1];
 
-	UNLOCK_CACHE;
+		for (j = 0; j < item_values_num; j++)
+			shard_values[offsets[hc_get_shard_index(item_values[j].itemid)]++] = item_values[j];
+
+		for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+			offsets[i] -= values_num[i];
+
+		values = shard_values;
+	}
+
+	/* Each shard stores values in its own part of history cache. When a shard is full the values of other */
+	/* shards are still added and only the remaining values of full shards wait for history syncers.       */
+	while (1)
+	{
+		for (pending = 0, i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+		{
+			int	added;
+
+			if (0 == values_num[i])
+				continue;
+
+			shard = hc_lock_shard(i);
+			added = hc_add_item_values(shard, values + offsets[i], values_num[i]);
+			hc_unlock_shard(i);
+
+			offsets[i] += added;
+
+			if (0 != (values_num[i] -= added))
+				pending = 1;
+		}
+
+		if (0 == pending)
+			break;
+
+		zabbix_log(LOG_LEVEL_DEBUG, "History cache is full. Sleeping for 1 second.");
+		sleep(1);
+	}
 
 	item_values_num = 0;
 	string_values_offset = 0;
@@ -3868,6 +4755,118 @@ void	dc_flush_history(void)
 ZBX_MEM_FUNC_IMPL(__hc_index, hc_index_mem)
 ZBX_MEM_FUNC_IMPL(__hc, hc_mem)
 
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_get_shard_index                                               *
+ *                                                                            *
+ * Purpose: returns index of history cache shard storing the specified item   *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_get_shard_index(zbx_uint64_t itemid)
+{
+	return (int)(itemid % (zbx_uint64_t)CONFIG_HISTORY_CACHE_SHARDS);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_lock_shard                                                    *
+ *                                                                            *
+ * Purpose: locks history cache shard                                         *
+ *                                                                            *
+ * Parameters: index - [IN] the shard index                                   *
+ *                                                                            *
+ * Return value: the locked shard                                             *
+ *                                                                            *
+ * Comments: The history (index) cache memory allocation functions work with  *
+ *           the memory of the last locked shard.                             *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hc_shard_t	*hc_lock_shard(int index)
+{
+	zbx_hc_shard_ref_t	*ref = &hc_shards[index];
+
+	zbx_mutex_lock(ref->lock);
+
+	hc_mem = ref->data_mem;
+	hc_index_mem = ref->index_mem;
+
+	return ref->shard;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_unlock_shard                                                  *
+ *                                                                            *
+ * Purpose: unlocks history cache shard                                       *
+ *                                                                            *
+ * Parameters: index - [IN] the shard index                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_unlock_shard(int index)
+{
+	zbx_mutex_unlock(hc_shards[index].lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_claim_shard                                                   *
+ *                                                                            *
+ * Purpose: locks the next history cache shard having queued items            *
+ *                                                                            *
+ * Parameters: index - [OUT] the locked shard index                           *
+ *                                                                            *
+ * Return value: the locked shard or NULL if history queues of all shards     *
+ *               are empty                                                    *
+ *                                                                            *
+ * Comments: History syncers start with shards chosen by process identifier   *
+ *           and pick the next shard after each batch, so concurrent syncers  *
+ *           normally work with different shards.                             *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_hc_shard_t	*hc_claim_shard(int *index)
+{
+	int	i;
+
+	if (-1 == hc_sync_shard)
+		hc_sync_shard = (int)(getpid() % CONFIG_HISTORY_CACHE_SHARDS);
+
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_hc_shard_t	*shard;
+
+		*index = hc_sync_shard;
+		hc_sync_shard = (hc_sync_shard + 1) % CONFIG_HISTORY_CACHE_SHARDS;
+
+		shard = hc_lock_shard(*index);
+
+		if (FAIL == zbx_binary_heap_empty(&shard->history_queue))
+			return shard;
+
+		hc_unlock_shard(*index);
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_get_history_num                                               *
+ *                                                                            *
+ * Purpose: returns the number of values in history cache                     *
+ *                                                                            *
+ * Comments: The shards are not locked, so the returned value is approximate. *
+ *                                                                            *
+ ******************************************************************************/
+static int	hc_get_history_num(void)
+{
+	int	i, history_num = 0;
+
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+		history_num += hc_shards[i].shard->history_num;
+
+	return history_num;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: hc_queue_elem_compare_func                                       *
@@ -3933,14 +4932,15 @@ static void	hc_free_data(zbx_hc_data_t *data)
  *                                                                            *
  * Purpose: put back item into history queue                                  *
  *                                                                            *
- * Parameters: data - [IN] history item data                                  *
+ * Parameters: shard - [IN] the history cache shard                           *
+ *             item  - [IN] the history item                                  *
  *                                                                            *
  ******************************************************************************/
-static void	hc_queue_item(zbx_hc_item_t *item)
+static void	hc_queue_item(zbx_hc_shard_t *shard, zbx_hc_item_t *item)
 {
 	zbx_binary_heap_elem_t	elem = {item->itemid, (const void *)item};
 
-	zbx_binary_heap_insert(&cache->history_queue, &elem);
+	zbx_binary_heap_insert(&shard->history_queue, &elem);
 }
 
 /******************************************************************************
@@ -3949,15 +4949,16 @@ static void	hc_queue_item(zbx_hc_item_t *item)
  *                                                                            *
  * Purpose: returns history item by itemid                                    *
  *                                                                            *
- * Parameters: itemid - [IN] the item id                                      *
+ * Parameters: shard  - [IN] the history cache shard                          *
+ *             itemid - [IN] the item id                                      *
  *                                                                            *
  * Return value: the history item or NULL if the requested item is not in     *
  *               history cache                                                *
  *                                                                            *
  ******************************************************************************/
-static zbx_hc_item_t	*hc_get_item(zbx_uint64_t itemid)
+static zbx_hc_item_t	*hc_get_item(zbx_hc_shard_t *shard, zbx_uint64_t itemid)
 {
-	return (zbx_hc_item_t *)zbx_hashset_search(&cache->history_items, &itemid);
+	return (zbx_hc_item_t *)zbx_hashset_search(&shard->history_items, &itemid);
 }
 
 /******************************************************************************
@@ -3966,17 +4967,18 @@ static zbx_hc_item_t	*hc_get_item(zbx_uint64_t itemid)
  *                                                                            *
  * Purpose: adds a new item to history cache                                  *
  *                                                                            *
- * Parameters: itemid - [IN] the item id                                      *
+ * Parameters: shard  - [IN] the history cache shard                          *
+ *             itemid - [IN] the item id                                      *
  *                      [IN] the item data                                    *
  *                                                                            *
  * Return value: the added history item                                       *
  *                                                                            *
  ******************************************************************************/
-static zbx_hc_item_t	*hc_add_item(zbx_uint64_t itemid, zbx_hc_data_t *data)
+static zbx_hc_item_t	*hc_add_item(zbx_hc_shard_t *shard, zbx_uint64_t itemid, zbx_hc_data_t *data)
 {
 	zbx_hc_item_t	item_local = {itemid, ZBX_HC_ITEM_STATUS_NORMAL, 0, data, data};
 
-	return (zbx_hc_item_t *)zbx_hashset_insert(&cache->history_items, &item_local, sizeof(item_local));
+	return (zbx_hc_item_t *)zbx_hashset_insert(&shard->history_items, &item_local, sizeof(item_local));
 }
 
 /******************************************************************************
@@ -4083,6 +5085,7 @@ static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_
  *                                                                            *
  * Parameters: data       - [IN/OUT] a reference to the cloned value          *
  *             item_value - [IN] the item value                               *
+ *             stats      - [IN/OUT] the history cache shard statistics       *
  *                                                                            *
  * Return value: SUCCESS - the item value was cloned successfully             *
  *               FAIL    - not enough memory                                  *
@@ -4091,7 +5094,8 @@ static int	hc_clone_history_log_data(zbx_log_value_t **dst, const dc_item_value_
  *           until it finishes cloning item value.                            *
  *                                                                            *
  ******************************************************************************/
-static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *item_value)
+static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *item_value,
+		ZBX_DC_STATS *stats)
 {
 	if (NULL == *data)
 	{
@@ -4117,7 +5121,7 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 			return FAIL;
 
 		(*data)->value_type = item_value->value_type;
-		cache->stats.notsupported_counter++;
+		stats->notsupported_counter++;
 
 		return SUCCEED;
 	}
@@ -4129,8 +5133,8 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 
 		(*data)->value_type = ITEM_VALUE_TYPE_TEXT;
 
-		cache->stats.history_text_counter++;
-		cache->stats.history_counter++;
+		stats->history_text_counter++;
+		stats->history_counter++;
 
 		return SUCCEED;
 	}
@@ -4168,23 +5172,23 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
 		switch (item_value->item_value_type)
 		{
 			case ITEM_VALUE_TYPE_FLOAT:
-				cache->stats.history_float_counter++;
+				stats->history_float_counter++;
 				break;
 			case ITEM_VALUE_TYPE_UINT64:
-				cache->stats.history_uint_counter++;
+				stats->history_uint_counter++;
 				break;
 			case ITEM_VALUE_TYPE_STR:
-				cache->stats.history_str_counter++;
+				stats->history_str_counter++;
 				break;
 			case ITEM_VALUE_TYPE_TEXT:
-				cache->stats.history_text_counter++;
+				stats->history_text_counter++;
 				break;
 			case ITEM_VALUE_TYPE_LOG:
-				cache->stats.history_log_counter++;
+				stats->history_log_counter++;
 				break;
 		}
 
-		cache->stats.history_counter++;
+		stats->history_counter++;
 	}
 
 	(*data)->value_type = item_value->value_type;
@@ -4196,17 +5200,17 @@ static int	hc_clone_history_data(zbx_hc_data_t **data, const dc_item_value_t *it
  *                                                                            *
  * Function: hc_add_item_values                                               *
  *                                                                            *
- * Purpose: adds item values to the history cache                             *
+ * Purpose: adds item values to the history cache shard                       *
  *                                                                            *
- * Parameters: values     - [IN] the item values to add                       *
+ * Parameters: shard      - [IN] the locked history cache shard               *
+ *             values     - [IN] the item values to add                       *
  *             values_num - [IN] the number of item values to add             *
  *                                                                            *
- * Comments: If the history cache is full this function will wait until       *
- *           history syncers processes values freeing enough space to store   *
- *           the new value.                                                   *
+ * Return value: the number of processed values, less than values_num if the  *
+ *               history cache shard is full                                  *
  *                                                                            *
  ******************************************************************************/
-static void	hc_add_item_values(dc_item_value_t *values, int values_num)
+static int	hc_add_item_values(zbx_hc_shard_t *shard, dc_item_value_t *values, int values_num)
 {
 	dc_item_value_t	*item_value;
 	int		i;
@@ -4220,7 +5224,7 @@ static void	hc_add_item_values(dc_item_value_t *values, int values_num)
 
 		/* a record with metadata and no value can be dropped if  */
 		/* the metadata update is copied to the last queued value */
-		if (NULL != (item = hc_get_item(item_value->itemid)) &&
+		if (NULL != (item = hc_get_item(shard, item_value->itemid)) &&
 				0 != (item_value->flags & ZBX_DC_FLAG_NOVALUE) &&
 				0 != (item_value->flags & ZBX_DC_FLAG_META))
 		{
@@ -4235,26 +5239,13 @@ static void	hc_add_item_values(dc_item_value_t *values, int values_num)
 			}
 		}
 
-		if (SUCCEED != hc_clone_history_data(&data, item_value))
-		{
-			do
-			{
-				UNLOCK_CACHE;
-
-				zabbix_log(LOG_LEVEL_DEBUG, "History cache is full. Sleeping for 1 second.");
-				sleep(1);
-
-				LOCK_CACHE;
-			}
-			while (SUCCEED != hc_clone_history_data(&data, item_value));
-
-			item = hc_get_item(item_value->itemid);
-		}
+		if (SUCCEED != hc_clone_history_data(&data, item_value, &shard->stats))
+			break;
 
 		if (NULL == item)
 		{
-			item = hc_add_item(item_value->itemid, data);
-			hc_queue_item(item);
+			item = hc_add_item(shard, item_value->itemid, data);
+			hc_queue_item(shard, item);
 		}
 		else
 		{
@@ -4263,6 +5254,10 @@ static void	hc_add_item_values(dc_item_value_t *values, int values_num)
 		}
 		item->values_num++;
 	}
+
+	shard->history_num += i;
+
+	return i;
 }
 
 /******************************************************************************
@@ -4335,24 +5330,26 @@ static void	hc_copy_history_data(ZBX_DC_HISTORY *history, zbx_uint64_t itemid, z
  *                                                                            *
  * Purpose: pops the next batch of history items from cache for processing    *
  *                                                                            *
- * Parameters: history_items - [OUT] the locked history items                 *
+ * Parameters: shard         - [IN] the locked history cache shard            *
+ *             history_items - [OUT] the locked history items                 *
  *                                                                            *
- * Comments: The history_items must be returned back to history cache with    *
- *           hc_push_items() function after they have been processed.         *
+ * Comments: The history_items must be returned back to the same history      *
+ *           cache shard with hc_push_items() function after they have been   *
+ *           processed.                                                       *
  *                                                                            *
  ******************************************************************************/
-static void	hc_pop_items(zbx_vector_ptr_t *history_items)
+static void	hc_pop_items(zbx_hc_shard_t *shard, zbx_vector_ptr_t *history_items)
 {
 	zbx_binary_heap_elem_t	*elem;
 	zbx_hc_item_t		*item;
 
-	while (ZBX_HC_SYNC_MAX > history_items->values_num && FAIL == zbx_binary_heap_empty(&cache->history_queue))
+	while (ZBX_HC_SYNC_MAX > history_items->values_num && FAIL == zbx_binary_heap_empty(&shard->history_queue))
 	{
-		elem = zbx_binary_heap_find_min(&cache->history_queue);
+		elem = zbx_binary_heap_find_min(&shard->history_queue);
 		item = (zbx_hc_item_t *)elem->data;
 		zbx_vector_ptr_append(history_items, item);
 
-		zbx_binary_heap_remove_min(&cache->history_queue);
+		zbx_binary_heap_remove_min(&shard->history_queue);
 	}
 }
 
@@ -4390,7 +5387,8 @@ static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *histor
  *                                                                            *
  * Purpose: push back the processed history items into history cache          *
  *                                                                            *
- * Parameters: history_items - [IN] the history items containing processed    *
+ * Parameters: shard         - [IN] the locked history cache shard            *
+ *             history_items - [IN] the history items containing processed    *
  *                                  (available) and busy items                *
  *                                                                            *
  * Comments: This function removes processed value from history cache.        *
@@ -4398,7 +5396,7 @@ static void	hc_get_item_values(ZBX_DC_HISTORY *history, zbx_vector_ptr_t *histor
  *           removed from history index.                                      *
  *                                                                            *
  ******************************************************************************/
-void	hc_push_items(zbx_vector_ptr_t *history_items)
+void	hc_push_items(zbx_hc_shard_t *shard, zbx_vector_ptr_t *history_items)
 {
 	int		i;
 	zbx_hc_item_t	*item;
@@ -4413,7 +5411,7 @@ void	hc_push_items(zbx_vector_ptr_t *history_items)
 			case ZBX_HC_ITEM_STATUS_BUSY:
 				/* reset item status before returning it to queue */
 				item->status = ZBX_HC_ITEM_STATUS_NORMAL;
-				hc_queue_item(item);
+				hc_queue_item(shard, item);
 				break;
 			case ZBX_HC_ITEM_STATUS_NORMAL:
 				item->values_num--;
@@ -4421,9 +5419,9 @@ void	hc_push_items(zbx_vector_ptr_t *history_items)
 				item->tail = item->tail->next;
 				hc_free_data(data_free);
 				if (NULL == item->tail)
-					zbx_hashset_remove(&cache->history_items, item);
+					zbx_hashset_remove(&shard->history_items, item);
 				else
-					hc_queue_item(item);
+					hc_queue_item(shard, item);
 				break;
 		}
 	}
@@ -4435,10 +5433,17 @@ void	hc_push_items(zbx_vector_ptr_t *history_items)
  *                                                                            *
  * Purpose: retrieve the size of history queue                                *
  *                                                                            *
+ * Comments: The shards are not locked, so the returned value is approximate. *
+ *                                                                            *
  ******************************************************************************/
 int	hc_queue_get_size(void)
 {
-	return cache->history_queue.elems_num;
+	int	i, size = 0;
+
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+		size += hc_shards[i].shard->history_queue.elems_num;
+
+	return size;
 }
 
 int	hc_get_history_compression_age(void)
@@ -4476,6 +5481,28 @@ int	hc_get_history_compression_age(void)
 
 ZBX_MEM_FUNC_IMPL(__trend, trend_mem)
 
+static zbx_hash_t	dc_trend_hash_func(const void *data)
+{
+	const ZBX_DC_TREND	*trend = (const ZBX_DC_TREND *)data;
+	zbx_hash_t		hash;
+
+	hash = ZBX_DEFAULT_UINT64_HASH_FUNC(&trend->itemid);
+
+	return ZBX_DEFAULT_HASH_ALGO(&trend->clock, sizeof(trend->clock), hash);
+}
+
+static int	dc_trend_compare_func(const void *d1, const void *d2)
+{
+	const ZBX_DC_TREND	*t1 = (const ZBX_DC_TREND *)d1;
+	const ZBX_DC_TREND	*t2 = (const ZBX_DC_TREND *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(t1->itemid, t2->itemid);
+	ZBX_RETURN_IF_NOT_EQUAL(t1->clock, t2->clock);
+	ZBX_RETURN_IF_NOT_EQUAL(t1->value_type, t2->value_type);
+
+	return 0;
+}
+
 static int	init_trend_cache(char **error)
 {
 	size_t	sz;
@@ -4497,6 +5524,9 @@ static int	init_trend_cache(char **error)
 
 	cache->trends_num = 0;
 	cache->trends_last_cleanup_hour = 0;
+	cache->trends_lag_hour = 0;
+	cache->trends_flush_lag = 0;
+	cache->trends_flush_time = 0;
 
 #define INIT_HASHSET_SIZE	100	/* Should be calculated dynamically based on trends size? */
 					/* Still does not make sense to have it more than initial */
@@ -4506,6 +5536,9 @@ static int	init_trend_cache(char **error)
 			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
 			__trend_mem_malloc_func, __trend_mem_realloc_func, __trend_mem_free_func);
 
+	zbx_hashset_create_ext(&cache->trends_closed, INIT_HASHSET_SIZE, dc_trend_hash_func, dc_trend_compare_func,
+			NULL, __trend_mem_malloc_func, __trend_mem_realloc_func, __trend_mem_free_func);
+
 #undef INIT_HASHSET_SIZE
 out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
@@ -4513,6 +5546,64 @@ out:
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: init_history_cache_shard                                         *
+ *                                                                            *
+ * Purpose: allocate shared memory for history cache shard                    *
+ *                                                                            *
+ * Parameters: index - [IN] the shard index                                   *
+ *             error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - the shard was initialized successfully             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: The history cache and history index cache sizes are divided      *
+ *           equally between shards. Values of a full shard wait for history  *
+ *           syncers, they are not moved to other shards.                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	init_history_cache_shard(int index, char **error)
+{
+	zbx_hc_shard_ref_t	*ref = &hc_shards[index];
+	int			ret;
+
+	if (SUCCEED != (ret = zbx_mutex_create(&ref->lock, 0 == index ? ZBX_MUTEX_CACHE :
+			ZBX_MUTEX_CACHE_SHARD + index - 1, error)))
+	{
+		goto out;
+	}
+
+	if (SUCCEED != (ret = zbx_mem_create(&ref->data_mem, CONFIG_HISTORY_CACHE_SIZE / CONFIG_HISTORY_CACHE_SHARDS,
+			"history cache", "HistoryCacheSize", 1, error)))
+	{
+		goto out;
+	}
+
+	if (SUCCEED != (ret = zbx_mem_create(&ref->index_mem,
+			CONFIG_HISTORY_INDEX_CACHE_SIZE / CONFIG_HISTORY_CACHE_SHARDS, "history index cache",
+			"HistoryIndexCacheSize", 0, error)))
+	{
+		goto out;
+	}
+
+	hc_mem = ref->data_mem;
+	hc_index_mem = ref->index_mem;
+
+	ref->shard = (zbx_hc_shard_t *)__hc_index_mem_malloc_func(NULL, sizeof(zbx_hc_shard_t));
+	memset(ref->shard, 0, sizeof(zbx_hc_shard_t));
+
+	zbx_hashset_create_ext(&ref->shard->history_items, ZBX_HC_ITEMS_INIT_SIZE,
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
+			__hc_index_mem_malloc_func, __hc_index_mem_realloc_func, __hc_index_mem_free_func);
+
+	zbx_binary_heap_create_ext(&ref->shard->history_queue, hc_queue_elem_compare_func,
+			ZBX_BINARY_HEAP_OPTION_EMPTY, __hc_index_mem_malloc_func, __hc_index_mem_realloc_func,
+			__hc_index_mem_free_func);
+out:
+	return ret;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: init_database_cache                                              *
@@ -4524,26 +5615,18 @@ out:
  ******************************************************************************/
 int	init_database_cache(char **error)
 {
-	int	ret;
+	int	ret, i;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	if (SUCCEED != (ret = zbx_mutex_create(&cache_lock, ZBX_MUTEX_CACHE, error)))
-		goto out;
-
 	if (SUCCEED != (ret = zbx_mutex_create(&cache_ids_lock, ZBX_MUTEX_CACHE_IDS, error)))
 		goto out;
 
-	if (SUCCEED != (ret = zbx_mem_create(&hc_mem, CONFIG_HISTORY_CACHE_SIZE, "history cache",
-			"HistoryCacheSize", 1, error)))
-	{
-		goto out;
-	}
-
-	if (SUCCEED != (ret = zbx_mem_create(&hc_index_mem, CONFIG_HISTORY_INDEX_CACHE_SIZE, "history index cache",
-			"HistoryIndexCacheSize", 0, error)))
+	/* initialize the first shard last, so the global history cache data is allocated in its index memory */
+	for (i = CONFIG_HISTORY_CACHE_SHARDS - 1; 0 <= i; i--)
 	{
-		goto out;
+		if (SUCCEED != (ret = init_history_cache_shard(i, error)))
+			goto out;
 	}
 
 	cache = (ZBX_DC_CACHE *)__hc_index_mem_malloc_func(NULL, sizeof(ZBX_DC_CACHE));
@@ -4552,13 +5635,6 @@ int	init_database_cache(char **error)
 	ids = (ZBX_DC_IDS *)__hc_index_mem_malloc_func(NULL, sizeof(ZBX_DC_IDS));
 	memset(ids, 0, sizeof(ZBX_DC_IDS));
 
-	zbx_hashset_create_ext(&cache->history_items, ZBX_HC_ITEMS_INIT_SIZE,
-			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC, NULL,
-			__hc_index_mem_malloc_func, __hc_index_mem_realloc_func, __hc_index_mem_free_func);
-
-	zbx_binary_heap_create_ext(&cache->history_queue, hc_queue_elem_compare_func, ZBX_BINARY_HEAP_OPTION_EMPTY,
-			__hc_index_mem_malloc_func, __hc_index_mem_realloc_func, __hc_index_mem_free_func);
-
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
 	{
 		zbx_hashset_create_ext(&(cache->proxyqueue.index), ZBX_HC_SYNC_MAX,
@@ -4617,13 +5693,17 @@ static void	DCsync_all(void)
  ******************************************************************************/
 void	free_database_cache(void)
 {
+	int	i;
+
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
 	DCsync_all();
 
 	cache = NULL;
 
-	zbx_mutex_destroy(&cache_lock);
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+		zbx_mutex_destroy(&hc_shards[i].lock);
+
 	zbx_mutex_destroy(&cache_ids_lock);
 
 	if (0 != (program_type & ZBX_PROGRAM_TYPE_SERVER))
@@ -4739,6 +5819,43 @@ out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: hc_mem_stats_add                                                 *
+ *                                                                            *
+ * Purpose: add shared memory allocator statistics of history cache shard     *
+ *                                                                            *
+ * Parameters: total - [IN/OUT] the summed statistics                         *
+ *             stats - [IN] the shard statistics                              *
+ *             index - [IN] the shard index                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	hc_mem_stats_add(zbx_mem_stats_t *total, const zbx_mem_stats_t *stats, int index)
+{
+	int	i;
+
+	if (0 == index)
+	{
+		*total = *stats;
+		return;
+	}
+
+	total->free_size += stats->free_size;
+	total->used_size += stats->used_size;
+	total->overhead += stats->overhead;
+	total->free_chunks += stats->free_chunks;
+	total->used_chunks += stats->used_chunks;
+
+	if (total->min_chunk_size > stats->min_chunk_size)
+		total->min_chunk_size = stats->min_chunk_size;
+
+	if (total->max_chunk_size < stats->max_chunk_size)
+		total->max_chunk_size = stats->max_chunk_size;
+
+	for (i = 0; i < MEM_BUCKET_COUNT; i++)
+		total->chunks_num[i] += stats->chunks_num[i];
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_hc_get_diag_stats                                            *
@@ -4748,12 +5865,39 @@ out:
  ******************************************************************************/
 void	zbx_hc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num)
 {
-	LOCK_CACHE;
+	int	i;
 
-	*values_num = cache->history_num;
-	*items_num = cache->history_items.num_data;
+	*items_num = 0;
+	*values_num = 0;
 
-	UNLOCK_CACHE;
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_uint64_t	shard_items_num, shard_values_num;
+
+		zbx_hc_get_shard_diag_stats(i, &shard_items_num, &shard_values_num);
+
+		*items_num += shard_items_num;
+		*values_num += shard_values_num;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_hc_get_shard_diag_stats                                      *
+ *                                                                            *
+ * Purpose: get history cache shard diagnostics statistics                    *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_hc_get_shard_diag_stats(int index, zbx_uint64_t *items_num, zbx_uint64_t *values_num)
+{
+	zbx_hc_shard_t	*shard;
+
+	shard = hc_lock_shard(index);
+
+	*values_num = shard->history_num;
+	*items_num = shard->history_items.num_data;
+
+	hc_unlock_shard(index);
 }
 
 /******************************************************************************
@@ -4762,18 +5906,45 @@ void	zbx_hc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num)
  *                                                                            *
  * Purpose: get shared memory allocator statistics                            *
  *                                                                            *
+ * Comments: Statistics of all history cache shards are summed, the minimum   *
+ *           and maximum chunk sizes are calculated over all shards.          *
+ *                                                                            *
  ******************************************************************************/
 void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index)
 {
-	LOCK_CACHE;
+	int		i;
+	zbx_mem_stats_t	data_shard, index_shard;
+
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_hc_get_shard_mem_stats(i, NULL != data ? &data_shard : NULL, NULL != index ? &index_shard : NULL);
+
+		if (NULL != data)
+			hc_mem_stats_add(data, &data_shard, i);
+
+		if (NULL != index)
+			hc_mem_stats_add(index, &index_shard, i);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_hc_get_shard_mem_stats                                       *
+ *                                                                            *
+ * Purpose: get shared memory allocator statistics of history cache shard     *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_hc_get_shard_mem_stats(int index, zbx_mem_stats_t *data, zbx_mem_stats_t *index_mem)
+{
+	hc_lock_shard(index);
 
 	if (NULL != data)
 		zbx_mem_get_stats(hc_mem, data);
 
-	if (NULL != index)
-		zbx_mem_get_stats(hc_index_mem, index);
+	if (NULL != index_mem)
+		zbx_mem_get_stats(hc_index_mem, index_mem);
 
-	UNLOCK_CACHE;
+	hc_unlock_shard(index);
 }
 
 /******************************************************************************
@@ -4785,21 +5956,27 @@ void	zbx_hc_get_mem_stats(zbx_mem_stats_t *data, zbx_mem_stats_t *index)
  ******************************************************************************/
 void	zbx_hc_get_items(zbx_vector_uint64_pair_t *items)
 {
+	int			i;
 	zbx_hashset_iter_t	iter;
 	zbx_hc_item_t		*item;
 
-	LOCK_CACHE;
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_hc_shard_t	*shard;
 
-	zbx_vector_uint64_pair_reserve(items, cache->history_items.num_data);
+		shard = hc_lock_shard(i);
 
-	zbx_hashset_iter_reset(&cache->history_items, &iter);
-	while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
-	{
-		zbx_uint64_pair_t	pair = {item->itemid, item->values_num};
-		zbx_vector_uint64_pair_append_ptr(items, &pair);
-	}
+		zbx_vector_uint64_pair_reserve(items, items->values_num + shard->history_items.num_data);
 
-	UNLOCK_CACHE;
+		zbx_hashset_iter_reset(&shard->history_items, &iter);
+		while (NULL != (item = (zbx_hc_item_t *)zbx_hashset_iter_next(&iter)))
+		{
+			zbx_uint64_pair_t	pair = {item->itemid, item->values_num};
+			zbx_vector_uint64_pair_append_ptr(items, &pair);
+		}
+
+		hc_unlock_shard(i);
+	}
 }
 
 /******************************************************************************
@@ -4927,14 +6104,23 @@ static void	zbx_hc_proxyqueue_clear(void)
  ******************************************************************************/
 int	zbx_hc_check_proxy(zbx_uint64_t proxyid)
 {
-	double	hc_pused;
-	int	ret;
+	double		hc_pused;
+	int		ret, i;
+	zbx_uint64_t	free_size = 0, total_size = 0;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() proxyid:"ZBX_FS_UI64, __func__, proxyid);
 
-	LOCK_CACHE;
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		hc_lock_shard(i);
+		free_size += hc_mem->free_size;
+		total_size += hc_mem->total_size;
+		hc_unlock_shard(i);
+	}
 
-	hc_pused = 100 * (double)(hc_mem->total_size - hc_mem->free_size) / hc_mem->total_size;
+	hc_pused = 100 * (double)(total_size - free_size) / total_size;
+
+	LOCK_CACHE;
 
 	if (20 >= hc_pused)
 	{
@@ -4985,3 +6171,7 @@ out:
 
 	return ret;
 }
+
+#ifdef HAVE_TESTS
+#	include "../../../tests/libs/zbxdbcache/dbcache_test.c"
+#endif
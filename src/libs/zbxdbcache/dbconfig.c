@@ -98,6 +98,7 @@ static zbx_mem_info_t	*config_mem;
 
 extern unsigned char	program_type;
 extern int		CONFIG_TIMER_FORKS;
+extern int		CONFIG_CONF_CACHE_THREADS;
 
 ZBX_MEM_FUNC_IMPL(__config, config_mem)
 
@@ -216,12 +217,21 @@ static unsigned char	poller_by_item(unsigned char type, const char *key)
 			}
 			ZBX_FALLTHROUGH;
 		case ITEM_TYPE_ZABBIX:
+			if (ITEM_TYPE_ZABBIX == type && 0 != CONFIG_AGENTPOLLER_FORKS)
+				return ZBX_POLLER_TYPE_AGENT;
+			ZBX_FALLTHROUGH;
 		case ITEM_TYPE_SNMP:
+			if (ITEM_TYPE_SNMP == type && 0 != CONFIG_SNMPPOLLER_FORKS)
+				return ZBX_POLLER_TYPE_SNMP;
+			ZBX_FALLTHROUGH;
+		case ITEM_TYPE_HTTPAGENT:
+			if (ITEM_TYPE_HTTPAGENT == type && 0 != CONFIG_HTTPAGENTPOLLER_FORKS)
+				return ZBX_POLLER_TYPE_HTTPAGENT;
+			ZBX_FALLTHROUGH;
 		case ITEM_TYPE_EXTERNAL:
 		case ITEM_TYPE_DB_MONITOR:
 		case ITEM_TYPE_SSH:
 		case ITEM_TYPE_TELNET:
-		case ITEM_TYPE_HTTPAGENT:
 		case ITEM_TYPE_SCRIPT:
 			if (0 == CONFIG_POLLER_FORKS)
 				break;
@@ -399,10 +409,33 @@ static void	DCitem_poller_type_update(ZBX_DC_ITEM *dc_item, const ZBX_DC_HOST *d
 
 	poller_type = poller_by_item(dc_item->type, dc_item->key);
 
+	/* asynchronous agent pollers do not support encrypted connections */
+	if (ZBX_POLLER_TYPE_AGENT == poller_type && ZBX_TCP_SEC_UNENCRYPTED != dc_host->tls_connect)
+		poller_type = (0 != CONFIG_POLLER_FORKS ? ZBX_POLLER_TYPE_NORMAL : ZBX_NO_POLLER);
+
+	/* asynchronous SNMP pollers do not walk OID trees, so discovery rules */
+	/* and OIDs with dynamic index are processed by regular pollers        */
+	if (ZBX_POLLER_TYPE_SNMP == poller_type)
+	{
+		const ZBX_DC_SNMPITEM	*snmpitem;
+
+		snmpitem = (const ZBX_DC_SNMPITEM *)zbx_hashset_search(&config->snmpitems, &dc_item->itemid);
+
+		if (0 != (ZBX_FLAG_DISCOVERY_RULE & dc_item->flags) || NULL == snmpitem ||
+				ZBX_SNMP_OID_TYPE_DYNAMIC == snmpitem->snmp_oid_type)
+		{
+			poller_type = (0 != CONFIG_POLLER_FORKS ? ZBX_POLLER_TYPE_NORMAL : ZBX_NO_POLLER);
+		}
+	}
+
 	if (0 != (flags & ZBX_HOST_UNREACHABLE))
 	{
-		if (ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_JAVA == poller_type)
+		if (ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_JAVA == poller_type ||
+				ZBX_POLLER_TYPE_AGENT == poller_type || ZBX_POLLER_TYPE_SNMP == poller_type ||
+				ZBX_POLLER_TYPE_HTTPAGENT == poller_type)
+		{
 			poller_type = ZBX_POLLER_TYPE_UNREACHABLE;
+		}
 
 		dc_item->poller_type = poller_type;
 		return;
@@ -414,8 +447,9 @@ static void	DCitem_poller_type_update(ZBX_DC_ITEM *dc_item, const ZBX_DC_HOST *d
 		return;
 	}
 
-	if (ZBX_POLLER_TYPE_UNREACHABLE != dc_item->poller_type ||
-			(ZBX_POLLER_TYPE_NORMAL != poller_type && ZBX_POLLER_TYPE_JAVA != poller_type))
+	if (ZBX_POLLER_TYPE_UNREACHABLE != dc_item->poller_type || (ZBX_POLLER_TYPE_NORMAL != poller_type &&
+			ZBX_POLLER_TYPE_JAVA != poller_type && ZBX_POLLER_TYPE_AGENT != poller_type &&
+			ZBX_POLLER_TYPE_SNMP != poller_type && ZBX_POLLER_TYPE_HTTPAGENT != poller_type))
 	{
 		dc_item->poller_type = poller_type;
 	}
@@ -1531,6 +1565,7 @@ done:
 			{
 				proxy->location = ZBX_LOC_NOWHERE;
 				proxy->version = 0;
+				proxy->accept_codecs = 0;
 				proxy->lastaccess = atoi(row[12]);
 				proxy->last_cfg_error_time = 0;
 				proxy->proxy_delay = 0;
@@ -5938,7 +5973,8 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 			correlation_sec, correlation_sec2, corr_condition_sec, corr_condition_sec2, corr_operation_sec,
 			corr_operation_sec2, hgroups_sec, hgroups_sec2, itempp_sec, itempp_sec2, itemscrp_sec,
 			itemscrp_sec2, total, total2, update_sec, maintenance_sec, maintenance_sec2, item_tag_sec,
-			item_tag_sec2;
+			item_tag_sec2, hgroup_host_sec, maintenance_tag_sec, maintenance_period_sec,
+			maintenance_group_sec, maintenance_host_sec, template_isec, prototype_isec;
 
 	zbx_dbsync_t	config_sync, hosts_sync, hi_sync, htmpl_sync, gmacro_sync, hmacro_sync, if_sync, items_sync,
 			template_items_sync, prototype_items_sync, triggers_sync, tdep_sync, func_sync, expr_sync,
@@ -5952,6 +5988,7 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	zbx_uint64_t	update_flags = 0;
 
 	zbx_hashset_t		trend_queue;
+	zbx_dbsync_tasks_t	tasks;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -6012,6 +6049,9 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	zbx_dbsync_init(&maintenance_group_sync, mode);
 	zbx_dbsync_init(&maintenance_host_sync, mode);
 
+	if (FAIL == zbx_dbsync_env_prepare(mode))
+		goto out;
+
 	sec = zbx_time();
 	if (FAIL == zbx_dbsync_compare_config(&config_sync))
 		goto out;
@@ -6035,25 +6075,22 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 
 	/* sync macro related data, to support macro resolving during configuration sync */
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_host_templates(&htmpl_sync))
-		goto out;
-	htsec = zbx_time() - sec;
+	zbx_dbsync_tasks_init(&tasks);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_host_templates, &htmpl_sync, &htsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_global_macros, &gmacro_sync, &gmsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_host_macros, &hmacro_sync, &hmsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_host_tags, &host_tag_sync, &host_tag_sec, 0);
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_global_macros(&gmacro_sync))
+	if (FAIL == zbx_dbsync_tasks_execute(&tasks, CONFIG_CONF_CACHE_THREADS))
 		goto out;
-	gmsec = zbx_time() - sec;
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_host_macros(&hmacro_sync))
-		goto out;
-	hmsec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_host_tags(&host_tag_sync))
-		goto out;
-	host_tag_sec = zbx_time() - sec;
+	/* macros are expanded during item and trigger compare and template links are not logged in changelog */
+	if (0 != htmpl_sync.add_num + htmpl_sync.update_num + htmpl_sync.remove_num ||
+			0 != gmacro_sync.add_num + gmacro_sync.update_num + gmacro_sync.remove_num ||
+			0 != hmacro_sync.add_num + hmacro_sync.update_num + hmacro_sync.remove_num)
+	{
+		zbx_dbsync_env_disable_changelog();
+	}
 
 	START_SYNC;
 	sec = zbx_time();
@@ -6081,35 +6118,26 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 
 	/* sync host data to support host lookups when resolving macros during configuration sync */
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_hosts(&hosts_sync))
+	zbx_dbsync_tasks_init(&tasks);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_hosts, &hosts_sync, &hsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_host_inventory, &hi_sync, &hisec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_host_groups, &hgroups_sync, &hgroups_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_host_group_hosts, &hgroup_host_sync, &hgroup_host_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_maintenances, &maintenance_sync, &maintenance_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_maintenance_tags, &maintenance_tag_sync,
+			&maintenance_tag_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_maintenance_periods, &maintenance_period_sync,
+			&maintenance_period_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_maintenance_groups, &maintenance_group_sync,
+			&maintenance_group_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_maintenance_hosts, &maintenance_host_sync,
+			&maintenance_host_sec, 0);
+
+	if (FAIL == zbx_dbsync_tasks_execute(&tasks, CONFIG_CONF_CACHE_THREADS))
 		goto out;
-	hsec = zbx_time() - sec;
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_host_inventory(&hi_sync))
-		goto out;
-	hisec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_host_groups(&hgroups_sync))
-		goto out;
-	if (FAIL == zbx_dbsync_compare_host_group_hosts(&hgroup_host_sync))
-		goto out;
-	hgroups_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_maintenances(&maintenance_sync))
-		goto out;
-	if (FAIL == zbx_dbsync_compare_maintenance_tags(&maintenance_tag_sync))
-		goto out;
-	if (FAIL == zbx_dbsync_compare_maintenance_periods(&maintenance_period_sync))
-		goto out;
-	if (FAIL == zbx_dbsync_compare_maintenance_groups(&maintenance_group_sync))
-		goto out;
-	if (FAIL == zbx_dbsync_compare_maintenance_hosts(&maintenance_host_sync))
-		goto out;
-	maintenance_sec = zbx_time() - sec;
+	hgroups_sec += hgroup_host_sec;
+	maintenance_sec += maintenance_tag_sec + maintenance_period_sec + maintenance_group_sec + maintenance_host_sec;
 
 	START_SYNC;
 	sec = zbx_time();
@@ -6151,34 +6179,26 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 
 	/* sync item data to support item lookups when resolving macros during configuration sync */
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_interfaces(&if_sync))
-		goto out;
-	ifsec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_items(&items_sync))
-		goto out;
+	/* item preprocessing compare relies on removed items, so it follows item compare */
+	zbx_dbsync_tasks_init(&tasks);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_items, &items_sync, &isec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_item_preprocs, &itempp_sync, &itempp_sec, 1);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_interfaces, &if_sync, &ifsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_template_items, &template_items_sync, &template_isec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_prototype_items, &prototype_items_sync, &prototype_isec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_item_script_param, &itemscrp_sync, &itemscrp_sec, 0);
 
-	if (FAIL == zbx_dbsync_compare_template_items(&template_items_sync))
+	if (FAIL == zbx_dbsync_tasks_execute(&tasks, CONFIG_CONF_CACHE_THREADS))
 		goto out;
 
-	if (FAIL == zbx_dbsync_compare_prototype_items(&prototype_items_sync))
-		goto out;
-	isec = zbx_time() - sec;
+	isec += template_isec + prototype_isec;
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_item_preprocs(&itempp_sync))
-		goto out;
-	itempp_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_item_script_param(&itemscrp_sync))
-		goto out;
-	itemscrp_sec = zbx_time() - sec;
+	/* Changes are applied in several short write locked windows instead of a single long one, so readers */
+	/* can proceed between them. Only data that must be consistent for readers is applied in one window.   */
 
+	/* items are applied together with their interfaces and preprocessing, so that readers never see new */
+	/* items with old interfaces or preprocessing steps                                                   */
 	START_SYNC;
-
 	/* resolves macros for interface_snmpaddrs, must be after DCsync_hmacros() */
 	sec = zbx_time();
 	DCsync_interfaces(&if_sync);
@@ -6209,15 +6229,12 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	/* sync function data to support function lookups when resolving macros during configuration sync */
 
 	/* relies on items, must be after DCsync_items() */
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_item_tags(&item_tag_sync))
-		goto out;
-	item_tag_sec = zbx_time() - sec;
+	zbx_dbsync_tasks_init(&tasks);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_functions, &func_sync, &fsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_item_tags, &item_tag_sync, &item_tag_sec, 0);
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_functions(&func_sync))
+	if (FAIL == zbx_dbsync_tasks_execute(&tasks, CONFIG_CONF_CACHE_THREADS))
 		goto out;
-	fsec = zbx_time() - sec;
 
 	START_SYNC;
 	sec = zbx_time();
@@ -6227,70 +6244,35 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 
 	/* sync rest of the data */
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_triggers(&triggers_sync))
-		goto out;
-	tsec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_trigger_dependency(&tdep_sync))
+	/* trigger tag compare relies on removed triggers, so it follows trigger compare */
+	zbx_dbsync_tasks_init(&tasks);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_triggers, &triggers_sync, &tsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_trigger_tags, &trigger_tag_sync, &trigger_tag_sec, 1);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_trigger_dependency, &tdep_sync, &dsec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_expressions, &expr_sync, &expr_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_actions, &action_sync, &action_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_action_ops, &action_op_sync, &action_op_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_action_conditions, &action_condition_sync,
+			&action_condition_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_correlations, &correlation_sync, &correlation_sec, 0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_corr_conditions, &corr_condition_sync, &corr_condition_sec,
+			0);
+	zbx_dbsync_tasks_add(&tasks, zbx_dbsync_compare_corr_operations, &corr_operation_sync, &corr_operation_sec,
+			0);
+
+	if (FAIL == zbx_dbsync_tasks_execute(&tasks, CONFIG_CONF_CACHE_THREADS))
 		goto out;
-	dsec = zbx_time() - sec;
 
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_expressions(&expr_sync))
-		goto out;
-	expr_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_actions(&action_sync))
-		goto out;
-	action_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_action_ops(&action_op_sync))
-		goto out;
-	action_op_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_action_conditions(&action_condition_sync))
-		goto out;
-	action_condition_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_trigger_tags(&trigger_tag_sync))
-		goto out;
-	trigger_tag_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_correlations(&correlation_sync))
-		goto out;
-	correlation_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_corr_conditions(&corr_condition_sync))
-		goto out;
-	corr_condition_sec = zbx_time() - sec;
-
-	sec = zbx_time();
-	if (FAIL == zbx_dbsync_compare_corr_operations(&corr_operation_sync))
-		goto out;
-	corr_operation_sec = zbx_time() - sec;
+	/* changelog is flushed before locking configuration cache */
+	zbx_dbsync_env_flush_changelog();
 
 	START_SYNC;
-
-	sec = zbx_time();
-	DCsync_triggers(&triggers_sync);
-	tsec2 = zbx_time() - sec;
-
-	sec = zbx_time();
-	DCsync_trigdeps(&tdep_sync);
-	dsec2 = zbx_time() - sec;
-
 	sec = zbx_time();
 	DCsync_expressions(&expr_sync);
 	expr_sec2 = zbx_time() - sec;
+	FINISH_SYNC;
 
+	START_SYNC;
 	sec = zbx_time();
 	DCsync_actions(&action_sync);
 	action_sec2 = zbx_time() - sec;
@@ -6302,16 +6284,9 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	sec = zbx_time();
 	DCsync_action_conditions(&action_condition_sync);
 	action_condition_sec2 = zbx_time() - sec;
+	FINISH_SYNC;
 
-	sec = zbx_time();
-	/* relies on triggers, must be after DCsync_triggers() */
-	DCsync_trigger_tags(&trigger_tag_sync);
-	trigger_tag_sec2 = zbx_time() - sec;
-
-	sec = zbx_time();
-	DCsync_item_tags(&item_tag_sync);
-	item_tag_sec2 = zbx_time() - sec;
-
+	START_SYNC;
 	sec = zbx_time();
 	DCsync_correlations(&correlation_sync);
 	correlation_sec2 = zbx_time() - sec;
@@ -6325,6 +6300,30 @@ void	DCsync_configuration(unsigned char mode, const struct zbx_json_parse *jp_kv
 	/* relies on correlation rules, must be after DCsync_correlations() */
 	DCsync_corr_operations(&corr_operation_sync);
 	corr_operation_sec2 = zbx_time() - sec;
+	FINISH_SYNC;
+
+	START_SYNC;
+	sec = zbx_time();
+	DCsync_item_tags(&item_tag_sync);
+	item_tag_sec2 = zbx_time() - sec;
+	FINISH_SYNC;
+
+	/* triggers must be applied in the same window with trigger cache update, */
+	/* because items reference cached triggers until the cache is updated     */
+	START_SYNC;
+
+	sec = zbx_time();
+	DCsync_triggers(&triggers_sync);
+	tsec2 = zbx_time() - sec;
+
+	sec = zbx_time();
+	DCsync_trigdeps(&tdep_sync);
+	dsec2 = zbx_time() - sec;
+
+	sec = zbx_time();
+	/* relies on triggers, must be after DCsync_triggers() */
+	DCsync_trigger_tags(&trigger_tag_sync);
+	trigger_tag_sec2 = zbx_time() - sec;
 
 	sec = zbx_time();
 
@@ -9450,6 +9449,8 @@ static void	dc_requeue_item_at(ZBX_DC_ITEM *dc_item, ZBX_DC_HOST *dc_host, int n
  * Purpose: Get array of items for selected poller                            *
  *                                                                            *
  * Parameters: poller_type - [IN] poller type (ZBX_POLLER_TYPE_...)           *
+ *             free_slots  - [IN] the number of checks asynchronous poller    *
+ *                                can start, ignored by other pollers         *
  *             items       - [OUT] array of items                             *
  *                                                                            *
  * Return value: number of items in items array                               *
@@ -9460,15 +9461,17 @@ static void	dc_requeue_item_at(ZBX_DC_ITEM *dc_item, ZBX_DC_HOST *dc_host, int n
  *           always return the items they have taken using DCrequeue_items()  *
  *           or DCpoller_requeue_items().                                     *
  *                                                                            *
- *           Currently batch polling is supported only for JMX, SNMP and      *
- *           icmpping* simple checks. In other cases only single item is      *
- *           retrieved.                                                       *
+ *           Currently batch polling is supported only for JMX, SNMP,         *
+ *           icmpping* simple checks and asynchronous agent and HTTP agent    *
+ *           checks. In other cases only single item is retrieved.            *
+ *           Asynchronous SNMP pollers get a batch of items of one interface  *
+ *           per call.                                                        *
  *                                                                            *
  *           IPMI poller queue are handled by DCconfig_get_ipmi_poller_items()*
  *           function.                                                        *
  *                                                                            *
  ******************************************************************************/
-int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
+int	DCconfig_get_poller_items(unsigned char poller_type, int free_slots, DC_ITEM **items)
 {
 	int			now, num = 0, max_items;
 	zbx_binary_heap_t	*queue;
@@ -9487,6 +9490,10 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
 		case ZBX_POLLER_TYPE_PINGER:
 			max_items = MAX_PINGER_ITEMS;
 			break;
+		case ZBX_POLLER_TYPE_AGENT:
+		case ZBX_POLLER_TYPE_HTTPAGENT:
+			max_items = MIN(free_slots, MAX_POLLER_ITEMS);
+			break;
 		default:
 			max_items = 1;
 	}
@@ -9558,7 +9565,8 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
 				/* postpone checks on hosts that have been checked recently and */
 				/* are still unreachable                                        */
 				if (ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_JAVA == poller_type ||
-						disable_until > now)
+						ZBX_POLLER_TYPE_AGENT == poller_type || ZBX_POLLER_TYPE_SNMP == poller_type ||
+						ZBX_POLLER_TYPE_HTTPAGENT == poller_type || disable_until > now)
 				{
 					dc_requeue_item(dc_item, dc_host, dc_interface,
 							ZBX_ITEM_COLLECTED | ZBX_HOST_UNREACHABLE, now);
@@ -9571,8 +9579,8 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
 
 		if (0 == num)
 		{
-			if (ZBX_POLLER_TYPE_NORMAL == poller_type && ITEM_TYPE_SNMP == dc_item->type &&
-					0 == (ZBX_FLAG_DISCOVERY_RULE & dc_item->flags))
+			if ((ZBX_POLLER_TYPE_NORMAL == poller_type || ZBX_POLLER_TYPE_SNMP == poller_type) &&
+					ITEM_TYPE_SNMP == dc_item->type && 0 == (ZBX_FLAG_DISCOVERY_RULE & dc_item->flags))
 			{
 				ZBX_DC_SNMPITEM	*snmpitem;
 
@@ -9583,6 +9591,9 @@ int	DCconfig_get_poller_items(unsigned char poller_type, DC_ITEM **items)
 				{
 					max_items = DCconfig_get_suggested_snmp_vars_nolock(dc_item->interfaceid, NULL);
 				}
+
+				if (ZBX_POLLER_TYPE_SNMP == poller_type && max_items > free_slots)
+					max_items = free_slots;
 			}
 
 			if (1 < max_items)
@@ -9932,6 +9943,52 @@ void	zbx_dc_requeue_unreachable_items(zbx_uint64_t *itemids, size_t itemids_num)
 	UNLOCK_CACHE;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dc_requeue_unchecked_items                                   *
+ *                                                                            *
+ * Purpose: return items to the queue without polling them                    *
+ *                                                                            *
+ * Parameters: itemids     - [IN] the item id array                           *
+ *             itemids_num - [IN] the number of values in itemids array       *
+ *                                                                            *
+ * Comments: The items keep their scheduled check time and poller type is     *
+ *           updated. For example when host encryption settings are changed   *
+ *           after asynchronous poller has taken its agent items, the items   *
+ *           are moved to regular pollers.                                    *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dc_requeue_unchecked_items(const zbx_uint64_t *itemids, size_t itemids_num)
+{
+	size_t		i;
+	ZBX_DC_ITEM	*dc_item;
+	ZBX_DC_HOST	*dc_host;
+
+	WRLOCK_CACHE;
+
+	for (i = 0; i < itemids_num; i++)
+	{
+		if (NULL == (dc_item = (ZBX_DC_ITEM *)zbx_hashset_search(&config->items, &itemids[i])))
+			continue;
+
+		if (ZBX_LOC_POLLER == dc_item->location)
+			dc_item->location = ZBX_LOC_NOWHERE;
+
+		if (ITEM_STATUS_ACTIVE != dc_item->status)
+			continue;
+
+		if (NULL == (dc_host = (ZBX_DC_HOST *)zbx_hashset_search(&config->hosts, &dc_item->hostid)))
+			continue;
+
+		if (HOST_STATUS_MONITORED != dc_host->status)
+			continue;
+
+		dc_requeue_item_at(dc_item, dc_host, dc_item->nextcheck);
+	}
+
+	UNLOCK_CACHE;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: DCinterface_get_agent_availability                               *
@@ -10665,6 +10722,7 @@ static void	DCget_proxy(DC_PROXY *dst_proxy, const ZBX_DC_PROXY *src_proxy)
 	dst_proxy->version = src_proxy->version;
 	dst_proxy->lastaccess = src_proxy->lastaccess;
 	dst_proxy->auto_compress = src_proxy->auto_compress;
+	dst_proxy->accept_codecs = src_proxy->accept_codecs;
 	dst_proxy->last_version_error_time = src_proxy->last_version_error_time;
 
 	if (NULL != (host = (const ZBX_DC_HOST *)zbx_hashset_search(&config->hosts, &src_proxy->hostid)))
@@ -13599,6 +13657,16 @@ void	zbx_dc_update_proxy(zbx_proxy_diff_t *diff)
 			else
 				diff->flags &= (~ZBX_FLAGS_PROXY_DIFF_UPDATE_COMPRESS);
 		}
+
+		if (0 != (diff->flags & ZBX_FLAGS_PROXY_DIFF_UPDATE_CODECS))
+		{
+			/* advertised codecs are kept only in cache */
+			if (proxy->accept_codecs != diff->codecs)
+				proxy->accept_codecs = diff->codecs;
+
+			diff->flags &= (~ZBX_FLAGS_PROXY_DIFF_UPDATE_CODECS);
+		}
+
 		if (0 != (diff->flags & ZBX_FLAGS_PROXY_DIFF_UPDATE_LASTERROR))
 		{
 			if (proxy->last_version_error_time != diff->last_version_error_time)
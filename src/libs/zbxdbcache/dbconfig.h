@@ -376,6 +376,7 @@ typedef struct
 	int			last_cfg_error_time;	/* time when passive proxy misconfiguration error was seen */
 							/* or 0 if no error */
 	int			version;
+	int			accept_codecs;		/* compression codecs advertised by proxy */
 	unsigned char		location;
 	unsigned char		auto_compress;
 	const char		*proxy_address;
@@ -28,16 +28,66 @@
 #include "dbconfig.h"
 #include "dbsync.h"
 
+/* configuration objects tracked in changelog table, must match CHANGELOG entries in schema */
+#define ZBX_DBSYNC_OBJ_HOST		1
+#define ZBX_DBSYNC_OBJ_HOST_TAG		2
+#define ZBX_DBSYNC_OBJ_ITEM		3
+#define ZBX_DBSYNC_OBJ_ITEM_TAG		4
+#define ZBX_DBSYNC_OBJ_TRIGGER		5
+#define ZBX_DBSYNC_OBJ_TRIGGER_TAG	6
+#define ZBX_DBSYNC_OBJ_FUNCTION		7
+#define ZBX_DBSYNC_OBJ_ITEM_PREPROC	8
+#define ZBX_DBSYNC_OBJ_COUNT		9
+
+/* changelog operations */
+#define ZBX_DBSYNC_OP_INSERT		1
+#define ZBX_DBSYNC_OP_UPDATE		2
+#define ZBX_DBSYNC_OP_DELETE		3
+
+/* above this number of changelog records full compare is cheaper than selecting changed rows */
+#define ZBX_DBSYNC_CHANGELOG_MAX	100000
+
+/* the period of full compare, done to ensure configuration cache consistency */
+#define ZBX_DBSYNC_FULL_COMPARE_PERIOD	SEC_PER_HOUR
+
+#define ZBX_DBSYNC_BATCH_SIZE		1000
+
+/* the object identifier field used to select changed rows */
 typedef struct
 {
-	zbx_hashset_t	strpool;
-	ZBX_DC_CONFIG	*cache;
+	unsigned char	object;
+	const char	*field;
+}
+zbx_dbsync_field_t;
+
+typedef struct
+{
+	zbx_hashset_t		strpool;
+	ZBX_DC_CONFIG		*cache;
+
+	/* SUCCEED - only objects registered in changelog are synchronized, FAIL - full compare */
+	int			changelog_mode;
+
+	/* the changelog records read during this synchronization */
+	zbx_vector_uint64_t	changelogids;
+
+	/* the changed objects, indexed by ZBX_DBSYNC_OBJ_* defines */
+	zbx_vector_uint64_t	changes[ZBX_DBSYNC_OBJ_COUNT];
+
+	/* the identifiers of objects removed during this synchronization, either explicitly or by cascade, */
+	/* indexed by ZBX_DBSYNC_OBJ_* defines - kept per object so compare threads do not share hashsets    */
+	zbx_hashset_t		removed[ZBX_DBSYNC_OBJ_COUNT];
+
+	/* the time of the last full compare */
+	time_t			full_compare_ts;
 }
 zbx_dbsync_env_t;
 
 static zbx_dbsync_env_t	dbsync_env;
 
-/* string pool support */
+/* string pool support, the pool is shared by compare threads */
+
+static pthread_mutex_t	strpool_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #define REFCOUNT_FIELD_SIZE	sizeof(zbx_uint32_t)
 
@@ -55,6 +105,8 @@ static char	*dbsync_strdup(const char *str)
 {
 	void	*ptr;
 
+	pthread_mutex_lock(&strpool_lock);
+
 	ptr = zbx_hashset_search(&dbsync_env.strpool, str - REFCOUNT_FIELD_SIZE);
 
 	if (NULL == ptr)
@@ -67,6 +119,8 @@ static char	*dbsync_strdup(const char *str)
 
 	(*(zbx_uint32_t *)ptr)++;
 
+	pthread_mutex_unlock(&strpool_lock);
+
 	return (char *)ptr + REFCOUNT_FIELD_SIZE;
 }
 
@@ -76,8 +130,12 @@ static void	dbsync_strfree(char *str)
 	{
 		void	*ptr = str - REFCOUNT_FIELD_SIZE;
 
+		pthread_mutex_lock(&strpool_lock);
+
 		if (0 == --(*(zbx_uint32_t *)ptr))
 			zbx_hashset_remove_direct(&dbsync_env.strpool, ptr);
+
+		pthread_mutex_unlock(&strpool_lock);
 	}
 }
 
@@ -269,6 +327,159 @@ static char	**dbsync_preproc_row(zbx_dbsync_t *sync, char **row)
 	return sync->row;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_remove                                          *
+ *                                                                            *
+ * Purpose: adds object removal row to the changeset and registers the        *
+ *          object as removed                                                 *
+ *                                                                            *
+ * Parameter: sync     - [IN] the changeset                                   *
+ *            object   - [IN] the object type (see ZBX_DBSYNC_OBJ_* defines)  *
+ *            objectid - [IN] the object identifier                           *
+ *                                                                            *
+ * Comments: Registered removals are used to remove child objects, as cascade *
+ *           deletes are not logged by triggers on all databases.             *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_changelog_remove(zbx_dbsync_t *sync, unsigned char object, zbx_uint64_t objectid)
+{
+	dbsync_add_row(sync, objectid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+	zbx_hashset_insert(&dbsync_env.removed[object], &objectid, sizeof(objectid));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_is_removed                                      *
+ *                                                                            *
+ * Purpose: checks if the object was removed during this synchronization      *
+ *                                                                            *
+ * Parameter: object   - [IN] the object type (see ZBX_DBSYNC_OBJ_* defines)  *
+ *            objectid - [IN] the object identifier                           *
+ *                                                                            *
+ * Return value: SUCCEED - the object was removed                             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_changelog_is_removed(unsigned char object, zbx_uint64_t objectid)
+{
+	return NULL == zbx_hashset_search(&dbsync_env.removed[object], &objectid) ? FAIL : SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_changelog_remove_rows                                     *
+ *                                                                            *
+ * Purpose: adds removal rows for changed cached objects that were not        *
+ *          returned by database                                              *
+ *                                                                            *
+ * Parameter: sync    - [IN] the changeset                                    *
+ *            object  - [IN] the object type (see ZBX_DBSYNC_OBJ_* defines)   *
+ *            ids     - [IN/OUT] the identifiers of objects returned by       *
+ *                               database, removed objects are added to it    *
+ *            objects - [IN] the cached objects                               *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_changelog_remove_rows(zbx_dbsync_t *sync, unsigned char object, zbx_hashset_t *ids,
+		zbx_hashset_t *objects)
+{
+	zbx_vector_uint64_t	*objectids = &dbsync_env.changes[object];
+	int			i;
+
+	for (i = 0; i < objectids->values_num; i++)
+	{
+		zbx_uint64_t	objectid = objectids->values[i];
+
+		if (NULL != zbx_hashset_search(ids, &objectid) || NULL == zbx_hashset_search(objects, &objectid))
+			continue;
+
+		dbsync_changelog_remove(sync, object, objectid);
+		zbx_hashset_insert(ids, &objectid, sizeof(objectid));
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_rows_estimate                                             *
+ *                                                                            *
+ * Purpose: estimates the number of rows returned by database                 *
+ *                                                                            *
+ * Parameter: object      - [IN] the object type (ZBX_DBSYNC_OBJ_* defines)   *
+ *            objects_num - [IN] the number of cached objects                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_rows_estimate(unsigned char object, int objects_num)
+{
+	if (SUCCEED == dbsync_env.changelog_mode)
+		return dbsync_env.changes[object].values_num;
+
+	return objects_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_select                                                    *
+ *                                                                            *
+ * Purpose: selects either all rows or, in changelog mode, only the rows of   *
+ *          changed objects                                                   *
+ *                                                                            *
+ * Parameter: sql        - [IN] the base sql query, freed by this function    *
+ *            sql_alloc  - [IN] the sql query buffer size                     *
+ *            sql_offset - [IN] the sql query length                          *
+ *            clause     - [IN] the clause to prefix changed row condition    *
+ *                              with (" where" or " and")                     *
+ *            fields     - [IN] the changed object identifier fields,         *
+ *                              terminated by an entry with NULL field        *
+ *            suffix     - [IN] the query suffix (can be NULL)                *
+ *            result     - [OUT] the query result, NULL if there were no      *
+ *                               changes to select                            *
+ *                                                                            *
+ * Return value: SUCCEED - the rows were selected                             *
+ *               FAIL    - database error                                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_select(char **sql, size_t *sql_alloc, size_t *sql_offset, const char *clause,
+		const zbx_dbsync_field_t *fields, const char *suffix, DB_RESULT *result)
+{
+	int	ret = SUCCEED, conditions_num = 0;
+
+	*result = NULL;
+
+	if (SUCCEED == dbsync_env.changelog_mode)
+	{
+		for (; NULL != fields->field; fields++)
+		{
+			zbx_vector_uint64_t	*objectids = &dbsync_env.changes[fields->object];
+
+			if (0 == objectids->values_num)
+				continue;
+
+			zbx_strcpy_alloc(sql, sql_alloc, sql_offset, 0 == conditions_num++ ? clause : " or");
+
+			if (1 == conditions_num)
+				zbx_strcpy_alloc(sql, sql_alloc, sql_offset, " (");
+
+			DBadd_condition_alloc(sql, sql_alloc, sql_offset, fields->field, objectids->values,
+					objectids->values_num);
+		}
+
+		if (0 == conditions_num)
+			goto out;
+
+		zbx_chrcpy_alloc(sql, sql_alloc, sql_offset, ')');
+	}
+
+	if (NULL != suffix)
+		zbx_strcpy_alloc(sql, sql_alloc, sql_offset, suffix);
+
+	if (NULL == (*result = DBselect("%s", *sql)))
+		ret = FAIL;
+out:
+	zbx_free(*sql);
+
+	return ret;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_dbsync_init_env                                              *
@@ -276,8 +487,20 @@ static char	**dbsync_preproc_row(zbx_dbsync_t *sync, char **row)
  ******************************************************************************/
 void	zbx_dbsync_init_env(ZBX_DC_CONFIG *cache)
 {
+	int	i;
+
 	dbsync_env.cache = cache;
 	zbx_hashset_create(&dbsync_env.strpool, 100, dbsync_strpool_hash_func, dbsync_strpool_compare_func);
+
+	dbsync_env.changelog_mode = FAIL;
+	zbx_vector_uint64_create(&dbsync_env.changelogids);
+
+	for (i = 0; i < ZBX_DBSYNC_OBJ_COUNT; i++)
+	{
+		zbx_vector_uint64_create(&dbsync_env.changes[i]);
+		zbx_hashset_create(&dbsync_env.removed[i], 0, ZBX_DEFAULT_UINT64_HASH_FUNC,
+				ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	}
 }
 
 /******************************************************************************
@@ -287,9 +510,151 @@ void	zbx_dbsync_init_env(ZBX_DC_CONFIG *cache)
  ******************************************************************************/
 void	zbx_dbsync_free_env(void)
 {
+	int	i;
+
+	for (i = 0; i < ZBX_DBSYNC_OBJ_COUNT; i++)
+	{
+		zbx_hashset_destroy(&dbsync_env.removed[i]);
+		zbx_vector_uint64_destroy(&dbsync_env.changes[i]);
+	}
+
+	zbx_vector_uint64_destroy(&dbsync_env.changelogids);
 	zbx_hashset_destroy(&dbsync_env.strpool);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_prepare                                           *
+ *                                                                            *
+ * Purpose: reads changelog and decides if the configuration can be           *
+ *          synchronized incrementally                                        *
+ *                                                                            *
+ * Parameter: mode - [IN] the synchronization mode (ZBX_DBSYNC_INIT or        *
+ *                        ZBX_DBSYNC_UPDATE)                                  *
+ *                                                                            *
+ * Return value: SUCCEED - the changelog was read                             *
+ *               FAIL    - database error                                     *
+ *                                                                            *
+ * Comments: All changelog records are read also during full synchronization, *
+ *           so they could be flushed afterwards.                             *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_dbsync_env_prepare(unsigned char mode)
+{
+	DB_RESULT	result;
+	DB_ROW		row;
+	time_t		now;
+	int		i;
+
+	if (NULL == (result = DBselect("select changelogid,object,objectid,operation from changelog")))
+		return FAIL;
+
+	while (NULL != (row = DBfetch(result)))
+	{
+		zbx_uint64_t	changelogid, objectid;
+		unsigned char	object;
+
+		ZBX_STR2UINT64(changelogid, row[0]);
+		zbx_vector_uint64_append(&dbsync_env.changelogids, changelogid);
+
+		ZBX_STR2UCHAR(object, row[1]);
+
+		if (0 == object || ZBX_DBSYNC_OBJ_COUNT <= object)
+		{
+			THIS_SHOULD_NEVER_HAPPEN;
+			continue;
+		}
+
+		ZBX_STR2UINT64(objectid, row[2]);
+		zbx_vector_uint64_append(&dbsync_env.changes[object], objectid);
+
+		if (ZBX_DBSYNC_OP_DELETE == atoi(row[3]))
+			zbx_hashset_insert(&dbsync_env.removed[object], &objectid, sizeof(objectid));
+	}
+	DBfree_result(result);
+
+	for (i = 0; i < ZBX_DBSYNC_OBJ_COUNT; i++)
+	{
+		zbx_vector_uint64_sort(&dbsync_env.changes[i], ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+		zbx_vector_uint64_uniq(&dbsync_env.changes[i], ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	}
+
+	now = time(NULL);
+
+	if (ZBX_DBSYNC_INIT == mode || ZBX_DBSYNC_CHANGELOG_MAX < dbsync_env.changelogids.values_num ||
+			ZBX_DBSYNC_FULL_COMPARE_PERIOD <= now - dbsync_env.full_compare_ts)
+	{
+		dbsync_env.full_compare_ts = now;
+		dbsync_env.changelog_mode = FAIL;
+	}
+	else
+		dbsync_env.changelog_mode = SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() changelog records:%d mode:%s", __func__,
+			dbsync_env.changelogids.values_num,
+			SUCCEED == dbsync_env.changelog_mode ? "changelog" : "full compare");
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_disable_changelog                                 *
+ *                                                                            *
+ * Purpose: switches the rest of synchronization to full compare              *
+ *                                                                            *
+ * Comments: Used when changes not tracked by changelog (like user macros)    *
+ *           can affect the synchronized rows.                                *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_disable_changelog(void)
+{
+	dbsync_env.changelog_mode = FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_env_flush_changelog                                   *
+ *                                                                            *
+ * Purpose: removes processed records from changelog                          *
+ *                                                                            *
+ * Comments: Records are removed by identifiers rather than range, because    *
+ *           records with lower identifiers can be committed later by         *
+ *           concurrent transactions.                                         *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_env_flush_changelog(void)
+{
+	char	*sql = NULL;
+	size_t	sql_alloc = 0, sql_offset;
+	int	i, batch_num;
+
+	if (0 == dbsync_env.changelogids.values_num)
+		return;
+
+	zbx_vector_uint64_sort(&dbsync_env.changelogids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+	DBbegin();
+
+	for (i = 0; i < dbsync_env.changelogids.values_num; i += ZBX_DBSYNC_BATCH_SIZE)
+	{
+		batch_num = MIN(ZBX_DBSYNC_BATCH_SIZE, dbsync_env.changelogids.values_num - i);
+
+		sql_offset = 0;
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, "delete from changelog where");
+		DBadd_condition_alloc(&sql, &sql_alloc, &sql_offset, "changelogid", dbsync_env.changelogids.values + i,
+				batch_num);
+
+		if (ZBX_DB_OK > DBexecute("%s", sql))
+			break;
+	}
+
+	DBcommit();
+
+	zbx_free(sql);
+	zbx_vector_uint64_clear(&dbsync_env.changelogids);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_dbsync_init                                                  *
@@ -756,9 +1121,12 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_HOST		*host;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_HOST, "hostid"}, {0}};
 
 #if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select hostid,proxy_hostid,host,ipmi_authtype,ipmi_privilege,ipmi_username,"
 				"ipmi_password,maintenance_status,maintenance_type,maintenance_from,"
 				"status,name,lastaccess,tls_connect,tls_accept,tls_issuer,tls_subject,"
@@ -768,14 +1136,14 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 				" and flags<>%d",
 			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
 			HOST_STATUS_PROXY_ACTIVE, HOST_STATUS_PROXY_PASSIVE,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 22, NULL);
 #else
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select hostid,proxy_hostid,host,ipmi_authtype,ipmi_privilege,ipmi_username,"
 				"ipmi_password,maintenance_status,maintenance_type,maintenance_from,"
 				"status,name,lastaccess,tls_connect,tls_accept,"
@@ -785,10 +1153,10 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 				" and flags<>%d",
 			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
 			HOST_STATUS_PROXY_ACTIVE, HOST_STATUS_PROXY_PASSIVE,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 18, NULL);
 #endif
@@ -799,8 +1167,8 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->hosts.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
-			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_HOST, dbsync_env.cache->hosts.num_data),
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
 	{
@@ -818,11 +1186,18 @@ int	zbx_dbsync_compare_hosts(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, dbrow);
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->hosts, &iter);
-	while (NULL != (host = (ZBX_DC_HOST *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
 	{
-		if (NULL == zbx_hashset_search(&ids, &host->hostid))
-			dbsync_add_row(sync, host->hostid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_HOST, &ids, &dbsync_env.cache->hosts);
+	}
+	else
+	{
+		zbx_hashset_iter_reset(&dbsync_env.cache->hosts, &iter);
+		while (NULL != (host = (ZBX_DC_HOST *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &host->hostid))
+				dbsync_add_row(sync, host->hostid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -1930,9 +2305,11 @@ int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_ITEM		*item;
-	char			**row;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_ITEM, "i.itemid"}, {0}};
 
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select i.itemid,i.hostid,i.status,i.type,i.value_type,i.key_,i.snmp_oid,i.ipmi_sensor,i.delay,"
 				"i.trapper_hosts,i.logtimefmt,i.params,ir.state,i.authtype,i.username,i.password,"
 				"i.publickey,i.privatekey,i.flags,i.interfaceid,ir.lastlogsize,ir.mtime,"
@@ -1946,11 +2323,10 @@ int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
 			" left join item_discovery id on i.itemid=id.itemid"
 			" join item_rtdata ir on i.itemid=ir.itemid"
 			" where h.status in (%d,%d) and i.flags<>%d",
-			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED, ZBX_FLAG_DISCOVERY_PROTOTYPE)))
+			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED, ZBX_FLAG_DISCOVERY_PROTOTYPE);
 
-	{
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 51, dbsync_item_preproc_row);
 
@@ -1960,8 +2336,8 @@ int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->items.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
-			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_ITEM, dbsync_env.cache->items.num_data),
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
 	{
@@ -1981,11 +2357,31 @@ int	zbx_dbsync_compare_items(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, row);
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->items, &iter);
-	while (NULL != (item = (ZBX_DC_ITEM *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
 	{
-		if (NULL == zbx_hashset_search(&ids, &item->itemid))
-			dbsync_add_row(sync, item->itemid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_ITEM, &ids, &dbsync_env.cache->items);
+
+		if (0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_HOST].num_data)
+		{
+			zbx_hashset_iter_reset(&dbsync_env.cache->items, &iter);
+			while (NULL != (item = (ZBX_DC_ITEM *)zbx_hashset_iter_next(&iter)))
+			{
+				if (NULL == zbx_hashset_search(&ids, &item->itemid) &&
+						SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_HOST, item->hostid))
+				{
+					dbsync_changelog_remove(sync, ZBX_DBSYNC_OBJ_ITEM, item->itemid);
+				}
+			}
+		}
+	}
+	else
+	{
+		zbx_hashset_iter_reset(&dbsync_env.cache->items, &iter);
+		while (NULL != (item = (ZBX_DC_ITEM *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &item->itemid))
+				dbsync_add_row(sync, item->itemid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -2348,9 +2744,11 @@ int	zbx_dbsync_compare_triggers(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_TRIGGER		*trigger;
-	char			**row;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_TRIGGER, "t.triggerid"}, {0}};
 
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select distinct t.triggerid,t.description,t.expression,t.error,t.priority,t.type,t.value,"
 				"t.state,t.lastchange,t.status,t.recovery_mode,t.recovery_expression,"
 				"t.correlation_mode,t.correlation_tag,t.opdata,t.event_name,null,null,null"
@@ -2361,10 +2759,10 @@ int	zbx_dbsync_compare_triggers(zbx_dbsync_t *sync)
 				" and h.status in (%d,%d)"
 				" and t.flags<>%d",
 			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 19, dbsync_trigger_preproc_row);
 
@@ -2374,8 +2772,8 @@ int	zbx_dbsync_compare_triggers(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->triggers.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
-			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_TRIGGER, dbsync_env.cache->triggers.num_data),
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
 	{
@@ -2395,11 +2793,18 @@ int	zbx_dbsync_compare_triggers(zbx_dbsync_t *sync)
 		}
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->triggers, &iter);
-	while (NULL != (trigger = (ZBX_DC_TRIGGER *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
 	{
-		if (NULL == zbx_hashset_search(&ids, &trigger->triggerid))
-			dbsync_add_row(sync, trigger->triggerid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_TRIGGER, &ids, &dbsync_env.cache->triggers);
+	}
+	else
+	{
+		zbx_hashset_iter_reset(&dbsync_env.cache->triggers, &iter);
+		while (NULL != (trigger = (ZBX_DC_TRIGGER *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &trigger->triggerid))
+				dbsync_add_row(sync, trigger->triggerid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -2586,9 +2991,11 @@ int	zbx_dbsync_compare_functions(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	ZBX_DC_FUNCTION		*function;
-	char			**row;
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_FUNCTION, "f.functionid"}, {0}};
 
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select i.itemid,f.functionid,f.name,f.parameter,t.triggerid,i.hostid"
 			" from hosts h,items i,functions f,triggers t"
 			" where h.hostid=i.hostid"
@@ -2597,10 +3004,10 @@ int	zbx_dbsync_compare_functions(zbx_dbsync_t *sync)
 				" and h.status in (%d,%d)"
 				" and t.flags<>%d",
 			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 6, dbsync_function_preproc_row);
 
@@ -2610,8 +3017,8 @@ int	zbx_dbsync_compare_functions(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->functions.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
-			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_FUNCTION, dbsync_env.cache->functions.num_data),
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
 	{
@@ -2631,11 +3038,36 @@ int	zbx_dbsync_compare_functions(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, row);
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->functions, &iter);
-	while (NULL != (function = (ZBX_DC_FUNCTION *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
 	{
-		if (NULL == zbx_hashset_search(&ids, &function->functionid))
-			dbsync_add_row(sync, function->functionid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_FUNCTION, &ids, &dbsync_env.cache->functions);
+
+		if (0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_ITEM].num_data ||
+				0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_TRIGGER].num_data)
+		{
+			zbx_hashset_iter_reset(&dbsync_env.cache->functions, &iter);
+			while (NULL != (function = (ZBX_DC_FUNCTION *)zbx_hashset_iter_next(&iter)))
+			{
+				if (NULL != zbx_hashset_search(&ids, &function->functionid))
+					continue;
+
+				if (SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_ITEM, function->itemid) ||
+						SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_TRIGGER,
+						function->triggerid))
+				{
+					dbsync_changelog_remove(sync, ZBX_DBSYNC_OBJ_FUNCTION, function->functionid);
+				}
+			}
+		}
+	}
+	else
+	{
+		zbx_hashset_iter_reset(&dbsync_env.cache->functions, &iter);
+		while (NULL != (function = (ZBX_DC_FUNCTION *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &function->functionid))
+				dbsync_add_row(sync, function->functionid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -3102,8 +3534,11 @@ int	zbx_dbsync_compare_trigger_tags(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_trigger_tag_t	*trigger_tag;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_TRIGGER_TAG, "tt.triggertagid"}, {0}};
 
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select distinct tt.triggertagid,tt.triggerid,tt.tag,tt.value"
 			" from trigger_tag tt,triggers t,hosts h,items i,functions f"
 			" where t.triggerid=tt.triggerid"
@@ -3112,10 +3547,10 @@ int	zbx_dbsync_compare_trigger_tags(zbx_dbsync_t *sync)
 				" and i.itemid=f.itemid"
 				" and f.triggerid=tt.triggerid"
 				" and h.status in (%d,%d)",
-				ZBX_FLAG_DISCOVERY_PROTOTYPE, HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED)))
-	{
+				ZBX_FLAG_DISCOVERY_PROTOTYPE, HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 4, NULL);
 
@@ -3125,7 +3560,8 @@ int	zbx_dbsync_compare_trigger_tags(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->trigger_tags.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_TRIGGER_TAG,
+			dbsync_env.cache->trigger_tags.num_data), ZBX_DEFAULT_UINT64_HASH_FUNC,
 			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
@@ -3147,11 +3583,33 @@ int	zbx_dbsync_compare_trigger_tags(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, dbrow);
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->trigger_tags, &iter);
-	while (NULL != (trigger_tag = (zbx_dc_trigger_tag_t *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
 	{
-		if (NULL == zbx_hashset_search(&ids, &trigger_tag->triggertagid))
-			dbsync_add_row(sync, trigger_tag->triggertagid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_TRIGGER_TAG, &ids, &dbsync_env.cache->trigger_tags);
+
+		if (0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_TRIGGER].num_data)
+		{
+			zbx_hashset_iter_reset(&dbsync_env.cache->trigger_tags, &iter);
+			while (NULL != (trigger_tag = (zbx_dc_trigger_tag_t *)zbx_hashset_iter_next(&iter)))
+			{
+				if (NULL == zbx_hashset_search(&ids, &trigger_tag->triggertagid) &&
+						SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_TRIGGER,
+						trigger_tag->triggerid))
+				{
+					dbsync_changelog_remove(sync, ZBX_DBSYNC_OBJ_TRIGGER_TAG,
+							trigger_tag->triggertagid);
+				}
+			}
+		}
+	}
+	else
+	{
+		zbx_hashset_iter_reset(&dbsync_env.cache->trigger_tags, &iter);
+		while (NULL != (trigger_tag = (zbx_dc_trigger_tag_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &trigger_tag->triggertagid))
+				dbsync_add_row(sync, trigger_tag->triggertagid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -3207,8 +3665,11 @@ int	zbx_dbsync_compare_item_tags(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_item_tag_t	*item_tag;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_ITEM_TAG, "it.itemtagid"}, {0}};
 
-	if (NULL == (result = DBselect(
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select distinct it.itemtagid,it.itemid,it.tag,it.value"
 			" from item_tag it,items i,hosts h"
 			" where i.itemid=it.itemid"
@@ -3216,10 +3677,10 @@ int	zbx_dbsync_compare_item_tags(zbx_dbsync_t *sync)
 				" and h.hostid=i.hostid"
 				" and h.status in (%d,%d)",
 				ZBX_FLAG_DISCOVERY_NORMAL, ZBX_FLAG_DISCOVERY_CREATED,
-				HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED)))
-	{
+				HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 4, NULL);
 
@@ -3229,8 +3690,8 @@ int	zbx_dbsync_compare_item_tags(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->item_tags.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
-			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_ITEM_TAG, dbsync_env.cache->item_tags.num_data),
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
 	{
@@ -3252,11 +3713,31 @@ int	zbx_dbsync_compare_item_tags(zbx_dbsync_t *sync)
 	}
 	DBfree_result(result);
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->item_tags, &iter);
-	while (NULL != (item_tag = (zbx_dc_item_tag_t *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
 	{
-		if (NULL == zbx_hashset_search(&ids, &item_tag->itemtagid))
-			dbsync_add_row(sync, item_tag->itemtagid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_ITEM_TAG, &ids, &dbsync_env.cache->item_tags);
+
+		if (0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_ITEM].num_data)
+		{
+			zbx_hashset_iter_reset(&dbsync_env.cache->item_tags, &iter);
+			while (NULL != (item_tag = (zbx_dc_item_tag_t *)zbx_hashset_iter_next(&iter)))
+			{
+				if (NULL == zbx_hashset_search(&ids, &item_tag->itemtagid) &&
+						SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_ITEM, item_tag->itemid))
+				{
+					dbsync_changelog_remove(sync, ZBX_DBSYNC_OBJ_ITEM_TAG, item_tag->itemtagid);
+				}
+			}
+		}
+	}
+	else
+	{
+		zbx_hashset_iter_reset(&dbsync_env.cache->item_tags, &iter);
+		while (NULL != (item_tag = (zbx_dc_item_tag_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &item_tag->itemtagid))
+				dbsync_add_row(sync, item_tag->itemtagid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -3311,13 +3792,14 @@ int	zbx_dbsync_compare_host_tags(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_host_tag_t	*host_tag;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_HOST_TAG, "hosttagid"}, {0}};
 
-	if (NULL == (result = DBselect(
-			"select * from host_tag")))
-	{
-		printf("db query failed!\n");
+	zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, "select hosttagid,hostid,tag,value from host_tag");
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " where", fields, NULL, &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 4, NULL);
 
@@ -3327,8 +3809,8 @@ int	zbx_dbsync_compare_host_tags(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->host_tags.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
-			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_HOST_TAG, dbsync_env.cache->host_tags.num_data),
+			ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
 	{
@@ -3349,11 +3831,31 @@ int	zbx_dbsync_compare_host_tags(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, dbrow);
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->host_tags, &iter);
-	while (NULL != (host_tag = (zbx_dc_host_tag_t *)zbx_hashset_iter_next(&iter)))
+	if (SUCCEED == dbsync_env.changelog_mode)
+	{
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_HOST_TAG, &ids, &dbsync_env.cache->host_tags);
+
+		if (0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_HOST].num_data)
+		{
+			zbx_hashset_iter_reset(&dbsync_env.cache->host_tags, &iter);
+			while (NULL != (host_tag = (zbx_dc_host_tag_t *)zbx_hashset_iter_next(&iter)))
+			{
+				if (NULL == zbx_hashset_search(&ids, &host_tag->hosttagid) &&
+						SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_HOST, host_tag->hostid))
+				{
+					dbsync_changelog_remove(sync, ZBX_DBSYNC_OBJ_HOST_TAG, host_tag->hosttagid);
+				}
+			}
+		}
+	}
+	else
 	{
-		if (NULL == zbx_hashset_search(&ids, &host_tag->hosttagid))
-			dbsync_add_row(sync, host_tag->hosttagid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		zbx_hashset_iter_reset(&dbsync_env.cache->host_tags, &iter);
+		while (NULL != (host_tag = (zbx_dc_host_tag_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &host_tag->hosttagid))
+				dbsync_add_row(sync, host_tag->hosttagid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -3869,6 +4371,44 @@ static int	dbsync_compare_item_preproc(const zbx_dc_preproc_op_t *preproc, const
 	return SUCCEED;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_preproc_is_changed                                        *
+ *                                                                            *
+ * Purpose: checks if item or its host was changed or removed during this     *
+ *          synchronization                                                   *
+ *                                                                            *
+ * Parameter: itemid - [IN] the item identifier                               *
+ *                                                                            *
+ * Return value: SUCCEED - the item or its host was changed or removed        *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	dbsync_preproc_is_changed(zbx_uint64_t itemid)
+{
+	const ZBX_DC_ITEM	*item;
+
+	if (FAIL != zbx_vector_uint64_bsearch(&dbsync_env.changes[ZBX_DBSYNC_OBJ_ITEM], itemid,
+			ZBX_DEFAULT_UINT64_COMPARE_FUNC))
+	{
+		return SUCCEED;
+	}
+
+	if (SUCCEED == dbsync_changelog_is_removed(ZBX_DBSYNC_OBJ_ITEM, itemid))
+		return SUCCEED;
+
+	if (NULL == (item = (const ZBX_DC_ITEM *)zbx_hashset_search(&dbsync_env.cache->items, &itemid)))
+		return SUCCEED;
+
+	if (FAIL != zbx_vector_uint64_bsearch(&dbsync_env.changes[ZBX_DBSYNC_OBJ_HOST], item->hostid,
+			ZBX_DEFAULT_UINT64_COMPARE_FUNC))
+	{
+		return SUCCEED;
+	}
+
+	return FAIL;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_dbsync_compare_item_preprocessing                            *
@@ -3889,9 +4429,14 @@ int	zbx_dbsync_compare_item_preprocs(zbx_dbsync_t *sync)
 	zbx_hashset_iter_t	iter;
 	zbx_uint64_t		rowid;
 	zbx_dc_preproc_op_t	*preproc;
-	char			**row;
-
-	if (NULL == (result = DBselect(
+	char			**row, *sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const zbx_dbsync_field_t	fields[] = {{ZBX_DBSYNC_OBJ_ITEM_PREPROC, "pp.item_preprocid"},
+						{ZBX_DBSYNC_OBJ_ITEM, "pp.itemid"}, {ZBX_DBSYNC_OBJ_HOST, "i.hostid"}, {0}};
+
+	/* preprocessing is synchronized also for changed items and hosts, */
+	/* because item type and host proxy affect which steps are cached  */
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
 			"select pp.item_preprocid,pp.itemid,pp.type,pp.params,pp.step,i.hostid,pp.error_handler,"
 				"pp.error_handler_params,i.type,i.key_,h.proxy_hostid"
 			" from item_preproc pp,items i,hosts h"
@@ -3900,14 +4445,13 @@ int	zbx_dbsync_compare_item_preprocs(zbx_dbsync_t *sync)
 				" and (h.proxy_hostid is null"
 					" or i.type in (%d,%d,%d))"
 				" and h.status in (%d,%d)"
-				" and i.flags<>%d"
-			" order by pp.itemid",
+				" and i.flags<>%d",
 			ITEM_TYPE_INTERNAL, ITEM_TYPE_CALCULATED, ITEM_TYPE_DEPENDENT,
 			HOST_STATUS_MONITORED, HOST_STATUS_NOT_MONITORED,
-			ZBX_FLAG_DISCOVERY_PROTOTYPE)))
-	{
+			ZBX_FLAG_DISCOVERY_PROTOTYPE);
+
+	if (FAIL == dbsync_select(&sql, &sql_alloc, &sql_offset, " and", fields, " order by pp.itemid", &result))
 		return FAIL;
-	}
 
 	dbsync_prepare(sync, 8, dbsync_item_pp_preproc_row);
 
@@ -3917,7 +4461,8 @@ int	zbx_dbsync_compare_item_preprocs(zbx_dbsync_t *sync)
 		return SUCCEED;
 	}
 
-	zbx_hashset_create(&ids, dbsync_env.cache->hostgroups.num_data, ZBX_DEFAULT_UINT64_HASH_FUNC,
+	zbx_hashset_create(&ids, dbsync_rows_estimate(ZBX_DBSYNC_OBJ_ITEM_PREPROC,
+			dbsync_env.cache->preprocops.num_data), ZBX_DEFAULT_UINT64_HASH_FUNC,
 			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
 	while (NULL != (dbrow = DBfetch(result)))
@@ -3952,12 +4497,35 @@ int	zbx_dbsync_compare_item_preprocs(zbx_dbsync_t *sync)
 			dbsync_add_row(sync, rowid, tag, row);
 	}
 
-	zbx_hashset_iter_reset(&dbsync_env.cache->preprocops, &iter);
+	if (SUCCEED == dbsync_env.changelog_mode)
+	{
+		dbsync_changelog_remove_rows(sync, ZBX_DBSYNC_OBJ_ITEM_PREPROC, &ids, &dbsync_env.cache->preprocops);
 
-	while (NULL != (preproc = (zbx_dc_preproc_op_t *)zbx_hashset_iter_next(&iter)))
+		/* remove steps of changed items and hosts that were filtered out or deleted */
+		if (0 != dbsync_env.changes[ZBX_DBSYNC_OBJ_ITEM].values_num ||
+				0 != dbsync_env.changes[ZBX_DBSYNC_OBJ_HOST].values_num ||
+				0 != dbsync_env.removed[ZBX_DBSYNC_OBJ_ITEM].num_data)
+		{
+			zbx_hashset_iter_reset(&dbsync_env.cache->preprocops, &iter);
+			while (NULL != (preproc = (zbx_dc_preproc_op_t *)zbx_hashset_iter_next(&iter)))
+			{
+				if (NULL != zbx_hashset_search(&ids, &preproc->item_preprocid))
+					continue;
+
+				if (SUCCEED == dbsync_preproc_is_changed(preproc->itemid))
+					dbsync_changelog_remove(sync, ZBX_DBSYNC_OBJ_ITEM_PREPROC, preproc->item_preprocid);
+			}
+		}
+	}
+	else
 	{
-		if (NULL == zbx_hashset_search(&ids, &preproc->item_preprocid))
-			dbsync_add_row(sync, preproc->item_preprocid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		zbx_hashset_iter_reset(&dbsync_env.cache->preprocops, &iter);
+
+		while (NULL != (preproc = (zbx_dc_preproc_op_t *)zbx_hashset_iter_next(&iter)))
+		{
+			if (NULL == zbx_hashset_search(&ids, &preproc->item_preprocid))
+				dbsync_add_row(sync, preproc->item_preprocid, ZBX_DBSYNC_ROW_REMOVE, NULL);
+		}
 	}
 
 	zbx_hashset_destroy(&ids);
@@ -4629,3 +5197,197 @@ int	zbx_dbsync_compare_host_group_hosts(zbx_dbsync_t *sync)
 
 	return SUCCEED;
 }
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_tasks_init                                            *
+ *                                                                            *
+ * Purpose: initializes configuration table compare task list                 *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_tasks_init(zbx_dbsync_tasks_t *tasks)
+{
+	tasks->tasks_num = 0;
+	tasks->next = 0;
+	tasks->ret = SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_tasks_add                                             *
+ *                                                                            *
+ * Purpose: adds configuration table compare task                             *
+ *                                                                            *
+ * Parameter: tasks        - [IN/OUT] the task list                           *
+ *            compare_func - [IN] the compare function                        *
+ *            sync         - [IN] the changeset to pass to compare function   *
+ *            sec          - [OUT] the compare time, added to this value      *
+ *            follows      - [IN] 1 - the task depends on the previous task   *
+ *                                0 - the task is independent                 *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_dbsync_tasks_add(zbx_dbsync_tasks_t *tasks, zbx_dbsync_compare_func_t compare_func, zbx_dbsync_t *sync,
+		double *sec, unsigned char follows)
+{
+	zbx_dbsync_task_t	*task;
+
+	if (ZBX_DBSYNC_TASKS_MAX == tasks->tasks_num)
+	{
+		THIS_SHOULD_NEVER_HAPPEN;
+		exit(EXIT_FAILURE);
+	}
+
+	task = &tasks->tasks[tasks->tasks_num++];
+	task->compare_func = compare_func;
+	task->sync = sync;
+	task->sec = sec;
+	task->follows = follows;
+
+	*sec = 0;
+}
+
+static pthread_mutex_t	tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_tasks_process                                             *
+ *                                                                            *
+ * Purpose: executes compare tasks until there are no tasks left              *
+ *                                                                            *
+ * Parameter: tasks - [IN/OUT] the task list                                  *
+ *                                                                            *
+ * Comments: Dependent tasks are taken together with the task they follow,    *
+ *           so they are executed in order by the same thread.                *
+ *                                                                            *
+ ******************************************************************************/
+static void	dbsync_tasks_process(zbx_dbsync_tasks_t *tasks)
+{
+	int	first, last, i;
+	double	sec;
+
+	while (1)
+	{
+		pthread_mutex_lock(&tasks_lock);
+
+		if (SUCCEED != tasks->ret || tasks->next == tasks->tasks_num)
+		{
+			pthread_mutex_unlock(&tasks_lock);
+			break;
+		}
+
+		first = tasks->next;
+
+		for (last = first + 1; last < tasks->tasks_num && 0 != tasks->tasks[last].follows; last++)
+			;
+
+		tasks->next = last;
+
+		pthread_mutex_unlock(&tasks_lock);
+
+		for (i = first; i < last; i++)
+		{
+			zbx_dbsync_task_t	*task = &tasks->tasks[i];
+			int			ret;
+
+			sec = zbx_time();
+			ret = task->compare_func(task->sync);
+			*task->sec += zbx_time() - sec;
+
+			if (SUCCEED != ret)
+			{
+				pthread_mutex_lock(&tasks_lock);
+				tasks->ret = FAIL;
+				pthread_mutex_unlock(&tasks_lock);
+				break;
+			}
+		}
+	}
+}
+
+#if defined(ZBX_HAVE_THREAD_LOCAL) && (defined(HAVE_POSTGRESQL) || defined(HAVE_MYSQL))
+#	define ZBX_DBSYNC_THREADS
+#endif
+
+#ifdef ZBX_DBSYNC_THREADS
+/******************************************************************************
+ *                                                                            *
+ * Function: dbsync_tasks_thread                                              *
+ *                                                                            *
+ * Purpose: compare thread entry point                                        *
+ *                                                                            *
+ * Comments: Each thread uses its own database connection.                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	*dbsync_tasks_thread(void *args)
+{
+	DBconnect(ZBX_DB_CONNECT_NORMAL);
+	dbsync_tasks_process((zbx_dbsync_tasks_t *)args);
+	DBclose();
+	zbx_db_thread_end();
+
+	return NULL;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_dbsync_tasks_execute                                         *
+ *                                                                            *
+ * Purpose: executes configuration table compare tasks                        *
+ *                                                                            *
+ * Parameter: tasks       - [IN/OUT] the task list                            *
+ *            threads_num - [IN] the maximum number of threads, including     *
+ *                               the calling thread                           *
+ *                                                                            *
+ * Return value: SUCCEED - all tasks were executed successfully               *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: The calling thread executes tasks using the current database     *
+ *           connection, additional threads open their own connections.       *
+ *           Compare functions only read configuration cache, so the cache    *
+ *           is not locked while tasks are executed. Tasks are executed       *
+ *           sequentially when threads are not supported.                     *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_dbsync_tasks_execute(zbx_dbsync_tasks_t *tasks, int threads_num)
+{
+#ifdef ZBX_DBSYNC_THREADS
+	pthread_t	threads[ZBX_DBSYNC_TASKS_MAX];
+	sigset_t	mask, orig_mask;
+	int		i, chains_num = 0, started_num = 0, err;
+
+	for (i = 0; i < tasks->tasks_num; i++)
+	{
+		if (0 == tasks->tasks[i].follows)
+			chains_num++;
+	}
+
+	threads_num = MIN(threads_num, chains_num);
+
+	/* block signals in compare threads, so they are handled by the main thread */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &orig_mask);
+
+	for (i = 1; i < threads_num; i++)
+	{
+		if (0 != (err = pthread_create(&threads[started_num], NULL, dbsync_tasks_thread, tasks)))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot start configuration sync thread: %s", zbx_strerror(err));
+			break;
+		}
+
+		started_num++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
+#else
+	ZBX_UNUSED(threads_num);
+#endif
+	dbsync_tasks_process(tasks);
+
+#ifdef ZBX_DBSYNC_THREADS
+	for (i = 0; i < started_num; i++)
+		pthread_join(threads[i], NULL);
+#endif
+	return tasks->ret;
+}
@@ -110,8 +110,47 @@ struct zbx_dbsync
 	zbx_uint64_t	remove_num;
 };
 
+typedef int (*zbx_dbsync_compare_func_t)(zbx_dbsync_t *sync);
+
+#define ZBX_DBSYNC_TASKS_MAX	16
+
+/* the configuration table compare task */
+typedef struct
+{
+	zbx_dbsync_compare_func_t	compare_func;
+	zbx_dbsync_t			*sync;
+
+	/* the time spent in compare function is added to this value */
+	double				*sec;
+
+	/* 1 - the task depends on the previous task and is executed after it in the same thread */
+	unsigned char			follows;
+}
+zbx_dbsync_task_t;
+
+typedef struct
+{
+	zbx_dbsync_task_t	tasks[ZBX_DBSYNC_TASKS_MAX];
+	int			tasks_num;
+
+	/* the index of next task to execute */
+	int			next;
+
+	/* the tasks execution result, FAIL if any of the compare functions failed */
+	int			ret;
+}
+zbx_dbsync_tasks_t;
+
 void	zbx_dbsync_init_env(ZBX_DC_CONFIG *cache);
 void	zbx_dbsync_free_env(void);
+int	zbx_dbsync_env_prepare(unsigned char mode);
+void	zbx_dbsync_env_disable_changelog(void);
+void	zbx_dbsync_env_flush_changelog(void);
+
+void	zbx_dbsync_tasks_init(zbx_dbsync_tasks_t *tasks);
+void	zbx_dbsync_tasks_add(zbx_dbsync_tasks_t *tasks, zbx_dbsync_compare_func_t compare_func, zbx_dbsync_t *sync,
+		double *sec, unsigned char follows);
+int	zbx_dbsync_tasks_execute(zbx_dbsync_tasks_t *tasks, int threads_num);
 
 void	zbx_dbsync_init(zbx_dbsync_t *sync, unsigned char mode);
 void	zbx_dbsync_clear(zbx_dbsync_t *sync);
@@ -0,0 +1,1165 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "log.h"
+#include "mutexs.h"
+#include "memalloc.h"
+#include "zbxalgo.h"
+#include "zbxproxybuf.h"
+
+#include <sys/mman.h>
+
+/*
+ * Proxy history buffer kept in append-only segment files instead of proxy_history table.
+ *
+ * Segment files "history.<n>" are numbered consecutively. Each segment starts with a header holding the id of its
+ * first record and the committed data size, followed by 8 byte aligned records with consecutive ids. The files are
+ * preallocated to the configured segment size and mapped into memory by the processes using them.
+ *
+ * History syncers append record batches to the last segment under lock, flush them to disk and then publish the
+ * new committed size. A batch is never split between segments - if it does not fit into the last segment a new
+ * segment is started. Data sender reads committed records without locking, starting after the read cursor - the
+ * last acknowledged record id and position of the next record. The cursor is saved to "cursor" file when data is
+ * acknowledged and segments holding only acknowledged records are removed, or left for housekeeper when
+ * ProxyLocalBuffer is set.
+ *
+ * On startup the records written after the committed size of the last segment are recovered as long as their ids
+ * are consecutive and checksums match.
+ */
+
+#define PB_SEGMENT_MAGIC	0x47534250	/* "PBSG" */
+#define PB_CURSOR_MAGIC		0x52434250	/* "PBCR" */
+#define PB_FORMAT_VERSION	1
+
+#define PB_SEGMENT_PREFIX	"history."
+#define PB_CURSOR_FILE		"cursor"
+
+#define PB_ALIGN(size)		(((size) + 7) & ~(zbx_uint64_t)7)
+
+typedef struct
+{
+	zbx_uint32_t	magic;
+	zbx_uint32_t	version;
+	zbx_uint64_t	first_id;	/* the id of the first record in segment */
+	zbx_uint64_t	size;		/* the committed data size, including header */
+	int		clock;		/* the time of the last commit */
+}
+zbx_pb_segment_header_t;
+
+#define PB_SEGMENT_DATA_OFFSET	PB_ALIGN(sizeof(zbx_pb_segment_header_t))
+
+typedef struct
+{
+	zbx_uint64_t	id;
+	zbx_uint32_t	size;		/* the payload size */
+	zbx_uint32_t	checksum;	/* the payload checksum */
+}
+zbx_pb_record_header_t;
+
+/* fixed part of record payload, followed by zero terminated source and value strings */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	zbx_uint64_t	lastlogsize;
+	int		clock;
+	int		ns;
+	int		timestamp;
+	int		severity;
+	int		logeventid;
+	int		mtime;
+	int		write_clock;
+	zbx_uint32_t	source_len;
+	zbx_uint32_t	value_len;
+	unsigned char	state;
+	unsigned char	flags;
+}
+zbx_pb_history_row_t;
+
+/* buffer position, points at the record following the record with the specified id */
+typedef struct
+{
+	zbx_uint64_t	id;
+	zbx_uint64_t	segment;
+	zbx_uint64_t	offset;
+}
+zbx_pb_pos_t;
+
+typedef struct
+{
+	zbx_uint32_t	magic;
+	zbx_uint32_t	checksum;
+	zbx_pb_pos_t	pos;
+}
+zbx_pb_cursor_t;
+
+/* buffer state shared between processes */
+typedef struct
+{
+	zbx_uint64_t	next_id;	/* the id of the next record to write */
+	zbx_pb_pos_t	read;		/* the read cursor */
+	zbx_uint64_t	first_segment;	/* the oldest segment */
+	zbx_uint64_t	write_segment;	/* the segment being written */
+	zbx_uint64_t	write_offset;	/* the committed size of the segment being written */
+}
+zbx_pb_t;
+
+/* segment mapped into process memory */
+typedef struct
+{
+	zbx_uint64_t	segment;
+	unsigned char	*addr;
+	size_t		size;
+}
+zbx_pb_map_t;
+
+static zbx_mem_info_t	*pb_mem = NULL;
+static zbx_pb_t		*pb = NULL;
+static zbx_mutex_t	pb_lock = ZBX_MUTEX_NULL;
+
+static char		*pb_dir = NULL;
+static zbx_uint64_t	pb_segment_size;
+static int		pb_local_buffer;
+static long		pb_page_size;
+
+static zbx_pb_map_t	pb_write_map;
+static zbx_pb_map_t	pb_read_map;
+
+/* position after the last record returned by zbx_pb_history_read() in this process */
+static zbx_pb_pos_t	pb_read_pos;
+
+static char	*pb_segment_path(zbx_uint64_t segment)
+{
+	return zbx_dsprintf(NULL, "%s/" PB_SEGMENT_PREFIX ZBX_FS_UI64, pb_dir, segment);
+}
+
+static void	pb_map_release(zbx_pb_map_t *map)
+{
+	if (NULL != map->addr)
+	{
+		munmap(map->addr, map->size);
+		map->addr = NULL;
+	}
+
+	map->segment = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_map_segment                                                   *
+ *                                                                            *
+ * Purpose: maps segment file into process memory                             *
+ *                                                                            *
+ * Parameters: map     - [IN/OUT] the segment mapping, the previously mapped  *
+ *                                segment is unmapped                         *
+ *             segment - [IN] the segment number                              *
+ *             error   - [OUT] the error message                              *
+ *                                                                            *
+ * Return value: SUCCEED - the segment was mapped                             *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_map_segment(zbx_pb_map_t *map, zbx_uint64_t segment, char **error)
+{
+	char		*path;
+	int		fd, ret = FAIL;
+	zbx_stat_t	st;
+	void		*addr;
+
+	if (NULL != map->addr && segment == map->segment)
+		return SUCCEED;
+
+	pb_map_release(map);
+
+	path = pb_segment_path(segment);
+
+	if (-1 == (fd = open(path, O_RDWR)))
+	{
+		*error = zbx_dsprintf(*error, "cannot open \"%s\": %s", path, zbx_strerror(errno));
+		goto out;
+	}
+
+	if (0 != fstat(fd, &st))
+	{
+		*error = zbx_dsprintf(*error, "cannot stat \"%s\": %s", path, zbx_strerror(errno));
+		goto close;
+	}
+
+	if ((zbx_uint64_t)st.st_size < PB_SEGMENT_DATA_OFFSET)
+	{
+		*error = zbx_dsprintf(*error, "file \"%s\" is too small", path);
+		goto close;
+	}
+
+	if (MAP_FAILED == (addr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)))
+	{
+		*error = zbx_dsprintf(*error, "cannot map \"%s\": %s", path, zbx_strerror(errno));
+		goto close;
+	}
+
+	map->addr = (unsigned char *)addr;
+	map->size = (size_t)st.st_size;
+	map->segment = segment;
+
+	ret = SUCCEED;
+close:
+	close(fd);
+out:
+	zbx_free(path);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_segment_create                                                *
+ *                                                                            *
+ * Purpose: creates and preallocates new segment file                         *
+ *                                                                            *
+ * Parameters: segment  - [IN] the segment number                             *
+ *             first_id - [IN] the id of the first record in segment          *
+ *             size     - [IN] the segment file size                          *
+ *             error    - [OUT] the error message                             *
+ *                                                                            *
+ * Return value: SUCCEED - the segment was created                            *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: Without posix_fallocate() the file is extended with ftruncate(), *
+ *           which leaves it sparse on most file systems.                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_segment_create(zbx_uint64_t segment, zbx_uint64_t first_id, zbx_uint64_t size, char **error)
+{
+	char			*path;
+	int			fd, ret = FAIL;
+	zbx_pb_segment_header_t	header;
+
+	path = pb_segment_path(segment);
+
+	if (-1 == (fd = open(path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)))
+	{
+		*error = zbx_dsprintf(*error, "cannot create \"%s\": %s", path, zbx_strerror(errno));
+		goto out;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = PB_SEGMENT_MAGIC;
+	header.version = PB_FORMAT_VERSION;
+	header.first_id = first_id;
+	header.size = PB_SEGMENT_DATA_OFFSET;
+	header.clock = (int)time(NULL);
+
+#ifdef HAVE_POSIX_FALLOCATE
+	/* allocate disk blocks upfront, so running out of space is reported here and not when appending records */
+	if (0 != (errno = posix_fallocate(fd, 0, (off_t)size)))
+#else
+	if (0 != ftruncate(fd, (off_t)size))
+#endif
+	{
+		*error = zbx_dsprintf(*error, "cannot allocate " ZBX_FS_UI64 " bytes for \"%s\": %s", size, path,
+				zbx_strerror(errno));
+		goto close;
+	}
+
+	if (sizeof(header) != pwrite(fd, &header, sizeof(header), 0) || 0 != fsync(fd))
+	{
+		*error = zbx_dsprintf(*error, "cannot write \"%s\": %s", path, zbx_strerror(errno));
+		goto close;
+	}
+
+	ret = SUCCEED;
+close:
+	close(fd);
+
+	if (SUCCEED != ret)
+		unlink(path);
+out:
+	zbx_free(path);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_segment_read_header                                           *
+ *                                                                            *
+ * Purpose: reads and validates segment header                                *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_segment_read_header(zbx_uint64_t segment, zbx_pb_segment_header_t *header, char **error)
+{
+	char	*path;
+	int	fd, ret = FAIL;
+
+	path = pb_segment_path(segment);
+
+	if (-1 == (fd = open(path, O_RDONLY)))
+	{
+		*error = zbx_dsprintf(*error, "cannot open \"%s\": %s", path, zbx_strerror(errno));
+		goto out;
+	}
+
+	if (sizeof(*header) != pread(fd, header, sizeof(*header), 0) || PB_SEGMENT_MAGIC != header->magic ||
+			PB_FORMAT_VERSION != header->version || PB_SEGMENT_DATA_OFFSET > header->size)
+	{
+		*error = zbx_dsprintf(*error, "invalid segment header in \"%s\"", path);
+	}
+	else
+		ret = SUCCEED;
+
+	close(fd);
+out:
+	zbx_free(path);
+
+	return ret;
+}
+
+static void	pb_segment_remove(zbx_uint64_t segment)
+{
+	char	*path;
+
+	path = pb_segment_path(segment);
+
+	if (0 != unlink(path) && ENOENT != errno)
+		zabbix_log(LOG_LEVEL_WARNING, "cannot remove \"%s\": %s", path, zbx_strerror(errno));
+
+	zbx_free(path);
+}
+
+static zbx_uint64_t	pb_record_size(const zbx_pb_history_t *h)
+{
+	return PB_ALIGN(sizeof(zbx_pb_record_header_t) + sizeof(zbx_pb_history_row_t) +
+			strlen(ZBX_NULL2EMPTY_STR(h->source)) + 1 + strlen(ZBX_NULL2EMPTY_STR(h->value)) + 1);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_record_write                                                  *
+ *                                                                            *
+ * Purpose: serializes history record                                         *
+ *                                                                            *
+ * Parameters: ptr - [OUT] the record location, must have pb_record_size()    *
+ *                         bytes available                                    *
+ *             h   - [IN] the history record                                  *
+ *                                                                            *
+ * Return value: The number of bytes written.                                 *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	pb_record_write(unsigned char *ptr, const zbx_pb_history_t *h)
+{
+	zbx_pb_record_header_t	header;
+	zbx_pb_history_row_t	row;
+	unsigned char		*payload = ptr + sizeof(header);
+	const char		*source = ZBX_NULL2EMPTY_STR(h->source), *value = ZBX_NULL2EMPTY_STR(h->value);
+
+	/* clear padding so that checksum does not depend on it */
+	memset(&row, 0, sizeof(row));
+	row.itemid = h->itemid;
+	row.lastlogsize = h->lastlogsize;
+	row.clock = h->clock;
+	row.ns = h->ns;
+	row.timestamp = h->timestamp;
+	row.severity = h->severity;
+	row.logeventid = h->logeventid;
+	row.mtime = h->mtime;
+	row.write_clock = h->write_clock;
+	row.source_len = (zbx_uint32_t)strlen(source);
+	row.value_len = (zbx_uint32_t)strlen(value);
+	row.state = h->state;
+	row.flags = h->flags;
+
+	memcpy(payload, &row, sizeof(row));
+	memcpy(payload + sizeof(row), source, row.source_len + 1);
+	memcpy(payload + sizeof(row) + row.source_len + 1, value, row.value_len + 1);
+
+	header.id = h->id;
+	header.size = sizeof(row) + row.source_len + 1 + row.value_len + 1;
+	header.checksum = zbx_hash_murmur2(payload, header.size, (zbx_hash_t)h->id);
+	memcpy(ptr, &header, sizeof(header));
+
+	return PB_ALIGN(sizeof(header) + header.size);
+}
+
+static zbx_uint64_t	pb_record_read(const unsigned char *ptr, zbx_pb_history_t *h)
+{
+	zbx_pb_record_header_t	header;
+	zbx_pb_history_row_t	row;
+	const unsigned char	*payload = ptr + sizeof(header);
+
+	memcpy(&header, ptr, sizeof(header));
+	memcpy(&row, payload, sizeof(row));
+
+	h->id = header.id;
+	h->itemid = row.itemid;
+	h->lastlogsize = row.lastlogsize;
+	h->clock = row.clock;
+	h->ns = row.ns;
+	h->timestamp = row.timestamp;
+	h->severity = row.severity;
+	h->logeventid = row.logeventid;
+	h->mtime = row.mtime;
+	h->write_clock = row.write_clock;
+	h->state = row.state;
+	h->flags = row.flags;
+	h->source = (const char *)payload + sizeof(row);
+	h->value = h->source + row.source_len + 1;
+
+	return PB_ALIGN(sizeof(header) + header.size);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_record_verify                                                 *
+ *                                                                            *
+ * Purpose: checks if the specified location holds valid record               *
+ *                                                                            *
+ * Parameters: addr   - [IN] the mapped segment                               *
+ *             offset - [IN] the record offset                                *
+ *             end    - [IN] the segment size                                 *
+ *             id     - [IN] the expected record id                           *
+ *                                                                            *
+ * Return value: The record size or 0 if the record is not valid.             *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	pb_record_verify(const unsigned char *addr, zbx_uint64_t offset, zbx_uint64_t end,
+		zbx_uint64_t id)
+{
+	zbx_pb_record_header_t	header;
+	zbx_pb_history_row_t	row;
+	const unsigned char	*payload;
+	zbx_uint64_t		size;
+
+	if (offset >= end || end - offset < sizeof(header) + sizeof(row))
+		return 0;
+
+	memcpy(&header, addr + offset, sizeof(header));
+
+	if (id != header.id || sizeof(row) > header.size || end - offset - sizeof(header) < header.size)
+		return 0;
+
+	payload = addr + offset + sizeof(header);
+
+	if (header.checksum != zbx_hash_murmur2(payload, header.size, (zbx_hash_t)id))
+		return 0;
+
+	memcpy(&row, payload, sizeof(row));
+
+	if (sizeof(row) + (zbx_uint64_t)row.source_len + 1 + (zbx_uint64_t)row.value_len + 1 != header.size)
+		return 0;
+
+	if ('\0' != payload[sizeof(row) + row.source_len] || '\0' != payload[header.size - 1])
+		return 0;
+
+	if (end - offset < (size = PB_ALIGN(sizeof(header) + header.size)))
+		return 0;
+
+	return size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_cursor_save                                                   *
+ *                                                                            *
+ * Purpose: saves read cursor to cursor file                                  *
+ *                                                                            *
+ * Comments: The cursor is written to temporary file which is then renamed    *
+ *           over the cursor file, so that a crash leaves either old or new   *
+ *           cursor. A stale cursor results in resending data to server.      *
+ *                                                                            *
+ ******************************************************************************/
+static void	pb_cursor_save(const zbx_pb_pos_t *pos)
+{
+	zbx_pb_cursor_t	cursor;
+	char		*path, *path_tmp;
+	int		fd;
+
+	cursor.magic = PB_CURSOR_MAGIC;
+	cursor.pos = *pos;
+	cursor.checksum = zbx_hash_murmur2(&cursor.pos, sizeof(cursor.pos), 0);
+
+	path = zbx_dsprintf(NULL, "%s/" PB_CURSOR_FILE, pb_dir);
+	path_tmp = zbx_dsprintf(NULL, "%s.tmp", path);
+
+	if (-1 == (fd = open(path_tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot create \"%s\": %s", path_tmp, zbx_strerror(errno));
+		goto out;
+	}
+
+	if (sizeof(cursor) != write(fd, &cursor, sizeof(cursor)) || 0 != fsync(fd))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write \"%s\": %s", path_tmp, zbx_strerror(errno));
+		close(fd);
+		goto out;
+	}
+
+	close(fd);
+
+	if (0 != rename(path_tmp, path))
+		zabbix_log(LOG_LEVEL_WARNING, "cannot rename \"%s\": %s", path_tmp, zbx_strerror(errno));
+out:
+	zbx_free(path_tmp);
+	zbx_free(path);
+}
+
+static int	pb_cursor_load(zbx_pb_pos_t *pos)
+{
+	zbx_pb_cursor_t	cursor;
+	char		*path;
+	int		fd, ret = FAIL;
+
+	path = zbx_dsprintf(NULL, "%s/" PB_CURSOR_FILE, pb_dir);
+
+	if (-1 == (fd = open(path, O_RDONLY)))
+		goto out;
+
+	if (sizeof(cursor) == read(fd, &cursor, sizeof(cursor)) && PB_CURSOR_MAGIC == cursor.magic &&
+			cursor.checksum == zbx_hash_murmur2(&cursor.pos, sizeof(cursor.pos), 0))
+	{
+		*pos = cursor.pos;
+		ret = SUCCEED;
+	}
+	else
+		zabbix_log(LOG_LEVEL_WARNING, "ignoring invalid proxy buffer cursor file \"%s\"", path);
+
+	close(fd);
+out:
+	zbx_free(path);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_list_segments                                                 *
+ *                                                                            *
+ * Purpose: gets sorted numbers of segment files in buffer directory          *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_list_segments(zbx_vector_uint64_t *segments, char **error)
+{
+	DIR		*dir;
+	struct dirent	*d;
+	zbx_uint64_t	segment;
+
+	if (NULL == (dir = opendir(pb_dir)))
+	{
+		*error = zbx_dsprintf(*error, "cannot open directory \"%s\": %s", pb_dir, zbx_strerror(errno));
+		return FAIL;
+	}
+
+	while (NULL != (d = readdir(dir)))
+	{
+		if (0 != strncmp(d->d_name, PB_SEGMENT_PREFIX, ZBX_CONST_STRLEN(PB_SEGMENT_PREFIX)))
+			continue;
+
+		if (SUCCEED != is_uint64(d->d_name + ZBX_CONST_STRLEN(PB_SEGMENT_PREFIX), &segment) || 0 == segment)
+			continue;
+
+		zbx_vector_uint64_append(segments, segment);
+	}
+
+	closedir(dir);
+
+	zbx_vector_uint64_sort(segments, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_recover                                                       *
+ *                                                                            *
+ * Purpose: restores buffer state from segment and cursor files               *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_recover(char **error)
+{
+	zbx_vector_uint64_t	segments;
+	zbx_pb_segment_header_t	header, first, *last;
+	zbx_pb_pos_t		cursor;
+	zbx_uint64_t		offset, id, size;
+	int			i, recovered = 0, ret = FAIL;
+
+	zbx_vector_uint64_create(&segments);
+
+	if (SUCCEED != pb_list_segments(&segments, error))
+		goto out;
+
+	/* discard the last segment if its creation was interrupted */
+	if (0 != segments.values_num && SUCCEED != pb_segment_read_header(segments.values[segments.values_num - 1],
+			&header, error))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "%s, removing segment", *error);
+		zbx_free(*error);
+		pb_segment_remove(segments.values[--segments.values_num]);
+	}
+
+	if (0 == segments.values_num)
+	{
+		if (SUCCEED != pb_segment_create(1, 1, pb_segment_size, error))
+			goto out;
+
+		zbx_vector_uint64_append(&segments, 1);
+	}
+
+	/* only consecutive segments ending with the last one can be used */
+	for (i = segments.values_num - 1; 0 < i && segments.values[i - 1] + 1 == segments.values[i]; i--)
+		;
+
+	for (; 0 < i; i--)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "removing proxy buffer segment " ZBX_FS_UI64 " not followed by segment "
+				ZBX_FS_UI64, segments.values[0], segments.values[0] + 1);
+		pb_segment_remove(segments.values[0]);
+		zbx_vector_uint64_remove(&segments, 0);
+	}
+
+	if (SUCCEED != pb_segment_read_header(segments.values[0], &first, error))
+		goto out;
+
+	pb->first_segment = segments.values[0];
+	pb->write_segment = segments.values[segments.values_num - 1];
+
+	if (SUCCEED != pb_map_segment(&pb_write_map, pb->write_segment, error))
+		goto out;
+
+	last = (zbx_pb_segment_header_t *)pb_write_map.addr;
+
+	if (last->size > pb_write_map.size)
+	{
+		*error = zbx_dsprintf(*error, "invalid committed size of segment " ZBX_FS_UI64, pb->write_segment);
+		goto out;
+	}
+
+	/* skip committed records, then recover the records written after the last commit */
+	for (offset = PB_SEGMENT_DATA_OFFSET, id = last->first_id; offset < last->size; id++)
+	{
+		if (0 == (size = pb_record_verify(pb_write_map.addr, offset, last->size, id)))
+		{
+			*error = zbx_dsprintf(*error, "corrupted record " ZBX_FS_UI64 " in segment " ZBX_FS_UI64, id,
+					pb->write_segment);
+			goto out;
+		}
+
+		offset += size;
+	}
+
+	for (; 0 != (size = pb_record_verify(pb_write_map.addr, offset, pb_write_map.size, id)); id++)
+	{
+		offset += size;
+		recovered++;
+	}
+
+	if (0 != recovered)
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "recovered %d uncommitted records in proxy buffer segment " ZBX_FS_UI64,
+				recovered, pb->write_segment);
+		last->size = offset;
+		msync(pb_write_map.addr, pb_page_size, MS_SYNC);
+	}
+
+	pb->next_id = id;
+	pb->write_offset = offset;
+
+	if (SUCCEED == pb_cursor_load(&cursor) && cursor.segment >= pb->first_segment &&
+			cursor.segment <= pb->write_segment && cursor.id < pb->next_id)
+	{
+		pb->read = cursor;
+	}
+	else
+	{
+		pb->read.id = first.first_id - 1;
+		pb->read.segment = pb->first_segment;
+		pb->read.offset = PB_SEGMENT_DATA_OFFSET;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() segments:" ZBX_FS_UI64 "-" ZBX_FS_UI64 " lastid:" ZBX_FS_UI64 " nextid:"
+			ZBX_FS_UI64, __func__, pb->first_segment, pb->write_segment, pb->read.id, pb->next_id);
+
+	ret = SUCCEED;
+out:
+	zbx_vector_uint64_destroy(&segments);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_init                                                      *
+ *                                                                            *
+ * Purpose: initializes proxy history buffer                                  *
+ *                                                                            *
+ * Parameters: dir          - [IN] the buffer directory, NULL or empty string *
+ *                                 to keep history in database                *
+ *             segment_size - [IN] the segment file size                      *
+ *             local_buffer - [IN] the number of hours to keep sent data      *
+ *             error        - [OUT] the error message                         *
+ *                                                                            *
+ * Return value: SUCCEED - the buffer was initialized or is disabled          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pb_init(const char *dir, zbx_uint64_t segment_size, int local_buffer, char **error)
+{
+	zbx_stat_t	st;
+	int		ret = FAIL;
+
+	if (NULL == dir || '\0' == *dir)
+		return SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() dir:'%s'", __func__, dir);
+
+	if (0 != zbx_stat(dir, &st))
+	{
+		*error = zbx_dsprintf(*error, "cannot access buffer directory \"%s\": %s", dir, zbx_strerror(errno));
+		goto out;
+	}
+
+	if (0 == S_ISDIR(st.st_mode))
+	{
+		*error = zbx_dsprintf(*error, "buffer directory \"%s\" is not a directory", dir);
+		goto out;
+	}
+
+	if (SUCCEED != zbx_mutex_create(&pb_lock, ZBX_MUTEX_PROXY_BUFFER, error))
+		goto out;
+
+	if (SUCCEED != zbx_mem_create(&pb_mem, ZBX_KIBIBYTE, "proxy buffer", "ProxyHistoryLogDir", 0, error))
+		goto out;
+
+	pb = (zbx_pb_t *)zbx_mem_malloc(pb_mem, NULL, sizeof(zbx_pb_t));
+	memset(pb, 0, sizeof(zbx_pb_t));
+
+	pb_dir = zbx_strdup(pb_dir, dir);
+	pb_segment_size = PB_ALIGN(segment_size);
+	pb_local_buffer = local_buffer;
+	pb_page_size = sysconf(_SC_PAGESIZE);
+
+	if (SUCCEED != (ret = pb_recover(error)))
+	{
+		pb_map_release(&pb_write_map);
+		pb = NULL;
+	}
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+void	zbx_pb_destroy(void)
+{
+	if (NULL == pb)
+		return;
+
+	pb_map_release(&pb_write_map);
+	pb_map_release(&pb_read_map);
+	zbx_mutex_destroy(&pb_lock);
+	zbx_free(pb_dir);
+	pb = NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_history_enabled                                           *
+ *                                                                            *
+ * Return value: SUCCEED - proxy history is kept in buffer files              *
+ *               FAIL    - proxy history is kept in database                  *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pb_history_enabled(void)
+{
+	return NULL != pb ? SUCCEED : FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_history_write                                             *
+ *                                                                            *
+ * Purpose: appends history records to the buffer                             *
+ *                                                                            *
+ * Parameters: records     - [IN/OUT] the history records, record ids and     *
+ *                                    write time are assigned by buffer       *
+ *             records_num - [IN] the number of records                       *
+ *             error       - [OUT] the error message                          *
+ *                                                                            *
+ * Return value: SUCCEED - the records were written and flushed to disk       *
+ *               FAIL    - otherwise, no records were written                 *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pb_history_write(zbx_pb_history_t *records, int records_num, char **error)
+{
+	zbx_uint64_t		size = 0, offset, sync_offset;
+	zbx_pb_segment_header_t	*header;
+	int			i, now, ret = FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() records:%d", __func__, records_num);
+
+	for (i = 0; i < records_num; i++)
+		size += pb_record_size(&records[i]);
+
+	now = (int)time(NULL);
+
+	zbx_mutex_lock(pb_lock);
+
+	if (SUCCEED != pb_map_segment(&pb_write_map, pb->write_segment, error))
+		goto out;
+
+	if (pb->write_offset + size > pb_write_map.size)
+	{
+		if (SUCCEED != pb_segment_create(pb->write_segment + 1, pb->next_id,
+				MAX(pb_segment_size, PB_SEGMENT_DATA_OFFSET + size), error))
+		{
+			goto out;
+		}
+
+		pb->write_segment++;
+		pb->write_offset = PB_SEGMENT_DATA_OFFSET;
+
+		if (SUCCEED != pb_map_segment(&pb_write_map, pb->write_segment, error))
+			goto out;
+	}
+
+	for (i = 0, offset = pb->write_offset; i < records_num; i++)
+	{
+		records[i].id = pb->next_id + i;
+		records[i].write_clock = now;
+		offset += pb_record_write(pb_write_map.addr + offset, &records[i]);
+	}
+
+	sync_offset = pb->write_offset - pb->write_offset % pb_page_size;
+
+	if (0 != msync(pb_write_map.addr + sync_offset, offset - sync_offset, MS_SYNC))
+	{
+		*error = zbx_dsprintf(*error, "cannot flush segment " ZBX_FS_UI64 ": %s", pb->write_segment,
+				zbx_strerror(errno));
+		goto out;
+	}
+
+	header = (zbx_pb_segment_header_t *)pb_write_map.addr;
+	header->size = offset;
+	header->clock = now;
+	msync(pb_write_map.addr, pb_page_size, MS_ASYNC);
+
+	pb->next_id += records_num;
+	pb->write_offset = offset;
+
+	ret = SUCCEED;
+out:
+	zbx_mutex_unlock(pb_lock);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+static void	pb_get_state(zbx_pb_t *state)
+{
+	zbx_mutex_lock(pb_lock);
+	*state = *pb;
+	zbx_mutex_unlock(pb_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_pos_seek                                                      *
+ *                                                                            *
+ * Purpose: maps segment at the specified position, moving position to the    *
+ *          next segment if the current one has been read                     *
+ *                                                                            *
+ * Parameters: pos   - [IN/OUT] the buffer position                           *
+ *             state - [IN] the buffer state                                  *
+ *             end   - [OUT] the committed size of position segment           *
+ *                                                                            *
+ * Return value: SUCCEED - the position segment was mapped                    *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_pos_seek(zbx_pb_pos_t *pos, const zbx_pb_t *state, zbx_uint64_t *end)
+{
+	char	*error = NULL;
+
+	for (;;)
+	{
+		if (SUCCEED != pb_map_segment(&pb_read_map, pos->segment, &error))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot read proxy buffer: %s", error);
+			zbx_free(error);
+			return FAIL;
+		}
+
+		if (pos->segment == state->write_segment)
+			*end = state->write_offset;
+		else
+			*end = ((const zbx_pb_segment_header_t *)pb_read_map.addr)->size;
+
+		if (pos->offset < *end || pos->segment >= state->write_segment)
+			return SUCCEED;
+
+		pos->segment++;
+		pos->offset = PB_SEGMENT_DATA_OFFSET;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pb_locate                                                        *
+ *                                                                            *
+ * Purpose: finds position of the record following the specified record       *
+ *                                                                            *
+ * Parameters: lastid - [IN] the record id                                    *
+ *             state  - [IN] the buffer state                                 *
+ *             pos    - [OUT] the position                                    *
+ *             end    - [OUT] the committed size of position segment          *
+ *                                                                            *
+ * Comments: Records are skipped starting with the last read position of this *
+ *           process when possible, otherwise from the read cursor.           *
+ *                                                                            *
+ ******************************************************************************/
+static int	pb_locate(zbx_uint64_t lastid, const zbx_pb_t *state, zbx_pb_pos_t *pos, zbx_uint64_t *end)
+{
+	zbx_pb_record_header_t	header;
+
+	if (pb_read_pos.segment >= state->read.segment && pb_read_pos.id >= state->read.id && pb_read_pos.id <= lastid)
+		*pos = pb_read_pos;
+	else
+		*pos = state->read;
+
+	for (;;)
+	{
+		if (SUCCEED != pb_pos_seek(pos, state, end))
+			return FAIL;
+
+		if (pos->id >= lastid || pos->offset >= *end)
+			return SUCCEED;
+
+		memcpy(&header, pb_read_map.addr + pos->offset, sizeof(header));
+		pos->id = header.id;
+		pos->offset += PB_ALIGN(sizeof(header) + header.size);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_history_read                                              *
+ *                                                                            *
+ * Purpose: reads history records following the specified record              *
+ *                                                                            *
+ * Parameters: lastid      - [IN] the id of last processed record             *
+ *             records     - [OUT] the history records                        *
+ *             records_max - [IN] the maximum number of records to read       *
+ *                                                                            *
+ * Return value: The number of records read.                                  *
+ *                                                                            *
+ * Comments: Records are read from a single segment, call again to continue   *
+ *           with the next segment. Record strings point to the mapped        *
+ *           segment and are valid until the next call.                       *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pb_history_read(zbx_uint64_t lastid, zbx_pb_history_t *records, int records_max)
+{
+	zbx_pb_t	state;
+	zbx_pb_pos_t	pos;
+	zbx_uint64_t	end;
+	int		records_num = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() lastid:" ZBX_FS_UI64, __func__, lastid);
+
+	pb_get_state(&state);
+
+	if (lastid + 1 >= state.next_id || SUCCEED != pb_locate(lastid, &state, &pos, &end) ||
+			SUCCEED != pb_pos_seek(&pos, &state, &end))
+	{
+		goto out;
+	}
+
+	while (pos.offset < end && records_num < records_max)
+	{
+		pos.offset += pb_record_read(pb_read_map.addr + pos.offset, &records[records_num]);
+		pos.id = records[records_num++].id;
+	}
+
+	pb_read_pos = pos;
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%d", __func__, records_num);
+
+	return records_num;
+}
+
+zbx_uint64_t	zbx_pb_history_get_lastid(void)
+{
+	zbx_uint64_t	lastid;
+
+	zbx_mutex_lock(pb_lock);
+	lastid = pb->read.id;
+	zbx_mutex_unlock(pb_lock);
+
+	return lastid;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_history_set_lastid                                        *
+ *                                                                            *
+ * Purpose: moves read cursor after the acknowledged record                   *
+ *                                                                            *
+ * Parameters: lastid - [IN] the id of the last record acknowledged by server *
+ *                                                                            *
+ * Comments: Segments preceding the cursor segment are removed unless sent    *
+ *           data must be kept for ProxyLocalBuffer hours.                    *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_pb_history_set_lastid(zbx_uint64_t lastid)
+{
+	zbx_pb_t	state;
+	zbx_pb_pos_t	pos;
+	zbx_uint64_t	end;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() lastid:" ZBX_FS_UI64, __func__, lastid);
+
+	pb_get_state(&state);
+
+	if (lastid <= state.read.id || SUCCEED != pb_locate(lastid, &state, &pos, &end) ||
+			SUCCEED != pb_pos_seek(&pos, &state, &end))
+	{
+		goto out;
+	}
+
+	zbx_mutex_lock(pb_lock);
+
+	/* housekeeper might have dropped unsent segments in the meantime */
+	if (pos.id > pb->read.id && pos.segment >= pb->read.segment)
+	{
+		pb->read = pos;
+		pb_cursor_save(&pos);
+
+		for (; 0 == pb_local_buffer && pb->first_segment < pos.segment; pb->first_segment++)
+			pb_segment_remove(pb->first_segment);
+	}
+
+	zbx_mutex_unlock(pb_lock);
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_history_get_delay                                         *
+ *                                                                            *
+ * Purpose: gets the age of the oldest record following the specified record  *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pb_history_get_delay(zbx_uint64_t lastid)
+{
+	zbx_pb_t		state;
+	zbx_pb_pos_t		pos;
+	zbx_uint64_t		end;
+	zbx_pb_history_t	h;
+
+	pb_get_state(&state);
+
+	if (lastid + 1 >= state.next_id || SUCCEED != pb_locate(lastid, &state, &pos, &end) ||
+			SUCCEED != pb_pos_seek(&pos, &state, &end) || pos.offset >= end)
+	{
+		return 0;
+	}
+
+	pb_record_read(pb_read_map.addr + pos.offset, &h);
+
+	return (int)time(NULL) - h.write_clock;
+}
+
+int	zbx_pb_history_get_count(void)
+{
+	zbx_uint64_t	count;
+
+	zbx_mutex_lock(pb_lock);
+	count = pb->next_id - 1 - pb->read.id;
+	zbx_mutex_unlock(pb_lock);
+
+	return (int)MIN(count, INT_MAX);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pb_history_housekeep                                         *
+ *                                                                            *
+ * Purpose: removes outdated segments                                         *
+ *                                                                            *
+ * Parameters: local_clock   - [IN] remove sent segments last written before  *
+ *                                  this time                                 *
+ *             offline_clock - [IN] remove unsent segments last written       *
+ *                                  before this time                          *
+ *                                                                            *
+ * Return value: The number of removed records.                               *
+ *                                                                            *
+ * Comments: The segment being written is never removed.                      *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pb_history_housekeep(int local_clock, int offline_clock)
+{
+	zbx_pb_segment_header_t	header, next;
+	char			*error = NULL;
+	int			records = 0, sent;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	zbx_mutex_lock(pb_lock);
+
+	while (pb->first_segment < pb->write_segment)
+	{
+		if (SUCCEED != pb_segment_read_header(pb->first_segment, &header, &error) ||
+				SUCCEED != pb_segment_read_header(pb->first_segment + 1, &next, &error))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot housekeep proxy buffer: %s", error);
+			zbx_free(error);
+			break;
+		}
+
+		sent = (pb->read.id >= next.first_id - 1);
+
+		if ((0 == sent || header.clock >= local_clock) && header.clock >= offline_clock)
+			break;
+
+		if (0 == sent)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "removing " ZBX_FS_UI64 " unsent records from proxy buffer",
+					next.first_id - 1 - pb->read.id);
+
+			pb->read.id = next.first_id - 1;
+			pb->read.segment = pb->first_segment + 1;
+			pb->read.offset = PB_SEGMENT_DATA_OFFSET;
+			pb_cursor_save(&pb->read);
+		}
+		else if (pb->read.segment == pb->first_segment)
+		{
+			pb->read.segment++;
+			pb->read.offset = PB_SEGMENT_DATA_OFFSET;
+		}
+
+		records += (int)(next.first_id - header.first_id);
+		pb_segment_remove(pb->first_segment++);
+	}
+
+	zbx_mutex_unlock(pb_lock);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%d", __func__, records);
+
+	return records;
+}
@@ -0,0 +1,1152 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "db.h"
+#include "log.h"
+#include "mutexs.h"
+#include "memalloc.h"
+#include "proxy.h"
+#include "dbcache.h"
+#include "zbxproxybuf.h"
+
+/*
+ * Proxy memory buffer - history, discovery and autoregistration records kept in a shared memory ring instead of
+ * proxy_history, proxy_dhistory and proxy_autoreg_host tables while the server keeps up with the proxy.
+ *
+ * Records of all tables are appended to a single byte ring. Each table has its own consecutive record ids and
+ * acknowledged id, the ring space is released from the oldest record up to the first record which has not been
+ * acknowledged yet. A record is never split - when it does not fit at the end of ring a wrap marker is written
+ * and the record is placed at the ring start.
+ *
+ * Each table is either in memory or database mode. In memory mode new records are written to the ring. A table is
+ * switched to database mode when the ring is full or its oldest record is older than ProxyMemoryBufferAge, then
+ * new records are written to the database (or proxy history log) as before. The records left in the ring are sent
+ * first, so the order of records is preserved. The data sender switches table back to memory mode when it finds no
+ * unsent records in database and no database writes were started or in progress meanwhile. Tables start in
+ * database mode to send the records left in database by previous proxy run.
+ *
+ * Records are written under lock, the data sender reads them without locking as only the process acknowledging
+ * records releases ring space.
+ *
+ * Buffer record ids are not related to database record ids, so history read from buffer is sent to server in a
+ * separate data session. Server discards values with ids not greater than the last value id received in the same
+ * session, which would drop buffer records after switching from database and vice versa.
+ */
+
+#define PMB_MODE_MEMORY		0
+#define PMB_MODE_DATABASE	1
+
+#define PMB_RECORD_WRAP		0xff
+
+#define PMB_ALIGN(size)		(((size) + 7) & ~(zbx_uint64_t)7)
+
+typedef struct
+{
+	zbx_uint64_t	id;
+	zbx_uint32_t	size;		/* the payload size */
+	int		write_clock;
+	unsigned char	table;
+}
+zbx_pmb_record_header_t;
+
+/* fixed part of history record payload, followed by zero terminated source and value strings */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	zbx_uint64_t	lastlogsize;
+	int		clock;
+	int		ns;
+	int		timestamp;
+	int		severity;
+	int		logeventid;
+	int		mtime;
+	zbx_uint32_t	source_len;
+	unsigned char	state;
+	unsigned char	flags;
+}
+zbx_pmb_history_row_t;
+
+/* discovery and autoregistration record payload is a mask of NULL fields followed by zero terminated fields */
+typedef struct
+{
+	const char	*fields[ZBX_PMB_FIELDS_MAX];
+	int		fields_num;
+}
+zbx_pmb_fields_t;
+
+typedef struct
+{
+	zbx_uint64_t	next_id;	/* the id of the next record to write */
+	zbx_uint64_t	lastid;		/* the id of the last acknowledged record */
+	zbx_uint64_t	db_seq;		/* the number of started database writes */
+	int		db_writers;	/* the number of database writes in progress */
+	unsigned char	mode;
+}
+zbx_pmb_table_t;
+
+/* buffer state shared between processes, positions grow monotonically and are mapped to ring by modulo */
+typedef struct
+{
+	zbx_pmb_table_t	tables[ZBX_PMB_TABLE_COUNT];
+	unsigned char	*data;
+	zbx_uint64_t	size;
+	zbx_uint64_t	head;		/* the position of the oldest record */
+	zbx_uint64_t	tail;		/* the position after the newest record */
+}
+zbx_pmb_t;
+
+/* table read state of this process */
+typedef struct
+{
+	zbx_uint64_t	pos;		/* the position after the last returned record */
+	zbx_uint64_t	id;		/* the id of the last returned record */
+	zbx_uint64_t	db_seq;		/* the number of started database writes when data source was chosen */
+	int		db_idle;	/* no database writes were in progress when data source was chosen */
+	int		source;		/* the data source of the last batch, ZBX_PMB_READ_* */
+}
+zbx_pmb_reader_t;
+
+typedef zbx_uint32_t	(*zbx_pmb_size_func_t)(const void *record);
+typedef void		(*zbx_pmb_write_func_t)(unsigned char *payload, const void *record);
+typedef void		(*zbx_pmb_read_func_t)(const unsigned char *ptr, void *record);
+
+static zbx_mem_info_t	*pmb_mem = NULL;
+static zbx_pmb_t	*pmb = NULL;
+static zbx_mutex_t	pmb_lock = ZBX_MUTEX_NULL;
+static int		pmb_max_age;
+static char		*pmb_session_token = NULL;
+
+static zbx_pmb_reader_t	pmb_readers[ZBX_PMB_TABLE_COUNT];
+
+/* the number of database writes started by this process and not released yet */
+static int		pmb_db_writers[ZBX_PMB_TABLE_COUNT];
+
+static const char	*pmb_table_names[ZBX_PMB_TABLE_COUNT] = {"history", "discovery", "autoregistration"};
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_record_at                                                    *
+ *                                                                            *
+ * Purpose: reads header of the record at or after the specified position     *
+ *                                                                            *
+ * Parameters: pos    - [IN] the position                                     *
+ *             end    - [IN] the position after the last record               *
+ *             header - [OUT] the record header, valid if the returned        *
+ *                            position is less than end                       *
+ *                                                                            *
+ * Return value: The record position, skipping the ring end if it cannot     *
+ *               hold record header or is marked as unused.                   *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	pmb_record_at(zbx_uint64_t pos, zbx_uint64_t end, zbx_pmb_record_header_t *header)
+{
+	zbx_uint64_t	left = pmb->size - pos % pmb->size;
+
+	if (sizeof(zbx_pmb_record_header_t) > left)
+		pos += left;
+
+	if (pos >= end)
+		return pos;
+
+	memcpy(header, pmb->data + pos % pmb->size, sizeof(zbx_pmb_record_header_t));
+
+	if (PMB_RECORD_WRAP == header->table)
+	{
+		pos += pmb->size - pos % pmb->size;
+		memcpy(header, pmb->data, sizeof(zbx_pmb_record_header_t));
+	}
+
+	return pos;
+}
+
+static zbx_uint64_t	pmb_record_size(const zbx_pmb_record_header_t *header)
+{
+	return PMB_ALIGN(sizeof(zbx_pmb_record_header_t) + header->size);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_reserve                                                      *
+ *                                                                            *
+ * Purpose: gets ring position for a new record                               *
+ *                                                                            *
+ * Parameters: tail  - [IN/OUT] the position after the last record            *
+ *             size  - [IN] the record size, including header                 *
+ *             write - [IN] 1 - write wrap marker if the record does not fit  *
+ *                              at the ring end                               *
+ *                          0 - only calculate the position                   *
+ *                                                                            *
+ * Return value: The record position.                                         *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	pmb_reserve(zbx_uint64_t *tail, zbx_uint64_t size, int write)
+{
+	zbx_uint64_t		pos = *tail, left = pmb->size - pos % pmb->size;
+	zbx_pmb_record_header_t	header;
+
+	if (sizeof(zbx_pmb_record_header_t) > left)
+	{
+		pos += left;
+		left = pmb->size;
+	}
+
+	if (size > left)
+	{
+		if (0 != write)
+		{
+			memset(&header, 0, sizeof(header));
+			header.table = PMB_RECORD_WRAP;
+			memcpy(pmb->data + pos % pmb->size, &header, sizeof(header));
+		}
+
+		pos += left;
+	}
+
+	*tail = pos + size;
+
+	return pos;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_get_age                                                      *
+ *                                                                            *
+ * Purpose: gets the age of the oldest unacknowledged record                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	pmb_get_age(int now)
+{
+	zbx_pmb_record_header_t	header;
+
+	if (pmb_record_at(pmb->head, pmb->tail, &header) >= pmb->tail)
+		return 0;
+
+	return now - header.write_clock;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_release_acknowledged                                         *
+ *                                                                            *
+ * Purpose: releases ring space up to the first unacknowledged record         *
+ *                                                                            *
+ * Comments: This function must be called with buffer lock held.              *
+ *                                                                            *
+ ******************************************************************************/
+static void	pmb_release_acknowledged(void)
+{
+	zbx_pmb_record_header_t	header;
+	zbx_uint64_t		pos;
+
+	while (pmb->head < pmb->tail)
+	{
+		if ((pos = pmb_record_at(pmb->head, pmb->tail, &header)) >= pmb->tail)
+		{
+			pmb->head = pmb->tail;
+			break;
+		}
+
+		if (header.id > pmb->tables[header.table].lastid)
+		{
+			pmb->head = pos;
+			break;
+		}
+
+		pmb->head = pos + pmb_record_size(&header);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_write                                                        *
+ *                                                                            *
+ * Purpose: appends records to the ring                                       *
+ *                                                                            *
+ * Parameters: table       - [IN] the table, ZBX_PMB_* define                 *
+ *             records     - [IN] the records                                 *
+ *             record_size - [IN] the size of record structure                *
+ *             records_num - [IN] the number of records                       *
+ *             size_func   - [IN] returns record payload size                 *
+ *             write_func  - [IN] writes record payload                       *
+ *                                                                            *
+ * Return value: SUCCEED - the records were written to the ring               *
+ *               FAIL    - the records must be written to database, see       *
+ *                         zbx_pmb_db_release()                               *
+ *                                                                            *
+ * Comments: Either all or none of the records are written.                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	pmb_write(unsigned char table, const void *records, size_t record_size, int records_num,
+		zbx_pmb_size_func_t size_func, zbx_pmb_write_func_t write_func)
+{
+	zbx_pmb_table_t		*t;
+	zbx_pmb_record_header_t	header;
+	zbx_uint32_t		*sizes;
+	zbx_uint64_t		tail, pos;
+	int			i, now, ret = FAIL;
+	const char		*reason = NULL;
+
+	if (NULL == pmb)
+		return FAIL;
+
+	sizes = (zbx_uint32_t *)zbx_malloc(NULL, sizeof(zbx_uint32_t) * records_num);
+
+	for (i = 0; i < records_num; i++)
+		sizes[i] = size_func((const char *)records + record_size * i);
+
+	now = (int)time(NULL);
+
+	zbx_mutex_lock(pmb_lock);
+
+	t = &pmb->tables[table];
+
+	if (PMB_MODE_MEMORY == t->mode)
+	{
+		for (i = 0, tail = pmb->tail; i < records_num; i++)
+			pmb_reserve(&tail, PMB_ALIGN(sizeof(header) + sizes[i]), 0);
+
+		if (tail - pmb->head > pmb->size)
+			reason = "buffer is full";
+		else if (0 != pmb_max_age && pmb_max_age < pmb_get_age(now))
+			reason = "buffer data is too old";
+
+		if (NULL != reason)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "proxy memory buffer %s, writing %s data to database", reason,
+					pmb_table_names[table]);
+			t->mode = PMB_MODE_DATABASE;
+		}
+	}
+
+	if (PMB_MODE_MEMORY != t->mode)
+	{
+		t->db_seq++;
+		t->db_writers++;
+		pmb_db_writers[table]++;
+		goto out;
+	}
+
+	header.table = table;
+	header.write_clock = now;
+
+	for (i = 0; i < records_num; i++)
+	{
+		header.id = t->next_id++;
+		header.size = sizes[i];
+
+		pos = pmb_reserve(&pmb->tail, PMB_ALIGN(sizeof(header) + header.size), 1);
+		memcpy(pmb->data + pos % pmb->size, &header, sizeof(header));
+		write_func(pmb->data + pos % pmb->size + sizeof(header), (const char *)records + record_size * i);
+	}
+
+	ret = SUCCEED;
+out:
+	zbx_mutex_unlock(pmb_lock);
+
+	zbx_free(sizes);
+
+	return ret;
+}
+
+static zbx_uint32_t	pmb_history_size(const void *record)
+{
+	const zbx_pb_history_t	*h = (const zbx_pb_history_t *)record;
+
+	return sizeof(zbx_pmb_history_row_t) + strlen(ZBX_NULL2EMPTY_STR(h->source)) + 1 +
+			strlen(ZBX_NULL2EMPTY_STR(h->value)) + 1;
+}
+
+static void	pmb_history_write(unsigned char *payload, const void *record)
+{
+	const zbx_pb_history_t	*h = (const zbx_pb_history_t *)record;
+	zbx_pmb_history_row_t	row;
+	const char		*source = ZBX_NULL2EMPTY_STR(h->source), *value = ZBX_NULL2EMPTY_STR(h->value);
+
+	row.itemid = h->itemid;
+	row.lastlogsize = h->lastlogsize;
+	row.clock = h->clock;
+	row.ns = h->ns;
+	row.timestamp = h->timestamp;
+	row.severity = h->severity;
+	row.logeventid = h->logeventid;
+	row.mtime = h->mtime;
+	row.source_len = (zbx_uint32_t)strlen(source);
+	row.state = h->state;
+	row.flags = h->flags;
+
+	memcpy(payload, &row, sizeof(row));
+	memcpy(payload + sizeof(row), source, row.source_len + 1);
+	memcpy(payload + sizeof(row) + row.source_len + 1, value, strlen(value) + 1);
+}
+
+static void	pmb_history_read(const unsigned char *ptr, void *record)
+{
+	zbx_pb_history_t	*h = (zbx_pb_history_t *)record;
+	zbx_pmb_record_header_t	header;
+	zbx_pmb_history_row_t	row;
+	const unsigned char	*payload = ptr + sizeof(header);
+
+	memcpy(&header, ptr, sizeof(header));
+	memcpy(&row, payload, sizeof(row));
+
+	h->id = header.id;
+	h->write_clock = header.write_clock;
+	h->itemid = row.itemid;
+	h->lastlogsize = row.lastlogsize;
+	h->clock = row.clock;
+	h->ns = row.ns;
+	h->timestamp = row.timestamp;
+	h->severity = row.severity;
+	h->logeventid = row.logeventid;
+	h->mtime = row.mtime;
+	h->state = row.state;
+	h->flags = row.flags;
+	h->source = (const char *)payload + sizeof(row);
+	h->value = h->source + row.source_len + 1;
+}
+
+static zbx_uint32_t	pmb_fields_size(const void *record)
+{
+	const zbx_pmb_fields_t	*f = (const zbx_pmb_fields_t *)record;
+	zbx_uint32_t		size = sizeof(zbx_uint32_t);
+	int			i;
+
+	for (i = 0; i < f->fields_num; i++)
+	{
+		if (NULL != f->fields[i])
+			size += strlen(f->fields[i]) + 1;
+	}
+
+	return size;
+}
+
+static void	pmb_fields_write(unsigned char *payload, const void *record)
+{
+	const zbx_pmb_fields_t	*f = (const zbx_pmb_fields_t *)record;
+	zbx_uint32_t		mask = 0;
+	size_t			len;
+	int			i;
+
+	for (i = 0; i < f->fields_num; i++)
+	{
+		if (NULL == f->fields[i])
+			mask |= 1 << i;
+	}
+
+	memcpy(payload, &mask, sizeof(mask));
+	payload += sizeof(mask);
+
+	for (i = 0; i < f->fields_num; i++)
+	{
+		if (NULL == f->fields[i])
+			continue;
+
+		len = strlen(f->fields[i]) + 1;
+		memcpy(payload, f->fields[i], len);
+		payload += len;
+	}
+}
+
+static void	pmb_fields_read(const unsigned char *ptr, void *record)
+{
+	zbx_pmb_row_t		*row = (zbx_pmb_row_t *)record;
+	zbx_pmb_record_header_t	header;
+	zbx_uint32_t		mask;
+	const char		*field;
+	int			i;
+
+	memcpy(&header, ptr, sizeof(header));
+	memcpy(&mask, ptr + sizeof(header), sizeof(mask));
+
+	row->id = header.id;
+	row->write_clock = header.write_clock;
+	field = (const char *)ptr + sizeof(header) + sizeof(mask);
+
+	for (i = 0; i < ZBX_PMB_FIELDS_MAX; i++)
+	{
+		if (0 != (mask & (1 << i)))
+		{
+			row->fields[i] = NULL;
+			continue;
+		}
+
+		row->fields[i] = field;
+		field += strlen(field) + 1;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_locate                                                       *
+ *                                                                            *
+ * Purpose: finds position of the first table record following the specified *
+ *          record                                                            *
+ *                                                                            *
+ * Comments: Records are skipped starting with the last read position of this *
+ *           process when possible, otherwise from the ring head.             *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	pmb_locate(unsigned char table, zbx_uint64_t lastid, zbx_uint64_t head, zbx_uint64_t tail)
+{
+	const zbx_pmb_reader_t	*reader = &pmb_readers[table];
+	zbx_pmb_record_header_t	header;
+	zbx_uint64_t		pos;
+
+	if (reader->id <= lastid && reader->pos >= head && reader->pos <= tail)
+		pos = reader->pos;
+	else
+		pos = head;
+
+	while ((pos = pmb_record_at(pos, tail, &header)) < tail)
+	{
+		if (table == header.table && header.id > lastid)
+			break;
+
+		pos += pmb_record_size(&header);
+	}
+
+	return pos;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_read                                                         *
+ *                                                                            *
+ * Purpose: reads table records following the specified record                *
+ *                                                                            *
+ * Parameters: table       - [IN] the table, ZBX_PMB_* define                 *
+ *             lastid      - [IN] the id of the last processed record         *
+ *             records     - [OUT] the records                                *
+ *             record_size - [IN] the size of record structure                *
+ *             records_max - [IN] the maximum number of records to read       *
+ *             read_func   - [IN] reads record at the specified ring address  *
+ *                                                                            *
+ * Return value: The number of records read.                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	pmb_read(unsigned char table, zbx_uint64_t lastid, void *records, size_t record_size, int records_max,
+		zbx_pmb_read_func_t read_func)
+{
+	zbx_pmb_reader_t	*reader = &pmb_readers[table];
+	zbx_pmb_record_header_t	header;
+	zbx_uint64_t		pos, head, tail;
+	int			records_num = 0;
+
+	zbx_mutex_lock(pmb_lock);
+	head = pmb->head;
+	tail = pmb->tail;
+	zbx_mutex_unlock(pmb_lock);
+
+	for (pos = pmb_locate(table, lastid, head, tail); records_num < records_max &&
+			(pos = pmb_record_at(pos, tail, &header)) < tail; pos += pmb_record_size(&header))
+	{
+		if (table != header.table)
+			continue;
+
+		read_func(pmb->data + pos % pmb->size, (char *)records + record_size * records_num++);
+		reader->id = header.id;
+		reader->pos = pos + pmb_record_size(&header);
+	}
+
+	return records_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_init                                                     *
+ *                                                                            *
+ * Purpose: initializes proxy memory buffer                                   *
+ *                                                                            *
+ * Parameters: size    - [IN] the buffer size, 0 to keep data in database    *
+ *             max_age - [IN] the maximum age of buffered data before new     *
+ *                            data is written to database, 0 - unlimited      *
+ *             error   - [OUT] the error message                              *
+ *                                                                            *
+ * Return value: SUCCEED - the buffer was initialized or is disabled          *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_init(zbx_uint64_t size, int max_age, char **error)
+{
+	int	i, ret = FAIL;
+
+	if (0 == size)
+		return SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() size:" ZBX_FS_UI64, __func__, size);
+
+	if (SUCCEED != zbx_mutex_create(&pmb_lock, ZBX_MUTEX_PROXY_MEMORY_BUFFER, error))
+		goto out;
+
+	if (SUCCEED != zbx_mem_create(&pmb_mem, size, "proxy memory buffer", "ProxyMemoryBufferSize", 0, error))
+		goto out;
+
+	pmb = (zbx_pmb_t *)zbx_mem_malloc(pmb_mem, NULL, sizeof(zbx_pmb_t));
+	memset(pmb, 0, sizeof(zbx_pmb_t));
+
+	/* leave room for allocator chunk overhead */
+	pmb->size = (pmb_mem->free_size - 2 * MEM_MIN_ALLOC) & ~(zbx_uint64_t)7;
+	pmb->data = (unsigned char *)zbx_mem_malloc(pmb_mem, NULL, pmb->size);
+
+	for (i = 0; i < ZBX_PMB_TABLE_COUNT; i++)
+	{
+		pmb->tables[i].next_id = 1;
+		pmb->tables[i].mode = PMB_MODE_DATABASE;
+	}
+
+	pmb_max_age = max_age;
+
+	/* different seed than configuration cache session token */
+	pmb_session_token = zbx_create_token(1);
+
+	ret = SUCCEED;
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+void	zbx_pmb_destroy(void)
+{
+	if (NULL == pmb)
+		return;
+
+	zbx_mutex_destroy(&pmb_lock);
+	zbx_free(pmb_session_token);
+	pmb = NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_flush                                                    *
+ *                                                                            *
+ * Purpose: writes unsent buffer records to database so that they are sent    *
+ *          after proxy restart                                               *
+ *                                                                            *
+ * Comments: This function is called on proxy shutdown after history cache   *
+ *           has been synced. Records left in buffer when a table was         *
+ *           switched to database mode are written after the database         *
+ *           records of that table.                                           *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_pmb_flush(void)
+{
+	zbx_pb_history_t	*records;
+	zbx_pmb_row_t		*rows;
+	zbx_db_insert_t		db_insert;
+	zbx_uint64_t		lastid, druleid, dcheckid;
+	int			i, records_num, total = 0;
+	char			*error = NULL;
+
+	if (NULL == pmb)
+		return;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	records = (zbx_pb_history_t *)zbx_malloc(NULL, sizeof(zbx_pb_history_t) * ZBX_MAX_HRECORDS);
+	rows = (zbx_pmb_row_t *)zbx_malloc(NULL, sizeof(zbx_pmb_row_t) * ZBX_MAX_HRECORDS);
+
+	DBbegin();
+
+	for (lastid = pmb->tables[ZBX_PMB_HISTORY].lastid; 0 != (records_num = pmb_read(ZBX_PMB_HISTORY, lastid,
+			records, sizeof(zbx_pb_history_t), ZBX_MAX_HRECORDS,
+			pmb_history_read)); lastid = records[records_num - 1].id)
+	{
+		total += records_num;
+
+		if (SUCCEED == zbx_pb_history_enabled())
+		{
+			if (SUCCEED != zbx_pb_history_write(records, records_num, &error))
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "cannot write proxy history buffer: %s", error);
+				zbx_free(error);
+			}
+
+			continue;
+		}
+
+		zbx_db_insert_prepare(&db_insert, "proxy_history", "itemid", "clock", "ns", "timestamp", "source",
+				"severity", "value", "logeventid", "state", "lastlogsize", "mtime", "flags",
+				"write_clock", NULL);
+
+		for (i = 0; i < records_num; i++)
+		{
+			const zbx_pb_history_t	*h = &records[i];
+
+			zbx_db_insert_add_values(&db_insert, h->itemid, h->clock, h->ns, h->timestamp, h->source,
+					h->severity, h->value, h->logeventid, (int)h->state, h->lastlogsize, h->mtime,
+					(int)h->flags, h->write_clock);
+		}
+
+		zbx_db_insert_execute(&db_insert);
+		zbx_db_insert_clean(&db_insert);
+	}
+
+	for (lastid = pmb->tables[ZBX_PMB_DISCOVERY].lastid; 0 != (records_num = pmb_read(ZBX_PMB_DISCOVERY, lastid,
+			rows, sizeof(zbx_pmb_row_t), ZBX_MAX_HRECORDS,
+			pmb_fields_read)); lastid = rows[records_num - 1].id)
+	{
+		total += records_num;
+
+		zbx_db_insert_prepare(&db_insert, "proxy_dhistory", "clock", "druleid", "dcheckid", "ip", "dns", "port",
+				"value", "status", NULL);
+
+		for (i = 0; i < records_num; i++)
+		{
+			const char	**f = rows[i].fields;
+
+			ZBX_STR2UINT64(druleid, f[1]);
+
+			if (NULL != f[2])
+				ZBX_STR2UINT64(dcheckid, f[2]);
+			else
+				dcheckid = 0;
+
+			zbx_db_insert_add_values(&db_insert, atoi(f[0]), druleid, dcheckid, f[3], f[4], atoi(f[5]),
+					f[6], atoi(f[7]));
+		}
+
+		zbx_db_insert_execute(&db_insert);
+		zbx_db_insert_clean(&db_insert);
+	}
+
+	for (lastid = pmb->tables[ZBX_PMB_AUTOREG].lastid; 0 != (records_num = pmb_read(ZBX_PMB_AUTOREG, lastid,
+			rows, sizeof(zbx_pmb_row_t), ZBX_MAX_HRECORDS,
+			pmb_fields_read)); lastid = rows[records_num - 1].id)
+	{
+		total += records_num;
+
+		zbx_db_insert_prepare(&db_insert, "proxy_autoreg_host", "clock", "host", "listen_ip", "listen_dns",
+				"listen_port", "host_metadata", "flags", "tls_accepted", NULL);
+
+		for (i = 0; i < records_num; i++)
+		{
+			const char	**f = rows[i].fields;
+
+			zbx_db_insert_add_values(&db_insert, atoi(f[0]), f[1], f[2], f[3], atoi(f[4]), f[5], atoi(f[6]),
+					atoi(f[7]));
+		}
+
+		zbx_db_insert_execute(&db_insert);
+		zbx_db_insert_clean(&db_insert);
+	}
+
+	if (ZBX_DB_OK == DBcommit())
+	{
+		for (i = 0; i < ZBX_PMB_TABLE_COUNT; i++)
+			pmb->tables[i].lastid = pmb->tables[i].next_id - 1;
+
+		pmb_release_acknowledged();
+	}
+	else
+		zabbix_log(LOG_LEVEL_WARNING, "cannot write %d proxy memory buffer records to database", total);
+
+	zbx_free(rows);
+	zbx_free(records);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() records:%d", __func__, total);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_enabled                                                  *
+ *                                                                            *
+ * Return value: SUCCEED - proxy memory buffer is used                        *
+ *               FAIL    - proxy data is kept in database                     *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_enabled(void)
+{
+	return NULL != pmb ? SUCCEED : FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_history_write                                            *
+ *                                                                            *
+ * Purpose: appends history records to the buffer                             *
+ *                                                                            *
+ * Parameters: records     - [IN] the history records                         *
+ *             records_num - [IN] the number of records                       *
+ *                                                                            *
+ * Return value: SUCCEED - the records were written to buffer                 *
+ *               FAIL    - the records must be written to database and        *
+ *                         zbx_pmb_db_release() called after commit           *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_history_write(const zbx_pb_history_t *records, int records_num)
+{
+	return pmb_write(ZBX_PMB_HISTORY, records, sizeof(zbx_pb_history_t), records_num, pmb_history_size,
+			pmb_history_write);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_discovery_write                                          *
+ *                                                                            *
+ * Purpose: appends discovery record to the buffer                            *
+ *                                                                            *
+ * Parameters: dcheckid - [IN] the discovery check id, 0 for host records     *
+ *             ...      - [IN] see proxy_dhistory table                       *
+ *                                                                            *
+ * Return value: see zbx_pmb_history_write()                                  *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_discovery_write(int clock, zbx_uint64_t druleid, zbx_uint64_t dcheckid, const char *ip,
+		const char *dns, int port, const char *value, int status)
+{
+	zbx_pmb_fields_t	f;
+	char			clock_s[MAX_ID_LEN], druleid_s[MAX_ID_LEN], dcheckid_s[MAX_ID_LEN], port_s[MAX_ID_LEN],
+				status_s[MAX_ID_LEN];
+
+	if (NULL == pmb)
+		return FAIL;
+
+	zbx_snprintf(clock_s, sizeof(clock_s), "%d", clock);
+	zbx_snprintf(druleid_s, sizeof(druleid_s), ZBX_FS_UI64, druleid);
+	zbx_snprintf(dcheckid_s, sizeof(dcheckid_s), ZBX_FS_UI64, dcheckid);
+	zbx_snprintf(port_s, sizeof(port_s), "%d", port);
+	zbx_snprintf(status_s, sizeof(status_s), "%d", status);
+
+	f.fields[0] = clock_s;
+	f.fields[1] = druleid_s;
+	f.fields[2] = (0 != dcheckid ? dcheckid_s : NULL);
+	f.fields[3] = ip;
+	f.fields[4] = dns;
+	f.fields[5] = port_s;
+	f.fields[6] = ZBX_NULL2EMPTY_STR(value);
+	f.fields[7] = status_s;
+	f.fields_num = 8;
+
+	return pmb_write(ZBX_PMB_DISCOVERY, &f, sizeof(f), 1, pmb_fields_size, pmb_fields_write);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_autoreg_write                                            *
+ *                                                                            *
+ * Purpose: appends autoregistration record to the buffer                     *
+ *                                                                            *
+ * Parameters: ... - [IN] see proxy_autoreg_host table                        *
+ *                                                                            *
+ * Return value: see zbx_pmb_history_write()                                  *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted)
+{
+	zbx_pmb_fields_t	f;
+	char			clock_s[MAX_ID_LEN], port_s[MAX_ID_LEN], flags_s[MAX_ID_LEN], tls_accepted_s[MAX_ID_LEN];
+
+	if (NULL == pmb)
+		return FAIL;
+
+	zbx_snprintf(clock_s, sizeof(clock_s), "%d", clock);
+	zbx_snprintf(port_s, sizeof(port_s), "%d", port);
+	zbx_snprintf(flags_s, sizeof(flags_s), "%d", flags);
+	zbx_snprintf(tls_accepted_s, sizeof(tls_accepted_s), "%u", tls_accepted);
+
+	f.fields[0] = clock_s;
+	f.fields[1] = host;
+	f.fields[2] = ip;
+	f.fields[3] = dns;
+	f.fields[4] = port_s;
+	f.fields[5] = host_metadata;
+	f.fields[6] = flags_s;
+	f.fields[7] = tls_accepted_s;
+	f.fields_num = 8;
+
+	return pmb_write(ZBX_PMB_AUTOREG, &f, sizeof(f), 1, pmb_fields_size, pmb_fields_write);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_db_release                                               *
+ *                                                                            *
+ * Purpose: marks database writes started by this process as finished        *
+ *                                                                            *
+ * Comments: Must be called after the transaction writing records rejected    *
+ *           by buffer is committed or rolled back.                           *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_pmb_db_release(void)
+{
+	int	i;
+
+	if (NULL == pmb)
+		return;
+
+	for (i = 0; i < ZBX_PMB_TABLE_COUNT && 0 == pmb_db_writers[i]; i++)
+		;
+
+	if (ZBX_PMB_TABLE_COUNT == i)
+		return;
+
+	zbx_mutex_lock(pmb_lock);
+
+	for (i = 0; i < ZBX_PMB_TABLE_COUNT; i++)
+	{
+		pmb->tables[i].db_writers -= pmb_db_writers[i];
+		pmb_db_writers[i] = 0;
+	}
+
+	zbx_mutex_unlock(pmb_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_read_begin                                               *
+ *                                                                            *
+ * Purpose: chooses data source for the next batch of table records           *
+ *                                                                            *
+ * Parameters: table  - [IN] the table, ZBX_PMB_* define                      *
+ *             lastid - [OUT] the id of the last acknowledged buffer record,  *
+ *                            set when reading from memory                    *
+ *                                                                            *
+ * Return value: ZBX_PMB_READ_MEMORY   - read buffer records after lastid     *
+ *               ZBX_PMB_READ_DATABASE - read database records                *
+ *               ZBX_PMB_READ_NONE     - there are no records to send         *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_read_begin(unsigned char table, zbx_uint64_t *lastid)
+{
+	zbx_pmb_reader_t	*reader = &pmb_readers[table];
+	zbx_pmb_table_t		*t;
+
+	if (NULL == pmb)
+		return ZBX_PMB_READ_DATABASE;
+
+	zbx_mutex_lock(pmb_lock);
+
+	t = &pmb->tables[table];
+
+	if (t->next_id - 1 > t->lastid)
+	{
+		*lastid = t->lastid;
+		reader->source = ZBX_PMB_READ_MEMORY;
+	}
+	else if (PMB_MODE_MEMORY == t->mode)
+	{
+		reader->source = ZBX_PMB_READ_NONE;
+	}
+	else
+	{
+		reader->db_seq = t->db_seq;
+		reader->db_idle = (0 == t->db_writers);
+		reader->source = ZBX_PMB_READ_DATABASE;
+	}
+
+	zbx_mutex_unlock(pmb_lock);
+
+	return reader->source;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_get_session_token                                        *
+ *                                                                            *
+ * Purpose: gets data session token for the last read history batch           *
+ *                                                                            *
+ * Return value: The buffer session token if history was read from buffer,   *
+ *               configuration cache session token otherwise.                 *
+ *                                                                            *
+ ******************************************************************************/
+const char	*zbx_pmb_get_session_token(void)
+{
+	if (NULL != pmb && ZBX_PMB_READ_MEMORY == pmb_readers[ZBX_PMB_HISTORY].source)
+		return pmb_session_token;
+
+	return zbx_dc_get_session_token();
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_history_read                                             *
+ *                                                                            *
+ * Purpose: reads history records following the specified record              *
+ *                                                                            *
+ * Parameters: lastid      - [IN] the id of last processed record             *
+ *             records     - [OUT] the history records                        *
+ *             records_max - [IN] the maximum number of records to read       *
+ *                                                                            *
+ * Return value: The number of records read.                                  *
+ *                                                                            *
+ * Comments: Record strings point to the buffer and are valid until the       *
+ *           records are acknowledged.                                        *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_history_read(zbx_uint64_t lastid, zbx_pb_history_t *records, int records_max)
+{
+	return pmb_read(ZBX_PMB_HISTORY, lastid, records, sizeof(zbx_pb_history_t), records_max,
+			pmb_history_read);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_rows_read                                                *
+ *                                                                            *
+ * Purpose: reads discovery or autoregistration records following the        *
+ *          specified record                                                  *
+ *                                                                            *
+ * Comments: See zbx_pmb_history_read().                                      *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_rows_read(unsigned char table, zbx_uint64_t lastid, zbx_pmb_row_t *rows, int rows_max)
+{
+	return pmb_read(table, lastid, rows, sizeof(zbx_pmb_row_t), rows_max,
+			pmb_fields_read);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_database_drained                                         *
+ *                                                                            *
+ * Purpose: switches table to memory mode after database records were sent   *
+ *                                                                            *
+ * Comments: Called when reading database found no records to send. The mode  *
+ *           is not changed if a database write was in progress when reading  *
+ *           started or was started since then, as its records might not have *
+ *           been visible.                                                    *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_pmb_database_drained(unsigned char table)
+{
+	const zbx_pmb_reader_t	*reader = &pmb_readers[table];
+	zbx_pmb_table_t		*t;
+
+	if (NULL == pmb || ZBX_PMB_READ_DATABASE != reader->source || 0 == reader->db_idle)
+		return;
+
+	zbx_mutex_lock(pmb_lock);
+
+	t = &pmb->tables[table];
+
+	if (PMB_MODE_DATABASE == t->mode && reader->db_seq == t->db_seq && 0 == t->db_writers)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "proxy memory buffer is used for %s data", pmb_table_names[table]);
+		t->mode = PMB_MODE_MEMORY;
+	}
+
+	zbx_mutex_unlock(pmb_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_set_lastid                                               *
+ *                                                                            *
+ * Purpose: acknowledges table records sent to server                         *
+ *                                                                            *
+ * Parameters: table  - [IN] the table, ZBX_PMB_* define                      *
+ *             lastid - [IN] the id of the last record acknowledged by server *
+ *                                                                            *
+ * Return value: SUCCEED - the records were read from buffer and were         *
+ *                         acknowledged                                       *
+ *               FAIL    - the records were read from database                *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_set_lastid(unsigned char table, zbx_uint64_t lastid)
+{
+	zbx_pmb_table_t	*t;
+
+	if (NULL == pmb || ZBX_PMB_READ_MEMORY != pmb_readers[table].source)
+		return FAIL;
+
+	zbx_mutex_lock(pmb_lock);
+
+	t = &pmb->tables[table];
+
+	if (lastid > t->lastid && lastid < t->next_id)
+	{
+		t->lastid = lastid;
+		pmb_release_acknowledged();
+	}
+
+	zbx_mutex_unlock(pmb_lock);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_history_get_delay                                        *
+ *                                                                            *
+ * Purpose: gets the age of the oldest history record following the          *
+ *          specified record                                                  *
+ *                                                                            *
+ * Return value: SUCCEED - the last history batch was read from buffer and    *
+ *                         delay was returned                                 *
+ *               FAIL    - the last history batch was read from database      *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_history_get_delay(zbx_uint64_t lastid, int *delay)
+{
+	zbx_pmb_record_header_t	header;
+	zbx_uint64_t		pos, head, tail;
+
+	if (NULL == pmb || ZBX_PMB_READ_MEMORY != pmb_readers[ZBX_PMB_HISTORY].source)
+		return FAIL;
+
+	zbx_mutex_lock(pmb_lock);
+	head = pmb->head;
+	tail = pmb->tail;
+	zbx_mutex_unlock(pmb_lock);
+
+	if ((pos = pmb_locate(ZBX_PMB_HISTORY, lastid, head, tail)) < tail)
+	{
+		pmb_record_at(pos, tail, &header);
+		*delay = (int)time(NULL) - header.write_clock;
+	}
+	else
+		*delay = 0;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_pmb_history_get_count                                        *
+ *                                                                            *
+ * Purpose: gets the number of unsent history records in buffer               *
+ *                                                                            *
+ * Return value: SUCCEED - history is in memory mode, database has no unsent  *
+ *                         records                                            *
+ *               FAIL    - unsent database records must be counted as well    *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_pmb_history_get_count(int *count)
+{
+	zbx_pmb_table_t	*t;
+	int		ret;
+
+	*count = 0;
+
+	if (NULL == pmb)
+		return FAIL;
+
+	zbx_mutex_lock(pmb_lock);
+
+	t = &pmb->tables[ZBX_PMB_HISTORY];
+	*count = (int)MIN(t->next_id - 1 - t->lastid, INT_MAX);
+	ret = (PMB_MODE_MEMORY == t->mode ? SUCCEED : FAIL);
+
+	zbx_mutex_unlock(pmb_lock);
+
+	return ret;
+}
@@ -76,6 +76,9 @@ static int	vc_state = ZBX_VC_DISABLED;
 /* the value cache size */
 extern zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE;
 
+/* compress numeric value history chunks */
+extern int	CONFIG_VALUE_CACHE_COMPRESSION;
+
 ZBX_MEM_FUNC_IMPL(__vc, vc_mem)
 
 #define VC_STRPOOL_INIT_SIZE	(1000)
@@ -108,7 +111,15 @@ typedef struct zbx_vc_chunk
 	/* the number of item value slots in chunk */
 	int			slots_num;
 
-	/* the item value data */
+	/* The size of compressed value data in bytes. 0 for uncompressed chunks */
+	/* and -1 for uncompressed chunks which could not be compressed.         */
+	int			packed_size;
+
+	/* the unique identifier of compressed chunk data, used by decoded chunk cache */
+	zbx_uint64_t		packed_id;
+
+	/* The item value data. Compressed chunks store the value bit stream */
+	/* (see vch_chunk_pack()) starting from the slot array offset.       */
 	zbx_history_record_t	slots[1];
 }
 zbx_vc_chunk_t;
@@ -212,6 +223,9 @@ typedef struct
 
 	/* the string pool for str, text and log item values */
 	zbx_hashset_t	strpool;
+
+	/* the last assigned compressed chunk identifier */
+	zbx_uint64_t	packed_id;
 }
 zbx_vc_cache_t;
 
@@ -261,6 +275,8 @@ ZBX_VECTOR_IMPL(vc_itemupdate, zbx_vc_item_update_t)
 
 static zbx_vector_vc_itemupdate_t	vc_itemupdates;
 
+ZBX_VECTOR_IMPL(vc_prefetch, zbx_vc_prefetch_t)
+
 static void	vc_cache_item_update(zbx_uint64_t itemid, zbx_vc_item_update_type_t type, int arg1, int arg2)
 {
 	zbx_vc_item_update_t	*update;
@@ -1427,6 +1443,590 @@ static int	vch_item_add_chunk(zbx_vc_item_t *item, int nslots, zbx_vc_chunk_t *i
 	return SUCCEED;
 }
 
+/*
+ * Compressed chunks
+ *
+ * When ValueCacheCompression is enabled all chunks of numeric (float and unsigned) items, except
+ * the head chunk, are compressed into a bit stream of consecutive values:
+ *
+ *   timestamp seconds     - delta of deltas from the previous value:
+ *                           '0' - no change, '10' - 7 bits, '110' - 9 bits, '1110' - 12 bits,
+ *                           '1111' - 32 bits
+ *   timestamp nanoseconds - '0' - the same as previous value, '1' - 30 bits of nanoseconds
+ *   float values          - XOR with the previous value:
+ *                           '0' - the same value,
+ *                           '10' - meaningful bits fitting in the previous leading/trailing zero window,
+ *                           '11' - 5 bits of leading zeros, 6 bits of meaningful bit count and the
+ *                                  meaningful bits
+ *   unsigned values       - zigzag encoded difference from the previous value:
+ *                           '0' - the same value, '1' - 6 bits of significant bit count - 1 and the
+ *                           significant bits
+ *
+ * The first value is encoded against zero previous value, so it does not require special handling.
+ *
+ * Compressed chunks are never modified, except for removing the oldest values by increasing the first
+ * value index. Readers decode compressed chunks into process local decoded chunk cache, which is keyed
+ * by unique compressed chunk identifier, so it's safe to reuse decoded data across cache locks.
+ */
+
+/* the maximum number of bytes required to store one compressed value */
+#define ZBX_VC_PACKED_VALUE_MAX_SIZE	18
+
+/* the compressed chunk header size, compressed data is stored right after it */
+#define ZBX_VC_CHUNK_HEADER_SIZE	offsetof(zbx_vc_chunk_t, slots)
+
+/* the number of decoded chunks cached by process */
+#define ZBX_VC_UNPACKED_CACHE_SIZE	2
+
+typedef struct
+{
+	unsigned char	*data;
+
+	/* the current position in bits */
+	size_t		offset;
+}
+zbx_vc_bitstream_t;
+
+typedef struct
+{
+	/* the compressed chunk identifier, 0 - unused */
+	zbx_uint64_t		packed_id;
+
+	zbx_history_record_t	*values;
+	int			values_alloc;
+}
+zbx_vc_unpacked_chunk_t;
+
+static zbx_vc_unpacked_chunk_t	vc_unpacked[ZBX_VC_UNPACKED_CACHE_SIZE];
+static int			vc_unpacked_last;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_bitstream_write                                               *
+ *                                                                            *
+ * Purpose: writes the lowest bits of a value into bit stream                 *
+ *                                                                            *
+ * Parameters: bs    - [IN/OUT] the bit stream, the data must be zeroed       *
+ *             value - [IN] the value to write                                *
+ *             bits  - [IN] the number of bits to write (1-64)                *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_bitstream_write(zbx_vc_bitstream_t *bs, zbx_uint64_t value, int bits)
+{
+	while (0 < bits)
+	{
+		int	left = 8 - (int)(bs->offset & 7), n = MIN(left, bits);
+
+		bs->data[bs->offset >> 3] |= (unsigned char)(((value >> (bits - n)) & ((1 << n) - 1)) << (left - n));
+		bs->offset += n;
+		bits -= n;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_bitstream_read                                                *
+ *                                                                            *
+ * Purpose: reads a value from bit stream                                     *
+ *                                                                            *
+ * Parameters: bs    - [IN/OUT] the bit stream                                *
+ *             bits  - [IN] the number of bits to read (1-64)                 *
+ *                                                                            *
+ * Return value: the value read                                               *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t	vc_bitstream_read(zbx_vc_bitstream_t *bs, int bits)
+{
+	zbx_uint64_t	value = 0;
+
+	while (0 < bits)
+	{
+		int	left = 8 - (int)(bs->offset & 7), n = MIN(left, bits);
+
+		value = (value << n) | ((bs->data[bs->offset >> 3] >> (left - n)) & ((1 << n) - 1));
+		bs->offset += n;
+		bits -= n;
+	}
+
+	return value;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_bitstream_write_dod                                           *
+ *                                                                            *
+ * Purpose: writes timestamp delta of deltas into bit stream                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	vc_bitstream_write_dod(zbx_vc_bitstream_t *bs, int dod)
+{
+	if (0 == dod)
+	{
+		vc_bitstream_write(bs, 0, 1);
+	}
+	else if (-64 <= dod && dod < 64)
+	{
+		vc_bitstream_write(bs, 2, 2);
+		vc_bitstream_write(bs, (zbx_uint64_t)dod, 7);
+	}
+	else if (-256 <= dod && dod < 256)
+	{
+		vc_bitstream_write(bs, 6, 3);
+		vc_bitstream_write(bs, (zbx_uint64_t)dod, 9);
+	}
+	else if (-2048 <= dod && dod < 2048)
+	{
+		vc_bitstream_write(bs, 14, 4);
+		vc_bitstream_write(bs, (zbx_uint64_t)dod, 12);
+	}
+	else
+	{
+		vc_bitstream_write(bs, 15, 4);
+		vc_bitstream_write(bs, (zbx_uint64_t)dod, 32);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_bitstream_read_signed                                         *
+ *                                                                            *
+ * Purpose: reads two's complement signed value from bit stream               *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_bitstream_read_signed(zbx_vc_bitstream_t *bs, int bits)
+{
+	int	value = (int)vc_bitstream_read(bs, bits), sign = 1 << (bits - 1);
+
+	return (value ^ sign) - sign;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_bitstream_read_dod                                            *
+ *                                                                            *
+ * Purpose: reads timestamp delta of deltas from bit stream                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_bitstream_read_dod(zbx_vc_bitstream_t *bs)
+{
+	if (0 == vc_bitstream_read(bs, 1))
+		return 0;
+
+	if (0 == vc_bitstream_read(bs, 1))
+		return vc_bitstream_read_signed(bs, 7);
+
+	if (0 == vc_bitstream_read(bs, 1))
+		return vc_bitstream_read_signed(bs, 9);
+
+	if (0 == vc_bitstream_read(bs, 1))
+		return vc_bitstream_read_signed(bs, 12);
+
+	return (int)(zbx_uint32_t)vc_bitstream_read(bs, 32);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_uint64_leading_zeros                                          *
+ *                                                                            *
+ * Purpose: counts leading zero bits of a non zero value                      *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_uint64_leading_zeros(zbx_uint64_t value)
+{
+	int	n = 0;
+
+	while (0 == (value & __UINT64_C(0x8000000000000000)))
+	{
+		value <<= 1;
+		n++;
+	}
+
+	return n;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_uint64_trailing_zeros                                         *
+ *                                                                            *
+ * Purpose: counts trailing zero bits of a non zero value                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_uint64_trailing_zeros(zbx_uint64_t value)
+{
+	int	n = 0;
+
+	while (0 == (value & 1))
+	{
+		value >>= 1;
+		n++;
+	}
+
+	return n;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_chunk_pack                                                   *
+ *                                                                            *
+ * Purpose: compresses numeric history values                                 *
+ *                                                                            *
+ * Parameters: values     - [IN] the values to compress                       *
+ *             values_num - [IN] the number of values                         *
+ *             value_type - [IN] the value type (float or unsigned)           *
+ *             data       - [OUT] the compressed data, must be zeroed and at  *
+ *                          least ZBX_VC_PACKED_VALUE_MAX_SIZE * values_num   *
+ *                          bytes long                                        *
+ *                                                                            *
+ * Return value: the size of compressed data in bytes                         *
+ *                                                                            *
+ ******************************************************************************/
+static int	vch_chunk_pack(const zbx_history_record_t *values, int values_num, int value_type,
+		unsigned char *data)
+{
+	zbx_vc_bitstream_t	bs = {data, 0};
+	int			i, sec = 0, delta = 0, ns = 0, leading = -1, trailing = 0;
+	zbx_uint64_t		prev = 0;
+
+	for (i = 0; i < values_num; i++)
+	{
+		const zbx_history_record_t	*value = &values[i];
+		zbx_uint64_t			raw, diff;
+
+		vc_bitstream_write_dod(&bs, value->timestamp.sec - sec - delta);
+		delta = value->timestamp.sec - sec;
+		sec = value->timestamp.sec;
+
+		if (value->timestamp.ns == ns)
+		{
+			vc_bitstream_write(&bs, 0, 1);
+		}
+		else
+		{
+			vc_bitstream_write(&bs, 1, 1);
+			vc_bitstream_write(&bs, (zbx_uint64_t)value->timestamp.ns, 30);
+			ns = value->timestamp.ns;
+		}
+
+		if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		{
+			int	lz, tz;
+
+			memcpy(&raw, &value->value.dbl, sizeof(raw));
+
+			if (0 == (diff = raw ^ prev))
+			{
+				vc_bitstream_write(&bs, 0, 1);
+			}
+			else
+			{
+				if (31 < (lz = vc_uint64_leading_zeros(diff)))
+					lz = 31;
+				tz = vc_uint64_trailing_zeros(diff);
+
+				if (-1 != leading && lz >= leading && tz >= trailing)
+				{
+					vc_bitstream_write(&bs, 2, 2);
+				}
+				else
+				{
+					leading = lz;
+					trailing = tz;
+
+					vc_bitstream_write(&bs, 3, 2);
+					vc_bitstream_write(&bs, (zbx_uint64_t)leading, 5);
+					/* 64 meaningful bits are written as 0 */
+					vc_bitstream_write(&bs, (zbx_uint64_t)(64 - leading - trailing), 6);
+				}
+
+				vc_bitstream_write(&bs, diff >> trailing, 64 - leading - trailing);
+			}
+		}
+		else
+		{
+			raw = value->value.ui64;
+			diff = raw - prev;
+
+			/* zigzag encoding */
+			if (0 == (diff = (diff << 1) ^ (0 - (diff >> 63))))
+			{
+				vc_bitstream_write(&bs, 0, 1);
+			}
+			else
+			{
+				int	bits = 64 - vc_uint64_leading_zeros(diff);
+
+				vc_bitstream_write(&bs, 1, 1);
+				vc_bitstream_write(&bs, (zbx_uint64_t)(bits - 1), 6);
+				vc_bitstream_write(&bs, diff, bits);
+			}
+		}
+
+		prev = raw;
+	}
+
+	return (int)((bs.offset + 7) >> 3);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_chunk_unpack                                                 *
+ *                                                                            *
+ * Purpose: decompresses numeric history values                               *
+ *                                                                            *
+ * Parameters: chunk      - [IN] the compressed chunk                         *
+ *             value_type - [IN] the value type (float or unsigned)           *
+ *             values     - [OUT] the decompressed values, must have at least *
+ *                          chunk slots_num elements                          *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_chunk_unpack(const zbx_vc_chunk_t *chunk, int value_type, zbx_history_record_t *values)
+{
+	zbx_vc_bitstream_t	bs = {(unsigned char *)chunk->slots, 0};
+	int			i, sec = 0, delta = 0, ns = 0, leading = 0, trailing = 0;
+	zbx_uint64_t		prev = 0;
+
+	for (i = 0; i < chunk->slots_num; i++)
+	{
+		delta += vc_bitstream_read_dod(&bs);
+		sec += delta;
+
+		if (0 != vc_bitstream_read(&bs, 1))
+			ns = (int)vc_bitstream_read(&bs, 30);
+
+		values[i].timestamp.sec = sec;
+		values[i].timestamp.ns = ns;
+
+		if (ITEM_VALUE_TYPE_FLOAT == value_type)
+		{
+			if (0 != vc_bitstream_read(&bs, 1))
+			{
+				if (0 != vc_bitstream_read(&bs, 1))
+				{
+					int	bits;
+
+					leading = (int)vc_bitstream_read(&bs, 5);
+
+					if (0 == (bits = (int)vc_bitstream_read(&bs, 6)))
+						bits = 64;
+
+					trailing = 64 - leading - bits;
+				}
+
+				prev ^= vc_bitstream_read(&bs, 64 - leading - trailing) << trailing;
+			}
+
+			memcpy(&values[i].value.dbl, &prev, sizeof(prev));
+		}
+		else
+		{
+			if (0 != vc_bitstream_read(&bs, 1))
+			{
+				zbx_uint64_t	diff;
+
+				diff = vc_bitstream_read(&bs, (int)vc_bitstream_read(&bs, 6) + 1);
+				prev += (diff >> 1) ^ (0 - (diff & 1));
+			}
+
+			values[i].value.ui64 = prev;
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_chunk_slots                                             *
+ *                                                                            *
+ * Purpose: gets item chunk value slots                                       *
+ *                                                                            *
+ * Parameters: item  - [IN] the chunk owner item                              *
+ *             chunk - [IN] the chunk                                         *
+ *                                                                            *
+ * Return value: the chunk value slots                                        *
+ *                                                                            *
+ * Comments: Compressed chunks are decoded into process local cache holding   *
+ *           ZBX_VC_UNPACKED_CACHE_SIZE last decoded chunks. The returned     *
+ *           slots must not be modified and are valid until more than         *
+ *           ZBX_VC_UNPACKED_CACHE_SIZE other compressed chunks are accessed. *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_history_record_t	*vch_item_chunk_slots(const zbx_vc_item_t *item, const zbx_vc_chunk_t *chunk)
+{
+	zbx_vc_unpacked_chunk_t	*unpacked;
+	int			i;
+
+	if (0 >= chunk->packed_size)
+		return (zbx_history_record_t *)chunk->slots;
+
+	for (i = 0; i < ZBX_VC_UNPACKED_CACHE_SIZE; i++)
+	{
+		if (vc_unpacked[i].packed_id == chunk->packed_id)
+			return vc_unpacked[i].values;
+	}
+
+	vc_unpacked_last = (vc_unpacked_last + 1) % ZBX_VC_UNPACKED_CACHE_SIZE;
+	unpacked = &vc_unpacked[vc_unpacked_last];
+
+	if (unpacked->values_alloc < chunk->slots_num)
+	{
+		unpacked->values_alloc = chunk->slots_num;
+		unpacked->values = (zbx_history_record_t *)zbx_realloc(unpacked->values,
+				sizeof(zbx_history_record_t) * unpacked->values_alloc);
+	}
+
+	vch_chunk_unpack(chunk, item->value_type, unpacked->values);
+	unpacked->packed_id = chunk->packed_id;
+
+	return unpacked->values;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_replace_chunk                                           *
+ *                                                                            *
+ * Purpose: replaces item chunk with another chunk and frees the old one      *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_replace_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk, zbx_vc_chunk_t *chunk_new)
+{
+	chunk_new->prev = chunk->prev;
+	chunk_new->next = chunk->next;
+
+	if (NULL != chunk->prev)
+		chunk->prev->next = chunk_new;
+	else
+		item->tail = chunk_new;
+
+	if (NULL != chunk->next)
+		chunk->next->prev = chunk_new;
+	else
+		item->head = chunk_new;
+
+	__vc_mem_free_func(chunk);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_pack_chunk                                              *
+ *                                                                            *
+ * Purpose: replaces item chunk with compressed chunk                         *
+ *                                                                            *
+ * Parameters: item  - [IN/OUT] the chunk owner item                          *
+ *             chunk - [IN] the chunk to compress                             *
+ *                                                                            *
+ * Comments: Compression is optional, so the space for compressed chunk is    *
+ *           not freed from other items. If allocation fails or compressed    *
+ *           data is not smaller the chunk is left uncompressed.              *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_pack_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk)
+{
+	static unsigned char	*data = NULL;
+	static size_t		data_alloc = 0;
+
+	zbx_vc_chunk_t		*packed;
+	int			values_num, size;
+	size_t			data_size;
+
+	values_num = chunk->last_value - chunk->first_value + 1;
+	data_size = (size_t)values_num * ZBX_VC_PACKED_VALUE_MAX_SIZE;
+
+	if (data_alloc < data_size)
+	{
+		data_alloc = data_size;
+		data = (unsigned char *)zbx_realloc(data, data_alloc);
+	}
+
+	memset(data, 0, data_size);
+	size = vch_chunk_pack(chunk->slots + chunk->first_value, values_num, item->value_type, data);
+
+	/* don't try compressing the chunk again if it did not become smaller */
+	if ((size_t)size >= sizeof(zbx_history_record_t) * values_num)
+	{
+		chunk->packed_size = -1;
+		return;
+	}
+
+	if (NULL == (packed = (zbx_vc_chunk_t *)__vc_mem_malloc_func(NULL, ZBX_VC_CHUNK_HEADER_SIZE + size)))
+		return;
+
+	packed->first_value = 0;
+	packed->last_value = values_num - 1;
+	packed->slots_num = values_num;
+	packed->packed_size = size;
+	packed->packed_id = ++vc_cache->packed_id;
+	memcpy(packed->slots, data, size);
+
+	vch_item_replace_chunk(item, chunk, packed);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_pack_chunks                                             *
+ *                                                                            *
+ * Purpose: compresses all item chunks except the head chunk                  *
+ *                                                                            *
+ * Parameters: item - [IN/OUT] the item                                       *
+ *                                                                            *
+ * Comments: The head chunk is kept uncompressed to add new values.           *
+ *                                                                            *
+ ******************************************************************************/
+static void	vch_item_pack_chunks(zbx_vc_item_t *item)
+{
+	zbx_vc_chunk_t	*chunk, *prev;
+
+	if (0 == CONFIG_VALUE_CACHE_COMPRESSION || NULL == item->head)
+		return;
+
+	if (ITEM_VALUE_TYPE_FLOAT != item->value_type && ITEM_VALUE_TYPE_UINT64 != item->value_type)
+		return;
+
+	for (chunk = item->head->prev; NULL != chunk; chunk = prev)
+	{
+		prev = chunk->prev;
+
+		if (0 == chunk->packed_size)
+			vch_item_pack_chunk(item, chunk);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: vch_item_unpack_chunk                                            *
+ *                                                                            *
+ * Purpose: replaces compressed item chunk with uncompressed chunk            *
+ *                                                                            *
+ * Parameters: item  - [IN/OUT] the chunk owner item                          *
+ *             chunk - [IN] the compressed chunk                              *
+ *                                                                            *
+ * Return value: the uncompressed chunk or NULL if there was not enough       *
+ *               memory                                                       *
+ *                                                                            *
+ * Comments: Compressed chunks are uncompressed only when values must be      *
+ *           inserted in them.                                                *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_vc_chunk_t	*vch_item_unpack_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk)
+{
+	zbx_vc_chunk_t	*plain;
+	size_t		size;
+
+	size = sizeof(zbx_vc_chunk_t) + sizeof(zbx_history_record_t) * (chunk->slots_num - 1);
+
+	if (NULL == (plain = (zbx_vc_chunk_t *)vc_item_malloc(item, size)))
+		return NULL;
+
+	memcpy(plain->slots, vch_item_chunk_slots(item, chunk), sizeof(zbx_history_record_t) * chunk->slots_num);
+	plain->first_value = chunk->first_value;
+	plain->last_value = chunk->last_value;
+	plain->slots_num = chunk->slots_num;
+	plain->packed_size = 0;
+	plain->packed_id = 0;
+
+	vch_item_replace_chunk(item, chunk, plain);
+
+	return plain;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: vch_chunk_find_last_value_before                                 *
@@ -1434,7 +2034,8 @@ static int	vch_item_add_chunk(zbx_vc_item_t *item, int nslots, zbx_vc_chunk_t *i
  * Purpose: find the index of the last value in chunk with timestamp less or  *
  *          equal to the specified timestamp.                                 *
  *                                                                            *
- * Parameters:  chunk - [IN] the chunk                                        *
+ * Parameters:  item  - [IN] the chunk owner item                             *
+ *              chunk - [IN] the chunk                                        *
  *              ts    - [IN] the target timestamp                             *
  *                                                                            *
  * Return value: The index of the last value in chunk with timestamp less or  *
@@ -1443,12 +2044,16 @@ static int	vch_item_add_chunk(zbx_vc_item_t *item, int nslots, zbx_vc_chunk_t *i
  *               values have timestamps greater than the target timestamp).   *
  *                                                                            *
  ******************************************************************************/
-static int	vch_chunk_find_last_value_before(const zbx_vc_chunk_t *chunk, const zbx_timespec_t *ts)
+static int	vch_chunk_find_last_value_before(const zbx_vc_item_t *item, const zbx_vc_chunk_t *chunk,
+		const zbx_timespec_t *ts)
 {
-	int	start = chunk->first_value, end = chunk->last_value, middle;
+	int			start = chunk->first_value, end = chunk->last_value, middle;
+	zbx_history_record_t	*slots;
+
+	slots = vch_item_chunk_slots(item, chunk);
 
 	/* check if the last value timestamp is already greater or equal to the specified timestamp */
-	if (0 >= zbx_timespec_compare(&chunk->slots[end].timestamp, ts))
+	if (0 >= zbx_timespec_compare(&slots[end].timestamp, ts))
 		return end;
 
 	/* chunk contains only one value, which did not pass the above check, return failure */
@@ -1460,13 +2065,13 @@ static int	vch_chunk_find_last_value_before(const zbx_vc_chunk_t *chunk, const z
 	{
 		middle = start + (end - start) / 2;
 
-		if (0 < zbx_timespec_compare(&chunk->slots[middle].timestamp, ts))
+		if (0 < zbx_timespec_compare(&slots[middle].timestamp, ts))
 		{
 			end = middle;
 			continue;
 		}
 
-		if (0 >= zbx_timespec_compare(&chunk->slots[middle + 1].timestamp, ts))
+		if (0 >= zbx_timespec_compare(&slots[middle + 1].timestamp, ts))
 		{
 			start = middle;
 			continue;
@@ -1510,16 +2115,16 @@ static int	vch_item_get_last_value(const zbx_vc_item_t *item, const zbx_timespec
 
 	index = chunk->last_value;
 
-	if (0 < zbx_timespec_compare(&chunk->slots[index].timestamp, ts))
+	if (0 < zbx_timespec_compare(&vch_item_chunk_slots(item, chunk)[index].timestamp, ts))
 	{
-		while (0 < zbx_timespec_compare(&chunk->slots[chunk->first_value].timestamp, ts))
+		while (0 < zbx_timespec_compare(&vch_item_chunk_slots(item, chunk)[chunk->first_value].timestamp, ts))
 		{
 			chunk = chunk->prev;
 			/* there are no values for requested range, return failure */
 			if (NULL == chunk)
 				return FAIL;
 		}
-		index = vch_chunk_find_last_value_before(chunk, ts);
+		index = vch_chunk_find_last_value_before(item, chunk, ts);
 	}
 
 	*pchunk = chunk;
@@ -1656,8 +2261,17 @@ static size_t	vch_item_free_chunk(zbx_vc_item_t *item, zbx_vc_chunk_t *chunk)
 {
 	size_t	freed;
 
-	freed = sizeof(zbx_vc_chunk_t) + (chunk->slots_num - 1) * sizeof(zbx_history_record_t);
-	freed += vc_item_free_values(item, chunk->slots, chunk->first_value, chunk->last_value);
+	if (0 < chunk->packed_size)
+	{
+		/* compressed chunks hold only numeric values without additional resources */
+		freed = ZBX_VC_CHUNK_HEADER_SIZE + chunk->packed_size;
+		item->values_total -= chunk->last_value - chunk->first_value + 1;
+	}
+	else
+	{
+		freed = sizeof(zbx_vc_chunk_t) + (chunk->slots_num - 1) * sizeof(zbx_history_record_t);
+		freed += vc_item_free_values(item, chunk->slots, chunk->first_value, chunk->last_value);
+	}
 
 	__vc_mem_free_func(chunk);
 
@@ -1707,21 +2321,28 @@ static void	vch_item_clean_cache(zbx_vc_item_t *item)
 
 	if (0 != item->active_range)
 	{
-		zbx_vc_chunk_t	*tail = item->tail;
-		zbx_vc_chunk_t	*chunk = tail;
-		int		timestamp;
+		zbx_vc_chunk_t		*tail = item->tail;
+		zbx_vc_chunk_t		*chunk = tail;
+		zbx_history_record_t	*next_slots;
+		int			timestamp, last_sec, head_sec;
 
 		timestamp = time(NULL) - item->active_range;
+		head_sec = item->head->slots[item->head->last_value].timestamp.sec;
 
 		/* try to remove chunks with all history values older than maximum request range */
-		while (NULL != chunk && chunk->slots[chunk->last_value].timestamp.sec < timestamp &&
-				chunk->slots[chunk->last_value].timestamp.sec !=
-						item->head->slots[item->head->last_value].timestamp.sec)
+		while (NULL != chunk)
 		{
+			last_sec = vch_item_chunk_slots(item, chunk)[chunk->last_value].timestamp.sec;
+
+			if (last_sec >= timestamp || last_sec == head_sec)
+				break;
+
 			/* don't remove the head chunk */
 			if (NULL == (next = chunk->next))
 				break;
 
+			next_slots = vch_item_chunk_slots(item, next);
+
 			/* Values with the same timestamps (seconds resolution) always should be either   */
 			/* kept in cache or removed together. There should not be a case when one of them */
 			/* is in cache and the second is dropped.                                         */
@@ -1730,18 +2351,17 @@ static void	vch_item_clean_cache(zbx_vc_item_t *item)
 			/* In this case increase the first value index of the next chunk until the first  */
 			/* value timestamp is greater.                                                    */
 
-			if (next->slots[next->first_value].timestamp.sec != next->slots[next->last_value].timestamp.sec)
+			if (next_slots[next->first_value].timestamp.sec != next_slots[next->last_value].timestamp.sec)
 			{
-				while (next->slots[next->first_value].timestamp.sec ==
-						chunk->slots[chunk->last_value].timestamp.sec)
+				while (next_slots[next->first_value].timestamp.sec == last_sec)
 				{
-					vc_item_free_values(item, next->slots, next->first_value, next->first_value);
+					vc_item_free_values(item, next_slots, next->first_value, next->first_value);
 					next->first_value++;
 				}
 			}
 
 			/* set the database cached from timestamp to the last (oldest) removed value timestamp + 1 */
-			item->db_cached_from = chunk->slots[chunk->last_value].timestamp.sec + 1;
+			item->db_cached_from = last_sec + 1;
 
 			vch_item_remove_chunk(item, chunk);
 
@@ -1768,24 +2388,25 @@ static void	vch_item_clean_cache(zbx_vc_item_t *item)
  ******************************************************************************/
 static void	vch_item_remove_values(zbx_vc_item_t *item, int timestamp)
 {
-	zbx_vc_chunk_t	*chunk = item->tail;
+	zbx_vc_chunk_t		*chunk = item->tail;
+	zbx_history_record_t	*slots;
 
 	if (ZBX_ITEM_STATUS_CACHED_ALL == item->status)
 		item->status = 0;
 
 	/* try to remove chunks with all history values older than the timestamp */
-	while (NULL != chunk && chunk->slots[chunk->first_value].timestamp.sec < timestamp)
+	while (NULL != chunk && (slots = vch_item_chunk_slots(item, chunk))[chunk->first_value].timestamp.sec < timestamp)
 	{
 		zbx_vc_chunk_t	*next;
 
 		/* If chunk contains values with timestamp greater or equal - remove */
 		/* only the values with less timestamp. Otherwise remove the while   */
 		/* chunk and check next one.                                         */
-		if (chunk->slots[chunk->last_value].timestamp.sec >= timestamp)
+		if (slots[chunk->last_value].timestamp.sec >= timestamp)
 		{
-			while (chunk->slots[chunk->first_value].timestamp.sec < timestamp)
+			while (slots[chunk->first_value].timestamp.sec < timestamp)
 			{
-				vc_item_free_values(item, chunk->slots, chunk->first_value, chunk->first_value);
+				vc_item_free_values(item, slots, chunk->first_value, chunk->first_value);
 				chunk->first_value++;
 			}
 
@@ -1823,7 +2444,8 @@ static int	vch_item_add_value_at_head(zbx_vc_item_t *item, const zbx_history_rec
 	if (NULL != item->head &&
 			0 < zbx_history_record_compare_asc_func(&item->head->slots[item->head->last_value], value))
 	{
-		if (0 < zbx_history_record_compare_asc_func(&item->tail->slots[item->tail->first_value], value))
+		if (0 < zbx_history_record_compare_asc_func(
+				&vch_item_chunk_slots(item, item->tail)[item->tail->first_value], value))
 		{
 			/* If the added value has the same or older timestamp as the first value in cache */
 			/* we can't add it to keep cache consistency. Additionally we must make sure no   */
@@ -1877,6 +2499,10 @@ static int	vch_item_add_value_at_head(zbx_vc_item_t *item, const zbx_history_rec
 					goto out;
 				}
 
+				/* values are shifted through the chunk, so it must be uncompressed */
+				if (0 < schunk->packed_size && NULL == (schunk = vch_item_unpack_chunk(item, schunk)))
+					goto out;
+
 				sindex = schunk->last_value;
 			}
 		}
@@ -1935,7 +2561,7 @@ static int	vch_item_add_values_at_tail(zbx_vc_item_t *item, const zbx_history_re
 	/* skip values already added to the item cache by another process */
 	if (NULL != item->tail)
 	{
-		int	sec = item->tail->slots[item->tail->first_value].timestamp.sec;
+		int	sec = vch_item_chunk_slots(item, item->tail)[item->tail->first_value].timestamp.sec;
 
 		while (--count >= 0 && values[count].timestamp.sec >= sec)
 			;
@@ -1946,8 +2572,9 @@ static int	vch_item_add_values_at_tail(zbx_vc_item_t *item, const zbx_history_re
 	{
 		int	copy_slots, nslots = 0;
 
-		/* find the number of free slots on the left side in first (tail) chunk */
-		if (NULL != item->tail)
+		/* find the number of free slots on the left side in first (tail) chunk, */
+		/* compressed chunks cannot be extended                                  */
+		if (NULL != item->tail && 0 >= item->tail->packed_size)
 			nslots = item->tail->first_value;
 
 		if (0 == nslots)
@@ -1969,6 +2596,8 @@ static int	vch_item_add_values_at_tail(zbx_vc_item_t *item, const zbx_history_re
 			goto out;
 	}
 
+	vch_item_pack_chunks(item);
+
 	ret = SUCCEED;
 out:
 	return ret;
@@ -2008,7 +2637,7 @@ static int	vch_item_cache_values_by_time(zbx_vc_item_t **item, int range_start)
 	if (NULL != (*item)->tail)
 	{
 		/* we need to get item values before the first cached value, but not including it */
-		range_end = (*item)->tail->slots[(*item)->tail->first_value].timestamp.sec - 1;
+		range_end = vch_item_chunk_slots(*item, (*item)->tail)[(*item)->tail->first_value].timestamp.sec - 1;
 	}
 	else
 		range_end = ZBX_JAN_2038;
@@ -2115,7 +2744,7 @@ static int	vch_item_cache_values_by_time_and_count(zbx_vc_item_t **item, int ran
 
 	/* get the end timestamp to which (including) the values should be cached */
 	if (NULL != (*item)->head)
-		range_end = (*item)->tail->slots[(*item)->tail->first_value].timestamp.sec - 1;
+		range_end = vch_item_chunk_slots(*item, (*item)->tail)[(*item)->tail->first_value].timestamp.sec - 1;
 	else
 		range_end = ZBX_JAN_2038;
 
@@ -2171,7 +2800,7 @@ static int	vch_item_cache_values_by_time_and_count(zbx_vc_item_t **item, int ran
 	if ((count <= records.values_num || 0 == range_start) && 0 != records.values_num)
 	{
 		vc_item_update_db_cached_from(*item,
-				(*item)->tail->slots[(*item)->tail->first_value].timestamp.sec);
+				vch_item_chunk_slots(*item, (*item)->tail)[(*item)->tail->first_value].timestamp.sec);
 	}
 	else if (0 != range_start)
 		vc_item_update_db_cached_from(*item, range_start);
@@ -2198,9 +2827,10 @@ out:
 static void	vch_item_get_values_by_time(const zbx_vc_item_t *item, zbx_vector_history_record_t *values, int seconds,
 		const zbx_timespec_t *ts)
 {
-	int		index, now;
-	zbx_timespec_t	start = {ts->sec - seconds, ts->ns};
-	zbx_vc_chunk_t	*chunk;
+	int			index, now;
+	zbx_timespec_t		start = {ts->sec - seconds, ts->ns};
+	zbx_vc_chunk_t		*chunk;
+	zbx_history_record_t	*slots;
 
 	/* Check if maximum request range is not set and all data are cached.  */
 	/* Because that indicates there was a count based request with unknown */
@@ -2219,16 +2849,20 @@ static void	vch_item_get_values_by_time(const zbx_vc_item_t *item, zbx_vector_hi
 		return;
 	}
 
-	/* fill the values vector with item history values until the start timestamp is reached */
-	while (0 < zbx_timespec_compare(&chunk->slots[chunk->last_value].timestamp, &start))
+	slots = vch_item_chunk_slots(item, chunk);
+
+	/* fill the values vector with item history values until the start timestamp is reached, */
+	/* compressed chunks are decoded on the fly                                              */
+	while (0 < zbx_timespec_compare(&slots[chunk->last_value].timestamp, &start))
 	{
-		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&chunk->slots[index].timestamp, &start))
-			vc_history_record_vector_append(values, item->value_type, &chunk->slots[index--]);
+		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&slots[index].timestamp, &start))
+			vc_history_record_vector_append(values, item->value_type, &slots[index--]);
 
 		if (NULL == (chunk = chunk->prev))
 			break;
 
 		index = chunk->last_value;
+		slots = vch_item_chunk_slots(item, chunk);
 	}
 }
 
@@ -2252,9 +2886,10 @@ static void	vch_item_get_values_by_time(const zbx_vc_item_t *item, zbx_vector_hi
 static void	vch_item_get_values_by_time_and_count(zbx_vc_item_t *item, zbx_vector_history_record_t *values,
 		int seconds, int count, const zbx_timespec_t *ts)
 {
-	int		index, now, range_timestamp;
-	zbx_vc_chunk_t	*chunk;
-	zbx_timespec_t	start;
+	int			index, now, range_timestamp;
+	zbx_vc_chunk_t		*chunk;
+	zbx_timespec_t		start;
+	zbx_history_record_t	*slots;
 
 	/* set start timestamp of the requested time period */
 	if (0 != seconds)
@@ -2277,11 +2912,13 @@ static void	vch_item_get_values_by_time_and_count(zbx_vc_item_t *item, zbx_vecto
 	/* fill the values vector with item history values until the <count> values are read    */
 	/* or no more values within specified time period                                       */
 	/* fill the values vector with item history values until the start timestamp is reached */
-	while (0 < zbx_timespec_compare(&chunk->slots[chunk->last_value].timestamp, &start))
+	slots = vch_item_chunk_slots(item, chunk);
+
+	while (0 < zbx_timespec_compare(&slots[chunk->last_value].timestamp, &start))
 	{
-		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&chunk->slots[index].timestamp, &start))
+		while (index >= chunk->first_value && 0 < zbx_timespec_compare(&slots[index].timestamp, &start))
 		{
-			vc_history_record_vector_append(values, item->value_type, &chunk->slots[index--]);
+			vc_history_record_vector_append(values, item->value_type, &slots[index--]);
 
 			if (values->values_num == count)
 				goto out;
@@ -2291,6 +2928,7 @@ static void	vch_item_get_values_by_time_and_count(zbx_vc_item_t *item, zbx_vecto
 			break;
 
 		index = chunk->last_value;
+		slots = vch_item_chunk_slots(item, chunk);
 	}
 out:
 	if (count > values->values_num)
@@ -2616,9 +3254,13 @@ int	zbx_vc_add_values(zbx_vector_ptr_t *history)
 				continue;
 			}
 
-			/* try to remove old (unused) chunks if a new chunk was added */
+			/* try to remove old (unused) chunks and compress the previous head chunk */
+			/* if a new chunk was added                                               */
 			if (head != item->head)
+			{
 				vch_item_clean_cache(item);
+				vch_item_pack_chunks(item);
+			}
 
 		}
 	}
@@ -2628,6 +3270,34 @@ int	zbx_vc_add_values(zbx_vector_ptr_t *history)
 	return SUCCEED;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_remove_items_by_ids                                       *
+ *                                                                            *
+ * Purpose: removes items from value cache                                    *
+ *                                                                            *
+ * Parameters: itemids - [IN] the item identifiers                            *
+ *                                                                            *
+ * Comments: Used when values added with zbx_vc_add_values() turn out to be   *
+ *           not stored in history storage, so the item values are read from  *
+ *           database when accessed next time.                                *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vc_remove_items_by_ids(const zbx_vector_uint64_t *itemids)
+{
+	int	i;
+
+	if (ZBX_VC_DISABLED == vc_state)
+		return;
+
+	WRLOCK_CACHE;
+
+	for (i = 0; i < itemids->values_num; i++)
+		vc_remove_item_by_id(itemids->values[i]);
+
+	UNLOCK_CACHE;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_vc_get_values                                                *
@@ -2708,6 +3378,166 @@ out:
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: vc_prefetch_compare_func                                         *
+ *                                                                            *
+ * Purpose: sorts prefetch requests by itemid and period start                *
+ *                                                                            *
+ ******************************************************************************/
+static int	vc_prefetch_compare_func(const void *d1, const void *d2)
+{
+	const zbx_vc_prefetch_t	*p1 = (const zbx_vc_prefetch_t *)d1;
+	const zbx_vc_prefetch_t	*p2 = (const zbx_vc_prefetch_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(p1->itemid, p2->itemid);
+	ZBX_RETURN_IF_NOT_EQUAL(p1->ts.sec - p1->seconds, p2->ts.sec - p2->seconds);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vc_prefetch_values                                           *
+ *                                                                            *
+ * Purpose: caches history of multiple items with batched history reads       *
+ *                                                                            *
+ * Parameters: requests - [IN] the prefetch requests, sorted by this function *
+ *                                                                            *
+ * Comments: Only the history periods missing in cache are read from history  *
+ *           storage, using one request per batch of items instead of one     *
+ *           request per item. Failures are not reported - the values will be *
+ *           read by zbx_vc_get_values() when requested.                      *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vc_prefetch_values(zbx_vector_vc_prefetch_t *requests)
+{
+	zbx_vector_ptr_t	history_requests;
+	zbx_vc_item_t		*item;
+	int			i, now, items_num = 0, values_num = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() requests:%d", __func__, requests->values_num);
+
+	zbx_vector_ptr_create(&history_requests);
+	zbx_vector_vc_prefetch_sort(requests, vc_prefetch_compare_func);
+
+	RDLOCK_CACHE;
+
+	if (ZBX_VC_DISABLED == vc_state)
+	{
+		UNLOCK_CACHE;
+		goto out;
+	}
+
+	for (i = 0; i < requests->values_num; i++)
+	{
+		zbx_vc_prefetch_t	*prefetch = &requests->values[i];
+		zbx_history_request_t	*request;
+		int			range_start, range_end;
+
+		/* the first item request has the earliest period start and covers the other item requests */
+		if (0 != i && prefetch->itemid == requests->values[i - 1].itemid)
+			continue;
+
+		if (0 > (range_start = prefetch->ts.sec - prefetch->seconds))
+			range_start = 0;
+
+		if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &prefetch->itemid)))
+		{
+			if (ZBX_VC_MODE_NORMAL != vc_cache->mode)
+				continue;
+
+			range_end = ZBX_JAN_2038;
+		}
+		else
+		{
+			if (item->value_type != prefetch->value_type || ZBX_ITEM_STATUS_CACHED_ALL == item->status)
+				continue;
+
+			if (0 != item->db_cached_from && range_start >= item->db_cached_from)
+				continue;
+
+			if (NULL != item->tail)
+				range_end = vch_item_chunk_slots(item, item->tail)[item->tail->first_value].timestamp.sec - 1;
+			else
+				range_end = ZBX_JAN_2038;
+		}
+
+		if (range_start >= range_end)
+			continue;
+
+		request = (zbx_history_request_t *)zbx_malloc(NULL, sizeof(zbx_history_request_t));
+		request->itemid = prefetch->itemid;
+		request->value_type = prefetch->value_type;
+		/* interval starting point is excluded by history backend */
+		request->start = (0 != range_start ? range_start - 1 : 0);
+		request->end = range_end;
+		zbx_history_record_vector_create(&request->values);
+
+		zbx_vector_ptr_append(&history_requests, request);
+	}
+
+	UNLOCK_CACHE;
+
+	if (0 == history_requests.values_num || SUCCEED != zbx_history_get_values_multi(&history_requests))
+		goto out;
+
+	now = time(NULL);
+
+	WRLOCK_CACHE;
+
+	for (i = 0; i < history_requests.values_num && ZBX_VC_DISABLED != vc_state; i++)
+	{
+		zbx_history_request_t	*request = (zbx_history_request_t *)history_requests.values[i];
+
+		zbx_vector_history_record_sort(&request->values,
+				(zbx_compare_func_t)zbx_history_record_compare_asc_func);
+
+		if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_search(&vc_cache->items, &request->itemid)))
+		{
+			zbx_vc_item_t	new_item = {.itemid = request->itemid, .value_type = request->value_type};
+
+			if (NULL == (item = (zbx_vc_item_t *)zbx_hashset_insert(&vc_cache->items, &new_item,
+					sizeof(new_item))))
+			{
+				continue;
+			}
+		}
+		else if (item->value_type != request->value_type)
+			continue;
+
+		/* when updating cache with time based request we can always reset status flags */
+		item->status = 0;
+
+		if (0 < request->values.values_num && SUCCEED != vch_item_add_values_at_tail(item,
+				request->values.values, request->values.values_num))
+		{
+			vc_remove_item(item);
+			continue;
+		}
+
+		vc_item_update_db_cached_from(item, request->start + 1);
+		/* mark the item as accessed, so it's not dropped before the values are requested */
+		vc_update_statistics(item, 0, request->values.values_num, now);
+		items_num++;
+		values_num += request->values.values_num;
+	}
+
+	UNLOCK_CACHE;
+out:
+	for (i = 0; i < history_requests.values_num; i++)
+	{
+		zbx_history_request_t	*request = (zbx_history_request_t *)history_requests.values[i];
+
+		zbx_history_record_vector_destroy(&request->values, request->value_type);
+		zbx_free(request);
+	}
+
+	zbx_vector_ptr_destroy(&history_requests);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() items:%d values:%d", __func__, items_num, values_num);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_vc_get_value                                                 *
@@ -2813,13 +3643,24 @@ void	zbx_vc_disable(void)
  *                                                                            *
  * Purpose: get value cache diagnostic statistics                             *
  *                                                                            *
+ * Parameters: items_num         - [OUT] the number of cached items           *
+ *             values_num        - [OUT] the number of cached values          *
+ *             mode              - [OUT] the value cache operating mode       *
+ *             packed_values_num - [OUT] the number of values stored in       *
+ *                                 compressed chunks                          *
+ *             packed_size       - [OUT] the size of compressed chunks        *
+ *                                                                            *
  ******************************************************************************/
-void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, int *mode)
+void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, int *mode,
+		zbx_uint64_t *packed_values_num, zbx_uint64_t *packed_size)
 {
 	zbx_hashset_iter_t	iter;
 	zbx_vc_item_t		*item;
+	zbx_vc_chunk_t		*chunk;
 
 	*values_num = 0;
+	*packed_values_num = 0;
+	*packed_size = 0;
 
 	if (ZBX_VC_DISABLED == vc_state)
 	{
@@ -2835,8 +3676,19 @@ void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, in
 
 	zbx_hashset_iter_reset(&vc_cache->items, &iter);
 	while (NULL != (item = (zbx_vc_item_t *)zbx_hashset_iter_next(&iter)))
+	{
 		*values_num += item->values_total;
 
+		for (chunk = item->tail; NULL != chunk; chunk = chunk->next)
+		{
+			if (0 >= chunk->packed_size)
+				continue;
+
+			*packed_values_num += chunk->last_value - chunk->first_value + 1;
+			*packed_size += ZBX_VC_CHUNK_HEADER_SIZE + chunk->packed_size;
+		}
+	}
+
 	UNLOCK_CACHE;
 }
 
@@ -50,6 +50,11 @@
  *   either zbx_history_record_vector_destroy() function (free the zbx_vc_get_values()
  *   call output) or zbx_history_record_clear() function (free the zbx_vc_get_value() call output).
  *
+ * Prefetching data
+ *
+ *   History of multiple items can be cached beforehand with zbx_vc_prefetch_values() function,
+ *   which reads the missing time periods with batched history requests.
+ *
  * Locking
  *
  *   The cache ensures synchronization between processes by using automatic locks whenever
@@ -92,6 +97,18 @@ typedef struct
 }
 zbx_vc_item_stats_t;
 
+/* item history prefetch request */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	int		value_type;
+	int		seconds;
+	zbx_timespec_t	ts;
+}
+zbx_vc_prefetch_t;
+
+ZBX_VECTOR_DECL(vc_prefetch, zbx_vc_prefetch_t)
+
 int	zbx_vc_init(char **error);
 
 void	zbx_vc_destroy(void);
@@ -109,11 +126,16 @@ int	zbx_vc_get_value(zbx_uint64_t itemid, int value_type, const zbx_timespec_t *
 
 int	zbx_vc_add_values(zbx_vector_ptr_t *history);
 
+void	zbx_vc_remove_items_by_ids(const zbx_vector_uint64_t *itemids);
+
+void	zbx_vc_prefetch_values(zbx_vector_vc_prefetch_t *requests);
+
 int	zbx_vc_get_statistics(zbx_vc_stats_t *stats);
 
 void	zbx_vc_housekeeping_value_cache(void);
 
-void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, int *mode);
+void	zbx_vc_get_diag_stats(zbx_uint64_t *items_num, zbx_uint64_t *values_num, int *mode,
+		zbx_uint64_t *packed_values_num, zbx_uint64_t *packed_size);
 void	zbx_vc_get_mem_stats(zbx_mem_stats_t *mem);
 void	zbx_vc_get_item_stats(zbx_vector_ptr_t *stats);
 void	zbx_vc_flush_stats(void);
@@ -26,6 +26,7 @@
 #include "dbcache.h"
 #include "zbxalgo.h"
 #include "cfg.h"
+#include "zbxproxybuf.h"
 
 #if defined(HAVE_MYSQL) || defined(HAVE_POSTGRESQL)
 #define ZBX_SUPPORTED_DB_CHARACTER_SET	"utf8"
@@ -57,7 +58,7 @@ zbx_autoreg_host_t;
 extern char	ZBX_PG_ESCAPE_BACKSLASH;
 #endif
 
-static int	connection_failure;
+static ZBX_THREAD_LOCAL int	connection_failure;
 extern unsigned char	program_type;
 
 void	DBclose(void)
@@ -1896,6 +1897,12 @@ void	DBproxy_register_host(const char *host, const char *ip, const char *dns, un
 {
 	char	*host_esc, *ip_esc, *dns_esc, *host_metadata_esc;
 
+	if (SUCCEED == zbx_pmb_autoreg_write((int)time(NULL), host, ip, dns, (int)port, host_metadata, (int)flag,
+			connection_type))
+	{
+		return;
+	}
+
 	host_esc = DBdyn_escape_field("proxy_autoreg_host", "host", host);
 	ip_esc = DBdyn_escape_field("proxy_autoreg_host", "listen_ip", ip);
 	dns_esc = DBdyn_escape_field("proxy_autoreg_host", "listen_dns", dns);
@@ -2727,6 +2734,7 @@ void	zbx_db_insert_prepare_dyn(zbx_db_insert_t *self, const ZBX_TABLE *table, co
 	}
 
 	self->autoincrement = -1;
+	self->binary = 0;
 
 	zbx_vector_ptr_create(&self->fields);
 	zbx_vector_ptr_create(&self->rows);
@@ -2832,7 +2840,8 @@ void	zbx_db_insert_add_values_dyn(zbx_db_insert_t *self, const zbx_db_value_t **
 #ifdef HAVE_ORACLE
 				row[i].str = DBdyn_escape_field_len(field, value->str, ESCAPE_SEQUENCE_OFF);
 #else
-				row[i].str = DBdyn_escape_field_len(field, value->str, ESCAPE_SEQUENCE_ON);
+				row[i].str = DBdyn_escape_field_len(field, value->str,
+						0 == self->binary ? ESCAPE_SEQUENCE_ON : ESCAPE_SEQUENCE_OFF);
 #endif
 				break;
 			default:
@@ -2912,6 +2921,315 @@ void	zbx_db_insert_add_values(zbx_db_insert_t *self, ...)
 	zbx_vector_ptr_destroy(&values);
 }
 
+#ifdef HAVE_POSTGRESQL
+/* binary copy format header - signature, flags and header extension length */
+#define ZBX_PG_COPY_HEADER	"PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0"
+#define ZBX_PG_COPY_HEADER_LEN	19
+
+/* numeric type digits are stored in base 10000 */
+#define ZBX_PG_NUMERIC_BASE	10000
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_copy_append_uint                                              *
+ *                                                                            *
+ * Purpose: appends unsigned integer in network byte order to binary copy     *
+ *          data                                                              *
+ *                                                                            *
+ * Parameters: data        - [IN/OUT] the binary copy data                    *
+ *             data_alloc  - [IN/OUT] the allocated data size                 *
+ *             data_offset - [IN/OUT] the used data size                      *
+ *             value       - [IN] the value to append                         *
+ *             size        - [IN] the value size in bytes (2, 4 or 8)         *
+ *                                                                            *
+ ******************************************************************************/
+static void	db_copy_append_uint(char **data, size_t *data_alloc, size_t *data_offset, zbx_uint64_t value,
+		int size)
+{
+	char	buf[sizeof(zbx_uint64_t)];
+	int	i;
+
+	for (i = size - 1; 0 <= i; i--)
+	{
+		buf[i] = (char)(value & 0xff);
+		value >>= 8;
+	}
+
+	zbx_str_memcpy_alloc(data, data_alloc, data_offset, buf, (size_t)size);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_copy_append_numeric                                           *
+ *                                                                            *
+ * Purpose: appends unsigned integer as numeric type field to binary copy     *
+ *          data                                                              *
+ *                                                                            *
+ * Parameters: data        - [IN/OUT] the binary copy data                    *
+ *             data_alloc  - [IN/OUT] the allocated data size                 *
+ *             data_offset - [IN/OUT] the used data size                      *
+ *             value       - [IN] the value to append                         *
+ *                                                                            *
+ * Comments: Numeric is stored as number of digits, weight of the first       *
+ *           digit, sign and display scale followed by base 10000 digits.     *
+ *                                                                            *
+ ******************************************************************************/
+static void	db_copy_append_numeric(char **data, size_t *data_alloc, size_t *data_offset, zbx_uint64_t value)
+{
+	int	digits[5], digits_num = 0;
+
+	for (; 0 != value; value /= ZBX_PG_NUMERIC_BASE)
+		digits[digits_num++] = (int)(value % ZBX_PG_NUMERIC_BASE);
+
+	db_copy_append_uint(data, data_alloc, data_offset, 8 + 2 * digits_num, 4);
+	db_copy_append_uint(data, data_alloc, data_offset, digits_num, 2);
+	db_copy_append_uint(data, data_alloc, data_offset, 0 == digits_num ? 0 : digits_num - 1, 2);
+	db_copy_append_uint(data, data_alloc, data_offset, 0, 2);
+	db_copy_append_uint(data, data_alloc, data_offset, 0, 2);
+
+	while (0 != digits_num--)
+		db_copy_append_uint(data, data_alloc, data_offset, digits[digits_num], 2);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_insert_copy_binary                                            *
+ *                                                                            *
+ * Purpose: inserts the prepared rows with PostgreSQL binary copy             *
+ *                                                                            *
+ * Parameters: self - [IN] the bulk insert data                               *
+ *                                                                            *
+ * Return value: Returns SUCCEED if the operation completed successfully or   *
+ *               FAIL otherwise.                                              *
+ *                                                                            *
+ * Comments: Binary copy skips formatting values as text on server and        *
+ *           parsing them on database side.                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_insert_copy_binary(const zbx_db_insert_t *self)
+{
+	char		*sql = NULL, *data;
+	size_t		sql_alloc = 0, sql_offset = 0, data_alloc = 16 * ZBX_KIBIBYTE, data_offset = 0, len;
+	int		i, j, rc;
+	const ZBX_FIELD	*field;
+
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "copy %s (", self->table->table);
+
+	for (i = 0; i < self->fields.values_num; i++)
+	{
+		field = (ZBX_FIELD *)self->fields.values[i];
+
+		if (0 != i)
+			zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ',');
+
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, field->name);
+	}
+
+	zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, ") from stdin (format binary)");
+
+	data = (char *)zbx_malloc(NULL, data_alloc);
+	zbx_str_memcpy_alloc(&data, &data_alloc, &data_offset, ZBX_PG_COPY_HEADER, ZBX_PG_COPY_HEADER_LEN);
+
+	for (i = 0; i < self->rows.values_num; i++)
+	{
+		const zbx_db_value_t	*values = (const zbx_db_value_t *)self->rows.values[i];
+
+		db_copy_append_uint(&data, &data_alloc, &data_offset, (zbx_uint64_t)self->fields.values_num, 2);
+
+		for (j = 0; j < self->fields.values_num; j++)
+		{
+			const zbx_db_value_t	*value = &values[j];
+			zbx_uint64_t		dbl_bits;
+
+			field = (const ZBX_FIELD *)self->fields.values[j];
+
+			switch (field->type)
+			{
+				case ZBX_TYPE_CHAR:
+				case ZBX_TYPE_TEXT:
+				case ZBX_TYPE_SHORTTEXT:
+				case ZBX_TYPE_LONGTEXT:
+				case ZBX_TYPE_CUID:
+					len = strlen(value->str);
+					db_copy_append_uint(&data, &data_alloc, &data_offset, len, 4);
+					zbx_str_memcpy_alloc(&data, &data_alloc, &data_offset, value->str, len);
+					break;
+				case ZBX_TYPE_INT:
+					db_copy_append_uint(&data, &data_alloc, &data_offset, 4, 4);
+					db_copy_append_uint(&data, &data_alloc, &data_offset, (zbx_uint32_t)value->i32, 4);
+					break;
+				case ZBX_TYPE_FLOAT:
+					memcpy(&dbl_bits, &value->dbl, sizeof(dbl_bits));
+					db_copy_append_uint(&data, &data_alloc, &data_offset, 8, 4);
+					db_copy_append_uint(&data, &data_alloc, &data_offset, dbl_bits, 8);
+					break;
+				case ZBX_TYPE_UINT:
+					db_copy_append_numeric(&data, &data_alloc, &data_offset, value->ui64);
+					break;
+				case ZBX_TYPE_ID:
+					/* zero identifiers are inserted as null values, -1 length stands for null */
+					if (0 == value->ui64)
+					{
+						db_copy_append_uint(&data, &data_alloc, &data_offset, 0xffffffff, 4);
+						break;
+					}
+
+					db_copy_append_uint(&data, &data_alloc, &data_offset, 8, 4);
+					db_copy_append_uint(&data, &data_alloc, &data_offset, value->ui64, 8);
+					break;
+				default:
+					THIS_SHOULD_NEVER_HAPPEN;
+					exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/* file trailer */
+	db_copy_append_uint(&data, &data_alloc, &data_offset, 0xffff, 2);
+
+	rc = zbx_db_copy_binary(sql, data, data_offset);
+
+	while (ZBX_DB_DOWN == rc)
+	{
+		DBclose();
+		DBconnect(ZBX_DB_CONNECT_NORMAL);
+
+		if (ZBX_DB_DOWN == (rc = zbx_db_copy_binary(sql, data, data_offset)))
+		{
+			zabbix_log(LOG_LEVEL_ERR, "database is down: retrying in %d seconds", ZBX_DB_WAIT_DOWN);
+			connection_failure = 1;
+			sleep(ZBX_DB_WAIT_DOWN);
+		}
+	}
+
+	zbx_free(data);
+	zbx_free(sql);
+
+	return ZBX_DB_OK <= rc ? SUCCEED : FAIL;
+}
+#endif
+
+#ifdef HAVE_MYSQL
+/* the maximum number of rows inserted by one prepared statement */
+#define ZBX_DB_PREPARED_ROWS_MAX	1000
+/* the maximum number of parameter markers in MySQL prepared statement */
+#define ZBX_DB_PREPARED_PARAMS_MAX	65535
+
+/******************************************************************************
+ *                                                                            *
+ * Function: db_insert_execute_prepared                                       *
+ *                                                                            *
+ * Purpose: inserts the prepared rows with MySQL multi-row prepared           *
+ *          statements                                                        *
+ *                                                                            *
+ * Parameters: self        - [IN] the bulk insert data                        *
+ *             sql_command - [IN] the insert statement up to the values       *
+ *             sql_values  - [IN] the default values of missing text fields,  *
+ *                                appended to each row (optional)             *
+ *                                                                            *
+ * Return value: Returns SUCCEED if the operation completed successfully or   *
+ *               FAIL otherwise.                                              *
+ *                                                                            *
+ * Comments: Rows are split in chunks, each chunk is sent in one round trip.  *
+ *           Statements are cached by connection, so only the last chunk of   *
+ *           different size is prepared again.                                *
+ *                                                                            *
+ ******************************************************************************/
+static int	db_insert_execute_prepared(const zbx_db_insert_t *self, const char *sql_command,
+		const char *sql_values)
+{
+	char		*sql = NULL, *sql_row = NULL;
+	size_t		sql_alloc = 0, sql_offset, sql_row_alloc = 0, sql_row_offset = 0, size;
+	unsigned char	*types;
+	int		i, j, rows_max, rows_num, sql_rows_num = 0, rc = ZBX_DB_OK;
+
+	types = (unsigned char *)zbx_malloc(NULL, (size_t)self->fields.values_num);
+
+	zbx_chrcpy_alloc(&sql_row, &sql_row_alloc, &sql_row_offset, '(');
+
+	for (j = 0; j < self->fields.values_num; j++)
+	{
+		types[j] = ((const ZBX_FIELD *)self->fields.values[j])->type;
+
+		if (0 != j)
+			zbx_chrcpy_alloc(&sql_row, &sql_row_alloc, &sql_row_offset, ',');
+
+		zbx_chrcpy_alloc(&sql_row, &sql_row_alloc, &sql_row_offset, '?');
+	}
+
+	if (NULL != sql_values)
+		zbx_strcpy_alloc(&sql_row, &sql_row_alloc, &sql_row_offset, sql_values);
+
+	zbx_chrcpy_alloc(&sql_row, &sql_row_alloc, &sql_row_offset, ')');
+
+	rows_max = MIN(ZBX_DB_PREPARED_ROWS_MAX, ZBX_DB_PREPARED_PARAMS_MAX / self->fields.values_num);
+
+	for (i = 0; i < self->rows.values_num && ZBX_DB_OK <= rc; i += rows_num)
+	{
+		zbx_db_value_t	**rows = (zbx_db_value_t **)self->rows.values + i;
+
+		/* limit the chunk data size like the size of text insert statements */
+		for (rows_num = 0, size = 0; i + rows_num < self->rows.values_num && rows_num < rows_max &&
+				size < ZBX_MAX_SQL_SIZE; rows_num++)
+		{
+			for (j = 0; j < self->fields.values_num; j++)
+			{
+				switch (types[j])
+				{
+					case ZBX_TYPE_CHAR:
+					case ZBX_TYPE_TEXT:
+					case ZBX_TYPE_SHORTTEXT:
+					case ZBX_TYPE_LONGTEXT:
+					case ZBX_TYPE_CUID:
+						size += strlen(rows[rows_num][j].str);
+						break;
+					default:
+						size += sizeof(zbx_uint64_t);
+				}
+			}
+		}
+
+		if (rows_num != sql_rows_num)
+		{
+			sql_offset = 0;
+			zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, sql_command);
+
+			for (j = 0; j < rows_num; j++)
+			{
+				if (0 != j)
+					zbx_chrcpy_alloc(&sql, &sql_alloc, &sql_offset, ',');
+
+				zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, sql_row);
+			}
+
+			sql_rows_num = rows_num;
+		}
+
+		rc = zbx_db_execute_prepared(sql, types, self->fields.values_num, rows, rows_num);
+
+		while (ZBX_DB_DOWN == rc)
+		{
+			DBclose();
+			DBconnect(ZBX_DB_CONNECT_NORMAL);
+
+			if (ZBX_DB_DOWN == (rc = zbx_db_execute_prepared(sql, types, self->fields.values_num, rows,
+					rows_num)))
+			{
+				zabbix_log(LOG_LEVEL_ERR, "database is down: retrying in %d seconds", ZBX_DB_WAIT_DOWN);
+				connection_failure = 1;
+				sleep(ZBX_DB_WAIT_DOWN);
+			}
+		}
+	}
+
+	zbx_free(sql_row);
+	zbx_free(sql);
+	zbx_free(types);
+
+	return ZBX_DB_OK <= rc ? SUCCEED : FAIL;
+}
+#endif
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_insert_execute                                            *
@@ -2962,6 +3280,11 @@ int	zbx_db_insert_execute(zbx_db_insert_t *self)
 		}
 	}
 
+#ifdef HAVE_POSTGRESQL
+	if (0 != self->binary)
+		return db_insert_copy_binary(self);
+#endif
+
 #ifndef HAVE_ORACLE
 	sql = (char *)zbx_malloc(NULL, sql_alloc);
 #endif
@@ -3007,6 +3330,14 @@ int	zbx_db_insert_execute(zbx_db_insert_t *self)
 #endif
 	zbx_strcpy_alloc(&sql_command, &sql_command_alloc, &sql_command_offset, ") values ");
 
+#ifdef HAVE_MYSQL
+	if (0 != self->binary)
+	{
+		ret = db_insert_execute_prepared(self, sql_command, sql_values);
+		goto out;
+	}
+#endif
+
 #ifdef HAVE_ORACLE
 	for (i = 0; i < self->fields.values_num; i++)
 	{
@@ -3190,6 +3521,29 @@ void	zbx_db_insert_autoincrement(zbx_db_insert_t *self, const char *field_name)
 	exit(EXIT_FAILURE);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_db_insert_binary                                             *
+ *                                                                            *
+ * Purpose: inserts rows in binary format instead of text insert statements   *
+ *                                                                            *
+ * Parameters: self - [IN] the bulk insert data                               *
+ *                                                                            *
+ * Comments: Must be called before adding values. Rows are inserted with      *
+ *           binary copy on PostgreSQL and with multi-row prepared statements *
+ *           on MySQL, the setting is ignored with other databases. With      *
+ *           PostgreSQL the float fields must be of double precision type.    *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_db_insert_binary(zbx_db_insert_t *self)
+{
+#if defined(HAVE_POSTGRESQL) || defined(HAVE_MYSQL)
+	self->binary = 1;
+#else
+	ZBX_UNUSED(self);
+#endif
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_db_get_database_type                                         *
@@ -26,6 +26,7 @@
 
 #include "proxy.h"
 #include "dbcache.h"
+#include "zbxproxybuf.h"
 #include "discovery.h"
 #include "zbxalgo.h"
 #include "preproc.h"
@@ -34,6 +35,7 @@
 #include "events.h"
 #include "zbxvault.h"
 #include "zbxavailability.h"
+#include "zbxcompress.h"
 
 extern char	*CONFIG_SERVER;
 extern char	*CONFIG_VAULTDBPATH;
@@ -47,6 +49,57 @@ extern char	*CONFIG_VAULTDBPATH;
 /* the maximum number of values processed in one batch */
 #define ZBX_HISTORY_VALUES_MAX		256
 
+/* binary history data format, see history_binary_finish() for the layout description */
+#define ZBX_HISTORY_BINARY_VERSION	1
+
+#define ZBX_HISTORY_BINARY_COLUMN_ID		0
+#define ZBX_HISTORY_BINARY_COLUMN_ITEMID	1
+#define ZBX_HISTORY_BINARY_COLUMN_CLOCK		2
+#define ZBX_HISTORY_BINARY_COLUMN_NS		3
+#define ZBX_HISTORY_BINARY_COLUMN_FLAGS		4
+#define ZBX_HISTORY_BINARY_COLUMN_VALUE		5
+#define ZBX_HISTORY_BINARY_COLUMN_LOG		6
+#define ZBX_HISTORY_BINARY_COLUMN_META		7
+#define ZBX_HISTORY_BINARY_COLUMNS_NUM		8
+
+#define ZBX_HISTORY_BINARY_FLAG_NOTSUPPORTED	0x01
+#define ZBX_HISTORY_BINARY_FLAG_VALUE		0x02
+#define ZBX_HISTORY_BINARY_FLAG_LOG		0x04
+#define ZBX_HISTORY_BINARY_FLAG_META		0x08
+
+/* the maximum length of variable length encoded 64 bit integer */
+#define ZBX_HISTORY_BINARY_UINT64_LEN	10
+
+typedef struct
+{
+	char	*data;
+	size_t	data_alloc;
+	size_t	data_offset;
+}
+zbx_history_binary_column_t;
+
+typedef struct
+{
+	zbx_history_binary_column_t	columns[ZBX_HISTORY_BINARY_COLUMNS_NUM];
+	zbx_uint64_t			id;
+	zbx_uint64_t			itemid;
+	int				clock;
+	int				rows_num;
+}
+zbx_history_binary_t;
+
+typedef struct
+{
+	const unsigned char	*columns[ZBX_HISTORY_BINARY_COLUMNS_NUM];
+	const unsigned char	*ends[ZBX_HISTORY_BINARY_COLUMNS_NUM];
+	zbx_uint64_t		id;
+	zbx_uint64_t		itemid;
+	int			clock;
+	int			rows_num;
+	int			rows_read;
+}
+zbx_history_binary_reader_t;
+
 typedef struct
 {
 	zbx_uint64_t		druleid;
@@ -127,6 +180,20 @@ static zbx_history_table_t	areg = {
 		}
 };
 
+/* the last record sent to server but not acknowledged yet by pipelining data sender, */
+/* tagged with data source as buffer and database record ids are not related        */
+typedef struct
+{
+	zbx_uint64_t	lastid;
+	int		source;
+}
+zbx_proxy_sent_t;
+
+static zbx_proxy_sent_t	proxy_sent[ZBX_PMB_TABLE_COUNT];
+
+/* the data source of the last read batch, ZBX_PMB_READ_* */
+static int		proxy_read_source[ZBX_PMB_TABLE_COUNT];
+
 typedef struct
 {
 	char		*path;
@@ -2295,16 +2362,28 @@ static void	proxy_set_lastid(const char *table_name, const char *lastidfield, co
 
 void	proxy_set_hist_lastid(const zbx_uint64_t lastid)
 {
-	proxy_set_lastid("proxy_history", "history_lastid", lastid);
+	if (SUCCEED == zbx_pmb_set_lastid(ZBX_PMB_HISTORY, lastid))
+		return;
+
+	if (SUCCEED == zbx_pb_history_enabled())
+		zbx_pb_history_set_lastid(lastid);
+	else
+		proxy_set_lastid("proxy_history", "history_lastid", lastid);
 }
 
 void	proxy_set_dhis_lastid(const zbx_uint64_t lastid)
 {
+	if (SUCCEED == zbx_pmb_set_lastid(ZBX_PMB_DISCOVERY, lastid))
+		return;
+
 	proxy_set_lastid(dht.table, dht.lastidfield, lastid);
 }
 
 void	proxy_set_areg_lastid(const zbx_uint64_t lastid)
 {
+	if (SUCCEED == zbx_pmb_set_lastid(ZBX_PMB_AUTOREG, lastid))
+		return;
+
 	proxy_set_lastid(areg.table, areg.lastidfield, lastid);
 }
 
@@ -2315,6 +2394,12 @@ int	proxy_get_delay(const zbx_uint64_t lastid)
 	char		*sql = NULL;
 	int		ts = 0;
 
+	if (SUCCEED == zbx_pmb_history_get_delay(lastid, &ts))
+		return ts;
+
+	if (SUCCEED == zbx_pb_history_enabled())
+		return zbx_pb_history_get_delay(lastid);
+
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() [lastid=" ZBX_FS_UI64 "]", __func__, lastid);
 
 	sql = zbx_dsprintf(sql, "select write_clock from proxy_history where id>" ZBX_FS_UI64 " order by id asc",
@@ -2333,6 +2418,40 @@ int	proxy_get_delay(const zbx_uint64_t lastid)
 	return ts;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_add_history_data_simple                                    *
+ *                                                                            *
+ * Purpose: adds discovery or autoregistration record to proxy data json      *
+ *                                                                            *
+ * Parameters: j           - [IN/OUT] the proxy data json                     *
+ *             proto_tag   - [IN] the record array tag                        *
+ *             ht          - [IN] the history table                           *
+ *             fields      - [IN] the record fields in table field order      *
+ *             records_num - [IN] the number of records already added         *
+ *                                                                            *
+ ******************************************************************************/
+static void	proxy_add_history_data_simple(struct zbx_json *j, const char *proto_tag, const zbx_history_table_t *ht,
+		const char * const *fields, int records_num)
+{
+	int	f;
+
+	if (0 == records_num)
+		zbx_json_addarray(j, proto_tag);
+
+	zbx_json_addobject(j, NULL);
+
+	for (f = 0; NULL != ht->fields[f].field; f++)
+	{
+		if (NULL != ht->fields[f].default_value && 0 == strcmp(fields[f], ht->fields[f].default_value))
+			continue;
+
+		zbx_json_addstring(j, ht->fields[f].tag, fields[f], ht->fields[f].jt);
+	}
+
+	zbx_json_close(j);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: proxy_get_history_data_simple                                    *
@@ -2389,22 +2508,57 @@ try_again:
 			}
 		}
 
-		if (0 == *records_num)
-			zbx_json_addarray(j, proto_tag);
-
-		zbx_json_addobject(j, NULL);
+		proxy_add_history_data_simple(j, proto_tag, ht, (const char * const *)row + 1, (*records_num)++);
 
-		for (f = 0; NULL != ht->fields[f].field; f++)
+		/* stop gathering data to avoid exceeding the maximum packet size */
+		if (ZBX_DATA_JSON_RECORD_LIMIT < j->buffer_offset)
 		{
-			if (NULL != ht->fields[f].default_value && 0 == strcmp(row[f + 1], ht->fields[f].default_value))
-				continue;
-
-			zbx_json_addstring(j, ht->fields[f].tag, row[f + 1], ht->fields[f].jt);
+			*more = ZBX_PROXY_DATA_MORE;
+			break;
 		}
 
-		(*records_num)++;
+		*id = *lastid;
+	}
+	DBfree_result(result);
+
+	if (ZBX_MAX_HRECORDS == *records_num - records_num_last)
+		*more = ZBX_PROXY_DATA_MORE;
 
-		zbx_json_close(j);
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%d lastid:" ZBX_FS_UI64 " more:%d size:" ZBX_FS_SIZE_T,
+			__func__, *records_num - records_num_last, *lastid, *more,
+			(zbx_fs_size_t)j->buffer_offset);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_get_history_buffer_data_simple                             *
+ *                                                                            *
+ * Purpose: get discovery or autoregistration data from the proxy memory      *
+ *          buffer                                                            *
+ *                                                                            *
+ * Parameters: table - [IN] the proxy memory buffer table                     *
+ *             ...   - see proxy_get_history_data_simple()                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	proxy_get_history_buffer_data_simple(struct zbx_json *j, const char *proto_tag,
+		const zbx_history_table_t *ht, unsigned char table, zbx_uint64_t *lastid, zbx_uint64_t *id,
+		int *records_num, int *more)
+{
+	int		i, rows_num, records_num_last = *records_num;
+	zbx_pmb_row_t	*rows;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() table:'%s'", __func__, ht->table);
+
+	*more = ZBX_PROXY_DATA_DONE;
+
+	rows = (zbx_pmb_row_t *)zbx_malloc(NULL, sizeof(zbx_pmb_row_t) * ZBX_MAX_HRECORDS);
+	rows_num = zbx_pmb_rows_read(table, *id, rows, ZBX_MAX_HRECORDS);
+
+	for (i = 0; i < rows_num; i++)
+	{
+		*lastid = rows[i].id;
+
+		proxy_add_history_data_simple(j, proto_tag, ht, rows[i].fields, (*records_num)++);
 
 		/* stop gathering data to avoid exceeding the maximum packet size */
 		if (ZBX_DATA_JSON_RECORD_LIMIT < j->buffer_offset)
@@ -2415,7 +2569,8 @@ try_again:
 
 		*id = *lastid;
 	}
-	DBfree_result(result);
+
+	zbx_free(rows);
 
 	if (ZBX_MAX_HRECORDS == *records_num - records_num_last)
 		*more = ZBX_PROXY_DATA_MORE;
@@ -2443,13 +2598,130 @@ typedef struct
 }
 zbx_history_data_t;
 
+typedef int	(*zbx_history_read_func_t)(zbx_uint64_t lastid, zbx_pb_history_t *records, int records_max);
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_history_data_add_strings                                   *
+ *                                                                            *
+ * Purpose: copies history record source and value into string buffer         *
+ *                                                                            *
+ ******************************************************************************/
+static void	proxy_history_data_add_strings(zbx_history_data_t *hd, const char *source, const char *value,
+		char **string_buffer, size_t *string_buffer_alloc, size_t *string_buffer_offset)
+{
+	size_t	len1, len2;
+
+	len1 = strlen(source) + 1;
+	len2 = strlen(value) + 1;
+
+	if (*string_buffer_alloc < *string_buffer_offset + len1 + len2)
+	{
+		while (*string_buffer_alloc < *string_buffer_offset + len1 + len2)
+			*string_buffer_alloc += ZBX_KIBIBYTE;
+
+		*string_buffer = (char *)zbx_realloc(*string_buffer, *string_buffer_alloc);
+	}
+
+	hd->source_offset = *string_buffer_offset;
+	memcpy(*string_buffer + hd->source_offset, source, len1);
+	*string_buffer_offset += len1;
+
+	hd->value_offset = *string_buffer_offset;
+	memcpy(*string_buffer + hd->value_offset, value, len2);
+	*string_buffer_offset += len2;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_get_history_buffer_data                                    *
+ *                                                                            *
+ * Purpose: read proxy history data from the proxy history buffer or proxy    *
+ *          memory buffer                                                     *
+ *                                                                            *
+ * Parameters: read_func - [IN] the buffer read function                      *
+ *             ...       - see proxy_get_history_data()                       *
+ *                                                                            *
+ * Return value: The number of records read.                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_get_history_buffer_data(zbx_history_read_func_t read_func, zbx_uint64_t lastid,
+		zbx_history_data_t **data, size_t *data_alloc, char **string_buffer, size_t *string_buffer_alloc,
+		int *more)
+{
+	size_t			data_num = 0, string_buffer_offset = 0;
+	int			i, records_num;
+	zbx_pb_history_t	*records;
+	zbx_history_data_t	*hd;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() lastid:" ZBX_FS_UI64, __func__, lastid);
+
+	records = (zbx_pb_history_t *)zbx_malloc(NULL, sizeof(zbx_pb_history_t) * ZBX_MAX_HRECORDS);
+
+	while (ZBX_MAX_HRECORDS > data_num && 0 != (records_num = read_func(lastid, records,
+			ZBX_MAX_HRECORDS - (int)data_num)))
+	{
+		for (i = 0; i < records_num; i++)
+		{
+			const zbx_pb_history_t	*r = &records[i];
+
+			if (*data_alloc == data_num)
+			{
+				*data_alloc *= 2;
+				*data = (zbx_history_data_t *)zbx_realloc(*data, sizeof(zbx_history_data_t) * *data_alloc);
+			}
+
+			hd = *data + data_num++;
+			hd->id = r->id;
+			hd->itemid = r->itemid;
+			hd->flags = r->flags;
+			hd->clock = r->clock;
+			hd->ns = r->ns;
+
+			if (PROXY_HISTORY_FLAG_NOVALUE == (hd->flags & PROXY_HISTORY_MASK_NOVALUE))
+				continue;
+
+			hd->state = r->state;
+
+			if (0 == (hd->flags & PROXY_HISTORY_FLAG_NOVALUE))
+			{
+				hd->timestamp = r->timestamp;
+				hd->severity = r->severity;
+				hd->logeventid = r->logeventid;
+
+				proxy_history_data_add_strings(hd, r->source, r->value, string_buffer,
+						string_buffer_alloc, &string_buffer_offset);
+			}
+
+			if (0 != (hd->flags & PROXY_HISTORY_FLAG_META))
+			{
+				hd->lastlogsize = r->lastlogsize;
+				hd->mtime = r->mtime;
+			}
+		}
+
+		lastid = records[records_num - 1].id;
+	}
+
+	zbx_free(records);
+
+	if (ZBX_MAX_HRECORDS != data_num)
+		*more = ZBX_PROXY_DATA_DONE;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() data_num:" ZBX_FS_SIZE_T, __func__, data_num);
+
+	return data_num;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: proxy_get_history_data                                           *
  *                                                                            *
  * Purpose: read proxy history data from the database                         *
  *                                                                            *
- * Parameters: lastid             - [IN] the id of last processed proxy       *
+ * Parameters: read_func          - [IN] the buffer read function, NULL to    *
+ *                                       read proxy_history table             *
+ *             lastid             - [IN] the id of last processed proxy       *
  *                                       history record                       *
  *             data               - [IN/OUT] the proxy history data buffer    *
  *             data_alloc         - [IN/OUT] the size of proxy history data   *
@@ -2462,8 +2734,9 @@ zbx_history_data_t;
  * Return value: The number of records read.                                  *
  *                                                                            *
  ******************************************************************************/
-static int	proxy_get_history_data(zbx_uint64_t lastid, zbx_history_data_t **data, size_t *data_alloc,
-		char **string_buffer, size_t *string_buffer_alloc, int *more)
+static int	proxy_get_history_data(zbx_history_read_func_t read_func, zbx_uint64_t lastid,
+		zbx_history_data_t **data, size_t *data_alloc, char **string_buffer, size_t *string_buffer_alloc,
+		int *more)
 {
 
 	DB_RESULT		result;
@@ -2476,6 +2749,12 @@ static int	proxy_get_history_data(zbx_uint64_t lastid, zbx_history_data_t **data
 	struct timespec		t_sleep = { 0, 100000000L }, t_rem;
 	zbx_history_data_t	*hd;
 
+	if (NULL != read_func)
+	{
+		return proxy_get_history_buffer_data(read_func, lastid, data, data_alloc, string_buffer,
+				string_buffer_alloc, more);
+	}
+
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() lastid:" ZBX_FS_UI64, __func__, lastid);
 
 try_again:
@@ -2542,30 +2821,12 @@ try_again:
 
 			if (0 == (hd->flags & PROXY_HISTORY_FLAG_NOVALUE))
 			{
-				size_t	len1, len2;
-
 				hd->timestamp = atoi(row[4]);
 				hd->severity = atoi(row[6]);
 				hd->logeventid = atoi(row[8]);
 
-				len1 = strlen(row[5]) + 1;
-				len2 = strlen(row[7]) + 1;
-
-				if (*string_buffer_alloc < string_buffer_offset + len1 + len2)
-				{
-					while (*string_buffer_alloc < string_buffer_offset + len1 + len2)
-						*string_buffer_alloc += ZBX_KIBIBYTE;
-
-					*string_buffer = (char *)zbx_realloc(*string_buffer, *string_buffer_alloc);
-				}
-
-				hd->source_offset = string_buffer_offset;
-				memcpy(*string_buffer + hd->source_offset, row[5], len1);
-				string_buffer_offset += len1;
-
-				hd->value_offset = string_buffer_offset;
-				memcpy(*string_buffer + hd->value_offset, row[7], len2);
-				string_buffer_offset += len2;
+				proxy_history_data_add_strings(hd, row[5], row[7], string_buffer, string_buffer_alloc,
+						&string_buffer_offset);
 			}
 
 			if (0 != (hd->flags & PROXY_HISTORY_FLAG_META))
@@ -2589,83 +2850,349 @@ try_again:
 
 /******************************************************************************
  *                                                                            *
- * Function: proxy_add_hist_data                                              *
+ * Function: history_binary_reserve                                           *
  *                                                                            *
- * Purpose: add history records to output json                                *
+ * Purpose: ensures binary history column can hold the specified number of    *
+ *          bytes more                                                        *
  *                                                                            *
- * Parameters: j             - [IN] the json output buffer                    *
- *             records_num   - [IN] the total number of records added         *
- *             dc_items      - [IN] the item configuration data               *
- *             errcodes      - [IN] the item configuration status codes       *
- *             records       - [IN] the records to add                        *
- *             string_buffer - [IN] the string buffer holding string values   *
- *             lastid        - [OUT] the id of last added record              *
+ * Parameters: column - [IN/OUT] the column                                   *
+ *             size   - [IN] the number of bytes to reserve                   *
  *                                                                            *
- * Return value: The total number of records added.                           *
+ ******************************************************************************/
+static void	history_binary_reserve(zbx_history_binary_column_t *column, size_t size)
+{
+	if (column->data_alloc >= column->data_offset + size)
+		return;
+
+	if (0 == column->data_alloc)
+		column->data_alloc = ZBX_KIBIBYTE;
+
+	while (column->data_alloc < column->data_offset + size)
+		column->data_alloc *= 2;
+
+	column->data = (char *)zbx_realloc(column->data, column->data_alloc);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_write_uint64                                      *
+ *                                                                            *
+ * Purpose: writes unsigned integer into binary history column as little      *
+ *          endian base 128 variable length value                             *
+ *                                                                            *
+ * Parameters: column - [IN/OUT] the column                                   *
+ *             value  - [IN] the value to write                               *
  *                                                                            *
  ******************************************************************************/
-static int	proxy_add_hist_data(struct zbx_json *j, int records_num, const DC_ITEM *dc_items, const int *errcodes,
-		const zbx_vector_ptr_t *records, const char *string_buffer, zbx_uint64_t *lastid)
+static void	history_binary_write_uint64(zbx_history_binary_column_t *column, zbx_uint64_t value)
 {
-	int				i;
-	const zbx_history_data_t	*hd;
+	history_binary_reserve(column, ZBX_HISTORY_BINARY_UINT64_LEN);
 
-	for (i = records->values_num - 1; i >= 0; i--)
+	while (0x80 <= value)
 	{
-		hd = (const zbx_history_data_t *)records->values[i];
-		*lastid = hd->id;
+		column->data[column->data_offset++] = (char)(value | 0x80);
+		value >>= 7;
+	}
 
-		if (SUCCEED != errcodes[i])
-			continue;
+	column->data[column->data_offset++] = (char)value;
+}
 
-		if (ITEM_STATUS_ACTIVE != dc_items[i].status)
-			continue;
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_write_int64                                       *
+ *                                                                            *
+ * Purpose: writes signed integer into binary history column                  *
+ *                                                                            *
+ * Parameters: column - [IN/OUT] the column                                   *
+ *             value  - [IN] the value to write                               *
+ *                                                                            *
+ * Comments: The value is zigzag encoded so small negative values (deltas)    *
+ *           take as few bytes as small positive values.                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	history_binary_write_int64(zbx_history_binary_column_t *column, zbx_int64_t value)
+{
+	history_binary_write_uint64(column, 0 > value ? ~((zbx_uint64_t)value << 1) : (zbx_uint64_t)value << 1);
+}
 
-		if (HOST_STATUS_MONITORED != dc_items[i].host.status)
-			continue;
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_write_str                                         *
+ *                                                                            *
+ * Purpose: writes length prefixed string into binary history column          *
+ *                                                                            *
+ * Parameters: column - [IN/OUT] the column                                   *
+ *             str    - [IN] the string to write                              *
+ *                                                                            *
+ ******************************************************************************/
+static void	history_binary_write_str(zbx_history_binary_column_t *column, const char *str)
+{
+	size_t	len;
 
-		if (PROXY_HISTORY_FLAG_NOVALUE == (hd->flags & PROXY_HISTORY_MASK_NOVALUE))
-		{
-			if (SUCCEED != zbx_is_counted_in_item_queue(dc_items[i].type, dc_items[i].key_orig))
-				continue;
-		}
+	len = strlen(str);
+	history_binary_write_uint64(column, len);
+	history_binary_reserve(column, len);
+	memcpy(column->data + column->data_offset, str, len);
+	column->data_offset += len;
+}
 
-		if (0 == records_num)
-			zbx_json_addarray(j, ZBX_PROTO_TAG_HISTORY_DATA);
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_add_row                                           *
+ *                                                                            *
+ * Purpose: adds history record to binary history data                        *
+ *                                                                            *
+ * Parameters: bin           - [IN/OUT] the binary history data               *
+ *             hd            - [IN] the history record                        *
+ *             string_buffer - [IN] the string buffer holding string values   *
+ *                                                                            *
+ * Comments: The record fields are written in the same cases as they would    *
+ *           be added to history data json by proxy_add_hist_data().          *
+ *                                                                            *
+ ******************************************************************************/
+static void	history_binary_add_row(zbx_history_binary_t *bin, const zbx_history_data_t *hd,
+		const char *string_buffer)
+{
+	zbx_history_binary_column_t	*columns = bin->columns;
+	unsigned char			flags = 0;
 
-		zbx_json_addobject(j, NULL);
-		zbx_json_adduint64(j, ZBX_PROTO_TAG_ID, hd->id);
-		zbx_json_adduint64(j, ZBX_PROTO_TAG_ITEMID, hd->itemid);
-		zbx_json_adduint64(j, ZBX_PROTO_TAG_CLOCK, hd->clock);
-		zbx_json_adduint64(j, ZBX_PROTO_TAG_NS, hd->ns);
+	history_binary_write_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_ID], (zbx_int64_t)(hd->id - bin->id));
+	history_binary_write_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_ITEMID],
+			(zbx_int64_t)(hd->itemid - bin->itemid));
+	history_binary_write_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_CLOCK], (zbx_int64_t)hd->clock - bin->clock);
+	history_binary_write_uint64(&columns[ZBX_HISTORY_BINARY_COLUMN_NS], (zbx_uint64_t)hd->ns);
 
-		if (PROXY_HISTORY_FLAG_NOVALUE != (hd->flags & PROXY_HISTORY_MASK_NOVALUE))
-		{
-			if (ITEM_STATE_NORMAL != hd->state)
-				zbx_json_adduint64(j, ZBX_PROTO_TAG_STATE, hd->state);
+	bin->id = hd->id;
+	bin->itemid = hd->itemid;
+	bin->clock = hd->clock;
 
-			if (0 == (hd->flags & PROXY_HISTORY_FLAG_NOVALUE))
-			{
-				if (0 != hd->timestamp)
-					zbx_json_adduint64(j, ZBX_PROTO_TAG_LOGTIMESTAMP, hd->timestamp);
+	if (PROXY_HISTORY_FLAG_NOVALUE != (hd->flags & PROXY_HISTORY_MASK_NOVALUE))
+	{
+		if (ITEM_STATE_NORMAL != hd->state)
+			flags |= ZBX_HISTORY_BINARY_FLAG_NOTSUPPORTED;
 
-				if ('\0' != string_buffer[hd->source_offset])
-				{
-					zbx_json_addstring(j, ZBX_PROTO_TAG_LOGSOURCE,
-							string_buffer + hd->source_offset, ZBX_JSON_TYPE_STRING);
-				}
+		if (0 == (hd->flags & PROXY_HISTORY_FLAG_NOVALUE))
+		{
+			const char	*source = string_buffer + hd->source_offset;
 
-				if (0 != hd->severity)
-					zbx_json_adduint64(j, ZBX_PROTO_TAG_LOGSEVERITY, hd->severity);
+			flags |= ZBX_HISTORY_BINARY_FLAG_VALUE;
+			history_binary_write_str(&columns[ZBX_HISTORY_BINARY_COLUMN_VALUE],
+					string_buffer + hd->value_offset);
 
-				if (0 != hd->logeventid)
-					zbx_json_adduint64(j, ZBX_PROTO_TAG_LOGEVENTID, hd->logeventid);
+			if (0 != hd->timestamp || '\0' != *source || 0 != hd->severity || 0 != hd->logeventid)
+			{
+				zbx_history_binary_column_t	*column = &columns[ZBX_HISTORY_BINARY_COLUMN_LOG];
 
-				zbx_json_addstring(j, ZBX_PROTO_TAG_VALUE, string_buffer + hd->value_offset,
-						ZBX_JSON_TYPE_STRING);
+				flags |= ZBX_HISTORY_BINARY_FLAG_LOG;
+				history_binary_write_int64(column, hd->timestamp);
+				history_binary_write_str(column, source);
+				history_binary_write_int64(column, hd->severity);
+				history_binary_write_int64(column, hd->logeventid);
 			}
+		}
 
-			if (0 != (hd->flags & PROXY_HISTORY_FLAG_META))
+		if (0 != (hd->flags & PROXY_HISTORY_FLAG_META))
+		{
+			flags |= ZBX_HISTORY_BINARY_FLAG_META;
+			history_binary_write_uint64(&columns[ZBX_HISTORY_BINARY_COLUMN_META], hd->lastlogsize);
+			history_binary_write_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_META], hd->mtime);
+		}
+	}
+
+	history_binary_reserve(&columns[ZBX_HISTORY_BINARY_COLUMN_FLAGS], 1);
+	columns[ZBX_HISTORY_BINARY_COLUMN_FLAGS].data[columns[ZBX_HISTORY_BINARY_COLUMN_FLAGS].data_offset++] =
+			(char)flags;
+
+	bin->rows_num++;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_size                                              *
+ *                                                                            *
+ * Purpose: gets the upper bound of binary history data block size            *
+ *                                                                            *
+ * Parameters: bin - [IN] the binary history data                             *
+ *                                                                            *
+ * Return value: The size of binary history data block in bytes.              *
+ *                                                                            *
+ ******************************************************************************/
+static size_t	history_binary_size(const zbx_history_binary_t *bin)
+{
+	size_t	size = 1 + ZBX_HISTORY_BINARY_UINT64_LEN * (1 + ZBX_HISTORY_BINARY_COLUMNS_NUM);
+	int	i;
+
+	for (i = 0; i < ZBX_HISTORY_BINARY_COLUMNS_NUM; i++)
+		size += bin->columns[i].data_offset;
+
+	return size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_finish                                            *
+ *                                                                            *
+ * Purpose: joins binary history data columns into data block                 *
+ *                                                                            *
+ * Parameters: bin      - [IN] the binary history data                        *
+ *             data     - [OUT] the binary history data block                 *
+ *             data_len - [OUT] the binary history data block size            *
+ *                                                                            *
+ * Comments: The binary history data block has the following layout:          *
+ *             version  - one byte, ZBX_HISTORY_BINARY_VERSION                *
+ *             rows     - the number of rows                                  *
+ *             columns  - ZBX_HISTORY_BINARY_COLUMNS_NUM columns, each one    *
+ *                        prefixed with its size in bytes:                    *
+ *               id     - the record id delta from previous row               *
+ *               itemid - the item id delta from previous row                 *
+ *               clock  - the clock delta from previous row                   *
+ *               ns     - the nanoseconds                                     *
+ *               flags  - one byte per row, ZBX_HISTORY_BINARY_FLAG_* bits    *
+ *               value  - the values of rows with value flag set              *
+ *               log    - the log timestamp, source, severity and event id    *
+ *                        of rows with log flag set                           *
+ *               meta   - the lastlogsize and mtime of rows with meta flag    *
+ *                        set                                                 *
+ *           Integers are encoded as little endian base 128 variable length   *
+ *           values, signed values and deltas are zigzag encoded. Strings are *
+ *           prefixed with their length.                                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	history_binary_finish(const zbx_history_binary_t *bin, char **data, size_t *data_len)
+{
+	zbx_history_binary_column_t	block = {NULL, 0, 0};
+	int				i;
+
+	history_binary_reserve(&block, history_binary_size(bin));
+	block.data[block.data_offset++] = ZBX_HISTORY_BINARY_VERSION;
+	history_binary_write_uint64(&block, (zbx_uint64_t)bin->rows_num);
+
+	for (i = 0; i < ZBX_HISTORY_BINARY_COLUMNS_NUM; i++)
+	{
+		history_binary_write_uint64(&block, bin->columns[i].data_offset);
+
+		if (0 != bin->columns[i].data_offset)
+		{
+			memcpy(block.data + block.data_offset, bin->columns[i].data, bin->columns[i].data_offset);
+			block.data_offset += bin->columns[i].data_offset;
+		}
+	}
+
+	*data = block.data;
+	*data_len = block.data_offset;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_clear                                             *
+ *                                                                            *
+ * Purpose: frees resources allocated by binary history data                  *
+ *                                                                            *
+ * Parameters: bin - [IN] the binary history data                             *
+ *                                                                            *
+ ******************************************************************************/
+static void	history_binary_clear(zbx_history_binary_t *bin)
+{
+	int	i;
+
+	for (i = 0; i < ZBX_HISTORY_BINARY_COLUMNS_NUM; i++)
+		zbx_free(bin->columns[i].data);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_add_hist_data                                              *
+ *                                                                            *
+ * Purpose: add history records to output json or binary history data         *
+ *                                                                            *
+ * Parameters: j             - [IN] the json output buffer                    *
+ *             bin           - [IN/OUT] the binary history data, NULL to add  *
+ *                                      records to json                       *
+ *             records_num   - [IN] the total number of records added         *
+ *             dc_items      - [IN] the item configuration data               *
+ *             errcodes      - [IN] the item configuration status codes       *
+ *             records       - [IN] the records to add                        *
+ *             string_buffer - [IN] the string buffer holding string values   *
+ *             lastid        - [OUT] the id of last added record              *
+ *                                                                            *
+ * Return value: The total number of records added.                           *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_add_hist_data(struct zbx_json *j, zbx_history_binary_t *bin, int records_num,
+		const DC_ITEM *dc_items, const int *errcodes, const zbx_vector_ptr_t *records, const char *string_buffer,
+		zbx_uint64_t *lastid)
+{
+	int				i;
+	const zbx_history_data_t	*hd;
+
+	for (i = records->values_num - 1; i >= 0; i--)
+	{
+		hd = (const zbx_history_data_t *)records->values[i];
+		*lastid = hd->id;
+
+		if (SUCCEED != errcodes[i])
+			continue;
+
+		if (ITEM_STATUS_ACTIVE != dc_items[i].status)
+			continue;
+
+		if (HOST_STATUS_MONITORED != dc_items[i].host.status)
+			continue;
+
+		if (PROXY_HISTORY_FLAG_NOVALUE == (hd->flags & PROXY_HISTORY_MASK_NOVALUE))
+		{
+			if (SUCCEED != zbx_is_counted_in_item_queue(dc_items[i].type, dc_items[i].key_orig))
+				continue;
+		}
+
+		if (NULL != bin)
+		{
+			history_binary_add_row(bin, hd, string_buffer);
+			records_num++;
+
+			/* stop gathering data to avoid exceeding the maximum packet size */
+			if (ZBX_DATA_JSON_RECORD_LIMIT < j->buffer_offset + history_binary_size(bin))
+				break;
+
+			continue;
+		}
+
+		if (0 == records_num)
+			zbx_json_addarray(j, ZBX_PROTO_TAG_HISTORY_DATA);
+
+		zbx_json_addobject(j, NULL);
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_ID, hd->id);
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_ITEMID, hd->itemid);
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_CLOCK, hd->clock);
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_NS, hd->ns);
+
+		if (PROXY_HISTORY_FLAG_NOVALUE != (hd->flags & PROXY_HISTORY_MASK_NOVALUE))
+		{
+			if (ITEM_STATE_NORMAL != hd->state)
+				zbx_json_adduint64(j, ZBX_PROTO_TAG_STATE, hd->state);
+
+			if (0 == (hd->flags & PROXY_HISTORY_FLAG_NOVALUE))
+			{
+				if (0 != hd->timestamp)
+					zbx_json_adduint64(j, ZBX_PROTO_TAG_LOGTIMESTAMP, hd->timestamp);
+
+				if ('\0' != string_buffer[hd->source_offset])
+				{
+					zbx_json_addstring(j, ZBX_PROTO_TAG_LOGSOURCE,
+							string_buffer + hd->source_offset, ZBX_JSON_TYPE_STRING);
+				}
+
+				if (0 != hd->severity)
+					zbx_json_adduint64(j, ZBX_PROTO_TAG_LOGSEVERITY, hd->severity);
+
+				if (0 != hd->logeventid)
+					zbx_json_adduint64(j, ZBX_PROTO_TAG_LOGEVENTID, hd->logeventid);
+
+				zbx_json_addstring(j, ZBX_PROTO_TAG_VALUE, string_buffer + hd->value_offset,
+						ZBX_JSON_TYPE_STRING);
+			}
+
+			if (0 != (hd->flags & PROXY_HISTORY_FLAG_META))
 			{
 				zbx_json_adduint64(j, ZBX_PROTO_TAG_LASTLOGSIZE, hd->lastlogsize);
 				zbx_json_adduint64(j, ZBX_PROTO_TAG_MTIME, hd->mtime);
@@ -2683,27 +3210,152 @@ static int	proxy_add_hist_data(struct zbx_json *j, int records_num, const DC_ITE
 	return records_num;
 }
 
-int	proxy_get_hist_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_get_sent_lastid                                            *
+ *                                                                            *
+ * Purpose: continues reading after the records sent to server but not        *
+ *          acknowledged yet                                                  *
+ *                                                                            *
+ * Parameters: table  - [IN] the table, ZBX_PMB_* define                      *
+ *             source - [IN] the data source, ZBX_PMB_READ_* define           *
+ *             id     - [IN/OUT] the id of the last acknowledged record       *
+ *                                                                            *
+ * Return value: SUCCEED - there are records in flight, id was moved to the   *
+ *                         last sent record                                   *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_get_sent_lastid(unsigned char table, int source, zbx_uint64_t *id)
+{
+	proxy_read_source[table] = source;
+
+	if (source != proxy_sent[table].source || proxy_sent[table].lastid <= *id)
+		return FAIL;
+
+	*id = proxy_sent[table].lastid;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_set_sent_lastids                                           *
+ *                                                                            *
+ * Purpose: remembers the last records sent to server, so the next batch can  *
+ *          be read before the previous is acknowledged                       *
+ *                                                                            *
+ * Parameters: history_lastid   - [IN] the last sent history record id        *
+ *             discovery_lastid - [IN] the last sent discovery record id      *
+ *             areg_lastid      - [IN] the last sent autoregistration record  *
+ *                                     id                                     *
+ *                                                                            *
+ * Comments: Zero id means that no records of the table were sent.            *
+ *                                                                            *
+ ******************************************************************************/
+void	proxy_set_sent_lastids(zbx_uint64_t history_lastid, zbx_uint64_t discovery_lastid, zbx_uint64_t areg_lastid)
+{
+	zbx_uint64_t	lastids[ZBX_PMB_TABLE_COUNT];
+	int		i;
+
+	lastids[ZBX_PMB_HISTORY] = history_lastid;
+	lastids[ZBX_PMB_DISCOVERY] = discovery_lastid;
+	lastids[ZBX_PMB_AUTOREG] = areg_lastid;
+
+	for (i = 0; i < ZBX_PMB_TABLE_COUNT; i++)
+	{
+		if (0 == lastids[i])
+			continue;
+
+		proxy_sent[i].lastid = lastids[i];
+		proxy_sent[i].source = proxy_read_source[i];
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_reset_sent_lastids                                         *
+ *                                                                            *
+ * Purpose: resets the records in flight, so reading continues after the last *
+ *          acknowledged records                                              *
+ *                                                                            *
+ ******************************************************************************/
+void	proxy_reset_sent_lastids(void)
+{
+	memset(proxy_sent, 0, sizeof(proxy_sent));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_get_hist_data                                              *
+ *                                                                            *
+ * Purpose: get history data to be sent to server                             *
+ *                                                                            *
+ * Parameters: j           - [IN/OUT] the proxy data json                     *
+ *             history     - [OUT] the binary history data block, NULL to add *
+ *                                 history data to json                       *
+ *             history_len - [OUT] the binary history data block size         *
+ *             lastid      - [OUT] the id of last added record                *
+ *             more        - [OUT] set to ZBX_PROXY_DATA_MORE if there might  *
+ *                                 be more data to read                       *
+ *                                                                            *
+ * Return value: The number of records added.                                 *
+ *                                                                            *
+ * Comments: When binary history data block is requested and there are        *
+ *           records to send, the block is allocated and history format tag   *
+ *           is added to json. The block must be sent right after the json    *
+ *           terminating zero byte, see zbx_proxy_data_join().                *
+ *                                                                            *
+ ******************************************************************************/
+int	proxy_get_hist_data(struct zbx_json *j, char **history, size_t *history_len, zbx_uint64_t *lastid, int *more)
 {
-	int			records_num = 0, data_num, i, *errcodes = NULL, items_alloc = 0;
+	int			records_num = 0, data_num, i, *errcodes = NULL, items_alloc = 0, source, reads = 0,
+				in_flight;
 	zbx_uint64_t		id;
+	zbx_history_read_func_t	read_func = NULL;
 	zbx_hashset_t		itemids_added;
 	zbx_history_data_t	*data;
+	zbx_history_binary_t	bin, *pbin = NULL;
 	char			*string_buffer;
-	size_t			data_alloc = 16, string_buffer_alloc = ZBX_KIBIBYTE;
+	size_t			data_alloc = 16, string_buffer_alloc = ZBX_KIBIBYTE, bin_size = 0;
 	zbx_vector_uint64_t	itemids;
 	zbx_vector_ptr_t	records;
 	DC_ITEM			*dc_items = 0;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
+	if (ZBX_PMB_READ_NONE == (source = zbx_pmb_read_begin(ZBX_PMB_HISTORY, &id)))
+	{
+		*more = ZBX_PROXY_DATA_DONE;
+		goto out;
+	}
+
+	if (NULL != history)
+	{
+		memset(&bin, 0, sizeof(bin));
+		pbin = &bin;
+	}
+
 	zbx_vector_uint64_create(&itemids);
 	zbx_vector_ptr_create(&records);
 	data = (zbx_history_data_t *)zbx_malloc(NULL, data_alloc * sizeof(zbx_history_data_t));
 	string_buffer = (char *)zbx_malloc(NULL, string_buffer_alloc);
 
 	*more = ZBX_PROXY_DATA_MORE;
-	proxy_get_lastid("proxy_history", "history_lastid", &id);
+
+	if (ZBX_PMB_READ_MEMORY == source)
+	{
+		read_func = zbx_pmb_history_read;
+	}
+	else if (SUCCEED == zbx_pb_history_enabled())
+	{
+		read_func = zbx_pb_history_read;
+		id = zbx_pb_history_get_lastid();
+	}
+	else
+		proxy_get_lastid("proxy_history", "history_lastid", &id);
+
+	in_flight = proxy_get_sent_lastid(ZBX_PMB_HISTORY, source, &id);
 
 	zbx_hashset_create(&itemids_added, data_alloc, ZBX_DEFAULT_UINT64_HASH_FUNC, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
 
@@ -2711,10 +3363,12 @@ int	proxy_get_hist_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
 	/*   1) there are no more data to read                                  */
 	/*   2) we have retrieved more than the total maximum number of records */
 	/*   3) we have gathered more than half of the maximum packet size      */
-	while (ZBX_DATA_JSON_BATCH_LIMIT > j->buffer_offset && ZBX_MAX_HRECORDS_TOTAL > records_num &&
-			0 != (data_num = proxy_get_history_data(id, &data, &data_alloc, &string_buffer,
+	while (ZBX_DATA_JSON_BATCH_LIMIT > j->buffer_offset + bin_size && ZBX_MAX_HRECORDS_TOTAL > records_num &&
+			0 != (data_num = proxy_get_history_data(read_func, id, &data, &data_alloc, &string_buffer,
 					&string_buffer_alloc, more)))
 	{
+		reads++;
+
 		zbx_vector_uint64_reserve(&itemids, data_num);
 		zbx_vector_ptr_reserve(&records, data_num);
 
@@ -2744,9 +3398,13 @@ int	proxy_get_hist_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
 
 		DCconfig_get_items_by_itemids(dc_items, itemids.values, errcodes, itemids.values_num);
 
-		records_num = proxy_add_hist_data(j, records_num, dc_items, errcodes, &records, string_buffer, lastid);
+		records_num = proxy_add_hist_data(j, pbin, records_num, dc_items, errcodes, &records, string_buffer,
+				lastid);
 		DCconfig_clean_items(dc_items, errcodes, itemids.values_num);
 
+		if (NULL != pbin)
+			bin_size = history_binary_size(pbin);
+
 		/* got less data than requested - either no more data to read or the history is full of */
 		/* holes. In this case send retrieved data before attempting to read/wait for more data */
 		if (ZBX_MAX_HRECORDS > data_num)
@@ -2759,7 +3417,23 @@ int	proxy_get_hist_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
 	}
 
 	if (0 != records_num)
-		zbx_json_close(j);
+	{
+		if (NULL != pbin)
+		{
+			history_binary_finish(pbin, history, history_len);
+			zbx_json_addstring(j, ZBX_PROTO_TAG_HISTORY_FORMAT, ZBX_PROTO_VALUE_HISTORY_FORMAT_BINARY,
+					ZBX_JSON_TYPE_STRING);
+		}
+		else
+			zbx_json_close(j);
+	}
+
+	if (NULL != pbin)
+		history_binary_clear(pbin);
+
+	/* no unsent records were found in database and all sent records were acknowledged */
+	if (ZBX_PMB_READ_DATABASE == source && 0 == reads && ZBX_PROXY_DATA_DONE == *more && SUCCEED != in_flight)
+		zbx_pmb_database_drained(ZBX_PMB_HISTORY);
 
 	zbx_hashset_destroy(&itemids_added);
 
@@ -2769,44 +3443,46 @@ int	proxy_get_hist_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
 	zbx_free(string_buffer);
 	zbx_vector_ptr_destroy(&records);
 	zbx_vector_uint64_destroy(&itemids);
-
+out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() lastid:" ZBX_FS_UI64 " records_num:%d size:~" ZBX_FS_SIZE_T " more:%d",
 			__func__, *lastid, records_num, j->buffer_offset, *more);
 
 	return records_num;
 }
 
-int	proxy_get_dhis_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_get_history_simple                                         *
+ *                                                                            *
+ * Purpose: get discovery or autoregistration data to be sent to server       *
+ *                                                                            *
+ * Parameters: j         - [IN/OUT] the proxy data json                       *
+ *             proto_tag - [IN] the record array tag                          *
+ *             ht        - [IN] the history table                             *
+ *             table     - [IN] the proxy memory buffer table                 *
+ *             lastid    - [OUT] the id of last added record                  *
+ *             more      - [OUT] set to ZBX_PROXY_DATA_MORE if there might be *
+ *                               more data to read                            *
+ *                                                                            *
+ * Return value: The number of records added.                                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_get_history_simple(struct zbx_json *j, const char *proto_tag, const zbx_history_table_t *ht,
+		unsigned char table, zbx_uint64_t *lastid, int *more)
 {
-	int		records_num = 0;
+	int		records_num = 0, source, in_flight;
 	zbx_uint64_t	id;
 
-	proxy_get_lastid(dht.table, dht.lastidfield, &id);
-
-	/* get history data in batches by ZBX_MAX_HRECORDS records and stop if: */
-	/*   1) there are no more data to read                                  */
-	/*   2) we have retrieved more than the total maximum number of records */
-	/*   3) we have gathered more than half of the maximum packet size      */
-	while (ZBX_DATA_JSON_BATCH_LIMIT > j->buffer_offset)
+	if (ZBX_PMB_READ_NONE == (source = zbx_pmb_read_begin(table, &id)))
 	{
-		proxy_get_history_data_simple(j, ZBX_PROTO_TAG_DISCOVERY_DATA, &dht, lastid, &id, &records_num, more);
-
-		if (ZBX_PROXY_DATA_DONE == *more || ZBX_MAX_HRECORDS_TOTAL <= records_num)
-			break;
+		*more = ZBX_PROXY_DATA_DONE;
+		return 0;
 	}
 
-	if (0 != records_num)
-		zbx_json_close(j);
-
-	return records_num;
-}
-
-int	proxy_get_areg_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
-{
-	int		records_num = 0;
-	zbx_uint64_t	id;
+	if (ZBX_PMB_READ_DATABASE == source)
+		proxy_get_lastid(ht->table, ht->lastidfield, &id);
 
-	proxy_get_lastid(areg.table, areg.lastidfield, &id);
+	in_flight = proxy_get_sent_lastid(table, source, &id);
 
 	/* get history data in batches by ZBX_MAX_HRECORDS records and stop if: */
 	/*   1) there are no more data to read                                  */
@@ -2814,8 +3490,10 @@ int	proxy_get_areg_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
 	/*   3) we have gathered more than half of the maximum packet size      */
 	while (ZBX_DATA_JSON_BATCH_LIMIT > j->buffer_offset)
 	{
-		proxy_get_history_data_simple(j, ZBX_PROTO_TAG_AUTOREGISTRATION, &areg, lastid, &id, &records_num,
-				more);
+		if (ZBX_PMB_READ_MEMORY == source)
+			proxy_get_history_buffer_data_simple(j, proto_tag, ht, table, lastid, &id, &records_num, more);
+		else
+			proxy_get_history_data_simple(j, proto_tag, ht, lastid, &id, &records_num, more);
 
 		if (ZBX_PROXY_DATA_DONE == *more || ZBX_MAX_HRECORDS_TOTAL <= records_num)
 			break;
@@ -2823,10 +3501,25 @@ int	proxy_get_areg_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
 
 	if (0 != records_num)
 		zbx_json_close(j);
+	else if (ZBX_PMB_READ_DATABASE == source && ZBX_DATA_JSON_BATCH_LIMIT > j->buffer_offset &&
+			SUCCEED != in_flight)
+	{
+		zbx_pmb_database_drained(table);
+	}
 
 	return records_num;
 }
 
+int	proxy_get_dhis_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
+{
+	return proxy_get_history_simple(j, ZBX_PROTO_TAG_DISCOVERY_DATA, &dht, ZBX_PMB_DISCOVERY, lastid, more);
+}
+
+int	proxy_get_areg_data(struct zbx_json *j, zbx_uint64_t *lastid, int *more)
+{
+	return proxy_get_history_simple(j, ZBX_PROTO_TAG_AUTOREGISTRATION, &areg, ZBX_PMB_AUTOREG, lastid, more);
+}
+
 void	calc_timestamp(const char *line, int *timestamp, const char *format)
 {
 	int		hh, mm, ss, yyyy, dd, MM;
@@ -3463,28 +4156,368 @@ static int	parse_history_data_by_itemids(struct zbx_json_parse *jp_data, const c
 	/* iterate the history data rows */
 	do
 	{
-		if (FAIL == zbx_json_brackets_open(*pnext, &jp_row))
+		if (FAIL == zbx_json_brackets_open(*pnext, &jp_row))
+		{
+			*error = zbx_strdup(*error, zbx_json_strerror());
+			goto out;
+		}
+
+		(*parsed_num)++;
+
+		if (SUCCEED != parse_history_data_row_itemid(&jp_row, &itemids[*values_num]))
+			continue;
+
+		if (SUCCEED != parse_history_data_row_value(&jp_row, unique_shift, &values[*values_num]))
+			continue;
+
+		(*values_num)++;
+	}
+	while (NULL != (*pnext = zbx_json_next(jp_data, *pnext)) && *values_num < ZBX_HISTORY_VALUES_MAX);
+
+	ret = SUCCEED;
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s processed:%d/%d", __func__, zbx_result_string(ret),
+			*values_num, *parsed_num);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_read_uint64                                       *
+ *                                                                            *
+ * Purpose: reads variable length unsigned integer from binary history data   *
+ *                                                                            *
+ * Parameters: data  - [IN/OUT] the data to read, advanced past the value     *
+ *             end   - [IN] the end of data                                   *
+ *             value - [OUT] the value                                        *
+ *                                                                            *
+ * Return value: SUCCEED - the value was read successfully                    *
+ *               FAIL    - the value is truncated or too long                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	history_binary_read_uint64(const unsigned char **data, const unsigned char *end, zbx_uint64_t *value)
+{
+	const unsigned char	*ptr = *data;
+	int			shift;
+
+	*value = 0;
+
+	for (shift = 0; shift < 64 && ptr < end; shift += 7)
+	{
+		*value |= (zbx_uint64_t)(*ptr & 0x7f) << shift;
+
+		if (0 == (*ptr++ & 0x80))
+		{
+			*data = ptr;
+			return SUCCEED;
+		}
+	}
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_read_int64                                        *
+ *                                                                            *
+ * Purpose: reads zigzag encoded signed integer from binary history data      *
+ *                                                                            *
+ * Parameters: data  - [IN/OUT] the data to read, advanced past the value     *
+ *             end   - [IN] the end of data                                   *
+ *             value - [OUT] the value                                        *
+ *                                                                            *
+ * Return value: SUCCEED - the value was read successfully                    *
+ *               FAIL    - the value is truncated or too long                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	history_binary_read_int64(const unsigned char **data, const unsigned char *end, zbx_int64_t *value)
+{
+	zbx_uint64_t	u;
+
+	if (SUCCEED != history_binary_read_uint64(data, end, &u))
+		return FAIL;
+
+	*value = (0 != (u & 1) ? (zbx_int64_t)~(u >> 1) : (zbx_int64_t)(u >> 1));
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_read_int                                          *
+ *                                                                            *
+ * Purpose: reads zigzag encoded integer from binary history data             *
+ *                                                                            *
+ * Parameters: data  - [IN/OUT] the data to read, advanced past the value     *
+ *             end   - [IN] the end of data                                   *
+ *             value - [OUT] the value                                        *
+ *                                                                            *
+ * Return value: SUCCEED - the value was read successfully                    *
+ *               FAIL    - the value is truncated or out of integer range     *
+ *                                                                            *
+ ******************************************************************************/
+static int	history_binary_read_int(const unsigned char **data, const unsigned char *end, int *value)
+{
+	zbx_int64_t	v;
+
+	if (SUCCEED != history_binary_read_int64(data, end, &v))
+		return FAIL;
+
+	if (v != (*value = (int)v))
+		return FAIL;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_read_str                                          *
+ *                                                                            *
+ * Purpose: reads length prefixed string from binary history data             *
+ *                                                                            *
+ * Parameters: data - [IN/OUT] the data to read, advanced past the string     *
+ *             end  - [IN] the end of data                                    *
+ *             str  - [OUT] the string (must be freed by the caller)          *
+ *                                                                            *
+ * Return value: SUCCEED - the string was read successfully                   *
+ *               FAIL    - the string is truncated                            *
+ *                                                                            *
+ ******************************************************************************/
+static int	history_binary_read_str(const unsigned char **data, const unsigned char *end, char **str)
+{
+	zbx_uint64_t	len;
+
+	if (SUCCEED != history_binary_read_uint64(data, end, &len) || (zbx_uint64_t)(end - *data) < len)
+		return FAIL;
+
+	*str = (char *)zbx_malloc(*str, (size_t)len + 1);
+	memcpy(*str, *data, (size_t)len);
+	(*str)[len] = '\0';
+	*data += len;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_reader_init                                       *
+ *                                                                            *
+ * Purpose: parses binary history data block header and locates its columns   *
+ *                                                                            *
+ * Parameters: reader - [OUT] the binary history data reader                  *
+ *             data   - [IN] the binary history data block                    *
+ *             size   - [IN] the binary history data block size               *
+ *             error  - [OUT] the error message                               *
+ *                                                                            *
+ * Return value: SUCCEED - the block header was parsed successfully           *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: See history_binary_finish() for the block layout description.    *
+ *                                                                            *
+ ******************************************************************************/
+static int	history_binary_reader_init(zbx_history_binary_reader_t *reader, const char *data, size_t size,
+		char **error)
+{
+	const unsigned char	*ptr = (const unsigned char *)data, *end = ptr + size;
+	zbx_uint64_t		value;
+	int			i;
+
+	memset(reader, 0, sizeof(zbx_history_binary_reader_t));
+
+	if (0 == size || ZBX_HISTORY_BINARY_VERSION != *ptr++)
+	{
+		*error = zbx_strdup(*error, "unsupported binary history data version");
+		return FAIL;
+	}
+
+	if (SUCCEED != history_binary_read_uint64(&ptr, end, &value) || INT_MAX < value)
+	{
+		*error = zbx_strdup(*error, "invalid binary history data row count");
+		return FAIL;
+	}
+
+	reader->rows_num = (int)value;
+
+	for (i = 0; i < ZBX_HISTORY_BINARY_COLUMNS_NUM; i++)
+	{
+		if (SUCCEED != history_binary_read_uint64(&ptr, end, &value) || (zbx_uint64_t)(end - ptr) < value)
+		{
+			*error = zbx_dsprintf(*error, "invalid binary history data column #%d size", i + 1);
+			return FAIL;
+		}
+
+		reader->columns[i] = ptr;
+		reader->ends[i] = ptr + value;
+		ptr += value;
+	}
+
+	/* flags column holds exactly one byte per row */
+	if (reader->ends[ZBX_HISTORY_BINARY_COLUMN_FLAGS] - reader->columns[ZBX_HISTORY_BINARY_COLUMN_FLAGS] !=
+			reader->rows_num)
+	{
+		*error = zbx_strdup(*error, "binary history data row count does not match flags column size");
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_read_row                                          *
+ *                                                                            *
+ * Purpose: reads the next row from binary history data                       *
+ *                                                                            *
+ * Parameters: reader - [IN/OUT] the binary history data reader               *
+ *             av     - [OUT] the item value                                  *
+ *             itemid - [OUT] the item identifier                             *
+ *                                                                            *
+ * Return value: SUCCEED - the row was read successfully                      *
+ *               FAIL    - the data is corrupted                              *
+ *                                                                            *
+ * Comments: The item value fields are set in the same way as                 *
+ *           parse_history_data_row_value() sets them from json row.          *
+ *                                                                            *
+ ******************************************************************************/
+static int	history_binary_read_row(zbx_history_binary_reader_t *reader, zbx_agent_value_t *av,
+		zbx_uint64_t *itemid)
+{
+	const unsigned char	**columns = reader->columns, * const *ends = reader->ends;
+	zbx_int64_t		delta;
+	zbx_uint64_t		ns;
+	unsigned char		flags;
+
+	memset(av, 0, sizeof(zbx_agent_value_t));
+
+	if (SUCCEED != history_binary_read_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_ID],
+			ends[ZBX_HISTORY_BINARY_COLUMN_ID], &delta))
+	{
+		return FAIL;
+	}
+
+	av->id = reader->id += (zbx_uint64_t)delta;
+
+	if (SUCCEED != history_binary_read_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_ITEMID],
+			ends[ZBX_HISTORY_BINARY_COLUMN_ITEMID], &delta))
+	{
+		return FAIL;
+	}
+
+	*itemid = reader->itemid += (zbx_uint64_t)delta;
+
+	if (SUCCEED != history_binary_read_int64(&columns[ZBX_HISTORY_BINARY_COLUMN_CLOCK],
+			ends[ZBX_HISTORY_BINARY_COLUMN_CLOCK], &delta) ||
+			0 > (delta += reader->clock) || INT_MAX < delta)
+	{
+		return FAIL;
+	}
+
+	av->ts.sec = reader->clock = (int)delta;
+
+	if (SUCCEED != history_binary_read_uint64(&columns[ZBX_HISTORY_BINARY_COLUMN_NS],
+			ends[ZBX_HISTORY_BINARY_COLUMN_NS], &ns) || 999999999 < ns)
+	{
+		return FAIL;
+	}
+
+	av->ts.ns = (int)ns;
+
+	flags = *columns[ZBX_HISTORY_BINARY_COLUMN_FLAGS]++;
+
+	if (0 != (flags & ZBX_HISTORY_BINARY_FLAG_NOTSUPPORTED))
+		av->state = ITEM_STATE_NOTSUPPORTED;
+
+	if (0 != (flags & ZBX_HISTORY_BINARY_FLAG_VALUE) && SUCCEED != history_binary_read_str(
+			&columns[ZBX_HISTORY_BINARY_COLUMN_VALUE], ends[ZBX_HISTORY_BINARY_COLUMN_VALUE], &av->value))
+	{
+		return FAIL;
+	}
+
+	if (0 != (flags & ZBX_HISTORY_BINARY_FLAG_LOG))
+	{
+		const unsigned char	**log = &columns[ZBX_HISTORY_BINARY_COLUMN_LOG],
+					*end = ends[ZBX_HISTORY_BINARY_COLUMN_LOG];
+
+		if (SUCCEED != history_binary_read_int(log, end, &av->timestamp) ||
+				SUCCEED != history_binary_read_str(log, end, &av->source) ||
+				SUCCEED != history_binary_read_int(log, end, &av->severity) ||
+				SUCCEED != history_binary_read_int(log, end, &av->logeventid))
+		{
+			return FAIL;
+		}
+
+		/* empty log source is not sent in json, keep it unset in the same way */
+		if ('\0' == *av->source)
+			zbx_free(av->source);
+	}
+
+	if (0 != (flags & ZBX_HISTORY_BINARY_FLAG_META))
+	{
+		const unsigned char	**meta = &columns[ZBX_HISTORY_BINARY_COLUMN_META],
+					*end = ends[ZBX_HISTORY_BINARY_COLUMN_META];
+
+		if (SUCCEED != history_binary_read_uint64(meta, end, &av->lastlogsize) ||
+				SUCCEED != history_binary_read_int(meta, end, &av->mtime))
+		{
+			return FAIL;
+		}
+
+		/* unsupported item meta information must be ignored, see parse_history_data_row_value() */
+		if (ITEM_STATE_NOTSUPPORTED != av->state)
+		{
+			av->meta = 1;
+		}
+		else
+		{
+			av->lastlogsize = 0;
+			av->mtime = 0;
+		}
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: parse_history_data_binary                                        *
+ *                                                                            *
+ * Purpose: parses up to ZBX_HISTORY_VALUES_MAX item values and item          *
+ *          identifiers from binary history data                              *
+ *                                                                            *
+ * Parameters: reader     - [IN/OUT] the binary history data reader           *
+ *             values     - [OUT] the item values                             *
+ *             itemids    - [OUT] the corresponding item identifiers          *
+ *             values_num - [OUT] number of elements in values and itemids    *
+ *                                arrays                                      *
+ *             error      - [OUT] the error message                           *
+ *                                                                            *
+ * Return value:  SUCCEED - values were parsed successfully                   *
+ *                FAIL    - an error occurred                                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	parse_history_data_binary(zbx_history_binary_reader_t *reader, zbx_agent_value_t *values,
+		zbx_uint64_t *itemids, int *values_num, char **error)
+{
+	int	ret = FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	for (*values_num = 0; *values_num < ZBX_HISTORY_VALUES_MAX && reader->rows_read < reader->rows_num;
+			(*values_num)++, reader->rows_read++)
+	{
+		if (SUCCEED != history_binary_read_row(reader, &values[*values_num], &itemids[*values_num]))
 		{
-			*error = zbx_strdup(*error, zbx_json_strerror());
+			*error = zbx_dsprintf(*error, "invalid binary history data row #%d", reader->rows_read + 1);
+			zbx_agent_values_clean(values, (size_t)*values_num + 1);
+			*values_num = 0;
 			goto out;
 		}
-
-		(*parsed_num)++;
-
-		if (SUCCEED != parse_history_data_row_itemid(&jp_row, &itemids[*values_num]))
-			continue;
-
-		if (SUCCEED != parse_history_data_row_value(&jp_row, unique_shift, &values[*values_num]))
-			continue;
-
-		(*values_num)++;
 	}
-	while (NULL != (*pnext = zbx_json_next(jp_data, *pnext)) && *values_num < ZBX_HISTORY_VALUES_MAX);
 
 	ret = SUCCEED;
 out:
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s processed:%d/%d", __func__, zbx_result_string(ret),
-			*values_num, *parsed_num);
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s processed:%d", __func__, zbx_result_string(ret), *values_num);
 
 	return ret;
 }
@@ -3522,6 +4555,75 @@ static int	proxy_item_validator(DC_ITEM *item, zbx_socket_t *sock, void *args, c
 	return SUCCEED;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: process_history_data_values                                      *
+ *                                                                            *
+ * Purpose: validates and processes parsed item values                        *
+ *                                                                            *
+ * Parameters: sock           - [IN] the connection socket                    *
+ *             validator_func - [IN] the item validator callback function     *
+ *             validator_args - [IN] the user arguments passed to validator   *
+ *                                   function                                 *
+ *             items          - [IN] the item configuration buffer            *
+ *             errcodes       - [IN] the item configuration status buffer     *
+ *             itemids        - [IN] the item identifiers                     *
+ *             values         - [IN] the item values, freed afterwards        *
+ *             values_num     - [IN] the number of item values                *
+ *             session        - [IN] the data session                         *
+ *             nodata_win     - [OUT] counter of delayed values               *
+ *             mode           - [IN]  item retrieve mode                      *
+ *                                                                            *
+ * Return value: The number of processed values.                              *
+ *                                                                            *
+ ******************************************************************************/
+static int	process_history_data_values(zbx_socket_t *sock, zbx_client_item_validator_t validator_func,
+		void *validator_args, DC_ITEM *items, int *errcodes, const zbx_uint64_t *itemids,
+		zbx_agent_value_t *values, int values_num, zbx_data_session_t *session,
+		zbx_proxy_suppress_t *nodata_win, unsigned int mode)
+{
+	int	i, processed_num;
+	char	*error = NULL;
+
+	DCconfig_get_items_by_itemids_partial(items, itemids, errcodes, (size_t)values_num, mode);
+
+	for (i = 0; i < values_num; i++)
+	{
+		if (SUCCEED != errcodes[i])
+			continue;
+
+		/* check and discard if duplicate data */
+		if (NULL != session && 0 != values[i].id && values[i].id <= session->last_valueid)
+		{
+			DCconfig_clean_items(&items[i], &errcodes[i], 1);
+			errcodes[i] = FAIL;
+			continue;
+		}
+
+		if (SUCCEED != validator_func(&items[i], sock, validator_args, &error))
+		{
+			if (NULL != error)
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "%s", error);
+				zbx_free(error);
+			}
+
+			DCconfig_clean_items(&items[i], &errcodes[i], 1);
+			errcodes[i] = FAIL;
+		}
+	}
+
+	processed_num = process_history_data(items, values, errcodes, values_num, nodata_win);
+
+	if (NULL != session)
+		session->last_valueid = values[values_num - 1].id;
+
+	DCconfig_clean_items(items, errcodes, values_num);
+	zbx_agent_values_clean(values, values_num);
+
+	return processed_num;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: process_history_data_by_itemids                                  *
@@ -3550,7 +4652,7 @@ static int	process_history_data_by_itemids(zbx_socket_t *sock, zbx_client_item_v
 		zbx_proxy_suppress_t *nodata_win, char **info, unsigned int mode)
 {
 	const char		*pnext = NULL;
-	int			ret = SUCCEED, processed_num = 0, total_num = 0, values_num, read_num, i, *errcodes;
+	int			ret = SUCCEED, processed_num = 0, total_num = 0, values_num, read_num, *errcodes;
 	double			sec;
 	DC_ITEM			*items;
 	char			*error = NULL;
@@ -3568,56 +4670,98 @@ static int	process_history_data_by_itemids(zbx_socket_t *sock, zbx_client_item_v
 	while (SUCCEED == parse_history_data_by_itemids(jp_data, &pnext, values, itemids, &values_num, &read_num,
 			&unique_shift, &error) && 0 != values_num)
 	{
-		DCconfig_get_items_by_itemids_partial(items, itemids, errcodes, (size_t)values_num, mode);
+		processed_num += process_history_data_values(sock, validator_func, validator_args, items, errcodes,
+				itemids, values, values_num, session, nodata_win, mode);
 
-		for (i = 0; i < values_num; i++)
-		{
-			if (SUCCEED != errcodes[i])
-				continue;
+		total_num += read_num;
 
-			/* check and discard if duplicate data */
-			if (NULL != session && 0 != values[i].id && values[i].id <= session->last_valueid)
-			{
-				DCconfig_clean_items(&items[i], &errcodes[i], 1);
-				errcodes[i] = FAIL;
-				continue;
-			}
+		if (NULL == pnext)
+			break;
+	}
 
-			if (SUCCEED != validator_func(&items[i], sock, validator_args, &error))
-			{
-				if (NULL != error)
-				{
-					zabbix_log(LOG_LEVEL_WARNING, "%s", error);
-					zbx_free(error);
-				}
+	zbx_free(errcodes);
+	zbx_free(items);
 
-				DCconfig_clean_items(&items[i], &errcodes[i], 1);
-				errcodes[i] = FAIL;
-			}
-		}
+	if (NULL == error)
+	{
+		ret = SUCCEED;
+		*info = zbx_dsprintf(*info, "processed: %d; failed: %d; total: %d; seconds spent: " ZBX_FS_DBL,
+				processed_num, total_num - processed_num, total_num, zbx_time() - sec);
+	}
+	else
+	{
+		zbx_free(*info);
+		*info = error;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
 
-		processed_num += process_history_data(items, values, errcodes, values_num, nodata_win);
+	return ret;
+}
 
-		total_num += read_num;
+/******************************************************************************
+ *                                                                            *
+ * Function: process_history_data_binary                                      *
+ *                                                                            *
+ * Purpose: parses binary history data and process the data                   *
+ *                                                                            *
+ * Parameters: validator_func - [IN] the item validator callback function     *
+ *             validator_args - [IN] the user arguments passed to validator   *
+ *                                   function                                 *
+ *             data           - [IN] the binary history data block            *
+ *             size           - [IN] the binary history data block size       *
+ *             session        - [IN] the data session                         *
+ *             nodata_win     - [OUT] counter of delayed values               *
+ *             info           - [OUT] address of a pointer to the info        *
+ *                                    string (should be freed by the caller)  *
+ *             mode           - [IN]  item retrieve mode is used to retrieve  *
+ *                                    only necessary data to reduce time      *
+ *                                    spent holding read lock                 *
+ *                                                                            *
+ * Return value:  SUCCEED - processed successfully                            *
+ *                FAIL - an error occurred                                    *
+ *                                                                            *
+ * Comments: This is binary alternative of process_history_data_by_itemids()  *
+ *           used by proxies when server advertises binary history format.    *
+ *                                                                            *
+ ******************************************************************************/
+static int	process_history_data_binary(zbx_client_item_validator_t validator_func, void *validator_args,
+		const char *data, size_t size, zbx_data_session_t *session, zbx_proxy_suppress_t *nodata_win,
+		char **info, unsigned int mode)
+{
+	int				ret = FAIL, processed_num = 0, values_num, *errcodes;
+	double				sec;
+	DC_ITEM				*items;
+	char				*error = NULL;
+	zbx_uint64_t			itemids[ZBX_HISTORY_VALUES_MAX];
+	zbx_agent_value_t		values[ZBX_HISTORY_VALUES_MAX];
+	zbx_history_binary_reader_t	reader;
 
-		if (NULL != session)
-			session->last_valueid = values[values_num - 1].id;
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() size:" ZBX_FS_SIZE_T, __func__, (zbx_fs_size_t)size);
 
-		DCconfig_clean_items(items, errcodes, values_num);
-		zbx_agent_values_clean(values, values_num);
+	sec = zbx_time();
 
-		if (NULL == pnext)
-			break;
+	if (SUCCEED != history_binary_reader_init(&reader, data, size, &error))
+		goto out;
+
+	items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * ZBX_HISTORY_VALUES_MAX);
+	errcodes = (int *)zbx_malloc(NULL, sizeof(int) * ZBX_HISTORY_VALUES_MAX);
+
+	while (SUCCEED == parse_history_data_binary(&reader, values, itemids, &values_num, &error) &&
+			0 != values_num)
+	{
+		processed_num += process_history_data_values(NULL, validator_func, validator_args, items, errcodes,
+				itemids, values, values_num, session, nodata_win, mode);
 	}
 
 	zbx_free(errcodes);
 	zbx_free(items);
-
+out:
 	if (NULL == error)
 	{
 		ret = SUCCEED;
 		*info = zbx_dsprintf(*info, "processed: %d; failed: %d; total: %d; seconds spent: " ZBX_FS_DBL,
-				processed_num, total_num - processed_num, total_num, zbx_time() - sec);
+				processed_num, reader.rows_read - processed_num, reader.rows_read, zbx_time() - sec);
 	}
 	else
 	{
@@ -4514,7 +5658,13 @@ int	proxy_get_history_count(void)
 	DB_RESULT	result;
 	DB_ROW		row;
 	zbx_uint64_t	id;
-	int		count = 0;
+	int		count = 0, buffered;
+
+	if (SUCCEED == zbx_pmb_history_get_count(&buffered))
+		return buffered;
+
+	if (SUCCEED == zbx_pb_history_enabled())
+		return buffered + zbx_pb_history_get_count();
 
 	proxy_get_lastid("proxy_history", "history_lastid", &id);
 
@@ -4529,7 +5679,7 @@ int	proxy_get_history_count(void)
 
 	DBfree_result(result);
 
-	return count;
+	return buffered + count;
 }
 
 /******************************************************************************
@@ -4676,6 +5826,9 @@ static void	check_proxy_nodata_empty(zbx_timespec_t *ts, unsigned char proxy_sta
  *                                                                            *
  * Parameters: proxy        - [IN] the source proxy                           *
  *             jp           - [IN] JSON with proxy data                       *
+ *             data         - [IN] the received message, JSON with proxy data *
+ *                                 optionally followed by binary history data *
+ *             size         - [IN] the received message size                  *
  *             proxy_hostid - [IN] proxy identifier from database             *
  *             ts           - [IN] timestamp when the proxy connection was    *
  *                                 established                                *
@@ -4688,11 +5841,11 @@ static void	check_proxy_nodata_empty(zbx_timespec_t *ts, unsigned char proxy_sta
  *                FAIL - an error occurred                                    *
  *                                                                            *
  ******************************************************************************/
-int	process_proxy_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, zbx_timespec_t *ts,
-		unsigned char proxy_status, int *more, char **error)
+int	process_proxy_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, const char *data, size_t size,
+		zbx_timespec_t *ts, unsigned char proxy_status, int *more, char **error)
 {
 	struct zbx_json_parse	jp_data;
-	int			ret = SUCCEED, flags_old;
+	int			ret = SUCCEED, flags_old, history_binary;
 	char			*error_step = NULL, value[MAX_STRING_LEN];
 	size_t			error_alloc = 0, error_offset = 0;
 	zbx_proxy_diff_t	proxy_diff;
@@ -4746,7 +5899,10 @@ int	process_proxy_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, zbx_tim
 
 	flags_old = proxy_diff.nodata_win.flags;
 
-	if (SUCCEED == zbx_json_brackets_by_name(jp, ZBX_PROTO_TAG_HISTORY_DATA, &jp_data))
+	history_binary = (SUCCEED == zbx_json_value_by_name(jp, ZBX_PROTO_TAG_HISTORY_FORMAT, value, sizeof(value),
+			NULL) && 0 == strcmp(value, ZBX_PROTO_VALUE_HISTORY_FORMAT_BINARY));
+
+	if (0 != history_binary || SUCCEED == zbx_json_brackets_by_name(jp, ZBX_PROTO_TAG_HISTORY_DATA, &jp_data))
 	{
 		zbx_data_session_t	*session = NULL;
 
@@ -4764,12 +5920,29 @@ int	process_proxy_data(const DC_PROXY *proxy, struct zbx_json_parse *jp, zbx_tim
 			session = zbx_dc_get_or_create_data_session(proxy->hostid, value);
 		}
 
-		if (SUCCEED != (ret = process_history_data_by_itemids(NULL, proxy_item_validator,
-				(void *)&proxy->hostid, &jp_data, session, &proxy_diff.nodata_win, &error_step,
-				ZBX_ITEM_GET_PROCESS)))
+		if (0 != history_binary)
 		{
-			zbx_strcatnl_alloc(error, &error_alloc, &error_offset, error_step);
+			size_t	offset;
+
+			/* binary history data block follows the json terminating zero byte */
+			if (size <= (offset = strlen(data) + 1))
+			{
+				*error = zbx_strdup(*error, "missing binary history data");
+				ret = FAIL;
+				goto out;
+			}
+
+			ret = process_history_data_binary(proxy_item_validator, (void *)&proxy->hostid, data + offset,
+					size - offset, session, &proxy_diff.nodata_win, &error_step, ZBX_ITEM_GET_PROCESS);
+		}
+		else
+		{
+			ret = process_history_data_by_itemids(NULL, proxy_item_validator, (void *)&proxy->hostid,
+					&jp_data, session, &proxy_diff.nodata_win, &error_step, ZBX_ITEM_GET_PROCESS);
 		}
+
+		if (SUCCEED != ret)
+			zbx_strcatnl_alloc(error, &error_alloc, &error_offset, error_step);
 	}
 
 	if (0 != (proxy_diff.nodata_win.flags & ZBX_PROXY_SUPPRESS_ACTIVE))
@@ -4872,12 +6045,14 @@ static void	zbx_db_flush_proxy_lastaccess(void)
  *             lastaccess - [IN] the last proxy access time                   *
  *             compress   - [IN] 1 if proxy is using data compression,        *
  *                               0 otherwise                                  *
+ *             codecs     - [IN] compression codecs advertised by proxy       *
  *             flags_add  - [IN] additional flags for update proxy            *
  *                                                                            *
  * Comments: The proxy parameter properties are also updated.                 *
  *                                                                            *
  ******************************************************************************/
-void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int compress, zbx_uint64_t flags_add)
+void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int compress, int codecs,
+		zbx_uint64_t flags_add)
 {
 	zbx_proxy_diff_t	diff;
 
@@ -4886,6 +6061,7 @@ void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int com
 	diff.version = version;
 	diff.lastaccess = lastaccess;
 	diff.compress = compress;
+	diff.codecs = codecs;
 
 	zbx_dc_update_proxy(&diff);
 
@@ -4900,6 +6076,7 @@ void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int com
 
 	proxy->version = version;
 	proxy->auto_compress = compress;
+	proxy->accept_codecs = codecs;
 	proxy->lastaccess = lastaccess;
 
 	if (0 != (diff.flags & ZBX_FLAGS_PROXY_DIFF_UPDATE_COMPRESS))
@@ -4907,6 +6084,225 @@ void	zbx_update_proxy_data(DC_PROXY *proxy, int version, int lastaccess, int com
 
 	zbx_db_flush_proxy_lastaccess();
 }
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_compress_flags                                         *
+ *                                                                            *
+ * Purpose: get protocol flags for compressed data sent to proxy              *
+ *                                                                            *
+ * Parameters: proxy         - [IN] the proxy                                 *
+ *             peer_protocol - [IN] protocol flags of the last message        *
+ *                                  received from proxy, 0 if none            *
+ *                                                                            *
+ * Comments: Compression codecs are advertised only to proxies that have      *
+ *           advertised their codecs with compression tag, older proxies      *
+ *           reject unknown protocol flags.                                   *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_proxy_compress_flags(const DC_PROXY *proxy, int peer_protocol)
+{
+	return zbx_tcp_compress_flags(peer_protocol | proxy->accept_codecs);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_add_compression                                        *
+ *                                                                            *
+ * Purpose: advertises compression codecs supported in addition to zlib       *
+ *                                                                            *
+ * Parameters: j - [IN/OUT] the json message to be sent to server             *
+ *                                                                            *
+ * Comments: Server uses codecs other than zlib and advertises its own codecs *
+ *           in protocol flags only after receiving this tag, so the tag is   *
+ *           ignored by older servers.                                        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_proxy_add_compression(struct zbx_json *j)
+{
+	int	codecs = 0;
+
+	if (SUCCEED == zbx_compress_codec_supported(ZBX_COMPRESS_ZSTD))
+		codecs |= ZBX_TCP_ACCEPT_ZSTD;
+
+	if (SUCCEED == zbx_compress_codec_supported(ZBX_COMPRESS_LZ4))
+		codecs |= ZBX_TCP_ACCEPT_LZ4;
+
+	if (0 == codecs)
+		return;
+
+	zbx_json_addarray(j, ZBX_PROTO_TAG_COMPRESSION);
+
+	if (0 != (codecs & ZBX_TCP_ACCEPT_ZSTD))
+		zbx_json_addstring(j, NULL, ZBX_PROTO_VALUE_COMPRESSION_ZSTD, ZBX_JSON_TYPE_STRING);
+
+	if (0 != (codecs & ZBX_TCP_ACCEPT_LZ4))
+		zbx_json_addstring(j, NULL, ZBX_PROTO_VALUE_COMPRESSION_LZ4, ZBX_JSON_TYPE_STRING);
+
+	zbx_json_close(j);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_get_compression                                        *
+ *                                                                            *
+ * Purpose: gets compression codecs advertised by proxy                       *
+ *                                                                            *
+ * Parameters: jp - [IN] the message received from proxy                      *
+ *                                                                            *
+ * Return value: The protocol accept flags of advertised codecs, 0 if proxy   *
+ *               has not advertised codecs other than zlib.                   *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_proxy_get_compression(const struct zbx_json_parse *jp)
+{
+	struct zbx_json_parse	jp_codecs;
+	const char		*p = NULL;
+	char			codec[MAX_ID_LEN + 1];
+	int			codecs = 0;
+
+	if (SUCCEED != zbx_json_brackets_by_name(jp, ZBX_PROTO_TAG_COMPRESSION, &jp_codecs))
+		return 0;
+
+	while (NULL != (p = zbx_json_next_value(&jp_codecs, p, codec, sizeof(codec), NULL)))
+	{
+		if (0 == strcmp(codec, ZBX_PROTO_VALUE_COMPRESSION_ZSTD))
+			codecs |= ZBX_TCP_ACCEPT_ZSTD;
+		else if (0 == strcmp(codec, ZBX_PROTO_VALUE_COMPRESSION_LZ4))
+			codecs |= ZBX_TCP_ACCEPT_LZ4;
+	}
+
+	return codecs;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_add_history_format                                     *
+ *                                                                            *
+ * Purpose: advertises binary history data format to proxy                    *
+ *                                                                            *
+ * Parameters: proxy - [IN] the proxy                                         *
+ *             j     - [IN/OUT] the json message to be sent to proxy          *
+ *                                                                            *
+ * Comments: Binary history format is advertised only to proxies of the same  *
+ *           version as server, older proxies keep sending history as json.   *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_proxy_add_history_format(const DC_PROXY *proxy, struct zbx_json *j)
+{
+	if (ZBX_COMPONENT_VERSION(ZABBIX_VERSION_MAJOR, ZABBIX_VERSION_MINOR) <= proxy->version)
+	{
+		zbx_json_addstring(j, ZBX_PROTO_TAG_HISTORY_FORMAT, ZBX_PROTO_VALUE_HISTORY_FORMAT_BINARY,
+				ZBX_JSON_TYPE_STRING);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_history_binary_accepted                                *
+ *                                                                            *
+ * Purpose: checks if server has advertised binary history data format        *
+ *                                                                            *
+ * Parameters: buffer - [IN] the message received from server                 *
+ *                                                                            *
+ * Return value: SUCCEED - server accepts binary history data                 *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_proxy_history_binary_accepted(const char *buffer)
+{
+	struct zbx_json_parse	jp;
+	char			value[MAX_STRING_LEN];
+
+	if (SUCCEED != zbx_json_open(buffer, &jp))
+		return FAIL;
+
+	if (SUCCEED != zbx_json_value_by_name(&jp, ZBX_PROTO_TAG_HISTORY_FORMAT, value, sizeof(value), NULL))
+		return FAIL;
+
+	return 0 == strcmp(value, ZBX_PROTO_VALUE_HISTORY_FORMAT_BINARY) ? SUCCEED : FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_add_data_pipeline                                      *
+ *                                                                            *
+ * Purpose: advertises the number of proxy data batches the proxy can send    *
+ *          without waiting for acknowledgement                               *
+ *                                                                            *
+ * Parameters: proxy - [IN] the proxy                                         *
+ *             j     - [IN/OUT] the json message to be sent to proxy          *
+ *                                                                            *
+ * Comments: Pipelining is advertised only to proxies of the same version as  *
+ *           server, older proxies keep sending one batch per connection.     *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_proxy_add_data_pipeline(const DC_PROXY *proxy, struct zbx_json *j)
+{
+	if (ZBX_COMPONENT_VERSION(ZABBIX_VERSION_MAJOR, ZABBIX_VERSION_MINOR) <= proxy->version)
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_PIPELINE, ZBX_PROXY_DATA_BATCHES_MAX);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_data_pipeline_accepted                                 *
+ *                                                                            *
+ * Purpose: gets the number of proxy data batches server accepts without      *
+ *          acknowledgement                                                   *
+ *                                                                            *
+ * Parameters: buffer - [IN] the message received from server                 *
+ *                                                                            *
+ * Return value: The number of batches or 0 if server does not accept         *
+ *               pipelined batches.                                           *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_proxy_data_pipeline_accepted(const char *buffer)
+{
+	struct zbx_json_parse	jp;
+	char			value[MAX_ID_LEN + 1];
+	zbx_uint64_t		batches;
+
+	if (SUCCEED != zbx_json_open(buffer, &jp))
+		return 0;
+
+	if (SUCCEED != zbx_json_value_by_name(&jp, ZBX_PROTO_TAG_PIPELINE, value, sizeof(value), NULL) ||
+			SUCCEED != is_uint64(value, &batches))
+	{
+		return 0;
+	}
+
+	return (int)MIN(batches, ZBX_PROXY_DATA_BATCHES_MAX);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_proxy_data_join                                              *
+ *                                                                            *
+ * Purpose: joins proxy data json and binary history data into one message    *
+ *                                                                            *
+ * Parameters: j    - [IN] the proxy data json                                *
+ *             data - [IN/OUT] the binary history data block on input, the    *
+ *                             message on output                              *
+ *             size - [IN/OUT] the binary history data block size on input,   *
+ *                             the message size on output                     *
+ *                                                                            *
+ * Comments: The binary history data block follows the json terminating zero  *
+ *           byte, see process_proxy_data().                                  *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_proxy_data_join(const struct zbx_json *j, char **data, size_t *size)
+{
+	char	*message;
+
+	message = (char *)zbx_malloc(NULL, j->buffer_size + 1 + *size);
+	memcpy(message, j->buffer, j->buffer_size + 1);
+	memcpy(message + j->buffer_size + 1, *data, *size);
+
+	zbx_free(*data);
+	*data = message;
+	*size += j->buffer_size + 1;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_update_proxy_lasterror                                       *
@@ -4993,3 +6389,7 @@ int	zbx_check_protocol_version(DC_PROXY *proxy, int version)
 out:
 	return ret;
 }
+
+#ifdef HAVE_TESTS
+#	include "../../../tests/libs/zbxdbhigh/history_binary_test.c"
+#endif
@@ -724,6 +724,86 @@ int	DBdrop_foreign_key(const char *table_name, int id)
 	return ret;
 }
 
+int	DBcreate_serial(const char *table_name, const char *field_name)
+{
+	int	ret = FAIL;
+
+#if defined(HAVE_MYSQL)
+	if (ZBX_DB_OK <= DBexecute("alter table " ZBX_FS_SQL_NAME " modify " ZBX_FS_SQL_NAME " %s not null"
+			" auto_increment", table_name, field_name, ZBX_TYPE_ID_STR))
+	{
+		ret = SUCCEED;
+	}
+#elif defined(HAVE_POSTGRESQL)
+	if (ZBX_DB_OK > DBexecute("create sequence %s_%s_seq owned by %s.%s", table_name, field_name, table_name,
+			field_name))
+	{
+		goto out;
+	}
+
+	if (ZBX_DB_OK <= DBexecute("alter table %s alter column %s set default nextval('%s_%s_seq')", table_name,
+			field_name, table_name, field_name))
+	{
+		ret = SUCCEED;
+	}
+out:
+#elif defined(HAVE_ORACLE)
+	if (ZBX_DB_OK > DBexecute("create sequence %s_seq start with 1 increment by 1 nomaxvalue", table_name))
+		goto out;
+
+	if (ZBX_DB_OK <= DBexecute("create trigger %s_tr before insert on %s for each row"
+			" begin select %s_seq.nextval into :new.%s from dual; end;",
+			table_name, table_name, table_name, field_name))
+	{
+		ret = SUCCEED;
+	}
+out:
+#endif
+	return ret;
+}
+
+int	DBcreate_changelog_triggers(const char *table_name, const char *field_name, int object)
+{
+	const char	*ops[] = {"insert", "update", "delete"};
+	int		i;
+
+	for (i = 0; i < (int)ARRSIZE(ops); i++)
+	{
+		const char	*row = (2 == i ? "old" : "new");
+		int		rc;
+
+#if defined(HAVE_MYSQL)
+		rc = DBexecute("create trigger `%s_%s` after %s on `%s` for each row"
+				" insert into changelog (object,objectid,operation) values (%d,%s.%s,%d)",
+				table_name, ops[i], ops[i], table_name, object, row, field_name, i + 1);
+#elif defined(HAVE_POSTGRESQL)
+		if (ZBX_DB_OK > DBexecute("create function changelog_%s_%s() returns trigger as $$"
+				" begin"
+					" insert into changelog (object,objectid,operation) values (%d,%s.%s,%d);"
+					" return %s;"
+				" end;"
+				" $$ language plpgsql",
+				table_name, ops[i], object, row, field_name, i + 1, row))
+		{
+			return FAIL;
+		}
+
+		rc = DBexecute("create trigger %s_%s after %s on %s for each row execute procedure changelog_%s_%s()",
+				table_name, ops[i], ops[i], table_name, table_name, ops[i]);
+#elif defined(HAVE_ORACLE)
+		rc = DBexecute("create trigger %s_%s after %s on %s for each row"
+				" begin"
+					" insert into changelog (object,objectid,operation) values (%d,:%s.%s,%d);"
+				" end;",
+				table_name, ops[i], ops[i], table_name, object, row, field_name, i + 1);
+#endif
+		if (ZBX_DB_OK > rc)
+			return FAIL;
+	}
+
+	return SUCCEED;
+}
+
 static int	DBcreate_dbversion_table(void)
 {
 	const ZBX_TABLE	table =
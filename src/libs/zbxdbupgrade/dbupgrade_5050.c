@@ -487,6 +487,66 @@ static int	DBpatch_5050034(void)
 
 	return DBset_default("config", &field);
 }
+
+static int	DBpatch_5050035(void)
+{
+	const ZBX_TABLE	table =
+			{"changelog", "changelogid", 0,
+				{
+					{"changelogid", NULL, NULL, NULL, 0, ZBX_TYPE_ID, ZBX_NOTNULL, 0},
+					{"object", "0", NULL, NULL, 0, ZBX_TYPE_INT, ZBX_NOTNULL, 0},
+					{"objectid", NULL, NULL, NULL, 0, ZBX_TYPE_ID, ZBX_NOTNULL, 0},
+					{"operation", "0", NULL, NULL, 0, ZBX_TYPE_INT, ZBX_NOTNULL, 0},
+					{0}
+				},
+				NULL
+			};
+
+	if (SUCCEED != DBcreate_table(&table))
+		return FAIL;
+
+	return DBcreate_serial("changelog", "changelogid");
+}
+
+static int	DBpatch_5050036(void)
+{
+	return DBcreate_changelog_triggers("hosts", "hostid", 1);
+}
+
+static int	DBpatch_5050037(void)
+{
+	return DBcreate_changelog_triggers("host_tag", "hosttagid", 2);
+}
+
+static int	DBpatch_5050038(void)
+{
+	return DBcreate_changelog_triggers("items", "itemid", 3);
+}
+
+static int	DBpatch_5050039(void)
+{
+	return DBcreate_changelog_triggers("item_tag", "itemtagid", 4);
+}
+
+static int	DBpatch_5050040(void)
+{
+	return DBcreate_changelog_triggers("triggers", "triggerid", 5);
+}
+
+static int	DBpatch_5050041(void)
+{
+	return DBcreate_changelog_triggers("trigger_tag", "triggertagid", 6);
+}
+
+static int	DBpatch_5050042(void)
+{
+	return DBcreate_changelog_triggers("functions", "functionid", 7);
+}
+
+static int	DBpatch_5050043(void)
+{
+	return DBcreate_changelog_triggers("item_preproc", "item_preprocid", 8);
+}
 #endif
 
 DBPATCH_START(5050)
@@ -528,5 +588,14 @@ DBPATCH_ADD(5050031, 0, 1)
 DBPATCH_ADD(5050032, 0, 1)
 DBPATCH_ADD(5050033, 0, 1)
 DBPATCH_ADD(5050034, 0, 1)
+DBPATCH_ADD(5050035, 0, 1)
+DBPATCH_ADD(5050036, 0, 1)
+DBPATCH_ADD(5050037, 0, 1)
+DBPATCH_ADD(5050038, 0, 1)
+DBPATCH_ADD(5050039, 0, 1)
+DBPATCH_ADD(5050040, 0, 1)
+DBPATCH_ADD(5050041, 0, 1)
+DBPATCH_ADD(5050042, 0, 1)
+DBPATCH_ADD(5050043, 0, 1)
 
 DBPATCH_END()
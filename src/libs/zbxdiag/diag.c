@@ -227,6 +227,43 @@ static void	diag_historycache_add_items(struct zbx_json *json, const char *field
 	zbx_json_close(json);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: diag_add_historycache_shards                                     *
+ *                                                                            *
+ * Purpose: add history cache shard statistics to json data                   *
+ *                                                                            *
+ * Parameters: json  - [IN/OUT] the json to update                            *
+ *                                                                            *
+ ******************************************************************************/
+static void	diag_add_historycache_shards(struct zbx_json *json)
+{
+	int	i;
+
+	zbx_json_addarray(json, "shards");
+
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		zbx_uint64_t	values_num, items_num;
+		zbx_mem_stats_t	data_mem, index_mem;
+
+		zbx_hc_get_shard_diag_stats(i, &items_num, &values_num);
+		zbx_hc_get_shard_mem_stats(i, &data_mem, &index_mem);
+
+		zbx_json_addobject(json, NULL);
+		zbx_json_addint64(json, "shard", i);
+		zbx_json_addint64(json, "items", items_num);
+		zbx_json_addint64(json, "values", values_num);
+		zbx_json_addobject(json, "memory");
+		diag_add_mem_stats(json, "data", &data_mem);
+		diag_add_mem_stats(json, "index", &index_mem);
+		zbx_json_close(json);
+		zbx_json_close(json);
+	}
+
+	zbx_json_close(json);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: diag_add_historycache_info                                       *
@@ -254,6 +291,7 @@ int	diag_add_historycache_info(const struct zbx_json_parse *jp, struct zbx_json
 					{"memory", ZBX_DIAG_HISTORYCACHE_MEMORY},
 					{"memory.data", ZBX_DIAG_HISTORYCACHE_MEMORY_DATA},
 					{"memory.index", ZBX_DIAG_HISTORYCACHE_MEMORY_INDEX},
+					{"shards", ZBX_DIAG_HISTORYCACHE_SHARDS},
 					{NULL, 0}
 					};
 
@@ -298,6 +336,14 @@ int	diag_add_historycache_info(const struct zbx_json_parse *jp, struct zbx_json
 			zbx_json_close(json);
 		}
 
+		if (0 != (fields & ZBX_DIAG_HISTORYCACHE_SHARDS))
+		{
+			time1 = zbx_time();
+			diag_add_historycache_shards(json);
+			time2 = zbx_time();
+			time_total += time2 - time1;
+		}
+
 		if (0 != tops.values_num)
 		{
 			zbx_json_addobject(json, "top");
@@ -514,27 +560,38 @@ void	diag_add_locks_info(struct zbx_json *json)
 {
 	int		i;
 #ifdef HAVE_VMINFO_T_UPDATES
-	const char	*names[ZBX_MUTEX_COUNT] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
+	const char	*names[ZBX_MUTEX_CACHE_SHARD] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
 				"ZBX_MUTEX_CACHE_IDS", "ZBX_MUTEX_SELFMON", "ZBX_MUTEX_CPUSTATS", "ZBX_MUTEX_DISKSTATS",
 				"ZBX_MUTEX_VALUECACHE", "ZBX_MUTEX_VMWARE", "ZBX_MUTEX_SQLITE3",
 				"ZBX_MUTEX_PROCSTAT", "ZBX_MUTEX_PROXY_HISTORY", "ZBX_MUTEX_KSTAT", "ZBX_MUTEX_MODBUS",
-				"ZBX_MUTEX_TREND_FUNC"};
+				"ZBX_MUTEX_TREND_FUNC", "ZBX_MUTEX_PROXY_BUFFER", "ZBX_MUTEX_PROXY_MEMORY_BUFFER"};
 #else
-	const char	*names[ZBX_MUTEX_COUNT] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
+	const char	*names[ZBX_MUTEX_CACHE_SHARD] = {"ZBX_MUTEX_LOG", "ZBX_MUTEX_CACHE", "ZBX_MUTEX_TRENDS",
 				"ZBX_MUTEX_CACHE_IDS", "ZBX_MUTEX_SELFMON", "ZBX_MUTEX_CPUSTATS", "ZBX_MUTEX_DISKSTATS",
 				"ZBX_MUTEX_VALUECACHE", "ZBX_MUTEX_VMWARE", "ZBX_MUTEX_SQLITE3",
 				"ZBX_MUTEX_PROCSTAT", "ZBX_MUTEX_PROXY_HISTORY", "ZBX_MUTEX_MODBUS",
-				"ZBX_MUTEX_TREND_FUNC"};
+				"ZBX_MUTEX_TREND_FUNC", "ZBX_MUTEX_PROXY_BUFFER", "ZBX_MUTEX_PROXY_MEMORY_BUFFER"};
 #endif
 	zbx_json_addarray(json, ZBX_DIAG_LOCKS);
 
-	for (i = 0; i < ZBX_MUTEX_COUNT; i++)
+	for (i = 0; i < ZBX_MUTEX_CACHE_SHARD; i++)
 	{
 		zbx_json_addobject(json, NULL);
 		zbx_json_addhex(json, names[i], (zbx_uint64_t)zbx_mutex_addr_get(i));
 		zbx_json_close(json);
 	}
 
+	for (i = ZBX_MUTEX_CACHE_SHARD; i < ZBX_MUTEX_COUNT; i++)
+	{
+		char	name[MAX_STRING_LEN];
+
+		zbx_snprintf(name, sizeof(name), "ZBX_MUTEX_CACHE_SHARD_%d", i - ZBX_MUTEX_CACHE_SHARD + 1);
+
+		zbx_json_addobject(json, NULL);
+		zbx_json_addhex(json, name, (zbx_uint64_t)zbx_mutex_addr_get(i));
+		zbx_json_close(json);
+	}
+
 	zbx_json_addobject(json, NULL);
 	zbx_json_addhex(json, "ZBX_RWLOCK_CONFIG", (zbx_uint64_t)zbx_rwlock_addr_get(ZBX_RWLOCK_CONFIG));
 	zbx_json_close(json);
@@ -108,6 +108,7 @@ static int	diag_add_valuecache_info(const struct zbx_json_parse *jp, struct zbx_
 					{"values", ZBX_DIAG_VALUECACHE_VALUES},
 					{"mode", ZBX_DIAG_VALUECACHE_MODE},
 					{"memory", ZBX_DIAG_VALUECACHE_MEMORY},
+					{"compression", ZBX_DIAG_VALUECACHE_COMPRESSION},
 					{NULL, 0}
 					};
 
@@ -119,11 +120,11 @@ static int	diag_add_valuecache_info(const struct zbx_json_parse *jp, struct zbx_
 
 		if (0 != (fields & ZBX_DIAG_VALUECACHE_SIMPLE))
 		{
-			zbx_uint64_t	values_num, items_num;
+			zbx_uint64_t	values_num, items_num, packed_values_num, packed_size;
 			int		mode;
 
 			time1 = zbx_time();
-			zbx_vc_get_diag_stats(&items_num, &values_num, &mode);
+			zbx_vc_get_diag_stats(&items_num, &values_num, &mode, &packed_values_num, &packed_size);
 			time2 = zbx_time();
 			time_total += time2 - time1;
 
@@ -133,6 +134,16 @@ static int	diag_add_valuecache_info(const struct zbx_json_parse *jp, struct zbx_
 				zbx_json_addint64(json, "values", values_num);
 			if (0 != (fields & ZBX_DIAG_VALUECACHE_MODE))
 				zbx_json_addint64(json, "mode", mode);
+
+			if (0 != (fields & ZBX_DIAG_VALUECACHE_COMPRESSION))
+			{
+				zbx_json_addobject(json, "compression");
+				zbx_json_adduint64(json, "values", packed_values_num);
+				zbx_json_adduint64(json, "size", packed_size);
+				zbx_json_addfloat(json, "ratio", 0 == packed_size ? 0 :
+						(double)packed_values_num * sizeof(zbx_history_record_t) / packed_size);
+				zbx_json_close(json);
+			}
 		}
 
 		if (0 != (fields & ZBX_DIAG_VALUECACHE_MEMORY))
@@ -20,6 +20,8 @@
 #include "common.h"
 #include "log.h"
 #include "zbxalgo.h"
+#include "db.h"
+#include "dbcache.h"
 #include "zbxhistory.h"
 #include "history.h"
 
@@ -32,6 +34,45 @@ extern char	*CONFIG_HISTORY_STORAGE_OPTS;
 
 zbx_history_iface_t	history_ifaces[ITEM_VALUE_TYPE_MAX];
 
+#if defined(ZBX_HAVE_THREAD_LOCAL) && (defined(HAVE_POSTGRESQL) || defined(HAVE_MYSQL))
+#	define ZBX_HISTORY_PIPELINE
+#endif
+
+#ifdef ZBX_HISTORY_PIPELINE
+
+/* the maximum number of queued history batches, including the batch being written */
+#define ZBX_HISTORY_PIPELINE_DEPTH	2
+
+#define ZBX_HISTORY_PIPELINE_STOPPED	0
+#define ZBX_HISTORY_PIPELINE_RUNNING	1
+#define ZBX_HISTORY_PIPELINE_FAILED	2
+
+/* history values queued for writing by pipeline thread */
+typedef struct
+{
+	/* the batch sequence number */
+	zbx_uint64_t		seq;
+
+	/* the copied history values (ZBX_DC_HISTORY) */
+	zbx_vector_ptr_t	history;
+}
+zbx_history_batch_t;
+
+static pthread_mutex_t	pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pipeline_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	pipeline_written = PTHREAD_COND_INITIALIZER;
+static zbx_vector_ptr_t	pipeline_queue;
+static int		pipeline_state = ZBX_HISTORY_PIPELINE_STOPPED, pipeline_enabled;
+
+/* the sequence numbers of the last queued and the last written batches - the written */
+/* batch sequence is the watermark below which all queued values are processed        */
+static zbx_uint64_t	pipeline_seq, pipeline_written_seq;
+
+/* the sequence numbers of batches that could not be written and were not reported yet */
+static zbx_vector_uint64_t	pipeline_failed;
+
+#endif
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_init                                                       *
@@ -89,20 +130,18 @@ void	zbx_history_destroy(void)
 
 /************************************************************************************
  *                                                                                  *
- * Function: zbx_history_add_values                                                 *
+ * Function: history_write_values                                                   *
  *                                                                                  *
- * Purpose: Sends values to the history storage                                     *
+ * Purpose: writes values to the history storage                                    *
  *                                                                                  *
  * Parameters: history - [IN] the values to store                                   *
  *                                                                                  *
- * Comments: add history values to the configured storage backends                  *
- *                                                                                  *
  ************************************************************************************/
-int	zbx_history_add_values(const zbx_vector_ptr_t *history)
+static int	history_write_values(const zbx_vector_ptr_t *history)
 {
 	int	i, flags = 0, ret = SUCCEED;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() values:%d", __func__, history->values_num);
 
 	for (i = 0; i < ITEM_VALUE_TYPE_MAX; i++)
 	{
@@ -125,6 +164,316 @@ int	zbx_history_add_values(const zbx_vector_ptr_t *history)
 	return ret;
 }
 
+#ifdef ZBX_HISTORY_PIPELINE
+/************************************************************************************
+ *                                                                                  *
+ * Function: history_batch_free                                                     *
+ *                                                                                  *
+ * Purpose: frees history batch with the copied values                              *
+ *                                                                                  *
+ ************************************************************************************/
+static void	history_batch_free(zbx_history_batch_t *batch)
+{
+	int	i;
+
+	for (i = 0; i < batch->history.values_num; i++)
+	{
+		ZBX_DC_HISTORY	*h = (ZBX_DC_HISTORY *)batch->history.values[i];
+
+		switch (h->value_type)
+		{
+			case ITEM_VALUE_TYPE_STR:
+			case ITEM_VALUE_TYPE_TEXT:
+				zbx_free(h->value.str);
+				break;
+			case ITEM_VALUE_TYPE_LOG:
+				zbx_free(h->value.log->source);
+				zbx_free(h->value.log->value);
+				zbx_free(h->value.log);
+				break;
+		}
+
+		zbx_free(h);
+	}
+
+	zbx_vector_ptr_destroy(&batch->history);
+	zbx_free(batch);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: history_pipeline_thread                                                *
+ *                                                                                  *
+ * Purpose: pipeline thread entry point, writes queued history batches              *
+ *                                                                                  *
+ * Comments: The thread uses its own database connection and runs until the         *
+ *           process exits.                                                         *
+ *                                                                                  *
+ ************************************************************************************/
+static void	*history_pipeline_thread(void *args)
+{
+	zbx_history_batch_t	*batch;
+	int			ret;
+
+	ZBX_UNUSED(args);
+
+	DBconnect(ZBX_DB_CONNECT_NORMAL);
+
+	pthread_mutex_lock(&pipeline_lock);
+
+	for (;;)
+	{
+		while (0 == pipeline_queue.values_num)
+			pthread_cond_wait(&pipeline_queued, &pipeline_lock);
+
+		batch = (zbx_history_batch_t *)pipeline_queue.values[0];
+		pthread_mutex_unlock(&pipeline_lock);
+
+		if (SUCCEED != (ret = history_write_values(&batch->history)))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot write %d history values, batch " ZBX_FS_UI64,
+					batch->history.values_num, batch->seq);
+		}
+
+		pthread_mutex_lock(&pipeline_lock);
+
+		if (SUCCEED != ret)
+			zbx_vector_uint64_append(&pipeline_failed, batch->seq);
+
+		zbx_vector_ptr_remove(&pipeline_queue, 0);
+		pipeline_written_seq = batch->seq;
+		pthread_cond_broadcast(&pipeline_written);
+
+		pthread_mutex_unlock(&pipeline_lock);
+		history_batch_free(batch);
+		pthread_mutex_lock(&pipeline_lock);
+	}
+
+	return NULL;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: history_pipeline_push                                                  *
+ *                                                                                  *
+ * Purpose: queues copy of history values for writing by pipeline thread            *
+ *                                                                                  *
+ * Parameters: history - [IN] the values to store                                   *
+ *                                                                                  *
+ * Comments: Blocks while the pipeline is full.                                     *
+ *                                                                                  *
+ ************************************************************************************/
+static void	history_pipeline_push(const zbx_vector_ptr_t *history)
+{
+	int			i;
+	zbx_history_batch_t	*batch;
+
+	batch = (zbx_history_batch_t *)zbx_malloc(NULL, sizeof(zbx_history_batch_t));
+	zbx_vector_ptr_create(&batch->history);
+	zbx_vector_ptr_reserve(&batch->history, history->values_num);
+
+	for (i = 0; i < history->values_num; i++)
+	{
+		const ZBX_DC_HISTORY	*src = (const ZBX_DC_HISTORY *)history->values[i];
+		ZBX_DC_HISTORY		*h;
+
+		h = (ZBX_DC_HISTORY *)zbx_malloc(NULL, sizeof(ZBX_DC_HISTORY));
+		*h = *src;
+
+		switch (h->value_type)
+		{
+			case ITEM_VALUE_TYPE_STR:
+			case ITEM_VALUE_TYPE_TEXT:
+				h->value.str = zbx_strdup(NULL, src->value.str);
+				break;
+			case ITEM_VALUE_TYPE_LOG:
+				h->value.log = (zbx_log_value_t *)zbx_malloc(NULL, sizeof(zbx_log_value_t));
+				*h->value.log = *src->value.log;
+				h->value.log->value = zbx_strdup(NULL, src->value.log->value);
+
+				if (NULL != src->value.log->source)
+					h->value.log->source = zbx_strdup(NULL, src->value.log->source);
+				break;
+		}
+
+		zbx_vector_ptr_append(&batch->history, h);
+	}
+
+	pthread_mutex_lock(&pipeline_lock);
+
+	while (ZBX_HISTORY_PIPELINE_DEPTH <= pipeline_queue.values_num)
+		pthread_cond_wait(&pipeline_written, &pipeline_lock);
+
+	batch->seq = ++pipeline_seq;
+	zbx_vector_ptr_append(&pipeline_queue, batch);
+	pthread_cond_signal(&pipeline_queued);
+
+	pthread_mutex_unlock(&pipeline_lock);
+}
+#endif
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_add_values                                                 *
+ *                                                                                  *
+ * Purpose: Sends values to the history storage                                     *
+ *                                                                                  *
+ * Parameters: history - [IN] the values to store                                   *
+ *                                                                                  *
+ * Comments: add history values to the configured storage backends                  *
+ *           When history pipeline is enabled the values are queued for writing     *
+ *           and this function returns without waiting for them to be stored.       *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_add_values(const zbx_vector_ptr_t *history)
+{
+#ifdef ZBX_HISTORY_PIPELINE
+	if (0 != pipeline_enabled)
+	{
+		history_pipeline_push(history);
+		return SUCCEED;
+	}
+#endif
+	return history_write_values(history);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_pipeline_begin                                             *
+ *                                                                                  *
+ * Purpose: starts queuing history values for writing by pipeline thread            *
+ *                                                                                  *
+ * Return value: SUCCEED - the history values will be written asynchronously        *
+ *               FAIL    - history pipeline is not supported, the values will be    *
+ *                         written synchronously                                    *
+ *                                                                                  *
+ * Comments: The pipeline thread is started with the first call and has its own     *
+ *           database connection. Pipeline is supported only with MySQL and         *
+ *           PostgreSQL and is not used with Elasticsearch history storage.         *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_pipeline_begin(void)
+{
+#ifdef ZBX_HISTORY_PIPELINE
+	pthread_t	thread;
+	sigset_t	mask, orig_mask;
+	int		err;
+
+	if (NULL != CONFIG_HISTORY_STORAGE_URL)
+		return FAIL;
+
+	if (ZBX_HISTORY_PIPELINE_STOPPED == pipeline_state)
+	{
+		zbx_vector_ptr_create(&pipeline_queue);
+		zbx_vector_uint64_create(&pipeline_failed);
+
+		/* block signals in pipeline thread, so they are handled by the main thread */
+		sigfillset(&mask);
+		pthread_sigmask(SIG_BLOCK, &mask, &orig_mask);
+
+		if (0 != (err = pthread_create(&thread, NULL, history_pipeline_thread, NULL)))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "cannot start history pipeline thread: %s", zbx_strerror(err));
+			pipeline_state = ZBX_HISTORY_PIPELINE_FAILED;
+		}
+		else
+		{
+			pthread_detach(thread);
+			pipeline_state = ZBX_HISTORY_PIPELINE_RUNNING;
+		}
+
+		pthread_sigmask(SIG_SETMASK, &orig_mask, NULL);
+	}
+
+	if (ZBX_HISTORY_PIPELINE_RUNNING != pipeline_state)
+		return FAIL;
+
+	pipeline_enabled = 1;
+
+	return SUCCEED;
+#else
+	return FAIL;
+#endif
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_pipeline_seq                                               *
+ *                                                                                  *
+ * Purpose: returns sequence number of the last queued history batch                *
+ *                                                                                  *
+ ************************************************************************************/
+zbx_uint64_t	zbx_history_pipeline_seq(void)
+{
+#ifdef ZBX_HISTORY_PIPELINE
+	return pipeline_seq;
+#else
+	return 0;
+#endif
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_pipeline_wait                                              *
+ *                                                                                  *
+ * Purpose: waits until history batches up to the specified sequence number are     *
+ *          written                                                                 *
+ *                                                                                  *
+ * Parameters: seq - [IN] the history batch sequence number                         *
+ *                                                                                  *
+ * Return value: SUCCEED - the batches were written                                 *
+ *               FAIL    - at least one of the batches could not be written         *
+ *                                                                                  *
+ * Comments: A failed batch is reported only once, by the first wait covering its   *
+ *           sequence number.                                                       *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_pipeline_wait(zbx_uint64_t seq)
+{
+#ifdef ZBX_HISTORY_PIPELINE
+	int	ret = SUCCEED;
+
+	if (ZBX_HISTORY_PIPELINE_RUNNING != pipeline_state)
+		return SUCCEED;
+
+	pthread_mutex_lock(&pipeline_lock);
+
+	while (pipeline_written_seq < seq)
+		pthread_cond_wait(&pipeline_written, &pipeline_lock);
+
+	/* failed batches are appended in the order they are written */
+	while (0 != pipeline_failed.values_num && pipeline_failed.values[0] <= seq)
+	{
+		zbx_vector_uint64_remove(&pipeline_failed, 0);
+		ret = FAIL;
+	}
+
+	pthread_mutex_unlock(&pipeline_lock);
+
+	return ret;
+#else
+	ZBX_UNUSED(seq);
+
+	return SUCCEED;
+#endif
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_pipeline_end                                               *
+ *                                                                                  *
+ * Purpose: waits until all queued history values are written and switches back     *
+ *          to synchronous history writes                                           *
+ *                                                                                  *
+ ************************************************************************************/
+void	zbx_history_pipeline_end(void)
+{
+#ifdef ZBX_HISTORY_PIPELINE
+	zbx_history_pipeline_wait(pipeline_seq);
+	pipeline_enabled = 0;
+#endif
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_get_values                                                 *
@@ -177,6 +526,71 @@ int	zbx_history_get_values(zbx_uint64_t itemid, int value_type, int start, int c
 	return ret;
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: zbx_history_get_values_multi                                           *
+ *                                                                                  *
+ * Purpose: gets values of multiple items from history storage                      *
+ *                                                                                  *
+ * Parameters:  requests - [IN/OUT] the history requests (zbx_history_request_t)    *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: This function reads all values from ]<start>,<end>] interval of every  *
+ *           request. Each item must be requested only once per interval.           *
+ *           Storage backends not supporting batched reads are queried item by      *
+ *           item.                                                                  *
+ *                                                                                  *
+ ************************************************************************************/
+int	zbx_history_get_values_multi(zbx_vector_ptr_t *requests)
+{
+	int			i, value_type, ret = SUCCEED;
+	zbx_vector_ptr_t	type_requests;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() requests:%d", __func__, requests->values_num);
+
+	zbx_vector_ptr_create(&type_requests);
+
+	for (value_type = 0; value_type < ITEM_VALUE_TYPE_MAX && SUCCEED == ret; value_type++)
+	{
+		zbx_history_iface_t	*writer = &history_ifaces[value_type];
+
+		zbx_vector_ptr_clear(&type_requests);
+
+		for (i = 0; i < requests->values_num; i++)
+		{
+			zbx_history_request_t	*request = (zbx_history_request_t *)requests->values[i];
+
+			if (request->value_type == value_type)
+				zbx_vector_ptr_append(&type_requests, request);
+		}
+
+		if (0 == type_requests.values_num)
+			continue;
+
+		if (NULL != writer->get_values_multi)
+		{
+			ret = writer->get_values_multi(writer, &type_requests);
+			continue;
+		}
+
+		for (i = 0; i < type_requests.values_num && SUCCEED == ret; i++)
+		{
+			zbx_history_request_t	*request = (zbx_history_request_t *)type_requests.values[i];
+
+			ret = writer->get_values(writer, request->itemid, request->start, 0, request->end,
+					&request->values);
+		}
+	}
+
+	zbx_vector_ptr_destroy(&type_requests);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: zbx_history_requires_trends                                            *
@@ -33,10 +33,23 @@
 #define		ZBX_IDX_JSON_ALLOCATE		256
 #define		ZBX_JSON_ALLOCATE		2048
 
+/* the bulk request is sent as soon as its body reaches this size */
+#define		ZBX_ELASTIC_BULK_SIZE		ZBX_MEBIBYTE
+
+/* the number of values read by one search request */
+#define		ZBX_ELASTIC_SEARCH_SIZE		1000
+
+/* point in time used by paged search is kept alive for this period after each request */
+#define		ZBX_ELASTIC_PIT_KEEP_ALIVE	"1m"
+
+/* point in time and _shard_doc sort are available starting with Elasticsearch 7.12 */
+#define		ZBX_ELASTIC_PIT_MIN_VERSION	71200
+
 const char	*value_type_str[] = {"dbl", "str", "log", "uint", "text"};
 
 extern char	*CONFIG_HISTORY_STORAGE_URL;
 extern int	CONFIG_HISTORY_STORAGE_PIPELINES;
+extern int	CONFIG_HISTORY_STORAGE_CONCURRENCY;
 
 static zbx_uint32_t	ZBX_ELASTIC_SVERSION = ZBX_DBVERSION_UNDEFINED;
 
@@ -44,22 +57,10 @@ typedef struct
 {
 	char	*base_url;
 	char	*post_url;
-	char	*buf;
 	CURL	*handle;
 }
 zbx_elastic_data_t;
 
-typedef struct
-{
-	unsigned char		initialized;
-	zbx_vector_ptr_t	ifaces;
-
-	CURLM			*handle;
-}
-zbx_elastic_writer_t;
-
-static zbx_elastic_writer_t	writer;
-
 typedef struct
 {
 	char	*data;
@@ -70,14 +71,39 @@ zbx_httppage_t;
 
 static zbx_httppage_t	page_r;
 
+/* bulk request, reused together with its cURL handle to keep the connection alive */
 typedef struct
 {
+	CURL		*handle;
+	zbx_httppage_t	body;
 	zbx_httppage_t	page;
 	char		errbuf[CURL_ERROR_SIZE];
+	int		values_num;
 }
-zbx_curlpage_t;
+zbx_elastic_request_t;
 
-static zbx_curlpage_t	page_w[ITEM_VALUE_TYPE_MAX];
+typedef struct
+{
+	unsigned char		initialized;
+	char			*post_url;
+	struct curl_slist	*headers;
+	CURLM			*handle;
+
+	/* the request being filled with history values */
+	zbx_elastic_request_t	*request;
+
+	/* the requests being sent, limited by HistoryStorageConcurrency */
+	zbx_vector_ptr_t	requests_running;
+
+	/* the requests which failed because of transport or storage errors and must be resent */
+	zbx_vector_ptr_t	requests_retry;
+
+	/* the requests ready to be filled with history values */
+	zbx_vector_ptr_t	requests_idle;
+}
+zbx_elastic_writer_t;
+
+static zbx_elastic_writer_t	writer;
 
 static size_t	curl_write_cb(void *ptr, size_t size, size_t nmemb, void *userdata)
 {
@@ -191,6 +217,48 @@ out:
 	return ret;
 }
 
+/* doc value fields are returned as arrays, even if they have single value */
+static int	history_docvalue_by_name(struct zbx_json_parse *jp, const char *name, char **value, size_t *value_alloc)
+{
+	struct zbx_json_parse	jp_field;
+
+	if (SUCCEED != zbx_json_brackets_by_name(jp, name, &jp_field))
+		return FAIL;
+
+	if (NULL == zbx_json_next_value_dyn(&jp_field, NULL, value, value_alloc, NULL))
+		return FAIL;
+
+	return SUCCEED;
+}
+
+static int	history_parse_docvalues(struct zbx_json_parse *jp, unsigned char value_type, zbx_history_record_t *hr)
+{
+	char	*value = NULL;
+	size_t	value_alloc = 0;
+	int	ret = FAIL;
+
+	if (SUCCEED != history_docvalue_by_name(jp, "clock", &value, &value_alloc))
+		goto out;
+
+	hr->timestamp.sec = atoi(value);
+
+	if (SUCCEED != history_docvalue_by_name(jp, "ns", &value, &value_alloc))
+		goto out;
+
+	hr->timestamp.ns = atoi(value);
+
+	if (SUCCEED != history_docvalue_by_name(jp, "value", &value, &value_alloc))
+		goto out;
+
+	hr->value = history_str2value(value, value_type);
+
+	ret = SUCCEED;
+out:
+	zbx_free(value);
+
+	return ret;
+}
+
 static void	elastic_log_error(CURL *handle, CURLcode error, const char *errbuf)
 {
 	char		http_status[MAX_STRING_LEN];
@@ -232,14 +300,10 @@ static void	elastic_close(zbx_history_iface_t *hist)
 {
 	zbx_elastic_data_t	*data = (zbx_elastic_data_t *)hist->data;
 
-	zbx_free(data->buf);
 	zbx_free(data->post_url);
 
 	if (NULL != data->handle)
 	{
-		if (NULL != writer.handle)
-			curl_multi_remove_handle(writer.handle, data->handle);
-
 		curl_easy_cleanup(data->handle);
 		data->handle = NULL;
 	}
@@ -323,26 +387,108 @@ static int	elastic_is_error_present(zbx_httppage_t *page, char **err)
 
 
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_request_free                                                   *
+ *                                                                                  *
+ * Purpose: releases bulk request and its cURL handle                               *
+ *                                                                                  *
+ ************************************************************************************/
+static void	elastic_request_free(zbx_elastic_request_t *request)
+{
+	curl_easy_cleanup(request->handle);
+	zbx_free(request->body.data);
+	zbx_free(request->page.data);
+	zbx_free(request);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_request_create                                                 *
+ *                                                                                  *
+ * Purpose: creates bulk request with cURL handle to be reused for sending          *
+ *          history values                                                          *
+ *                                                                                  *
+ * Return value: the created request or NULL if cURL handle cannot be initialized   *
+ *                                                                                  *
+ ************************************************************************************/
+static zbx_elastic_request_t	*elastic_request_create(void)
+{
+	zbx_elastic_request_t	*request;
+	CURLoption		opt;
+	CURLcode		err;
+
+	request = (zbx_elastic_request_t *)zbx_malloc(NULL, sizeof(zbx_elastic_request_t));
+	memset(request, 0, sizeof(zbx_elastic_request_t));
+
+	if (NULL == (request->handle = curl_easy_init()))
+	{
+		zabbix_log(LOG_LEVEL_ERR, "cannot initialize cURL session");
+		zbx_free(request);
+		return NULL;
+	}
+
+	if (CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_URL, writer.post_url)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_POST, 1L)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_HTTPHEADER, writer.headers)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_WRITEFUNCTION,
+					curl_write_cb)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_WRITEDATA, &request->page)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_FAILONERROR, 1L)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_ERRORBUFFER,
+					request->errbuf)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_PRIVATE, request)))
+	{
+		zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)opt, curl_easy_strerror(err));
+		elastic_request_free(request);
+		return NULL;
+	}
+
+	return request;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_request_reset                                                  *
+ *                                                                                  *
+ * Purpose: clears sent history values from bulk request, so it can be reused       *
+ *                                                                                  *
+ ************************************************************************************/
+static void	elastic_request_reset(zbx_elastic_request_t *request)
+{
+	request->body.offset = 0;
+	request->values_num = 0;
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: elastic_writer_init                                                    *
  *                                                                                  *
- * Purpose: initializes elastic writer for a new batch of history values            *
+ * Purpose: initializes elastic writer, the writer is kept until history storage    *
+ *          interfaces are destroyed, so connections to storage are reused          *
+ *                                                                                  *
+ * Parameters: base_url - [IN] the history storage URL                              *
  *                                                                                  *
  ************************************************************************************/
-static void	elastic_writer_init(void)
+static void	elastic_writer_init(const char *base_url)
 {
 	if (0 != writer.initialized)
 		return;
 
-	zbx_vector_ptr_create(&writer.ifaces);
-
 	if (NULL == (writer.handle = curl_multi_init()))
 	{
 		zbx_error("Cannot initialize cURL multi session");
 		exit(EXIT_FAILURE);
 	}
 
+	zbx_vector_ptr_create(&writer.requests_running);
+	zbx_vector_ptr_create(&writer.requests_retry);
+	zbx_vector_ptr_create(&writer.requests_idle);
+
+	writer.post_url = zbx_dsprintf(NULL, "%s/_bulk?refresh=true", base_url);
+	writer.headers = curl_slist_append(NULL, "Content-Type: application/x-ndjson");
+	writer.request = NULL;
+
 	writer.initialized = 1;
 }
 
@@ -358,75 +504,282 @@ static void	elastic_writer_release(void)
 {
 	int	i;
 
-	for (i = 0; i < writer.ifaces.values_num; i++)
-		elastic_close((zbx_history_iface_t *)writer.ifaces.values[i]);
+	if (0 == writer.initialized)
+		return;
+
+	for (i = 0; i < writer.requests_running.values_num; i++)
+	{
+		zbx_elastic_request_t	*request = (zbx_elastic_request_t *)writer.requests_running.values[i];
+
+		curl_multi_remove_handle(writer.handle, request->handle);
+	}
+
+	zbx_vector_ptr_clear_ext(&writer.requests_running, (zbx_clean_func_t)elastic_request_free);
+	zbx_vector_ptr_destroy(&writer.requests_running);
+	zbx_vector_ptr_clear_ext(&writer.requests_retry, (zbx_clean_func_t)elastic_request_free);
+	zbx_vector_ptr_destroy(&writer.requests_retry);
+	zbx_vector_ptr_clear_ext(&writer.requests_idle, (zbx_clean_func_t)elastic_request_free);
+	zbx_vector_ptr_destroy(&writer.requests_idle);
+
+	if (NULL != writer.request)
+		elastic_request_free(writer.request);
 
 	curl_multi_cleanup(writer.handle);
 	writer.handle = NULL;
 
-	zbx_vector_ptr_destroy(&writer.ifaces);
+	curl_slist_free_all(writer.headers);
+	zbx_free(writer.post_url);
 
 	writer.initialized = 0;
 }
 
 /************************************************************************************
  *                                                                                  *
- * Function: elastic_writer_add_iface                                               *
+ * Function: elastic_writer_complete                                                *
+ *                                                                                  *
+ * Purpose: checks result of sent bulk request                                      *
  *                                                                                  *
- * Purpose: adds history storage interface to be flushed later                      *
+ * Parameters: request - [IN] the completed request                                 *
+ *             result  - [IN] the transfer result                                   *
  *                                                                                  *
- * Parameters: db_insert - [IN] bulk insert data                                    *
+ * Comments: The request is moved to retry list on transport or storage errors,     *
+ *           otherwise it becomes idle.                                             *
  *                                                                                  *
  ************************************************************************************/
-static void	elastic_writer_add_iface(zbx_history_iface_t *hist)
+static void	elastic_writer_complete(zbx_elastic_request_t *request, CURLcode result)
 {
-	zbx_elastic_data_t	*data = (zbx_elastic_data_t *)hist->data;
-	CURLoption		opt;
-	CURLcode		err;
+	char	*error;
 
-	elastic_writer_init();
+	/* If the error is due to malformed data, there is no sense on re-trying to send. */
+	/* That's why we actually check for transport and curl errors separately */
+	if (CURLE_HTTP_RETURNED_ERROR == result)
+	{
+		if ('\0' != *request->errbuf)
+		{
+			zabbix_log(LOG_LEVEL_ERR, "cannot send data to elasticsearch, HTTP error message: %s",
+					request->errbuf);
+		}
+		else
+		{
+			char		http_status[MAX_STRING_LEN];
+			long int	response_code;
+
+			if (CURLE_OK == curl_easy_getinfo(request->handle, CURLINFO_RESPONSE_CODE, &response_code))
+				zbx_snprintf(http_status, sizeof(http_status), "HTTP status code: %ld", response_code);
+			else
+				zbx_strlcpy(http_status, "unknown HTTP status code", sizeof(http_status));
 
-	if (NULL == (data->handle = curl_easy_init()))
+			zabbix_log(LOG_LEVEL_ERR, "cannot send data to elasticsearch, %s", http_status);
+		}
+	}
+	else if (CURLE_OK != result)
 	{
-		zabbix_log(LOG_LEVEL_ERR, "cannot initialize cURL session");
+		zabbix_log(LOG_LEVEL_WARNING, "cannot send data to elasticsearch: %s",
+				'\0' != *request->errbuf ? request->errbuf : curl_easy_strerror(result));
+
+		/* If the error is due to curl internal problems or unrelated */
+		/* problems with HTTP, we put the request in a retry list */
+		zbx_vector_ptr_append(&writer.requests_retry, request);
 		return;
 	}
+	else if (SUCCEED == elastic_is_error_present(&request->page, &error))
+	{
+		zabbix_log(LOG_LEVEL_WARNING, "%s() cannot send data to elasticsearch: %s", __func__, error);
+		zbx_free(error);
 
-	if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_URL, data->post_url)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POST, 1L)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POSTFIELDS, data->buf)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_WRITEFUNCTION,
-					curl_write_cb)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_WRITEDATA,
-					&page_w[hist->value_type].page)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_FAILONERROR, 1L)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_ERRORBUFFER,
-					page_w[hist->value_type].errbuf)))
+		/* If the error is due to elastic internal problems (for example an index */
+		/* became read-only), we put the request in a retry list */
+		zbx_vector_ptr_append(&writer.requests_retry, request);
+		return;
+	}
+
+	elastic_request_reset(request);
+	zbx_vector_ptr_append(&writer.requests_idle, request);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_writer_process                                                 *
+ *                                                                                  *
+ * Purpose: advances the running bulk requests and processes the completed ones     *
+ *                                                                                  *
+ * Parameters: timeout - [IN] the maximum time to wait for network activity, in     *
+ *                            milliseconds                                          *
+ *                                                                                  *
+ * Return value: SUCCEED - the requests were processed                              *
+ *               FAIL    - cURL multi handle failed, the running requests were      *
+ *                         discarded                                                *
+ *                                                                                  *
+ ************************************************************************************/
+static int	elastic_writer_process(int timeout)
+{
+	int			running, fds, msgnum, i;
+	CURLMcode		code;
+	CURLMsg			*msg;
+	zbx_elastic_request_t	*request;
+
+	if (CURLM_OK != (code = curl_multi_perform(writer.handle, &running)))
 	{
-		zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)opt, curl_easy_strerror(err));
-		goto out;
+		zabbix_log(LOG_LEVEL_ERR, "cannot perform on curl multi handle: %s", curl_multi_strerror(code));
+		goto fail;
+	}
+
+	if (running == writer.requests_running.values_num && 0 != timeout)
+	{
+		if (CURLM_OK != (code = curl_multi_wait(writer.handle, NULL, 0, timeout, &fds)))
+		{
+			zabbix_log(LOG_LEVEL_ERR, "cannot wait on curl multi handle: %s", curl_multi_strerror(code));
+			goto fail;
+		}
+
+		if (CURLM_OK != (code = curl_multi_perform(writer.handle, &running)))
+		{
+			zabbix_log(LOG_LEVEL_ERR, "cannot perform on curl multi handle: %s", curl_multi_strerror(code));
+			goto fail;
+		}
 	}
 
-	*page_w[hist->value_type].errbuf = '\0';
+	while (NULL != (msg = curl_multi_info_read(writer.handle, &msgnum)))
+	{
+		if (CURLMSG_DONE != msg->msg)
+			continue;
+
+		if (CURLE_OK != curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&request))
+			continue;
+
+		curl_multi_remove_handle(writer.handle, request->handle);
+
+		if (FAIL != (i = zbx_vector_ptr_search(&writer.requests_running, request,
+				ZBX_DEFAULT_PTR_COMPARE_FUNC)))
+		{
+			zbx_vector_ptr_remove_noorder(&writer.requests_running, i);
+		}
+
+		elastic_writer_complete(request, msg->data.result);
+	}
 
-	if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_PRIVATE, &page_w[hist->value_type])))
+	return SUCCEED;
+fail:
+	for (i = 0; i < writer.requests_running.values_num; i++)
+	{
+		request = (zbx_elastic_request_t *)writer.requests_running.values[i];
+
+		curl_multi_remove_handle(writer.handle, request->handle);
+		elastic_request_reset(request);
+		zbx_vector_ptr_append(&writer.requests_idle, request);
+	}
+
+	zbx_vector_ptr_clear(&writer.requests_running);
+
+	return FAIL;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_writer_send                                                    *
+ *                                                                                  *
+ * Purpose: starts sending bulk request without waiting for response                *
+ *                                                                                  *
+ * Parameters: request - [IN] the request to send                                   *
+ *                                                                                  *
+ ************************************************************************************/
+static void	elastic_writer_send(zbx_elastic_request_t *request)
+{
+	CURLoption	opt;
+	CURLcode	err;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "sending %d values", request->values_num);
+	zabbix_log(LOG_LEVEL_TRACE, "sending %s", request->body.data);
+
+	if (CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_POSTFIELDS, request->body.data)) ||
+			CURLE_OK != (err = curl_easy_setopt(request->handle, opt = CURLOPT_POSTFIELDSIZE,
+					(long)request->body.offset)))
 	{
 		zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)opt, curl_easy_strerror(err));
-		goto out;
+		elastic_request_reset(request);
+		zbx_vector_ptr_append(&writer.requests_idle, request);
+		return;
 	}
 
-	page_w[hist->value_type].page.offset = 0;
+	*request->errbuf = '\0';
+	request->page.offset = 0;
 
-	if (0 < page_w[hist->value_type].page.alloc)
-		*page_w[hist->value_type].page.data = '\0';
+	if (0 < request->page.alloc)
+		*request->page.data = '\0';
 
-	curl_multi_add_handle(writer.handle, data->handle);
+	curl_multi_add_handle(writer.handle, request->handle);
+	zbx_vector_ptr_append(&writer.requests_running, request);
 
-	zbx_vector_ptr_append(&writer.ifaces, hist);
+	/* start the transfer */
+	(void)elastic_writer_process(0);
+}
 
-	return;
-out:
-	elastic_close(hist);
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_writer_get_request                                             *
+ *                                                                                  *
+ * Purpose: gets bulk request to add history values to                              *
+ *                                                                                  *
+ * Return value: the request or NULL if cURL handle cannot be initialized           *
+ *                                                                                  *
+ * Comments: When HistoryStorageConcurrency requests are already being sent this    *
+ *           function waits until one of them completes, so the history syncer      *
+ *           does not build up bulk requests faster than storage can accept them.   *
+ *                                                                                  *
+ ************************************************************************************/
+static zbx_elastic_request_t	*elastic_writer_get_request(void)
+{
+	if (NULL != writer.request)
+		return writer.request;
+
+	while (0 == writer.requests_idle.values_num &&
+			CONFIG_HISTORY_STORAGE_CONCURRENCY <= writer.requests_running.values_num)
+	{
+		(void)elastic_writer_process(ZBX_HISTORY_STORAGE_DOWN);
+	}
+
+	if (0 != writer.requests_idle.values_num)
+	{
+		writer.request = (zbx_elastic_request_t *)writer.requests_idle.values[writer.requests_idle.values_num - 1];
+		zbx_vector_ptr_remove_noorder(&writer.requests_idle, writer.requests_idle.values_num - 1);
+	}
+	else
+		writer.request = elastic_request_create();
+
+	return writer.request;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_writer_add_value                                               *
+ *                                                                                  *
+ * Purpose: adds history value to the current bulk request and sends the request    *
+ *          once it is full                                                         *
+ *                                                                                  *
+ * Parameters: index - [IN] the bulk action line                                    *
+ *             doc   - [IN] the history value document                              *
+ *                                                                                  *
+ * Return value: SUCCEED - the value was added                                      *
+ *               FAIL    - cURL handle cannot be initialized                        *
+ *                                                                                  *
+ ************************************************************************************/
+static int	elastic_writer_add_value(const char *index, const char *doc)
+{
+	zbx_elastic_request_t	*request;
+
+	if (NULL == (request = elastic_writer_get_request()))
+		return FAIL;
+
+	zbx_snprintf_alloc(&request->body.data, &request->body.alloc, &request->body.offset, "%s\n%s\n", index, doc);
+	request->values_num++;
+
+	if (ZBX_ELASTIC_BULK_SIZE <= request->body.offset)
+	{
+		writer.request = NULL;
+		elastic_writer_send(request);
+	}
+
+	return SUCCEED;
 }
 
 /************************************************************************************
@@ -435,159 +788,60 @@ out:
  *                                                                                  *
  * Purpose: posts historical data to elastic storage                                *
  *                                                                                  *
+ * Comments: Sends the current bulk request and waits until all requests are sent,  *
+ *           retrying failed requests until they succeed.                           *
+ *                                                                                  *
  ************************************************************************************/
 static int	elastic_writer_flush(void)
 {
-	struct curl_slist	*curl_headers = NULL;
-	int			i, running, previous, msgnum;
-	CURLMsg			*msg;
 	zbx_vector_ptr_t	retries;
-	CURLcode		err;
-	int			ret = SUCCEED;
+	int			i, ret = SUCCEED;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	/* The writer might be uninitialized only if the history */
-	/* was already flushed. In that case, return SUCCEED */
+	/* The writer might be uninitialized only if no history */
+	/* was added yet. In that case, return SUCCEED */
 	if (0 == writer.initialized)
 		goto end;
 
-	zbx_vector_ptr_create(&retries);
-
-	curl_headers = curl_slist_append(curl_headers, "Content-Type: application/x-ndjson");
-
-	for (i = 0; i < writer.ifaces.values_num; i++)
+	if (NULL != writer.request)
 	{
-		zbx_history_iface_t	*hist = (zbx_history_iface_t *)writer.ifaces.values[i];
-		zbx_elastic_data_t	*data = (zbx_elastic_data_t *)hist->data;
+		zbx_elastic_request_t	*request = writer.request;
 
-		if (CURLE_OK != (err = curl_easy_setopt(data->handle, CURLOPT_HTTPHEADER, curl_headers)))
-		{
-			zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)CURLOPT_HTTPHEADER,
-					curl_easy_strerror(err));
-			ret = FAIL;
-			goto clean;
-		}
-
-		zabbix_log(LOG_LEVEL_DEBUG, "sending %s", data->buf);
+		writer.request = NULL;
+		elastic_writer_send(request);
 	}
 
-try_again:
-	previous = 0;
+	zbx_vector_ptr_create(&retries);
 
-	do
+	for (;;)
 	{
-		int		fds;
-		CURLMcode	code;
-		char		*error;
-		zbx_curlpage_t	*curl_page;
-
-		if (CURLM_OK != (code = curl_multi_perform(writer.handle, &running)))
+		while (0 != writer.requests_running.values_num)
 		{
-			zabbix_log(LOG_LEVEL_ERR, "cannot perform on curl multi handle: %s", curl_multi_strerror(code));
-			break;
+			if (SUCCEED != elastic_writer_process(ZBX_HISTORY_STORAGE_DOWN))
+			{
+				ret = FAIL;
+				break;
+			}
 		}
 
-		if (CURLM_OK != (code = curl_multi_wait(writer.handle, NULL, 0, ZBX_HISTORY_STORAGE_DOWN, &fds)))
-		{
-			zabbix_log(LOG_LEVEL_ERR, "cannot wait on curl multi handle: %s", curl_multi_strerror(code));
+		if (0 == writer.requests_retry.values_num)
 			break;
-		}
 
-		if (previous == running)
-			continue;
-
-		while (NULL != (msg = curl_multi_info_read(writer.handle, &msgnum)))
-		{
-			/* If the error is due to malformed data, there is no sense on re-trying to send. */
-			/* That's why we actually check for transport and curl errors separately */
-			if (CURLE_HTTP_RETURNED_ERROR == msg->data.result)
-			{
-				if (CURLE_OK == curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
-						(char **)&curl_page) && '\0' != *curl_page->errbuf)
-				{
-					zabbix_log(LOG_LEVEL_ERR, "cannot send data to elasticsearch, HTTP error"
-							" message: %s", curl_page->errbuf);
-				}
-				else
-				{
-					char		http_status[MAX_STRING_LEN];
-					long int	response_code;
-
-					if (CURLE_OK == curl_easy_getinfo(msg->easy_handle,
-							CURLINFO_RESPONSE_CODE, &response_code))
-					{
-						zbx_snprintf(http_status, sizeof(http_status), "HTTP status code: %ld",
-								response_code);
-					}
-					else
-					{
-						zbx_strlcpy(http_status, "unknown HTTP status code",
-								sizeof(http_status));
-					}
-
-					zabbix_log(LOG_LEVEL_ERR, "cannot send data to elasticsearch, %s", http_status);
-				}
-			}
-			else if (CURLE_OK != msg->data.result)
-			{
-				if (CURLE_OK == curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
-						(char **)&curl_page) && '\0' != *curl_page->errbuf)
-				{
-					zabbix_log(LOG_LEVEL_WARNING, "cannot send data to elasticsearch: %s",
-							curl_page->errbuf);
-				}
-				else
-				{
-					zabbix_log(LOG_LEVEL_WARNING, "cannot send data to elasticsearch: %s",
-							curl_easy_strerror(msg->data.result));
-				}
-
-				/* If the error is due to curl internal problems or unrelated */
-				/* problems with HTTP, we put the handle in a retry list and */
-				/* remove it from the current execution loop */
-				zbx_vector_ptr_append(&retries, msg->easy_handle);
-				curl_multi_remove_handle(writer.handle, msg->easy_handle);
-			}
-			else if (CURLE_OK == curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&curl_page)
-					&& SUCCEED == elastic_is_error_present(&curl_page->page, &error))
-			{
-				zabbix_log(LOG_LEVEL_WARNING, "%s() cannot send data to elasticsearch: %s",
-						__func__, error);
-				zbx_free(error);
-
-				/* If the error is due to elastic internal problems (for example an index */
-				/* became read-only), we put the handle in a retry list and */
-				/* remove it from the current execution loop */
-				zbx_vector_ptr_append(&retries, msg->easy_handle);
-				curl_multi_remove_handle(writer.handle, msg->easy_handle);
-			}
-		}
+		/* We have requests to retry, so we send them again */
+		/* after sleeping for ZBX_HISTORY_STORAGE_DOWN / 1000 (seconds) */
+		sleep(ZBX_HISTORY_STORAGE_DOWN / 1000);
 
-		previous = running;
-	}
-	while (running);
+		zbx_vector_ptr_append_array(&retries, writer.requests_retry.values, writer.requests_retry.values_num);
+		zbx_vector_ptr_clear(&writer.requests_retry);
 
-	/* We check if we have handles to retry. If yes, we put them back in the multi */
-	/* handle and go to the beginning of the do while() for try sending the data again */
-	/* after sleeping for ZBX_HISTORY_STORAGE_DOWN / 1000 (seconds) */
-	if (0 < retries.values_num)
-	{
 		for (i = 0; i < retries.values_num; i++)
-			curl_multi_add_handle(writer.handle, retries.values[i]);
+			elastic_writer_send((zbx_elastic_request_t *)retries.values[i]);
 
 		zbx_vector_ptr_clear(&retries);
-
-		sleep(ZBX_HISTORY_STORAGE_DOWN / 1000);
-		goto try_again;
 	}
-clean:
-	curl_slist_free_all(curl_headers);
 
 	zbx_vector_ptr_destroy(&retries);
-
-	elastic_writer_release();
-
 end:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 
@@ -614,11 +868,162 @@ static void	elastic_destroy(zbx_history_iface_t *hist)
 	zbx_elastic_data_t	*data = (zbx_elastic_data_t *)hist->data;
 
 	elastic_close(hist);
+	elastic_writer_release();
 
 	zbx_free(data->base_url);
 	zbx_free(data);
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_query                                                          *
+ *                                                                                  *
+ * Purpose: sends request to the history storage using the read handle             *
+ *                                                                                  *
+ * Parameters:  data    - [IN] the history storage data                             *
+ *              url     - [IN] the request url                                      *
+ *              method  - [IN] the custom request method, NULL for POST             *
+ *              body    - [IN] the request body                                     *
+ *              errbuf  - [OUT] the cURL error buffer set for the read handle       *
+ *                                                                                  *
+ * Return value: SUCCEED - the request was sent and the response is in page_r       *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ ************************************************************************************/
+static int	elastic_query(zbx_elastic_data_t *data, const char *url, const char *method, const char *body,
+		char *errbuf)
+{
+	CURLcode	err;
+	CURLoption	opt;
+
+	if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_URL, url)) ||
+			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_CUSTOMREQUEST, method)) ||
+			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POSTFIELDS, body)))
+	{
+		zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)opt, curl_easy_strerror(err));
+		return FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "sending query to %s; post data: %s", url, body);
+
+	page_r.offset = 0;
+	*errbuf = '\0';
+	if (CURLE_OK != (err = curl_easy_perform(data->handle)))
+	{
+		elastic_log_error(data->handle, err, errbuf);
+		return FAIL;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "received from elasticsearch: %s", page_r.data);
+
+	return SUCCEED;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_open_pit                                                       *
+ *                                                                                  *
+ * Purpose: opens point in time of the value type indices, so that paged search     *
+ *          sees the same documents on every page                                   *
+ *                                                                                  *
+ * Parameters:  data       - [IN] the history storage data                          *
+ *              value_type - [IN] the value type                                    *
+ *              errbuf     - [OUT] the cURL error buffer set for the read handle    *
+ *                                                                                  *
+ * Return value: the point in time id or NULL on failure                            *
+ *                                                                                  *
+ ************************************************************************************/
+static char	*elastic_open_pit(zbx_elastic_data_t *data, unsigned char value_type, char *errbuf)
+{
+	struct zbx_json_parse	jp;
+	char			*url, *pit_id = NULL;
+	size_t			pit_id_alloc = 0;
+
+	url = zbx_dsprintf(NULL, "%s/%s*/_pit?keep_alive=%s", data->base_url, value_type_str[value_type],
+			ZBX_ELASTIC_PIT_KEEP_ALIVE);
+
+	if (SUCCEED == elastic_query(data, url, NULL, "", errbuf) &&
+			(SUCCEED != zbx_json_open(page_r.data, &jp) ||
+			SUCCEED != zbx_json_value_by_name_dyn(&jp, "id", &pit_id, &pit_id_alloc, NULL)))
+	{
+		zabbix_log(LOG_LEVEL_ERR, "cannot open point in time of elasticsearch indices: %s", page_r.data);
+		zbx_free(pit_id);
+	}
+
+	zbx_free(url);
+
+	return pit_id;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_close_pit                                                      *
+ *                                                                                  *
+ * Purpose: closes point in time opened by elastic_open_pit()                       *
+ *                                                                                  *
+ * Parameters:  data   - [IN] the history storage data                              *
+ *              pit_id - [IN] the point in time id                                  *
+ *              errbuf - [OUT] the cURL error buffer set for the read handle        *
+ *                                                                                  *
+ * Comments: Point in time that failed to close expires after its keep alive        *
+ *           period.                                                                *
+ *                                                                                  *
+ ************************************************************************************/
+static void	elastic_close_pit(zbx_elastic_data_t *data, const char *pit_id, char *errbuf)
+{
+	struct zbx_json	json;
+	char		*url;
+
+	url = zbx_dsprintf(NULL, "%s/_pit", data->base_url);
+
+	zbx_json_init(&json, ZBX_JSON_STAT_BUF_LEN);
+	zbx_json_addstring(&json, "id", pit_id, ZBX_JSON_TYPE_STRING);
+	zbx_json_close(&json);
+
+	(void)elastic_query(data, url, "DELETE", json.buffer, errbuf);
+
+	zbx_json_free(&json);
+	zbx_free(url);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: elastic_search_after_ties                                              *
+ *                                                                                  *
+ * Purpose: changes clock, ns search_after values so that the next search starts    *
+ *          with the values sharing them                                            *
+ *                                                                                  *
+ * Parameters:  search_after - [IN/OUT] the sort values of the last returned hit    *
+ *              after_alloc  - [IN/OUT] the search_after buffer size                *
+ *                                                                                  *
+ * Return value: SUCCEED - the search_after values were changed                     *
+ *               FAIL - the sort values cannot be parsed                            *
+ *                                                                                  *
+ * Comments: Values are sorted in descending order, so the values following ns + 1  *
+ *           include all values sharing clock and ns with the last hit.             *
+ *                                                                                  *
+ ************************************************************************************/
+static int	elastic_search_after_ties(char **search_after, size_t *after_alloc)
+{
+	struct zbx_json_parse	jp;
+	const char		*p;
+	char			clock[MAX_ID_LEN + 1], ns[MAX_ID_LEN + 1];
+	size_t			after_offset = 0;
+	zbx_uint64_t		ns_num;
+
+	if (SUCCEED != zbx_json_brackets_open(*search_after, &jp) ||
+			NULL == (p = zbx_json_next_value(&jp, NULL, clock, sizeof(clock), NULL)) ||
+			NULL == zbx_json_next_value(&jp, p, ns, sizeof(ns), NULL) || SUCCEED != is_uint64(ns, &ns_num))
+	{
+		zabbix_log(LOG_LEVEL_ERR, "cannot parse elasticsearch sort values: %s", *search_after);
+		return FAIL;
+	}
+
+	zbx_snprintf_alloc(search_after, after_alloc, &after_offset, "[%s," ZBX_FS_UI64 "]", clock, ns_num + 1);
+
+	return SUCCEED;
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: elastic_get_values                                                     *
@@ -637,81 +1042,60 @@ static void	elastic_destroy(zbx_history_iface_t *hist)
  *                                                                                  *
  * Comments: This function reads <count> values from ]<start>,<end>] interval or    *
  *           all values from the specified interval if count is zero.               *
+ *           The values are paged with search_after. Values of the same item can    *
+ *           share clock and ns. Starting with Elasticsearch 7.12 the search is     *
+ *           done in a point in time and the sort order ends with _shard_doc, which *
+ *           is unique within a point in time. Older versions have no unique sort   *
+ *           field, so each page starts with the values sharing the last clock and  *
+ *           ns of the previous page and skips the ones already returned. The order *
+ *           of such values is kept only while the indices do not change.           *
+ *           The response is limited to the returned hit fields. Numeric values are *
+ *           read from doc value fields instead of document source.                 *
  *                                                                                  *
  ************************************************************************************/
 static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, int start, int count, int end,
 		zbx_vector_history_record_t *values)
 {
 	zbx_elastic_data_t	*data = (zbx_elastic_data_t *)hist->data;
-	size_t			url_alloc = 0, url_offset = 0, id_alloc = 0, scroll_alloc = 0, scroll_offset = 0;
-	int			total, empty, ret;
+	size_t			after_alloc = 0, after_offset = 0, pit_alloc = 0, len;
+	int			total, size, hits, docvalues, pit, ties, skip = 0, ret = FAIL;
 	CURLcode		err;
 	struct zbx_json		query;
 	struct curl_slist	*curl_headers = NULL;
-	char			*scroll_id = NULL, *scroll_query = NULL, errbuf[CURL_ERROR_SIZE];
+	char			*search_after = NULL, *pit_id = NULL, errbuf[CURL_ERROR_SIZE];
 	CURLoption		opt;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	ret = FAIL;
-
-	if (NULL == (data->handle = curl_easy_init()))
+	/* the handle is kept between queries to reuse the connection */
+	if (NULL == data->handle && NULL == (data->handle = curl_easy_init()))
 	{
 		zabbix_log(LOG_LEVEL_ERR, "cannot initialize cURL session");
 
 		return FAIL;
 	}
 
-	zbx_snprintf_alloc(&data->post_url, &url_alloc, &url_offset, "%s/%s*/_search?scroll=10s", data->base_url,
-			value_type_str[hist->value_type]);
+	/* only numeric values are stored in fields having doc values */
+	docvalues = (ITEM_VALUE_TYPE_FLOAT == hist->value_type || ITEM_VALUE_TYPE_UINT64 == hist->value_type);
 
-	/* prepare the json query for elasticsearch, apply ranges if needed */
-	zbx_json_init(&query, ZBX_JSON_ALLOCATE);
+	pit = (ZBX_ELASTIC_PIT_MIN_VERSION <= ZBX_ELASTIC_SVERSION);
 
-	if (0 < count)
+	/* search in point in time must not specify indices */
+	if (0 != pit)
 	{
-		zbx_json_adduint64(&query, "size", count);
-		zbx_json_addarray(&query, "sort");
-		zbx_json_addobject(&query, NULL);
-		zbx_json_addobject(&query, "clock");
-		zbx_json_addstring(&query, "order", "desc", ZBX_JSON_TYPE_STRING);
-		zbx_json_close(&query);
-		zbx_json_close(&query);
-		zbx_json_close(&query);
+		data->post_url = zbx_dsprintf(data->post_url, "%s/_search?filter_path=pit_id,hits.hits.sort,"
+				"hits.hits.%s", data->base_url, 0 != docvalues ? "fields" : "_source");
+	}
+	else
+	{
+		data->post_url = zbx_dsprintf(data->post_url, "%s/%s*/_search?filter_path=hits.hits.sort,"
+				"hits.hits.%s", data->base_url, value_type_str[hist->value_type],
+				0 != docvalues ? "fields" : "_source");
 	}
-
-	zbx_json_addobject(&query, "query");
-	zbx_json_addobject(&query, "bool");
-	zbx_json_addarray(&query, "must");
-	zbx_json_addobject(&query, NULL);
-	zbx_json_addobject(&query, "match");
-	zbx_json_adduint64(&query, "itemid", itemid);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_addarray(&query, "filter");
-	zbx_json_addobject(&query, NULL);
-	zbx_json_addobject(&query, "range");
-	zbx_json_addobject(&query, "clock");
-
-	if (0 < start)
-		zbx_json_adduint64(&query, "gt", start);
-
-	if (0 < end)
-		zbx_json_adduint64(&query, "lte", end);
-
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
-	zbx_json_close(&query);
 
 	curl_headers = curl_slist_append(curl_headers, "Content-Type: application/json");
 
-	if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_URL, data->post_url)) ||
-			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POSTFIELDS, query.buffer)) ||
+	if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POST, 1L)) ||
 			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_WRITEFUNCTION,
 					curl_write_cb)) ||
 			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_WRITEDATA, &page_r)) ||
@@ -720,145 +1104,200 @@ static int	elastic_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, in
 			CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_ERRORBUFFER, errbuf)))
 	{
 		zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)opt, curl_easy_strerror(err));
-		goto out;
-	}
-
-	zabbix_log(LOG_LEVEL_DEBUG, "sending query to %s; post data: %s", data->post_url, query.buffer);
+		curl_slist_free_all(curl_headers);
 
-	page_r.offset = 0;
-	*errbuf = '\0';
-	if (CURLE_OK != (err = curl_easy_perform(data->handle)))
-	{
-		elastic_log_error(data->handle, err, errbuf);
-		goto out;
+		return FAIL;
 	}
 
-	url_offset = 0;
-	zbx_snprintf_alloc(&data->post_url, &url_alloc, &url_offset, "%s/_search/scroll", data->base_url);
+	zbx_json_init(&query, ZBX_JSON_ALLOCATE);
 
-	if (CURLE_OK != (err = curl_easy_setopt(data->handle, CURLOPT_URL, data->post_url)))
-	{
-		zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)CURLOPT_URL,
-				curl_easy_strerror(err));
+	if (0 != pit && NULL == (pit_id = elastic_open_pit(data, hist->value_type, errbuf)))
 		goto out;
-	}
 
 	total = (0 == count ? -1 : count);
 
-	/* For processing the records, we need to keep track of the total requested and if the response from the */
-	/* elasticsearch server is empty. For this we use two variables, empty and total. If the result is empty or */
-	/* the total reach zero, we terminate the scrolling query and return what we currently have. */
+	/* For processing the records, we need to keep track of the total requested and the number of hits */
+	/* returned by the last search. If the page is not full or the total reach zero, we terminate the   */
+	/* search and return what we currently have.                                                        */
 	do
 	{
-		struct zbx_json_parse	jp, jp_values, jp_item, jp_sub, jp_hits, jp_source;
+		struct zbx_json_parse	jp, jp_values, jp_item, jp_sub, jp_hits, jp_fields, jp_sort;
 		zbx_history_record_t	hr;
 		const char		*p = NULL;
 
-		empty = 1;
+		size = (-1 == total || ZBX_ELASTIC_SEARCH_SIZE < total ? ZBX_ELASTIC_SEARCH_SIZE : total);
 
-		zabbix_log(LOG_LEVEL_DEBUG, "received from elasticsearch: %s", page_r.data);
+		/* the values already returned by the previous search are read again and skipped */
+		size += skip;
 
-		zbx_json_open(page_r.data, &jp);
-		zbx_json_brackets_open(jp.start, &jp_values);
+		/* prepare the json query for elasticsearch, apply ranges if needed */
+		zbx_json_clean(&query);
 
-		/* get the scroll id immediately, for being used in subsequent queries */
-		if (SUCCEED != zbx_json_value_by_name_dyn(&jp_values, "_scroll_id", &scroll_id, &id_alloc, NULL))
+		zbx_json_adduint64(&query, "size", size);
+
+		if (0 != pit)
 		{
-			zabbix_log(LOG_LEVEL_WARNING, "elasticsearch version is not compatible with zabbix server. "
-					"_scroll_id tag is absent");
+			zbx_json_addobject(&query, "pit");
+			zbx_json_addstring(&query, "id", pit_id, ZBX_JSON_TYPE_STRING);
+			zbx_json_addstring(&query, "keep_alive", ZBX_ELASTIC_PIT_KEEP_ALIVE, ZBX_JSON_TYPE_STRING);
+			zbx_json_close(&query);
 		}
 
-		zbx_json_brackets_by_name(&jp_values, "hits", &jp_sub);
-		zbx_json_brackets_by_name(&jp_sub, "hits", &jp_hits);
+		zbx_json_addarray(&query, "sort");
+		zbx_json_addobject(&query, NULL);
+		zbx_json_addstring(&query, "clock", "desc", ZBX_JSON_TYPE_STRING);
+		zbx_json_close(&query);
+		zbx_json_addobject(&query, NULL);
+		zbx_json_addstring(&query, "ns", "desc", ZBX_JSON_TYPE_STRING);
+		zbx_json_close(&query);
 
-		while (NULL != (p = zbx_json_next(&jp_hits, p)))
+		if (0 != pit)
 		{
-			empty = 0;
+			zbx_json_addobject(&query, NULL);
+			zbx_json_addstring(&query, "_shard_doc", "desc", ZBX_JSON_TYPE_STRING);
+			zbx_json_close(&query);
+		}
 
-			if (SUCCEED != zbx_json_brackets_open(p, &jp_item))
-				continue;
+		zbx_json_close(&query);
 
-			if (SUCCEED != zbx_json_brackets_by_name(&jp_item, "_source", &jp_source))
-				continue;
+		if (0 != docvalues)
+		{
+			zbx_json_addraw(&query, "_source", "false");
+			zbx_json_addarray(&query, "docvalue_fields");
+			zbx_json_addobject(&query, NULL);
+			zbx_json_addstring(&query, "field", "clock", ZBX_JSON_TYPE_STRING);
+			zbx_json_addstring(&query, "format", "epoch_second", ZBX_JSON_TYPE_STRING);
+			zbx_json_close(&query);
+			zbx_json_addstring(&query, NULL, "ns", ZBX_JSON_TYPE_STRING);
+			zbx_json_addstring(&query, NULL, "value", ZBX_JSON_TYPE_STRING);
+			zbx_json_close(&query);
+		}
 
-			if (SUCCEED != history_parse_value(&jp_source, hist->value_type, &hr))
-				continue;
+		if (NULL != search_after)
+			zbx_json_addraw(&query, "search_after", search_after);
 
-			zbx_vector_history_record_append_ptr(values, &hr);
+		zbx_json_addobject(&query, "query");
+		zbx_json_addobject(&query, "bool");
+		zbx_json_addarray(&query, "must");
+		zbx_json_addobject(&query, NULL);
+		zbx_json_addobject(&query, "match");
+		zbx_json_adduint64(&query, "itemid", itemid);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_addarray(&query, "filter");
+		zbx_json_addobject(&query, NULL);
+		zbx_json_addobject(&query, "range");
+		zbx_json_addobject(&query, "clock");
 
-			if (-1 != total)
-				--total;
+		if (0 < start)
+			zbx_json_adduint64(&query, "gt", start);
 
-			if (0 == total)
-			{
-				empty = 1;
-				break;
-			}
-		}
+		if (0 < end)
+			zbx_json_adduint64(&query, "lte", end);
 
-		if (1 == empty)
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+		zbx_json_close(&query);
+
+		if (SUCCEED != elastic_query(data, data->post_url, NULL, query.buffer, errbuf))
+			goto out;
+
+		hits = 0;
+		ties = 0;
+
+		if (SUCCEED != zbx_json_open(page_r.data, &jp) ||
+				SUCCEED != zbx_json_brackets_open(jp.start, &jp_values))
 		{
-			ret = SUCCEED;
 			break;
 		}
 
-		/* scroll to the next page */
-		scroll_offset = 0;
-		zbx_snprintf_alloc(&scroll_query, &scroll_alloc, &scroll_offset,
-				"{\"scroll\":\"10s\",\"scroll_id\":\"%s\"}\n", ZBX_NULL2EMPTY_STR(scroll_id));
+		/* point in time id can change between searches, the latest one must be used */
+		if (0 != pit)
+			(void)zbx_json_value_by_name_dyn(&jp_values, "pit_id", &pit_id, &pit_alloc, NULL);
 
-		if (CURLE_OK != (err = curl_easy_setopt(data->handle, CURLOPT_POSTFIELDS, scroll_query)))
+		/* filtered response of search without hits has no hits object */
+		if (SUCCEED != zbx_json_brackets_by_name(&jp_values, "hits", &jp_sub) ||
+				SUCCEED != zbx_json_brackets_by_name(&jp_sub, "hits", &jp_hits))
 		{
-			zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)CURLOPT_POSTFIELDS,
-					curl_easy_strerror(err));
 			break;
 		}
 
-		page_r.offset = 0;
-		*errbuf = '\0';
-		if (CURLE_OK != (err = curl_easy_perform(data->handle)))
+		while (NULL != (p = zbx_json_next(&jp_hits, p)))
 		{
-			elastic_log_error(data->handle, err, errbuf);
-			break;
-		}
-	}
-	while (0 == empty);
+			hits++;
 
-	/* as recommended by the elasticsearch documentation, we close the scroll search through a DELETE request */
-	if (NULL != scroll_id)
-	{
-		url_offset = 0;
-		zbx_snprintf_alloc(&data->post_url, &url_alloc, &url_offset, "%s/_search/scroll/%s", data->base_url,
-				scroll_id);
+			if (SUCCEED != zbx_json_brackets_open(p, &jp_item))
+				continue;
 
-		if (CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_URL, data->post_url)) ||
-				CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_POSTFIELDS, "")) ||
-				CURLE_OK != (err = curl_easy_setopt(data->handle, opt = CURLOPT_CUSTOMREQUEST, "DELETE")))
-		{
-			zabbix_log(LOG_LEVEL_ERR, "cannot set cURL option %d: [%s]", (int)opt,
-					curl_easy_strerror(err));
-			ret = FAIL;
-			goto out;
+			/* remember sort values of the last hit to continue the search after it */
+			if (SUCCEED == zbx_json_brackets_by_name(&jp_item, "sort", &jp_sort))
+			{
+				len = (size_t)(jp_sort.end - jp_sort.start + 1);
+
+				/* count the hits sharing the last sort values, including the skipped ones */
+				if (0 != ties && len == after_offset && 0 == memcmp(search_after, jp_sort.start, len))
+					ties++;
+				else
+					ties = 1;
+
+				after_offset = 0;
+				zbx_strncpy_alloc(&search_after, &after_alloc, &after_offset, jp_sort.start, len);
+			}
+
+			if (hits <= skip)
+				continue;
+
+			if (SUCCEED != zbx_json_brackets_by_name(&jp_item, 0 != docvalues ? "fields" : "_source",
+					&jp_fields))
+			{
+				continue;
+			}
+
+			if (0 != docvalues)
+			{
+				if (SUCCEED != history_parse_docvalues(&jp_fields, hist->value_type, &hr))
+					continue;
+			}
+			else if (SUCCEED != history_parse_value(&jp_fields, hist->value_type, &hr))
+				continue;
+
+			zbx_vector_history_record_append_ptr(values, &hr);
+
+			if (-1 != total)
+				--total;
 		}
 
+		if (NULL == search_after)
+			break;
 
-		zabbix_log(LOG_LEVEL_DEBUG, "elasticsearch closing scroll %s", data->post_url);
+		if (0 == pit)
+		{
+			if (SUCCEED != elastic_search_after_ties(&search_after, &after_alloc))
+				break;
 
-		page_r.offset = 0;
-		*errbuf = '\0';
-		if (CURLE_OK != (err = curl_easy_perform(data->handle)))
-			elastic_log_error(data->handle, err, errbuf);
+			skip = ties;
+		}
 	}
+	while (hits == size && 0 != total);
 
+	ret = SUCCEED;
 out:
-	elastic_close(hist);
+	if (NULL != pit_id)
+	{
+		elastic_close_pit(data, pit_id, errbuf);
+		zbx_free(pit_id);
+	}
 
 	curl_slist_free_all(curl_headers);
 
 	zbx_json_free(&query);
 
-	zbx_free(scroll_id);
-	zbx_free(scroll_query);
+	zbx_free(search_after);
 
 	zbx_vector_history_record_sort(values, (zbx_compare_func_t)zbx_history_record_compare_desc_func);
 
@@ -876,6 +1315,9 @@ out:
  * Parameters:  hist    - [IN] the history storage interface                        *
  *              history - [IN] the history data vector (may have mixed value types) *
  *                                                                                  *
+ * Comments: The values are streamed by bulk requests of ZBX_ELASTIC_BULK_SIZE,     *
+ *           full requests are sent while the remaining values are being added.     *
+ *                                                                                  *
  ************************************************************************************/
 static int	elastic_add_values(zbx_history_iface_t *hist, const zbx_vector_ptr_t *history)
 {
@@ -883,11 +1325,12 @@ static int	elastic_add_values(zbx_history_iface_t *hist, const zbx_vector_ptr_t
 	int			i, num = 0;
 	ZBX_DC_HISTORY		*h;
 	struct zbx_json		json_idx, json;
-	size_t			buf_alloc = 0, buf_offset = 0;
 	char			pipeline[14]; /* index name length + suffix "-pipeline" */
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
+	elastic_writer_init(data->base_url);
+
 	zbx_json_init(&json_idx, ZBX_IDX_JSON_ALLOCATE);
 
 	zbx_json_addobject(&json_idx, "index");
@@ -902,6 +1345,8 @@ static int	elastic_add_values(zbx_history_iface_t *hist, const zbx_vector_ptr_t
 	zbx_json_close(&json_idx);
 	zbx_json_close(&json_idx);
 
+	zbx_json_init(&json, ZBX_JSON_ALLOCATE);
+
 	for (i = 0; i < history->values_num; i++)
 	{
 		h = (ZBX_DC_HISTORY *)history->values[i];
@@ -909,7 +1354,7 @@ static int	elastic_add_values(zbx_history_iface_t *hist, const zbx_vector_ptr_t
 		if (hist->value_type != h->value_type)
 			continue;
 
-		zbx_json_init(&json, ZBX_JSON_ALLOCATE);
+		zbx_json_clean(&json);
 
 		zbx_json_adduint64(&json, "itemid", h->itemid);
 
@@ -933,19 +1378,13 @@ static int	elastic_add_values(zbx_history_iface_t *hist, const zbx_vector_ptr_t
 
 		zbx_json_close(&json);
 
-		zbx_snprintf_alloc(&data->buf, &buf_alloc, &buf_offset, "%s\n%s\n", json_idx.buffer, json.buffer);
-
-		zbx_json_free(&json);
+		if (SUCCEED != elastic_writer_add_value(json_idx.buffer, json.buffer))
+			break;
 
 		num++;
 	}
 
-	if (num > 0)
-	{
-		data->post_url = zbx_dsprintf(NULL, "%s/_bulk?refresh=true", data->base_url);
-		elastic_writer_add_iface(hist);
-	}
-
+	zbx_json_free(&json);
 	zbx_json_free(&json_idx);
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
@@ -1000,7 +1439,6 @@ int	zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type
 	memset(data, 0, sizeof(zbx_elastic_data_t));
 	data->base_url = zbx_strdup(NULL, CONFIG_HISTORY_STORAGE_URL);
 	zbx_rtrim(data->base_url, "/");
-	data->buf = NULL;
 	data->post_url = NULL;
 	data->handle = NULL;
 
@@ -1010,6 +1448,7 @@ int	zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type
 	hist->add_values = elastic_add_values;
 	hist->flush = elastic_flush;
 	hist->get_values = elastic_get_values;
+	hist->get_values_multi = NULL;
 	hist->requires_trends = 0;
 
 	return SUCCEED;
@@ -25,6 +25,11 @@
 #include "zbxhistory.h"
 #include "history.h"
 
+extern int	CONFIG_DOUBLE_PRECISION;
+
+/* the maximum number of items read by one history select */
+#define ZBX_HISTORY_SQL_BATCH_SIZE	1000
+
 typedef struct
 {
 	unsigned char		initialized;
@@ -205,6 +210,10 @@ static void	add_history_dbl(const zbx_vector_ptr_t *history)
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history", "itemid", "clock", "ns", "value", NULL);
 
+	/* values of old numeric type history tables are inserted as text */
+	if (ZBX_DB_DBL_PRECISION_ENABLED == CONFIG_DOUBLE_PRECISION)
+		zbx_db_insert_binary(db_insert);
+
 	for (i = 0; i < history->values_num; i++)
 	{
 		const ZBX_DC_HISTORY	*h = (ZBX_DC_HISTORY *)history->values[i];
@@ -230,6 +239,7 @@ static void	add_history_uint(zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_uint", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_binary(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -256,6 +266,7 @@ static void	add_history_str(zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_str", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_binary(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -282,6 +293,7 @@ static void	add_history_text(zbx_vector_ptr_t *history)
 
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_text", "itemid", "clock", "ns", "value", NULL);
+	zbx_db_insert_binary(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -309,6 +321,7 @@ static void	add_history_log(zbx_vector_ptr_t *history)
 	db_insert = (zbx_db_insert_t *)zbx_malloc(NULL, sizeof(zbx_db_insert_t));
 	zbx_db_insert_prepare(db_insert, "history_log", "itemid", "clock", "ns", "timestamp", "source", "severity",
 			"value", "logeventid", NULL);
+	zbx_db_insert_binary(db_insert);
 
 	for (i = 0; i < history->values_num; i++)
 	{
@@ -602,6 +615,206 @@ out:
 	return ret;
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: db_history_request_compare                                             *
+ *                                                                                  *
+ * Purpose: sorts history requests by period start and itemid                       *
+ *                                                                                  *
+ ************************************************************************************/
+static int	db_history_request_compare(const void *d1, const void *d2)
+{
+	const zbx_history_request_t	*r1 = *(const zbx_history_request_t * const *)d1;
+	const zbx_history_request_t	*r2 = *(const zbx_history_request_t * const *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(r1->start, r2->start);
+	ZBX_RETURN_IF_NOT_EQUAL(r1->itemid, r2->itemid);
+
+	return 0;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: db_history_request_compare_itemid                                      *
+ *                                                                                  *
+ * Purpose: sorts history requests by itemid                                        *
+ *                                                                                  *
+ ************************************************************************************/
+static int	db_history_request_compare_itemid(const void *d1, const void *d2)
+{
+	const zbx_history_request_t	*r1 = *(const zbx_history_request_t * const *)d1;
+	const zbx_history_request_t	*r2 = *(const zbx_history_request_t * const *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(r1->itemid, r2->itemid);
+
+	return 0;
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: db_history_request_span                                                *
+ *                                                                                  *
+ * Purpose: gets length of the requested period, open periods ending now            *
+ *                                                                                  *
+ ************************************************************************************/
+static zbx_uint64_t	db_history_request_span(int start, int end, int now)
+{
+	if (end > now)
+		end = now;
+
+	return (end > start ? (zbx_uint64_t)(end - start) : 1);
+}
+
+/************************************************************************************
+ *                                                                                  *
+ * Function: db_read_values_multi                                                   *
+ *                                                                                  *
+ * Purpose: reads history data of multiple items from database                      *
+ *                                                                                  *
+ * Parameters:  value_type - [IN] the value type (see ITEM_VALUE_TYPE_* defs)       *
+ *              requests   - [IN/OUT] the history requests                          *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ * Comments: Requests are read with one select per batch of up to                   *
+ *           ZBX_HISTORY_SQL_BATCH_SIZE items, covering the periods of all batch    *
+ *           requests. The values outside of the item request period are dropped.   *
+ *           Requests with close period starts are batched as long as the selected  *
+ *           periods are not more than twice as long as the requested periods in    *
+ *           total, so short periods are not read together with long ones.          *
+ *                                                                                  *
+ ************************************************************************************/
+static int	db_read_values_multi(int value_type, zbx_vector_ptr_t *requests)
+{
+	char			*sql = NULL;
+	size_t	 		sql_alloc = 0, sql_offset;
+	int			i, j, start, end, now, ret = SUCCEED;
+	zbx_uint64_t		span, span_total;
+	DB_RESULT		result;
+	DB_ROW			row;
+	zbx_vc_history_table_t	*table = &vc_history_tables[value_type];
+	zbx_vector_uint64_t	itemids;
+	zbx_vector_ptr_t	batch;
+
+	zbx_vector_uint64_create(&itemids);
+	zbx_vector_ptr_create(&batch);
+	zbx_vector_ptr_sort(requests, db_history_request_compare);
+
+	now = (int)time(NULL);
+
+	for (i = 0; i < requests->values_num; i = j)
+	{
+		zbx_history_request_t	*request = (zbx_history_request_t *)requests->values[i];
+
+		zbx_vector_uint64_clear(&itemids);
+		zbx_vector_ptr_clear(&batch);
+
+		start = request->start;
+		end = request->end;
+		span_total = db_history_request_span(request->start, request->end, now);
+		zbx_vector_ptr_append(&batch, request);
+
+		for (j = i + 1; j < requests->values_num && ZBX_HISTORY_SQL_BATCH_SIZE > j - i; j++)
+		{
+			zbx_history_request_t	*next = (zbx_history_request_t *)requests->values[j];
+			int			next_end;
+			zbx_uint64_t		next_span_total;
+
+			/* requests are sorted by period start, so only the period end can be extended */
+			next_end = MAX(end, next->end);
+			next_span_total = span_total + db_history_request_span(next->start, next->end, now);
+
+			span = db_history_request_span(start, next_end, now);
+
+			if (span * (zbx_uint64_t)(j - i + 1) > 2 * next_span_total)
+				break;
+
+			end = next_end;
+			span_total = next_span_total;
+			zbx_vector_ptr_append(&batch, next);
+		}
+
+		zbx_vector_ptr_sort(&batch, db_history_request_compare_itemid);
+
+		for (j = 0; j < batch.values_num; j++)
+			zbx_vector_uint64_append(&itemids, ((zbx_history_request_t *)batch.values[j])->itemid);
+
+		zbx_vector_uint64_uniq(&itemids, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+		sql_offset = 0;
+		zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "select itemid,clock,ns,%s from %s where",
+				table->fields, table->name);
+		DBadd_condition_alloc(&sql, &sql_alloc, &sql_offset, "itemid", itemids.values, itemids.values_num);
+
+		if (ZBX_JAN_2038 == end)
+		{
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, " and clock>%d", start);
+		}
+		else if (1 == end - start)
+		{
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, " and clock=%d", end);
+		}
+		else
+			zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, " and clock>%d and clock<=%d", start, end);
+
+		j = i + batch.values_num;
+
+		if (NULL == (result = DBselect("%s", sql)))
+		{
+			ret = FAIL;
+			break;
+		}
+
+		while (NULL != (row = DBfetch(result)))
+		{
+			zbx_history_request_t	request_local, *prequest = &request_local;
+			zbx_history_record_t	value;
+			int			index, k;
+
+			ZBX_STR2UINT64(request_local.itemid, row[0]);
+
+			if (FAIL == (index = zbx_vector_ptr_bsearch(&batch, prequest, db_history_request_compare_itemid)))
+			{
+				THIS_SHOULD_NEVER_HAPPEN;
+				continue;
+			}
+
+			value.timestamp.sec = atoi(row[1]);
+
+			/* the same item can have several requests with different periods */
+			while (0 < index && request_local.itemid ==
+					((zbx_history_request_t *)batch.values[index - 1])->itemid)
+			{
+				index--;
+			}
+
+			for (k = index; k < batch.values_num; k++)
+			{
+				zbx_history_request_t	*item_request = (zbx_history_request_t *)batch.values[k];
+
+				if (item_request->itemid != request_local.itemid)
+					break;
+
+				if (value.timestamp.sec <= item_request->start || value.timestamp.sec > item_request->end)
+					continue;
+
+				value.timestamp.ns = atoi(row[2]);
+				table->rtov(&value.value, row + 3);
+
+				zbx_vector_history_record_append_ptr(&item_request->values, &value);
+			}
+		}
+		DBfree_result(result);
+	}
+
+	zbx_free(sql);
+	zbx_vector_ptr_destroy(&batch);
+	zbx_vector_uint64_destroy(&itemids);
+
+	return ret;
+}
+
 /******************************************************************************************************************
  *                                                                                                                *
  * history interface support                                                                                      *
@@ -654,6 +867,24 @@ static int	sql_get_values(zbx_history_iface_t *hist, zbx_uint64_t itemid, int st
 	return db_read_values_by_time_and_count(itemid, hist->value_type, values, end - start, count, end);
 }
 
+/************************************************************************************
+ *                                                                                  *
+ * Function: sql_get_values_multi                                                   *
+ *                                                                                  *
+ * Purpose: gets history data of multiple items from history storage                *
+ *                                                                                  *
+ * Parameters:  hist     - [IN] the history storage interface                       *
+ *              requests - [IN/OUT] the history requests (zbx_history_request_t)    *
+ *                                                                                  *
+ * Return value: SUCCEED - the history data were read successfully                  *
+ *               FAIL - otherwise                                                   *
+ *                                                                                  *
+ ************************************************************************************/
+static int	sql_get_values_multi(zbx_history_iface_t *hist, zbx_vector_ptr_t *requests)
+{
+	return db_read_values_multi(hist->value_type, requests);
+}
+
 /************************************************************************************
  *                                                                                  *
  * Function: sql_add_values                                                         *
@@ -728,6 +959,7 @@ int	zbx_history_sql_init(zbx_history_iface_t *hist, unsigned char value_type, ch
 	hist->add_values = sql_add_values;
 	hist->flush = sql_flush;
 	hist->get_values = sql_get_values;
+	hist->get_values_multi = sql_get_values_multi;
 
 	switch (value_type)
 	{
@@ -20,6 +20,7 @@
 #include "common.h"
 #include "zbxjson.h"
 #include "json_parser.h"
+#include "json_scan.h"
 #include "json.h"
 #include "jsonpath.h"
 
@@ -538,10 +539,15 @@ static const char	*__zbx_json_rbracket(const char *p)
 
 	rbracket = ('{' == lbracket ? '}' : ']');
 
-	while ('\0' != *p)
+	while (1)
 	{
+		/* skip to the next character that can change state or level */
+		p = (0 == state ? json_scan_structural(p) : json_scan_quote(p));
+
 		switch (*p)
 		{
+			case '\0':
+				return NULL;
 			case '"':
 				state = (0 == state ? 1 : 0);
 				break;
@@ -567,8 +573,6 @@ static const char	*__zbx_json_rbracket(const char *p)
 		}
 		p++;
 	}
-
-	return NULL;
 }
 
 /******************************************************************************
@@ -644,8 +648,12 @@ const char	*zbx_json_next(const struct zbx_json_parse *jp, const char *p)
 		return p;
 	}
 
-	while (p <= jp->end)
+	while (1)
 	{
+		/* skip to the next character that can change state or level */
+		if ((p = (0 == state ? json_scan_structural(p) : json_scan_quote(p))) > jp->end)
+			break;
+
 		switch (*p)
 		{
 			case '"':
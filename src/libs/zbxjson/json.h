@@ -20,8 +20,9 @@
 #ifndef ZABBIX_JSON_H
 #define ZABBIX_JSON_H
 
+/* skips ZBX_WHITESPACE characters */
 #define SKIP_WHITESPACE(src)	\
-	while ('\0' != *(src) && NULL != strchr(ZBX_WHITESPACE, *(src))) (src)++
+	while (' ' == *(src) || '\t' == *(src) || '\r' == *(src) || '\n' == *(src)) (src)++
 
 /* can only be used on non empty string */
 #define SKIP_WHITESPACE_NEXT(src)\
@@ -21,6 +21,7 @@
 
 #include "zbxjson.h"
 #include "json_parser.h"
+#include "json_scan.h"
 #include "json.h"
 
 #include "log.h"
@@ -79,7 +80,8 @@ static int	json_parse_string(const char *start, char **error)
 	/* skip starting '"' */
 	ptr++;
 
-	while ('"' != *ptr)
+	/* skip plain characters up to the next quote, escape or control character */
+	while ('"' != *(ptr = json_scan_string(ptr)))
 	{
 		/* unexpected end of string data, failing */
 		if ('\0' == *ptr)
@@ -121,13 +123,13 @@ static int	json_parse_string(const char *start, char **error)
 					return json_error("invalid escape sequence in string data",
 							escape_start, error);
 			}
-		}
 
-		/* Control character U+0000 - U+001F? It should have been escaped according to RFC 8259. */
-		if (0x1f >= (unsigned char)*ptr)
-			return json_error("invalid control character in string data", ptr, error);
+			ptr++;
+			continue;
+		}
 
-		ptr++;
+		/* Control character U+0000 - U+001F. It should have been escaped according to RFC 8259. */
+		return json_error("invalid control character in string data", ptr, error);
 	}
 
 	return (int)(ptr - start) + 1;
@@ -0,0 +1,248 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+
+#include "json_scan.h"
+
+#ifdef HAVE_X86_SIMD
+#	include <immintrin.h>
+#endif
+
+/* the scanned character classes */
+#define JSON_SCAN_STRING	0	/* string end, escape or control character (including '\0') */
+#define JSON_SCAN_QUOTE		1	/* string end, escape or '\0' */
+#define JSON_SCAN_STRUCTURAL	2	/* string start, brackets, value separator or '\0' */
+
+#define JSON_SCAN_CLASSES_NUM	3
+
+typedef const char	*(*zbx_json_scan_func_t)(const char *p, int cls);
+
+#define JSON_SCAN_IS_STRING(c)		('"' == (c) || '\\' == (c) || 0x1f >= (c))
+#define JSON_SCAN_IS_QUOTE(c)		('"' == (c) || '\\' == (c) || '\0' == (c))
+#define JSON_SCAN_IS_STRUCTURAL(c)	('"' == (c) || '[' == (c) || ']' == (c) || '{' == (c) || '}' == (c) || \
+					',' == (c) || '\0' == (c))
+
+#define JSON_SCAN_ROW4(f, c)	f(c), f((c) + 1), f((c) + 2), f((c) + 3)
+#define JSON_SCAN_ROW16(f, c)	JSON_SCAN_ROW4(f, c), JSON_SCAN_ROW4(f, (c) + 4), JSON_SCAN_ROW4(f, (c) + 8), \
+				JSON_SCAN_ROW4(f, (c) + 12)
+#define JSON_SCAN_ROW64(f, c)	JSON_SCAN_ROW16(f, c), JSON_SCAN_ROW16(f, (c) + 16), JSON_SCAN_ROW16(f, (c) + 32), \
+				JSON_SCAN_ROW16(f, (c) + 48)
+#define JSON_SCAN_ROW(f)	{JSON_SCAN_ROW64(f, 0), JSON_SCAN_ROW64(f, 64), JSON_SCAN_ROW64(f, 128), \
+				JSON_SCAN_ROW64(f, 192)}
+
+/* character class membership for the scalar scanner, built at compile time so that no initialization */
+/* is needed before the scanner can be used by several threads                                        */
+static const unsigned char	json_scan_table[JSON_SCAN_CLASSES_NUM][256] = {
+	JSON_SCAN_ROW(JSON_SCAN_IS_STRING),
+	JSON_SCAN_ROW(JSON_SCAN_IS_QUOTE),
+	JSON_SCAN_ROW(JSON_SCAN_IS_STRUCTURAL)
+};
+
+/******************************************************************************
+ *                                                                            *
+ * Function: json_scan_scalar                                                 *
+ *                                                                            *
+ * Purpose: find the first character of the specified class, one byte at a    *
+ *          time                                                              *
+ *                                                                            *
+ * Parameters: p   - [IN] the data to scan                                    *
+ *             cls - [IN] the character class (JSON_SCAN_*)                   *
+ *                                                                            *
+ * Return value: The first character of the specified class.                  *
+ *                                                                            *
+ ******************************************************************************/
+static const char	*json_scan_scalar(const char *p, int cls)
+{
+	const unsigned char	*table = json_scan_table[cls];
+
+	while (0 == table[(unsigned char)*p])
+		p++;
+
+	return p;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* The SIMD scanners load aligned blocks, so a block never crosses page boundary and the data */
+/* can be safely read up to the end of the block containing terminating '\0', which always    */
+/* matches the scanned character class.                                                      */
+
+__attribute__((target("sse2")))
+static unsigned int	json_scan_mask_sse2(__m128i v, int cls)
+{
+	__m128i	m;
+
+	switch (cls)
+	{
+		case JSON_SCAN_STRING:
+			/* control characters are found as bytes with max(v, 0x1f) equal to 0x1f */
+			m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f)));
+			break;
+		case JSON_SCAN_QUOTE:
+			m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+			break;
+		default:
+			/* '[' and ']' differ from '{' and '}' only by 0x20 bit */
+			m = _mm_or_si128(v, _mm_set1_epi8(0x20));
+			m = _mm_or_si128(_mm_cmpeq_epi8(m, _mm_set1_epi8('{')), _mm_cmpeq_epi8(m, _mm_set1_epi8('}')));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+			break;
+	}
+
+	return (unsigned int)_mm_movemask_epi8(m);
+}
+
+__attribute__((target("sse2")))
+static const char	*json_scan_sse2(const char *p, int cls)
+{
+	const __m128i	*block = (const __m128i *)((uintptr_t)p & ~(uintptr_t)15);
+	unsigned int	mask;
+
+	mask = json_scan_mask_sse2(_mm_load_si128(block), cls) & (~0U << (p - (const char *)block));
+
+	while (0 == mask)
+		mask = json_scan_mask_sse2(_mm_load_si128(++block), cls);
+
+	return (const char *)block + __builtin_ctz(mask);
+}
+
+__attribute__((target("avx2")))
+static unsigned int	json_scan_mask_avx2(__m256i v, int cls)
+{
+	__m256i	m;
+
+	switch (cls)
+	{
+		case JSON_SCAN_STRING:
+			m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+					_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x1f)),
+					_mm256_set1_epi8(0x1f)));
+			break;
+		case JSON_SCAN_QUOTE:
+			m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+					_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+			break;
+		default:
+			m = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+			m = _mm256_or_si256(_mm256_cmpeq_epi8(m, _mm256_set1_epi8('{')),
+					_mm256_cmpeq_epi8(m, _mm256_set1_epi8('}')));
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+			break;
+	}
+
+	return (unsigned int)_mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static const char	*json_scan_avx2(const char *p, int cls)
+{
+	const __m256i	*block = (const __m256i *)((uintptr_t)p & ~(uintptr_t)31);
+	unsigned int	mask;
+
+	mask = json_scan_mask_avx2(_mm256_load_si256(block), cls) & (~0U << (p - (const char *)block));
+
+	while (0 == mask)
+		mask = json_scan_mask_avx2(_mm256_load_si256(++block), cls);
+
+	return (const char *)block + __builtin_ctz(mask);
+}
+
+static zbx_json_scan_func_t	json_scan_func = json_scan_scalar;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: json_scan_init                                                   *
+ *                                                                            *
+ * Purpose: select the scanner supported by CPU                               *
+ *                                                                            *
+ * Comments: Runs at program startup before any threads are created, so the   *
+ *           scanner is never changed while being used.                       *
+ *                                                                            *
+ ******************************************************************************/
+__attribute__((constructor))
+static void	json_scan_init(void)
+{
+	__builtin_cpu_init();
+
+	if (0 != __builtin_cpu_supports("avx2"))
+		json_scan_func = json_scan_avx2;
+	else if (0 != __builtin_cpu_supports("sse2"))
+		json_scan_func = json_scan_sse2;
+}
+#else
+static const zbx_json_scan_func_t	json_scan_func = json_scan_scalar;
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: json_scan_string                                                 *
+ *                                                                            *
+ * Purpose: find the end of plain string data                                 *
+ *                                                                            *
+ * Parameters: p - [IN] the string contents                                   *
+ *                                                                            *
+ * Return value: The first '"', '\' or control character (including           *
+ *               terminating '\0').                                           *
+ *                                                                            *
+ ******************************************************************************/
+const char	*json_scan_string(const char *p)
+{
+	return json_scan_func(p, JSON_SCAN_STRING);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: json_scan_quote                                                  *
+ *                                                                            *
+ * Purpose: find the end of string data in valid json                         *
+ *                                                                            *
+ * Parameters: p - [IN] the string contents                                   *
+ *                                                                            *
+ * Return value: The first '"', '\' or terminating '\0'.                      *
+ *                                                                            *
+ ******************************************************************************/
+const char	*json_scan_quote(const char *p)
+{
+	return json_scan_func(p, JSON_SCAN_QUOTE);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: json_scan_structural                                             *
+ *                                                                            *
+ * Purpose: find the next structural character outside string                 *
+ *                                                                            *
+ * Parameters: p - [IN] the json data outside string                          *
+ *                                                                            *
+ * Return value: The first '"', '[', ']', '{', '}', ',' or terminating '\0'.  *
+ *                                                                            *
+ ******************************************************************************/
+const char	*json_scan_structural(const char *p)
+{
+	return json_scan_func(p, JSON_SCAN_STRUCTURAL);
+}
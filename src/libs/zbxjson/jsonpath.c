@@ -39,9 +39,33 @@ zbx_json_element_t;
 ZBX_VECTOR_DECL(json, zbx_json_element_t)
 ZBX_VECTOR_IMPL(json, zbx_json_element_t)
 
-static int	jsonpath_query_object(const struct zbx_json_parse *jp_root, const struct zbx_json_parse *jp,
+/* indexed json object or array */
+typedef struct
+{
+	const char		*start;		/* the object/array location in json data */
+	zbx_hashset_t		names;		/* object elements (zbx_json_element_t) by name */
+	zbx_vector_ptr_t	elements;	/* array element locations in json data */
+	unsigned char		duplicates;	/* 1 if object has duplicate names and cannot be indexed */
+}
+zbx_jsonpath_index_node_t;
+
+struct zbx_jsonpath_index
+{
+	zbx_hashset_t	nodes;
+};
+
+typedef struct
+{
+	const struct zbx_json_parse	*root;		/* the document root */
+	zbx_jsonpath_index_t		*index;		/* the document index (optional) */
+}
+zbx_jsonpath_context_t;
+
+static int	jsonpath_query_object(const zbx_jsonpath_context_t *ctx, const struct zbx_json_parse *jp,
+		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects);
+static int	jsonpath_query_array(const zbx_jsonpath_context_t *ctx, const struct zbx_json_parse *jp,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects);
-static int	jsonpath_query_array(const struct zbx_json_parse *jp_root, const struct zbx_json_parse *jp,
+static int	jsonpath_query_next_segment(const zbx_jsonpath_context_t *ctx, const char *name, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects);
 
 typedef struct
@@ -1328,13 +1352,187 @@ static int	jsonpath_pointer_to_jp(const char *pnext, struct zbx_json_parse *jp)
 	}
 }
 
+static zbx_hash_t	jsonpath_index_name_hash(const void *data)
+{
+	const zbx_json_element_t	*element = (const zbx_json_element_t *)data;
+
+	return ZBX_DEFAULT_STRING_HASH_FUNC(element->name);
+}
+
+static void	jsonpath_index_name_clear(void *data)
+{
+	zbx_json_element_t	*element = (zbx_json_element_t *)data;
+
+	zbx_free(element->name);
+}
+
+static void	jsonpath_index_node_clear(void *data)
+{
+	zbx_jsonpath_index_node_t	*node = (zbx_jsonpath_index_node_t *)data;
+
+	if ('{' == *node->start)
+		zbx_hashset_destroy(&node->names);
+	else
+		zbx_vector_ptr_destroy(&node->elements);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: jsonpath_index_get                                               *
+ *                                                                            *
+ * Purpose: get index of json object or array, indexing it on first access    *
+ *                                                                            *
+ * Parameters: index - [IN] the document index                                *
+ *             jp    - [IN] the object or array to get index of               *
+ *                                                                            *
+ * Return value: The object or array index.                                   *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_jsonpath_index_node_t	*jsonpath_index_get(zbx_jsonpath_index_t *index,
+		const struct zbx_json_parse *jp)
+{
+	zbx_jsonpath_index_node_t	*node, node_local;
+	const char			*pnext = NULL;
+
+	if (NULL != (node = (zbx_jsonpath_index_node_t *)zbx_hashset_search(&index->nodes, &jp->start)))
+		return node;
+
+	node_local.start = jp->start;
+	node_local.duplicates = 0;
+	node = (zbx_jsonpath_index_node_t *)zbx_hashset_insert(&index->nodes, &node_local, sizeof(node_local));
+
+	if ('{' == *jp->start)
+	{
+		char			name[MAX_STRING_LEN];
+		zbx_json_element_t	element_local;
+
+		zbx_hashset_create_ext(&node->names, 0, jsonpath_index_name_hash, ZBX_DEFAULT_STR_COMPARE_FUNC,
+				jsonpath_index_name_clear, ZBX_DEFAULT_MEM_MALLOC_FUNC, ZBX_DEFAULT_MEM_REALLOC_FUNC,
+				ZBX_DEFAULT_MEM_FREE_FUNC);
+
+		element_local.name = name;
+
+		while (NULL != (pnext = zbx_json_pair_next(jp, pnext, name, sizeof(name))))
+		{
+			if (NULL != zbx_hashset_search(&node->names, &element_local))
+			{
+				node->duplicates = 1;
+				continue;
+			}
+
+			element_local.name = zbx_strdup(NULL, name);
+			element_local.value = pnext;
+			zbx_hashset_insert(&node->names, &element_local, sizeof(element_local));
+			element_local.name = name;
+		}
+	}
+	else
+	{
+		zbx_vector_ptr_create(&node->elements);
+
+		while (NULL != (pnext = zbx_json_next(jp, pnext)))
+			zbx_vector_ptr_append(&node->elements, (void *)pnext);
+	}
+
+	return node;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: jsonpath_query_object_index                                      *
+ *                                                                            *
+ * Purpose: query json object for single name segment match using document    *
+ *          index                                                             *
+ *                                                                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
+ *             jp         - [IN] the json object to query                     *
+ *             jsonpath   - [IN] the jsonpath                                 *
+ *             path_depth - [IN] the jsonpath segment to match                *
+ *             objects    - [OUT] the matched json elements (name, value)     *
+ *                                                                            *
+ * Return value: SUCCEED - the object was queried successfully                *
+ *               FAIL    - otherwise                                          *
+ *               NOTSUPPORTED - the object cannot be queried by index         *
+ *                                                                            *
+ ******************************************************************************/
+static int	jsonpath_query_object_index(const zbx_jsonpath_context_t *ctx, const struct zbx_json_parse *jp,
+		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
+{
+	const zbx_jsonpath_segment_t	*segment = &jsonpath->segments[path_depth];
+	zbx_jsonpath_index_node_t	*node;
+	zbx_json_element_t		*element, element_local;
+
+	if (ZBX_JSONPATH_SEGMENT_MATCH_LIST != segment->type || ZBX_JSONPATH_LIST_NAME != segment->data.list.type ||
+			NULL != segment->data.list.values->next || 1 == segment->detached)
+	{
+		return NOTSUPPORTED;
+	}
+
+	node = jsonpath_index_get(ctx->index, jp);
+
+	if (1 == node->duplicates)
+		return NOTSUPPORTED;
+
+	element_local.name = (char *)segment->data.list.values->data;
+
+	if (NULL == (element = (zbx_json_element_t *)zbx_hashset_search(&node->names, &element_local)))
+		return SUCCEED;
+
+	return jsonpath_query_next_segment(ctx, element->name, element->value, jsonpath, path_depth, objects);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: jsonpath_query_array_index                                       *
+ *                                                                            *
+ * Purpose: query json array for single index segment match using document    *
+ *          index                                                             *
+ *                                                                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
+ *             elements   - [IN] the indexed array elements                   *
+ *             jsonpath   - [IN] the jsonpath                                 *
+ *             path_depth - [IN] the jsonpath segment to match                *
+ *             objects    - [OUT] the matched json elements (name, value)     *
+ *                                                                            *
+ * Return value: SUCCEED - the array was queried successfully                 *
+ *               FAIL    - otherwise                                          *
+ *               NOTSUPPORTED - the array cannot be queried by index          *
+ *                                                                            *
+ ******************************************************************************/
+static int	jsonpath_query_array_index(const zbx_jsonpath_context_t *ctx, const zbx_vector_ptr_t *elements,
+		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
+{
+	const zbx_jsonpath_segment_t	*segment = &jsonpath->segments[path_depth];
+	int				index;
+	char				name[MAX_ID_LEN + 1];
+
+	if (ZBX_JSONPATH_SEGMENT_MATCH_LIST != segment->type || ZBX_JSONPATH_LIST_INDEX != segment->data.list.type ||
+			NULL != segment->data.list.values->next || 1 == segment->detached)
+	{
+		return NOTSUPPORTED;
+	}
+
+	memcpy(&index, segment->data.list.values->data, sizeof(index));
+
+	if (0 > index)
+		index += elements->values_num;
+
+	if (0 > index || elements->values_num <= index)
+		return SUCCEED;
+
+	zbx_snprintf(name, sizeof(name), "%d", index);
+
+	return jsonpath_query_next_segment(ctx, name, (const char *)elements->values[index], jsonpath, path_depth,
+			objects);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: jsonpath_query_contents                                          *
  *                                                                            *
  * Purpose: perform the rest of jsonpath query on json data                   *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             pnext      - [IN] a pointer to object/array/value in json data *
  *             jsonpath   - [IN] the jsonpath                                 *
  *             path_depth - [IN] the jsonpath segment to match                *
@@ -1344,7 +1542,7 @@ static int	jsonpath_pointer_to_jp(const char *pnext, struct zbx_json_parse *jp)
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_query_contents(const struct zbx_json_parse *jp_root, const char *pnext,
+static int	jsonpath_query_contents(const zbx_jsonpath_context_t *ctx, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
 {
 	struct zbx_json_parse	jp_child;
@@ -1355,12 +1553,12 @@ static int	jsonpath_query_contents(const struct zbx_json_parse *jp_root, const c
 			if (FAIL == zbx_json_brackets_open(pnext, &jp_child))
 				return FAIL;
 
-			return jsonpath_query_object(jp_root, &jp_child, jsonpath, path_depth, objects);
+			return jsonpath_query_object(ctx, &jp_child, jsonpath, path_depth, objects);
 		case '[':
 			if (FAIL == zbx_json_brackets_open(pnext, &jp_child))
 				return FAIL;
 
-			return jsonpath_query_array(jp_root, &jp_child, jsonpath, path_depth, objects);
+			return jsonpath_query_array(ctx, &jp_child, jsonpath, path_depth, objects);
 	}
 	return SUCCEED;
 }
@@ -1371,7 +1569,7 @@ static int	jsonpath_query_contents(const struct zbx_json_parse *jp_root, const c
  *                                                                            *
  * Purpose: query next segment                                                *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             name       - [IN] name or index of the next json element       *
  *             pnext      - [IN] a pointer to object/array/value in json data *
  *             jsonpath   - [IN] the jsonpath                                 *
@@ -1382,7 +1580,7 @@ static int	jsonpath_query_contents(const struct zbx_json_parse *jp_root, const c
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_query_next_segment(const struct zbx_json_parse *jp_root, const char *name, const char *pnext,
+static int	jsonpath_query_next_segment(const zbx_jsonpath_context_t *ctx, const char *name, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
 {
 	/* check if jsonpath end has been reached, so we have found matching data */
@@ -1395,7 +1593,7 @@ static int	jsonpath_query_next_segment(const struct zbx_json_parse *jp_root, con
 	}
 
 	/* continue by matching found data against the rest of jsonpath segments */
-	return jsonpath_query_contents(jp_root, pnext, jsonpath, path_depth, objects);
+	return jsonpath_query_contents(ctx, pnext, jsonpath, path_depth, objects);
 }
 
 /******************************************************************************
@@ -1404,7 +1602,7 @@ static int	jsonpath_query_next_segment(const struct zbx_json_parse *jp_root, con
  *                                                                            *
  * Purpose: match object value name against jsonpath segment name list        *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             name       - [IN] name or index of the next json element       *
  *             pnext      - [IN] a pointer to object value with the specified *
  *                               name                                         *
@@ -1416,7 +1614,7 @@ static int	jsonpath_query_next_segment(const struct zbx_json_parse *jp_root, con
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_match_name(const struct zbx_json_parse *jp_root, const char *name, const char *pnext,
+static int	jsonpath_match_name(const zbx_jsonpath_context_t *ctx, const char *name, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
 {
 	const zbx_jsonpath_segment_t	*segment = &jsonpath->segments[path_depth];
@@ -1430,7 +1628,7 @@ static int	jsonpath_match_name(const struct zbx_json_parse *jp_root, const char
 	{
 		if (0 == strcmp(name, node->data))
 		{
-			if (FAIL == jsonpath_query_next_segment(jp_root, name, pnext, jsonpath, path_depth, objects))
+			if (FAIL == jsonpath_query_next_segment(ctx, name, pnext, jsonpath, path_depth, objects))
 				return FAIL;
 			break;
 		}
@@ -1675,7 +1873,7 @@ static int	jsonpath_regexp_match(const char *text, const char *pattern, double *
  *                                                                            *
  * Purpose: match json array element/object value against jsonpath expression *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             name       - [IN] name or index of the next json element       *
  *             pnext      - [IN] a pointer to array element/object value      *
  *             jsonpath   - [IN] the jsonpath                                 *
@@ -1686,7 +1884,7 @@ static int	jsonpath_regexp_match(const char *text, const char *pattern, double *
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_match_expression(const struct zbx_json_parse *jp_root, const char *name, const char *pnext,
+static int	jsonpath_match_expression(const zbx_jsonpath_context_t *ctx, const char *name, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
 {
 	struct zbx_json_parse	jp;
@@ -1838,7 +2036,7 @@ static int	jsonpath_match_expression(const struct zbx_json_parse *jp_root, const
 		switch (token->type)
 		{
 			case ZBX_JSONPATH_TOKEN_PATH_ABSOLUTE:
-				if (FAIL == jsonpath_extract_value(jp_root, token->data, &value))
+				if (FAIL == jsonpath_extract_value(ctx->root, token->data, &value))
 					zbx_variant_set_none(&value);
 				zbx_vector_var_append_ptr(&stack, &value);
 				break;
@@ -1883,7 +2081,7 @@ static int	jsonpath_match_expression(const struct zbx_json_parse *jp_root, const
 
 	jsonpath_variant_to_boolean(&stack.values[0]);
 	if (SUCCEED != zbx_double_compare(stack.values[0].data.dbl, 0.0))
-		ret = jsonpath_query_next_segment(jp_root, name, pnext, jsonpath, path_depth, objects);
+		ret = jsonpath_query_next_segment(ctx, name, pnext, jsonpath, path_depth, objects);
 out:
 	for (i = 0; i < stack.values_num; i++)
 		zbx_variant_clear(&stack.values[i]);
@@ -1898,7 +2096,7 @@ out:
  *                                                                            *
  * Purpose: query object fields for jsonpath segment match                    *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             jp         - [IN] the json object to query                     *
  *             jsonpath   - [IN] the jsonpath                                 *
  *             path_depth - [IN] the jsonpath segment to match                *
@@ -1908,7 +2106,7 @@ out:
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_query_object(const struct zbx_json_parse *jp_root, const struct zbx_json_parse *jp,
+static int	jsonpath_query_object(const zbx_jsonpath_context_t *ctx, const struct zbx_json_parse *jp,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
 {
 	const char			*pnext = NULL;
@@ -1916,6 +2114,13 @@ static int	jsonpath_query_object(const struct zbx_json_parse *jp_root, const str
 	const zbx_jsonpath_segment_t	*segment;
 	int				ret = SUCCEED;
 
+	if (NULL != ctx->index && NOTSUPPORTED != (ret = jsonpath_query_object_index(ctx, jp, jsonpath, path_depth,
+			objects)))
+	{
+		return ret;
+	}
+
+	ret = SUCCEED;
 	segment = &jsonpath->segments[path_depth];
 
 	while (NULL != (pnext = zbx_json_pair_next(jp, pnext, name, sizeof(name))) && SUCCEED == ret)
@@ -1923,20 +2128,20 @@ static int	jsonpath_query_object(const struct zbx_json_parse *jp_root, const str
 		switch (segment->type)
 		{
 			case ZBX_JSONPATH_SEGMENT_MATCH_ALL:
-				ret = jsonpath_query_next_segment(jp_root, name, pnext, jsonpath, path_depth, objects);
+				ret = jsonpath_query_next_segment(ctx, name, pnext, jsonpath, path_depth, objects);
 				break;
 			case ZBX_JSONPATH_SEGMENT_MATCH_LIST:
-				ret = jsonpath_match_name(jp_root, name, pnext, jsonpath, path_depth, objects);
+				ret = jsonpath_match_name(ctx, name, pnext, jsonpath, path_depth, objects);
 				break;
 			case ZBX_JSONPATH_SEGMENT_MATCH_EXPRESSION:
-				ret = jsonpath_match_expression(jp_root, name, pnext, jsonpath, path_depth, objects);
+				ret = jsonpath_match_expression(ctx, name, pnext, jsonpath, path_depth, objects);
 				break;
 			default:
 				break;
 		}
 
 		if (1 == segment->detached)
-			ret = jsonpath_query_contents(jp_root, pnext, jsonpath, path_depth, objects);
+			ret = jsonpath_query_contents(ctx, pnext, jsonpath, path_depth, objects);
 	}
 
 	return ret;
@@ -1948,7 +2153,7 @@ static int	jsonpath_query_object(const struct zbx_json_parse *jp_root, const str
  *                                                                            *
  * Purpose: match array element against segment index list                    *
  *                                                                            *
- * Parameters: jp_root      - [IN] the document root                          *
+ * Parameters: ctx          - [IN] the jsonpath query context                 *
  *             name         - [IN] the json element name (index)              *
  *             pnext        - [IN] a pointer to an array element              *
  *             jsonpath     - [IN] the jsonpath                               *
@@ -1961,7 +2166,7 @@ static int	jsonpath_query_object(const struct zbx_json_parse *jp_root, const str
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_match_index(const struct zbx_json_parse *jp_root, const char *name, const char *pnext,
+static int	jsonpath_match_index(const zbx_jsonpath_context_t *ctx, const char *name, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, int index, int elements_num, zbx_vector_json_t *objects)
 {
 	const zbx_jsonpath_segment_t	*segment = &jsonpath->segments[path_depth];
@@ -1979,7 +2184,7 @@ static int	jsonpath_match_index(const struct zbx_json_parse *jp_root, const char
 
 		if ((query_index >= 0 && index == query_index) || index == elements_num + query_index)
 		{
-			if (FAIL == jsonpath_query_next_segment(jp_root, name, pnext, jsonpath, path_depth, objects))
+			if (FAIL == jsonpath_query_next_segment(ctx, name, pnext, jsonpath, path_depth, objects))
 				return FAIL;
 			break;
 		}
@@ -1994,7 +2199,7 @@ static int	jsonpath_match_index(const struct zbx_json_parse *jp_root, const char
  *                                                                            *
  * Purpose: match array element against segment index range                   *
  *                                                                            *
- * Parameters: jp_root      - [IN] the document root                          *
+ * Parameters: ctx          - [IN] the jsonpath query context                 *
  *             name         - [IN] the json element name (index)              *
  *             pnext        - [IN] a pointer to an array element              *
  *             jsonpath     - [IN] the jsonpath                               *
@@ -2007,7 +2212,7 @@ static int	jsonpath_match_index(const struct zbx_json_parse *jp_root, const char
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_match_range(const struct zbx_json_parse *jp_root, const char *name, const char *pnext,
+static int	jsonpath_match_range(const zbx_jsonpath_context_t *ctx, const char *name, const char *pnext,
 		const zbx_jsonpath_t *jsonpath, int path_depth, int index, int elements_num, zbx_vector_json_t *objects)
 {
 	int				start_index, end_index;
@@ -2023,7 +2228,7 @@ static int	jsonpath_match_range(const struct zbx_json_parse *jp_root, const char
 
 	if (start_index <= index && end_index > index)
 	{
-		if (FAIL == jsonpath_query_next_segment(jp_root, name, pnext, jsonpath, path_depth, objects))
+		if (FAIL == jsonpath_query_next_segment(ctx, name, pnext, jsonpath, path_depth, objects))
 			return FAIL;
 	}
 
@@ -2036,7 +2241,7 @@ static int	jsonpath_match_range(const struct zbx_json_parse *jp_root, const char
  *                                                                            *
  * Purpose: query array elements for jsonpath segment match                   *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             jp         - [IN] the json array to query                      *
  *             jsonpath   - [IN] the jsonpath                                 *
  *             path_depth - [IN] the jsonpath segment to match                *
@@ -2046,45 +2251,67 @@ static int	jsonpath_match_range(const struct zbx_json_parse *jp_root, const char
  *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_query_array(const struct zbx_json_parse *jp_root, const struct zbx_json_parse *jp,
+static int	jsonpath_query_array(const zbx_jsonpath_context_t *ctx, const struct zbx_json_parse *jp,
 		const zbx_jsonpath_t *jsonpath, int path_depth, zbx_vector_json_t *objects)
 {
 	const char		*pnext = NULL;
 	int			index = 0, elements_num = 0, ret = SUCCEED;
 	zbx_jsonpath_segment_t	*segment;
+	zbx_vector_ptr_t	*elements = NULL;
 
 	segment = &jsonpath->segments[path_depth];
 
-	while (NULL != (pnext = zbx_json_next(jp, pnext)))
-		elements_num++;
+	if (NULL != ctx->index)
+	{
+		elements = &jsonpath_index_get(ctx->index, jp)->elements;
+
+		if (NOTSUPPORTED != (ret = jsonpath_query_array_index(ctx, elements, jsonpath, path_depth, objects)))
+			return ret;
 
-	while (NULL != (pnext = zbx_json_next(jp, pnext)) && SUCCEED == ret)
+		ret = SUCCEED;
+		elements_num = elements->values_num;
+	}
+	else
+	{
+		while (NULL != (pnext = zbx_json_next(jp, pnext)))
+			elements_num++;
+	}
+
+	while (SUCCEED == ret)
 	{
 		char	name[MAX_ID_LEN + 1];
 
+		if (NULL != elements)
+			pnext = (index < elements_num ? (const char *)elements->values[index] : NULL);
+		else
+			pnext = zbx_json_next(jp, pnext);
+
+		if (NULL == pnext)
+			break;
+
 		zbx_snprintf(name, sizeof(name), "%d", index);
 		switch (segment->type)
 		{
 			case ZBX_JSONPATH_SEGMENT_MATCH_ALL:
-				ret = jsonpath_query_next_segment(jp_root, name, pnext, jsonpath, path_depth, objects);
+				ret = jsonpath_query_next_segment(ctx, name, pnext, jsonpath, path_depth, objects);
 				break;
 			case ZBX_JSONPATH_SEGMENT_MATCH_LIST:
-				ret = jsonpath_match_index(jp_root, name, pnext, jsonpath, path_depth, index,
+				ret = jsonpath_match_index(ctx, name, pnext, jsonpath, path_depth, index,
 						elements_num, objects);
 				break;
 			case ZBX_JSONPATH_SEGMENT_MATCH_RANGE:
-				ret = jsonpath_match_range(jp_root, name, pnext, jsonpath, path_depth, index,
+				ret = jsonpath_match_range(ctx, name, pnext, jsonpath, path_depth, index,
 						elements_num, objects);
 				break;
 			case ZBX_JSONPATH_SEGMENT_MATCH_EXPRESSION:
-				ret = jsonpath_match_expression(jp_root, name, pnext, jsonpath, path_depth, objects);
+				ret = jsonpath_match_expression(ctx, name, pnext, jsonpath, path_depth, objects);
 				break;
 			default:
 				break;
 		}
 
 		if (1 == segment->detached)
-			ret = jsonpath_query_contents(jp_root, pnext, jsonpath, path_depth, objects);
+			ret = jsonpath_query_contents(ctx, pnext, jsonpath, path_depth, objects);
 
 		index++;
 	}
@@ -2314,7 +2541,7 @@ out:
  *                                                                            *
  * Purpose: apply jsonpath function to the extracted object list              *
  *                                                                            *
- * Parameters: jp_root    - [IN] the document root                            *
+ * Parameters: ctx        - [IN] the jsonpath query context                   *
  *             objects    - [IN] the matched json elements (name, value)      *
  *             jsonpath   - [IN] the jsonpath                                 *
  *             path_depth - [IN] the jsonpath segment to match                *
@@ -2325,7 +2552,7 @@ out:
  *                         json error                                         *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_apply_functions(const struct zbx_json_parse *jp_root, const zbx_vector_json_t *objects,
+static int	jsonpath_apply_functions(const zbx_jsonpath_context_t *ctx, const zbx_vector_json_t *objects,
 		const zbx_jsonpath_t *jsonpath, int path_depth, char **output)
 {
 	int			ret, definite_path;
@@ -2337,7 +2564,7 @@ static int	jsonpath_apply_functions(const struct zbx_json_parse *jp_root, const
 	/* when functions are applied directly to the json document (at the start of the jsonpath ) */
 	/* it makes all document as input object                                                    */
 	if (0 == path_depth)
-		zbx_vector_json_add_element(&input, "", jp_root->start);
+		zbx_vector_json_add_element(&input, "", ctx->root->start);
 	else
 		zbx_vector_json_copy(&input, objects);
 
@@ -2384,7 +2611,8 @@ static int	jsonpath_apply_functions(const struct zbx_json_parse *jp_root, const
  *               FAIL    - invalid result data (internal json error)          *
  *                                                                            *
  ******************************************************************************/
-static int	jsonpath_format_query_result(const zbx_vector_json_t *objects, zbx_jsonpath_t *jsonpath, char **output)
+static int	jsonpath_format_query_result(const zbx_vector_json_t *objects, const zbx_jsonpath_t *jsonpath,
+		char **output)
 {
 	size_t	output_offset = 0, output_alloc;
 	int	i;
@@ -2546,49 +2774,122 @@ int	zbx_jsonpath_compile(const char *path, zbx_jsonpath_t *jsonpath)
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_jsonpath_query                                               *
+ * Function: zbx_jsonpath_index_create                                        *
  *                                                                            *
- * Purpose: perform jsonpath query on the specified json data                 *
+ * Purpose: create structural index of json document                          *
  *                                                                            *
- * Parameters: jp     - [IN] the json data                                    *
- *             path   - [IN] the jsonpath                                     *
- *             output - [OUT] the output value                                *
+ * Return value: The created index.                                           *
+ *                                                                            *
+ * Comments: The index is filled by queries performed with it - objects and   *
+ *           arrays are indexed when they are accessed for the first time.    *
+ *           The index refers to the json data, so it must be used only with  *
+ *           the same document and freed before the document.                 *
+ *                                                                            *
+ ******************************************************************************/
+zbx_jsonpath_index_t	*zbx_jsonpath_index_create(void)
+{
+	zbx_jsonpath_index_t	*index;
+
+	index = (zbx_jsonpath_index_t *)zbx_malloc(NULL, sizeof(zbx_jsonpath_index_t));
+
+	zbx_hashset_create_ext(&index->nodes, 0, ZBX_DEFAULT_PTR_HASH_FUNC, ZBX_DEFAULT_PTR_COMPARE_FUNC,
+			jsonpath_index_node_clear, ZBX_DEFAULT_MEM_MALLOC_FUNC, ZBX_DEFAULT_MEM_REALLOC_FUNC,
+			ZBX_DEFAULT_MEM_FREE_FUNC);
+
+	return index;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_jsonpath_index_free                                          *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_jsonpath_index_free(zbx_jsonpath_index_t *index)
+{
+	zbx_hashset_destroy(&index->nodes);
+	zbx_free(index);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_jsonpath_query_compiled                                      *
+ *                                                                            *
+ * Purpose: perform compiled jsonpath query on the specified json data        *
+ *                                                                            *
+ * Parameters: jp       - [IN] the json data                                  *
+ *             jsonpath - [IN] the compiled jsonpath                          *
+ *             index    - [IN/OUT] the json data index (optional)             *
+ *             output   - [OUT] the output value                              *
  *                                                                            *
  * Return value: SUCCEED - the query was performed successfully (empty result *
  *                         being counted as successful query)                 *
  *               FAIL    - otherwise                                          *
  *                                                                            *
+ * Comments: When index is specified the objects and arrays accessed during   *
+ *           query are indexed, so that other queries on the same json data   *
+ *           can locate elements without parsing the data again.              *
+ *                                                                            *
  ******************************************************************************/
-int	zbx_jsonpath_query(const struct zbx_json_parse *jp, const char *path, char **output)
+int	zbx_jsonpath_query_compiled(const struct zbx_json_parse *jp, const zbx_jsonpath_t *jsonpath,
+		zbx_jsonpath_index_t *index, char **output)
 {
-	zbx_jsonpath_t		jsonpath;
 	int			path_depth = 0, ret = SUCCEED;
 	zbx_vector_json_t	objects;
+	zbx_jsonpath_context_t	ctx;
 
-	if (FAIL == zbx_jsonpath_compile(path, &jsonpath))
-		return FAIL;
+	ctx.root = jp;
+	ctx.index = index;
 
 	zbx_vector_json_create(&objects);
 
 	if ('{' == *jp->start)
-		ret = jsonpath_query_object(jp, jp, &jsonpath, path_depth, &objects);
+		ret = jsonpath_query_object(&ctx, jp, jsonpath, path_depth, &objects);
 	else if ('[' == *jp->start)
-		ret = jsonpath_query_array(jp, jp, &jsonpath, path_depth, &objects);
+		ret = jsonpath_query_array(&ctx, jp, jsonpath, path_depth, &objects);
 
 	if (SUCCEED == ret)
 	{
-		path_depth = jsonpath.segments_num;
-		while (0 < path_depth && ZBX_JSONPATH_SEGMENT_FUNCTION == jsonpath.segments[path_depth - 1].type)
+		path_depth = jsonpath->segments_num;
+		while (0 < path_depth && ZBX_JSONPATH_SEGMENT_FUNCTION == jsonpath->segments[path_depth - 1].type)
 			path_depth--;
 
-		if (path_depth < jsonpath.segments_num)
-			ret = jsonpath_apply_functions(jp, &objects, &jsonpath, path_depth, output);
+		if (path_depth < jsonpath->segments_num)
+			ret = jsonpath_apply_functions(&ctx, &objects, jsonpath, path_depth, output);
 		else
-			ret = jsonpath_format_query_result(&objects, &jsonpath, output);
+			ret = jsonpath_format_query_result(&objects, jsonpath, output);
 	}
 
 	zbx_vector_json_clear_ext(&objects);
 	zbx_vector_json_destroy(&objects);
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_jsonpath_query                                               *
+ *                                                                            *
+ * Purpose: perform jsonpath query on the specified json data                 *
+ *                                                                            *
+ * Parameters: jp     - [IN] the json data                                    *
+ *             path   - [IN] the jsonpath                                     *
+ *             output - [OUT] the output value                                *
+ *                                                                            *
+ * Return value: SUCCEED - the query was performed successfully (empty result *
+ *                         being counted as successful query)                 *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_jsonpath_query(const struct zbx_json_parse *jp, const char *path, char **output)
+{
+	zbx_jsonpath_t	jsonpath;
+	int		ret;
+
+	if (FAIL == zbx_jsonpath_compile(path, &jsonpath))
+		return FAIL;
+
+	ret = zbx_jsonpath_query_compiled(jp, &jsonpath, NULL, output);
+
 	zbx_jsonpath_clear(&jsonpath);
 
 	return ret;
@@ -2733,6 +2733,97 @@ int	evaluate_function2(zbx_variant_t *value, DC_ITEM *item, const char *function
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_get_function_history_period                                  *
+ *                                                                            *
+ * Purpose: get the time period of item history the function will read        *
+ *                                                                            *
+ * Parameters: function  - [IN] the function name                             *
+ *             parameter - [IN] the function parameters                       *
+ *             ts        - [IN] the function calculation time                 *
+ *             seconds   - [OUT] the period length in seconds                 *
+ *             ts_end    - [OUT] the period end time                          *
+ *                                                                            *
+ * Return value: SUCCEED - the function reads time based history period       *
+ *               FAIL - the function does not read history or the period is   *
+ *                      defined by number of values                           *
+ *                                                                            *
+ * Comments: Used to prefetch history of multiple items into value cache      *
+ *           before evaluating their functions.                               *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_get_function_history_period(const char *function, const char *parameter, const zbx_timespec_t *ts,
+		int *seconds, zbx_timespec_t *ts_end)
+{
+	const char		*functions[] = {"min", "max", "avg", "sum", "percentile", "count", "countunique",
+				"find", "forecast", "timeleft", "first", "kurtosis", "mad", "skewness", "stddevpop",
+				"stddevsamp", "sumofsquares", "varpop", "varsamp", NULL};
+	const char		**ptr;
+	int			time_shift;
+	zbx_value_type_t	type;
+
+	for (ptr = functions; NULL != *ptr; ptr++)
+	{
+		if (0 == strcmp(*ptr, function))
+			break;
+	}
+
+	if (NULL == *ptr)
+		return FAIL;
+
+	if (SUCCEED != get_function_parameter_hist_range(ts->sec, parameter, 1, seconds, &type, &time_shift) ||
+			ZBX_VALUE_SECONDS != type)
+	{
+		return FAIL;
+	}
+
+	*ts_end = *ts;
+	ts_end->sec -= time_shift;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_get_function_trends_period                                   *
+ *                                                                            *
+ * Purpose: get the time period of item trends the function will read         *
+ *                                                                            *
+ * Parameters: function  - [IN] the function name                             *
+ *             parameter - [IN] the function parameters                       *
+ *             ts        - [IN] the function calculation time                 *
+ *             start     - [OUT] the period start time                        *
+ *             end       - [OUT] the period end time                          *
+ *                                                                            *
+ * Return value: SUCCEED - the function reads trends period                   *
+ *               FAIL - the function does not read trends or its parameters   *
+ *                      are invalid                                           *
+ *                                                                            *
+ * Comments: Used to evaluate trend functions of multiple items with batched  *
+ *           queries before evaluating them one by one.                       *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_get_function_trends_period(const char *function, const char *parameter, const zbx_timespec_t *ts,
+		int *start, int *end)
+{
+	int	ret;
+	char	*period = NULL, *error = NULL;
+
+	if (0 != strncmp(function, "trend", 5) || 1 != num_param(parameter))
+		return FAIL;
+
+	if (SUCCEED != get_function_parameter_str(parameter, 1, &period))
+		return FAIL;
+
+	ret = zbx_trends_parse_range(ts->sec, period, start, end, &error);
+
+	zbx_free(error);
+	zbx_free(period);
+
+	return ret;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_is_trigger_function                                          *
@@ -25,6 +25,7 @@
 #include "zbxeval.h"
 
 #include "valuecache.h"
+#include "zbxtrends.h"
 #include "macrofunc.h"
 #include "../zbxalgo/vectorimpl.h"
 #ifdef HAVE_LIBXML2
@@ -5225,6 +5226,109 @@ static void	zbx_populate_function_items(const zbx_vector_uint64_t *functionids,
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() ifuncs_num:%d", __func__, ifuncs->num_data);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_prefetch_item_functions_data                                 *
+ *                                                                            *
+ * Purpose: caches history periods and trend function results of all          *
+ *          functions to be evaluated with batched reads                      *
+ *                                                                            *
+ * Parameters: funcs            - [IN] the functions to evaluate              *
+ *             history_itemids  - [IN] the items read when saving history     *
+ *             history_items    - [IN]                                        *
+ *             history_errcodes - [IN]                                        *
+ *             itemids          - [IN] the other function items               *
+ *             items            - [IN]                                        *
+ *             errcodes         - [IN]                                        *
+ *                                                                            *
+ * Comments: Without prefetching the value cache misses of every item are     *
+ *           read from history storage one item at a time and trend functions *
+ *           are evaluated with one query per item.                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_prefetch_item_functions_data(zbx_hashset_t *funcs, const zbx_vector_uint64_t *history_itemids,
+		const DC_ITEM *history_items, const int *history_errcodes, const zbx_vector_uint64_t *itemids,
+		const DC_ITEM *items, const int *errcodes)
+{
+	int				i;
+	zbx_func_t			*func;
+	zbx_hashset_iter_t		iter;
+	zbx_vector_vc_prefetch_t	requests;
+	zbx_vector_trend_prefetch_t	trend_requests;
+
+	zbx_vector_vc_prefetch_create(&requests);
+	zbx_vector_trend_prefetch_create(&trend_requests);
+
+	zbx_hashset_iter_reset(funcs, &iter);
+	while (NULL != (func = (zbx_func_t *)zbx_hashset_iter_next(&iter)))
+	{
+		int			errcode;
+		const DC_ITEM		*item;
+		zbx_vc_prefetch_t	request;
+		zbx_trend_prefetch_t	trend_request;
+
+		if (NULL != func->error)
+			continue;
+
+		if (FAIL != (i = zbx_vector_uint64_bsearch(history_itemids, func->itemid,
+				ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
+		{
+			item = history_items + i;
+			errcode = history_errcodes[i];
+		}
+		else
+		{
+			i = zbx_vector_uint64_bsearch(itemids, func->itemid, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+			item = items + i;
+			errcode = errcodes[i];
+		}
+
+		if (SUCCEED != errcode || ITEM_STATUS_ACTIVE != item->status ||
+				HOST_STATUS_MONITORED != item->host.status)
+		{
+			continue;
+		}
+
+		if (SUCCEED == zbx_get_function_history_period(func->function, func->parameter, &func->timespec,
+				&request.seconds, &request.ts))
+		{
+			request.itemid = item->itemid;
+			request.value_type = item->value_type;
+			zbx_vector_vc_prefetch_append(&requests, request);
+			continue;
+		}
+
+		switch (item->value_type)
+		{
+			case ITEM_VALUE_TYPE_FLOAT:
+				trend_request.table = "trends";
+				break;
+			case ITEM_VALUE_TYPE_UINT64:
+				trend_request.table = "trends_uint";
+				break;
+			default:
+				continue;
+		}
+
+		if (SUCCEED == zbx_get_function_trends_period(func->function, func->parameter, &func->timespec,
+				&trend_request.start, &trend_request.end))
+		{
+			trend_request.itemid = item->itemid;
+			trend_request.function = func->function + 5;
+			zbx_vector_trend_prefetch_append(&trend_requests, trend_request);
+		}
+	}
+
+	if (1 < requests.values_num)
+		zbx_vc_prefetch_values(&requests);
+
+	if (1 < trend_requests.values_num)
+		zbx_trends_prefetch_values(&trend_requests);
+
+	zbx_vector_trend_prefetch_destroy(&trend_requests);
+	zbx_vector_vc_prefetch_destroy(&requests);
+}
+
 static void	zbx_evaluate_item_functions(zbx_hashset_t *funcs, const zbx_vector_uint64_t *history_itemids,
 		const DC_ITEM *history_items, const int *history_errcodes)
 {
@@ -5259,6 +5363,9 @@ static void	zbx_evaluate_item_functions(zbx_hashset_t *funcs, const zbx_vector_u
 				ZBX_ITEM_GET_SYNC);
 	}
 
+	zbx_prefetch_item_functions_data(funcs, history_itemids, history_items, history_errcodes, &itemids, items,
+			errcodes);
+
 	zbx_hashset_iter_reset(funcs, &iter);
 	while (NULL != (func = (zbx_func_t *)zbx_hashset_iter_next(&iter)))
 	{
@@ -126,6 +126,8 @@ void	zbx_get_zabbix_stats(struct zbx_json *json)
 		zbx_json_adduint64(json, "used", wcache_info.trend_total - wcache_info.trend_free);
 		zbx_json_addfloat(json, "pused", 100 * (double)(wcache_info.trend_total - wcache_info.trend_free) /
 				wcache_info.trend_total);
+		zbx_json_adduint64(json, "queue", wcache_info.trend_queue);
+		zbx_json_adduint64(json, "lag", wcache_info.trend_lag);
 		zbx_json_close(json);
 	}
 
@@ -27,6 +27,13 @@
 
 extern zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE;
 
+typedef union
+{
+	double		dbl;		/* the trends function value */
+	zbx_uint32_t	partial;	/* index of the partial aggregate in partials pool */
+}
+zbx_tfc_value_t;
+
 typedef struct
 {
 	zbx_uint64_t		itemid;		/* the itemid */
@@ -34,7 +41,7 @@ typedef struct
 	int			end;		/* the period end time */
 	zbx_trend_function_t	function;	/* the trends function */
 	zbx_trend_state_t	state;		/* the cached value state */
-	double			value;		/* the cached value */
+	zbx_tfc_value_t		value;		/* the cached value */
 	zbx_uint32_t		prev;		/* index of the previous LRU list or unused entry */
 	zbx_uint32_t		next;		/* index of the next LRU list or unused entry */
 	zbx_uint32_t		prev_value;	/* index of the previous value list */
@@ -49,28 +56,45 @@ typedef struct
 }
 zbx_tfc_slot_t;
 
+/* the partial aggregates are kept in separate pool to keep the slots small */
+typedef struct
+{
+	zbx_trend_partial_t	partial;	/* the partial aggregate of trend records */
+	zbx_uint32_t		slot;		/* index of the slot referencing the partial aggregate */
+	zbx_uint32_t		prev;		/* index of the previous LRU list entry */
+	zbx_uint32_t		next;		/* index of the next LRU list or unused entry */
+}
+zbx_tfc_partial_t;
+
 typedef struct
 {
-	zbx_hashset_t	index;
-	zbx_tfc_slot_t	*slots;
-	zbx_uint32_t	slots_num;
-	zbx_uint32_t	free_slot;
-	zbx_uint32_t	free_head;
-	zbx_uint32_t	lru_head;
-	zbx_uint32_t	lru_tail;
-	zbx_uint64_t	hits;
-	zbx_uint64_t	misses;
-	zbx_uint64_t	items_num;
+	zbx_hashset_t		index;
+	zbx_tfc_slot_t		*slots;
+	zbx_uint32_t		slots_num;
+	zbx_uint32_t		free_slot;
+	zbx_uint32_t		free_head;
+	zbx_uint32_t		lru_head;
+	zbx_uint32_t		lru_tail;
+	zbx_tfc_partial_t	*partials;
+	zbx_uint32_t		partials_num;
+	zbx_uint32_t		partials_free_slot;
+	zbx_uint32_t		partials_free_head;
+	zbx_uint32_t		partials_lru_head;
+	zbx_uint32_t		partials_lru_tail;
+	zbx_uint64_t		hits;
+	zbx_uint64_t		misses;
+	zbx_uint64_t		items_num;
 }
 zbx_tfc_t;
 
 static zbx_tfc_t	*cache = NULL;
 
 /*
- * The shared memory is split in three parts:
+ * The shared memory is split in four parts:
  *   1) header, containing cache information
  *   2) indexing hashset slots pointer array, allocated during cache initialization
  *   3) slots array, allocated during cache initialization and used for hashset entry allocations
+ *   4) partial aggregates array, allocated during cache initialization and referenced by partial aggregate slots
  */
 static zbx_mem_info_t	*tfc_mem = NULL;
 
@@ -261,6 +285,67 @@ static void	tfc_value_remove(zbx_tfc_data_t *data)
 	cache->slots[data->next_value].data.prev_value = data->prev_value;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: tfc_partial_lru_append                                           *
+ *                                                                            *
+ * Purpose: append partial aggregate to the tail of least recently used       *
+ *          partial aggregate list                                            *
+ *                                                                            *
+ ******************************************************************************/
+static void	tfc_partial_lru_append(zbx_uint32_t index)
+{
+	zbx_tfc_partial_t	*partial = &cache->partials[index];
+
+	partial->prev = cache->partials_lru_tail;
+	partial->next = UINT32_MAX;
+
+	if (UINT32_MAX != partial->prev)
+		cache->partials[partial->prev].next = index;
+	else
+		cache->partials_lru_head = index;
+
+	cache->partials_lru_tail = index;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: tfc_partial_lru_remove                                           *
+ *                                                                            *
+ * Purpose: remove partial aggregate from least recently used partial         *
+ *          aggregate list                                                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	tfc_partial_lru_remove(zbx_uint32_t index)
+{
+	zbx_tfc_partial_t	*partial = &cache->partials[index];
+
+	if (UINT32_MAX != partial->prev)
+		cache->partials[partial->prev].next = partial->next;
+	else
+		cache->partials_lru_head = partial->next;
+
+	if (UINT32_MAX != partial->next)
+		cache->partials[partial->next].prev = partial->prev;
+	else
+		cache->partials_lru_tail = partial->prev;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: tfc_partial_free                                                 *
+ *                                                                            *
+ * Purpose: return partial aggregate to the unused partial aggregate list     *
+ *                                                                            *
+ ******************************************************************************/
+static void	tfc_partial_free(zbx_uint32_t index)
+{
+	tfc_partial_lru_remove(index);
+
+	cache->partials[index].next = cache->partials_free_head;
+	cache->partials_free_head = index;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: tfc_free_data                                                    *
@@ -273,6 +358,9 @@ static void	tfc_free_data(zbx_tfc_data_t *data)
 	tfc_lru_remove(data);
 	tfc_value_remove(data);
 
+	if (ZBX_TREND_FUNCTION_PARTIAL == data->function)
+		tfc_partial_free(data->value.partial);
+
 	if (data->prev_value == data->next_value)
 	{
 		zbx_hashset_remove_direct(&cache->index, &cache->slots[data->prev_value].data);
@@ -303,6 +391,51 @@ static void	tfc_reserve_slot(void)
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: tfc_partial_alloc                                                *
+ *                                                                            *
+ * Purpose: allocate partial aggregate for the slot                           *
+ *                                                                            *
+ * Parameters: slot - [IN] index of the slot referencing partial aggregate    *
+ *                                                                            *
+ * Return value: index of the allocated partial aggregate                     *
+ *                                                                            *
+ * Comments: When the partial aggregate pool is full the least recently used  *
+ *           partial aggregate is removed from cache together with its slot.  *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint32_t	tfc_partial_alloc(zbx_uint32_t slot)
+{
+	zbx_uint32_t	index;
+
+	if (cache->partials_free_slot != cache->partials_num)
+	{
+		index = cache->partials_free_slot++;
+	}
+	else
+	{
+		if (UINT32_MAX == cache->partials_free_head)
+		{
+			if (UINT32_MAX == cache->partials_lru_head)
+			{
+				THIS_SHOULD_NEVER_HAPPEN;
+				exit(EXIT_FAILURE);
+			}
+
+			tfc_free_data(&cache->slots[cache->partials[cache->partials_lru_head].slot].data);
+		}
+
+		index = cache->partials_free_head;
+		cache->partials_free_head = cache->partials[index].next;
+	}
+
+	cache->partials[index].slot = slot;
+	tfc_partial_lru_append(index);
+
+	return index;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: tfc_index_add                                                    *
@@ -368,14 +501,18 @@ int	zbx_tfc_init(char **error)
 
 	cache =  (zbx_tfc_t *)__tfc_mem_realloc_func(NULL, sizeof(zbx_tfc_t));
 
-	/* (8 + 8) * 3 - overhead for 3 allocations */
-	CONFIG_TREND_FUNC_CACHE_SIZE -= size_reserved + sizeof(zbx_tfc_t) + (8 + 8) * 3;
+	/* (8 + 8) * 4 - overhead for 4 allocations */
+	CONFIG_TREND_FUNC_CACHE_SIZE -= size_reserved + sizeof(zbx_tfc_t) + (8 + 8) * 4;
+
+	/* a quarter of the cache is used for daily partial aggregates, each also taking a slot */
+	cache->partials_num = CONFIG_TREND_FUNC_CACHE_SIZE / 4 / sizeof(zbx_tfc_partial_t);
+	CONFIG_TREND_FUNC_CACHE_SIZE -= cache->partials_num * sizeof(zbx_tfc_partial_t);
 
 	/* 5/4 - reversing critical load factor which is accounted for when inserting new hashset entry */
 	/* but ignored when creating hashset with the specified size                                    */
 	cache->slots_num = CONFIG_TREND_FUNC_CACHE_SIZE / (16 * 5 / 4 + sizeof(zbx_tfc_slot_t));
 
-	zabbix_log(LOG_LEVEL_DEBUG, "%s(): slots:%u", __func__, cache->slots_num);
+	zabbix_log(LOG_LEVEL_DEBUG, "%s(): slots:%u partials:%u", __func__, cache->slots_num, cache->partials_num);
 
 	zbx_hashset_create_ext(&cache->index, cache->slots_num, tfc_hash_func, tfc_compare_func,
 			NULL, tfc_malloc_func, tfc_realloc_func, tfc_free_func);
@@ -387,6 +524,13 @@ int	zbx_tfc_init(char **error)
 	cache->free_head = UINT32_MAX;
 	cache->free_slot = 0;
 
+	cache->partials = (zbx_tfc_partial_t *)__tfc_mem_malloc_func(NULL,
+			sizeof(zbx_tfc_partial_t) * cache->partials_num);
+	cache->partials_free_slot = 0;
+	cache->partials_free_head = UINT32_MAX;
+	cache->partials_lru_head = UINT32_MAX;
+	cache->partials_lru_tail = UINT32_MAX;
+
 	cache->hits = 0;
 	cache->misses = 0;
 	cache->items_num = 0;
@@ -400,7 +544,7 @@ out:
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_tfc_get_value                                                *
+ * Function: tfc_get_value                                                    *
  *                                                                            *
  * Purpose: get value and state from trend function cache                     *
  *                                                                            *
@@ -409,14 +553,16 @@ out:
  *             end      - [IN] the period end time (including)                *
  *             function - [IN] the trend function                             *
  *             value    - [OUT] the cached value                              *
+ *             partial  - [OUT] the cached partial aggregate, used instead of *
+ *                              value for partial aggregate function          *
  *             state    - [OUT] the cached state                              *
  *                                                                            *
  * Return value: SUCCEED - the value/state was retrieved successfully         *
  *               FAIL - no cached item value of the function over the range   *
  *                                                                            *
  ******************************************************************************/
-int	zbx_tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double *value,
-		zbx_trend_state_t *state)
+static int	tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double *value,
+		zbx_trend_partial_t *partial, zbx_trend_state_t *state)
 {
 	zbx_tfc_data_t	*data, data_local;
 
@@ -437,7 +583,16 @@ int	zbx_tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_functio
 		tfc_lru_remove(data);
 		tfc_lru_append(data);
 
-		*value = data->value;
+		if (ZBX_TREND_FUNCTION_PARTIAL == function)
+		{
+			tfc_partial_lru_remove(data->value.partial);
+			tfc_partial_lru_append(data->value.partial);
+
+			*partial = cache->partials[data->value.partial].partial;
+		}
+		else
+			*value = data->value.dbl;
+
 		*state = data->state;
 
 		cache->hits++;
@@ -454,7 +609,7 @@ int	zbx_tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_functio
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_tfc_put_value                                                *
+ * Function: tfc_put_value                                                    *
  *                                                                            *
  * Purpose: put value and state from trend function cache                     *
  *                                                                            *
@@ -463,11 +618,13 @@ int	zbx_tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_functio
  *             end      - [IN] the period end time (including)                *
  *             function - [IN] the trend function                             *
  *             value    - [IN] the value to cache                             *
+ *             partial  - [IN] the partial aggregate to cache, used instead   *
+ *                             of value for partial aggregate function        *
  *             state    - [IN] the state to cache                             *
  *                                                                            *
  ******************************************************************************/
-void	zbx_tfc_put_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double value,
-		zbx_trend_state_t state)
+static void	tfc_put_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double value,
+		const zbx_trend_partial_t *partial, zbx_trend_state_t state)
 {
 	zbx_tfc_data_t	*data, data_local, *root;
 
@@ -503,14 +660,165 @@ void	zbx_tfc_put_value(zbx_uint64_t itemid, int start, int end, zbx_trend_functi
 		/* new slot was allocated, link it */
 		tfc_lru_append(data);
 		tfc_value_append(root, data);
+
+		if (ZBX_TREND_FUNCTION_PARTIAL == function)
+			data->value.partial = tfc_partial_alloc(tfc_data_slot_index(data));
+	}
+	else if (ZBX_TREND_FUNCTION_PARTIAL == function)
+	{
+		tfc_partial_lru_remove(data->value.partial);
+		tfc_partial_lru_append(data->value.partial);
 	}
 
-	data->value = value;
+	if (ZBX_TREND_FUNCTION_PARTIAL == function)
+		cache->partials[data->value.partial].partial = *partial;
+	else
+		data->value.dbl = value;
+
 	data->state = state;
 
 	UNLOCK_CACHE;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tfc_get_value                                                *
+ *                                                                            *
+ * Purpose: get value and state from trend function cache                     *
+ *                                                                            *
+ * Parameters: itemid   - [IN] the itemid                                     *
+ *             start    - [IN] the period start time (including)              *
+ *             end      - [IN] the period end time (including)                *
+ *             function - [IN] the trend function                             *
+ *             value    - [OUT] the cached value                              *
+ *             state    - [OUT] the cached state                              *
+ *                                                                            *
+ * Return value: SUCCEED - the value/state was retrieved successfully         *
+ *               FAIL - no cached item value of the function over the range   *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double *value,
+		zbx_trend_state_t *state)
+{
+	return tfc_get_value(itemid, start, end, function, value, NULL, state);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tfc_put_value                                                *
+ *                                                                            *
+ * Purpose: put value and state from trend function cache                     *
+ *                                                                            *
+ * Parameters: itemid   - [IN] the itemid                                     *
+ *             start    - [IN] the period start time (including)              *
+ *             end      - [IN] the period end time (including)                *
+ *             function - [IN] the trend function                             *
+ *             value    - [IN] the value to cache                             *
+ *             state    - [IN] the state to cache                             *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_tfc_put_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double value,
+		zbx_trend_state_t state)
+{
+	tfc_put_value(itemid, start, end, function, value, NULL, state);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tfc_has_value                                                *
+ *                                                                            *
+ * Purpose: check if trend function cache contains item value of the          *
+ *          function over the range                                           *
+ *                                                                            *
+ * Parameters: itemid   - [IN] the itemid                                     *
+ *             start    - [IN] the period start time (including)              *
+ *             end      - [IN] the period end time (including)                *
+ *             function - [IN] the trend function                             *
+ *                                                                            *
+ * Return value: SUCCEED - the value is cached                                *
+ *               FAIL - no cached item value of the function over the range   *
+ *                                                                            *
+ * Comments: Unlike zbx_tfc_get_value() this function does not update cache   *
+ *           statistics and least recently used list.                         *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tfc_has_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function)
+{
+	zbx_tfc_data_t	*data, data_local;
+
+	if (NULL == cache)
+		return FAIL;
+
+	data_local.itemid = itemid;
+	data_local.start = start;
+	data_local.end = end;
+	data_local.function = function;
+
+	LOCK_CACHE;
+	data = (zbx_tfc_data_t *)zbx_hashset_search(&cache->index, &data_local);
+	UNLOCK_CACHE;
+
+	return NULL != data ? SUCCEED : FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tfc_get_partial                                              *
+ *                                                                            *
+ * Purpose: get partial aggregate of item trend records from trend function   *
+ *          cache                                                             *
+ *                                                                            *
+ * Parameters: itemid  - [IN] the itemid                                      *
+ *             start   - [IN] the period start time (including)               *
+ *             end     - [IN] the period end time (including)                 *
+ *             partial - [OUT] the cached partial aggregate                   *
+ *                                                                            *
+ * Return value: SUCCEED - the partial aggregate was retrieved successfully   *
+ *               FAIL - no cached partial aggregate over the range            *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tfc_get_partial(zbx_uint64_t itemid, int start, int end, zbx_trend_partial_t *partial)
+{
+	zbx_trend_state_t	state;
+
+	return tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_PARTIAL, NULL, partial, &state);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tfc_put_partial                                              *
+ *                                                                            *
+ * Purpose: put partial aggregate of item trend records into trend function   *
+ *          cache                                                             *
+ *                                                                            *
+ * Parameters: itemid  - [IN] the itemid                                      *
+ *             start   - [IN] the period start time (including)               *
+ *             end     - [IN] the period end time (including)                 *
+ *             partial - [IN] the partial aggregate to cache                  *
+ *                                                                            *
+ * Comments: The partial aggregate is invalidated together with trends        *
+ *           function values when trends within its period are updated.       *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_tfc_put_partial(zbx_uint64_t itemid, int start, int end, const zbx_trend_partial_t *partial)
+{
+	tfc_put_value(itemid, start, end, ZBX_TREND_FUNCTION_PARTIAL, 0, partial,
+			0 != partial->num ? ZBX_TREND_STATE_NORMAL : ZBX_TREND_STATE_NODATA);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_tfc_is_enabled                                               *
+ *                                                                            *
+ * Return value: SUCCEED - trend function cache is enabled                    *
+ *               FAIL - otherwise                                             *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_tfc_is_enabled(void)
+{
+	return NULL != cache ? SUCCEED : FAIL;
+}
+
 void	zbx_tfc_invalidate_trends(ZBX_DC_TREND *trends, int trends_num)
 {
 	zbx_tfc_data_t	*root, *data, data_local;
@@ -22,6 +22,37 @@
 #include "log.h"
 #include "zbxtrends.h"
 #include "trends.h"
+#include "../zbxalgo/vectorimpl.h"
+
+#define ZBX_TRENDS_PREFETCH_BATCH_SIZE	1000
+
+ZBX_VECTOR_IMPL(trend_prefetch, zbx_trend_prefetch_t)
+
+/* aggregate of item trend records, used in batched function evaluation */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	double		value;
+	double		num;
+}
+zbx_trend_aggregate_t;
+
+/* item trend records of a period aggregated from daily partial aggregates */
+typedef struct
+{
+	zbx_uint64_t		itemid;
+
+	/* the aggregate of all records */
+	zbx_trend_partial_t	total;
+
+	/* the daily aggregates and 1 for the days taken from cache, 0 otherwise */
+	zbx_trend_partial_t	*days;
+	unsigned char		*cached;
+
+	/* the clock condition of records to be read from database, NULL if there are none */
+	char			*clock_sql;
+}
+zbx_trend_partials_t;
 
 static char	*trends_errors[ZBX_TREND_STATE_COUNT] = {
 		"unknown error",
@@ -583,13 +614,364 @@ static zbx_trend_state_t	trends_eval_sum(const char *table, zbx_uint64_t itemid,
 	return ZBX_TREND_STATE_NORMAL;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partial_add                                               *
+ *                                                                            *
+ * Purpose: add partial aggregate to the total                                *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_partial_add(zbx_trend_partial_t *total, const zbx_trend_partial_t *partial)
+{
+	if (0 == partial->num)
+		return;
+
+	if (0 == total->num)
+	{
+		*total = *partial;
+		return;
+	}
+
+	total->sum += partial->sum;
+	total->num += partial->num;
+
+	if (partial->min < total->min)
+		total->min = partial->min;
+
+	if (partial->max > total->max)
+		total->max = partial->max;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partial_period                                            *
+ *                                                                            *
+ * Purpose: get whole days of the period that can be aggregated from daily    *
+ *          partial aggregates                                                *
+ *                                                                            *
+ * Parameters: start      - [IN] the period start time (including)            *
+ *             end        - [IN] the period end time (including)              *
+ *             days_start - [OUT] the start time of the first whole day       *
+ *             days_num   - [OUT] the number of whole days                    *
+ *                                                                            *
+ * Return value: SUCCEED - the whole days were found                          *
+ *               FAIL    - trend function cache is disabled or the period     *
+ *                         does not contain whole days                        *
+ *                                                                            *
+ ******************************************************************************/
+static int	trends_partial_period(int start, int end, int *days_start, int *days_num)
+{
+	if (SUCCEED != zbx_tfc_is_enabled())
+		return FAIL;
+
+	/* the trend records of a day have hour aligned clocks from its start till one hour before its end */
+	*days_start = start + SEC_PER_DAY - 1 - (start + SEC_PER_DAY - 1) % SEC_PER_DAY;
+
+	if (end < *days_start + SEC_PER_DAY - SEC_PER_HOUR)
+		return FAIL;
+
+	*days_num = (end - *days_start - SEC_PER_DAY + SEC_PER_HOUR) / SEC_PER_DAY + 1;
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partials_add_range                                        *
+ *                                                                            *
+ * Purpose: add clock range of records to be read from database               *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_partials_add_range(zbx_trend_partials_t *partials, size_t *sql_alloc, size_t *sql_offset,
+		int start, int end)
+{
+	if (0 != *sql_offset)
+		zbx_strcpy_alloc(&partials->clock_sql, sql_alloc, sql_offset, " or ");
+
+	zbx_snprintf_alloc(&partials->clock_sql, sql_alloc, sql_offset, "clock>=%d and clock<=%d", start, end);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partials_init                                             *
+ *                                                                            *
+ * Purpose: aggregate whole days of the period from daily partial aggregates  *
+ *          in trend function cache and get the clock condition of the        *
+ *          remaining records                                                 *
+ *                                                                            *
+ * Parameters: partials   - [OUT] the partial aggregates                      *
+ *             itemid     - [IN] the itemid                                   *
+ *             start      - [IN] the period start time (including)            *
+ *             end        - [IN] the period end time (including)              *
+ *             days_start - [IN] the start time of the first whole day        *
+ *             days_num   - [IN] the number of whole days                     *
+ *                                                                            *
+ * Comments: Records of the days missing in cache and of the partial days at  *
+ *           the period edges must be read from database. Adjacent ranges are *
+ *           merged into single range.                                        *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_partials_init(zbx_trend_partials_t *partials, zbx_uint64_t itemid, int start, int end,
+		int days_start, int days_num)
+{
+	int	i, day, fetch_start = -1, fetch_end = 0;
+	size_t	sql_alloc = 0, sql_offset = 0;
+
+	partials->itemid = itemid;
+	partials->days = (zbx_trend_partial_t *)zbx_malloc(NULL, sizeof(zbx_trend_partial_t) * (size_t)days_num);
+	partials->cached = (unsigned char *)zbx_malloc(NULL, (size_t)days_num);
+	partials->clock_sql = NULL;
+
+	memset(&partials->total, 0, sizeof(zbx_trend_partial_t));
+
+	if (start < days_start)
+	{
+		fetch_start = start;
+		fetch_end = days_start - 1;
+	}
+
+	for (i = 0; i < days_num; i++)
+	{
+		day = days_start + i * SEC_PER_DAY;
+
+		if (SUCCEED == zbx_tfc_get_partial(itemid, day, day + SEC_PER_DAY - 1, &partials->days[i]))
+		{
+			partials->cached[i] = 1;
+
+			if (-1 != fetch_start)
+			{
+				trends_partials_add_range(partials, &sql_alloc, &sql_offset, fetch_start, fetch_end);
+				fetch_start = -1;
+			}
+
+			trends_partial_add(&partials->total, &partials->days[i]);
+		}
+		else
+		{
+			partials->cached[i] = 0;
+			memset(&partials->days[i], 0, sizeof(zbx_trend_partial_t));
+
+			if (-1 == fetch_start)
+				fetch_start = day;
+
+			fetch_end = day + SEC_PER_DAY - 1;
+		}
+	}
+
+	if ((day = days_start + days_num * SEC_PER_DAY) <= end)
+	{
+		if (-1 == fetch_start)
+			fetch_start = day;
+
+		fetch_end = end;
+	}
+
+	if (-1 != fetch_start)
+		trends_partials_add_range(partials, &sql_alloc, &sql_offset, fetch_start, fetch_end);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partials_add_row                                          *
+ *                                                                            *
+ * Purpose: add trend record read from database to the partial aggregates     *
+ *                                                                            *
+ * Parameters: partials   - [IN/OUT] the partial aggregates                   *
+ *             row        - [IN] the record clock, num, value_avg, value_min  *
+ *                               and value_max                                *
+ *             days_start - [IN] the start time of the first whole day        *
+ *             days_num   - [IN] the number of whole days                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_partials_add_row(zbx_trend_partials_t *partials, DB_ROW row, int days_start, int days_num)
+{
+	zbx_trend_partial_t	record;
+	int			clock, day;
+
+	clock = atoi(row[0]);
+	record.num = atof(row[1]);
+	record.sum = atof(row[2]) * record.num;
+	record.min = atof(row[3]);
+	record.max = atof(row[4]);
+
+	trends_partial_add(&partials->total, &record);
+
+	if (clock < days_start || days_num <= (day = (clock - days_start) / SEC_PER_DAY) || 0 != partials->cached[day])
+		return;
+
+	trends_partial_add(&partials->days[day], &record);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partials_clear                                            *
+ *                                                                            *
+ * Purpose: cache the daily partial aggregates read from database and free    *
+ *          the partial aggregates                                            *
+ *                                                                            *
+ * Parameters: partials   - [IN] the partial aggregates                       *
+ *             days_start - [IN] the start time of the first whole day        *
+ *             days_num   - [IN] the number of whole days                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_partials_clear(zbx_trend_partials_t *partials, int days_start, int days_num)
+{
+	int	i, day;
+
+	for (i = 0; i < days_num; i++)
+	{
+		if (0 == partials->cached[i])
+		{
+			day = days_start + i * SEC_PER_DAY;
+			zbx_tfc_put_partial(partials->itemid, day, day + SEC_PER_DAY - 1, &partials->days[i]);
+		}
+	}
+
+	zbx_free(partials->clock_sql);
+	zbx_free(partials->cached);
+	zbx_free(partials->days);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_eval_partial                                              *
+ *                                                                            *
+ * Purpose: aggregate trend records of the specified period, using daily      *
+ *          partial aggregates from trend function cache                      *
+ *                                                                            *
+ * Parameters: table  - [IN] the trends table name                            *
+ *             itemid - [IN] the itemid                                       *
+ *             start  - [IN] the period start time (including)                *
+ *             end    - [IN] the period end time (including)                  *
+ *             total  - [OUT] the aggregate of trend records                  *
+ *                                                                            *
+ * Return value: SUCCEED - the records were aggregated                        *
+ *               FAIL    - trend function cache is disabled or the period     *
+ *                         does not contain whole days                        *
+ *                                                                            *
+ * Comments: Whole days within the period are taken from cache. Records of    *
+ *           the days missing in cache and of the partial days at the period  *
+ *           edges are read from database with single query. The missing      *
+ *           daily aggregates are cached.                                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	trends_eval_partial(const char *table, zbx_uint64_t itemid, int start, int end,
+		zbx_trend_partial_t *total)
+{
+	DB_RESULT		result;
+	DB_ROW			row;
+	int			days_start, days_num;
+	zbx_trend_partials_t	partials;
+
+	if (SUCCEED != trends_partial_period(start, end, &days_start, &days_num))
+		return FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() itemid:" ZBX_FS_UI64 " period:%d-%d days:%d", __func__, itemid, start,
+			end, days_num);
+
+	trends_partials_init(&partials, itemid, start, end, days_start, days_num);
+
+	if (NULL != partials.clock_sql)
+	{
+		result = DBselect(
+				"select clock,num,value_avg,value_min,value_max from %s"
+				" where itemid=" ZBX_FS_UI64
+					" and (%s)",
+				table, itemid, partials.clock_sql);
+
+		while (NULL != (row = DBfetch(result)))
+			trends_partials_add_row(&partials, row, days_start, days_num);
+
+		DBfree_result(result);
+	}
+
+	*total = partials.total;
+	trends_partials_clear(&partials, days_start, days_num);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() num:" ZBX_FS_DBL, __func__, total->num);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_partial_eval                                              *
+ *                                                                            *
+ * Purpose: evaluate trend function from aggregate of trend records           *
+ *                                                                            *
+ * Parameters: function - [IN] the trend function                             *
+ *             total    - [IN] the aggregate of trend records                 *
+ *             value    - [OUT] the evaluation result                         *
+ *                                                                            *
+ * Return value: Trend value state of the specified period and function.      *
+ *               ZBX_TREND_STATE_UNKNOWN is returned if the function must be  *
+ *               evaluated with trend records instead.                        *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_trend_state_t	trends_partial_eval(zbx_trend_function_t function, const zbx_trend_partial_t *total,
+		double *value)
+{
+	if (0 == total->num)
+	{
+		if (ZBX_TREND_FUNCTION_COUNT != function && ZBX_TREND_FUNCTION_SUM != function)
+			return ZBX_TREND_STATE_NODATA;
+
+		*value = 0;
+
+		return ZBX_TREND_STATE_NORMAL;
+	}
+
+	switch (function)
+	{
+		case ZBX_TREND_FUNCTION_AVG:
+			/* sum overflow, fall back to weighted average of trend records */
+			if (ZBX_INFINITY == total->sum || -ZBX_INFINITY == total->sum)
+				return ZBX_TREND_STATE_UNKNOWN;
+
+			*value = total->sum / total->num;
+			break;
+		case ZBX_TREND_FUNCTION_COUNT:
+			*value = total->num;
+			break;
+		case ZBX_TREND_FUNCTION_DELTA:
+			*value = total->max - total->min;
+			break;
+		case ZBX_TREND_FUNCTION_MAX:
+			*value = total->max;
+			break;
+		case ZBX_TREND_FUNCTION_MIN:
+			*value = total->min;
+			break;
+		case ZBX_TREND_FUNCTION_SUM:
+			if (ZBX_INFINITY == total->sum)
+				return ZBX_TREND_STATE_OVERFLOW;
+
+			*value = total->sum;
+			break;
+		default:
+			THIS_SHOULD_NEVER_HAPPEN;
+			return ZBX_TREND_STATE_UNKNOWN;
+	}
+
+	return ZBX_TREND_STATE_NORMAL;
+}
+
 int	zbx_trends_eval_avg(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error)
 {
 	zbx_trend_state_t	state;
+	zbx_trend_partial_t	partial;
 
 	if (FAIL == zbx_tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_AVG, value, &state))
 	{
-		state = trends_eval_avg(table, itemid, start, end, value);
+		state = ZBX_TREND_STATE_UNKNOWN;
+
+		if (SUCCEED == trends_eval_partial(table, itemid, start, end, &partial))
+			state = trends_partial_eval(ZBX_TREND_FUNCTION_AVG, &partial, value);
+
+		/* fall back to trend records if the partial aggregate cannot be used */
+		if (ZBX_TREND_STATE_UNKNOWN == state)
+			state = trends_eval_avg(table, itemid, start, end, value);
+
 		zbx_tfc_put_value(itemid, start, end, ZBX_TREND_FUNCTION_AVG, *value, state);
 	}
 
@@ -605,12 +987,18 @@ int	zbx_trends_eval_avg(const char *table, zbx_uint64_t itemid, int start, int e
 int	zbx_trends_eval_count(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error)
 {
 	zbx_trend_state_t	state;
+	zbx_trend_partial_t	partial;
 
 	ZBX_UNUSED(error);
 
 	if (FAIL == zbx_tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_COUNT, value, &state))
 	{
-		if (ZBX_TREND_STATE_NORMAL != (state = trends_eval(table, itemid, start, end, "num", "sum(num)", value)))
+		if (SUCCEED == trends_eval_partial(table, itemid, start, end, &partial))
+			state = trends_partial_eval(ZBX_TREND_FUNCTION_COUNT, &partial, value);
+		else
+			state = trends_eval(table, itemid, start, end, "num", "sum(num)", value);
+
+		if (ZBX_TREND_STATE_NORMAL != state)
 		{
 			state = ZBX_TREND_STATE_NORMAL;
 			*value = 0;
@@ -625,11 +1013,18 @@ int	zbx_trends_eval_count(const char *table, zbx_uint64_t itemid, int start, int
 int	zbx_trends_eval_delta(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error)
 {
 	zbx_trend_state_t	state;
+	zbx_trend_partial_t	partial;
 
 	if (FAIL == zbx_tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_DELTA, value, &state))
 	{
-		state = trends_eval(table, itemid, start, end, "value_max-value_min", "max(value_max)-min(value_min)",
-				value);
+		if (SUCCEED == trends_eval_partial(table, itemid, start, end, &partial))
+			state = trends_partial_eval(ZBX_TREND_FUNCTION_DELTA, &partial, value);
+		else
+		{
+			state = trends_eval(table, itemid, start, end, "value_max-value_min",
+					"max(value_max)-min(value_min)", value);
+		}
+
 		zbx_tfc_put_value(itemid, start, end, ZBX_TREND_FUNCTION_DELTA, *value, state);
 	}
 
@@ -645,10 +1040,15 @@ int	zbx_trends_eval_delta(const char *table, zbx_uint64_t itemid, int start, int
 int	zbx_trends_eval_max(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error)
 {
 	zbx_trend_state_t	state;
+	zbx_trend_partial_t	partial;
 
 	if (FAIL == zbx_tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_MAX, value, &state))
 	{
-		state = trends_eval(table, itemid, start, end, "value_max", "max(value_max)", value);
+		if (SUCCEED == trends_eval_partial(table, itemid, start, end, &partial))
+			state = trends_partial_eval(ZBX_TREND_FUNCTION_MAX, &partial, value);
+		else
+			state = trends_eval(table, itemid, start, end, "value_max", "max(value_max)", value);
+
 		zbx_tfc_put_value(itemid, start, end, ZBX_TREND_FUNCTION_MAX, *value, state);
 	}
 
@@ -664,10 +1064,15 @@ int	zbx_trends_eval_max(const char *table, zbx_uint64_t itemid, int start, int e
 int	zbx_trends_eval_min(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error)
 {
 	zbx_trend_state_t	state;
+	zbx_trend_partial_t	partial;
 
 	if (FAIL == zbx_tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_MIN, value, &state))
 	{
-		state = trends_eval(table, itemid, start, end, "value_min", "min(value_min)", value);
+		if (SUCCEED == trends_eval_partial(table, itemid, start, end, &partial))
+			state = trends_partial_eval(ZBX_TREND_FUNCTION_MIN, &partial, value);
+		else
+			state = trends_eval(table, itemid, start, end, "value_min", "min(value_min)", value);
+
 		zbx_tfc_put_value(itemid, start, end, ZBX_TREND_FUNCTION_MIN, *value, state);
 	}
 
@@ -683,10 +1088,15 @@ int	zbx_trends_eval_min(const char *table, zbx_uint64_t itemid, int start, int e
 int	zbx_trends_eval_sum(const char *table, zbx_uint64_t itemid, int start, int end, double *value, char **error)
 {
 	zbx_trend_state_t	state;
+	zbx_trend_partial_t	partial;
 
 	if (FAIL == zbx_tfc_get_value(itemid, start, end, ZBX_TREND_FUNCTION_SUM, value, &state))
 	{
-		state = trends_eval_sum(table, itemid, start, end, value);
+		if (SUCCEED == trends_eval_partial(table, itemid, start, end, &partial))
+			state = trends_partial_eval(ZBX_TREND_FUNCTION_SUM, &partial, value);
+		else
+			state = trends_eval_sum(table, itemid, start, end, value);
+
 		zbx_tfc_put_value(itemid, start, end, ZBX_TREND_FUNCTION_SUM, *value, state);
 	}
 
@@ -698,3 +1108,393 @@ int	zbx_trends_eval_sum(const char *table, zbx_uint64_t itemid, int start, int e
 
 	return FAIL;
 }
+
+static zbx_trend_function_t	trends_get_function(const char *name)
+{
+	if (0 == strcmp(name, "avg"))
+		return ZBX_TREND_FUNCTION_AVG;
+	if (0 == strcmp(name, "count"))
+		return ZBX_TREND_FUNCTION_COUNT;
+	if (0 == strcmp(name, "max"))
+		return ZBX_TREND_FUNCTION_MAX;
+	if (0 == strcmp(name, "min"))
+		return ZBX_TREND_FUNCTION_MIN;
+	if (0 == strcmp(name, "sum"))
+		return ZBX_TREND_FUNCTION_SUM;
+
+	return ZBX_TREND_FUNCTION_UNKNOWN;
+}
+
+static int	trend_prefetch_compare_func(const void *d1, const void *d2)
+{
+	const zbx_trend_prefetch_t	*p1 = (const zbx_trend_prefetch_t *)d1;
+	const zbx_trend_prefetch_t	*p2 = (const zbx_trend_prefetch_t *)d2;
+	int				ret;
+
+	if (0 != (ret = strcmp(p1->function, p2->function)))
+		return ret;
+
+	if (0 != (ret = strcmp(p1->table, p2->table)))
+		return ret;
+
+	ZBX_RETURN_IF_NOT_EQUAL(p1->start, p2->start);
+	ZBX_RETURN_IF_NOT_EQUAL(p1->end, p2->end);
+	ZBX_RETURN_IF_NOT_EQUAL(p1->itemid, p2->itemid);
+
+	return 0;
+}
+
+static int	trends_partials_compare_func(const void *d1, const void *d2)
+{
+	const zbx_trend_partials_t	*p1 = *(const zbx_trend_partials_t * const *)d1;
+	const zbx_trend_partials_t	*p2 = *(const zbx_trend_partials_t * const *)d2;
+	int				ret;
+
+	if (0 != (ret = strcmp(p1->clock_sql, p2->clock_sql)))
+		return ret;
+
+	ZBX_RETURN_IF_NOT_EQUAL(p1->itemid, p2->itemid);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_prefetch_batch_partial                                    *
+ *                                                                            *
+ * Purpose: evaluate trend function of multiple items over the same period    *
+ *          from daily partial aggregates and store the results in trend      *
+ *          function cache                                                    *
+ *                                                                            *
+ * Parameters: table       - [IN] the trends table name                       *
+ *             function    - [IN] the trend function                          *
+ *             start       - [IN] the period start time (including)           *
+ *             end         - [IN] the period end time (including)             *
+ *             days_start  - [IN] the start time of the first whole day       *
+ *             days_num    - [IN] the number of whole days                    *
+ *             itemids     - [IN] the sorted itemids                          *
+ *             itemids_num - [IN] the number of itemids                       *
+ *                                                                            *
+ * Comments: Whole days are taken from cache. Records of the days missing in  *
+ *           cache and of the partial days at the period edges are read with  *
+ *           one query per group of items missing the same days, usually only *
+ *           the period edges. The results are identical to evaluating the    *
+ *           items one by one with trends_eval_partial().                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_prefetch_batch_partial(const char *table, zbx_trend_function_t function, int start, int end,
+		int days_start, int days_num, const zbx_uint64_t *itemids, int itemids_num)
+{
+	DB_RESULT		result;
+	DB_ROW			row;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset;
+	int			i, j;
+	zbx_trend_partials_t	*partials, *item_partials;
+	zbx_vector_ptr_t	fetch;
+	zbx_vector_uint64_t	fetch_itemids;
+	zbx_uint64_t		itemid;
+	zbx_trend_state_t	state;
+	double			value;
+
+	partials = (zbx_trend_partials_t *)zbx_malloc(NULL, sizeof(zbx_trend_partials_t) * (size_t)itemids_num);
+	zbx_vector_ptr_create(&fetch);
+	zbx_vector_uint64_create(&fetch_itemids);
+
+	for (i = 0; i < itemids_num; i++)
+	{
+		trends_partials_init(&partials[i], itemids[i], start, end, days_start, days_num);
+
+		if (NULL != partials[i].clock_sql)
+			zbx_vector_ptr_append(&fetch, &partials[i]);
+	}
+
+	zbx_vector_ptr_sort(&fetch, trends_partials_compare_func);
+
+	for (i = 0; i < fetch.values_num; i = j)
+	{
+		const char	*clock_sql = ((zbx_trend_partials_t *)fetch.values[i])->clock_sql;
+
+		zbx_vector_uint64_clear(&fetch_itemids);
+
+		for (j = i; j < fetch.values_num; j++)
+		{
+			item_partials = (zbx_trend_partials_t *)fetch.values[j];
+
+			if (0 != strcmp(clock_sql, item_partials->clock_sql))
+				break;
+
+			zbx_vector_uint64_append(&fetch_itemids, item_partials->itemid);
+		}
+
+		sql_offset = 0;
+		zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset,
+				"select itemid,clock,num,value_avg,value_min,value_max from %s"
+				" where (%s) and",
+				table, clock_sql);
+		DBadd_condition_alloc(&sql, &sql_alloc, &sql_offset, "itemid", fetch_itemids.values,
+				fetch_itemids.values_num);
+
+		result = DBselect("%s", sql);
+
+		while (NULL != (row = DBfetch(result)))
+		{
+			ZBX_STR2UINT64(itemid, row[0]);
+
+			/* the itemid is the first member of partial aggregates */
+			if (NULL == (item_partials = (zbx_trend_partials_t *)bsearch(&itemid, partials,
+					(size_t)itemids_num, sizeof(zbx_trend_partials_t), ZBX_DEFAULT_UINT64_COMPARE_FUNC)))
+			{
+				THIS_SHOULD_NEVER_HAPPEN;
+				continue;
+			}
+
+			trends_partials_add_row(item_partials, row + 1, days_start, days_num);
+		}
+
+		DBfree_result(result);
+	}
+
+	for (i = 0; i < itemids_num; i++)
+	{
+		/* on average overflow the value is left for zbx_trends_eval_avg() to evaluate from records */
+		if (ZBX_TREND_STATE_UNKNOWN != (state = trends_partial_eval(function, &partials[i].total, &value)))
+			zbx_tfc_put_value(itemids[i], start, end, function, value, state);
+
+		trends_partials_clear(&partials[i], days_start, days_num);
+	}
+
+	zbx_free(sql);
+	zbx_vector_uint64_destroy(&fetch_itemids);
+	zbx_vector_ptr_destroy(&fetch);
+	zbx_free(partials);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trends_prefetch_batch                                            *
+ *                                                                            *
+ * Purpose: evaluate trend function of multiple items over the same period    *
+ *          with single query and store the results in trend function cache   *
+ *                                                                            *
+ * Parameters: table       - [IN] the trends table name                       *
+ *             function    - [IN] the trend function                          *
+ *             start       - [IN] the period start time (including)           *
+ *             end         - [IN] the period end time (including)             *
+ *             itemids     - [IN] the sorted itemids                          *
+ *             itemids_num - [IN] the number of itemids                       *
+ *                                                                            *
+ * Comments: Periods containing whole days are evaluated from daily partial   *
+ *           aggregates, like when evaluating single item.                    *
+ *           Otherwise minimum, maximum and count are aggregated by database. *
+ *           Average and sum are aggregated from the trend records in the     *
+ *           same way as when evaluating single item to get identical results *
+ *           and avoid floating point overflow errors in database.            *
+ *                                                                            *
+ ******************************************************************************/
+static void	trends_prefetch_batch(const char *table, zbx_trend_function_t function, int start, int end,
+		const zbx_uint64_t *itemids, int itemids_num)
+{
+	DB_RESULT		result;
+	DB_ROW			row;
+	char			*sql = NULL;
+	size_t			sql_alloc = 0, sql_offset = 0;
+	const char		*eval;
+	int			i, days_start, days_num;
+	zbx_hashset_t		aggregates;
+	zbx_trend_aggregate_t	*aggregate, aggregate_local;
+	zbx_trend_state_t	state;
+	double			value, num;
+
+	if (SUCCEED == trends_partial_period(start, end, &days_start, &days_num))
+	{
+		trends_prefetch_batch_partial(table, function, start, end, days_start, days_num, itemids,
+				itemids_num);
+		return;
+	}
+
+	switch (function)
+	{
+		case ZBX_TREND_FUNCTION_AVG:
+		case ZBX_TREND_FUNCTION_SUM:
+			eval = NULL;
+			break;
+		case ZBX_TREND_FUNCTION_COUNT:
+			eval = "sum(num)";
+			break;
+		case ZBX_TREND_FUNCTION_MAX:
+			eval = "max(value_max)";
+			break;
+		case ZBX_TREND_FUNCTION_MIN:
+			eval = "min(value_min)";
+			break;
+		default:
+			THIS_SHOULD_NEVER_HAPPEN;
+			return;
+	}
+
+	zbx_hashset_create(&aggregates, (size_t)itemids_num, ZBX_DEFAULT_UINT64_HASH_FUNC,
+			ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+
+	if (NULL != eval)
+		zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "select itemid,%s from %s", eval, table);
+	else
+		zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, "select itemid,value_avg,num from %s", table);
+
+	zbx_snprintf_alloc(&sql, &sql_alloc, &sql_offset, " where clock>=%d and clock<=%d and", start, end);
+	DBadd_condition_alloc(&sql, &sql_alloc, &sql_offset, "itemid", itemids, itemids_num);
+
+	if (NULL != eval)
+		zbx_strcpy_alloc(&sql, &sql_alloc, &sql_offset, " group by itemid");
+
+	result = DBselect("%s", sql);
+	zbx_free(sql);
+
+	while (NULL != (row = DBfetch(result)))
+	{
+		if (SUCCEED == DBis_null(row[1]))
+			continue;
+
+		ZBX_STR2UINT64(aggregate_local.itemid, row[0]);
+
+		if (NULL == (aggregate = (zbx_trend_aggregate_t *)zbx_hashset_search(&aggregates, &aggregate_local)))
+		{
+			aggregate_local.value = 0;
+			aggregate_local.num = 0;
+			aggregate = (zbx_trend_aggregate_t *)zbx_hashset_insert(&aggregates, &aggregate_local,
+					sizeof(aggregate_local));
+		}
+
+		value = atof(row[1]);
+
+		switch (function)
+		{
+			case ZBX_TREND_FUNCTION_AVG:
+				num = atof(row[2]);
+
+				if (0 == aggregate->num)
+					aggregate->value = value;
+				else
+				{
+					aggregate->value = aggregate->value / (aggregate->num + num) * aggregate->num +
+							value / (aggregate->num + num) * num;
+				}
+
+				aggregate->num += num;
+				break;
+			case ZBX_TREND_FUNCTION_SUM:
+				aggregate->value += value * atof(row[2]);
+				aggregate->num = 1;
+				break;
+			default:
+				aggregate->value = value;
+				aggregate->num = 1;
+		}
+	}
+
+	DBfree_result(result);
+
+	for (i = 0; i < itemids_num; i++)
+	{
+		value = 0;
+
+		if (NULL != (aggregate = (zbx_trend_aggregate_t *)zbx_hashset_search(&aggregates, &itemids[i])))
+		{
+			value = aggregate->value;
+			state = ZBX_TREND_STATE_NORMAL;
+
+			if (ZBX_TREND_FUNCTION_SUM == function && ZBX_INFINITY == value)
+				state = ZBX_TREND_STATE_OVERFLOW;
+		}
+		else if (ZBX_TREND_FUNCTION_COUNT == function || ZBX_TREND_FUNCTION_SUM == function)
+			state = ZBX_TREND_STATE_NORMAL;
+		else
+			state = ZBX_TREND_STATE_NODATA;
+
+		zbx_tfc_put_value(itemids[i], start, end, function, value, state);
+	}
+
+	zbx_hashset_destroy(&aggregates);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_trends_prefetch_values                                       *
+ *                                                                            *
+ * Purpose: evaluate trend functions of multiple items and store the results  *
+ *          in trend function cache                                           *
+ *                                                                            *
+ * Parameters: requests - [IN/OUT] the function evaluation requests, sorted   *
+ *                                 by this function                           *
+ *                                                                            *
+ * Comments: Requests with the same function, table and period are grouped    *
+ *           and evaluated with batched queries instead of one query per      *
+ *           item, using the cached daily partial aggregates for whole days.  *
+ *           The following zbx_trends_eval_*() calls get the results from     *
+ *           trend function cache. Groups of single item and items already    *
+ *           cached are skipped. Nothing is done if trend function cache is   *
+ *           disabled.                                                        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_trends_prefetch_values(zbx_vector_trend_prefetch_t *requests)
+{
+	int			i, j, k, queries_num = 0;
+	zbx_vector_uint64_t	itemids;
+	zbx_trend_function_t	function;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() requests:%d", __func__, requests->values_num);
+
+	if (SUCCEED != zbx_tfc_is_enabled())
+		goto out;
+
+	zbx_vector_uint64_create(&itemids);
+	zbx_vector_trend_prefetch_sort(requests, trend_prefetch_compare_func);
+
+	for (i = 0; i < requests->values_num; i = j)
+	{
+		const zbx_trend_prefetch_t	*group = &requests->values[i];
+
+		for (j = i + 1; j < requests->values_num; j++)
+		{
+			const zbx_trend_prefetch_t	*request = &requests->values[j];
+
+			if (0 != strcmp(group->function, request->function) || 0 != strcmp(group->table, request->table)
+					|| group->start != request->start || group->end != request->end)
+			{
+				break;
+			}
+		}
+
+		if (2 > j - i || ZBX_TREND_FUNCTION_UNKNOWN == (function = trends_get_function(group->function)))
+			continue;
+
+		zbx_vector_uint64_clear(&itemids);
+
+		for (k = i; k < j; k++)
+		{
+			zbx_uint64_t	itemid = requests->values[k].itemid;
+
+			if (0 != itemids.values_num && itemid == itemids.values[itemids.values_num - 1])
+				continue;
+
+			if (SUCCEED == zbx_tfc_has_value(itemid, group->start, group->end, function))
+				continue;
+
+			zbx_vector_uint64_append(&itemids, itemid);
+		}
+
+		if (2 > itemids.values_num)
+			continue;
+
+		for (k = 0; k < itemids.values_num; k += ZBX_TRENDS_PREFETCH_BATCH_SIZE)
+		{
+			trends_prefetch_batch(group->table, function, group->start, group->end, itemids.values + k,
+					MIN(ZBX_TRENDS_PREFETCH_BATCH_SIZE, itemids.values_num - k));
+			queries_num++;
+		}
+	}
+
+	zbx_vector_uint64_destroy(&itemids);
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s() queries:%d", __func__, queries_num);
+}
@@ -30,7 +30,8 @@ typedef enum
 	ZBX_TREND_FUNCTION_DELTA,
 	ZBX_TREND_FUNCTION_MAX,
 	ZBX_TREND_FUNCTION_MIN,
-	ZBX_TREND_FUNCTION_SUM
+	ZBX_TREND_FUNCTION_SUM,
+	ZBX_TREND_FUNCTION_PARTIAL
 }
 zbx_trend_function_t;
 
@@ -44,9 +45,23 @@ typedef enum
 }
 zbx_trend_state_t;
 
+/* partial aggregate of trend records */
+typedef struct
+{
+	double	sum;	/* sum of value_avg * num */
+	double	num;	/* number of values */
+	double	min;
+	double	max;
+}
+zbx_trend_partial_t;
+
 int	zbx_tfc_get_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double *value,
 		zbx_trend_state_t *state);
 void	zbx_tfc_put_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function, double value,
 		zbx_trend_state_t state);
+int	zbx_tfc_has_value(zbx_uint64_t itemid, int start, int end, zbx_trend_function_t function);
+int	zbx_tfc_get_partial(zbx_uint64_t itemid, int start, int end, zbx_trend_partial_t *partial);
+void	zbx_tfc_put_partial(zbx_uint64_t itemid, int start, int end, const zbx_trend_partial_t *partial);
+int	zbx_tfc_is_enabled(void);
 
 #endif
@@ -28,6 +28,7 @@
 #include "dbcache.h"
 #include "zbxtasks.h"
 #include "dbcache.h"
+#include "zbxproxybuf.h"
 
 #include "datasender.h"
 #include "../servercomms.h"
@@ -49,6 +50,24 @@ extern int		server_num, process_num;
 					ZBX_DATASENDER_AUTOREGISTRATION | ZBX_DATASENDER_TASKS |	\
 					ZBX_DATASENDER_TASKS_RECV)
 
+/* 'proxy data' request sent to server and waiting for acknowledgement */
+typedef struct
+{
+	zbx_uint64_t		batchid;
+	zbx_uint64_t		flags;
+	zbx_uint64_t		history_lastid;
+	zbx_uint64_t		discovery_lastid;
+	zbx_uint64_t		areg_lastid;
+	int			availability_ts;
+	zbx_vector_ptr_t	tasks;
+}
+zbx_datasender_batch_t;
+
+/* pipeline - the number of batches server accepts without acknowledgement, 0 if pipelining is not supported */
+static int		data_timestamp = 0, task_timestamp = 0, upload_state = SUCCEED, history_binary = FAIL,
+			pipeline = 0;
+static zbx_uint64_t	last_batchid = 0;
+
 /******************************************************************************
  *                                                                            *
  * Function: get_hist_upload_state                                            *
@@ -80,167 +99,425 @@ static void	get_hist_upload_state(const char *buffer, int *state)
 
 /******************************************************************************
  *                                                                            *
- * Function: proxy_data_sender                                                *
+ * Function: proxy_data_batch_read                                            *
  *                                                                            *
  * Purpose: collects host availability, history, discovery, autoregistration  *
- *          data and sends 'proxy data' request                               *
+ *          data and tasks for the next 'proxy data' request                  *
+ *                                                                            *
+ * Parameters: batch             - [OUT] the batch                            *
+ *             j                 - [IN/OUT] the proxy data json               *
+ *             history           - [OUT] the binary history data block        *
+ *             history_len       - [OUT] the binary history data block size   *
+ *             now               - [IN] the current time                      *
+ *             hist_upload_state - [IN] the history upload state              *
+ *             tasks_in_flight   - [IN] 1 - tasks were sent in a batch not    *
+ *                                      acknowledged yet, 0 - otherwise       *
+ *             more              - [OUT] ZBX_PROXY_DATA_MORE if there might   *
+ *                                       be more data to send                 *
+ *                                                                            *
+ * Return value: The number of history, discovery and autoregistration        *
+ *               records added.                                               *
+ *                                                                            *
+ * Comments: History, discovery and autoregistration records are read after   *
+ *           the records of batches in flight. Tasks are not read again until *
+ *           the batch with tasks is acknowledged, as they are marked done    *
+ *           only then.                                                       *
  *                                                                            *
  ******************************************************************************/
-static int	proxy_data_sender(int *more, int now, int *hist_upload_state)
+static int	proxy_data_batch_read(zbx_datasender_batch_t *batch, struct zbx_json *j, char **history,
+		size_t *history_len, int now, int hist_upload_state, int tasks_in_flight, int *more)
 {
-	static int		data_timestamp = 0, task_timestamp = 0, upload_state = SUCCEED;
-
-	zbx_socket_t		sock;
-	struct zbx_json		j;
-	struct zbx_json_parse	jp, jp_tasks;
-	int			availability_ts, history_records = 0, discovery_records = 0,
-				areg_records = 0, more_history = 0, more_discovery = 0, more_areg = 0, proxy_delay;
-	zbx_uint64_t		history_lastid = 0, discovery_lastid = 0, areg_lastid = 0, flags = 0;
-	zbx_timespec_t		ts;
-	char			*error = NULL;
-	zbx_vector_ptr_t	tasks;
-
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+	int	history_records = 0, discovery_records = 0, areg_records = 0, more_history = 0, more_discovery = 0,
+		more_areg = 0;
 
 	*more = ZBX_PROXY_DATA_DONE;
-	zbx_json_init(&j, 16 * ZBX_KIBIBYTE);
 
-	zbx_json_addstring(&j, ZBX_PROTO_TAG_REQUEST, ZBX_PROTO_VALUE_PROXY_DATA, ZBX_JSON_TYPE_STRING);
-	zbx_json_addstring(&j, ZBX_PROTO_TAG_HOST, CONFIG_HOSTNAME, ZBX_JSON_TYPE_STRING);
-	zbx_json_addstring(&j, ZBX_PROTO_TAG_SESSION, zbx_dc_get_session_token(), ZBX_JSON_TYPE_STRING);
+	zbx_json_addstring(j, ZBX_PROTO_TAG_REQUEST, ZBX_PROTO_VALUE_PROXY_DATA, ZBX_JSON_TYPE_STRING);
+	zbx_json_addstring(j, ZBX_PROTO_TAG_HOST, CONFIG_HOSTNAME, ZBX_JSON_TYPE_STRING);
 
 	if (SUCCEED == upload_state && CONFIG_PROXYDATA_FREQUENCY <= now - data_timestamp &&
-			ZBX_PROXY_UPLOAD_DISABLED != *hist_upload_state)
+			ZBX_PROXY_UPLOAD_DISABLED != hist_upload_state)
 	{
-		if (SUCCEED == get_interface_availability_data(&j, &availability_ts))
-			flags |= ZBX_DATASENDER_AVAILABILITY;
+		if (SUCCEED == get_interface_availability_data(j, &batch->availability_ts))
+			batch->flags |= ZBX_DATASENDER_AVAILABILITY;
 
-		history_records = proxy_get_hist_data(&j, &history_lastid, &more_history);
-		if (0 != history_lastid)
-			flags |= ZBX_DATASENDER_HISTORY;
+		history_records = proxy_get_hist_data(j, SUCCEED == history_binary ? history : NULL, history_len,
+				&batch->history_lastid, &more_history);
+		if (0 != batch->history_lastid)
+			batch->flags |= ZBX_DATASENDER_HISTORY;
 
-		discovery_records = proxy_get_dhis_data(&j, &discovery_lastid, &more_discovery);
+		discovery_records = proxy_get_dhis_data(j, &batch->discovery_lastid, &more_discovery);
 		if (0 != discovery_records)
-			flags |= ZBX_DATASENDER_DISCOVERY;
+			batch->flags |= ZBX_DATASENDER_DISCOVERY;
 
-		areg_records = proxy_get_areg_data(&j, &areg_lastid, &more_areg);
+		areg_records = proxy_get_areg_data(j, &batch->areg_lastid, &more_areg);
 		if (0 != areg_records)
-			flags |= ZBX_DATASENDER_AUTOREGISTRATION;
+			batch->flags |= ZBX_DATASENDER_AUTOREGISTRATION;
 
 		if (ZBX_PROXY_DATA_MORE != more_history && ZBX_PROXY_DATA_MORE != more_discovery &&
 						ZBX_PROXY_DATA_MORE != more_areg)
 		{
 			data_timestamp = now;
 		}
+		else
+			*more = ZBX_PROXY_DATA_MORE;
 	}
 
-	zbx_vector_ptr_create(&tasks);
+	/* history read from memory buffer is sent in its own data session */
+	zbx_json_addstring(j, ZBX_PROTO_TAG_SESSION, zbx_pmb_get_session_token(), ZBX_JSON_TYPE_STRING);
 
-	if (SUCCEED == upload_state && ZBX_TASK_UPDATE_FREQUENCY <= now - task_timestamp)
+	if (SUCCEED == upload_state && 0 == tasks_in_flight && ZBX_TASK_UPDATE_FREQUENCY <= now - task_timestamp)
 	{
 		task_timestamp = now;
 
-		zbx_tm_get_remote_tasks(&tasks, 0);
+		zbx_tm_get_remote_tasks(&batch->tasks, 0);
 
-		if (0 != tasks.values_num)
+		if (0 != batch->tasks.values_num)
 		{
-			zbx_tm_json_serialize_tasks(&j, &tasks);
-			flags |= ZBX_DATASENDER_TASKS;
+			zbx_tm_json_serialize_tasks(j, &batch->tasks);
+			batch->flags |= ZBX_DATASENDER_TASKS;
 		}
 
-		flags |= ZBX_DATASENDER_TASKS_REQUEST;
+		batch->flags |= ZBX_DATASENDER_TASKS_REQUEST;
+	}
+
+	if (SUCCEED != upload_state)
+		batch->flags |= ZBX_DATASENDER_TASKS_REQUEST;
+
+	return history_records + discovery_records + areg_records;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_data_batch_send                                            *
+ *                                                                            *
+ * Purpose: sends 'proxy data' request without waiting for response           *
+ *                                                                            *
+ * Parameters: sock        - [IN] the connection to server                    *
+ *             batch       - [IN/OUT] the batch                               *
+ *             j           - [IN/OUT] the proxy data json                     *
+ *             history     - [IN/OUT] the binary history data block           *
+ *             history_len - [IN/OUT] the binary history data block size      *
+ *             more        - [IN] ZBX_PROXY_DATA_MORE if there might be more  *
+ *                                data to send                                *
+ *             pipelined   - [IN] 1 - the connection is kept open for next    *
+ *                                    batches, 0 - otherwise                  *
+ *             error       - [OUT] the error message                          *
+ *                                                                            *
+ * Return value: SUCCEED - the request was sent                               *
+ *               FAIL    - an error occurred                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_data_batch_send(zbx_socket_t *sock, zbx_datasender_batch_t *batch, struct zbx_json *j,
+		char **history, size_t *history_len, int more, int pipelined, char **error)
+{
+	zbx_timespec_t	ts;
+	int		proxy_delay;
+
+	if (ZBX_PROXY_DATA_MORE == more)
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_MORE, ZBX_PROXY_DATA_MORE);
+
+	zbx_json_addstring(j, ZBX_PROTO_TAG_VERSION, ZABBIX_VERSION, ZBX_JSON_TYPE_STRING);
+	zbx_proxy_add_compression(j);
+
+	zbx_timespec(&ts);
+	zbx_json_adduint64(j, ZBX_PROTO_TAG_CLOCK, ts.sec);
+	zbx_json_adduint64(j, ZBX_PROTO_TAG_NS, ts.ns);
+
+	if (0 != (batch->flags & ZBX_DATASENDER_HISTORY) && 0 != (proxy_delay = proxy_get_delay(batch->history_lastid)))
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_PROXY_DELAY, proxy_delay);
+
+	/* batch id asks server to acknowledge it and keep the connection open for the next batches */
+	if (0 != pipelined)
+	{
+		batch->batchid = ++last_batchid;
+		zbx_json_adduint64(j, ZBX_PROTO_TAG_BATCH, batch->batchid);
+	}
+
+	if (NULL != *history)
+	{
+		zbx_proxy_data_join(j, history, history_len);
+		return send_data_batch_to_server(sock, *history, *history_len, error);
 	}
 
+	return send_data_batch_to_server(sock, j->buffer, j->buffer_size, error);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_data_batch_ack                                             *
+ *                                                                            *
+ * Purpose: receives server response to the oldest batch in flight and        *
+ *          updates the last sent record ids                                  *
+ *                                                                            *
+ * Parameters: sock              - [IN] the connection to server              *
+ *             batch             - [IN/OUT] the oldest batch in flight        *
+ *             acked             - [IN] the number of batches acknowledged    *
+ *                                      over this connection                  *
+ *             hist_upload_state - [OUT] the history upload state             *
+ *             closing           - [OUT] 1 - server withdrew pipelining, no   *
+ *                                       more batches must be sent over this  *
+ *                                       connection                           *
+ *             error             - [OUT] the error message                    *
+ *                                                                            *
+ * Return value: SUCCEED - the batch was acknowledged                         *
+ *               FAIL    - an error occurred                                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_data_batch_ack(zbx_socket_t *sock, zbx_datasender_batch_t *batch, int acked,
+		int *hist_upload_state, int *closing, char **error)
+{
+	struct zbx_json_parse	jp, jp_tasks;
+	char			value[MAX_ID_LEN + 1];
+	zbx_uint64_t		batchid = 0;
+	int			batches;
+
+	upload_state = recv_data_batch_response(sock, error);
+
+	get_hist_upload_state(sock->buffer, hist_upload_state);
+
+	/* binary history format and pipelining are used only while server keeps advertising them */
+	history_binary = zbx_proxy_history_binary_accepted(sock->buffer);
+
+	/* server advertises pipelining in the first response and withdraws it from connection kept open for */
+	/* too long, then pipelining is used again on the next connection                                   */
+	if (0 != (batches = zbx_proxy_data_pipeline_accepted(sock->buffer)) || 0 == acked)
+		pipeline = batches;
+	else
+		*closing = 1;
+
 	if (SUCCEED != upload_state)
-		flags |= ZBX_DATASENDER_TASKS_REQUEST;
+		return FAIL;
 
-	if (0 != flags)
+	if (SUCCEED != zbx_json_open(sock->buffer, &jp))
 	{
-		if (ZBX_PROXY_DATA_MORE == more_history || ZBX_PROXY_DATA_MORE == more_discovery ||
-				ZBX_PROXY_DATA_MORE == more_areg)
+		*error = zbx_strdup(*error, zbx_json_strerror());
+		upload_state = FAIL;
+		return FAIL;
+	}
+
+	if (0 != batch->batchid)
+	{
+		if (SUCCEED == zbx_json_value_by_name(&jp, ZBX_PROTO_TAG_BATCH, value, sizeof(value), NULL))
+			ZBX_STR2UINT64(batchid, value);
+
+		if (batchid != batch->batchid)
 		{
-			zbx_json_adduint64(&j, ZBX_PROTO_TAG_MORE, ZBX_PROXY_DATA_MORE);
-			*more = ZBX_PROXY_DATA_MORE;
+			*error = zbx_dsprintf(*error, "expected acknowledgement of batch " ZBX_FS_UI64 " but received"
+					" of batch " ZBX_FS_UI64, batch->batchid, batchid);
+			pipeline = 0;
+			upload_state = FAIL;
+			return FAIL;
 		}
+	}
 
-		zbx_json_addstring(&j, ZBX_PROTO_TAG_VERSION, ZABBIX_VERSION, ZBX_JSON_TYPE_STRING);
+	if (0 != (batch->flags & ZBX_DATASENDER_AVAILABILITY))
+		zbx_set_availability_diff_ts(batch->availability_ts);
 
-		/* retry till have a connection */
-		if (FAIL == connect_to_server(&sock, 600, CONFIG_PROXYDATA_FREQUENCY))
-			goto clean;
+	if (SUCCEED == zbx_json_brackets_by_name(&jp, ZBX_PROTO_TAG_TASKS, &jp_tasks))
+		batch->flags |= ZBX_DATASENDER_TASKS_RECV;
 
-		zbx_timespec(&ts);
-		zbx_json_adduint64(&j, ZBX_PROTO_TAG_CLOCK, ts.sec);
-		zbx_json_adduint64(&j, ZBX_PROTO_TAG_NS, ts.ns);
+	/* data read from proxy memory buffer is acknowledged without database transaction */
+	if (0 != (batch->flags & ZBX_DATASENDER_HISTORY) &&
+			SUCCEED == zbx_pmb_set_lastid(ZBX_PMB_HISTORY, batch->history_lastid))
+	{
+		batch->flags &= ~(zbx_uint64_t)ZBX_DATASENDER_HISTORY;
+	}
+
+	if (0 != (batch->flags & ZBX_DATASENDER_DISCOVERY) &&
+			SUCCEED == zbx_pmb_set_lastid(ZBX_PMB_DISCOVERY, batch->discovery_lastid))
+	{
+		batch->flags &= ~(zbx_uint64_t)ZBX_DATASENDER_DISCOVERY;
+	}
 
-		if (0 != (flags & ZBX_DATASENDER_HISTORY) && 0 != (proxy_delay = proxy_get_delay(history_lastid)))
-			zbx_json_adduint64(&j, ZBX_PROTO_TAG_PROXY_DELAY, proxy_delay);
+	if (0 != (batch->flags & ZBX_DATASENDER_AUTOREGISTRATION) &&
+			SUCCEED == zbx_pmb_set_lastid(ZBX_PMB_AUTOREG, batch->areg_lastid))
+	{
+		batch->flags &= ~(zbx_uint64_t)ZBX_DATASENDER_AUTOREGISTRATION;
+	}
 
-		upload_state = put_data_to_server(&sock, &j, &error);
-		get_hist_upload_state(sock.buffer, hist_upload_state);
+	if (0 != (batch->flags & ZBX_DATASENDER_DB_UPDATE))
+	{
+		DBbegin();
 
-		if (SUCCEED != upload_state)
+		if (0 != (batch->flags & ZBX_DATASENDER_TASKS))
 		{
-			*more = ZBX_PROXY_DATA_DONE;
-			if (ZBX_PROXY_UPLOAD_DISABLED != *hist_upload_state)
-			{
-				zabbix_log(LOG_LEVEL_WARNING, "cannot send proxy data to server at \"%s\": %s",
-						sock.peer, error);
-			}
-			zbx_free(error);
+			zbx_tm_update_task_status(&batch->tasks, ZBX_TM_STATUS_DONE);
+			zbx_vector_ptr_clear_ext(&batch->tasks, (zbx_clean_func_t)zbx_tm_task_free);
 		}
-		else
+
+		if (0 != (batch->flags & ZBX_DATASENDER_TASKS_RECV))
 		{
-			if (0 != (flags & ZBX_DATASENDER_AVAILABILITY))
-				zbx_set_availability_diff_ts(availability_ts);
+			zbx_tm_json_deserialize_tasks(&jp_tasks, &batch->tasks);
+			zbx_tm_save_tasks(&batch->tasks);
+		}
 
-			if (SUCCEED == zbx_json_open(sock.buffer, &jp))
-			{
-				if (SUCCEED == zbx_json_brackets_by_name(&jp, ZBX_PROTO_TAG_TASKS, &jp_tasks))
-					flags |= ZBX_DATASENDER_TASKS_RECV;
-			}
+		if (0 != (batch->flags & ZBX_DATASENDER_HISTORY))
+			proxy_set_hist_lastid(batch->history_lastid);
 
-			if (0 != (flags & ZBX_DATASENDER_DB_UPDATE))
-			{
-				DBbegin();
+		if (0 != (batch->flags & ZBX_DATASENDER_DISCOVERY))
+			proxy_set_dhis_lastid(batch->discovery_lastid);
+
+		if (0 != (batch->flags & ZBX_DATASENDER_AUTOREGISTRATION))
+			proxy_set_areg_lastid(batch->areg_lastid);
+
+		DBcommit();
+	}
+
+	return SUCCEED;
+}
+
+static void	proxy_data_batch_init(zbx_datasender_batch_t *batch)
+{
+	memset(batch, 0, sizeof(zbx_datasender_batch_t));
+	zbx_vector_ptr_create(&batch->tasks);
+}
+
+static void	proxy_data_batch_clear(zbx_datasender_batch_t *batch)
+{
+	zbx_vector_ptr_clear_ext(&batch->tasks, (zbx_clean_func_t)zbx_tm_task_free);
+	zbx_vector_ptr_destroy(&batch->tasks);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: proxy_data_sender                                                *
+ *                                                                            *
+ * Purpose: collects host availability, history, discovery, autoregistration  *
+ *          data and sends 'proxy data' requests                              *
+ *                                                                            *
+ * Comments: When server accepts pipelining, the next batches are read and    *
+ *           sent over the same connection while up to the advertised number  *
+ *           of batches wait for acknowledgement, so sending a backlog is     *
+ *           limited by bandwidth rather than by round trip time. Otherwise   *
+ *           one batch is sent per connection.                                *
+ *                                                                            *
+ ******************************************************************************/
+static int	proxy_data_sender(int *more, int now, int *hist_upload_state)
+{
+	zbx_socket_t		sock;
+	struct zbx_json		j;
+	zbx_datasender_batch_t	batches[ZBX_PROXY_DATA_BATCHES_MAX], *batch;
+	int			records, batches_first = 0, batches_num = 0, batches_max, pipelined, batch_read = 1,
+				tasks_in_flight = 0, closing = 0, acked = 0;
+	char			*error = NULL, *history = NULL;
+	size_t			history_len = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	zbx_json_init(&j, 16 * ZBX_KIBIBYTE);
+
+	/* the first batch is read before connecting, so there is nothing to send on idle proxy */
+	batch = &batches[0];
+	proxy_data_batch_init(batch);
+	records = proxy_data_batch_read(batch, &j, &history, &history_len, now, *hist_upload_state, 0, more);
+
+	if (0 == batch->flags)
+	{
+		proxy_data_batch_clear(batch);
+		goto out;
+	}
 
-				if (0 != (flags & ZBX_DATASENDER_TASKS))
+	/* retry till have a connection */
+	if (FAIL == connect_to_server(&sock, 600, CONFIG_PROXYDATA_FREQUENCY))
+	{
+		proxy_data_batch_clear(batch);
+		goto out;
+	}
+
+	/* server might stop advertising pipelining, keep it for the whole connection */
+	pipelined = (0 != pipeline ? 1 : 0);
+	batches_max = (0 != pipeline ? pipeline : 1);
+
+	while (1)
+	{
+		/* keep sending batches until the window is full or there is nothing more to send */
+		while (1)
+		{
+			if (0 == batch_read)
+			{
+				/* the connection is not kept longer than data sender would spend sending in a row */
+				if (0 == pipelined || 0 != closing || batches_max == batches_num ||
+						ZBX_PROXY_DATA_MORE != *more || SEC_PER_MIN <= time(NULL) - now ||
+						!ZBX_IS_RUNNING())
 				{
-					zbx_tm_update_task_status(&tasks, ZBX_TM_STATUS_DONE);
-					zbx_vector_ptr_clear_ext(&tasks, (zbx_clean_func_t)zbx_tm_task_free);
+					break;
 				}
 
-				if (0 != (flags & ZBX_DATASENDER_TASKS_RECV))
+				batch = &batches[(batches_first + batches_num) % ZBX_PROXY_DATA_BATCHES_MAX];
+				proxy_data_batch_init(batch);
+
+				zbx_json_clean(&j);
+				zbx_free(history);
+				history_len = 0;
+
+				records += proxy_data_batch_read(batch, &j, &history, &history_len, (int)time(NULL),
+						*hist_upload_state, tasks_in_flight, more);
+
+				if (0 == batch->flags)
 				{
-					zbx_tm_json_deserialize_tasks(&jp_tasks, &tasks);
-					zbx_tm_save_tasks(&tasks);
+					proxy_data_batch_clear(batch);
+					break;
 				}
+			}
 
-				if (0 != (flags & ZBX_DATASENDER_HISTORY))
-					proxy_set_hist_lastid(history_lastid);
+			batch_read = 0;
+			batches_num++;
 
-				if (0 != (flags & ZBX_DATASENDER_DISCOVERY))
-					proxy_set_dhis_lastid(discovery_lastid);
+			if (SUCCEED != proxy_data_batch_send(&sock, batch, &j, &history, &history_len, *more, pipelined,
+					&error))
+			{
+				upload_state = FAIL;
+				goto fail;
+			}
 
-				if (0 != (flags & ZBX_DATASENDER_AUTOREGISTRATION))
-					proxy_set_areg_lastid(areg_lastid);
+			proxy_set_sent_lastids(batch->history_lastid, batch->discovery_lastid, batch->areg_lastid);
 
-				DBcommit();
-			}
+			if (0 != (batch->flags & ZBX_DATASENDER_TASKS))
+				tasks_in_flight = 1;
 		}
 
-		disconnect_server(&sock);
+		if (0 == batches_num)
+			break;
+
+		batch = &batches[batches_first];
+
+		if (SUCCEED != proxy_data_batch_ack(&sock, batch, acked++, hist_upload_state, &closing, &error))
+			goto fail;
+
+		if (0 != (batch->flags & ZBX_DATASENDER_TASKS))
+			tasks_in_flight = 0;
+
+		proxy_data_batch_clear(batch);
+		batches_first = (batches_first + 1) % ZBX_PROXY_DATA_BATCHES_MAX;
+		batches_num--;
 	}
-clean:
-	zbx_vector_ptr_clear_ext(&tasks, (zbx_clean_func_t)zbx_tm_task_free);
-	zbx_vector_ptr_destroy(&tasks);
 
+	goto disconnect;
+fail:
+	*more = ZBX_PROXY_DATA_DONE;
+
+	if (ZBX_PROXY_UPLOAD_DISABLED != *hist_upload_state)
+		zabbix_log(LOG_LEVEL_WARNING, "cannot send proxy data to server at \"%s\": %s", sock.peer, error);
+
+	zbx_free(error);
+
+	/* batches in flight will be read again after the last acknowledged records */
+	for (; 0 < batches_num; batches_num--)
+	{
+		proxy_data_batch_clear(&batches[batches_first]);
+		batches_first = (batches_first + 1) % ZBX_PROXY_DATA_BATCHES_MAX;
+	}
+disconnect:
+	proxy_reset_sent_lastids();
+	disconnect_server(&sock);
+out:
 	zbx_json_free(&j);
+	zbx_free(history);
 
-	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s more:%d flags:0x" ZBX_FS_UX64, __func__,
-			zbx_result_string(upload_state), *more, flags);
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s more:%d", __func__, zbx_result_string(upload_state), *more);
 
-	return history_records + discovery_records + areg_records;
+	return records;
 }
 
 /******************************************************************************
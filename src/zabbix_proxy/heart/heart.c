@@ -22,6 +22,7 @@
 #include "log.h"
 #include "zbxjson.h"
 #include "zbxself.h"
+#include "proxy.h"
 
 #include "heart.h"
 #include "../servercomms.h"
@@ -48,11 +49,12 @@ static int	send_heartbeat(void)
 	zbx_json_addstring(&j, "request", ZBX_PROTO_VALUE_PROXY_HEARTBEAT, ZBX_JSON_TYPE_STRING);
 	zbx_json_addstring(&j, "host", CONFIG_HOSTNAME, ZBX_JSON_TYPE_STRING);
 	zbx_json_addstring(&j, ZBX_PROTO_TAG_VERSION, ZABBIX_VERSION, ZBX_JSON_TYPE_STRING);
+	zbx_proxy_add_compression(&j);
 
 	if (FAIL == connect_to_server(&sock, CONFIG_HEARTBEAT_FREQUENCY, 0)) /* do not retry */
 		return FAIL;
 
-	if (SUCCEED != put_data_to_server(&sock, &j, &error))
+	if (SUCCEED != put_data_to_server(&sock, j.buffer, j.buffer_size, &error))
 	{
 		zabbix_log(LOG_LEVEL_WARNING, "cannot send heartbeat message to server at \"%s\": %s",
 				sock.peer, error);
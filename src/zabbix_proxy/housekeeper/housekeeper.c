@@ -23,6 +23,7 @@
 #include "daemon.h"
 #include "zbxself.h"
 #include "dbcache.h"
+#include "zbxproxybuf.h"
 
 #include "housekeeper.h"
 
@@ -149,7 +150,14 @@ static int	housekeeping_history(int now)
 
         zabbix_log(LOG_LEVEL_DEBUG, "In housekeeping_history()");
 
-	records += delete_history("proxy_history", "history_lastid", now);
+	if (SUCCEED == zbx_pb_history_enabled())
+	{
+		records += zbx_pb_history_housekeep(now - CONFIG_PROXY_LOCAL_BUFFER * SEC_PER_HOUR,
+				now - CONFIG_PROXY_OFFLINE_BUFFER * SEC_PER_HOUR);
+	}
+	else
+		records += delete_history("proxy_history", "history_lastid", now);
+
 	records += delete_history("proxy_dhistory", "dhistory_lastid", now);
 	records += delete_history("proxy_autoreg_host", "autoreg_host_lastid", now);
 
@@ -44,6 +44,7 @@
 #include "housekeeper/housekeeper.h"
 #include "../zabbix_server/pinger/pinger.h"
 #include "../zabbix_server/poller/poller.h"
+#include "../zabbix_server/poller/async_poller.h"
 #include "../zabbix_server/trapper/trapper.h"
 #include "../zabbix_server/trapper/proxydata.h"
 #include "../zabbix_server/snmptrapper/snmptrapper.h"
@@ -60,7 +61,10 @@
 #include "../zabbix_server/preprocessor/preproc_worker.h"
 #include "../zabbix_server/availability/avail_manager.h"
 #include "zbxvault.h"
+#include "zbxcompress.h"
 #include "zbxdiag.h"
+#include "preproc.h"
+#include "zbxproxybuf.h"
 
 
 #ifdef HAVE_OPENIPMI
@@ -188,23 +192,32 @@ int	CONFIG_HISTORYPOLLER_FORKS	= 1;	/* for zabbix[proxy_history] internal check
 int	CONFIG_AVAILMAN_FORKS		= 1;
 int	CONFIG_SERVICEMAN_FORKS		= 0;
 int	CONFIG_PROBLEMHOUSEKEEPER_FORKS	= 0;
+int	CONFIG_AGENTPOLLER_FORKS	= 1;
+int	CONFIG_SNMPPOLLER_FORKS		= 0;
+int	CONFIG_HTTPAGENTPOLLER_FORKS	= 0;
 
 int	CONFIG_LISTEN_PORT		= ZBX_DEFAULT_SERVER_PORT;
 char	*CONFIG_LISTEN_IP		= NULL;
 char	*CONFIG_SOURCE_IP		= NULL;
 int	CONFIG_TRAPPER_TIMEOUT		= 300;
+int	CONFIG_MAX_CONCURRENT_CHECKS	= 1000;
 
 int	CONFIG_HOUSEKEEPING_FREQUENCY	= 1;
 int	CONFIG_PROXY_LOCAL_BUFFER	= 0;
 int	CONFIG_PROXY_OFFLINE_BUFFER	= 1;
+char	*CONFIG_PROXY_HISTORY_LOG_DIR	= NULL;
+int	CONFIG_PROXY_MEMORY_BUFFER_AGE	= 0;
 
 int	CONFIG_HEARTBEAT_FREQUENCY	= 60;
 
 int	CONFIG_PROXYCONFIG_FREQUENCY	= SEC_PER_HOUR;
 int	CONFIG_PROXYDATA_FREQUENCY	= 1;
+int	CONFIG_PROXYDATA_PIPELINE_TIME	= 0;	/* not used in zabbix_proxy, required for linking */
 
 int	CONFIG_HISTSYNCER_FORKS		= 4;
 int	CONFIG_HISTSYNCER_FREQUENCY	= 1;
+int	CONFIG_HISTORY_PIPELINE		= 0;
+int	CONFIG_CONF_CACHE_THREADS	= 1;
 int	CONFIG_CONFSYNCER_FORKS		= 1;
 
 int	CONFIG_VMWARE_FORKS		= 0;
@@ -215,9 +228,14 @@ int	CONFIG_VMWARE_TIMEOUT		= 10;
 zbx_uint64_t	CONFIG_CONF_CACHE_SIZE		= 8 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE	= 16 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE	= 4 * ZBX_MEBIBYTE;
+int		CONFIG_HISTORY_CACHE_SHARDS	= 1;
+zbx_uint64_t	CONFIG_PREPROCESSOR_RING_SIZE	= 0;
+zbx_uint64_t	CONFIG_PROXY_HISTORY_LOG_SEGMENT_SIZE	= 64 * ZBX_MEBIBYTE;
+zbx_uint64_t	CONFIG_PROXY_MEMORY_BUFFER_SIZE	= 0;
 zbx_uint64_t	CONFIG_TRENDS_CACHE_SIZE	= 0;
 zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE	= 0;
 zbx_uint64_t	CONFIG_VALUE_CACHE_SIZE		= 0;
+int		CONFIG_VALUE_CACHE_COMPRESSION	= 0;
 zbx_uint64_t	CONFIG_VMWARE_CACHE_SIZE	= 8 * ZBX_MEBIBYTE;
 zbx_uint64_t	CONFIG_EXPORT_FILE_SIZE;
 
@@ -307,10 +325,14 @@ static char	*CONFIG_SOCKET_PATH	= NULL;
 char	*CONFIG_HISTORY_STORAGE_URL		= NULL;
 char	*CONFIG_HISTORY_STORAGE_OPTS		= NULL;
 int	CONFIG_HISTORY_STORAGE_PIPELINES	= 0;
+int	CONFIG_HISTORY_STORAGE_CONCURRENCY	= 5;
 
 char	*CONFIG_STATS_ALLOWED_IP	= NULL;
 int	CONFIG_TCP_MAX_BACKLOG_SIZE	= SOMAXCONN;
 
+char	*CONFIG_COMPRESSION_CODEC	= NULL;
+char	*CONFIG_COMPRESSION_DICTIONARY	= NULL;
+
 int	CONFIG_DOUBLE_PRECISION		= ZBX_DB_DBL_PRECISION_ENABLED;
 
 volatile sig_atomic_t	zbx_diaginfo_scope = ZBX_DIAGINFO_UNDEFINED;
@@ -439,6 +461,21 @@ int	get_process_info_by_thread(int local_server_num, unsigned char *local_proces
 		*local_process_type = ZBX_PROCESS_TYPE_AVAILMAN;
 		*local_process_num = local_server_num - server_count + CONFIG_AVAILMAN_FORKS;
 	}
+	else if (local_server_num <= (server_count += CONFIG_AGENTPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_AGENTPOLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_AGENTPOLLER_FORKS;
+	}
+	else if (local_server_num <= (server_count += CONFIG_SNMPPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_SNMPPOLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_SNMPPOLLER_FORKS;
+	}
+	else if (local_server_num <= (server_count += CONFIG_HTTPAGENTPOLLER_FORKS))
+	{
+		*local_process_type = ZBX_PROCESS_TYPE_HTTPAGENTPOLLER;
+		*local_process_num = local_server_num - server_count + CONFIG_HTTPAGENTPOLLER_FORKS;
+	}
 	else
 		return FAIL;
 
@@ -570,10 +607,11 @@ static void	zbx_validate_config(ZBX_TASK_EX *task)
 		err = 1;
 	}
 
-	if (0 == CONFIG_UNREACHABLE_POLLER_FORKS && 0 != CONFIG_POLLER_FORKS + CONFIG_JAVAPOLLER_FORKS)
+	if (0 == CONFIG_UNREACHABLE_POLLER_FORKS && 0 != CONFIG_POLLER_FORKS + CONFIG_JAVAPOLLER_FORKS +
+			CONFIG_AGENTPOLLER_FORKS + CONFIG_SNMPPOLLER_FORKS + CONFIG_HTTPAGENTPOLLER_FORKS)
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "\"StartPollersUnreachable\" configuration parameter must not be 0"
-				" if regular or Java pollers are started");
+				" if regular, agent, SNMP, HTTP agent or Java pollers are started");
 		err = 1;
 	}
 
@@ -583,6 +621,27 @@ static void	zbx_validate_config(ZBX_TASK_EX *task)
 		err = 1;
 	}
 
+	if (CONFIG_PREPROCESSOR_FORKS < CONFIG_PREPROCMAN_FORKS)
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "\"StartPreprocessors\" configuration parameter must not be less than"
+				" \"StartPreprocessingManagers\"");
+		err = 1;
+	}
+
+	if (0 != CONFIG_PREPROCESSOR_RING_SIZE && 256 * ZBX_KIBIBYTE > CONFIG_PREPROCESSOR_RING_SIZE)
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "\"PreprocessingRingSize\" configuration parameter must be either 0"
+				" or greater than 256KB");
+		err = 1;
+	}
+
+	if (0 != CONFIG_PROXY_MEMORY_BUFFER_SIZE && 0 != CONFIG_PROXY_LOCAL_BUFFER)
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "\"ProxyMemoryBufferSize\" configuration parameter cannot be used when"
+				" \"ProxyLocalBuffer\" is set");
+		err = 1;
+	}
+
 	if (ZBX_PROXYMODE_ACTIVE == CONFIG_PROXYMODE && FAIL == is_supported_ip(CONFIG_SERVER) &&
 			FAIL == zbx_validate_hostname(CONFIG_SERVER))
 	{
@@ -716,16 +775,30 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	0,			1},
 		{"CacheSize",			&CONFIG_CONF_CACHE_SIZE,		TYPE_UINT64,
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(64) * ZBX_GIBIBYTE},
+		{"CacheUpdateThreads",		&CONFIG_CONF_CACHE_THREADS,		TYPE_INT,
+			PARM_OPT,	1,			16},
 		{"HistoryCacheSize",		&CONFIG_HISTORY_CACHE_SIZE,		TYPE_UINT64,
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
 		{"HistoryIndexCacheSize",	&CONFIG_HISTORY_INDEX_CACHE_SIZE,	TYPE_UINT64,
 			PARM_OPT,	128 * ZBX_KIBIBYTE,	__UINT64_C(2) * ZBX_GIBIBYTE},
+		{"HistoryCacheShards",		&CONFIG_HISTORY_CACHE_SHARDS,		TYPE_INT,
+			PARM_OPT,	1,			ZBX_HC_SHARDS_MAX},
+		{"PreprocessingRingSize",	&CONFIG_PREPROCESSOR_RING_SIZE,		TYPE_UINT64,
+			PARM_OPT,	0,			__UINT64_C(2) * ZBX_GIBIBYTE},
 		{"HousekeepingFrequency",	&CONFIG_HOUSEKEEPING_FREQUENCY,		TYPE_INT,
 			PARM_OPT,	0,			24},
 		{"ProxyLocalBuffer",		&CONFIG_PROXY_LOCAL_BUFFER,		TYPE_INT,
 			PARM_OPT,	0,			720},
 		{"ProxyOfflineBuffer",		&CONFIG_PROXY_OFFLINE_BUFFER,		TYPE_INT,
 			PARM_OPT,	1,			720},
+		{"ProxyHistoryLogDir",		&CONFIG_PROXY_HISTORY_LOG_DIR,		TYPE_STRING,
+			PARM_OPT,	0,			0},
+		{"ProxyHistoryLogSegmentSize",	&CONFIG_PROXY_HISTORY_LOG_SEGMENT_SIZE,	TYPE_UINT64,
+			PARM_OPT,	ZBX_MEBIBYTE,		__UINT64_C(1) * ZBX_GIBIBYTE},
+		{"ProxyMemoryBufferSize",	&CONFIG_PROXY_MEMORY_BUFFER_SIZE,	TYPE_UINT64,
+			PARM_OPT,	0,			__UINT64_C(2) * ZBX_GIBIBYTE},
+		{"ProxyMemoryBufferAge",	&CONFIG_PROXY_MEMORY_BUFFER_AGE,	TYPE_INT,
+			PARM_OPT,	0,			SEC_PER_DAY * 10},
 		{"HeartbeatFrequency",		&CONFIG_HEARTBEAT_FREQUENCY,		TYPE_INT,
 			PARM_OPT,	0,			ZBX_PROXY_HEARTBEAT_FREQUENCY_MAX},
 		{"ConfigFrequency",		&CONFIG_PROXYCONFIG_FREQUENCY,		TYPE_INT,
@@ -868,10 +941,24 @@ static void	zbx_load_config(ZBX_TASK_EX *task)
 			PARM_OPT,	0,			0},
 		{"StartPreprocessors",		&CONFIG_PREPROCESSOR_FORKS,		TYPE_INT,
 			PARM_OPT,	1,			1000},
+		{"StartPreprocessingManagers",	&CONFIG_PREPROCMAN_FORKS,		TYPE_INT,
+			PARM_OPT,	1,			ZBX_PREPROCESSING_MANAGERS_MAX},
 		{"StartHistoryPollers",		&CONFIG_HISTORYPOLLER_FORKS,		TYPE_INT,
 			PARM_OPT,	0,			1000},
+		{"StartAgentPollers",		&CONFIG_AGENTPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"StartSNMPPollers",		&CONFIG_SNMPPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"StartHTTPAgentPollers",	&CONFIG_HTTPAGENTPOLLER_FORKS,		TYPE_INT,
+			PARM_OPT,	0,			1000},
+		{"MaxConcurrentChecksPerPoller",	&CONFIG_MAX_CONCURRENT_CHECKS,	TYPE_INT,
+			PARM_OPT,	1,			1000},
 		{"ListenBacklog",		&CONFIG_TCP_MAX_BACKLOG_SIZE,		TYPE_INT,
 			PARM_OPT,	0,			INT_MAX},
+		{"CompressionCodec",		&CONFIG_COMPRESSION_CODEC,		TYPE_STRING,
+			PARM_OPT,	0,			0},
+		{"CompressionDictionary",	&CONFIG_COMPRESSION_DICTIONARY,		TYPE_STRING,
+			PARM_OPT,	0,			0},
 		{NULL}
 	};
 
@@ -1117,6 +1204,13 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 		exit(EXIT_FAILURE);
 	}
 
+	if (SUCCEED != zbx_compress_init(CONFIG_COMPRESSION_CODEC, CONFIG_COMPRESSION_DICTIONARY, &error))
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize data compression: %s", error);
+		zbx_free(error);
+		exit(EXIT_FAILURE);
+	}
+
 	zbx_free_config();
 
 	if (SUCCEED != init_database_cache(&error))
@@ -1133,6 +1227,21 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 		exit(EXIT_FAILURE);
 	}
 
+	if (SUCCEED != zbx_pb_init(CONFIG_PROXY_HISTORY_LOG_DIR, CONFIG_PROXY_HISTORY_LOG_SEGMENT_SIZE,
+			CONFIG_PROXY_LOCAL_BUFFER, &error))
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize proxy history log: %s", error);
+		zbx_free(error);
+		exit(EXIT_FAILURE);
+	}
+
+	if (SUCCEED != zbx_pmb_init(CONFIG_PROXY_MEMORY_BUFFER_SIZE, CONFIG_PROXY_MEMORY_BUFFER_AGE, &error))
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize proxy memory buffer: %s", error);
+		zbx_free(error);
+		exit(EXIT_FAILURE);
+	}
+
 	if (SUCCEED != init_configuration_cache(&error))
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize configuration cache: %s", error);
@@ -1140,6 +1249,13 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 		exit(EXIT_FAILURE);
 	}
 
+	if (SUCCEED != zbx_preprocessor_ring_init(&error))
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize preprocessing ring: %s", error);
+		zbx_free(error);
+		exit(EXIT_FAILURE);
+	}
+
 	if (SUCCEED != init_selfmon_collector(&error))
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "cannot initialize self-monitoring: %s", error);
@@ -1201,7 +1317,8 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 			+ CONFIG_JAVAPOLLER_FORKS + CONFIG_SNMPTRAPPER_FORKS + CONFIG_SELFMON_FORKS
 			+ CONFIG_VMWARE_FORKS + CONFIG_IPMIMANAGER_FORKS + CONFIG_TASKMANAGER_FORKS
 			+ CONFIG_PREPROCMAN_FORKS + CONFIG_PREPROCESSOR_FORKS + CONFIG_HISTORYPOLLER_FORKS
-			+ CONFIG_AVAILMAN_FORKS;
+			+ CONFIG_AVAILMAN_FORKS + CONFIG_AGENTPOLLER_FORKS + CONFIG_SNMPPOLLER_FORKS
+			+ CONFIG_HTTPAGENTPOLLER_FORKS;
 
 	threads = (pid_t *)zbx_calloc(threads, threads_num, sizeof(pid_t));
 	threads_flags = (int *)zbx_calloc(threads_flags, threads_num, sizeof(int));
@@ -1314,6 +1431,11 @@ int	MAIN_ZABBIX_ENTRY(int flags)
 				thread_args.args = &poller_type;
 				zbx_thread_start(poller_thread, &thread_args, &threads[i]);
 				break;
+			case ZBX_PROCESS_TYPE_AGENTPOLLER:
+			case ZBX_PROCESS_TYPE_SNMPPOLLER:
+			case ZBX_PROCESS_TYPE_HTTPAGENTPOLLER:
+				zbx_thread_start(async_poller_thread, &thread_args, &threads[i]);
+				break;
 			case ZBX_PROCESS_TYPE_AVAILMAN:
 				threads_flags[i] = ZBX_THREAD_PRIORITY_FIRST;
 				zbx_thread_start(availability_manager_thread, &thread_args, &threads[i]);
@@ -1365,6 +1487,7 @@ void	zbx_on_exit(int ret)
 
 	DBconnect(ZBX_DB_CONNECT_EXIT);
 	free_database_cache();
+	zbx_pmb_flush();
 	free_configuration_cache();
 	DBclose();
 
@@ -1376,6 +1499,8 @@ void	zbx_on_exit(int ret)
 
 	free_selfmon_collector();
 	free_proxy_history_lock();
+	zbx_pb_destroy();
+	zbx_pmb_destroy();
 
 	zbx_unload_modules();
 
@@ -25,11 +25,15 @@
 #include "zbxjson.h"
 
 #include "comms.h"
+#include "proxy.h"
 #include "servercomms.h"
 #include "daemon.h"
 
 extern unsigned int	configured_tls_connect_mode;
 
+/* protocol flags of the last message received from server, used to negotiate compression codec */
+static int	server_protocol = 0;
+
 #if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
 extern char	*CONFIG_TLS_SERVER_CERT_ISSUER;
 extern char	*CONFIG_TLS_SERVER_CERT_SUBJECT;
@@ -130,8 +134,9 @@ int	get_data_from_server(zbx_socket_t *sock, const char *request, char **error)
 	zbx_json_addstring(&j, "request", request, ZBX_JSON_TYPE_STRING);
 	zbx_json_addstring(&j, "host", CONFIG_HOSTNAME, ZBX_JSON_TYPE_STRING);
 	zbx_json_addstring(&j, ZBX_PROTO_TAG_VERSION, ZABBIX_VERSION, ZBX_JSON_TYPE_STRING);
+	zbx_proxy_add_compression(&j);
 
-	if (SUCCEED != zbx_tcp_send_ext(sock, j.buffer, strlen(j.buffer), ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS, 0))
+	if (SUCCEED != zbx_tcp_send_ext(sock, j.buffer, strlen(j.buffer), zbx_tcp_compress_flags(server_protocol), 0))
 	{
 		*error = zbx_strdup(*error, zbx_socket_strerror());
 		goto exit;
@@ -143,10 +148,15 @@ int	get_data_from_server(zbx_socket_t *sock, const char *request, char **error)
 		goto exit;
 	}
 
+	server_protocol = sock->protocol;
+
 	zabbix_log(LOG_LEVEL_DEBUG, "Received [%s] from server", sock->buffer);
 
 	ret = SUCCEED;
 exit:
+	if (SUCCEED != ret)
+		server_protocol = 0;
+
 	zbx_json_free(&j);
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
@@ -156,32 +166,83 @@ exit:
 
 /******************************************************************************
  *                                                                            *
- * Function: put_data_to_server                                               *
+ * Function: send_data_batch_to_server                                        *
  *                                                                            *
- * Purpose: send data to server                                               *
+ * Purpose: send data to server without waiting for response                  *
  *                                                                            *
  * Return value: SUCCEED - processed successfully                             *
  *               FAIL - an error occurred                                     *
  *                                                                            *
+ * Comments: The response must be received with recv_data_batch_response().   *
+ *           Several batches can be sent before receiving their responses,    *
+ *           responses are received in the same order.                        *
+ *                                                                            *
  ******************************************************************************/
-int	put_data_to_server(zbx_socket_t *sock, struct zbx_json *j, char **error)
+int	send_data_batch_to_server(zbx_socket_t *sock, const char *data, size_t size, char **error)
 {
 	int	ret = FAIL;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() datalen:" ZBX_FS_SIZE_T, __func__, (zbx_fs_size_t)j->buffer_size);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() datalen:" ZBX_FS_SIZE_T, __func__, (zbx_fs_size_t)size);
 
-	if (SUCCEED != zbx_tcp_send_ext(sock, j->buffer, strlen(j->buffer), ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS, 0))
+	if (SUCCEED != zbx_tcp_send_ext(sock, data, size, zbx_tcp_compress_flags(server_protocol), 0))
 	{
 		*error = zbx_strdup(*error, zbx_socket_strerror());
+		server_protocol = 0;
 		goto out;
 	}
 
+	ret = SUCCEED;
+out:
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: recv_data_batch_response                                         *
+ *                                                                            *
+ * Purpose: receive server response to the oldest sent data batch             *
+ *                                                                            *
+ * Return value: SUCCEED - processed successfully                             *
+ *               FAIL - an error occurred                                     *
+ *                                                                            *
+ ******************************************************************************/
+int	recv_data_batch_response(zbx_socket_t *sock, char **error)
+{
+	int	ret = FAIL;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
 	if (SUCCEED != zbx_recv_response(sock, 0, error))
+	{
+		/* fall back to zlib until server advertises its codecs again, it might have been downgraded */
+		server_protocol = 0;
 		goto out;
+	}
 
+	server_protocol = sock->protocol;
 	ret = SUCCEED;
 out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
 
 	return ret;
 }
+
+/******************************************************************************
+ *                                                                            *
+ * Function: put_data_to_server                                               *
+ *                                                                            *
+ * Purpose: send data to server                                               *
+ *                                                                            *
+ * Return value: SUCCEED - processed successfully                             *
+ *               FAIL - an error occurred                                     *
+ *                                                                            *
+ ******************************************************************************/
+int	put_data_to_server(zbx_socket_t *sock, const char *data, size_t size, char **error)
+{
+	if (SUCCEED != send_data_batch_to_server(sock, data, size, error))
+		return FAIL;
+
+	return recv_data_batch_response(sock, error);
+}
@@ -26,6 +26,7 @@
 #include "discovery.h"
 #include "zbxserver.h"
 #include "zbxself.h"
+#include "zbxproxybuf.h"
 
 #include "daemon.h"
 #include "discoverer.h"
@@ -58,6 +59,9 @@ static void	proxy_update_service(zbx_uint64_t druleid, zbx_uint64_t dcheckid, co
 {
 	char	*ip_esc, *dns_esc, *value_esc;
 
+	if (SUCCEED == zbx_pmb_discovery_write(now, druleid, dcheckid, ip, dns, port, value, status))
+		return;
+
 	ip_esc = DBdyn_escape_field("proxy_dhistory", "ip", ip);
 	dns_esc = DBdyn_escape_field("proxy_dhistory", "dns", dns);
 	value_esc = DBdyn_escape_field("proxy_dhistory", "value", value);
@@ -84,6 +88,9 @@ static void	proxy_update_host(zbx_uint64_t druleid, const char *ip, const char *
 {
 	char	*ip_esc, *dns_esc;
 
+	if (SUCCEED == zbx_pmb_discovery_write(now, druleid, 0, ip, dns, 0, "", status))
+		return;
+
 	ip_esc = DBdyn_escape_field("proxy_dhistory", "ip", ip);
 	dns_esc = DBdyn_escape_field("proxy_dhistory", "dns", dns);
 
@@ -623,6 +630,7 @@ static void	process_rule(DB_DRULE *drule)
 				proxy_update_host(drule->druleid, ip, dns, host_status, now);
 
 			DBcommit();
+			zbx_pmb_db_release();
 		}
 		while (SUCCEED == iprange_next(&iprange, ipaddress));
 next:
@@ -418,7 +418,7 @@ static void	get_pinger_hosts(icmpitem_t **icmp_items, int *icmp_items_alloc, int
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
 	items = &item;
-	num = DCconfig_get_poller_items(ZBX_POLLER_TYPE_PINGER, &items);
+	num = DCconfig_get_poller_items(ZBX_POLLER_TYPE_PINGER, 0, &items);
 
 	for (i = 0; i < num; i++)
 	{
@@ -0,0 +1,1093 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+
+#include "async_event.h"
+
+#if defined(LIBEVENT_VERSION_NUMBER) && LIBEVENT_VERSION_NUMBER >= 0x2000000
+#	include <event2/dns.h>
+#	define ZBX_ASYNC_POLLER_EVDNS
+#	ifndef EVDNS_BASE_INITIALIZE_NAMESERVERS
+#		define EVDNS_BASE_INITIALIZE_NAMESERVERS	1	/* libevent 2.0 takes boolean flag */
+#	endif
+#endif
+
+#include "log.h"
+#include "comms.h"
+#include "dbcache.h"
+#include "daemon.h"
+#include "zbxself.h"
+#include "zbxserver.h"
+#include "preproc.h"
+#include "zbxcompress.h"
+#include "zbxcrypto.h"
+#include "zbxavailability.h"
+
+#include "poller.h"
+#include "checks_agent.h"
+#include "checks_snmp.h"
+#include "checks_http.h"
+#include "async_poller.h"
+
+/*
+ * Asynchronous agent poller keeps up to MaxConcurrentChecksPerPoller passive agent checks in flight within
+ * a single process. Every check uses non-blocking socket driven by libevent - it connects to the agent, sends
+ * the item key and reads the response. Completed checks are processed in batches: values are passed to
+ * preprocessing, interface availability is updated and items are returned to the queue.
+ *
+ * Host names are resolved by libevent asynchronous DNS resolver, which reads name servers from resolv.conf and
+ * host names from the hosts file. With libevent 1.x host names are resolved synchronously.
+ *
+ * Encrypted connections are not supported, agent checks on hosts with TLS are processed by regular pollers.
+ *
+ * Asynchronous SNMP poller runs in the same loop. It takes batches of items of one interface from the queue
+ * and requests them with Net-SNMP asynchronous sessions (see zbx_async_check_snmp()), so that requests to
+ * many devices are in flight at the same time and slow devices do not block the process. SNMP walks are not
+ * supported, discovery and dynamic index items are processed by regular pollers.
+ *
+ * Asynchronous HTTP agent poller passes HTTP agent checks to a single cURL multi handle driven by the same
+ * event loop (see zbx_async_check_httpagent()). Completed checks are processed as soon as their transfers
+ * finish, connections, TLS sessions and resolved host names are shared between checks.
+ */
+
+extern unsigned char	process_type, program_type;
+extern int		server_num, process_num;
+
+#ifndef SOCK_CLOEXEC
+#	define SOCK_CLOEXEC 0	/* SOCK_CLOEXEC is Linux-specific, available since 2.6.23 */
+#endif
+
+#if !defined(LIBEVENT_VERSION_NUMBER) || LIBEVENT_VERSION_NUMBER < 0x2000000
+struct event	*event_new(struct event_base *ev, evutil_socket_t fd, short what,
+		void(*cb_func)(int, short, void *), void *cb_arg)
+{
+	struct event	*event;
+
+	event = zbx_malloc(NULL, sizeof(struct event));
+	event_set(event, fd, what, cb_func, cb_arg);
+	event_base_set(ev, event);
+
+	return event;
+}
+
+void	event_free(struct event *event)
+{
+	event_del(event);
+	zbx_free(event);
+}
+
+#endif
+
+#define ZBX_AGENT_RECV_BUF_SIZE		(16 * ZBX_KIBIBYTE)
+
+#define ZBX_AGENT_CHECK_STATE_RESOLVE	0
+#define ZBX_AGENT_CHECK_STATE_CONNECT	1
+#define ZBX_AGENT_CHECK_STATE_SEND	2
+#define ZBX_AGENT_CHECK_STATE_RECV	3
+
+typedef struct zbx_async_poller zbx_async_poller_t;
+
+/* completed check waiting to be processed */
+typedef struct
+{
+	DC_ITEM		item;
+	AGENT_RESULT	result;
+	int		errcode;
+}
+zbx_async_result_t;
+
+typedef struct
+{
+	DC_ITEM			item;
+	AGENT_RESULT		result;
+	unsigned char		state;
+
+	int			fd;
+	struct event		*ev;
+	short			ev_what;
+	double			deadline;
+
+	/* request while sending, response while receiving */
+	zbx_agent_packet_t	packet;
+
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+	/* pending host name resolution */
+	struct evdns_getaddrinfo_request	*dns_request;
+#endif
+	zbx_async_poller_t	*poller;
+}
+zbx_agent_check_t;
+
+struct zbx_async_poller
+{
+	struct event_base	*base;
+	struct event		*ev_timer;
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+	struct evdns_base	*dnsbase;
+#endif
+	/* SourceIP address resolved at startup, NULL if not set or invalid */
+	struct addrinfo		*source_ip;
+
+	/* ZBX_POLLER_TYPE_AGENT, ZBX_POLLER_TYPE_SNMP or ZBX_POLLER_TYPE_HTTPAGENT */
+	unsigned char		poller_type;
+
+#ifdef HAVE_LIBCURL
+	zbx_async_httpagent_t	*httpagent;
+#endif
+
+	/* checks taken from the queue and not yet returned */
+	int			checks_num;
+
+	/* completed checks */
+	zbx_vector_ptr_t	checks_done;
+};
+
+static void	agent_check_event_cb(evutil_socket_t fd, short what, void *arg);
+
+static const char	*agent_check_state_string(unsigned char state)
+{
+	switch (state)
+	{
+		case ZBX_AGENT_CHECK_STATE_RESOLVE:
+			return "resolving";
+		case ZBX_AGENT_CHECK_STATE_CONNECT:
+			return "connecting to";
+		case ZBX_AGENT_CHECK_STATE_SEND:
+			return "sending request to";
+		default:
+			return "receiving response from";
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_add_result                                          *
+ *                                                                            *
+ * Purpose: adds completed check to be processed by poller                    *
+ *                                                                            *
+ * Parameters: poller  - [IN] the asynchronous poller                         *
+ *             item    - [IN] the checked item, ownership of item data is     *
+ *                            passed to poller                                *
+ *             result  - [IN] the check result, ownership is passed to poller *
+ *             errcode - [IN] the check result code                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_add_result(zbx_async_poller_t *poller, const DC_ITEM *item, const AGENT_RESULT *result,
+		int errcode)
+{
+	zbx_async_result_t	*res;
+
+	res = (zbx_async_result_t *)zbx_malloc(NULL, sizeof(zbx_async_result_t));
+	res->item = *item;
+	res->result = *result;
+	res->errcode = errcode;
+
+	zbx_vector_ptr_append(&poller->checks_done, res);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_finish                                               *
+ *                                                                            *
+ * Purpose: releases check resources and passes its result to poller          *
+ *                                                                            *
+ * Parameters: check   - [IN] the agent check                                 *
+ *             errcode - [IN] the check result code                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_finish(zbx_agent_check_t *check, int errcode)
+{
+	if (NULL != check->ev)
+	{
+		event_free(check->ev);
+		check->ev = NULL;
+	}
+
+	if (-1 != check->fd)
+	{
+		close(check->fd);
+		check->fd = -1;
+	}
+
+	zbx_free(check->packet.buffer);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() itemid:" ZBX_FS_UI64 " %s", __func__, check->item.itemid,
+			zbx_result_string(errcode));
+
+	async_poller_add_result(check->poller, &check->item, &check->result, errcode);
+	zbx_free(check);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_fail                                                 *
+ *                                                                            *
+ * Purpose: finishes agent check with network error                           *
+ *                                                                            *
+ * Parameters: check   - [IN] the agent check                                 *
+ *             errcode - [IN] the check result code                           *
+ *             error   - [IN] the error message, freed by this function       *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_fail(zbx_agent_check_t *check, int errcode, char *error)
+{
+	SET_MSG_RESULT(&check->result, zbx_dsprintf(NULL, "Get value from agent failed: %s", error));
+	zbx_free(error);
+
+	agent_check_finish(check, errcode);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_wait                                                 *
+ *                                                                            *
+ * Purpose: waits for socket event until the check deadline                   *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *             what  - [IN] the socket event to wait for (EV_READ, EV_WRITE)  *
+ *                          or 0 to wait for the deadline only                *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_wait(zbx_agent_check_t *check, short what)
+{
+	struct timeval	tv;
+	double		timeout;
+
+	if (NULL == check->ev || what != check->ev_what)
+	{
+		if (NULL != check->ev)
+			event_free(check->ev);
+
+		check->ev = event_new(check->poller->base, check->fd, what, agent_check_event_cb, check);
+		check->ev_what = what;
+	}
+
+	if (0 > (timeout = check->deadline - zbx_time()))
+		timeout = 0;
+
+	tv.tv_sec = (time_t)timeout;
+	tv.tv_usec = (suseconds_t)((timeout - (double)tv.tv_sec) * 1000000);
+
+	event_add(check->ev, &tv);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_connect                                              *
+ *                                                                            *
+ * Purpose: starts non-blocking connection to agent and prepares request      *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *             ai    - [IN] the resolved agent address                        *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_connect(zbx_agent_check_t *check, const struct addrinfo *ai)
+{
+	const DC_ITEM	*item = &check->item;
+
+	if (-1 == (check->fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)))
+	{
+		agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot create socket [[%s]:%hu]: %s",
+				item->interface.addr, item->interface.port, zbx_strerror(errno)));
+		return;
+	}
+
+#if !SOCK_CLOEXEC
+	if (-1 == fcntl(check->fd, F_SETFD, FD_CLOEXEC))
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "failed to set the FD_CLOEXEC file descriptor flag on socket [[%s]:%hu]:"
+				" %s", item->interface.addr, item->interface.port, zbx_strerror(errno));
+	}
+#endif
+	if (-1 == fcntl(check->fd, F_SETFL, fcntl(check->fd, F_GETFL) | O_NONBLOCK))
+	{
+		agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot set non-blocking mode on socket"
+				" [[%s]:%hu]: %s", item->interface.addr, item->interface.port, zbx_strerror(errno)));
+		return;
+	}
+
+	if (NULL != CONFIG_SOURCE_IP)
+	{
+		if (NULL == check->poller->source_ip)
+		{
+			agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "invalid source IP address [%s]",
+					CONFIG_SOURCE_IP));
+			return;
+		}
+
+		if (-1 == bind(check->fd, check->poller->source_ip->ai_addr, check->poller->source_ip->ai_addrlen))
+		{
+			agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "bind() failed: %s",
+					zbx_strerror(errno)));
+			return;
+		}
+	}
+
+	if (0 != connect(check->fd, ai->ai_addr, ai->ai_addrlen) && EINPROGRESS != errno)
+	{
+		agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot connect to [[%s]:%hu]: %s",
+				item->interface.addr, item->interface.port, zbx_strerror(errno)));
+		return;
+	}
+
+	zbx_agent_packet_request(&check->packet, item->key);
+
+	check->state = ZBX_AGENT_CHECK_STATE_CONNECT;
+	agent_check_wait(check, EV_WRITE);
+}
+
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_resolved_cb                                          *
+ *                                                                            *
+ * Purpose: agent host name resolution callback                               *
+ *                                                                            *
+ * Parameters: result - [IN] the resolution result, EVUTIL_EAI_CANCEL if      *
+ *                           the check deadline was reached                   *
+ *             ai     - [IN] the resolved addresses                           *
+ *             arg    - [IN] the agent check                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_resolved_cb(int result, struct evutil_addrinfo *ai, void *arg)
+{
+	zbx_agent_check_t	*check = (zbx_agent_check_t *)arg;
+
+	check->dns_request = NULL;
+
+	if (EVUTIL_EAI_CANCEL == result)
+	{
+		agent_check_fail(check, TIMEOUT_ERROR, zbx_dsprintf(NULL, "timeout while resolving [%s]",
+				check->item.interface.addr));
+	}
+	else if (0 != result)
+	{
+		agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot resolve [%s]: %s",
+				check->item.interface.addr, evutil_gai_strerror(result)));
+	}
+	else
+		agent_check_connect(check, ai);
+
+	if (NULL != ai)
+		evutil_freeaddrinfo(ai);
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_start                                                *
+ *                                                                            *
+ * Purpose: starts resolving agent host name                                  *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *                                                                            *
+ * Comments: The check continues with connection to agent when the host name  *
+ *           is resolved. Host names are resolved synchronously if libevent   *
+ *           asynchronous DNS resolver is not available.                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_start(zbx_agent_check_t *check)
+{
+	char					service[8];
+	const DC_ITEM				*item = &check->item;
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+	struct evutil_addrinfo			hints;
+	struct evdns_getaddrinfo_request	*request;
+#else
+	struct addrinfo				hints, *ai = NULL;
+#endif
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() host:'%s' addr:'%s' key:'%s'", __func__, item->host.host,
+			item->interface.addr, item->key);
+
+	zbx_snprintf(service, sizeof(service), "%hu", item->interface.port);
+	memset(&hints, 0, sizeof(hints));
+#ifdef HAVE_IPV6
+	hints.ai_family = PF_UNSPEC;
+#else
+	hints.ai_family = AF_INET;
+#endif
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	check->state = ZBX_AGENT_CHECK_STATE_RESOLVE;
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+	/* the deadline is watched while host name is resolved, see agent_check_event_cb() */
+	agent_check_wait(check, 0);
+
+	/* the callback is called before returning if host name is resolved right away, for example IP address, */
+	/* in that case the check can be already finished and must not be accessed                             */
+	if (NULL != (request = evdns_getaddrinfo(check->poller->dnsbase, item->interface.addr, service, &hints,
+			agent_check_resolved_cb, check)))
+	{
+		check->dns_request = request;
+	}
+#else
+	if (0 != getaddrinfo(item->interface.addr, service, &hints, &ai))
+	{
+		agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot resolve [%s]",
+				item->interface.addr));
+	}
+	else
+		agent_check_connect(check, ai);
+
+	if (NULL != ai)
+		freeaddrinfo(ai);
+#endif
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_connected                                            *
+ *                                                                            *
+ * Purpose: checks result of non-blocking connect                             *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *                                                                            *
+ * Return value: SUCCEED - the connection was established                     *
+ *               FAIL    - otherwise, the check is finished with error        *
+ *                                                                            *
+ ******************************************************************************/
+static int	agent_check_connected(zbx_agent_check_t *check)
+{
+	int		error = 0;
+	socklen_t	len = sizeof(error);
+
+	if (-1 == getsockopt(check->fd, SOL_SOCKET, SO_ERROR, &error, &len))
+		error = errno;
+
+	if (0 != error)
+	{
+		agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot connect to [[%s]:%hu]: %s",
+				check->item.interface.addr, check->item.interface.port, zbx_strerror(error)));
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_send                                                 *
+ *                                                                            *
+ * Purpose: sends request to agent                                            *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_send(zbx_agent_check_t *check)
+{
+	ssize_t	n;
+
+	while (check->packet.buffer_offset < check->packet.buffer_size)
+	{
+		if (-1 == (n = write(check->fd, check->packet.buffer + check->packet.buffer_offset,
+				check->packet.buffer_size - check->packet.buffer_offset)))
+		{
+			if (EINTR == errno)
+				continue;
+
+			if (EAGAIN == errno || EWOULDBLOCK == errno)
+			{
+				agent_check_wait(check, EV_WRITE);
+				return;
+			}
+
+			agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot send request to [[%s]:%hu]:"
+					" %s", check->item.interface.addr, check->item.interface.port,
+					zbx_strerror(errno)));
+			return;
+		}
+
+		check->packet.buffer_offset += (size_t)n;
+	}
+
+	check->state = ZBX_AGENT_CHECK_STATE_RECV;
+	check->packet.buffer_alloc = ZBX_AGENT_RECV_BUF_SIZE;
+	check->packet.buffer = (char *)zbx_realloc(check->packet.buffer, check->packet.buffer_alloc);
+	check->packet.buffer_offset = 0;
+	check->packet.buffer_size = 0;
+
+	agent_check_wait(check, EV_READ);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_parse_header                                         *
+ *                                                                            *
+ * Purpose: validates response header, gets expected response size            *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *                                                                            *
+ * Return value: SUCCEED - the header is valid or not yet fully received      *
+ *               FAIL    - otherwise, the check is finished with error        *
+ *                                                                            *
+ ******************************************************************************/
+static int	agent_check_parse_header(zbx_agent_check_t *check)
+{
+	char	*error = NULL;
+
+	if (SUCCEED != zbx_agent_packet_parse_header(&check->packet, check->item.interface.addr,
+			check->item.interface.port, &error))
+	{
+		agent_check_fail(check, NETWORK_ERROR, error);
+		return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_complete                                             *
+ *                                                                            *
+ * Purpose: parses received response and finishes the check                   *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_complete(zbx_agent_check_t *check)
+{
+	agent_check_finish(check, zbx_agent_packet_parse_response(&check->packet, check->item.interface.addr,
+			check->item.interface.port, &check->result));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_recv                                                 *
+ *                                                                            *
+ * Purpose: reads response from agent                                         *
+ *                                                                            *
+ * Parameters: check - [IN] the agent check                                   *
+ *                                                                            *
+ * Comments: The check is completed when the whole packet is received or      *
+ *           agent closes the connection.                                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_recv(zbx_agent_check_t *check)
+{
+	ssize_t	n;
+
+	for (;;)
+	{
+		if (-1 == (n = read(check->fd, check->packet.buffer + check->packet.buffer_offset,
+				check->packet.buffer_alloc - check->packet.buffer_offset - 1)))
+		{
+			if (EINTR == errno)
+				continue;
+
+			if (EAGAIN == errno || EWOULDBLOCK == errno)
+			{
+				agent_check_wait(check, EV_READ);
+				return;
+			}
+
+			agent_check_fail(check, NETWORK_ERROR, zbx_dsprintf(NULL, "cannot read response from"
+					" [[%s]:%hu]: %s", check->item.interface.addr, check->item.interface.port,
+					zbx_strerror(errno)));
+			return;
+		}
+
+		if (0 == n)
+			break;
+
+		check->packet.buffer_offset += (size_t)n;
+
+		if (SUCCEED != agent_check_parse_header(check))
+			return;
+
+		if (0 != check->packet.buffer_size && check->packet.buffer_offset >= check->packet.buffer_size)
+			break;
+	}
+
+	agent_check_complete(check);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_check_event_cb                                             *
+ *                                                                            *
+ * Purpose: agent check socket event callback                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	agent_check_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_agent_check_t	*check = (zbx_agent_check_t *)arg;
+
+	ZBX_UNUSED(fd);
+
+	if (0 != (what & EV_TIMEOUT))
+	{
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+		if (NULL != check->dns_request)
+		{
+			/* the check is finished by resolution callback with EVUTIL_EAI_CANCEL result */
+			evdns_getaddrinfo_cancel(check->dns_request);
+			return;
+		}
+#endif
+		agent_check_fail(check, TIMEOUT_ERROR, zbx_dsprintf(NULL, "timeout while %s [[%s]:%hu]",
+				agent_check_state_string(check->state), check->item.interface.addr,
+				check->item.interface.port));
+		return;
+	}
+
+	switch (check->state)
+	{
+		case ZBX_AGENT_CHECK_STATE_CONNECT:
+			if (SUCCEED != agent_check_connected(check))
+				break;
+
+			check->state = ZBX_AGENT_CHECK_STATE_SEND;
+			ZBX_FALLTHROUGH;
+		case ZBX_AGENT_CHECK_STATE_SEND:
+			agent_check_send(check);
+			break;
+		case ZBX_AGENT_CHECK_STATE_RECV:
+			agent_check_recv(check);
+			break;
+	}
+}
+
+static void	async_poller_timer_cb(evutil_socket_t fd, short what, void *arg)
+{
+	ZBX_UNUSED(fd);
+	ZBX_UNUSED(what);
+	ZBX_UNUSED(arg);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_start_agent_checks                                  *
+ *                                                                            *
+ * Purpose: starts agent checks of items taken from the queue                 *
+ *                                                                            *
+ * Parameters: poller   - [IN] the asynchronous poller                        *
+ *             items    - [IN] the items to check                             *
+ *             results  - [IN] the prepared item results                      *
+ *             errcodes - [IN] the item error codes after preparation         *
+ *             num      - [IN] the number of items                            *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_start_agent_checks(zbx_async_poller_t *poller, DC_ITEM *items, AGENT_RESULT *results,
+		int *errcodes, int num)
+{
+	int			i, unchecked_num = 0;
+	zbx_uint64_t		unchecked_itemids[MAX_POLLER_ITEMS];
+	zbx_agent_check_t	*check;
+
+	for (i = 0; i < num; i++)
+	{
+		if (SUCCEED == errcodes[i] && ZBX_TCP_SEC_UNENCRYPTED != items[i].host.tls_connect)
+		{
+			/* host encryption settings were changed after the item was queued, return it */
+			/* to the queue unchecked so it's moved to regular pollers                    */
+			unchecked_itemids[unchecked_num++] = items[i].itemid;
+
+			zbx_clean_items(&items[i], 1, &results[i]);
+			DCconfig_clean_items(&items[i], NULL, 1);
+			continue;
+		}
+
+		check = (zbx_agent_check_t *)zbx_malloc(NULL, sizeof(zbx_agent_check_t));
+		memset(check, 0, sizeof(zbx_agent_check_t));
+
+		check->item = items[i];
+		check->result = results[i];
+		check->fd = -1;
+		check->deadline = zbx_time() + CONFIG_TIMEOUT;
+		check->poller = poller;
+
+		if (SUCCEED != errcodes[i])
+			agent_check_finish(check, errcodes[i]);
+		else
+			agent_check_start(check);
+	}
+
+	if (0 != unchecked_num)
+	{
+		zbx_dc_requeue_unchecked_items(unchecked_itemids, (size_t)unchecked_num);
+		poller->checks_num -= unchecked_num;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_batch_done_cb                                       *
+ *                                                                            *
+ * Purpose: passes results of completed batch of checks to poller             *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_batch_done_cb(DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, void *arg)
+{
+	zbx_async_poller_t	*poller = (zbx_async_poller_t *)arg;
+	int			i;
+
+	for (i = 0; i < num; i++)
+		async_poller_add_result(poller, &items[i], &results[i], errcodes[i]);
+}
+
+#ifdef HAVE_LIBCURL
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_httpagent_done_cb                                   *
+ *                                                                            *
+ * Purpose: passes result of completed HTTP agent check to poller             *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_httpagent_done_cb(DC_ITEM *item, AGENT_RESULT *result, int errcode, void *arg)
+{
+	async_poller_add_result((zbx_async_poller_t *)arg, item, result, errcode);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_start_httpagent_checks                              *
+ *                                                                            *
+ * Purpose: starts HTTP agent checks of items taken from the queue            *
+ *                                                                            *
+ * Parameters: poller   - [IN] the asynchronous poller                        *
+ *             items    - [IN] the items to check                             *
+ *             results  - [IN] the prepared item results                      *
+ *             errcodes - [IN] the item error codes after preparation         *
+ *             num      - [IN] the number of items                            *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_start_httpagent_checks(zbx_async_poller_t *poller, DC_ITEM *items, AGENT_RESULT *results,
+		int *errcodes, int num)
+{
+	int	i;
+
+	for (i = 0; i < num; i++)
+	{
+		if (SUCCEED != errcodes[i])
+			async_poller_add_result(poller, &items[i], &results[i], errcodes[i]);
+		else
+			zbx_async_check_httpagent(poller->httpagent, &items[i], &results[i]);
+	}
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_start_checks                                        *
+ *                                                                            *
+ * Purpose: takes due items from the queue and starts their checks            *
+ *                                                                            *
+ * Parameters: poller    - [IN] the asynchronous poller                       *
+ *             nextcheck - [OUT] the next item check time                     *
+ *                                                                            *
+ ******************************************************************************/
+static void	async_poller_start_checks(zbx_async_poller_t *poller, int *nextcheck)
+{
+	DC_ITEM			item, *items;
+	AGENT_RESULT		results[MAX_POLLER_ITEMS];
+	int			errcodes[MAX_POLLER_ITEMS], num;
+
+	while (poller->checks_num < CONFIG_MAX_CONCURRENT_CHECKS)
+	{
+		items = &item;
+
+		if (0 == (num = DCconfig_get_poller_items(poller->poller_type,
+				CONFIG_MAX_CONCURRENT_CHECKS - poller->checks_num, &items)))
+		{
+			*nextcheck = DCconfig_get_poller_nextcheck(poller->poller_type);
+			break;
+		}
+
+		zbx_prepare_items(items, errcodes, num, results, MACRO_EXPAND_YES);
+		poller->checks_num += num;
+
+		if (ZBX_POLLER_TYPE_SNMP == poller->poller_type)
+		{
+#ifdef HAVE_NETSNMP
+			zbx_async_check_snmp(items, results, errcodes, num, poller->base, async_poller_batch_done_cb,
+					poller);
+#else
+			zbx_check_items(items, errcodes, num, results, NULL, poller->poller_type);
+			async_poller_batch_done_cb(items, results, errcodes, num, poller);
+#endif
+		}
+		else if (ZBX_POLLER_TYPE_HTTPAGENT == poller->poller_type)
+		{
+#ifdef HAVE_LIBCURL
+			async_poller_start_httpagent_checks(poller, items, results, errcodes, num);
+#else
+			zbx_check_items(items, errcodes, num, results, NULL, poller->poller_type);
+			async_poller_batch_done_cb(items, results, errcodes, num, poller);
+#endif
+		}
+		else
+			async_poller_start_agent_checks(poller, items, results, errcodes, num);
+
+		if (items != &item)
+			zbx_free(items);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: async_poller_process_checks                                      *
+ *                                                                            *
+ * Purpose: processes completed checks and returns their items to the queue   *
+ *                                                                            *
+ * Parameters: poller    - [IN] the asynchronous poller                       *
+ *             nextcheck - [OUT] the next item check time                     *
+ *                                                                            *
+ * Return value: number of processed checks                                   *
+ *                                                                            *
+ ******************************************************************************/
+static int	async_poller_process_checks(zbx_async_poller_t *poller, int *nextcheck)
+{
+	zbx_timespec_t		timespec;
+	zbx_uint64_t		*itemids;
+	int			*errcodes, *lastclocks, i, num;
+	unsigned char		*data = NULL;
+	size_t			data_alloc = 0, data_offset = 0;
+	zbx_async_result_t	*check;
+
+	if (0 == (num = poller->checks_done.values_num))
+		return 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() num:%d", __func__, num);
+
+	itemids = (zbx_uint64_t *)zbx_malloc(NULL, sizeof(zbx_uint64_t) * num);
+	errcodes = (int *)zbx_malloc(NULL, sizeof(int) * num);
+	lastclocks = (int *)zbx_malloc(NULL, sizeof(int) * num);
+
+	zbx_timespec(&timespec);
+
+	for (i = 0; i < num; i++)
+	{
+		check = (zbx_async_result_t *)poller->checks_done.values[i];
+
+		switch (check->errcode)
+		{
+			case SUCCEED:
+			case NOTSUPPORTED:
+			case AGENT_ERROR:
+				zbx_activate_item_interface(&timespec, &check->item, &data, &data_alloc, &data_offset);
+				break;
+			case NETWORK_ERROR:
+			case GATEWAY_ERROR:
+			case TIMEOUT_ERROR:
+				zbx_deactivate_item_interface(&timespec, &check->item, &data, &data_alloc, &data_offset,
+						check->result.msg);
+				break;
+			case CONFIG_ERROR:
+				/* nothing to do */
+				break;
+			default:
+				zbx_error("unknown response code returned: %d", check->errcode);
+				THIS_SHOULD_NEVER_HAPPEN;
+		}
+
+		if (SUCCEED == check->errcode)
+		{
+			check->item.state = ITEM_STATE_NORMAL;
+			zbx_preprocess_item_value(check->item.itemid, check->item.host.hostid, check->item.value_type,
+					check->item.flags, &check->result, &timespec, check->item.state, NULL);
+		}
+		else if (NOTSUPPORTED == check->errcode || AGENT_ERROR == check->errcode ||
+				CONFIG_ERROR == check->errcode)
+		{
+			check->item.state = ITEM_STATE_NOTSUPPORTED;
+			zbx_preprocess_item_value(check->item.itemid, check->item.host.hostid, check->item.value_type,
+					check->item.flags, NULL, &timespec, check->item.state, check->result.msg);
+		}
+
+		itemids[i] = check->item.itemid;
+		errcodes[i] = check->errcode;
+		lastclocks[i] = timespec.sec;
+
+		zbx_clean_items(&check->item, 1, &check->result);
+		DCconfig_clean_items(&check->item, NULL, 1);
+		zbx_free(check);
+	}
+
+	DCpoller_requeue_items(itemids, lastclocks, errcodes, (size_t)num, poller->poller_type, nextcheck);
+	zbx_preprocessor_flush();
+
+	if (NULL != data)
+	{
+		zbx_availability_flush(data, data_offset);
+		zbx_free(data);
+	}
+
+	zbx_vector_ptr_clear(&poller->checks_done);
+	poller->checks_num -= num;
+
+	zbx_free(lastclocks);
+	zbx_free(errcodes);
+	zbx_free(itemids);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+
+	return num;
+}
+
+ZBX_THREAD_ENTRY(async_poller_thread, args)
+{
+	zbx_async_poller_t	poller;
+	int			nextcheck = FAIL, sleeptime = -1, processed = 0, old_processed = 0;
+	double			sec, total_sec = 0.0, old_total_sec = 0.0;
+	time_t			last_stat_time;
+	struct timeval		tv = {1, 0};
+
+#define	STAT_INTERVAL	5	/* if a process is busy and does not sleep then update status not faster than */
+				/* once in STAT_INTERVAL seconds */
+
+	process_type = ((zbx_thread_args_t *)args)->process_type;
+	server_num = ((zbx_thread_args_t *)args)->server_num;
+	process_num = ((zbx_thread_args_t *)args)->process_num;
+
+	zabbix_log(LOG_LEVEL_INFORMATION, "%s #%d started [%s #%d]", get_program_type_string(program_type),
+			server_num, get_process_type_string(process_type), process_num);
+
+	update_selfmon_counter(ZBX_PROCESS_STATE_BUSY);
+
+#if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
+	zbx_tls_init_child();
+#endif
+	zbx_setproctitle("%s #%d started", get_process_type_string(process_type), process_num);
+	last_stat_time = time(NULL);
+
+	switch (process_type)
+	{
+		case ZBX_PROCESS_TYPE_SNMPPOLLER:
+			poller.poller_type = ZBX_POLLER_TYPE_SNMP;
+			break;
+		case ZBX_PROCESS_TYPE_HTTPAGENTPOLLER:
+			poller.poller_type = ZBX_POLLER_TYPE_HTTPAGENT;
+			break;
+		default:
+			poller.poller_type = ZBX_POLLER_TYPE_AGENT;
+	}
+
+	poller.base = event_base_new();
+#ifdef HAVE_LIBCURL
+	poller.httpagent = NULL;
+
+	if (ZBX_POLLER_TYPE_HTTPAGENT == poller.poller_type)
+	{
+		char	*error = NULL;
+
+		if (NULL == (poller.httpagent = zbx_async_httpagent_create(poller.base, async_poller_httpagent_done_cb,
+				&poller, &error)))
+		{
+			zabbix_log(LOG_LEVEL_CRIT, "cannot initialize HTTP agent checks: %s", error);
+			zbx_free(error);
+			exit(EXIT_FAILURE);
+		}
+	}
+#endif
+	poller.ev_timer = event_new(poller.base, -1, 0, async_poller_timer_cb, NULL);
+	poller.checks_num = 0;
+	poller.source_ip = NULL;
+
+	if (ZBX_POLLER_TYPE_AGENT == poller.poller_type)
+	{
+#ifdef ZBX_ASYNC_POLLER_EVDNS
+		if (NULL == (poller.dnsbase = evdns_base_new(poller.base, EVDNS_BASE_INITIALIZE_NAMESERVERS)))
+		{
+			zabbix_log(LOG_LEVEL_CRIT, "cannot initialize asynchronous DNS resolver");
+			exit(EXIT_FAILURE);
+		}
+#endif
+		if (NULL != CONFIG_SOURCE_IP)
+		{
+			struct addrinfo	hints;
+
+			memset(&hints, 0, sizeof(hints));
+			hints.ai_family = PF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_flags = AI_NUMERICHOST;
+
+			if (0 != getaddrinfo(CONFIG_SOURCE_IP, NULL, &hints, &poller.source_ip))
+				poller.source_ip = NULL;
+		}
+	}
+	zbx_vector_ptr_create(&poller.checks_done);
+
+	while (ZBX_IS_RUNNING())
+	{
+		sec = zbx_time();
+		zbx_update_env(sec);
+
+		if (0 != sleeptime)
+		{
+			zbx_setproctitle("%s #%d [got %d values in " ZBX_FS_DBL " sec, getting values]",
+					get_process_type_string(process_type), process_num, old_processed,
+					old_total_sec);
+		}
+
+		async_poller_start_checks(&poller, &nextcheck);
+		processed += async_poller_process_checks(&poller, &nextcheck);
+
+		if (0 != poller.checks_num)
+		{
+			/* wait for socket events, new items are taken from the queue at least once per second */
+			evtimer_add(poller.ev_timer, &tv);
+
+			update_selfmon_counter(ZBX_PROCESS_STATE_IDLE);
+			event_base_loop(poller.base, EVLOOP_ONCE);
+			update_selfmon_counter(ZBX_PROCESS_STATE_BUSY);
+
+			evtimer_del(poller.ev_timer);
+
+			processed += async_poller_process_checks(&poller, &nextcheck);
+			sleeptime = 0;
+		}
+		else
+			sleeptime = calculate_sleeptime(nextcheck, POLLER_DELAY);
+
+		total_sec += zbx_time() - sec;
+
+		if (0 != sleeptime || STAT_INTERVAL <= time(NULL) - last_stat_time)
+		{
+			if (0 == sleeptime)
+			{
+				zbx_setproctitle("%s #%d [got %d values in " ZBX_FS_DBL " sec, %d checks in progress]",
+					get_process_type_string(process_type), process_num, processed, total_sec,
+					poller.checks_num);
+			}
+			else
+			{
+				zbx_setproctitle("%s #%d [got %d values in " ZBX_FS_DBL " sec, idle %d sec]",
+					get_process_type_string(process_type), process_num, processed, total_sec,
+					sleeptime);
+				old_processed = processed;
+				old_total_sec = total_sec;
+			}
+			processed = 0;
+			total_sec = 0.0;
+			last_stat_time = time(NULL);
+		}
+
+		zbx_sleep_loop(sleeptime);
+	}
+
+	zbx_setproctitle("%s #%d [terminated]", get_process_type_string(process_type), process_num);
+
+	while (1)
+		zbx_sleep(SEC_PER_MIN);
+#undef STAT_INTERVAL
+}
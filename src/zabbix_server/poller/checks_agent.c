@@ -20,6 +20,7 @@
 #include "common.h"
 #include "comms.h"
 #include "log.h"
+#include "zbxcompress.h"
 #include "../../libs/zbxcrypto/tls_tcp_active.h"
 
 #include "checks_agent.h"
@@ -28,6 +29,252 @@
 extern unsigned char	program_type;
 #endif
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_agent_handle_response                                        *
+ *                                                                            *
+ * Purpose: parse value received from Zabbix agent                            *
+ *                                                                            *
+ * Parameters: buffer       - [IN] the received data                          *
+ *             read_bytes   - [IN] the received data length                   *
+ *             received_len - [IN] the number of bytes received, including    *
+ *                                 protocol header                            *
+ *             addr         - [IN] the agent address                          *
+ *             result       - [OUT] the item value or error message           *
+ *                                                                            *
+ * Return value: SUCCEED - the value was stored in result                     *
+ *               NETWORK_ERROR - empty response was received                  *
+ *               NOTSUPPORTED - item not supported by the agent               *
+ *               AGENT_ERROR - uncritical error on agent side occurred        *
+ *                                                                            *
+ * Comments: shared by synchronous and asynchronous agent pollers             *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_agent_handle_response(char *buffer, size_t read_bytes, ssize_t received_len, const char *addr,
+		AGENT_RESULT *result)
+{
+	zabbix_log(LOG_LEVEL_DEBUG, "get value from agent result: '%s'", buffer);
+
+	if (0 == strcmp(buffer, ZBX_NOTSUPPORTED))
+	{
+		/* 'ZBX_NOTSUPPORTED\0<error message>' */
+		if (sizeof(ZBX_NOTSUPPORTED) < read_bytes)
+			SET_MSG_RESULT(result, zbx_dsprintf(NULL, "%s", buffer + sizeof(ZBX_NOTSUPPORTED)));
+		else
+			SET_MSG_RESULT(result, zbx_strdup(NULL, "Not supported by Zabbix Agent"));
+
+		return NOTSUPPORTED;
+	}
+
+	if (0 == strcmp(buffer, ZBX_ERROR))
+	{
+		SET_MSG_RESULT(result, zbx_strdup(NULL, "Zabbix Agent non-critical error"));
+		return AGENT_ERROR;
+	}
+
+	if (0 == received_len)
+	{
+		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Received empty response from Zabbix Agent at [%s]."
+				" Assuming that agent dropped connection because of access permissions.", addr));
+		return NETWORK_ERROR;
+	}
+
+	set_result_type(result, ITEM_VALUE_TYPE_TEXT, buffer);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_agent_packet_request                                         *
+ *                                                                            *
+ * Purpose: prepares agent request packet                                     *
+ *                                                                            *
+ * Parameters: packet - [OUT] the request packet                              *
+ *             key    - [IN] the item key                                     *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_agent_packet_request(zbx_agent_packet_t *packet, const char *key)
+{
+	size_t		key_len, offset;
+	zbx_uint32_t	len32_le;
+
+	/* request is the item key in Zabbix protocol packet */
+	key_len = strlen(key);
+	packet->buffer_size = ZBX_AGENT_HEADER_SIZE + key_len;
+	packet->buffer_alloc = packet->buffer_size;
+	packet->buffer = (char *)zbx_realloc(packet->buffer, packet->buffer_alloc);
+
+	memcpy(packet->buffer, ZBX_AGENT_HEADER_DATA, ZBX_AGENT_HEADER_LEN);
+	offset = ZBX_AGENT_HEADER_LEN;
+	packet->buffer[offset++] = ZBX_TCP_PROTOCOL;
+
+	len32_le = zbx_htole_uint32((zbx_uint32_t)key_len);
+	memcpy(packet->buffer + offset, &len32_le, sizeof(len32_le));
+	offset += sizeof(len32_le);
+
+	len32_le = 0;
+	memcpy(packet->buffer + offset, &len32_le, sizeof(len32_le));
+	offset += sizeof(len32_le);
+
+	memcpy(packet->buffer + offset, key, key_len);
+	packet->buffer_offset = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_agent_packet_parse_header                                    *
+ *                                                                            *
+ * Purpose: validates response header, gets expected response size            *
+ *                                                                            *
+ * Parameters: packet - [IN/OUT] the response packet being received           *
+ *             addr   - [IN] the agent address                                *
+ *             port   - [IN] the agent port                                   *
+ *             error  - [OUT] the error message                               *
+ *                                                                            *
+ * Return value: SUCCEED - the header is valid or not yet fully received      *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ * Comments: The buffer is extended to fit the whole response and             *
+ *           terminating zero once the header is received.                    *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_agent_packet_parse_header(zbx_agent_packet_t *packet, const char *addr, unsigned short port,
+		char **error)
+{
+	zbx_uint32_t	len32_le, expected_len;
+	size_t		offset;
+
+	if (0 != packet->buffer_size)
+		return SUCCEED;
+
+	if (0 != memcmp(packet->buffer, ZBX_AGENT_HEADER_DATA, MIN(packet->buffer_offset, ZBX_AGENT_HEADER_LEN)))
+	{
+		*error = zbx_dsprintf(NULL, "message from [[%s]:%hu] is missing header", addr, port);
+		return FAIL;
+	}
+
+	if (ZBX_AGENT_HEADER_SIZE > packet->buffer_offset)
+		return SUCCEED;
+
+	offset = ZBX_AGENT_HEADER_LEN;
+	packet->protocol = (unsigned char)packet->buffer[offset++];
+
+	if (0 == (packet->protocol & ZBX_TCP_PROTOCOL) || packet->protocol > (ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS))
+	{
+		*error = zbx_dsprintf(NULL, "message from [[%s]:%hu] is using unsupported protocol version \"%d\"",
+				addr, port, (int)packet->protocol);
+		return FAIL;
+	}
+
+	memcpy(&len32_le, packet->buffer + offset, sizeof(len32_le));
+	expected_len = zbx_letoh_uint32(len32_le);
+	offset += sizeof(len32_le);
+
+	memcpy(&len32_le, packet->buffer + offset, sizeof(len32_le));
+	packet->reserved = zbx_letoh_uint32(len32_le);
+
+	if (ZBX_MAX_RECV_DATA_SIZE < expected_len ||
+			(0 != (packet->protocol & ZBX_TCP_COMPRESS) && ZBX_MAX_RECV_DATA_SIZE < packet->reserved))
+	{
+		*error = zbx_dsprintf(NULL, "message size from [[%s]:%hu] exceeds the maximum size " ZBX_FS_UI64
+				" bytes", addr, port, (zbx_uint64_t)ZBX_MAX_RECV_DATA_SIZE);
+		return FAIL;
+	}
+
+	packet->buffer_size = ZBX_AGENT_HEADER_SIZE + expected_len;
+
+	/* reserve space for terminating zero */
+	if (packet->buffer_alloc < packet->buffer_size + 1)
+	{
+		packet->buffer_alloc = packet->buffer_size + 1;
+		packet->buffer = (char *)zbx_realloc(packet->buffer, packet->buffer_alloc);
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_agent_packet_parse_response                                  *
+ *                                                                            *
+ * Purpose: parses value from received response packet                        *
+ *                                                                            *
+ * Parameters: packet - [IN/OUT] the received response packet, the buffer     *
+ *                               must have space for terminating zero         *
+ *             addr   - [IN] the agent address                                *
+ *             port   - [IN] the agent port                                   *
+ *             result - [OUT] the item value or error message                 *
+ *                                                                            *
+ * Return value: SUCCEED - the value was stored in result                     *
+ *               NETWORK_ERROR - the response was not complete or invalid,    *
+ *                               or empty response was received               *
+ *               NOTSUPPORTED - item not supported by the agent               *
+ *               AGENT_ERROR - uncritical error on agent side occurred        *
+ *                                                                            *
+ * Comments: The response is complete when the whole packet is received       *
+ *           or agent closed connection without sending anything.             *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_agent_packet_parse_response(zbx_agent_packet_t *packet, const char *addr, unsigned short port,
+		AGENT_RESULT *result)
+{
+	char	*data, *out = NULL;
+	size_t	data_len;
+	int	ret;
+
+	if (0 == packet->buffer_offset)
+	{
+		packet->buffer[0] = '\0';
+		return zbx_agent_handle_response(packet->buffer, 0, 0, addr, result);
+	}
+
+	if (0 == packet->buffer_size || packet->buffer_offset != packet->buffer_size)
+	{
+		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Get value from agent failed: message from [[%s]:%hu] is"
+				" %s than expected", addr, port, 0 == packet->buffer_size ||
+				packet->buffer_offset < packet->buffer_size ? "shorter" : "longer"));
+		return NETWORK_ERROR;
+	}
+
+	data = packet->buffer + ZBX_AGENT_HEADER_SIZE;
+	data_len = packet->buffer_size - ZBX_AGENT_HEADER_SIZE;
+
+	if (0 != (packet->protocol & ZBX_TCP_COMPRESS))
+	{
+		size_t	out_size = packet->reserved;
+
+		out = (char *)zbx_malloc(NULL, packet->reserved + 1);
+
+		if (FAIL == zbx_uncompress(data, data_len, out, &out_size))
+		{
+			zbx_free(out);
+			SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Get value from agent failed: cannot uncompress data"
+					" from [[%s]:%hu]: %s", addr, port, zbx_compress_strerror()));
+			return NETWORK_ERROR;
+		}
+
+		if (out_size != packet->reserved)
+		{
+			zbx_free(out);
+			SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Get value from agent failed: uncompressed message size"
+					" from [[%s]:%hu] is %s than expected", addr, port,
+					out_size < packet->reserved ? "shorter" : "longer"));
+			return NETWORK_ERROR;
+		}
+
+		data = out;
+		data_len = out_size;
+	}
+
+	data[data_len] = '\0';
+
+	ret = zbx_agent_handle_response(data, data_len, (ssize_t)packet->buffer_offset, addr, result);
+	zbx_free(out);
+
+	return ret;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: get_value_agent                                                  *
@@ -107,34 +354,7 @@ int	get_value_agent(const DC_ITEM *item, AGENT_RESULT *result)
 		ret = NETWORK_ERROR;
 
 	if (SUCCEED == ret)
-	{
-		zabbix_log(LOG_LEVEL_DEBUG, "get value from agent result: '%s'", s.buffer);
-
-		if (0 == strcmp(s.buffer, ZBX_NOTSUPPORTED))
-		{
-			/* 'ZBX_NOTSUPPORTED\0<error message>' */
-			if (sizeof(ZBX_NOTSUPPORTED) < s.read_bytes)
-				SET_MSG_RESULT(result, zbx_dsprintf(NULL, "%s", s.buffer + sizeof(ZBX_NOTSUPPORTED)));
-			else
-				SET_MSG_RESULT(result, zbx_strdup(NULL, "Not supported by Zabbix Agent"));
-
-			ret = NOTSUPPORTED;
-		}
-		else if (0 == strcmp(s.buffer, ZBX_ERROR))
-		{
-			SET_MSG_RESULT(result, zbx_strdup(NULL, "Zabbix Agent non-critical error"));
-			ret = AGENT_ERROR;
-		}
-		else if (0 == received_len)
-		{
-			SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Received empty response from Zabbix Agent at [%s]."
-					" Assuming that agent dropped connection because of access permissions.",
-					item->interface.addr));
-			ret = NETWORK_ERROR;
-		}
-		else
-			set_result_type(result, ITEM_VALUE_TYPE_TEXT, s.buffer);
-	}
+		ret = zbx_agent_handle_response(s.buffer, s.read_bytes, received_len, item->interface.addr, result);
 	else
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Get value from agent failed: %s", zbx_socket_strerror()));
 
@@ -25,6 +25,33 @@
 
 extern char	*CONFIG_SOURCE_IP;
 
+#define ZBX_AGENT_HEADER_DATA		"ZBXD"
+#define ZBX_AGENT_HEADER_LEN		ZBX_CONST_STRLEN(ZBX_AGENT_HEADER_DATA)
+#define ZBX_AGENT_HEADER_SIZE		(ZBX_AGENT_HEADER_LEN + 1 + 2 * sizeof(zbx_uint32_t))
+
+/* agent request or response packet of asynchronous agent check */
+typedef struct
+{
+	char		*buffer;
+	size_t		buffer_alloc;
+	size_t		buffer_offset;
+
+	/* the request size or the expected response size including header, 0 if not yet known */
+	size_t		buffer_size;
+
+	unsigned char	protocol;
+	zbx_uint32_t	reserved;
+}
+zbx_agent_packet_t;
+
 int	get_value_agent(const DC_ITEM *item, AGENT_RESULT *result);
+int	zbx_agent_handle_response(char *buffer, size_t read_bytes, ssize_t received_len, const char *addr,
+		AGENT_RESULT *result);
+
+void	zbx_agent_packet_request(zbx_agent_packet_t *packet, const char *key);
+int	zbx_agent_packet_parse_header(zbx_agent_packet_t *packet, const char *addr, unsigned short port,
+		char **error);
+int	zbx_agent_packet_parse_response(zbx_agent_packet_t *packet, const char *addr, unsigned short port,
+		AGENT_RESULT *result);
 
 #endif
@@ -23,6 +23,8 @@
 #include "log.h"
 #ifdef HAVE_LIBCURL
 
+#include "async_event.h"
+
 #define HTTP_REQUEST_GET	0
 #define HTTP_REQUEST_POST	1
 #define HTTP_REQUEST_PUT	2
@@ -179,28 +181,59 @@ static void	http_output_json(unsigned char retrieve_mode, char **buffer, zbx_htt
 	zbx_json_free(&json);
 }
 
-int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
+typedef struct
 {
 	CURL			*easyhandle;
-	CURLcode		err;
-	char			url[ITEM_URL_LEN_MAX], errbuf[CURL_ERROR_SIZE], *error = NULL, *headers, *line, *buffer;
-	int			ret = NOTSUPPORTED, timeout_seconds, found = FAIL;
-	long			response_code;
-	struct curl_slist	*headers_slist = NULL;
-	struct zbx_json		json;
-	zbx_http_response_t	body = {0}, header = {0};
-	size_t			(*curl_body_cb)(void *ptr, size_t size, size_t nmemb, void *userdata);
-	char			application_json[] = {"Content-Type: application/json"};
-	char			application_xml[] = {"Content-Type: application/xml"};
+	struct curl_slist	*headers_slist;
+	zbx_http_response_t	header;
+	zbx_http_response_t	body;
+	char			errbuf[CURL_ERROR_SIZE];
+}
+zbx_http_context_t;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s() request method '%s' URL '%s%s' headers '%s' message body '%s'",
-			__func__, zbx_request_string(item->request_method), item->url, item->query_fields,
-			item->headers, item->posts);
+static void	http_context_init(zbx_http_context_t *context)
+{
+	memset(context, 0, sizeof(zbx_http_context_t));
+}
 
-	if (NULL == (easyhandle = curl_easy_init()))
+static void	http_context_clean(zbx_http_context_t *context)
+{
+	curl_slist_free_all(context->headers_slist);	/* must be called after curl_easy_perform() */
+	curl_easy_cleanup(context->easyhandle);
+	zbx_free(context->body.data);
+	zbx_free(context->header.data);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_prepare_context                                             *
+ *                                                                            *
+ * Purpose: creates cURL easy handle and sets it up to perform HTTP agent     *
+ *          item request                                                      *
+ *                                                                            *
+ * Parameters: context - [IN/OUT] the request context, must not be moved      *
+ *                                until the request is completed              *
+ *             item    - [IN] the HTTP agent item                             *
+ *             result  - [OUT] the error message on failure                   *
+ *                                                                            *
+ * Return value: SUCCEED      - the request is ready to be performed          *
+ *               NOTSUPPORTED - otherwise                                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	http_prepare_context(zbx_http_context_t *context, const DC_ITEM *item, AGENT_RESULT *result)
+{
+	CURL		*easyhandle;
+	CURLcode	err;
+	char		url[ITEM_URL_LEN_MAX], *error = NULL, *headers, *line;
+	int		timeout_seconds, found = FAIL;
+	size_t		(*curl_body_cb)(void *ptr, size_t size, size_t nmemb, void *userdata);
+	char		application_json[] = {"Content-Type: application/json"};
+	char		application_xml[] = {"Content-Type: application/xml"};
+
+	if (NULL == (easyhandle = context->easyhandle = curl_easy_init()))
 	{
 		SET_MSG_RESULT(result, zbx_strdup(NULL, "Cannot initialize cURL library"));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	switch (item->retrieve_mode)
@@ -215,27 +248,27 @@ int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
 		default:
 			THIS_SHOULD_NEVER_HAPPEN;
 			SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Invalid retrieve mode"));
-			goto clean;
+			return NOTSUPPORTED;
 	}
 
-	if (SUCCEED != zbx_http_prepare_callbacks(easyhandle, &header, &body, zbx_curl_write_cb, curl_body_cb, errbuf,
-			&error))
+	if (SUCCEED != zbx_http_prepare_callbacks(easyhandle, &context->header, &context->body, zbx_curl_write_cb,
+			curl_body_cb, context->errbuf, &error))
 	{
 		SET_MSG_RESULT(result, error);
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_PROXY, item->http_proxy)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot set proxy: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_FOLLOWLOCATION,
 			0 == item->follow_redirects ? 0L : 1L)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot set follow redirects: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (0 != item->follow_redirects &&
@@ -243,44 +276,44 @@ int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot set number of redirects allowed: %s",
 				curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (FAIL == is_time_suffix(item->timeout, &timeout_seconds, strlen(item->timeout)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Invalid timeout: %s", item->timeout));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_TIMEOUT, (long)timeout_seconds)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot specify timeout: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (SUCCEED != zbx_http_prepare_ssl(easyhandle, item->ssl_cert_file, item->ssl_key_file, item->ssl_key_password,
 			item->verify_peer, item->verify_host, &error))
 	{
 		SET_MSG_RESULT(result, error);
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (SUCCEED != zbx_http_prepare_auth(easyhandle, item->authtype, item->username, item->password, &error))
 	{
 		SET_MSG_RESULT(result, error);
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if (SUCCEED != http_prepare_request(easyhandle, item->posts, item->request_method, &error))
 	{
 		SET_MSG_RESULT(result, error);
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	headers = item->headers;
 	while (NULL != (line = zbx_http_parse_header(&headers)))
 	{
-		headers_slist = curl_slist_append(headers_slist, line);
+		context->headers_slist = curl_slist_append(context->headers_slist, line);
 
 		if (FAIL == found && 0 == strncmp(line, "Content-Type:", ZBX_CONST_STRLEN("Content-Type:")))
 			found = SUCCEED;
@@ -291,15 +324,15 @@ int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
 	if (FAIL == found)
 	{
 		if (ZBX_POSTTYPE_JSON == item->post_type)
-			headers_slist = curl_slist_append(headers_slist, application_json);
+			context->headers_slist = curl_slist_append(context->headers_slist, application_json);
 		else if (ZBX_POSTTYPE_XML == item->post_type)
-			headers_slist = curl_slist_append(headers_slist, application_xml);
+			context->headers_slist = curl_slist_append(context->headers_slist, application_xml);
 	}
 
-	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_HTTPHEADER, headers_slist)))
+	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_HTTPHEADER, context->headers_slist)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot specify headers: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 #if LIBCURL_VERSION_NUM >= 0x071304
@@ -307,7 +340,7 @@ int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
 	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot set allowed protocols: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 #endif
 
@@ -315,82 +348,107 @@ int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
 	if (CURLE_OK != (err = curl_easy_setopt(easyhandle, CURLOPT_URL, url)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot specify URL: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
-	*errbuf = '\0';
+	*context->errbuf = '\0';
+
+	return SUCCEED;
+}
 
-	if (CURLE_OK != (err = curl_easy_perform(easyhandle)))
+static void	http_set_perform_error(CURLcode err, const char *errbuf, AGENT_RESULT *result)
+{
+	if (CURLE_WRITE_ERROR == err)
 	{
-		if (CURLE_WRITE_ERROR == err)
-		{
-			SET_MSG_RESULT(result, zbx_strdup(NULL, "The requested value is too large"));
-		}
-		else
-		{
-			SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot perform request: %s",
-					'\0' == *errbuf ? curl_easy_strerror(err) : errbuf));
-		}
-		goto clean;
+		SET_MSG_RESULT(result, zbx_strdup(NULL, "The requested value is too large"));
+	}
+	else
+	{
+		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot perform request: %s",
+				'\0' == *errbuf ? curl_easy_strerror(err) : errbuf));
 	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_process_response                                            *
+ *                                                                            *
+ * Purpose: checks response of performed HTTP agent item request and sets     *
+ *          item value                                                        *
+ *                                                                            *
+ * Parameters: context - [IN/OUT] the request context                         *
+ *             item    - [IN] the HTTP agent item                             *
+ *             result  - [OUT] the item value or error message                *
+ *                                                                            *
+ * Return value: SUCCEED      - the item value was set                        *
+ *               NOTSUPPORTED - otherwise                                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	http_process_response(zbx_http_context_t *context, const DC_ITEM *item, AGENT_RESULT *result)
+{
+	CURLcode		err;
+	char			*headers, *line, *buffer;
+	long			response_code;
+	struct zbx_json		json;
+	zbx_http_response_t	*header = &context->header, *body = &context->body;
 
-	if (CURLE_OK != (err = curl_easy_getinfo(easyhandle, CURLINFO_RESPONSE_CODE, &response_code)))
+	if (CURLE_OK != (err = curl_easy_getinfo(context->easyhandle, CURLINFO_RESPONSE_CODE, &response_code)))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Cannot get the response code: %s", curl_easy_strerror(err)));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	if ('\0' != *item->status_codes && FAIL == int_in_list(item->status_codes, response_code))
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Response code \"%ld\" did not match any of the"
 				" required status codes \"%s\"", response_code, item->status_codes));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
-	if (NULL == header.data)
+	if (NULL == header->data)
 	{
 		SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Server returned empty header"));
-		goto clean;
+		return NOTSUPPORTED;
 	}
 
 	switch (item->retrieve_mode)
 	{
 		case ZBX_RETRIEVE_MODE_CONTENT:
-			if (NULL == body.data)
+			if (NULL == body->data)
 			{
 				SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Server returned empty content"));
-				goto clean;
+				return NOTSUPPORTED;
 			}
 
-			if (FAIL == zbx_is_utf8(body.data))
+			if (FAIL == zbx_is_utf8(body->data))
 			{
 				SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Server returned invalid UTF-8 sequence"));
-				goto clean;
+				return NOTSUPPORTED;
 			}
 
 			if (HTTP_STORE_JSON == item->output_format)
 			{
-				http_output_json(item->retrieve_mode, &buffer, &header, &body);
+				http_output_json(item->retrieve_mode, &buffer, header, body);
 				SET_TEXT_RESULT(result, buffer);
 			}
 			else
 			{
-				SET_TEXT_RESULT(result, body.data);
-				body.data = NULL;
+				SET_TEXT_RESULT(result, body->data);
+				body->data = NULL;
 			}
 			break;
 		case ZBX_RETRIEVE_MODE_HEADERS:
-			if (FAIL == zbx_is_utf8(header.data))
+			if (FAIL == zbx_is_utf8(header->data))
 			{
 				SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Server returned invalid UTF-8 sequence"));
-				goto clean;
+				return NOTSUPPORTED;
 			}
 
 			if (HTTP_STORE_JSON == item->output_format)
 			{
 				zbx_json_init(&json, ZBX_JSON_STAT_BUF_LEN);
 				zbx_json_addobject(&json, "header");
-				headers = header.data;
+				headers = header->data;
 				while (NULL != (line = zbx_http_parse_header(&headers)))
 				{
 					http_add_json_header(&json, line);
@@ -401,40 +459,399 @@ int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
 			}
 			else
 			{
-				SET_TEXT_RESULT(result, header.data);
-				header.data = NULL;
+				SET_TEXT_RESULT(result, header->data);
+				header->data = NULL;
 			}
 			break;
 		case ZBX_RETRIEVE_MODE_BOTH:
-			if (FAIL == zbx_is_utf8(header.data) || (NULL != body.data && FAIL == zbx_is_utf8(body.data)))
+			if (FAIL == zbx_is_utf8(header->data) || (NULL != body->data && FAIL == zbx_is_utf8(body->data)))
 			{
 				SET_MSG_RESULT(result, zbx_dsprintf(NULL, "Server returned invalid UTF-8 sequence"));
-				goto clean;
+				return NOTSUPPORTED;
 			}
 
 			if (HTTP_STORE_JSON == item->output_format)
 			{
-				http_output_json(item->retrieve_mode, &buffer, &header, &body);
+				http_output_json(item->retrieve_mode, &buffer, header, body);
 				SET_TEXT_RESULT(result, buffer);
 			}
 			else
 			{
-				zbx_strncpy_alloc(&header.data, &header.allocated, &header.offset,
-						body.data, body.offset);
-				SET_TEXT_RESULT(result, header.data);
-				header.data = NULL;
+				zbx_strncpy_alloc(&header->data, &header->allocated, &header->offset,
+						body->data, body->offset);
+				SET_TEXT_RESULT(result, header->data);
+				header->data = NULL;
 			}
 			break;
 	}
 
-	ret = SUCCEED;
+	return SUCCEED;
+}
+
+int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result)
+{
+	zbx_http_context_t	context;
+	CURLcode		err;
+	int			ret;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() request method '%s' URL '%s%s' headers '%s' message body '%s'",
+			__func__, zbx_request_string(item->request_method), item->url, item->query_fields,
+			item->headers, item->posts);
+
+	http_context_init(&context);
+
+	if (SUCCEED != (ret = http_prepare_context(&context, item, result)))
+		goto clean;
+
+	if (CURLE_OK != (err = curl_easy_perform(context.easyhandle)))
+	{
+		http_set_perform_error(err, context.errbuf, result);
+		ret = NOTSUPPORTED;
+		goto clean;
+	}
+
+	ret = http_process_response(&context, item, result);
 clean:
-	curl_slist_free_all(headers_slist);	/* must be called after curl_easy_perform() */
-	curl_easy_cleanup(easyhandle);
-	zbx_free(body.data);
-	zbx_free(header.data);
+	http_context_clean(&context);
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
 
 	return ret;
 }
+
+/* curl_multi_socket_action() with CURL_CSELECT_* flags is supported starting with version 7.16.3 (0x071003) */
+#if LIBCURL_VERSION_NUM >= 0x071003
+#	define ZBX_HTTP_ASYNC
+#endif
+
+struct zbx_async_httpagent
+{
+#ifdef ZBX_HTTP_ASYNC
+	CURLM				*multihandle;
+	CURLSH				*sharehandle;
+	struct event_base		*base;
+	struct event			*ev_timer;
+#endif
+	zbx_async_httpagent_cb_t	done_cb;
+	void				*done_arg;
+};
+
+#ifdef ZBX_HTTP_ASYNC
+typedef struct
+{
+	DC_ITEM			item;
+	AGENT_RESULT		result;
+	zbx_http_context_t	context;
+	zbx_async_httpagent_t	*agent;
+}
+zbx_http_check_t;
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_check_finish                                                *
+ *                                                                            *
+ * Purpose: releases check resources and passes its result to the caller      *
+ *                                                                            *
+ * Parameters: check   - [IN] the HTTP agent check, freed by this function    *
+ *             errcode - [IN] the check result code                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	http_check_finish(zbx_http_check_t *check, int errcode)
+{
+	zbx_async_httpagent_t	*agent = check->agent;
+
+	http_context_clean(&check->context);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() itemid:" ZBX_FS_UI64 " %s", __func__, check->item.itemid,
+			zbx_result_string(errcode));
+
+	agent->done_cb(&check->item, &check->result, errcode, agent->done_arg);
+	zbx_free(check);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_multi_read_info                                             *
+ *                                                                            *
+ * Purpose: finishes checks with completed transfers                          *
+ *                                                                            *
+ ******************************************************************************/
+static void	http_multi_read_info(zbx_async_httpagent_t *agent)
+{
+	CURLMsg			*msg;
+	int			msgs_left, ret;
+	char			*data;
+	zbx_http_check_t	*check;
+
+	while (NULL != (msg = curl_multi_info_read(agent->multihandle, &msgs_left)))
+	{
+		if (CURLMSG_DONE != msg->msg)
+			continue;
+
+		if (CURLE_OK != curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &data) || NULL == data)
+		{
+			THIS_SHOULD_NEVER_HAPPEN;
+			continue;
+		}
+
+		check = (zbx_http_check_t *)data;
+		curl_multi_remove_handle(agent->multihandle, msg->easy_handle);
+
+		if (CURLE_OK != msg->data.result)
+		{
+			http_set_perform_error(msg->data.result, check->context.errbuf, &check->result);
+			ret = NOTSUPPORTED;
+		}
+		else
+			ret = http_process_response(&check->context, &check->item, &check->result);
+
+		http_check_finish(check, ret);
+	}
+}
+
+static void	http_socket_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_async_httpagent_t	*agent = (zbx_async_httpagent_t *)arg;
+	int			action = 0, running;
+
+	if (0 != (what & EV_READ))
+		action |= CURL_CSELECT_IN;
+
+	if (0 != (what & EV_WRITE))
+		action |= CURL_CSELECT_OUT;
+
+	curl_multi_socket_action(agent->multihandle, fd, action, &running);
+	http_multi_read_info(agent);
+}
+
+static void	http_timer_event_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_async_httpagent_t	*agent = (zbx_async_httpagent_t *)arg;
+	int			running;
+
+	ZBX_UNUSED(fd);
+	ZBX_UNUSED(what);
+
+	curl_multi_socket_action(agent->multihandle, CURL_SOCKET_TIMEOUT, 0, &running);
+	http_multi_read_info(agent);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_multi_socket_cb                                             *
+ *                                                                            *
+ * Purpose: registers in libevent the socket events cURL is waiting for       *
+ *                                                                            *
+ * Comments: The socket event is stored in cURL multi handle as socket        *
+ *           pointer and is recreated every time the waited events change.    *
+ *                                                                            *
+ ******************************************************************************/
+static int	http_multi_socket_cb(CURL *easyhandle, curl_socket_t s, int what, void *userp, void *socketp)
+{
+	zbx_async_httpagent_t	*agent = (zbx_async_httpagent_t *)userp;
+	struct event		*ev = (struct event *)socketp;
+	short			events = EV_PERSIST;
+
+	ZBX_UNUSED(easyhandle);
+
+	if (NULL != ev)
+		event_free(ev);
+
+	if (CURL_POLL_REMOVE == what)
+		return 0;
+
+	if (0 != (what & CURL_POLL_IN))
+		events |= EV_READ;
+
+	if (0 != (what & CURL_POLL_OUT))
+		events |= EV_WRITE;
+
+	ev = event_new(agent->base, s, events, http_socket_event_cb, agent);
+	event_add(ev, NULL);
+	curl_multi_assign(agent->multihandle, s, ev);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: http_multi_timer_cb                                              *
+ *                                                                            *
+ * Purpose: schedules the cURL timeout processing                             *
+ *                                                                            *
+ * Parameters: multihandle - [IN] the cURL multi handle                       *
+ *             timeout_ms  - [IN] the timeout in milliseconds, -1 to cancel   *
+ *             userp       - [IN] the asynchronous HTTP agent                 *
+ *                                                                            *
+ ******************************************************************************/
+static int	http_multi_timer_cb(CURLM *multihandle, long timeout_ms, void *userp)
+{
+	zbx_async_httpagent_t	*agent = (zbx_async_httpagent_t *)userp;
+	struct timeval		tv;
+
+	ZBX_UNUSED(multihandle);
+
+	if (-1 == timeout_ms)
+	{
+		evtimer_del(agent->ev_timer);
+		return 0;
+	}
+
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	evtimer_add(agent->ev_timer, &tv);
+
+	return 0;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_httpagent_create                                       *
+ *                                                                            *
+ * Purpose: creates asynchronous HTTP agent performing requests in the        *
+ *          specified event loop                                              *
+ *                                                                            *
+ * Parameters: base    - [IN] the event base                                  *
+ *             done_cb - [IN] the callback called for every completed check   *
+ *             arg     - [IN] the callback argument                           *
+ *             error   - [OUT] the error message                              *
+ *                                                                            *
+ * Return value: the asynchronous HTTP agent or NULL on failure               *
+ *                                                                            *
+ * Comments: All requests share one cURL multi handle and a share handle with *
+ *           DNS cache, TLS sessions and connection cache, so connections and *
+ *           TLS sessions to the same host are reused between checks.         *
+ *           With libcurl older than 7.16.3 checks are performed              *
+ *           synchronously.                                                   *
+ *                                                                            *
+ ******************************************************************************/
+zbx_async_httpagent_t	*zbx_async_httpagent_create(struct event_base *base, zbx_async_httpagent_cb_t done_cb,
+		void *arg, char **error)
+{
+	zbx_async_httpagent_t	*agent;
+
+	if (0 != curl_global_init(CURL_GLOBAL_ALL))
+	{
+		*error = zbx_strdup(*error, "Cannot initialize cURL library");
+		return NULL;
+	}
+
+	agent = (zbx_async_httpagent_t *)zbx_malloc(NULL, sizeof(zbx_async_httpagent_t));
+	memset(agent, 0, sizeof(zbx_async_httpagent_t));
+	agent->done_cb = done_cb;
+	agent->done_arg = arg;
+#ifdef ZBX_HTTP_ASYNC
+	agent->base = base;
+
+	if (NULL == (agent->multihandle = curl_multi_init()))
+	{
+		*error = zbx_strdup(*error, "Cannot initialize cURL multi session");
+		goto fail;
+	}
+
+	if (NULL == (agent->sharehandle = curl_share_init()))
+	{
+		*error = zbx_strdup(*error, "Cannot initialize cURL share handle");
+		goto fail;
+	}
+
+	curl_share_setopt(agent->sharehandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x071700
+	/* sharing of TLS session IDs is supported starting with version 7.23.0 (0x071700) */
+	curl_share_setopt(agent->sharehandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x073900
+	/* sharing of connection cache is supported starting with version 7.57.0 (0x073900) */
+	curl_share_setopt(agent->sharehandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+	curl_multi_setopt(agent->multihandle, CURLMOPT_SOCKETFUNCTION, http_multi_socket_cb);
+	curl_multi_setopt(agent->multihandle, CURLMOPT_SOCKETDATA, agent);
+	curl_multi_setopt(agent->multihandle, CURLMOPT_TIMERFUNCTION, http_multi_timer_cb);
+	curl_multi_setopt(agent->multihandle, CURLMOPT_TIMERDATA, agent);
+
+	agent->ev_timer = event_new(base, -1, 0, http_timer_event_cb, agent);
+
+	return agent;
+fail:
+	if (NULL != agent->sharehandle)
+		curl_share_cleanup(agent->sharehandle);
+
+	if (NULL != agent->multihandle)
+		curl_multi_cleanup(agent->multihandle);
+
+	zbx_free(agent);
+
+	return NULL;
+#else
+	ZBX_UNUSED(base);
+
+	return agent;
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_check_httpagent                                        *
+ *                                                                            *
+ * Purpose: starts HTTP agent item check                                      *
+ *                                                                            *
+ * Parameters: agent  - [IN] the asynchronous HTTP agent                      *
+ *             item   - [IN] the item to check, ownership of item data is     *
+ *                           passed to the check                              *
+ *             result - [IN] the prepared item result, ownership is passed to *
+ *                           the check                                        *
+ *                                                                            *
+ * Comments: The done callback receives the item and its result when the      *
+ *           check is completed, it can be called before this function        *
+ *           returns if the request cannot be started.                        *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_check_httpagent(zbx_async_httpagent_t *agent, const DC_ITEM *item, AGENT_RESULT *result)
+{
+#ifdef ZBX_HTTP_ASYNC
+	zbx_http_check_t	*check;
+	CURLMcode		merr;
+	int			ret;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() request method '%s' URL '%s%s' headers '%s' message body '%s'",
+			__func__, zbx_request_string(item->request_method), item->url, item->query_fields,
+			item->headers, item->posts);
+
+	check = (zbx_http_check_t *)zbx_malloc(NULL, sizeof(zbx_http_check_t));
+	check->item = *item;
+	check->result = *result;
+	check->agent = agent;
+	http_context_init(&check->context);
+
+	/* request options may reference item data, so the check copy of item is used */
+	if (SUCCEED != (ret = http_prepare_context(&check->context, &check->item, &check->result)))
+		goto fail;
+
+	curl_easy_setopt(check->context.easyhandle, CURLOPT_PRIVATE, (char *)check);
+	curl_easy_setopt(check->context.easyhandle, CURLOPT_SHARE, agent->sharehandle);
+
+	if (CURLM_OK != (merr = curl_multi_add_handle(agent->multihandle, check->context.easyhandle)))
+	{
+		SET_MSG_RESULT(&check->result, zbx_dsprintf(NULL, "Cannot start request: %s",
+				curl_multi_strerror(merr)));
+		ret = NOTSUPPORTED;
+		goto fail;
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+
+	return;
+fail:
+	http_check_finish(check, ret);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+#else
+	DC_ITEM		item_local = *item;
+	AGENT_RESULT	result_local = *result;
+	int		errcode;
+
+	errcode = get_value_http(&item_local, &result_local);
+	agent->done_cb(&item_local, &result_local, errcode, agent->done_arg);
+#endif
+}
 #endif
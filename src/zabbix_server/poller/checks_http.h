@@ -25,7 +25,17 @@
 #ifdef HAVE_LIBCURL
 #include "dbcache.h"
 
+struct event_base;
+
+typedef struct zbx_async_httpagent zbx_async_httpagent_t;
+
+typedef void (*zbx_async_httpagent_cb_t)(DC_ITEM *item, AGENT_RESULT *result, int errcode, void *arg);
+
 int	get_value_http(const DC_ITEM *item, AGENT_RESULT *result);
+
+zbx_async_httpagent_t	*zbx_async_httpagent_create(struct event_base *base, zbx_async_httpagent_cb_t done_cb,
+		void *arg, char **error);
+void	zbx_async_check_httpagent(zbx_async_httpagent_t *agent, const DC_ITEM *item, AGENT_RESULT *result);
 #endif
 
 #endif
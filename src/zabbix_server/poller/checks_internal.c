@@ -188,7 +188,7 @@ int	get_value_internal(const DC_ITEM *item, AGENT_RESULT *result)
 {
 	AGENT_REQUEST	request;
 	int		ret = NOTSUPPORTED, nparams;
-	const char	*tmp, *tmp1;
+	const char	*tmp, *tmp1, *tmp2;
 
 	init_request(&request);
 
@@ -536,9 +536,11 @@ int	get_value_internal(const DC_ITEM *item, AGENT_RESULT *result)
 			SET_DBL_RESULT(result, value);
 		}
 	}
-	else if (0 == strcmp(tmp, "wcache"))			/* zabbix[wcache,<cache>,<mode>] */
+	else if (0 == strcmp(tmp, "wcache"))			/* zabbix[wcache,<cache>,<mode>,<shard>] */
 	{
-		if (2 > nparams || nparams > 3)
+		int	shard = ZBX_HC_SHARD_ALL, stats_request;
+
+		if (2 > nparams || nparams > 4)
 		{
 			SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid number of parameters."));
 			goto out;
@@ -547,45 +549,67 @@ int	get_value_internal(const DC_ITEM *item, AGENT_RESULT *result)
 		tmp = get_rparam(&request, 1);
 		tmp1 = get_rparam(&request, 2);
 
+		if (4 == nparams && NULL != (tmp2 = get_rparam(&request, 3)) && '\0' != *tmp2)
+		{
+			if (0 == strcmp(tmp, "trend"))
+			{
+				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid fourth parameter."));
+				goto out;
+			}
+
+			if (FAIL == is_uint31(tmp2, &shard) || CONFIG_HISTORY_CACHE_SHARDS <= shard)
+			{
+				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid fourth parameter."));
+				goto out;
+			}
+		}
+
 		if (0 == strcmp(tmp, "values"))
 		{
 			if (NULL == tmp1 || '\0' == *tmp1 || 0 == strcmp(tmp1, "all"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_COUNTER));
+				stats_request = ZBX_STATS_HISTORY_COUNTER;
 			else if (0 == strcmp(tmp1, "float"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_FLOAT_COUNTER));
+				stats_request = ZBX_STATS_HISTORY_FLOAT_COUNTER;
 			else if (0 == strcmp(tmp1, "uint"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_UINT_COUNTER));
+				stats_request = ZBX_STATS_HISTORY_UINT_COUNTER;
 			else if (0 == strcmp(tmp1, "str"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_STR_COUNTER));
+				stats_request = ZBX_STATS_HISTORY_STR_COUNTER;
 			else if (0 == strcmp(tmp1, "log"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_LOG_COUNTER));
+				stats_request = ZBX_STATS_HISTORY_LOG_COUNTER;
 			else if (0 == strcmp(tmp1, "text"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_TEXT_COUNTER));
+				stats_request = ZBX_STATS_HISTORY_TEXT_COUNTER;
 			else if (0 == strcmp(tmp1, "not supported"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_NOTSUPPORTED_COUNTER));
+				stats_request = ZBX_STATS_NOTSUPPORTED_COUNTER;
 			else
 			{
 				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid third parameter."));
 				goto out;
 			}
+
+			SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_shard_stats(stats_request, shard));
 		}
 		else if (0 == strcmp(tmp, "history"))
 		{
 			if (NULL == tmp1 || '\0' == *tmp1 || 0 == strcmp(tmp1, "pfree"))
-				SET_DBL_RESULT(result, *(double *)DCget_stats(ZBX_STATS_HISTORY_PFREE));
+				stats_request = ZBX_STATS_HISTORY_PFREE;
 			else if (0 == strcmp(tmp1, "total"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_TOTAL));
+				stats_request = ZBX_STATS_HISTORY_TOTAL;
 			else if (0 == strcmp(tmp1, "used"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_USED));
+				stats_request = ZBX_STATS_HISTORY_USED;
 			else if (0 == strcmp(tmp1, "free"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_FREE));
+				stats_request = ZBX_STATS_HISTORY_FREE;
 			else if (0 == strcmp(tmp1, "pused"))
-				SET_DBL_RESULT(result, *(double *)DCget_stats(ZBX_STATS_HISTORY_PUSED));
+				stats_request = ZBX_STATS_HISTORY_PUSED;
 			else
 			{
 				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid third parameter."));
 				goto out;
 			}
+
+			if (ZBX_STATS_HISTORY_PFREE == stats_request || ZBX_STATS_HISTORY_PUSED == stats_request)
+				SET_DBL_RESULT(result, *(double *)DCget_shard_stats(stats_request, shard));
+			else
+				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_shard_stats(stats_request, shard));
 		}
 		else if (0 == strcmp(tmp, "trend"))
 		{
@@ -605,6 +629,10 @@ int	get_value_internal(const DC_ITEM *item, AGENT_RESULT *result)
 				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_TREND_FREE));
 			else if (0 == strcmp(tmp1, "pused"))
 				SET_DBL_RESULT(result, *(double *)DCget_stats(ZBX_STATS_TREND_PUSED));
+			else if (0 == strcmp(tmp1, "queue"))
+				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_TREND_QUEUE));
+			else if (0 == strcmp(tmp1, "lag"))
+				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_TREND_LAG));
 			else
 			{
 				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid third parameter."));
@@ -614,20 +642,26 @@ int	get_value_internal(const DC_ITEM *item, AGENT_RESULT *result)
 		else if (0 == strcmp(tmp, "index"))
 		{
 			if (NULL == tmp1 || '\0' == *tmp1 || 0 == strcmp(tmp1, "pfree"))
-				SET_DBL_RESULT(result, *(double *)DCget_stats(ZBX_STATS_HISTORY_INDEX_PFREE));
+				stats_request = ZBX_STATS_HISTORY_INDEX_PFREE;
 			else if (0 == strcmp(tmp1, "total"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_INDEX_TOTAL));
+				stats_request = ZBX_STATS_HISTORY_INDEX_TOTAL;
 			else if (0 == strcmp(tmp1, "used"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_INDEX_USED));
+				stats_request = ZBX_STATS_HISTORY_INDEX_USED;
 			else if (0 == strcmp(tmp1, "free"))
-				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_stats(ZBX_STATS_HISTORY_INDEX_FREE));
+				stats_request = ZBX_STATS_HISTORY_INDEX_FREE;
 			else if (0 == strcmp(tmp1, "pused"))
-				SET_DBL_RESULT(result, *(double *)DCget_stats(ZBX_STATS_HISTORY_INDEX_PUSED));
+				stats_request = ZBX_STATS_HISTORY_INDEX_PUSED;
 			else
 			{
 				SET_MSG_RESULT(result, zbx_strdup(NULL, "Invalid third parameter."));
 				goto out;
 			}
+
+			if (ZBX_STATS_HISTORY_INDEX_PFREE == stats_request ||
+					ZBX_STATS_HISTORY_INDEX_PUSED == stats_request)
+				SET_DBL_RESULT(result, *(double *)DCget_shard_stats(stats_request, shard));
+			else
+				SET_UI64_RESULT(result, *(zbx_uint64_t *)DCget_shard_stats(stats_request, shard));
 		}
 		else
 		{
@@ -25,6 +25,8 @@
 #include <net-snmp/net-snmp-config.h>
 #include <net-snmp/net-snmp-includes.h>
 
+#include "async_event.h"
+
 #include "comms.h"
 #include "zbxalgo.h"
 #include "zbxjson.h"
@@ -101,6 +103,59 @@ typedef struct
 }
 zbx_snmpidx_mapping_t;
 
+/* range of asynchronous batch items requested with a single GET request */
+typedef struct
+{
+	int	first;
+	int	num;
+	int	level;	/* 0 - whole batch, 1 - halved batch, 2 - single item */
+}
+zbx_snmp_async_range_t;
+
+/* asynchronous GET of standard OIDs on the same interface */
+typedef struct
+{
+	DC_ITEM			*items;
+	AGENT_RESULT		*results;
+	int			*errcodes;
+	int			num;
+
+	oid			(*parsed_oids)[MAX_OID_LEN];
+	size_t			*parsed_oid_lens;
+
+	/* ranges to request, the first range covers whole batch and it is split when device cannot handle it */
+	zbx_snmp_async_range_t	*ranges;
+	int			ranges_num;
+	int			ranges_head;
+
+	/* the range being requested and the batch item indexes of its request variable bindings */
+	zbx_snmp_async_range_t	range;
+	int			*mapping;
+	int			mapping_num;
+
+	void			*sessp;
+	struct event		*ev_read;
+	struct event		*ev_timer;
+
+	/* the outstanding request and its outcome reported by Net-SNMP */
+	int			reqid;
+	int			received;
+	int			status;
+	struct snmp_pdu		*response;
+
+	/* bulk request statistics, see DCconfig_update_interface_snmp_stats() */
+	int			max_succeed;
+	int			min_fail;
+
+	/* the error failing all not yet processed items */
+	int			err;
+	char			error[MAX_STRING_LEN];
+
+	zbx_async_snmp_cb_t	done_cb;
+	void			*done_arg;
+}
+zbx_snmp_async_batch_t;
+
 static zbx_hashset_t	snmpidx;		/* Dynamic Index Cache */
 static char		zbx_snmp_init_done;
 
@@ -452,17 +507,31 @@ static int	zbx_get_snmp_response_error(const struct snmp_session *ss, const DC_I
 	return ret;
 }
 
-static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *error, size_t max_error_len)
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_init_session                                            *
+ *                                                                            *
+ * Purpose: fills SNMP session parameters from item interface settings        *
+ *                                                                            *
+ * Parameters: item          - [IN] the item                                  *
+ *             session       - [OUT] the session to initialize                *
+ *             addr          - [OUT] the peer name buffer, referenced by      *
+ *                                   the session                              *
+ *             addr_len      - [IN] the peer name buffer size                 *
+ *             error         - [OUT] the error message                        *
+ *             max_error_len - [IN] the error message buffer size             *
+ *                                                                            *
+ * Return value: SUCCEED - the session was initialized                        *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_init_session(const DC_ITEM *item, struct snmp_session *session, char *addr, size_t addr_len,
+		char *error, size_t max_error_len)
 {
-	struct snmp_session	session, *ss = NULL;
-	char			addr[128];
 #ifdef HAVE_IPV6
-	int			family;
+	int	family;
 #endif
-
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
-
-	snmp_sess_init(&session);
+	snmp_sess_init(session);
 
 	/* Allow using sub-OIDs higher than MAX_INT, like in 'snmpwalk -Ir'. */
 	/* Disables the validation of varbind values against the MIB definition for the relevant OID. */
@@ -476,167 +545,167 @@ static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *err
 	switch (item->snmp_version)
 	{
 		case ZBX_IF_SNMP_VERSION_1:
-			session.version = SNMP_VERSION_1;
+			session->version = SNMP_VERSION_1;
 			break;
 		case ZBX_IF_SNMP_VERSION_2:
-			session.version = SNMP_VERSION_2c;
+			session->version = SNMP_VERSION_2c;
 			break;
 		case ZBX_IF_SNMP_VERSION_3:
-			session.version = SNMP_VERSION_3;
+			session->version = SNMP_VERSION_3;
 			break;
 		default:
 			THIS_SHOULD_NEVER_HAPPEN;
 			break;
 	}
 
-	session.timeout = CONFIG_TIMEOUT * 1000 * 1000;	/* timeout of one attempt in microseconds */
+	session->timeout = CONFIG_TIMEOUT * 1000 * 1000;	/* timeout of one attempt in microseconds */
 							/* (net-snmp default = 1 second) */
 
 #ifdef HAVE_IPV6
 	if (SUCCEED != get_address_family(item->interface.addr, &family, error, max_error_len))
-		goto end;
+		return FAIL;
 
 	if (PF_INET == family)
 	{
-		zbx_snprintf(addr, sizeof(addr), "%s:%hu", item->interface.addr, item->interface.port);
+		zbx_snprintf(addr, addr_len, "%s:%hu", item->interface.addr, item->interface.port);
 	}
 	else
 	{
 		if (item->interface.useip)
-			zbx_snprintf(addr, sizeof(addr), "udp6:[%s]:%hu", item->interface.addr, item->interface.port);
+			zbx_snprintf(addr, addr_len, "udp6:[%s]:%hu", item->interface.addr, item->interface.port);
 		else
-			zbx_snprintf(addr, sizeof(addr), "udp6:%s:%hu", item->interface.addr, item->interface.port);
+			zbx_snprintf(addr, addr_len, "udp6:%s:%hu", item->interface.addr, item->interface.port);
 	}
 #else
-	zbx_snprintf(addr, sizeof(addr), "%s:%hu", item->interface.addr, item->interface.port);
+	zbx_snprintf(addr, addr_len, "%s:%hu", item->interface.addr, item->interface.port);
 #endif
-	session.peername = addr;
+	session->peername = addr;
 
-	if (SNMP_VERSION_1 == session.version || SNMP_VERSION_2c == session.version)
+	if (SNMP_VERSION_1 == session->version || SNMP_VERSION_2c == session->version)
 	{
-		session.community = (u_char *)item->snmp_community;
-		session.community_len = strlen((char *)session.community);
-		zabbix_log(LOG_LEVEL_DEBUG, "SNMP [%s@%s]", session.community, session.peername);
+		session->community = (u_char *)item->snmp_community;
+		session->community_len = strlen((char *)session->community);
+		zabbix_log(LOG_LEVEL_DEBUG, "SNMP [%s@%s]", session->community, session->peername);
 	}
-	else if (SNMP_VERSION_3 == session.version)
+	else if (SNMP_VERSION_3 == session->version)
 	{
 		/* set the SNMPv3 user name */
-		session.securityName = item->snmpv3_securityname;
-		session.securityNameLen = strlen(session.securityName);
+		session->securityName = item->snmpv3_securityname;
+		session->securityNameLen = strlen(session->securityName);
 
 		/* set the SNMPv3 context if specified */
 		if ('\0' != *item->snmpv3_contextname)
 		{
-			session.contextName = item->snmpv3_contextname;
-			session.contextNameLen = strlen(session.contextName);
+			session->contextName = item->snmpv3_contextname;
+			session->contextNameLen = strlen(session->contextName);
 		}
 
 		/* set the security level to authenticated, but not encrypted */
 		switch (item->snmpv3_securitylevel)
 		{
 			case ITEM_SNMPV3_SECURITYLEVEL_NOAUTHNOPRIV:
-				session.securityLevel = SNMP_SEC_LEVEL_NOAUTH;
+				session->securityLevel = SNMP_SEC_LEVEL_NOAUTH;
 				break;
 			case ITEM_SNMPV3_SECURITYLEVEL_AUTHNOPRIV:
-				session.securityLevel = SNMP_SEC_LEVEL_AUTHNOPRIV;
+				session->securityLevel = SNMP_SEC_LEVEL_AUTHNOPRIV;
 
-				if (FAIL == zbx_snmpv3_set_auth_protocol(item, &session))
+				if (FAIL == zbx_snmpv3_set_auth_protocol(item, session))
 				{
 					zbx_snprintf(error, max_error_len, "Unsupported authentication protocol [%d]",
 							item->snmpv3_authprotocol);
-					goto end;
+					return FAIL;
 				}
 
-				session.securityAuthKeyLen = USM_AUTH_KU_LEN;
+				session->securityAuthKeyLen = USM_AUTH_KU_LEN;
 
-				if (SNMPERR_SUCCESS != generate_Ku(session.securityAuthProto,
-						session.securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
-						strlen(item->snmpv3_authpassphrase), session.securityAuthKey,
-						&session.securityAuthKeyLen))
+				if (SNMPERR_SUCCESS != generate_Ku(session->securityAuthProto,
+						session->securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
+						strlen(item->snmpv3_authpassphrase), session->securityAuthKey,
+						&session->securityAuthKeyLen))
 				{
 					zbx_strlcpy(error, "Error generating Ku from authentication pass phrase",
 							max_error_len);
-					goto end;
+					return FAIL;
 				}
 				break;
 			case ITEM_SNMPV3_SECURITYLEVEL_AUTHPRIV:
-				session.securityLevel = SNMP_SEC_LEVEL_AUTHPRIV;
+				session->securityLevel = SNMP_SEC_LEVEL_AUTHPRIV;
 
-				if (FAIL == zbx_snmpv3_set_auth_protocol(item, &session))
+				if (FAIL == zbx_snmpv3_set_auth_protocol(item, session))
 				{
 					zbx_snprintf(error, max_error_len, "Unsupported authentication protocol [%d]",
 							item->snmpv3_authprotocol);
-					goto end;
+					return FAIL;
 				}
 
-				session.securityAuthKeyLen = USM_AUTH_KU_LEN;
+				session->securityAuthKeyLen = USM_AUTH_KU_LEN;
 
-				if (SNMPERR_SUCCESS != generate_Ku(session.securityAuthProto,
-						session.securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
-						strlen(item->snmpv3_authpassphrase), session.securityAuthKey,
-						&session.securityAuthKeyLen))
+				if (SNMPERR_SUCCESS != generate_Ku(session->securityAuthProto,
+						session->securityAuthProtoLen, (u_char *)item->snmpv3_authpassphrase,
+						strlen(item->snmpv3_authpassphrase), session->securityAuthKey,
+						&session->securityAuthKeyLen))
 				{
 					zbx_strlcpy(error, "Error generating Ku from authentication pass phrase",
 							max_error_len);
-					goto end;
+					return FAIL;
 				}
 
 				switch (item->snmpv3_privprotocol)
 				{
 					case ITEM_SNMPV3_PRIVPROTOCOL_DES:
 						/* set the privacy protocol to DES */
-						session.securityPrivProto = usmDESPrivProtocol;
-						session.securityPrivProtoLen = USM_PRIV_PROTO_DES_LEN;
+						session->securityPrivProto = usmDESPrivProtocol;
+						session->securityPrivProtoLen = USM_PRIV_PROTO_DES_LEN;
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES128:
 						/* set the privacy protocol to AES128 */
-						session.securityPrivProto = usmAESPrivProtocol;
-						session.securityPrivProtoLen = USM_PRIV_PROTO_AES_LEN;
+						session->securityPrivProto = usmAESPrivProtocol;
+						session->securityPrivProtoLen = USM_PRIV_PROTO_AES_LEN;
 						break;
 #ifdef HAVE_NETSNMP_STRONG_PRIV
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES192:
 						/* set the privacy protocol to AES192 */
-						session.securityPrivProto = usmAES192PrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES192PrivProtocol);
+						session->securityPrivProto = usmAES192PrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES192PrivProtocol);
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES256:
 						/* set the privacy protocol to AES256 */
-						session.securityPrivProto = usmAES256PrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES256PrivProtocol);
+						session->securityPrivProto = usmAES256PrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES256PrivProtocol);
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES192C:
 						/* set the privacy protocol to AES192 (Cisco version) */
-						session.securityPrivProto = usmAES192CiscoPrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES192CiscoPrivProtocol);
+						session->securityPrivProto = usmAES192CiscoPrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES192CiscoPrivProtocol);
 						break;
 					case ITEM_SNMPV3_PRIVPROTOCOL_AES256C:
 						/* set the privacy protocol to AES256 (Cisco version) */
-						session.securityPrivProto = usmAES256CiscoPrivProtocol;
-						session.securityPrivProtoLen = OID_LENGTH(usmAES256CiscoPrivProtocol);
+						session->securityPrivProto = usmAES256CiscoPrivProtocol;
+						session->securityPrivProtoLen = OID_LENGTH(usmAES256CiscoPrivProtocol);
 						break;
 #endif
 					default:
 						zbx_snprintf(error, max_error_len,
 								"Unsupported privacy protocol [%d]",
 								item->snmpv3_privprotocol);
-						goto end;
+						return FAIL;
 				}
 
-				session.securityPrivKeyLen = USM_PRIV_KU_LEN;
+				session->securityPrivKeyLen = USM_PRIV_KU_LEN;
 
-				if (SNMPERR_SUCCESS != generate_Ku(session.securityAuthProto,
-						session.securityAuthProtoLen, (u_char *)item->snmpv3_privpassphrase,
-						strlen(item->snmpv3_privpassphrase), session.securityPrivKey,
-						&session.securityPrivKeyLen))
+				if (SNMPERR_SUCCESS != generate_Ku(session->securityAuthProto,
+						session->securityAuthProtoLen, (u_char *)item->snmpv3_privpassphrase,
+						strlen(item->snmpv3_privpassphrase), session->securityPrivKey,
+						&session->securityPrivKeyLen))
 				{
 					zbx_strlcpy(error, "Error generating Ku from privacy pass phrase",
 							max_error_len);
-					goto end;
+					return FAIL;
 				}
 				break;
 		}
 
-		zabbix_log(LOG_LEVEL_DEBUG, "SNMPv3 [%s@%s]", session.securityName, session.peername);
+		zabbix_log(LOG_LEVEL_DEBUG, "SNMPv3 [%s@%s]", session->securityName, session->peername);
 	}
 
 #ifdef HAVE_NETSNMP_SESSION_LOCALNAME
@@ -649,10 +718,23 @@ static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *err
 		static char	localname[64];
 
 		zbx_snprintf(localname, sizeof(localname), "%s:0", CONFIG_SOURCE_IP);
-		session.localname = localname;
+		session->localname = localname;
 	}
 #endif
 
+	return SUCCEED;
+}
+
+static struct snmp_session	*zbx_snmp_open_session(const DC_ITEM *item, char *error, size_t max_error_len)
+{
+	struct snmp_session	session, *ss = NULL;
+	char			addr[128];
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	if (SUCCEED != zbx_snmp_init_session(item, &session, addr, sizeof(addr), error, max_error_len))
+		goto end;
+
 	SOCK_STARTUP;
 
 	if (NULL == (ss = snmp_open(&session)))
@@ -2199,6 +2281,652 @@ out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_push_range                                        *
+ *                                                                            *
+ * Purpose: adds range of batch items to be requested                         *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch                       *
+ *             first - [IN] the index of the first item in range              *
+ *             num   - [IN] the number of items in range                      *
+ *             level - [IN] the number of times the range was split           *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_push_range(zbx_snmp_async_batch_t *batch, int first, int num, int level)
+{
+	zbx_snmp_async_range_t	*range = &batch->ranges[batch->ranges_num++];
+
+	range->first = first;
+	range->num = num;
+	range->level = level;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_next_range                                        *
+ *                                                                            *
+ * Purpose: makes the next pending range current                              *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch                       *
+ *                                                                            *
+ * Return value: SUCCEED - the next range was taken                           *
+ *               FAIL    - all ranges have been processed                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_async_next_range(zbx_snmp_async_batch_t *batch)
+{
+	if (batch->ranges_head == batch->ranges_num)
+		return FAIL;
+
+	batch->range = batch->ranges[batch->ranges_head++];
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_split_range                                       *
+ *                                                                            *
+ * Purpose: splits the current range when device cannot handle it             *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch                       *
+ *                                                                            *
+ * Comments: The range is halved first and then split into single items,      *
+ *           the same way as zbx_snmp_get_values() does.                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_split_range(zbx_snmp_async_batch_t *batch)
+{
+	const zbx_snmp_async_range_t	*range = &batch->range;
+	int				i, half;
+
+	if (batch->min_fail > batch->mapping_num)
+		batch->min_fail = batch->mapping_num;
+
+	if (0 == range->level)
+	{
+		half = range->num / 2;
+
+		zbx_snmp_async_push_range(batch, range->first, half, 1);
+		zbx_snmp_async_push_range(batch, range->first + half, range->num - half, 1);
+	}
+	else if (1 == range->level)
+	{
+		for (i = range->first; i < range->first + range->num; i++)
+			zbx_snmp_async_push_range(batch, i, 1, 2);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_response_cb                                       *
+ *                                                                            *
+ * Purpose: Net-SNMP asynchronous request callback                            *
+ *                                                                            *
+ * Comments: The response is copied and processed after snmp_sess_read2() or  *
+ *           snmp_sess_timeout() returns, so that the next request is not     *
+ *           sent from within the library.                                    *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_async_response_cb(int operation, struct snmp_session *sp, int reqid, struct snmp_pdu *pdu,
+		void *magic)
+{
+	zbx_snmp_async_batch_t	*batch = (zbx_snmp_async_batch_t *)magic;
+
+	ZBX_UNUSED(sp);
+
+	if (reqid != batch->reqid)
+		return 1;
+
+	switch (operation)
+	{
+		case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+			batch->status = STAT_SUCCESS;
+			batch->response = snmp_clone_pdu(pdu);
+			break;
+		case NETSNMP_CALLBACK_OP_TIMED_OUT:
+			batch->status = STAT_TIMEOUT;
+			break;
+		default:
+			batch->status = STAT_ERROR;
+	}
+
+	if (STAT_SUCCESS == batch->status && NULL == batch->response)
+		batch->status = STAT_ERROR;
+
+	batch->reqid = 0;
+	batch->received = 1;
+
+	return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_send                                              *
+ *                                                                            *
+ * Purpose: sends GET request for the supported items of the current range    *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch                       *
+ *                                                                            *
+ * Return value: SUCCEED - the request was sent                               *
+ *               FAIL    - there was nothing to send, or the request could    *
+ *                         not be sent (batch received flag is set in this    *
+ *                         case and the error is handled as response)         *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_async_send(zbx_snmp_async_batch_t *batch)
+{
+	const zbx_snmp_async_range_t	*range = &batch->range;
+	struct snmp_session		*ss;
+	struct snmp_pdu			*pdu;
+	struct timeval			tv;
+	int				i;
+
+	if (NULL == (pdu = snmp_pdu_create(SNMP_MSG_GET)))
+	{
+		zbx_strlcpy(batch->error, "snmp_pdu_create(): cannot create PDU object.", sizeof(batch->error));
+		batch->err = CONFIG_ERROR;
+		return FAIL;
+	}
+
+	batch->mapping_num = 0;
+
+	for (i = range->first; i < range->first + range->num; i++)
+	{
+		if (SUCCEED != batch->errcodes[i])
+			continue;
+
+		if (NULL == snmp_add_null_var(pdu, batch->parsed_oids[i], batch->parsed_oid_lens[i]))
+		{
+			SET_MSG_RESULT(&batch->results[i], zbx_strdup(NULL,
+					"snmp_add_null_var(): cannot add null variable."));
+			batch->errcodes[i] = CONFIG_ERROR;
+			continue;
+		}
+
+		batch->mapping[batch->mapping_num++] = i;
+	}
+
+	if (0 == batch->mapping_num)
+	{
+		snmp_free_pdu(pdu);
+		return FAIL;
+	}
+
+	ss = snmp_sess_session(batch->sessp);
+	ss->retries = (1 == batch->mapping_num && 0 == range->level ? 1 : 0);
+
+	if (0 == (batch->reqid = snmp_sess_async_send(batch->sessp, pdu, zbx_snmp_async_response_cb, batch)))
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "%s() snmp_sess_async_send() s_snmp_errno:%d mapping_num:%d", __func__,
+				ss->s_snmp_errno, batch->mapping_num);
+
+		snmp_free_pdu(pdu);
+		batch->status = STAT_ERROR;
+		batch->received = 1;
+		return FAIL;
+	}
+
+	tv.tv_sec = ss->timeout / 1000000;
+	tv.tv_usec = ss->timeout % 1000000;
+	evtimer_add(batch->ev_timer, &tv);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_process_response                                  *
+ *                                                                            *
+ * Purpose: processes response to the current range request                   *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch                       *
+ *                                                                            *
+ * Return value: SUCCEED - the current range is processed                     *
+ *               FAIL    - the current range must be requested again without  *
+ *                         the variable reported by device as bad             *
+ *                                                                            *
+ * Comments: The response handling mirrors zbx_snmp_get_values(), batch error *
+ *           is set on errors that fail the whole batch.                      *
+ *                                                                            *
+ ******************************************************************************/
+static int	zbx_snmp_async_process_response(zbx_snmp_async_batch_t *batch)
+{
+	const DC_ITEM		*item = &batch->items[batch->range.first];
+	struct snmp_session	*ss;
+	struct snmp_pdu		*response = batch->response;
+	struct variable_list	*var;
+	int			i, j, status = batch->status, ret = SUCCEED;
+	unsigned char		val_type;
+
+	ss = snmp_sess_session(batch->sessp);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() status:%d s_snmp_errno:%d errstat:%ld mapping_num:%d", __func__, status,
+			ss->s_snmp_errno, NULL == response ? (long)-1 : response->errstat, batch->mapping_num);
+
+	if (STAT_SUCCESS == status && SNMP_ERR_NOERROR == response->errstat)
+	{
+		for (i = 0, var = response->variables;; i++, var = var->next_variable)
+		{
+			/* check that response variable binding matches the request variable binding */
+
+			if (i == batch->mapping_num)
+			{
+				if (NULL != var)
+				{
+					zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+							" too many variable bindings", item->host.host);
+
+					if (1 != batch->mapping_num)	/* give device a chance to handle a smaller request */
+						goto halve;
+
+					zbx_strlcpy(batch->error, "Invalid SNMP response: too many variable bindings.",
+							sizeof(batch->error));
+
+					batch->err = NOTSUPPORTED;
+				}
+
+				break;
+			}
+
+			if (NULL == var)
+			{
+				zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+						" too few variable bindings", item->host.host);
+
+				if (1 != batch->mapping_num)	/* give device a chance to handle a smaller request */
+					goto halve;
+
+				zbx_strlcpy(batch->error, "Invalid SNMP response: too few variable bindings.",
+						sizeof(batch->error));
+
+				batch->err = NOTSUPPORTED;
+				break;
+			}
+
+			j = batch->mapping[i];
+
+			if (batch->parsed_oid_lens[j] != var->name_length ||
+					0 != memcmp(batch->parsed_oids[j], var->name, batch->parsed_oid_lens[j] * sizeof(oid)))
+			{
+				char	sent_oid[ITEM_SNMP_OID_LEN_MAX], received_oid[ITEM_SNMP_OID_LEN_MAX];
+
+				zbx_snmp_dump_oid(sent_oid, sizeof(sent_oid), batch->parsed_oids[j],
+						batch->parsed_oid_lens[j]);
+				zbx_snmp_dump_oid(received_oid, sizeof(received_oid), var->name, var->name_length);
+
+				if (1 != batch->mapping_num)
+				{
+					zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+							" variable bindings that do not match the request:"
+							" sent \"%s\", received \"%s\"",
+							item->host.host, sent_oid, received_oid);
+
+					goto halve;	/* give device a chance to handle a smaller request */
+				}
+				else
+				{
+					zabbix_log(LOG_LEVEL_DEBUG, "SNMP response from host \"%s\" contains"
+							" variable bindings that do not match the request:"
+							" sent \"%s\", received \"%s\"",
+							item->host.host, sent_oid, received_oid);
+				}
+			}
+
+			/* process received data */
+
+			batch->errcodes[j] = zbx_snmp_set_result(var, &batch->results[j], &val_type);
+
+			if (ISSET_TEXT(&batch->results[j]) && ZBX_SNMP_STR_HEX == val_type)
+				zbx_remove_chars(batch->results[j].text, "\r\n");
+		}
+
+		if (SUCCEED == batch->err && batch->max_succeed < batch->mapping_num)
+			batch->max_succeed = batch->mapping_num;
+	}
+	else if (STAT_SUCCESS == status && SNMP_ERR_NOSUCHNAME == response->errstat && 0 != response->errindex)
+	{
+		/* see zbx_snmp_get_values() for the explanation of SNMPv1 and SNMPv2 behavior, the bad variable */
+		/* is marked as not supported and the rest of variables are requested again                     */
+
+		i = response->errindex - 1;
+
+		if (0 > i || i >= batch->mapping_num)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "SNMP response from host \"%s\" contains"
+					" an out of bounds error index: %ld", item->host.host, response->errindex);
+
+			zbx_strlcpy(batch->error, "Invalid SNMP response: error index out of bounds.",
+					sizeof(batch->error));
+
+			batch->err = NOTSUPPORTED;
+			return SUCCEED;
+		}
+
+		j = batch->mapping[i];
+
+		zabbix_log(LOG_LEVEL_DEBUG, "%s() errindex:%ld OID:'%s'", __func__, response->errindex,
+				batch->items[j].snmp_oid);
+
+		batch->errcodes[j] = zbx_get_snmp_response_error(ss, &item->interface, status, response, batch->error,
+				sizeof(batch->error));
+		SET_MSG_RESULT(&batch->results[j], zbx_strdup(NULL, batch->error));
+		*batch->error = '\0';
+
+		if (1 < batch->mapping_num)
+			ret = FAIL;
+	}
+	else if (1 < batch->mapping_num &&
+			((STAT_SUCCESS == status && SNMP_ERR_TOOBIG == response->errstat) || STAT_TIMEOUT == status ||
+			(STAT_ERROR == status && SNMPERR_TOO_LONG == ss->s_snmp_errno)))
+	{
+		/* see zbx_snmp_get_values() for the explanation of halving the number of variables to query */
+halve:
+		zbx_snmp_async_split_range(batch);
+	}
+	else
+	{
+		batch->err = zbx_get_snmp_response_error(ss, &item->interface, status, response, batch->error,
+				sizeof(batch->error));
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_finish                                            *
+ *                                                                            *
+ * Purpose: releases batch session and passes results to the caller           *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch, freed by this        *
+ *                          function                                          *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_finish(zbx_snmp_async_batch_t *batch)
+{
+	int	i;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() host:'%s' num:%d err:%s", __func__, batch->items[0].host.host,
+			batch->num, zbx_result_string(batch->err));
+
+	if (SUCCEED != batch->err)
+	{
+		zabbix_log(LOG_LEVEL_DEBUG, "getting SNMP values failed: %s", batch->error);
+
+		for (i = 0; i < batch->num; i++)
+		{
+			if (SUCCEED != batch->errcodes[i])
+				continue;
+
+			SET_MSG_RESULT(&batch->results[i], zbx_strdup(NULL, batch->error));
+			batch->errcodes[i] = batch->err;
+		}
+	}
+	else if (0 != batch->max_succeed || MAX_SNMP_ITEMS + 1 != batch->min_fail)
+	{
+		DCconfig_update_interface_snmp_stats(batch->items[0].interface.interfaceid, batch->max_succeed,
+				batch->min_fail);
+	}
+
+	if (NULL != batch->ev_timer)
+		event_free(batch->ev_timer);
+
+	if (NULL != batch->ev_read)
+		event_free(batch->ev_read);
+
+	if (NULL != batch->response)
+		snmp_free_pdu(batch->response);
+
+	if (NULL != batch->sessp)
+	{
+		snmp_sess_close(batch->sessp);
+		SOCK_CLEANUP;
+	}
+
+	batch->done_cb(batch->items, batch->results, batch->errcodes, batch->num, batch->done_arg);
+
+	zbx_free(batch->ranges);
+	zbx_free(batch->mapping);
+	zbx_free(batch->parsed_oid_lens);
+	zbx_free(batch->parsed_oids);
+	zbx_free(batch->errcodes);
+	zbx_free(batch->results);
+	zbx_free(batch->items);
+	zbx_free(batch);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_snmp_async_run                                               *
+ *                                                                            *
+ * Purpose: processes received response and sends the next request until      *
+ *          a request is in flight or the batch is completed                  *
+ *                                                                            *
+ * Parameters: batch - [IN] the asynchronous SNMP batch                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	zbx_snmp_async_run(zbx_snmp_async_batch_t *batch)
+{
+	while (SUCCEED == batch->err)
+	{
+		if (0 != batch->received)
+		{
+			int	ret;
+
+			ret = zbx_snmp_async_process_response(batch);
+
+			batch->received = 0;
+
+			if (NULL != batch->response)
+			{
+				snmp_free_pdu(batch->response);
+				batch->response = NULL;
+			}
+
+			if (SUCCEED != batch->err)
+				break;
+
+			if (SUCCEED == ret && SUCCEED != zbx_snmp_async_next_range(batch))
+				break;
+		}
+
+		if (SUCCEED == zbx_snmp_async_send(batch))
+			return;
+
+		if (0 == batch->received && SUCCEED != zbx_snmp_async_next_range(batch))
+			break;
+	}
+
+	zbx_snmp_async_finish(batch);
+}
+
+static void	zbx_snmp_async_read_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_snmp_async_batch_t	*batch = (zbx_snmp_async_batch_t *)arg;
+	netsnmp_large_fd_set	fdset;
+
+	ZBX_UNUSED(what);
+
+	/* large fd set is used because poller can have more sockets open than FD_SETSIZE */
+	netsnmp_large_fd_set_init(&fdset, fd + 1);
+	netsnmp_large_fd_setfd(fd, &fdset);
+	snmp_sess_read2(batch->sessp, &fdset);
+	netsnmp_large_fd_set_cleanup(&fdset);
+
+	if (0 != batch->received)
+	{
+		evtimer_del(batch->ev_timer);
+		zbx_snmp_async_run(batch);
+	}
+}
+
+static void	zbx_snmp_async_timer_cb(evutil_socket_t fd, short what, void *arg)
+{
+	zbx_snmp_async_batch_t	*batch = (zbx_snmp_async_batch_t *)arg;
+	struct snmp_session	*ss;
+	struct timeval		tv;
+
+	ZBX_UNUSED(fd);
+	ZBX_UNUSED(what);
+
+	/* retransmits the request or reports timeout through the request callback */
+	snmp_sess_timeout(batch->sessp);
+
+	if (0 != batch->received)
+	{
+		zbx_snmp_async_run(batch);
+		return;
+	}
+
+	ss = snmp_sess_session(batch->sessp);
+	tv.tv_sec = ss->timeout / 1000000;
+	tv.tv_usec = ss->timeout % 1000000;
+	evtimer_add(batch->ev_timer, &tv);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_async_check_snmp                                             *
+ *                                                                            *
+ * Purpose: starts asynchronous SNMP GET of interface items                   *
+ *                                                                            *
+ * Parameters: items    - [IN] the items of the same interface, ownership of  *
+ *                             item data is passed to this function           *
+ *             results  - [IN] the prepared item results                      *
+ *             errcodes - [IN] the item error codes after preparation         *
+ *             num      - [IN] the number of items                            *
+ *             base     - [IN] the event base to register socket events in    *
+ *             done_cb  - [IN] the callback called with item results when all *
+ *                             items are processed, ownership of item data    *
+ *                             and results is passed to the callback          *
+ *             arg      - [IN] the callback argument                          *
+ *                                                                            *
+ * Comments: The batch is requested the same way as get_values_snmp() does    *
+ *           for standard OIDs, including halving of bulk requests and        *
+ *           updating of interface bulk statistics. Discovery and dynamic     *
+ *           index items are processed synchronously.                         *
+ *                                                                            *
+ *           SNMPv3 engine ID discovery is performed by Net-SNMP when the     *
+ *           session is opened and is blocking.                               *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_async_check_snmp(DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, struct event_base *base,
+		zbx_async_snmp_cb_t done_cb, void *arg)
+{
+	zbx_snmp_async_batch_t	*batch;
+	struct snmp_session	session;
+	char			addr[128], oid_translated[ITEM_SNMP_OID_LEN_MAX];
+	int			i, j;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() host:'%s' addr:'%s' num:%d", __func__, items[0].host.host,
+			items[0].interface.addr, num);
+
+	zbx_init_snmp();	/* avoid high CPU usage by only initializing SNMP once used */
+
+	batch = (zbx_snmp_async_batch_t *)zbx_malloc(NULL, sizeof(zbx_snmp_async_batch_t));
+	memset(batch, 0, sizeof(zbx_snmp_async_batch_t));
+
+	batch->items = (DC_ITEM *)zbx_malloc(NULL, sizeof(DC_ITEM) * num);
+	memcpy(batch->items, items, sizeof(DC_ITEM) * num);
+	batch->results = (AGENT_RESULT *)zbx_malloc(NULL, sizeof(AGENT_RESULT) * num);
+	memcpy(batch->results, results, sizeof(AGENT_RESULT) * num);
+	batch->errcodes = (int *)zbx_malloc(NULL, sizeof(int) * num);
+	memcpy(batch->errcodes, errcodes, sizeof(int) * num);
+	batch->num = num;
+	batch->err = SUCCEED;
+	batch->min_fail = MAX_SNMP_ITEMS + 1;
+	batch->done_cb = done_cb;
+	batch->done_arg = arg;
+
+	for (j = 0; j < num; j++)	/* locate first supported item to use as a reference */
+	{
+		if (SUCCEED == batch->errcodes[j])
+			break;
+	}
+
+	if (j == num)	/* all items already NOTSUPPORTED (with invalid key, port or SNMP parameters) */
+		goto out;
+
+	if (0 != (ZBX_FLAG_DISCOVERY_RULE & batch->items[j].flags) || NULL != strchr(batch->items[j].snmp_oid, '['))
+	{
+		/* item configuration was changed after the items were queued or OID macros were resolved */
+		/* to dynamic index, walking is not supported by asynchronous requests                    */
+		get_values_snmp(batch->items, batch->results, batch->errcodes, num, ZBX_POLLER_TYPE_SNMP);
+		goto out;
+	}
+
+	batch->parsed_oids = (oid (*)[MAX_OID_LEN])zbx_malloc(NULL, sizeof(*batch->parsed_oids) * num);
+	batch->parsed_oid_lens = (size_t *)zbx_malloc(NULL, sizeof(size_t) * num);
+	batch->mapping = (int *)zbx_malloc(NULL, sizeof(int) * num);
+
+	/* the batch range can be halved once and then split into single items */
+	batch->ranges = (zbx_snmp_async_range_t *)zbx_malloc(NULL, sizeof(zbx_snmp_async_range_t) * (num + 3));
+
+	for (i = j; i < num; i++)
+	{
+		if (SUCCEED != batch->errcodes[i])
+			continue;
+
+		if (0 != num_key_param(batch->items[i].snmp_oid))
+		{
+			SET_MSG_RESULT(&batch->results[i], zbx_dsprintf(NULL, "OID \"%s\" contains unsupported"
+					" parameters.", batch->items[i].snmp_oid));
+			batch->errcodes[i] = CONFIG_ERROR;
+			continue;
+		}
+
+		zbx_snmp_translate(oid_translated, batch->items[i].snmp_oid, sizeof(oid_translated));
+		batch->parsed_oid_lens[i] = MAX_OID_LEN;
+
+		if (NULL == snmp_parse_oid(oid_translated, batch->parsed_oids[i], &batch->parsed_oid_lens[i]))
+		{
+			SET_MSG_RESULT(&batch->results[i], zbx_dsprintf(NULL, "snmp_parse_oid(): cannot parse OID"
+					" \"%s\".", oid_translated));
+			batch->errcodes[i] = CONFIG_ERROR;
+		}
+	}
+
+	if (SUCCEED != zbx_snmp_init_session(&batch->items[j], &session, addr, sizeof(addr), batch->error,
+			sizeof(batch->error)))
+	{
+		batch->err = NETWORK_ERROR;
+		goto out;
+	}
+
+	SOCK_STARTUP;
+
+	if (NULL == (batch->sessp = snmp_sess_open(&session)))
+	{
+		SOCK_CLEANUP;
+
+		zbx_strlcpy(batch->error, "Cannot open SNMP session", sizeof(batch->error));
+		batch->err = NETWORK_ERROR;
+		goto out;
+	}
+
+	batch->ev_read = event_new(base, snmp_sess_transport(batch->sessp)->sock, EV_READ | EV_PERSIST,
+			zbx_snmp_async_read_cb, batch);
+	event_add(batch->ev_read, NULL);
+	batch->ev_timer = event_new(base, -1, 0, zbx_snmp_async_timer_cb, batch);
+
+	zbx_snmp_async_push_range(batch, j, num - j, 0);
+	(void)zbx_snmp_async_next_range(batch);
+
+	zbx_snmp_async_run(batch);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+
+	return;
+out:
+	zbx_snmp_async_finish(batch);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
 static void	zbx_shutdown_snmp(void)
 {
 	sigset_t	mask, orig_mask;
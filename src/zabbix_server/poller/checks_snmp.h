@@ -40,6 +40,13 @@ extern int	CONFIG_TIMEOUT;
 int	get_value_snmp(const DC_ITEM *item, AGENT_RESULT *result, unsigned char poller_type);
 void	get_values_snmp(const DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, unsigned char poller_type);
 void	zbx_clear_cache_snmp(unsigned char process_type, int process_num);
+
+struct event_base;
+
+typedef void (*zbx_async_snmp_cb_t)(DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, void *arg);
+
+void	zbx_async_check_snmp(DC_ITEM *items, AGENT_RESULT *results, int *errcodes, int num, struct event_base *base,
+		zbx_async_snmp_cb_t done_cb, void *arg);
 #endif
 
 #endif
@@ -812,7 +812,7 @@ static int	get_values(unsigned char poller_type, int *nextcheck)
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
 	items = &item;
-	num = DCconfig_get_poller_items(poller_type, &items);
+	num = DCconfig_get_poller_items(poller_type, 0, &items);
 
 	if (0 == num)
 	{
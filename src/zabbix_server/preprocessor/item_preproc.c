@@ -35,6 +35,32 @@
 
 extern zbx_es_t	es_engine;
 
+/* the maximum number of compiled jsonpaths kept in cache */
+#define ZBX_PREPROC_JSONPATH_CACHE_MAX	1000
+
+typedef struct
+{
+	char		*path;
+	zbx_jsonpath_t	jsonpath;
+}
+zbx_preproc_jsonpath_t;
+
+/* the last json document queried by jsonpath, so that the queries of */
+/* dependent items on the same master value can share its index      */
+typedef struct
+{
+	char			*data;
+	size_t			size;
+	struct zbx_json_parse	jp;
+	zbx_jsonpath_index_t	*index;
+}
+zbx_preproc_json_t;
+
+/* compiled jsonpaths by path */
+static ZBX_THREAD_LOCAL zbx_hashset_t		jsonpath_cache;
+
+static ZBX_THREAD_LOCAL zbx_preproc_json_t	json_last;
+
 /******************************************************************************
  *                                                                            *
  * Function: item_preproc_numeric_type_hint                                   *
@@ -859,6 +885,133 @@ static int	item_preproc_regsub(zbx_variant_t *value, const char *params, char **
 	return FAIL;
 }
 
+static zbx_hash_t	preproc_jsonpath_hash(const void *data)
+{
+	const zbx_preproc_jsonpath_t	*path = (const zbx_preproc_jsonpath_t *)data;
+
+	return ZBX_DEFAULT_STRING_HASH_FUNC(path->path);
+}
+
+static void	preproc_jsonpath_clear(void *data)
+{
+	zbx_preproc_jsonpath_t	*path = (zbx_preproc_jsonpath_t *)data;
+
+	zbx_free(path->path);
+	zbx_jsonpath_clear(&path->jsonpath);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: item_preproc_jsonpath_compile                                    *
+ *                                                                            *
+ * Purpose: get compiled jsonpath from cache, compiling it if necessary       *
+ *                                                                            *
+ * Parameters: path - [IN] the jsonpath                                       *
+ *                                                                            *
+ * Return value: The compiled jsonpath or NULL if the path is not valid.      *
+ *                                                                            *
+ ******************************************************************************/
+static const zbx_jsonpath_t	*item_preproc_jsonpath_compile(const char *path)
+{
+	zbx_preproc_jsonpath_t	*cached, path_local;
+
+	if (0 == jsonpath_cache.num_slots)
+	{
+		zbx_hashset_create_ext(&jsonpath_cache, 100, preproc_jsonpath_hash, ZBX_DEFAULT_STR_COMPARE_FUNC,
+				preproc_jsonpath_clear, ZBX_DEFAULT_MEM_MALLOC_FUNC, ZBX_DEFAULT_MEM_REALLOC_FUNC,
+				ZBX_DEFAULT_MEM_FREE_FUNC);
+	}
+
+	path_local.path = (char *)path;
+
+	if (NULL != (cached = (zbx_preproc_jsonpath_t *)zbx_hashset_search(&jsonpath_cache, &path_local)))
+		return &cached->jsonpath;
+
+	if (FAIL == zbx_jsonpath_compile(path, &path_local.jsonpath))
+		return NULL;
+
+	/* paths are not tracked for usage, simply start over when the cache is full */
+	if (ZBX_PREPROC_JSONPATH_CACHE_MAX <= jsonpath_cache.num_data)
+		zbx_hashset_clear(&jsonpath_cache);
+
+	path_local.path = zbx_strdup(NULL, path);
+	cached = (zbx_preproc_jsonpath_t *)zbx_hashset_insert(&jsonpath_cache, &path_local, sizeof(path_local));
+
+	return &cached->jsonpath;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: item_preproc_json_open                                           *
+ *                                                                            *
+ * Purpose: open json document for jsonpath queries                           *
+ *                                                                            *
+ * Parameters: data  - [IN] the json document                                 *
+ *             size  - [OUT] the json document length                         *
+ *             jp    - [OUT] the opened json document                         *
+ *             index - [OUT] the document index (NULL if not indexed)         *
+ *                                                                            *
+ * Return value: SUCCEED - the document was opened successfully               *
+ *               FAIL    - the document is not valid json                     *
+ *                                                                            *
+ * Comments: When the document is the same as the last successfully queried   *
+ *           document (dependent items of the same master item) the kept      *
+ *           document is used instead, it is indexed on the second query and  *
+ *           the following queries reuse the index rather than parsing the    *
+ *           document from the start.                                         *
+ *                                                                            *
+ ******************************************************************************/
+static int	item_preproc_json_open(const char *data, size_t *size, struct zbx_json_parse *jp,
+		zbx_jsonpath_index_t **index)
+{
+	*size = strlen(data);
+
+	/* each dependent item value is received in its own buffer, so the content must be compared */
+	if (NULL != json_last.data && *size == json_last.size && 0 == memcmp(data, json_last.data, *size))
+	{
+		if (NULL == json_last.index)
+			json_last.index = zbx_jsonpath_index_create();
+
+		*jp = json_last.jp;
+		*index = json_last.index;
+
+		return SUCCEED;
+	}
+
+	*index = NULL;
+
+	return zbx_json_open(data, jp);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: item_preproc_json_keep                                           *
+ *                                                                            *
+ * Purpose: keep queried json document for the following queries              *
+ *                                                                            *
+ * Parameters: data - [IN] the json document, the memory is taken over        *
+ *             size - [IN] the json document length                           *
+ *             jp   - [IN] the opened json document                           *
+ *                                                                            *
+ * Comments: The document is the value replaced by the query result, so it    *
+ *           is kept without copying.                                         *
+ *                                                                            *
+ ******************************************************************************/
+static void	item_preproc_json_keep(char *data, size_t size, const struct zbx_json_parse *jp)
+{
+	if (NULL != json_last.index)
+	{
+		zbx_jsonpath_index_free(json_last.index);
+		json_last.index = NULL;
+	}
+
+	zbx_free(json_last.data);
+
+	json_last.data = data;
+	json_last.size = size;
+	json_last.jp = *jp;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: item_preproc_jsonpath_op                                         *
@@ -877,11 +1030,16 @@ static int	item_preproc_jsonpath_op(zbx_variant_t *value, const char *params, ch
 {
 	struct zbx_json_parse	jp;
 	char			*data = NULL;
+	const zbx_jsonpath_t	*jsonpath;
+	zbx_jsonpath_index_t	*index;
+	size_t			size;
 
 	if (FAIL == item_preproc_convert_value(value, ZBX_VARIANT_STR, errmsg))
 		return FAIL;
 
-	if (FAIL == zbx_json_open(value->data.str, &jp) || FAIL == zbx_jsonpath_query(&jp, params, &data))
+	if (FAIL == item_preproc_json_open(value->data.str, &size, &jp, &index) ||
+			NULL == (jsonpath = item_preproc_jsonpath_compile(params)) ||
+			FAIL == zbx_jsonpath_query_compiled(&jp, jsonpath, index, &data))
 	{
 		*errmsg = zbx_strdup(*errmsg, zbx_json_strerror());
 		return FAIL;
@@ -893,7 +1051,11 @@ static int	item_preproc_jsonpath_op(zbx_variant_t *value, const char *params, ch
 		return FAIL;
 	}
 
-	zbx_variant_clear(value);
+	if (NULL == index)
+		item_preproc_json_keep(value->data.str, size, &jp);
+	else
+		zbx_variant_clear(value);
+
 	zbx_variant_set_str(value, data);
 
 	return SUCCEED;
@@ -33,6 +33,7 @@
 #include "preproc_manager.h"
 #include "zbxalgo.h"
 #include "preproc_history.h"
+#include "preproc_ring.h"
 
 extern unsigned char	process_type, program_type;
 extern int		server_num, process_num, CONFIG_PREPROCESSOR_FORKS;
@@ -42,6 +43,11 @@ extern int		server_num, process_num, CONFIG_PREPROCESSOR_FORKS;
 #define ZBX_PREPROC_PRIORITY_NONE	0
 #define ZBX_PREPROC_PRIORITY_FIRST	1
 
+/* maximum number of values of the same item sent to worker in one task */
+#define ZBX_PREPROC_BATCH_MAX		64
+/* maximum number of queued requests scanned when collecting values for batch */
+#define ZBX_PREPROC_BATCH_WINDOW	1024
+
 typedef enum
 {
 	REQUEST_STATE_QUEUED		= 0,		/* requires preprocessing */
@@ -81,6 +87,13 @@ typedef struct
 }
 zbx_item_link_t;
 
+/* values of the same item being preprocessed by worker in one task */
+typedef struct
+{
+	zbx_vector_ptr_t	nodes;		/* queued items of the batched requests in processing order */
+}
+zbx_preprocessing_batch_t;
+
 /* direct request to be forwarded to worker, bypassing the preprocessing queue */
 typedef struct
 {
@@ -106,6 +119,7 @@ typedef struct
 
 	zbx_list_t			direct_queue;	/* Queue of external requests that have to be */
 							/* forwarded to workers for preprocessing.    */
+	int				index;		/* preprocessing manager index */
 }
 zbx_preprocessing_manager_t;
 
@@ -201,48 +215,119 @@ static void	preprocessor_sync_configuration(zbx_preprocessing_manager_t *manager
 
 /******************************************************************************
  *                                                                            *
- * Function: preprocessor_create_task                                         *
+ * Function: preprocessor_get_request_value                                   *
  *                                                                            *
- * Purpose: create preprocessing task for request                             *
+ * Purpose: get request value to be preprocessed                              *
  *                                                                            *
- * Parameters: manager - [IN] preprocessing manager                           *
- *             request - [IN] preprocessing request                           *
- *             task    - [OUT] preprocessing task data                        *
+ * Parameters: request - [IN] preprocessing request                           *
+ *             value   - [OUT] the value (references request result data)     *
  *                                                                            *
  ******************************************************************************/
-static zbx_uint32_t	preprocessor_create_task(zbx_preprocessing_manager_t *manager,
-		zbx_preprocessing_request_t *request, unsigned char **task)
+static void	preprocessor_get_request_value(const zbx_preprocessing_request_t *request, zbx_variant_t *value)
 {
-	zbx_variant_t		value;
-	zbx_preproc_history_t	*vault;
-	zbx_vector_ptr_t	*phistory;
-
 	if (ITEM_STATE_NOTSUPPORTED == request->value.state)
-		zbx_variant_set_str(&value, "");
+		zbx_variant_set_str(value, "");
 	else if (ISSET_LOG(request->value.result_ptr->result))
-		zbx_variant_set_str(&value, request->value.result_ptr->result->log->value);
+		zbx_variant_set_str(value, request->value.result_ptr->result->log->value);
 	else if (ISSET_UI64(request->value.result_ptr->result))
-		zbx_variant_set_ui64(&value, request->value.result_ptr->result->ui64);
+		zbx_variant_set_ui64(value, request->value.result_ptr->result->ui64);
 	else if (ISSET_DBL(request->value.result_ptr->result))
-		zbx_variant_set_dbl(&value, request->value.result_ptr->result->dbl);
+		zbx_variant_set_dbl(value, request->value.result_ptr->result->dbl);
 	else if (ISSET_STR(request->value.result_ptr->result))
-		zbx_variant_set_str(&value, request->value.result_ptr->result->str);
+		zbx_variant_set_str(value, request->value.result_ptr->result->str);
 	else if (ISSET_TEXT(request->value.result_ptr->result))
-		zbx_variant_set_str(&value, request->value.result_ptr->result->text);
+		zbx_variant_set_str(value, request->value.result_ptr->result->text);
 	else
 		THIS_SHOULD_NEVER_HAPPEN;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_get_history                                         *
+ *                                                                            *
+ * Purpose: get preprocessing history of the item                             *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *             itemid  - [IN] the item identifier                             *
+ *                                                                            *
+ * Return value: the item preprocessing history or NULL if none               *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_vector_ptr_t	*preprocessor_get_history(zbx_preprocessing_manager_t *manager, zbx_uint64_t itemid)
+{
+	zbx_preproc_history_t	*vault;
+
+	if (NULL == (vault = (zbx_preproc_history_t *)zbx_hashset_search(&manager->history_cache, &itemid)))
+		return NULL;
+
+	return &vault->history;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_create_task                                         *
+ *                                                                            *
+ * Purpose: create preprocessing task for request                             *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *             request - [IN] preprocessing request                           *
+ *             task    - [OUT] preprocessing task data                        *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint32_t	preprocessor_create_task(zbx_preprocessing_manager_t *manager,
+		zbx_preprocessing_request_t *request, unsigned char **task)
+{
+	zbx_variant_t	value;
 
-	if (NULL != (vault = (zbx_preproc_history_t *)zbx_hashset_search(&manager->history_cache,
-				&request->value.itemid)))
+	preprocessor_get_request_value(request, &value);
+
+	return zbx_preprocessor_pack_task(task, request->value.itemid, request->value_type, request->value.ts, &value,
+			preprocessor_get_history(manager, request->value.itemid), request->steps, request->steps_num);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_create_batch_task                                   *
+ *                                                                            *
+ * Purpose: create preprocessing task for batched requests                    *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *             batch   - [IN] the batched requests                            *
+ *             task    - [OUT] preprocessing task data                        *
+ *                                                                            *
+ * Comments: The steps of the first request are used for all values, so the   *
+ *           batched requests must have identical steps.                      *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint32_t	preprocessor_create_batch_task(zbx_preprocessing_manager_t *manager,
+		const zbx_preprocessing_batch_t *batch, unsigned char **task)
+{
+	zbx_variant_t			*values;
+	zbx_timespec_t			**ts;
+	zbx_preprocessing_request_t	*request;
+	zbx_uint32_t			size;
+	int				i;
+
+	values = (zbx_variant_t *)zbx_malloc(NULL, sizeof(zbx_variant_t) * batch->nodes.values_num);
+	ts = (zbx_timespec_t **)zbx_malloc(NULL, sizeof(zbx_timespec_t *) * batch->nodes.values_num);
+
+	for (i = 0; i < batch->nodes.values_num; i++)
 	{
-		phistory = &vault->history;
+		request = (zbx_preprocessing_request_t *)((zbx_list_item_t *)batch->nodes.values[i])->data;
+		preprocessor_get_request_value(request, &values[i]);
+		ts[i] = request->value.ts;
 	}
-	else
-		phistory = NULL;
 
+	request = (zbx_preprocessing_request_t *)((zbx_list_item_t *)batch->nodes.values[0])->data;
 
-	return zbx_preprocessor_pack_task(task, request->value.itemid, request->value_type, request->value.ts, &value,
-			phistory, request->steps, request->steps_num);
+	size = zbx_preprocessor_pack_batch_task(task, request->value.itemid, request->value_type, ts, values,
+			batch->nodes.values_num, preprocessor_get_history(manager, request->value.itemid),
+			request->steps, request->steps_num);
+
+	zbx_free(ts);
+	zbx_free(values);
+
+	return size;
 }
 
 /******************************************************************************
@@ -274,6 +359,92 @@ static	void	preprocessor_set_request_state_done(zbx_preprocessing_manager_t *man
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_compare_steps                                       *
+ *                                                                            *
+ * Purpose: check if two requests have identical preprocessing steps          *
+ *                                                                            *
+ * Parameters: r1 - [IN] the first request                                    *
+ *             r2 - [IN] the second request                                   *
+ *                                                                            *
+ * Return value: SUCCEED - the steps are identical                            *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+static int	preprocessor_compare_steps(const zbx_preprocessing_request_t *r1, const zbx_preprocessing_request_t *r2)
+{
+	int	i;
+
+	if (r1->steps_num != r2->steps_num || r1->value_type != r2->value_type)
+		return FAIL;
+
+	for (i = 0; i < r1->steps_num; i++)
+	{
+		if (r1->steps[i].type != r2->steps[i].type || r1->steps[i].error_handler != r2->steps[i].error_handler)
+			return FAIL;
+
+		if (0 != strcmp(r1->steps[i].params, r2->steps[i].params))
+			return FAIL;
+
+		if (0 != strcmp(r1->steps[i].error_handler_params, r2->steps[i].error_handler_params))
+			return FAIL;
+	}
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_collect_batch                                       *
+ *                                                                            *
+ * Purpose: collect queued values of the same item that can be preprocessed   *
+ *          together with the specified request                               *
+ *                                                                            *
+ * Parameters: iterator - [IN] the queue position of the request              *
+ *             nodes    - [OUT] queued items of the requests to preprocess,   *
+ *                              starting with the specified request           *
+ *                                                                            *
+ * Comments: Values of an item with history based steps are linked through    *
+ *           pending requests - only the directly pending value can follow.   *
+ *           Other values must be queued and have the same preprocessing      *
+ *           steps. Collecting stops at the first value of the item that      *
+ *           cannot be batched to keep the value order.                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	preprocessor_collect_batch(const zbx_list_iterator_t *iterator, zbx_vector_ptr_t *nodes)
+{
+	zbx_list_iterator_t		it = *iterator;
+	zbx_preprocessing_request_t	*first, *last, *request;
+	int				scanned = 0;
+
+	zbx_list_iterator_peek(&it, (void **)&first);
+	zbx_vector_ptr_append(nodes, it.current);
+
+	if (ITEM_STATE_NORMAL != first->value.state)
+		return;
+
+	last = first;
+
+	while (ZBX_PREPROC_BATCH_MAX > nodes->values_num && ZBX_PREPROC_BATCH_WINDOW > scanned++ &&
+			SUCCEED == zbx_list_iterator_next(&it))
+	{
+		zbx_list_iterator_peek(&it, (void **)&request);
+
+		if (request->value.itemid != first->value.itemid)
+			continue;
+
+		if (request != last->pending && (NULL != last->pending || REQUEST_STATE_QUEUED != request->state))
+			break;
+
+		if (ITEM_STATE_NORMAL != request->value.state || SUCCEED != preprocessor_compare_steps(first, request))
+			break;
+
+		zbx_vector_ptr_append(nodes, it.current);
+		last = request;
+	}
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: preprocessor_get_next_task                                       *
@@ -292,6 +463,9 @@ static void	*preprocessor_get_next_task(zbx_preprocessing_manager_t *manager, zb
 	zbx_preprocessing_request_t		*request = NULL;
 	void					*task = NULL;
 	zbx_preprocessing_direct_request_t	*direct_request;
+	zbx_preprocessing_batch_t		*batch;
+	zbx_vector_ptr_t			nodes;
+	int					i;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -333,11 +507,34 @@ static void	*preprocessor_get_next_task(zbx_preprocessing_manager_t *manager, zb
 			continue;
 		}
 
-		task = iterator.current;
-		request->state = REQUEST_STATE_PROCESSING;
-		message->code = ZBX_IPC_PREPROCESSOR_REQUEST;
-		message->size = preprocessor_create_task(manager, request, &message->data);
-		request_free_steps(request);
+		zbx_vector_ptr_create(&nodes);
+		preprocessor_collect_batch(&iterator, &nodes);
+
+		if (1 == nodes.values_num)
+		{
+			task = iterator.current;
+			request->state = REQUEST_STATE_PROCESSING;
+			message->code = ZBX_IPC_PREPROCESSOR_REQUEST;
+			message->size = preprocessor_create_task(manager, request, &message->data);
+			request_free_steps(request);
+			zbx_vector_ptr_destroy(&nodes);
+			break;
+		}
+
+		batch = (zbx_preprocessing_batch_t *)zbx_malloc(NULL, sizeof(zbx_preprocessing_batch_t));
+		batch->nodes = nodes;
+
+		message->code = ZBX_IPC_PREPROCESSOR_BATCH_REQUEST;
+		message->size = preprocessor_create_batch_task(manager, batch, &message->data);
+
+		for (i = 0; i < nodes.values_num; i++)
+		{
+			request = (zbx_preprocessing_request_t *)((zbx_list_item_t *)nodes.values[i])->data;
+			request->state = REQUEST_STATE_PROCESSING;
+			request_free_steps(request);
+		}
+
+		task = batch;
 		break;
 	}
 out:
@@ -818,29 +1015,99 @@ static void	preprocessor_enqueue_dependent(zbx_preprocessing_manager_t *manager,
 
 /******************************************************************************
  *                                                                            *
- * Function: preprocessor_add_request                                         *
+ * Function: preprocessor_enqueue_values                                      *
  *                                                                            *
- * Purpose: handle new preprocessing request                                  *
+ * Purpose: unpack and enqueue item values                                    *
  *                                                                            *
  * Parameters: manager - [IN] preprocessing manager                           *
- *             message - [IN] packed preprocessing request                    *
+ *             data    - [IN] packed item values                              *
+ *             size    - [IN] packed data size                                *
  *                                                                            *
  ******************************************************************************/
-static void	preprocessor_add_request(zbx_preprocessing_manager_t *manager, zbx_ipc_message_t *message)
+static void	preprocessor_enqueue_values(zbx_preprocessing_manager_t *manager, unsigned char *data,
+		zbx_uint32_t size)
 {
 	zbx_uint32_t			offset = 0;
 	zbx_preproc_item_value_t	value;
 
+	while (offset < size)
+	{
+		offset += zbx_preprocessor_unpack_value(&value, data + offset);
+		preprocessor_enqueue(manager, &value, NULL);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_read_ring                                           *
+ *                                                                            *
+ * Purpose: enqueue item values written by other processes into shared        *
+ *          memory preprocessing ring                                         *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *                                                                            *
+ * Return value: the number of ring slots read                                *
+ *                                                                            *
+ ******************************************************************************/
+static int	preprocessor_read_ring(zbx_preprocessing_manager_t *manager)
+{
+	unsigned char	*data;
+	zbx_uint32_t	size;
+	int		slots_num = 0;
+
+	while (SUCCEED == preproc_ring_read(manager->index, &data, &size))
+	{
+		if (0 == slots_num++)
+			preprocessor_sync_configuration(manager);
+
+		preprocessor_enqueue_values(manager, data, size);
+		preproc_ring_release(manager->index);
+	}
+
+	return slots_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_add_ring_request                                    *
+ *                                                                            *
+ * Purpose: handle preprocessing ring notification                            *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	preprocessor_add_ring_request(zbx_preprocessing_manager_t *manager)
+{
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	preprocessor_sync_configuration(manager);
+	preproc_ring_reset_notify(manager->index);
 
-	while (offset < message->size)
+	if (0 != preprocessor_read_ring(manager))
 	{
-		offset += zbx_preprocessor_unpack_value(&value, message->data + offset);
-		preprocessor_enqueue(manager, &value, NULL);
+		preprocessor_assign_tasks(manager);
+		preprocessing_flush_queue(manager);
 	}
 
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_add_request                                         *
+ *                                                                            *
+ * Purpose: handle new preprocessing request                                  *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *             message - [IN] packed preprocessing request                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	preprocessor_add_request(zbx_preprocessing_manager_t *manager, zbx_ipc_message_t *message)
+{
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	preprocessor_sync_configuration(manager);
+	preprocessor_enqueue_values(manager, message->data, message->size);
+
 	preprocessor_assign_tasks(manager);
 	preprocessing_flush_queue(manager);
 
@@ -1027,6 +1294,52 @@ out:
 	return ret;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_store_history                                       *
+ *                                                                            *
+ * Purpose: replace item preprocessing history with the history returned by   *
+ *          worker                                                            *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *             itemid  - [IN] the item identifier                             *
+ *             history - [IN/OUT] the new history, its contents are moved to  *
+ *                                history cache                               *
+ *                                                                            *
+ ******************************************************************************/
+static void	preprocessor_store_history(zbx_preprocessing_manager_t *manager, zbx_uint64_t itemid,
+		zbx_vector_ptr_t *history)
+{
+	zbx_preproc_history_t	*vault;
+
+	if (NULL != (vault = (zbx_preproc_history_t *)zbx_hashset_search(&manager->history_cache, &itemid)))
+		zbx_vector_ptr_clear_ext(&vault->history, (zbx_clean_func_t)zbx_preproc_op_history_free);
+
+	if (0 != history->values_num)
+	{
+		if (NULL == vault)
+		{
+			zbx_preproc_history_t	history_local;
+
+			history_local.itemid = itemid;
+			vault = (zbx_preproc_history_t *)zbx_hashset_insert(&manager->history_cache, &history_local,
+					sizeof(history_local));
+			zbx_vector_ptr_create(&vault->history);
+		}
+
+		zbx_vector_ptr_append_array(&vault->history, history->values, history->values_num);
+		zbx_vector_ptr_clear(history);
+	}
+	else
+	{
+		if (NULL != vault)
+		{
+			zbx_vector_ptr_destroy(&vault->history);
+			zbx_hashset_remove_direct(&manager->history_cache, vault);
+		}
+	}
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: preprocessor_add_result                                          *
@@ -1046,7 +1359,6 @@ static void	preprocessor_add_result(zbx_preprocessing_manager_t *manager, zbx_ip
 	zbx_variant_t			value;
 	char				*error;
 	zbx_vector_ptr_t		history;
-	zbx_preproc_history_t		*vault;
 	zbx_list_item_t			*node;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
@@ -1058,45 +1370,91 @@ static void	preprocessor_add_result(zbx_preprocessing_manager_t *manager, zbx_ip
 	zbx_vector_ptr_create(&history);
 	zbx_preprocessor_unpack_result(&value, &history, &error, message->data);
 
-	if (NULL != (vault = (zbx_preproc_history_t *)zbx_hashset_search(&manager->history_cache,
-			&request->value.itemid)))
+	preprocessor_store_history(manager, request->value.itemid, &history);
+
+	preprocessor_set_request_state_done(manager, request, worker->task);
+
+	if (FAIL != preprocessor_set_variant_result(request, &value, error))
+		preprocessor_enqueue_dependent(manager, &request->value, worker->task);
+
+	worker->task = NULL;
+	zbx_variant_clear(&value);
+
+	manager->preproc_num--;
+
+	preprocessor_assign_tasks(manager);
+	preprocessing_flush_queue(manager);
+
+	zbx_vector_ptr_destroy(&history);
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_add_batch_result                                    *
+ *                                                                            *
+ * Purpose: handle preprocessing result of batched requests                   *
+ *                                                                            *
+ * Parameters: manager - [IN] preprocessing manager                           *
+ *             client  - [IN] IPC client                                      *
+ *             message - [IN] packed preprocessing batch result               *
+ *                                                                            *
+ ******************************************************************************/
+static void	preprocessor_add_batch_result(zbx_preprocessing_manager_t *manager, zbx_ipc_client_t *client,
+		zbx_ipc_message_t *message)
+{
+	zbx_preprocessing_worker_t	*worker;
+	zbx_preprocessing_batch_t	*batch;
+	zbx_preprocessing_request_t	*request;
+	zbx_variant_t			*values;
+	char				**errors;
+	zbx_vector_ptr_t		history;
+	zbx_list_item_t			*node;
+	int				i, values_num;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	worker = preprocessor_get_worker_by_client(manager, client);
+	batch = (zbx_preprocessing_batch_t *)worker->task;
+
+	zbx_vector_ptr_create(&history);
+	zbx_preprocessor_unpack_batch_result(&values, &errors, &values_num, &history, message->data);
+
+	if (values_num != batch->nodes.values_num)
 	{
-		zbx_vector_ptr_clear_ext(&vault->history, (zbx_clean_func_t)zbx_preproc_op_history_free);
+		THIS_SHOULD_NEVER_HAPPEN;
+		exit(EXIT_FAILURE);
 	}
 
-	if (0 != history.values_num)
+	request = (zbx_preprocessing_request_t *)((zbx_list_item_t *)batch->nodes.values[0])->data;
+	preprocessor_store_history(manager, request->value.itemid, &history);
+
+	for (i = 0; i < values_num; i++)
 	{
-		if (NULL == vault)
-		{
-			zbx_preproc_history_t	history_local;
+		node = (zbx_list_item_t *)batch->nodes.values[i];
+		request = (zbx_preprocessing_request_t *)node->data;
 
-			history_local.itemid = request->value.itemid;
-			vault = (zbx_preproc_history_t *)zbx_hashset_insert(&manager->history_cache, &history_local,
-					sizeof(history_local));
-			zbx_vector_ptr_create(&vault->history);
-		}
+		preprocessor_set_request_state_done(manager, request, node);
 
-		zbx_vector_ptr_append_array(&vault->history, history.values, history.values_num);
-		zbx_vector_ptr_clear(&history);
-	}
-	else
-	{
-		if (NULL != vault)
-		{
-			zbx_vector_ptr_destroy(&vault->history);
-			zbx_hashset_remove_direct(&manager->history_cache, vault);
-		}
-	}
+		/* the pending request is part of this batch and is already processed */
+		if (NULL != request->pending && i + 1 < values_num)
+			request->pending->state = REQUEST_STATE_PROCESSING;
 
-	preprocessor_set_request_state_done(manager, request, worker->task);
+		if (FAIL != preprocessor_set_variant_result(request, &values[i], errors[i]))
+			preprocessor_enqueue_dependent(manager, &request->value, node);
 
-	if (FAIL != preprocessor_set_variant_result(request, &value, error))
-		preprocessor_enqueue_dependent(manager, &request->value, worker->task);
+		zbx_variant_clear(&values[i]);
+
+		manager->preproc_num--;
+	}
 
 	worker->task = NULL;
-	zbx_variant_clear(&value);
 
-	manager->preproc_num--;
+	zbx_vector_ptr_destroy(&batch->nodes);
+	zbx_free(batch);
+	zbx_free(values);
+	zbx_free(errors);
 
 	preprocessor_assign_tasks(manager);
 	preprocessing_flush_queue(manager);
@@ -1504,7 +1862,7 @@ ZBX_THREAD_ENTRY(preprocessing_manager_thread, args)
 
 	update_selfmon_counter(ZBX_PROCESS_STATE_BUSY);
 
-	if (FAIL == zbx_ipc_service_start(&service, ZBX_IPC_SERVICE_PREPROCESSING, &error))
+	if (FAIL == zbx_ipc_service_start(&service, zbx_preprocessor_get_service_name(process_num - 1), &error))
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "cannot start preprocessing service: %s", error);
 		zbx_free(error);
@@ -1512,6 +1870,7 @@ ZBX_THREAD_ENTRY(preprocessing_manager_thread, args)
 	}
 
 	preprocessor_init_manager(&manager);
+	manager.index = process_num - 1;
 
 	/* initialize statistics */
 	time_stat = zbx_time();
@@ -1554,9 +1913,21 @@ ZBX_THREAD_ENTRY(preprocessing_manager_thread, args)
 				case ZBX_IPC_PREPROCESSOR_REQUEST:
 					preprocessor_add_request(&manager, message);
 					break;
+				case ZBX_IPC_PREPROCESSOR_RING_NOTIFY:
+					preprocessor_add_ring_request(&manager);
+					break;
+				case ZBX_IPC_PREPROCESSOR_RING_REQUEST:
+					/* the sender has waited until its ring slots were read, acknowledge the */
+					/* values being queued so it can continue writing into the ring          */
+					preprocessor_add_request(&manager, message);
+					zbx_ipc_client_send(client, message->code, NULL, 0);
+					break;
 				case ZBX_IPC_PREPROCESSOR_RESULT:
 					preprocessor_add_result(&manager, client, message);
 					break;
+				case ZBX_IPC_PREPROCESSOR_BATCH_RESULT:
+					preprocessor_add_batch_result(&manager, client, message);
+					break;
 				case ZBX_IPC_PREPROCESSOR_QUEUE:
 					zbx_ipc_client_send(client, message->code, (unsigned char *)&manager.queued_num,
 							sizeof(zbx_uint64_t));
@@ -0,0 +1,472 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "log.h"
+#include "memalloc.h"
+#include "preproc.h"
+
+#include "preproc_ring.h"
+
+/*
+ * Bounded multi-producer, single-consumer rings of fixed size slots in shared memory, one per preprocessing
+ * manager instance.
+ *
+ * Producers (pollers, trappers) reserve a slot by advancing enqueue position with compare-and-swap, copy
+ * packed item values into the slot and publish it by setting slot sequence number to position + 1. The
+ * consumer (preprocessing manager) reads published slots in order and frees them by setting sequence number
+ * to position + slots_num, making the slot available for the next lap. The consumer never waits for slots
+ * being written, it stops at the first unpublished slot and continues when notified again.
+ *
+ * The consumer is woken up over preprocessing service socket. Only the producer which raises notify flag
+ * sends the wakeup message, the flag is reset by consumer before it starts reading the ring.
+ *
+ * When the ring cannot be used (full or the data does not fit into a slot) the producer waits until the
+ * consumer has read all slots it wrote before sending the values over socket, so values of one producer are
+ * queued in the order they were sent.
+ */
+
+extern zbx_uint64_t	CONFIG_PREPROCESSOR_RING_SIZE;
+extern int		CONFIG_PREPROCMAN_FORKS;
+
+#ifdef HAVE_ATOMIC_BUILTINS
+typedef struct
+{
+	zbx_uint64_t	seq;
+	zbx_uint32_t	size;
+}
+zbx_preproc_ring_slot_t;
+
+typedef struct
+{
+	zbx_uint64_t	enqueue_pos;
+	zbx_uint64_t	dequeue_pos;
+	zbx_uint64_t	slots_num;
+	int		notify;
+	unsigned char	*slots;
+}
+zbx_preproc_ring_t;
+
+static zbx_mem_info_t		*ring_mem = NULL;
+static zbx_preproc_ring_t	*rings = NULL;
+
+/* the enqueue positions following the last slots written by this process, per ring */
+static zbx_uint64_t		*rings_written = NULL;
+
+#define PREPROC_RING_SLOT_DATA_SIZE	(ZBX_PREPROC_RING_SLOT_SIZE - sizeof(zbx_preproc_ring_slot_t))
+
+static zbx_preproc_ring_slot_t	*preproc_ring_get_slot(const zbx_preproc_ring_t *ring, zbx_uint64_t pos)
+{
+	return (zbx_preproc_ring_slot_t *)(ring->slots + (pos & (ring->slots_num - 1)) * ZBX_PREPROC_RING_SLOT_SIZE);
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_preprocessor_ring_init                                       *
+ *                                                                            *
+ * Purpose: allocates shared memory rings used to pass item values to         *
+ *          preprocessing managers                                            *
+ *                                                                            *
+ * Parameters: error - [OUT] the error message                                *
+ *                                                                            *
+ * Return value: SUCCEED - the rings were allocated or are disabled           *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_preprocessor_ring_init(char **error)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	zbx_uint64_t		i, size, slots_num;
+	zbx_preproc_ring_slot_t	*slot;
+	zbx_preproc_ring_t	*ring;
+	int			j;
+#endif
+	int			ret = FAIL;
+
+	if (0 == CONFIG_PREPROCESSOR_RING_SIZE)
+		return SUCCEED;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+#ifdef HAVE_ATOMIC_BUILTINS
+	if (SUCCEED != zbx_mem_create(&ring_mem, CONFIG_PREPROCESSOR_RING_SIZE, "preprocessing ring size",
+			"PreprocessingRingSize", 1, error))
+	{
+		goto out;
+	}
+
+	if (NULL == (rings = (zbx_preproc_ring_t *)zbx_mem_malloc(ring_mem, NULL,
+			sizeof(zbx_preproc_ring_t) * CONFIG_PREPROCMAN_FORKS)))
+	{
+		*error = zbx_strdup(*error, "cannot allocate preprocessing ring header");
+		goto out;
+	}
+
+	memset(rings, 0, sizeof(zbx_preproc_ring_t) * CONFIG_PREPROCMAN_FORKS);
+
+	/* leave room for allocator chunk overhead */
+	size = (ring_mem->free_size - (CONFIG_PREPROCMAN_FORKS + 1) * 2 * MEM_MIN_ALLOC) / CONFIG_PREPROCMAN_FORKS;
+
+	for (slots_num = 1; slots_num * 2 * ZBX_PREPROC_RING_SLOT_SIZE <= size; slots_num *= 2)
+		;
+
+	if (2 > slots_num)
+	{
+		*error = zbx_dsprintf(*error, "\"PreprocessingRingSize\" must be large enough to hold at least two "
+				ZBX_FS_UI64 " byte slots per preprocessing manager",
+				(zbx_uint64_t)ZBX_PREPROC_RING_SLOT_SIZE);
+		goto out;
+	}
+
+	for (j = 0; j < CONFIG_PREPROCMAN_FORKS; j++)
+	{
+		ring = &rings[j];
+		ring->slots_num = slots_num;
+
+		if (NULL == (ring->slots = (unsigned char *)zbx_mem_malloc(ring_mem, NULL,
+				ring->slots_num * ZBX_PREPROC_RING_SLOT_SIZE)))
+		{
+			*error = zbx_strdup(*error, "cannot allocate preprocessing ring slots");
+			goto out;
+		}
+
+		for (i = 0; i < ring->slots_num; i++)
+		{
+			slot = preproc_ring_get_slot(ring, i);
+			slot->seq = i;
+			slot->size = 0;
+		}
+	}
+
+	/* allocated in private memory, so each forked process tracks its own writes */
+	rings_written = (zbx_uint64_t *)zbx_calloc(NULL, (size_t)CONFIG_PREPROCMAN_FORKS, sizeof(zbx_uint64_t));
+
+	zabbix_log(LOG_LEVEL_DEBUG, "%s() rings:%d slots:" ZBX_FS_UI64, __func__, CONFIG_PREPROCMAN_FORKS, slots_num);
+
+	ret = SUCCEED;
+out:
+	if (SUCCEED != ret)
+		rings = NULL;
+#else
+	zabbix_log(LOG_LEVEL_WARNING, "preprocessing ring is not supported on this platform, \"PreprocessingRingSize\""
+			" configuration parameter is ignored");
+	ret = SUCCEED;
+#endif
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_reserve                                             *
+ *                                                                            *
+ * Purpose: reserves ring slot for writing                                    *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index                   *
+ *             size  - [IN] the size of data to write                         *
+ *             pos   - [OUT] the reserved slot position                       *
+ *             data  - [OUT] the slot data buffer                             *
+ *                                                                            *
+ * Return value: SUCCEED - the slot was reserved, it must be published with   *
+ *                         preproc_ring_publish()                             *
+ *               FAIL    - the ring is disabled, full or the data does not    *
+ *                         fit into a slot                                    *
+ *                                                                            *
+ * Comments: The consumer cannot read slots following a reserved slot until   *
+ *           it is published.                                                 *
+ *                                                                            *
+ ******************************************************************************/
+int	preproc_ring_reserve(int index, zbx_uint32_t size, zbx_uint64_t *pos, unsigned char **data)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	zbx_uint64_t		seq;
+	zbx_preproc_ring_slot_t	*slot;
+	zbx_preproc_ring_t	*ring;
+
+	if (NULL == rings || PREPROC_RING_SLOT_DATA_SIZE < size)
+		return FAIL;
+
+	ring = &rings[index];
+
+	*pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+
+	for (;;)
+	{
+		slot = preproc_ring_get_slot(ring, *pos);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if (seq == *pos)
+		{
+			/* on failure pos is updated with the current enqueue position */
+			if (0 != __atomic_compare_exchange_n(&ring->enqueue_pos, pos, *pos + 1, 0, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (seq < *pos)
+		{
+			/* slot was not yet released by the consumer after the previous lap */
+			return FAIL;
+		}
+		else
+			*pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+	}
+
+	*data = (unsigned char *)slot + sizeof(zbx_preproc_ring_slot_t);
+
+	return SUCCEED;
+#else
+	ZBX_UNUSED(index);
+	ZBX_UNUSED(size);
+	ZBX_UNUSED(pos);
+	ZBX_UNUSED(data);
+
+	return FAIL;
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_publish                                             *
+ *                                                                            *
+ * Purpose: makes the reserved slot available to the consumer                 *
+ *                                                                            *
+ * Parameters: index  - [IN] the preprocessing manager index                  *
+ *             pos    - [IN] the reserved slot position                       *
+ *             size   - [IN] the size of data written into the slot           *
+ *             notify - [OUT] 1 - preprocessing manager must be notified      *
+ *                            0 - notification is already pending             *
+ *                                                                            *
+ ******************************************************************************/
+void	preproc_ring_publish(int index, zbx_uint64_t pos, zbx_uint32_t size, int *notify)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	zbx_preproc_ring_t	*ring = &rings[index];
+	zbx_preproc_ring_slot_t	*slot;
+
+	slot = preproc_ring_get_slot(ring, pos);
+	slot->size = size;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	if (rings_written[index] < pos + 1)
+		rings_written[index] = pos + 1;
+
+	/* pairs with the fence in preproc_ring_reset_notify() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	*notify = (0 == __atomic_exchange_n(&ring->notify, 1, __ATOMIC_SEQ_CST));
+#else
+	ZBX_UNUSED(index);
+	ZBX_UNUSED(pos);
+	ZBX_UNUSED(size);
+	ZBX_UNUSED(notify);
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_write                                               *
+ *                                                                            *
+ * Purpose: writes packed item values into the ring                           *
+ *                                                                            *
+ * Parameters: index  - [IN] the preprocessing manager index                  *
+ *             data   - [IN] the packed item values                           *
+ *             size   - [IN] the packed data size                             *
+ *             notify - [OUT] 1 - preprocessing manager must be notified      *
+ *                            0 - notification is already pending             *
+ *                                                                            *
+ * Return value: SUCCEED - the data was written into the ring                 *
+ *               FAIL    - the ring is disabled, full or the data does not    *
+ *                         fit into a slot; data must be sent over socket     *
+ *                                                                            *
+ ******************************************************************************/
+int	preproc_ring_write(int index, const unsigned char *data, zbx_uint32_t size, int *notify)
+{
+	zbx_uint64_t	pos;
+	unsigned char	*slot_data;
+
+	if (SUCCEED != preproc_ring_reserve(index, size, &pos, &slot_data))
+		return FAIL;
+
+	memcpy(slot_data, data, size);
+	preproc_ring_publish(index, pos, size, notify);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_drained                                             *
+ *                                                                            *
+ * Purpose: checks if the consumer has read all slots written by this process *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index                   *
+ *                                                                            *
+ * Return value: SUCCEED - all slots written by this process were read or the *
+ *                         ring is disabled                                   *
+ *               FAIL    - otherwise                                          *
+ *                                                                            *
+ ******************************************************************************/
+int	preproc_ring_drained(int index)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	if (NULL == rings)
+		return SUCCEED;
+
+	if (rings_written[index] > __atomic_load_n(&rings[index].dequeue_pos, __ATOMIC_ACQUIRE))
+		return FAIL;
+#else
+	ZBX_UNUSED(index);
+#endif
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_drain                                               *
+ *                                                                            *
+ * Purpose: waits until the consumer has read all slots written by this       *
+ *          process                                                           *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index                   *
+ *                                                                            *
+ * Return value: SUCCEED - the ring is enabled and was drained, values must   *
+ *                         be sent over socket with acknowledgement           *
+ *               FAIL    - the ring is disabled                               *
+ *                                                                            *
+ * Comments: The producer waits instead of the preprocessing manager. The     *
+ *           manager is already notified about the slots written by this      *
+ *           process, so the wait lasts until it reads them.                  *
+ *                                                                            *
+ ******************************************************************************/
+int	preproc_ring_drain(int index)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	struct timespec	ts = {0, 100000};
+
+	if (NULL == rings)
+		return FAIL;
+
+	while (SUCCEED != preproc_ring_drained(index))
+		nanosleep(&ts, NULL);
+
+	return SUCCEED;
+#else
+	ZBX_UNUSED(index);
+
+	return FAIL;
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_read                                                *
+ *                                                                            *
+ * Purpose: gets the next published slot from the ring                        *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index                   *
+ *             data  - [OUT] the packed item values                           *
+ *             size  - [OUT] the packed data size                             *
+ *                                                                            *
+ * Return value: SUCCEED - the data was read, it is valid until               *
+ *                         preproc_ring_release() is called                   *
+ *               FAIL    - the ring is empty, disabled or the next slot is    *
+ *                         not yet published                                  *
+ *                                                                            *
+ * Comments: The producer of unpublished slot notifies preprocessing manager  *
+ *           after publishing it, unless notification is already pending.     *
+ *                                                                            *
+ ******************************************************************************/
+int	preproc_ring_read(int index, unsigned char **data, zbx_uint32_t *size)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	zbx_preproc_ring_slot_t	*slot;
+	zbx_preproc_ring_t	*ring;
+
+	if (NULL == rings)
+		return FAIL;
+
+	ring = &rings[index];
+	slot = preproc_ring_get_slot(ring, ring->dequeue_pos);
+
+	if (ring->dequeue_pos + 1 != __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE))
+		return FAIL;
+
+	*data = (unsigned char *)slot + sizeof(zbx_preproc_ring_slot_t);
+	*size = slot->size;
+
+	return SUCCEED;
+#else
+	ZBX_UNUSED(index);
+	ZBX_UNUSED(data);
+	ZBX_UNUSED(size);
+
+	return FAIL;
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_release                                             *
+ *                                                                            *
+ * Purpose: releases the slot returned by preproc_ring_read() for reuse       *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index                   *
+ *                                                                            *
+ ******************************************************************************/
+void	preproc_ring_release(int index)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	zbx_preproc_ring_slot_t	*slot;
+	zbx_preproc_ring_t	*ring = &rings[index];
+
+	slot = preproc_ring_get_slot(ring, ring->dequeue_pos);
+	__atomic_store_n(&slot->seq, ring->dequeue_pos + ring->slots_num, __ATOMIC_RELEASE);
+
+	/* producers waiting in preproc_ring_drain() read the dequeue position */
+	__atomic_store_n(&ring->dequeue_pos, ring->dequeue_pos + 1, __ATOMIC_RELEASE);
+#else
+	ZBX_UNUSED(index);
+#endif
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preproc_ring_reset_notify                                        *
+ *                                                                            *
+ * Purpose: resets notify flag before reading the ring, so the next producer  *
+ *          writing into the ring will send notification                      *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index                   *
+ *                                                                            *
+ ******************************************************************************/
+void	preproc_ring_reset_notify(int index)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+	if (NULL == rings)
+		return;
+
+	__atomic_store_n(&rings[index].notify, 0, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+	ZBX_UNUSED(index);
+#endif
+}
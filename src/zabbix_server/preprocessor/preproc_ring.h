@@ -0,0 +1,37 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef ZABBIX_PREPROC_RING_H
+#define ZABBIX_PREPROC_RING_H
+
+#include "common.h"
+
+/* ring slot size, including slot header */
+#define ZBX_PREPROC_RING_SLOT_SIZE	(64 * ZBX_KIBIBYTE)
+
+int	preproc_ring_reserve(int index, zbx_uint32_t size, zbx_uint64_t *pos, unsigned char **data);
+void	preproc_ring_publish(int index, zbx_uint64_t pos, zbx_uint32_t size, int *notify);
+int	preproc_ring_write(int index, const unsigned char *data, zbx_uint32_t size, int *notify);
+int	preproc_ring_drained(int index);
+int	preproc_ring_drain(int index);
+int	preproc_ring_read(int index, unsigned char **data, zbx_uint32_t *size);
+void	preproc_ring_release(int index);
+void	preproc_ring_reset_notify(int index);
+
+#endif
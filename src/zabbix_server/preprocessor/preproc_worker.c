@@ -32,7 +32,7 @@
 #include "preproc_history.h"
 
 extern unsigned char	process_type, program_type;
-extern int		server_num, process_num;
+extern int		server_num, process_num, CONFIG_PREPROCMAN_FORKS;
 
 #define ZBX_PREPROC_VALUE_PREVIEW_LEN		100
 
@@ -275,60 +275,93 @@ static int	worker_item_preproc_execute(unsigned char value_type, zbx_variant_t *
 
 /******************************************************************************
  *                                                                            *
- * Function: worker_preprocess_value                                          *
+ * Function: worker_preprocess_item_value                                     *
  *                                                                            *
- * Purpose: handle item value preprocessing task                              *
+ * Purpose: execute preprocessing steps and format error message on failure   *
  *                                                                            *
- * Parameters: socket  - [IN] IPC socket                                      *
- *             message - [IN] packed preprocessing task                       *
+ * Parameters: value_type    - [IN] the item value type                       *
+ *             value         - [IN/OUT] the value to process                  *
+ *             ts            - [IN] the value timestamp                       *
+ *             steps         - [IN] the preprocessing steps to execute        *
+ *             steps_num     - [IN] the number of preprocessing steps         *
+ *             history_in    - [IN] the preprocessing history                 *
+ *             history_out   - [OUT] the new preprocessing history            *
+ *             error         - [OUT] error message                            *
  *                                                                            *
  ******************************************************************************/
-static void	worker_preprocess_value(zbx_ipc_socket_t *socket, zbx_ipc_message_t *message)
+static void	worker_preprocess_item_value(unsigned char value_type, zbx_variant_t *value, const zbx_timespec_t *ts,
+		zbx_preproc_op_t *steps, int steps_num, zbx_vector_ptr_t *history_in, zbx_vector_ptr_t *history_out,
+		char **error)
 {
-	zbx_uint32_t		size = 0;
-	unsigned char		*data = NULL, value_type;
-	zbx_uint64_t		itemid;
-	zbx_variant_t		value, value_start;
-	int			i, steps_num, results_num, ret;
-	char			*errmsg = NULL, *error = NULL;
-	zbx_timespec_t		*ts;
-	zbx_preproc_op_t	*steps;
-	zbx_vector_ptr_t	history_in, history_out;
+	zbx_variant_t		value_start;
+	int			i, results_num, ret;
+	char			*errmsg = NULL;
 	zbx_preproc_result_t	*results;
 
-	zbx_vector_ptr_create(&history_in);
-	zbx_vector_ptr_create(&history_out);
-
-	zbx_preprocessor_unpack_task(&itemid, &value_type, &ts, &value, &history_in, &steps, &steps_num,
-			message->data);
-
-	zbx_variant_copy(&value_start, &value);
+	zbx_variant_copy(&value_start, value);
 	results = (zbx_preproc_result_t *)zbx_malloc(NULL, sizeof(zbx_preproc_result_t) * steps_num);
 	memset(results, 0, sizeof(zbx_preproc_result_t) * steps_num);
 
-	if (FAIL == (ret = worker_item_preproc_execute(value_type, &value, ts, steps, steps_num, &history_in,
-			&history_out, results, &results_num, &errmsg)) && 0 != results_num)
+	if (FAIL == (ret = worker_item_preproc_execute(value_type, value, ts, steps, steps_num, history_in,
+			history_out, results, &results_num, &errmsg)) && 0 != results_num)
 	{
 		int action = results[results_num - 1].action;
 
 		if (ZBX_PREPROC_FAIL_SET_ERROR != action && ZBX_PREPROC_FAIL_FORCE_ERROR != action)
 		{
-			worker_format_error(&value_start, results, results_num, errmsg, &error);
+			worker_format_error(&value_start, results, results_num, errmsg, error);
 			zbx_free(errmsg);
 		}
 		else
-			error = errmsg;
+			*error = errmsg;
 	}
 
 	if (SUCCEED == ZBX_CHECK_LOG_LEVEL(LOG_LEVEL_DEBUG))
 	{
 		const char	*result;
 
-		result = (SUCCEED == ret ? zbx_variant_value_desc(&value) : error);
+		result = (SUCCEED == ret ? zbx_variant_value_desc(value) : *error);
 		zabbix_log(LOG_LEVEL_DEBUG, "%s(): %s", __func__, zbx_variant_value_desc(&value_start));
 		zabbix_log(LOG_LEVEL_DEBUG, "%s: %s %s",__func__, zbx_result_string(ret), result);
 	}
 
+	zbx_variant_clear(&value_start);
+
+	for (i = 0; i < results_num; i++)
+		zbx_variant_clear(&results[i].value);
+	zbx_free(results);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: worker_preprocess_value                                          *
+ *                                                                            *
+ * Purpose: handle item value preprocessing task                              *
+ *                                                                            *
+ * Parameters: socket  - [IN] IPC socket                                      *
+ *             message - [IN] packed preprocessing task                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	worker_preprocess_value(zbx_ipc_socket_t *socket, zbx_ipc_message_t *message)
+{
+	zbx_uint32_t		size = 0;
+	unsigned char		*data = NULL, value_type;
+	zbx_uint64_t		itemid;
+	zbx_variant_t		value;
+	int			steps_num;
+	char			*error = NULL;
+	zbx_timespec_t		*ts;
+	zbx_preproc_op_t	*steps;
+	zbx_vector_ptr_t	history_in, history_out;
+
+	zbx_vector_ptr_create(&history_in);
+	zbx_vector_ptr_create(&history_out);
+
+	zbx_preprocessor_unpack_task(&itemid, &value_type, &ts, &value, &history_in, &steps, &steps_num,
+			message->data);
+
+	worker_preprocess_item_value(value_type, &value, ts, steps, steps_num, &history_in, &history_out, &error);
+
 	size = zbx_preprocessor_pack_result(&data, &value, &history_out, error);
 	zbx_variant_clear(&value);
 	zbx_free(error);
@@ -343,13 +376,82 @@ static void	worker_preprocess_value(zbx_ipc_socket_t *socket, zbx_ipc_message_t
 
 	zbx_free(data);
 
-	zbx_variant_clear(&value_start);
+	zbx_vector_ptr_clear_ext(&history_out, (zbx_clean_func_t)zbx_preproc_op_history_free);
+	zbx_vector_ptr_destroy(&history_out);
 
-	for (i = 0; i < results_num; i++)
-		zbx_variant_clear(&results[i].value);
-	zbx_free(results);
+	zbx_vector_ptr_clear_ext(&history_in, (zbx_clean_func_t)zbx_preproc_op_history_free);
+	zbx_vector_ptr_destroy(&history_in);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: worker_preprocess_batch                                          *
+ *                                                                            *
+ * Purpose: handle preprocessing task for multiple values of the same item    *
+ *                                                                            *
+ * Parameters: socket  - [IN] IPC socket                                      *
+ *             message - [IN] packed preprocessing batch task                 *
+ *                                                                            *
+ * Comments: The values are processed in the received order with the same     *
+ *           steps, the history produced by one value is used as input        *
+ *           history for the next value.                                      *
+ *                                                                            *
+ ******************************************************************************/
+static void	worker_preprocess_batch(zbx_ipc_socket_t *socket, zbx_ipc_message_t *message)
+{
+	zbx_uint32_t		size = 0;
+	unsigned char		*data = NULL, value_type;
+	zbx_uint64_t		itemid;
+	zbx_variant_t		*values;
+	int			i, steps_num, values_num;
+	char			**errors;
+	zbx_timespec_t		**ts;
+	zbx_preproc_op_t	*steps;
+	zbx_vector_ptr_t	history_in, history_out;
+
+	zbx_vector_ptr_create(&history_in);
+	zbx_vector_ptr_create(&history_out);
+
+	zbx_preprocessor_unpack_batch_task(&itemid, &value_type, &ts, &values, &values_num, &history_in, &steps,
+			&steps_num, message->data);
+
+	errors = (char **)zbx_malloc(NULL, sizeof(char *) * values_num);
+
+	for (i = 0; i < values_num; i++)
+	{
+		errors[i] = NULL;
+
+		worker_preprocess_item_value(value_type, &values[i], ts[i], steps, steps_num, &history_in,
+				&history_out, &errors[i]);
+
+		/* history left from the steps that were not executed is dropped as with single value */
+		zbx_vector_ptr_clear_ext(&history_in, (zbx_clean_func_t)zbx_preproc_op_history_free);
+		zbx_vector_ptr_append_array(&history_in, history_out.values, history_out.values_num);
+		zbx_vector_ptr_clear(&history_out);
+	}
+
+	size = zbx_preprocessor_pack_batch_result(&data, values, errors, values_num, &history_in);
+
+	for (i = 0; i < values_num; i++)
+	{
+		zbx_variant_clear(&values[i]);
+		zbx_free(errors[i]);
+		zbx_free(ts[i]);
+	}
+
+	zbx_free(values);
+	zbx_free(errors);
+	zbx_free(ts);
+	zbx_free(steps);
+
+	if (FAIL == zbx_ipc_socket_write(socket, ZBX_IPC_PREPROCESSOR_BATCH_RESULT, data, size))
+	{
+		zabbix_log(LOG_LEVEL_CRIT, "cannot send preprocessing result");
+		exit(EXIT_FAILURE);
+	}
+
+	zbx_free(data);
 
-	zbx_vector_ptr_clear_ext(&history_out, (zbx_clean_func_t)zbx_preproc_op_history_free);
 	zbx_vector_ptr_destroy(&history_out);
 
 	zbx_vector_ptr_clear_ext(&history_in, (zbx_clean_func_t)zbx_preproc_op_history_free);
@@ -426,6 +528,7 @@ ZBX_THREAD_ENTRY(preprocessing_worker_thread, args)
 {
 	pid_t			ppid;
 	char			*error = NULL;
+	const char		*service;
 	zbx_ipc_socket_t	socket;
 	zbx_ipc_message_t	message;
 
@@ -439,9 +542,12 @@ ZBX_THREAD_ENTRY(preprocessing_worker_thread, args)
 
 	zbx_ipc_message_init(&message);
 
-	if (FAIL == zbx_ipc_socket_open(&socket, ZBX_IPC_SERVICE_PREPROCESSING, SEC_PER_MIN, &error))
+	/* workers are distributed evenly between preprocessing managers */
+	service = zbx_preprocessor_get_service_name((process_num - 1) % CONFIG_PREPROCMAN_FORKS);
+
+	if (FAIL == zbx_ipc_socket_open(&socket, service, SEC_PER_MIN, &error))
 	{
-		zabbix_log(LOG_LEVEL_CRIT, "cannot connect to preprocessing service: %s", error);
+		zabbix_log(LOG_LEVEL_CRIT, "cannot connect to preprocessing service \"%s\": %s", service, error);
 		zbx_free(error);
 		exit(EXIT_FAILURE);
 	}
@@ -474,6 +580,9 @@ ZBX_THREAD_ENTRY(preprocessing_worker_thread, args)
 			case ZBX_IPC_PREPROCESSOR_REQUEST:
 				worker_preprocess_value(&socket, &message);
 				break;
+			case ZBX_IPC_PREPROCESSOR_BATCH_REQUEST:
+				worker_preprocess_batch(&socket, &message);
+				break;
 			case ZBX_IPC_PREPROCESSOR_TEST_REQUEST:
 				worker_test_value(&socket, &message);
 				break;
@@ -27,6 +27,7 @@
 #include "preproc.h"
 #include "preprocessing.h"
 #include "preproc_history.h"
+#include "preproc_ring.h"
 
 #define PACKED_FIELD_RAW	0
 #define PACKED_FIELD_STRING	1
@@ -44,8 +45,11 @@ zbx_packed_field_t;
 #define PACKED_FIELD(value, size)	\
 		(zbx_packed_field_t){(value), (size), (0 == (size) ? PACKED_FIELD_STRING : PACKED_FIELD_RAW)};
 
-static zbx_ipc_message_t	cached_message;
-static int			cached_values;
+extern int	CONFIG_PREPROCMAN_FORKS;
+
+/* values cached for each preprocessing manager */
+static zbx_ipc_message_t	cached_messages[ZBX_PREPROCESSING_MANAGERS_MAX];
+static int			cached_values[ZBX_PREPROCESSING_MANAGERS_MAX];
 
 /******************************************************************************
  *                                                                            *
@@ -556,6 +560,130 @@ zbx_uint32_t	zbx_preprocessor_pack_result(unsigned char **data, zbx_variant_t *v
 	return size;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_preprocessor_pack_batch_task                                 *
+ *                                                                            *
+ * Purpose: pack preprocessing task for multiple values of the same item into *
+ *          a single buffer that can be used in IPC                           *
+ *                                                                            *
+ * Parameters: data          - [OUT] memory buffer for packed data            *
+ *             itemid        - [IN] item id                                   *
+ *             value_type    - [IN] item value type                           *
+ *             ts            - [IN] value timestamps (elements can be NULL)   *
+ *             values        - [IN] item values                               *
+ *             values_num    - [IN] item value count                          *
+ *             history       - [IN] history data (can be NULL)                *
+ *             steps         - [IN] preprocessing steps                       *
+ *             steps_num     - [IN] preprocessing step count                  *
+ *                                                                            *
+ * Return value: size of packed data                                          *
+ *                                                                            *
+ * Comments: The values are processed in the specified order, the history     *
+ *           produced by one value is used for the next value.                *
+ *                                                                            *
+ ******************************************************************************/
+zbx_uint32_t	zbx_preprocessor_pack_batch_task(unsigned char **data, zbx_uint64_t itemid, unsigned char value_type,
+		zbx_timespec_t **ts, zbx_variant_t *values, int values_num, const zbx_vector_ptr_t *history,
+		const zbx_preproc_op_t *steps, int steps_num)
+{
+	zbx_packed_field_t	*offset, *fields;
+	unsigned char		*ts_markers;
+	zbx_uint32_t		size;
+	int			i, history_num;
+	zbx_ipc_message_t	message;
+
+	history_num = (NULL != history ? history->values_num : 0);
+
+	/* 5 is a max field count (without value, preprocessing step and history fields), */
+	/* 5 is a max field count per value                                                */
+	fields = (zbx_packed_field_t *)zbx_malloc(NULL, (5 + values_num * 5 + steps_num * 4 + history_num * 5)
+			* sizeof(zbx_packed_field_t));
+	ts_markers = (unsigned char *)zbx_malloc(NULL, values_num);
+
+	offset = fields;
+
+	*offset++ = PACKED_FIELD(&itemid, sizeof(zbx_uint64_t));
+	*offset++ = PACKED_FIELD(&value_type, sizeof(unsigned char));
+	offset += preprocessor_pack_history(offset, history, &history_num);
+	offset += preprocessor_pack_steps(offset, steps, &steps_num);
+	*offset++ = PACKED_FIELD(&values_num, sizeof(int));
+
+	for (i = 0; i < values_num; i++)
+	{
+		ts_markers[i] = (NULL != ts[i]);
+		*offset++ = PACKED_FIELD(&ts_markers[i], sizeof(unsigned char));
+
+		if (NULL != ts[i])
+		{
+			*offset++ = PACKED_FIELD(&ts[i]->sec, sizeof(int));
+			*offset++ = PACKED_FIELD(&ts[i]->ns, sizeof(int));
+		}
+
+		offset += preprocessor_pack_variant(offset, &values[i]);
+	}
+
+	zbx_ipc_message_init(&message);
+	size = message_pack_data(&message, fields, offset - fields);
+	*data = message.data;
+	zbx_free(ts_markers);
+	zbx_free(fields);
+
+	return size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_preprocessor_pack_batch_result                               *
+ *                                                                            *
+ * Purpose: pack preprocessing results of multiple values into a single       *
+ *          buffer that can be used in IPC                                    *
+ *                                                                            *
+ * Parameters: data          - [OUT] memory buffer for packed data            *
+ *             values        - [IN] result values                             *
+ *             errors        - [IN] preprocessing errors (elements can be     *
+ *                                  NULL)                                     *
+ *             values_num    - [IN] result count                              *
+ *             history       - [IN] item history data after processing the    *
+ *                                  last value                                *
+ *                                                                            *
+ * Return value: size of packed data                                          *
+ *                                                                            *
+ ******************************************************************************/
+zbx_uint32_t	zbx_preprocessor_pack_batch_result(unsigned char **data, zbx_variant_t *values, char **errors,
+		int values_num, const zbx_vector_ptr_t *history)
+{
+	zbx_packed_field_t	*offset, *fields;
+	zbx_uint32_t		size;
+	zbx_ipc_message_t	message;
+	int			i, history_num;
+
+	history_num = history->values_num;
+
+	/* 3 is a max field count per value */
+	fields = (zbx_packed_field_t *)zbx_malloc(NULL, (2 + values_num * 3 + history_num * 5) *
+			sizeof(zbx_packed_field_t));
+	offset = fields;
+
+	*offset++ = PACKED_FIELD(&values_num, sizeof(int));
+
+	for (i = 0; i < values_num; i++)
+	{
+		offset += preprocessor_pack_variant(offset, &values[i]);
+		*offset++ = PACKED_FIELD(errors[i], 0);
+	}
+
+	offset += preprocessor_pack_history(offset, history, &history_num);
+
+	zbx_ipc_message_init(&message);
+	size = message_pack_data(&message, fields, offset - fields);
+	*data = message.data;
+
+	zbx_free(fields);
+
+	return size;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_preprocessor_pack_test_result                                *
@@ -859,6 +987,94 @@ void	zbx_preprocessor_unpack_result(zbx_variant_t *value, zbx_vector_ptr_t *hist
 	(void)zbx_deserialize_str(offset, error, value_len);
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_preprocessor_unpack_batch_task                               *
+ *                                                                            *
+ * Purpose: unpack preprocessing task for multiple values from IPC data       *
+ *          buffer                                                            *
+ *                                                                            *
+ * Parameters: itemid        - [OUT] itemid                                   *
+ *             value_type    - [OUT] item value type                          *
+ *             ts            - [OUT] value timestamps                         *
+ *             values        - [OUT] item values                              *
+ *             values_num    - [OUT] item value count                         *
+ *             history       - [OUT] history data                             *
+ *             steps         - [OUT] preprocessing steps                      *
+ *             steps_num     - [OUT] preprocessing step count                 *
+ *             data          - [IN] IPC data buffer                           *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_preprocessor_unpack_batch_task(zbx_uint64_t *itemid, unsigned char *value_type, zbx_timespec_t ***ts,
+		zbx_variant_t **values, int *values_num, zbx_vector_ptr_t *history, zbx_preproc_op_t **steps,
+		int *steps_num, const unsigned char *data)
+{
+	const unsigned char	*offset = data;
+	unsigned char		ts_marker;
+	int			i;
+
+	offset += zbx_deserialize_uint64(offset, itemid);
+	offset += zbx_deserialize_char(offset, value_type);
+	offset += preprocesser_unpack_history(offset, history);
+	offset += preprocessor_unpack_steps(offset, steps, steps_num);
+	offset += zbx_deserialize_int(offset, values_num);
+
+	*ts = (zbx_timespec_t **)zbx_malloc(NULL, sizeof(zbx_timespec_t *) * *values_num);
+	*values = (zbx_variant_t *)zbx_malloc(NULL, sizeof(zbx_variant_t) * *values_num);
+
+	for (i = 0; i < *values_num; i++)
+	{
+		offset += zbx_deserialize_char(offset, &ts_marker);
+
+		if (0 != ts_marker)
+		{
+			(*ts)[i] = (zbx_timespec_t *)zbx_malloc(NULL, sizeof(zbx_timespec_t));
+
+			offset += zbx_deserialize_int(offset, &(*ts)[i]->sec);
+			offset += zbx_deserialize_int(offset, &(*ts)[i]->ns);
+		}
+		else
+			(*ts)[i] = NULL;
+
+		offset += preprocesser_unpack_variant(offset, &(*values)[i]);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_preprocessor_unpack_batch_result                             *
+ *                                                                            *
+ * Purpose: unpack preprocessing results of multiple values from IPC data     *
+ *          buffer                                                            *
+ *                                                                            *
+ * Parameters: values        - [OUT] result values                            *
+ *             errors        - [OUT] preprocessing errors                     *
+ *             values_num    - [OUT] result count                             *
+ *             history       - [OUT] item history data                        *
+ *             data          - [IN] IPC data buffer                           *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_preprocessor_unpack_batch_result(zbx_variant_t **values, char ***errors, int *values_num,
+		zbx_vector_ptr_t *history, const unsigned char *data)
+{
+	zbx_uint32_t		value_len;
+	const unsigned char	*offset = data;
+	int			i;
+
+	offset += zbx_deserialize_int(offset, values_num);
+
+	*values = (zbx_variant_t *)zbx_malloc(NULL, sizeof(zbx_variant_t) * *values_num);
+	*errors = (char **)zbx_malloc(NULL, sizeof(char *) * *values_num);
+
+	for (i = 0; i < *values_num; i++)
+	{
+		offset += preprocesser_unpack_variant(offset, &(*values)[i]);
+		offset += zbx_deserialize_str(offset, &(*errors)[i], value_len);
+	}
+
+	(void)preprocesser_unpack_history(offset, history);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_preprocessor_unpack_test_result                              *
@@ -977,46 +1193,137 @@ void	zbx_preprocessor_unpack_top_result(zbx_vector_ptr_t *items, const unsigned
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_preprocessor_get_service_name                                *
+ *                                                                            *
+ * Purpose: gets IPC service name of the specified preprocessing manager      *
+ *                                                                            *
+ * Parameters: index - [IN] the preprocessing manager index (starting with 0) *
+ *                                                                            *
+ * Return value: the service name                                             *
+ *                                                                            *
+ * Comments: The first manager uses the default preprocessing service name.   *
+ *           The returned name is valid until the next call.                  *
+ *                                                                            *
+ ******************************************************************************/
+const char	*zbx_preprocessor_get_service_name(int index)
+{
+	static char	service[MAX_ID_LEN + sizeof(ZBX_IPC_SERVICE_PREPROCESSING) + 1];
+
+	if (0 == index)
+		return ZBX_IPC_SERVICE_PREPROCESSING;
+
+	zbx_snprintf(service, sizeof(service), "%s_%d", ZBX_IPC_SERVICE_PREPROCESSING, index + 1);
+
+	return service;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_get_manager_index                                   *
+ *                                                                            *
+ * Purpose: gets index of preprocessing manager owning the item               *
+ *                                                                            *
+ * Parameters: itemid - [IN] the item identifier                              *
+ *                                                                            *
+ * Return value: the preprocessing manager index                              *
+ *                                                                            *
+ * Comments: All values of an item (and its dependent items) are processed by *
+ *           the same manager to keep the value order.                        *
+ *                                                                            *
+ ******************************************************************************/
+static int	preprocessor_get_manager_index(zbx_uint64_t itemid)
+{
+	return (int)(itemid % (zbx_uint64_t)CONFIG_PREPROCMAN_FORKS);
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: preprocessor_send                                                *
  *                                                                            *
  * Purpose: sends command to preprocessor manager                             *
  *                                                                            *
- * Parameters: code     - [IN] message code                                   *
+ * Parameters: index    - [IN] preprocessing manager index                    *
+ *             code     - [IN] message code                                   *
  *             data     - [IN] message data                                   *
  *             size     - [IN] message data size                              *
  *             response - [OUT] response message (can be NULL if response is  *
  *                              not requested)                                *
  *                                                                            *
  ******************************************************************************/
-static void	preprocessor_send(zbx_uint32_t code, unsigned char *data, zbx_uint32_t size,
+static void	preprocessor_send(int index, zbx_uint32_t code, unsigned char *data, zbx_uint32_t size,
 		zbx_ipc_message_t *response)
 {
 	char			*error = NULL;
-	static zbx_ipc_socket_t	socket = {0};
+	static zbx_ipc_socket_t	sockets[ZBX_PREPROCESSING_MANAGERS_MAX];
+	zbx_ipc_socket_t	*socket = &sockets[index];
 
-	/* each process has a permanent connection to preprocessing manager */
-	if (0 == socket.fd && FAIL == zbx_ipc_socket_open(&socket, ZBX_IPC_SERVICE_PREPROCESSING, SEC_PER_MIN,
-			&error))
+	/* each process has a permanent connection to preprocessing managers */
+	if (0 == socket->fd && FAIL == zbx_ipc_socket_open(socket, zbx_preprocessor_get_service_name(index),
+			SEC_PER_MIN, &error))
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "cannot connect to preprocessing service: %s", error);
 		exit(EXIT_FAILURE);
 	}
 
-	if (FAIL == zbx_ipc_socket_write(&socket, code, data, size))
+	if (FAIL == zbx_ipc_socket_write(socket, code, data, size))
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "cannot send data to preprocessing service");
 		exit(EXIT_FAILURE);
 	}
 
-	if (NULL != response && FAIL == zbx_ipc_socket_read(&socket, response))
+	if (NULL != response && FAIL == zbx_ipc_socket_read(socket, response))
 	{
 		zabbix_log(LOG_LEVEL_CRIT, "cannot receive data from preprocessing service");
 		exit(EXIT_FAILURE);
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_flush_manager                                       *
+ *                                                                            *
+ * Purpose: send values cached for the specified manager                      *
+ *                                                                            *
+ * Parameters: index - [IN] preprocessing manager index                       *
+ *                                                                            *
+ * Comments: When preprocessing ring is enabled the cached values are written *
+ *           into the ring and only a wakeup is sent over socket if the       *
+ *           manager is not notified yet. If the ring is full or the values   *
+ *           do not fit into a slot, they are sent over socket after the      *
+ *           manager has read the values written into the ring before and     *
+ *           the next values are written only after the manager acknowledges  *
+ *           them, keeping the order of values sent by this process.          *
+ *                                                                            *
+ ******************************************************************************/
+static void	preprocessor_flush_manager(int index)
+{
+	zbx_ipc_message_t	*message = &cached_messages[index], response;
+	int			notify;
+
+	if (0 == message->size)
+		return;
+
+	if (SUCCEED == preproc_ring_write(index, message->data, message->size, &notify))
+	{
+		if (0 != notify)
+			preprocessor_send(index, ZBX_IPC_PREPROCESSOR_RING_NOTIFY, NULL, 0, NULL);
+	}
+	else if (SUCCEED == preproc_ring_drain(index))
+	{
+		zbx_ipc_message_init(&response);
+		preprocessor_send(index, ZBX_IPC_PREPROCESSOR_RING_REQUEST, message->data, message->size, &response);
+		zbx_ipc_message_clean(&response);
+	}
+	else
+		preprocessor_send(index, ZBX_IPC_PREPROCESSOR_REQUEST, message->data, message->size, NULL);
+
+	zbx_ipc_message_clean(message);
+	zbx_ipc_message_init(message);
+	cached_values[index] = 0;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_preprocess_item_value                                        *
@@ -1042,6 +1349,7 @@ void	zbx_preprocess_item_value(zbx_uint64_t itemid, zbx_uint64_t hostid, unsigne
 					.error = error, .item_flags = item_flags, .state = state, .ts = ts};
 	zbx_result_ptr_t		result_ptr = {.result = result};
 	size_t				value_len = 0, len;
+	int				index;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
@@ -1071,15 +1379,16 @@ void	zbx_preprocess_item_value(zbx_uint64_t itemid, zbx_uint64_t hostid, unsigne
 	}
 
 	value.result_ptr = &result_ptr;
+	index = preprocessor_get_manager_index(itemid);
 
-	if (0 == preprocessor_pack_value(&cached_message, &value))
+	if (0 == preprocessor_pack_value(&cached_messages[index], &value))
 	{
-		zbx_preprocessor_flush();
-		preprocessor_pack_value(&cached_message, &value);
+		preprocessor_flush_manager(index);
+		preprocessor_pack_value(&cached_messages[index], &value);
 	}
 
-	if (MAX_VALUES_LOCAL < ++cached_values)
-		zbx_preprocessor_flush();
+	if (MAX_VALUES_LOCAL < ++cached_values[index])
+		preprocessor_flush_manager(index);
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
@@ -1088,41 +1397,43 @@ void	zbx_preprocess_item_value(zbx_uint64_t itemid, zbx_uint64_t hostid, unsigne
  *                                                                            *
  * Function: zbx_preprocessor_flush                                           *
  *                                                                            *
- * Purpose: send flush command to preprocessing manager                       *
+ * Purpose: send flush command to preprocessing managers                      *
  *                                                                            *
  ******************************************************************************/
 void	zbx_preprocessor_flush(void)
 {
-	if (0 < cached_message.size)
-	{
-		preprocessor_send(ZBX_IPC_PREPROCESSOR_REQUEST, cached_message.data, cached_message.size, NULL);
+	int	i;
 
-		zbx_ipc_message_clean(&cached_message);
-		zbx_ipc_message_init(&cached_message);
-		cached_values = 0;
-	}
+	for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
+		preprocessor_flush_manager(i);
 }
 
 /******************************************************************************
  *                                                                            *
  * Function: zbx_preprocessor_get_queue_size                                  *
  *                                                                            *
- * Purpose: get queue size (enqueued value count) of preprocessing manager    *
+ * Purpose: get queue size (enqueued value count) of preprocessing managers   *
  *                                                                            *
  * Return value: enqueued item count                                          *
  *                                                                            *
  ******************************************************************************/
 zbx_uint64_t	zbx_preprocessor_get_queue_size(void)
 {
-	zbx_uint64_t		size;
+	zbx_uint64_t		size, total = 0;
 	zbx_ipc_message_t	message;
+	int			i;
 
-	zbx_ipc_message_init(&message);
-	preprocessor_send(ZBX_IPC_PREPROCESSOR_QUEUE, NULL, 0, &message);
-	memcpy(&size, message.data, sizeof(zbx_uint64_t));
-	zbx_ipc_message_clean(&message);
+	for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
+	{
+		zbx_ipc_message_init(&message);
+		preprocessor_send(i, ZBX_IPC_PREPROCESSOR_QUEUE, NULL, 0, &message);
+		memcpy(&size, message.data, sizeof(zbx_uint64_t));
+		zbx_ipc_message_clean(&message);
 
-	return size;
+		total += size;
+	}
+
+	return total;
 }
 
 /******************************************************************************
@@ -1270,48 +1581,130 @@ out:
  *                                                                            *
  * Purpose: get preprocessing manager diagnostic statistics                   *
  *                                                                            *
+ * Comments: statistics of all preprocessing managers are summed              *
+ *                                                                            *
  ******************************************************************************/
 int	zbx_preprocessor_get_diag_stats(int *total, int *queued, int *processing, int *done,
 		int *pending, char **error)
 {
 	unsigned char	*result;
+	int		i, m_total, m_queued, m_processing, m_done, m_pending;
 
-	if (SUCCEED != zbx_ipc_async_exchange(ZBX_IPC_SERVICE_PREPROCESSING, ZBX_IPC_PREPROCESSOR_DIAG_STATS,
-			SEC_PER_MIN, NULL, 0, &result, error))
+	*total = *queued = *processing = *done = *pending = 0;
+
+	for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
 	{
-		return FAIL;
-	}
+		if (SUCCEED != zbx_ipc_async_exchange(zbx_preprocessor_get_service_name(i),
+				ZBX_IPC_PREPROCESSOR_DIAG_STATS, SEC_PER_MIN, NULL, 0, &result, error))
+		{
+			return FAIL;
+		}
 
-	zbx_preprocessor_unpack_diag_stats(total, queued, processing, done, pending, result);
-	zbx_free(result);
+		zbx_preprocessor_unpack_diag_stats(&m_total, &m_queued, &m_processing, &m_done, &m_pending, result);
+		zbx_free(result);
+
+		*total += m_total;
+		*queued += m_queued;
+		*processing += m_processing;
+		*done += m_done;
+		*pending += m_pending;
+	}
 
 	return SUCCEED;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_preprocessor_get_top_items                                   *
+ * Function: preproc_item_stats_compare_by_values_desc                        *
  *                                                                            *
- * Purpose: get the top N items by the number of queued values                *
+ * Purpose: compare item statistics by queued value count                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	preproc_item_stats_compare_by_values_desc(const void *d1, const void *d2)
+{
+	const zbx_preproc_item_stats_t	*i1 = *(const zbx_preproc_item_stats_t * const *)d1;
+	const zbx_preproc_item_stats_t	*i2 = *(const zbx_preproc_item_stats_t * const *)d2;
+
+	return i2->values_num - i1->values_num;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: preprocessor_get_top_items                                       *
+ *                                                                            *
+ * Purpose: get the top N items from all preprocessing managers               *
+ *                                                                            *
+ * Parameters: limit - [IN] the number of items to return                     *
+ *             items - [OUT] the item statistics                              *
+ *             error - [OUT] the error message                                *
+ *             code  - [IN] the request code                                  *
  *                                                                            *
  ******************************************************************************/
 static int	preprocessor_get_top_items(int limit, zbx_vector_ptr_t *items, char **error, zbx_uint32_t code)
 {
-	int		ret;
-	unsigned char	*data, *result;
-	zbx_uint32_t	data_len;
+	int			ret = SUCCEED, i, j;
+	unsigned char		*data, *result;
+	zbx_uint32_t		data_len;
+	zbx_vector_ptr_t	manager_items[ZBX_PREPROCESSING_MANAGERS_MAX];
 
 	data_len = zbx_preprocessor_pack_top_items_request(&data, limit);
 
-	if (SUCCEED != (ret = zbx_ipc_async_exchange(ZBX_IPC_SERVICE_PREPROCESSING, code, SEC_PER_MIN, data, data_len,
-			&result, error)))
+	for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
+		zbx_vector_ptr_create(&manager_items[i]);
+
+	for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
 	{
-		goto out;
+		if (SUCCEED != (ret = zbx_ipc_async_exchange(zbx_preprocessor_get_service_name(i), code, SEC_PER_MIN,
+				data, data_len, &result, error)))
+		{
+			goto out;
+		}
+
+		zbx_preprocessor_unpack_top_result(&manager_items[i], result);
+		zbx_free(result);
 	}
 
-	zbx_preprocessor_unpack_top_result(items, result);
-	zbx_free(result);
+	if (ZBX_IPC_PREPROCESSOR_TOP_ITEMS == code)
+	{
+		for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
+		{
+			zbx_vector_ptr_append_array(items, manager_items[i].values, manager_items[i].values_num);
+			manager_items[i].values_num = 0;
+		}
+
+		zbx_vector_ptr_sort(items, preproc_item_stats_compare_by_values_desc);
+
+		while (limit < items->values_num)
+			zbx_free(items->values[--items->values_num]);
+	}
+	else
+	{
+		/* there is no common value age across managers, take the oldest items of each manager in turn */
+		for (j = 0; items->values_num < limit; j++)
+		{
+			int	added = 0;
+
+			for (i = 0; i < CONFIG_PREPROCMAN_FORKS && items->values_num < limit; i++)
+			{
+				if (j < manager_items[i].values_num)
+				{
+					zbx_vector_ptr_append(items, manager_items[i].values[j]);
+					manager_items[i].values[j] = NULL;
+					added++;
+				}
+			}
+
+			if (0 == added)
+				break;
+		}
+	}
 out:
+	for (i = 0; i < CONFIG_PREPROCMAN_FORKS; i++)
+	{
+		zbx_vector_ptr_clear_ext(&manager_items[i], zbx_ptr_free);
+		zbx_vector_ptr_destroy(&manager_items[i]);
+	}
+
 	zbx_free(data);
 
 	return ret;
@@ -39,6 +39,10 @@
 #define ZBX_IPC_PREPROCESSOR_TOP_ITEMS			9
 #define ZBX_IPC_PREPROCESSOR_TOP_ITEMS_RESULT		10
 #define ZBX_IPC_PREPROCESSOR_TOP_OLDEST_PREPROC_ITEMS	11
+#define ZBX_IPC_PREPROCESSOR_RING_NOTIFY		12
+#define ZBX_IPC_PREPROCESSOR_BATCH_REQUEST		13
+#define ZBX_IPC_PREPROCESSOR_BATCH_RESULT		14
+#define ZBX_IPC_PREPROCESSOR_RING_REQUEST		15
 
 typedef struct {
 	AGENT_RESULT	*result;
@@ -64,6 +68,11 @@ zbx_uint32_t	zbx_preprocessor_pack_task(unsigned char **data, zbx_uint64_t itemi
 		const zbx_preproc_op_t *steps, int steps_num);
 zbx_uint32_t	zbx_preprocessor_pack_result(unsigned char **data, zbx_variant_t *value,
 		const zbx_vector_ptr_t *history, char *error);
+zbx_uint32_t	zbx_preprocessor_pack_batch_task(unsigned char **data, zbx_uint64_t itemid, unsigned char value_type,
+		zbx_timespec_t **ts, zbx_variant_t *values, int values_num, const zbx_vector_ptr_t *history,
+		const zbx_preproc_op_t *steps, int steps_num);
+zbx_uint32_t	zbx_preprocessor_pack_batch_result(unsigned char **data, zbx_variant_t *values, char **errors,
+		int values_num, const zbx_vector_ptr_t *history);
 
 zbx_uint32_t	zbx_preprocessor_unpack_value(zbx_preproc_item_value_t *value, unsigned char *data);
 void	zbx_preprocessor_unpack_task(zbx_uint64_t *itemid, unsigned char *value_type, zbx_timespec_t **ts,
@@ -71,6 +80,11 @@ void	zbx_preprocessor_unpack_task(zbx_uint64_t *itemid, unsigned char *value_typ
 		int *steps_num, const unsigned char *data);
 void	zbx_preprocessor_unpack_result(zbx_variant_t *value, zbx_vector_ptr_t *history, char **error,
 		const unsigned char *data);
+void	zbx_preprocessor_unpack_batch_task(zbx_uint64_t *itemid, unsigned char *value_type, zbx_timespec_t ***ts,
+		zbx_variant_t **values, int *values_num, zbx_vector_ptr_t *history, zbx_preproc_op_t **steps,
+		int *steps_num, const unsigned char *data);
+void	zbx_preprocessor_unpack_batch_result(zbx_variant_t **values, char ***errors, int *values_num,
+		zbx_vector_ptr_t *history, const unsigned char *data);
 
 void	zbx_preprocessor_unpack_test_request(unsigned char *value_type, char **value, zbx_timespec_t *ts,
 		zbx_vector_ptr_t *history, zbx_preproc_op_t **steps, int *steps_num, const unsigned char *data);
@@ -96,4 +110,6 @@ zbx_uint32_t	zbx_preprocessor_pack_top_items_result(unsigned char **data, zbx_pr
 
 void	zbx_preprocessor_unpack_top_result(zbx_vector_ptr_t *items, const unsigned char *data);
 
+const char	*zbx_preprocessor_get_service_name(int index);
+
 #endif /* ZABBIX_PREPROCESSING_H */
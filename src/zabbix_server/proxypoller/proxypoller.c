@@ -91,7 +91,7 @@ static int	send_data_to_proxy(const DC_PROXY *proxy, zbx_socket_t *sock, const c
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s() data:'%s'", __func__, data);
 
 	if (0 != proxy->auto_compress)
-		flags |= ZBX_TCP_COMPRESS;
+		flags = zbx_proxy_compress_flags(proxy, 0);
 
 	if (FAIL == (ret = zbx_tcp_send_ext(sock, data, size, flags, 0)))
 	{
@@ -142,6 +142,7 @@ static void	disconnect_proxy(zbx_socket_t *sock)
  * Parameters: proxy   - [IN/OUT] proxy data                                  *
  *             request - [IN] requested data type                             *
  *             data    - [OUT] data received from proxy                       *
+ *             size    - [OUT] size of data received from proxy               *
  *             ts      - [OUT] timestamp when the proxy connection was        *
  *                             established                                    *
  *             tasks   - [IN] proxy task response flag                        *
@@ -150,10 +151,12 @@ static void	disconnect_proxy(zbx_socket_t *sock)
  *               other code - an error occurred                               *
  *                                                                            *
  * Comments: The proxy->compress property is updated depending on the         *
- *           protocol flags sent by proxy.                                    *
+ *           protocol flags sent by proxy and proxy->accept_codecs property   *
+ *           depending on the compression codecs advertised by proxy.         *
  *                                                                            *
  ******************************************************************************/
-static int	get_data_from_proxy(DC_PROXY *proxy, const char *request, char **data, zbx_timespec_t *ts)
+static int	get_data_from_proxy(DC_PROXY *proxy, const char *request, char **data, size_t *size,
+		zbx_timespec_t *ts)
 {
 	zbx_socket_t	s;
 	struct zbx_json	j;
@@ -165,6 +168,9 @@ static int	get_data_from_proxy(DC_PROXY *proxy, const char *request, char **data
 
 	zbx_json_addstring(&j, "request", request, ZBX_JSON_TYPE_STRING);
 
+	if (0 == strcmp(request, ZBX_PROTO_VALUE_PROXY_DATA))
+		zbx_proxy_add_history_format(proxy, &j);
+
 	if (SUCCEED == (ret = connect_to_proxy(proxy, &s, CONFIG_TRAPPER_TIMEOUT)))
 	{
 		/* get connection timestamp if required */
@@ -175,15 +181,22 @@ static int	get_data_from_proxy(DC_PROXY *proxy, const char *request, char **data
 		{
 			if (SUCCEED == (ret = recv_data_from_proxy(proxy, &s)))
 			{
+				struct zbx_json_parse	jp;
+
 				if (0 != (s.protocol & ZBX_TCP_COMPRESS))
 					proxy->auto_compress = 1;
 
+				if (SUCCEED == zbx_json_open(s.buffer, &jp))
+					proxy->accept_codecs = zbx_proxy_get_compression(&jp);
+				else
+					proxy->accept_codecs = 0;
+
 				if (!ZBX_IS_RUNNING())
 				{
 					int	flags = ZBX_TCP_PROTOCOL;
 
 					if (0 != (s.protocol & ZBX_TCP_COMPRESS))
-						flags |= ZBX_TCP_COMPRESS;
+						flags = zbx_tcp_compress_flags(s.protocol);
 
 					zbx_send_response_ext(&s, FAIL, "Zabbix server shutdown in progress", NULL,
 							flags, CONFIG_TIMEOUT);
@@ -194,10 +207,16 @@ static int	get_data_from_proxy(DC_PROXY *proxy, const char *request, char **data
 				}
 				else
 				{
-					ret = zbx_send_proxy_data_response(proxy, &s, NULL, ZBX_PROXY_UPLOAD_UNDEFINED);
+					ret = zbx_send_proxy_data_response(proxy, &s, NULL, ZBX_PROXY_UPLOAD_UNDEFINED, 0,
+							0);
 
+					/* copy the whole message, binary history data follows json */
 					if (SUCCEED == ret)
-						*data = zbx_strdup(*data, s.buffer);
+					{
+						*size = s.read_bytes;
+						*data = (char *)zbx_malloc(*data, *size + 1);
+						memcpy(*data, s.buffer, *size + 1);
+					}
 				}
 			}
 		}
@@ -295,6 +314,7 @@ out:
  *                                                                            *
  * Parameters: proxy  - [IN/OUT] proxy data                                   *
  *             answer - [IN] data received from proxy                         *
+ *             size   - [IN] size of data received from proxy                 *
  *             ts     - [IN] timestamp when the proxy connection was          *
  *                           established                                      *
  *             more   - [OUT] available data flag                             *
@@ -306,7 +326,8 @@ out:
  *           sent by proxy.                                                   *
  *                                                                            *
  ******************************************************************************/
-static int	proxy_process_proxy_data(DC_PROXY *proxy, const char *answer, zbx_timespec_t *ts, int *more)
+static int	proxy_process_proxy_data(DC_PROXY *proxy, const char *answer, size_t size, zbx_timespec_t *ts,
+		int *more)
 {
 	struct zbx_json_parse	jp;
 	char			*error = NULL;
@@ -339,7 +360,8 @@ static int	proxy_process_proxy_data(DC_PROXY *proxy, const char *answer, zbx_tim
 
 	proxy->version = version;
 
-	if (SUCCEED != (ret = process_proxy_data(proxy, &jp, ts, HOST_STATUS_PROXY_PASSIVE, more, &error)))
+	if (SUCCEED != (ret = process_proxy_data(proxy, &jp, answer, size, ts, HOST_STATUS_PROXY_PASSIVE, more,
+			&error)))
 	{
 		zabbix_log(LOG_LEVEL_WARNING, "proxy \"%s\" at \"%s\" returned invalid proxy data: %s",
 				proxy->host, proxy->addr, error);
@@ -372,12 +394,13 @@ out:
 static int	proxy_get_data(DC_PROXY *proxy, int *more)
 {
 	char		*answer = NULL;
+	size_t		size;
 	int		ret;
 	zbx_timespec_t	ts;
 
 	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
 
-	if (SUCCEED != (ret = get_data_from_proxy(proxy, ZBX_PROTO_VALUE_PROXY_DATA, &answer, &ts)))
+	if (SUCCEED != (ret = get_data_from_proxy(proxy, ZBX_PROTO_VALUE_PROXY_DATA, &answer, &size, &ts)))
 		goto out;
 
 	/* handle pre 3.4 proxies that did not support proxy data request */
@@ -390,7 +413,7 @@ static int	proxy_get_data(DC_PROXY *proxy, int *more)
 	}
 
 	proxy->lastaccess = time(NULL);
-	ret = proxy_process_proxy_data(proxy, answer, &ts, more);
+	ret = proxy_process_proxy_data(proxy, answer, size, &ts, more);
 	zbx_free(answer);
 out:
 	if (SUCCEED == ret)
@@ -419,6 +442,7 @@ out:
 static int	proxy_get_tasks(DC_PROXY *proxy)
 {
 	char		*answer = NULL;
+	size_t		size;
 	int		ret = FAIL, more;
 	zbx_timespec_t	ts;
 
@@ -427,12 +451,12 @@ static int	proxy_get_tasks(DC_PROXY *proxy)
 	if (ZBX_COMPONENT_VERSION(3, 2) >= proxy->version)
 		goto out;
 
-	if (SUCCEED != (ret = get_data_from_proxy(proxy, ZBX_PROTO_VALUE_PROXY_TASKS, &answer, &ts)))
+	if (SUCCEED != (ret = get_data_from_proxy(proxy, ZBX_PROTO_VALUE_PROXY_TASKS, &answer, &size, &ts)))
 		goto out;
 
 	proxy->lastaccess = time(NULL);
 
-	ret = proxy_process_proxy_data(proxy, answer, &ts, &more);
+	ret = proxy_process_proxy_data(proxy, answer, size, &ts, &more);
 
 	zbx_free(answer);
 out:
@@ -533,9 +557,11 @@ static int	process_proxy(void)
 		}
 error:
 		if (proxy_old.version != proxy.version || proxy_old.auto_compress != proxy.auto_compress ||
+				proxy_old.accept_codecs != proxy.accept_codecs ||
 				proxy_old.lastaccess != proxy.lastaccess)
 		{
-			zbx_update_proxy_data(&proxy_old, proxy.version, proxy.lastaccess, proxy.auto_compress, 0);
+			zbx_update_proxy_data(&proxy_old, proxy.version, proxy.lastaccess, proxy.auto_compress,
+					proxy.accept_codecs, 0);
 		}
 
 		DCrequeue_proxy(proxy.hostid, update_nextcheck, ret);
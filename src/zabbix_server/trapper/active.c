@@ -23,6 +23,7 @@
 #include "log.h"
 #include "zbxserver.h"
 #include "zbxregexp.h"
+#include "zbxproxybuf.h"
 
 #include "../../libs/zbxcrypto/tls_tcp_active.h"
 
@@ -91,6 +92,7 @@ static void	db_register_host(const char *host, const char *ip, unsigned short po
 		DBproxy_register_host(host, p_ip, p_dns, port, connection_type, host_metadata, (unsigned short)flag);
 
 	DBcommit();
+	zbx_pmb_db_release();
 }
 
 static int	zbx_autoreg_check_permissions(const char *host, const char *ip, unsigned short port,
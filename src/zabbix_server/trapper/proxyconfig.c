@@ -60,10 +60,11 @@ void	send_proxyconfig(zbx_socket_t *sock, struct zbx_json_parse *jp)
 	}
 
 	zbx_update_proxy_data(&proxy, zbx_get_proxy_protocol_version(jp), time(NULL),
-			(0 != (sock->protocol & ZBX_TCP_COMPRESS) ? 1 : 0), ZBX_FLAGS_PROXY_DIFF_UPDATE_CONFIG);
+			(0 != (sock->protocol & ZBX_TCP_COMPRESS) ? 1 : 0), zbx_proxy_get_compression(jp),
+			ZBX_FLAGS_PROXY_DIFF_UPDATE_CONFIG);
 
 	if (0 != proxy.auto_compress)
-		flags |= ZBX_TCP_COMPRESS;
+		flags = zbx_proxy_compress_flags(&proxy, sock->protocol);
 
 	zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
 
@@ -25,6 +25,7 @@
 #include "zbxtasks.h"
 #include "mutexs.h"
 #include "daemon.h"
+#include "zbxproxybuf.h"
 
 #include "proxydata.h"
 
@@ -34,7 +35,8 @@ static zbx_mutex_t	proxy_lock = ZBX_MUTEX_NULL;
 #define	LOCK_PROXY_HISTORY	if (0 != (program_type & ZBX_PROGRAM_TYPE_PROXY_PASSIVE)) zbx_mutex_lock(proxy_lock)
 #define	UNLOCK_PROXY_HISTORY	if (0 != (program_type & ZBX_PROGRAM_TYPE_PROXY_PASSIVE)) zbx_mutex_unlock(proxy_lock)
 
-int	zbx_send_proxy_data_response(const DC_PROXY *proxy, zbx_socket_t *sock, const char *info, int upload_status)
+int	zbx_send_proxy_data_response(const DC_PROXY *proxy, zbx_socket_t *sock, const char *info, int upload_status,
+		zbx_uint64_t batchid, int pipeline)
 {
 	struct zbx_json		json;
 	zbx_vector_ptr_t	tasks;
@@ -70,11 +72,19 @@ int	zbx_send_proxy_data_response(const DC_PROXY *proxy, zbx_socket_t *sock, cons
 	if (NULL != info && '\0' != *info)
 		zbx_json_addstring(&json, ZBX_PROTO_TAG_INFO, info, ZBX_JSON_TYPE_STRING);
 
+	zbx_proxy_add_history_format(proxy, &json);
+
+	if (0 != pipeline)
+		zbx_proxy_add_data_pipeline(proxy, &json);
+
+	if (0 != batchid)
+		zbx_json_adduint64(&json, ZBX_PROTO_TAG_BATCH, batchid);
+
 	if (0 != tasks.values_num)
 		zbx_tm_json_serialize_tasks(&json, &tasks);
 
 	if (0 != proxy->auto_compress)
-		flags |= ZBX_TCP_COMPRESS;
+		flags = zbx_proxy_compress_flags(proxy, sock->protocol);
 
 	if (SUCCEED == (ret = zbx_tcp_send_ext(sock, json.buffer, strlen(json.buffer), flags, 0)))
 	{
@@ -92,22 +102,31 @@ int	zbx_send_proxy_data_response(const DC_PROXY *proxy, zbx_socket_t *sock, cons
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_recv_proxy_data                                              *
+ * Function: recv_proxy_data_batch                                            *
  *                                                                            *
- * Purpose: receive 'proxy data' request from proxy                           *
+ * Purpose: receive one 'proxy data' request from proxy                       *
  *                                                                            *
- * Parameters: sock - [IN] the connection socket                              *
- *             jp   - [IN] the received JSON data                             *
- *             ts   - [IN] the connection timestamp                           *
+ * Parameters: sock     - [IN] the connection socket                          *
+ *             jp       - [IN] the received JSON data                         *
+ *             ts       - [IN] the request timestamp                          *
+ *             batchid  - [IN] the batch id to acknowledge, 0 if proxy does   *
+ *                             not pipeline requests                          *
+ *             pipeline - [IN] 1 - advertise pipelining to proxy              *
+ *                             0 - proxy must not send more batches over this *
+ *                                 connection                                 *
+ *                                                                            *
+ * Return value: SUCCEED - the data was processed and acknowledged            *
+ *               FAIL    - otherwise                                          *
  *                                                                            *
  ******************************************************************************/
-void	zbx_recv_proxy_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_timespec_t *ts)
+static int	recv_proxy_data_batch(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_timespec_t *ts,
+		zbx_uint64_t batchid, int pipeline)
 {
 	int			ret = FAIL, upload_status = 0, status, version, responded = 0;
 	char			*error = NULL;
 	DC_PROXY		proxy;
 
-	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s() batchid:" ZBX_FS_UI64, __func__, batchid);
 
 	if (SUCCEED != (status = get_active_proxy_from_request(jp, &proxy, &error)))
 	{
@@ -124,6 +143,7 @@ void	zbx_recv_proxy_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_time
 	}
 
 	version = zbx_get_proxy_protocol_version(jp);
+	proxy.accept_codecs = zbx_proxy_get_compression(jp);
 
 	if (SUCCEED != zbx_check_protocol_version(&proxy, version))
 	{
@@ -138,7 +158,8 @@ void	zbx_recv_proxy_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_time
 	{
 		upload_status = ZBX_PROXY_UPLOAD_ENABLED;
 
-		if (SUCCEED != (ret = process_proxy_data(&proxy, jp, ts, HOST_STATUS_PROXY_ACTIVE, NULL, &error)))
+		if (SUCCEED != (ret = process_proxy_data(&proxy, jp, sock->buffer, sock->read_bytes, ts,
+				HOST_STATUS_PROXY_ACTIVE, NULL, &error)))
 		{
 			zabbix_log(LOG_LEVEL_WARNING, "received invalid proxy data from proxy \"%s\" at \"%s\": %s",
 					proxy.host, sock->peer, error);
@@ -155,7 +176,9 @@ void	zbx_recv_proxy_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_time
 		goto out;
 	}
 
-	zbx_send_proxy_data_response(&proxy, sock, error, upload_status);
+	if (SUCCEED != zbx_send_proxy_data_response(&proxy, sock, error, upload_status, batchid, pipeline))
+		ret = FAIL;
+
 	responded = 1;
 
 out:
@@ -163,7 +186,7 @@ out:
 				/* we are trying to save info about lastaccess to detect communication problem */
 	{
 		zbx_update_proxy_data(&proxy, version, ts->sec,
-				(0 != (sock->protocol & ZBX_TCP_COMPRESS) ? 1 : 0), 0);
+				(0 != (sock->protocol & ZBX_TCP_COMPRESS) ? 1 : 0), proxy.accept_codecs, 0);
 	}
 
 	if (0 == responded)
@@ -171,7 +194,7 @@ out:
 		int	flags = ZBX_TCP_PROTOCOL;
 
 		if (0 != (sock->protocol & ZBX_TCP_COMPRESS))
-			flags |= ZBX_TCP_COMPRESS;
+			flags = zbx_tcp_compress_flags(sock->protocol);
 
 		zbx_send_response_ext(sock, ret, error, NULL, flags, CONFIG_TIMEOUT);
 	}
@@ -179,6 +202,87 @@ out:
 	zbx_free(error);
 
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s():%s", __func__, zbx_result_string(ret));
+
+	return ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_recv_proxy_data                                              *
+ *                                                                            *
+ * Purpose: receive 'proxy data' request from proxy                           *
+ *                                                                            *
+ * Parameters: sock - [IN] the connection socket                              *
+ *             jp   - [IN] the received JSON data                             *
+ *             ts   - [IN] the connection timestamp                           *
+ *                                                                            *
+ * Comments: Proxy sending batch id keeps the connection open and can send    *
+ *           next batches before the previous are acknowledged. Batches are   *
+ *           processed in the order they were received until the proxy closes *
+ *           connection. Connection is closed after the first failed batch so *
+ *           that batches following it are not processed out of order.       *
+ *           Pipelining is no longer advertised after ProxyDataPipelineTime,  *
+ *           so the proxy closes connection after the batches already sent,   *
+ *           and the connection is closed by server if the proxy keeps        *
+ *           sending.                                                         *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_recv_proxy_data(zbx_socket_t *sock, struct zbx_json_parse *jp, zbx_timespec_t *ts)
+{
+	struct zbx_json_parse	jp_batch = *jp;
+	char			value[MAX_STRING_LEN];
+	zbx_uint64_t		batchid;
+	time_t			time_start;
+	int			pipeline, batches_closed = 0;
+
+	zabbix_log(LOG_LEVEL_DEBUG, "In %s()", __func__);
+
+	time_start = time(NULL);
+
+	while (1)
+	{
+		batchid = 0;
+
+		pipeline = (CONFIG_PROXYDATA_PIPELINE_TIME > time(NULL) - time_start);
+
+		/* proxy can have the whole window of batches in flight when it receives the first response */
+		/* without pipelining                                                                         */
+		if (0 == pipeline && ZBX_PROXY_DATA_BATCHES_MAX < ++batches_closed)
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "proxy at \"%s\" keeps sending data after pipelining was"
+					" withdrawn, closing connection", sock->peer);
+			break;
+		}
+
+		if (SUCCEED == zbx_json_value_by_name(&jp_batch, ZBX_PROTO_TAG_BATCH, value, sizeof(value), NULL) &&
+				SUCCEED != is_uint64(value, &batchid))
+		{
+			batchid = 0;
+		}
+
+		if (SUCCEED != recv_proxy_data_batch(sock, &jp_batch, ts, batchid, pipeline) || 0 == batchid)
+			break;
+
+		/* proxy closes connection when it has no more data to send */
+		if (!ZBX_IS_RUNNING() || SUCCEED != zbx_tcp_recv_to(sock, CONFIG_TRAPPER_TIMEOUT) ||
+				0 == sock->read_bytes)
+		{
+			break;
+		}
+
+		zbx_timespec(ts);
+
+		if (SUCCEED != zbx_json_open(sock->buffer, &jp_batch) || SUCCEED != zbx_json_value_by_name(&jp_batch,
+				ZBX_PROTO_TAG_REQUEST, value, sizeof(value), NULL) ||
+				0 != strcmp(value, ZBX_PROTO_VALUE_PROXY_DATA))
+		{
+			zabbix_log(LOG_LEVEL_WARNING, "received unexpected request from proxy at \"%s\" while"
+					" waiting for proxy data", sock->peer);
+			break;
+		}
+	}
+
+	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
 }
 
 /******************************************************************************
@@ -189,12 +293,13 @@ out:
  *                                                                            *
  * Parameters: sock  - [IN] the connection socket                             *
  *             data  - [IN] the data to send                                  *
+ *             size  - [IN] the data size                                     *
  *             error - [OUT] the error message                                *
  *                                                                            *
  ******************************************************************************/
-static int	send_data_to_server(zbx_socket_t *sock, const char *data, char **error)
+static int	send_data_to_server(zbx_socket_t *sock, const char *data, size_t size, char **error)
 {
-	if (SUCCEED != zbx_tcp_send_ext(sock, data, strlen(data), ZBX_TCP_PROTOCOL | ZBX_TCP_COMPRESS, CONFIG_TIMEOUT))
+	if (SUCCEED != zbx_tcp_send_ext(sock, data, size, zbx_tcp_compress_flags(sock->protocol), CONFIG_TIMEOUT))
 	{
 		*error = zbx_strdup(*error, zbx_socket_strerror());
 		return FAIL;
@@ -220,8 +325,10 @@ void	zbx_send_proxy_data(zbx_socket_t *sock, zbx_timespec_t *ts)
 {
 	struct zbx_json		j;
 	zbx_uint64_t		areg_lastid = 0, history_lastid = 0, discovery_lastid = 0;
-	char			*error = NULL;
-	int			availability_ts, more_history, more_discovery, more_areg, proxy_delay;
+	char			*error = NULL, *history = NULL;
+	size_t			history_len = 0;
+	int			availability_ts, more_history, more_discovery, more_areg, proxy_delay,
+				history_binary;
 	zbx_vector_ptr_t	tasks;
 	struct zbx_json_parse	jp, jp_tasks;
 
@@ -233,12 +340,16 @@ void	zbx_send_proxy_data(zbx_socket_t *sock, zbx_timespec_t *ts)
 		goto out;
 	}
 
+	/* server advertises binary history format in the request */
+	history_binary = zbx_proxy_history_binary_accepted(sock->buffer);
+
 	LOCK_PROXY_HISTORY;
 	zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
 
-	zbx_json_addstring(&j, ZBX_PROTO_TAG_SESSION, zbx_dc_get_session_token(), ZBX_JSON_TYPE_STRING);
 	get_interface_availability_data(&j, &availability_ts);
-	proxy_get_hist_data(&j, &history_lastid, &more_history);
+	proxy_get_hist_data(&j, SUCCEED == history_binary ? &history : NULL, &history_len, &history_lastid,
+			&more_history);
+	zbx_json_addstring(&j, ZBX_PROTO_TAG_SESSION, zbx_pmb_get_session_token(), ZBX_JSON_TYPE_STRING);
 	proxy_get_dhis_data(&j, &discovery_lastid, &more_discovery);
 	proxy_get_areg_data(&j, &areg_lastid, &more_areg);
 
@@ -255,13 +366,18 @@ void	zbx_send_proxy_data(zbx_socket_t *sock, zbx_timespec_t *ts)
 	}
 
 	zbx_json_addstring(&j, ZBX_PROTO_TAG_VERSION, ZABBIX_VERSION, ZBX_JSON_TYPE_STRING);
+	zbx_proxy_add_compression(&j);
 	zbx_json_adduint64(&j, ZBX_PROTO_TAG_CLOCK, ts->sec);
 	zbx_json_adduint64(&j, ZBX_PROTO_TAG_NS, ts->ns);
 
 	if (0 != history_lastid && 0 != (proxy_delay = proxy_get_delay(history_lastid)))
 		zbx_json_adduint64(&j, ZBX_PROTO_TAG_PROXY_DELAY, proxy_delay);
 
-	if (SUCCEED == send_data_to_server(sock, j.buffer, &error))
+	if (NULL != history)
+		zbx_proxy_data_join(&j, &history, &history_len);
+
+	if (SUCCEED == send_data_to_server(sock, NULL != history ? history : j.buffer,
+			NULL != history ? history_len : j.buffer_size, &error))
 	{
 		zbx_set_availability_diff_ts(availability_ts);
 
@@ -303,6 +419,7 @@ void	zbx_send_proxy_data(zbx_socket_t *sock, zbx_timespec_t *ts)
 	zbx_vector_ptr_destroy(&tasks);
 
 	zbx_json_free(&j);
+	zbx_free(history);
 	UNLOCK_PROXY_HISTORY;
 out:
 	zabbix_log(LOG_LEVEL_DEBUG, "End of %s()", __func__);
@@ -343,10 +460,11 @@ void	zbx_send_task_data(zbx_socket_t *sock, zbx_timespec_t *ts)
 		zbx_tm_json_serialize_tasks(&j, &tasks);
 
 	zbx_json_addstring(&j, ZBX_PROTO_TAG_VERSION, ZABBIX_VERSION, ZBX_JSON_TYPE_STRING);
+	zbx_proxy_add_compression(&j);
 	zbx_json_adduint64(&j, ZBX_PROTO_TAG_CLOCK, ts->sec);
 	zbx_json_adduint64(&j, ZBX_PROTO_TAG_NS, ts->ns);
 
-	if (SUCCEED == send_data_to_server(sock, j.buffer, &error))
+	if (SUCCEED == send_data_to_server(sock, j.buffer, j.buffer_size, &error))
 	{
 		DBbegin();
 
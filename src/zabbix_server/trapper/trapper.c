@@ -201,13 +201,14 @@ static void	recv_proxy_heartbeat(zbx_socket_t *sock, struct zbx_json_parse *jp)
 	}
 
 	zbx_update_proxy_data(&proxy, zbx_get_proxy_protocol_version(jp), time(NULL),
-			(0 != (sock->protocol & ZBX_TCP_COMPRESS) ? 1 : 0), ZBX_FLAGS_PROXY_DIFF_UPDATE_HEARTBEAT);
+			(0 != (sock->protocol & ZBX_TCP_COMPRESS) ? 1 : 0), zbx_proxy_get_compression(jp),
+			ZBX_FLAGS_PROXY_DIFF_UPDATE_HEARTBEAT);
 
 	if (0 != proxy.auto_compress)
-		flags |= ZBX_TCP_COMPRESS;
+		flags = zbx_proxy_compress_flags(&proxy, sock->protocol);
 out:
 	if (FAIL == ret && 0 != (sock->protocol & ZBX_TCP_COMPRESS))
-		flags |= ZBX_TCP_COMPRESS;
+		flags = zbx_tcp_compress_flags(sock->protocol);
 
 	zbx_send_response_ext(sock, ret, error, NULL, flags, CONFIG_TIMEOUT);
 
@@ -37,14 +37,17 @@ AC_DEFUN([CONF_TESTS],[
 		tests/libs/zbxserver/Makefile
 		tests/libs/zbxprometheus/Makefile
 		tests/zabbix_server/Makefile
+		tests/zabbix_server/poller/Makefile
 		tests/zabbix_server/preprocessor/Makefile
 		tests/libs/zbxcomms/Makefile
+		tests/libs/zbxcompress/Makefile
 		tests/zabbix_server/trapper/Makefile
 		tests/libs/zbxregexp/Makefile
 		tests/libs/zbxtrends/Makefile
 		tests/mocks/Makefile
 		tests/mocks/configcache/Makefile
 		tests/mocks/valuecache/Makefile
+		tests/mocks/trends/Makefile
 		])
 		AC_DEFINE([HAVE_TESTS], [1], ["Define to 1 if tests directory is present"])
 	])
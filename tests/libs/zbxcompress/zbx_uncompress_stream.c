@@ -0,0 +1,162 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "zbxcompress.h"
+
+static unsigned char	mock_str_to_codec(const char *str)
+{
+	if (0 == strcmp(str, "zlib"))
+		return ZBX_COMPRESS_ZLIB;
+
+	if (0 == strcmp(str, "zstd"))
+		return ZBX_COMPRESS_ZSTD;
+
+	if (0 == strcmp(str, "lz4"))
+		return ZBX_COMPRESS_LZ4;
+
+	fail_msg("unknown compression codec \"%s\"", str);
+
+	return ZBX_COMPRESS_ZLIB;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_uncompress                                                  *
+ *                                                                            *
+ * Purpose: uncompress data writing it to stream in chunks of the specified   *
+ *          size, like it is received from socket                             *
+ *                                                                            *
+ ******************************************************************************/
+static int	mock_uncompress(unsigned char codec, const char *in, size_t size_in, size_t chunk, char *out,
+		size_t out_size, size_t *size_out)
+{
+	zbx_uncompress_stream_t	*stream;
+	size_t			offset, size;
+	int			ret = SUCCEED;
+
+	if (NULL == (stream = zbx_uncompress_stream_create(codec, out, out_size)))
+		fail_msg("cannot create uncompress stream: %s", zbx_compress_strerror());
+
+	for (offset = 0; offset < size_in && SUCCEED == ret; offset += size)
+	{
+		size = MIN(chunk, size_in - offset);
+		ret = zbx_uncompress_stream_write(stream, in + offset, size);
+	}
+
+	if (SUCCEED == ret)
+		ret = zbx_uncompress_stream_finish(stream, size_out);
+
+	zbx_uncompress_stream_free(stream);
+
+	return ret;
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	const char	*data, *mutation;
+	char		*in = NULL, *compressed = NULL, *out;
+	size_t		in_alloc = 0, in_offset = 0, compressed_size, out_size, size_out = 0, chunk, offset;
+	zbx_uint64_t	i, repeat;
+	unsigned char	codec;
+	int		ret, expected_ret;
+
+	ZBX_UNUSED(state);
+
+	codec = mock_str_to_codec(zbx_mock_get_parameter_string("in.codec"));
+
+	if (SUCCEED != zbx_compress_codec_supported(codec))
+	{
+		zbx_mock_assert_int_eq("zbx_compress_ext() with codec not compiled in", FAIL,
+				zbx_compress_ext(codec, "", 0, &compressed, &compressed_size));
+		skip();
+	}
+
+	data = zbx_mock_get_parameter_string("in.data");
+	repeat = zbx_mock_get_parameter_uint64("in.repeat");
+
+	for (i = 0; i < repeat; i++)
+		zbx_snprintf_alloc(&in, &in_alloc, &in_offset, "%s" ZBX_FS_UI64 "\n", data, i);
+
+	if (NULL == in)
+		in = zbx_strdup(NULL, "");
+
+	if (SUCCEED != zbx_compress_ext(codec, in, in_offset, &compressed, &compressed_size))
+		fail_msg("cannot compress data: %s", zbx_compress_strerror());
+
+	mutation = zbx_mock_get_parameter_string("in.mutation");
+	offset = (size_t)zbx_mock_get_parameter_uint64("in.offset");
+
+	if (0 == strcmp(mutation, "truncate"))
+	{
+		if (offset > compressed_size)
+			fail_msg("cannot truncate " ZBX_FS_SIZE_T " bytes of " ZBX_FS_SIZE_T " bytes compressed data",
+					(zbx_fs_size_t)offset, (zbx_fs_size_t)compressed_size);
+
+		compressed_size -= offset;
+	}
+	else if (0 == strcmp(mutation, "corrupt"))
+	{
+		if (offset >= compressed_size)
+			fail_msg("cannot corrupt byte " ZBX_FS_SIZE_T " of " ZBX_FS_SIZE_T " bytes compressed data",
+					(zbx_fs_size_t)offset, (zbx_fs_size_t)compressed_size);
+
+		compressed[offset] ^= 0xff;
+	}
+	else if (0 == strcmp(mutation, "append"))
+	{
+		compressed = (char *)zbx_realloc(compressed, compressed_size + offset);
+		memset(compressed + compressed_size, 'x', offset);
+		compressed_size += offset;
+	}
+	else if (0 != strcmp(mutation, "none"))
+		fail_msg("unknown mutation \"%s\"", mutation);
+
+	/* output buffer is sized by the uncompressed size, like the buffer allocated by protocol header */
+	out_size = in_offset - (size_t)zbx_mock_get_parameter_uint64("in.shortage");
+	out = (char *)zbx_malloc(NULL, out_size + 1);
+
+	if (0 == (chunk = (size_t)zbx_mock_get_parameter_uint64("in.chunk")))
+		chunk = compressed_size;
+
+	ret = mock_uncompress(codec, compressed, compressed_size, chunk, out, out_size, &size_out);
+	expected_ret = zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.return"));
+
+	if (SUCCEED != ret && SUCCEED == expected_ret)
+		fail_msg("cannot uncompress data: %s", zbx_compress_strerror());
+
+	zbx_mock_assert_int_eq("uncompress return value", expected_ret, ret);
+
+	if (SUCCEED == ret)
+	{
+		zbx_mock_assert_uint64_eq("uncompressed size", in_offset, size_out);
+
+		if (0 != memcmp(in, out, size_out))
+			fail_msg("uncompressed data does not match the original data");
+	}
+
+	zbx_free(out);
+	zbx_free(compressed);
+	zbx_free(in);
+}
@@ -0,0 +1,81 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "dbcache_test.h"
+
+int	zbx_dc_trends_init_test(zbx_uint64_t size, char **error)
+{
+	cache = (ZBX_DC_CACHE *)zbx_malloc(NULL, sizeof(ZBX_DC_CACHE));
+	memset(cache, 0, sizeof(ZBX_DC_CACHE));
+
+	CONFIG_TRENDS_CACHE_SIZE = size;
+
+	return init_trend_cache(error);
+}
+
+void	zbx_dc_trends_add_test(const ZBX_DC_HISTORY *history, int history_num)
+{
+	ZBX_DC_TREND			*trends = NULL;
+	int				trends_num = 0;
+	zbx_vector_uint64_pair_t	trends_diff;
+
+	zbx_vector_uint64_pair_create(&trends_diff);
+
+	DCmass_update_trends(history, history_num, &trends, &trends_num, 0);
+	DBmass_update_trends(trends, trends_num, &trends_diff);
+
+	zbx_vector_uint64_pair_destroy(&trends_diff);
+	zbx_free(trends);
+}
+
+void	zbx_dc_trends_sync_test(void)
+{
+	DCsync_trends();
+}
+
+int	zbx_dc_trends_queue_test(void)
+{
+	return cache->trends_closed.num_data;
+}
+
+int	zbx_dc_trends_lag_test(void)
+{
+	return cache->trends_flush_lag;
+}
+
+int	zbx_hc_sync_shard_test(int index)
+{
+	zbx_hc_shard_t		*shard;
+	zbx_vector_ptr_t	history_items;
+	int			values_num;
+
+	zbx_vector_ptr_create(&history_items);
+
+	/* remove the oldest value of each queued item like history syncer does */
+	shard = hc_lock_shard(index);
+	hc_pop_items(shard, &history_items);
+	hc_push_items(shard, &history_items);
+	shard->history_num -= history_items.values_num;
+	hc_unlock_shard(index);
+
+	values_num = history_items.values_num;
+	zbx_vector_ptr_destroy(&history_items);
+
+	return values_num;
+}
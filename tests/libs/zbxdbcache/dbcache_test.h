@@ -0,0 +1,30 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef DBCACHE_TEST_H
+#define DBCACHE_TEST_H
+
+int	zbx_dc_trends_init_test(zbx_uint64_t size, char **error);
+void	zbx_dc_trends_add_test(const ZBX_DC_HISTORY *history, int history_num);
+void	zbx_dc_trends_sync_test(void);
+int	zbx_dc_trends_queue_test(void);
+int	zbx_dc_trends_lag_test(void);
+int	zbx_hc_sync_shard_test(int index);
+
+#endif
@@ -0,0 +1,202 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "log.h"
+#include "mutexs.h"
+#include "sysinfo.h"
+#include "dbcache.h"
+#include "dbcache_test.h"
+
+extern zbx_uint64_t	CONFIG_HISTORY_CACHE_SIZE;
+extern zbx_uint64_t	CONFIG_HISTORY_INDEX_CACHE_SIZE;
+extern int		CONFIG_HISTORY_CACHE_SHARDS;
+
+/* the expected waits for free history cache space, invalid handle if none are expected */
+static zbx_mock_handle_t	mock_sleeps = -1;
+static int			mock_step;
+
+int	__wrap_zbx_mutex_create(zbx_mutex_t *mutex, zbx_mutex_name_t name, char **error);
+unsigned int	__wrap_sleep(unsigned int seconds);
+
+int	__wrap_zbx_mutex_create(zbx_mutex_t *mutex, zbx_mutex_name_t name, char **error)
+{
+	ZBX_UNUSED(name);
+	ZBX_UNUSED(error);
+
+	*mutex = ZBX_MUTEX_NULL;
+
+	return SUCCEED;
+}
+
+static zbx_uint64_t	mock_get_uint64(zbx_mock_handle_t handle)
+{
+	zbx_uint64_t		value;
+	zbx_mock_error_t	err;
+
+	if (ZBX_MOCK_SUCCESS != (err = zbx_mock_uint64(handle, &value)))
+		fail_msg("[%d] cannot read unsigned integer: %s", mock_step, zbx_mock_error_string(err));
+
+	return value;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_check_shards                                                *
+ *                                                                            *
+ * Purpose: checks the number of items and values in history cache shards     *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_check_shards(const char *prefix, zbx_mock_handle_t handle)
+{
+	zbx_mock_handle_t	hitems, hvalues, hitem, hvalue;
+	zbx_uint64_t		items_num, values_num;
+	int			i;
+	char			msg[MAX_STRING_LEN];
+
+	hitems = zbx_mock_get_object_member_handle(handle, "items");
+	hvalues = zbx_mock_get_object_member_handle(handle, "values");
+
+	for (i = 0; i < CONFIG_HISTORY_CACHE_SHARDS; i++)
+	{
+		if (ZBX_MOCK_SUCCESS != zbx_mock_vector_element(hitems, &hitem) ||
+				ZBX_MOCK_SUCCESS != zbx_mock_vector_element(hvalues, &hvalue))
+		{
+			fail_msg("%s: expected statistics of %d shards", prefix, CONFIG_HISTORY_CACHE_SHARDS);
+		}
+
+		zbx_hc_get_shard_diag_stats(i, &items_num, &values_num);
+
+		zbx_snprintf(msg, sizeof(msg), "%s: items in shard %d", prefix, i);
+		zbx_mock_assert_uint64_eq(msg, mock_get_uint64(hitem), items_num);
+		zbx_snprintf(msg, sizeof(msg), "%s: values in shard %d", prefix, i);
+		zbx_mock_assert_uint64_eq(msg, mock_get_uint64(hvalue), values_num);
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: __wrap_sleep                                                     *
+ *                                                                            *
+ * Purpose: checks history cache shards when the process adding values waits  *
+ *          for free space and simulates history syncer freeing it            *
+ *                                                                            *
+ ******************************************************************************/
+unsigned int	__wrap_sleep(unsigned int seconds)
+{
+	zbx_mock_handle_t	hsleep, hsync;
+	char			prefix[MAX_STRING_LEN];
+
+	ZBX_UNUSED(seconds);
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_vector_element(mock_sleeps, &hsleep))
+		fail_msg("[%d] unexpected wait for free history cache space", mock_step);
+
+	zbx_snprintf(prefix, sizeof(prefix), "[%d] sleep", mock_step);
+	mock_check_shards(prefix, hsleep);
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hsleep, "sync", &hsync))
+		zbx_hc_sync_shard_test((int)mock_get_uint64(hsync));
+
+	return 0;
+}
+
+static void	mock_add_values(zbx_mock_handle_t hstep)
+{
+	zbx_mock_handle_t	hvalues, hvalue, hsleep;
+	zbx_mock_error_t	err;
+	zbx_timespec_t		ts = {0, 0};
+	AGENT_RESULT		result;
+	char			*text;
+	size_t			size;
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_object_member(hstep, "sleeps", &mock_sleeps))
+		mock_sleeps = -1;
+
+	hvalues = zbx_mock_get_object_member_handle(hstep, "values");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hvalues, &hvalue)))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read value: %s", mock_step, zbx_mock_error_string(err));
+
+		size = (size_t)zbx_mock_get_object_member_uint64(hvalue, "size");
+		text = (char *)zbx_malloc(NULL, size + 1);
+		memset(text, 'x', size);
+		text[size] = '\0';
+
+		init_result(&result);
+		SET_TEXT_RESULT(&result, text);
+		ts.sec++;
+
+		dc_add_history(zbx_mock_get_object_member_uint64(hvalue, "itemid"), ITEM_VALUE_TYPE_TEXT, 0, &result,
+				&ts, ITEM_STATE_NORMAL, NULL);
+
+		free_result(&result);
+	}
+
+	dc_flush_history();
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_vector_element(mock_sleeps, &hsleep))
+		fail_msg("[%d] expected more waits for free history cache space", mock_step);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_handle_t	hin, hsteps, hstep;
+	zbx_mock_error_t	err;
+	char			*error = NULL, prefix[MAX_STRING_LEN];
+	const char		*op;
+
+	ZBX_UNUSED(state);
+
+	hin = zbx_mock_get_parameter_handle("in");
+
+	CONFIG_HISTORY_CACHE_SHARDS = (int)zbx_mock_get_object_member_uint64(hin, "shards");
+	CONFIG_HISTORY_CACHE_SIZE = zbx_mock_get_object_member_uint64(hin, "cache_size");
+	CONFIG_HISTORY_INDEX_CACHE_SIZE = ZBX_MEBIBYTE * (zbx_uint64_t)CONFIG_HISTORY_CACHE_SHARDS;
+
+	if (SUCCEED != init_database_cache(&error))
+		fail_msg("cannot initialize history cache: %s", error);
+
+	hsteps = zbx_mock_get_object_member_handle(hin, "steps");
+
+	for (mock_step = 1; ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hsteps, &hstep)); mock_step++)
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read step: %s", mock_step, zbx_mock_error_string(err));
+
+		op = zbx_mock_get_object_member_string(hstep, "op");
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] %s", mock_step, op);
+
+		if (0 == strcmp(op, "add"))
+			mock_add_values(hstep);
+		else if (0 == strcmp(op, "shards"))
+			mock_check_shards(prefix, hstep);
+		else if (0 == strcmp(op, "sync"))
+			zbx_hc_sync_shard_test((int)zbx_mock_get_object_member_uint64(hstep, "shard"));
+		else
+			fail_msg("[%d] unknown operation \"%s\"", mock_step, op);
+	}
+}
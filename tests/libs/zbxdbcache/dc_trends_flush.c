@@ -0,0 +1,433 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "log.h"
+#include "zbxalgo.h"
+#include "vectorimpl.h"
+#include "mutexs.h"
+#include "db.h"
+#include "dbcache.h"
+#include "dbcache_test.h"
+
+#define MOCK_TRENDS_VALUES_MAX	64
+
+/* the trend record in mocked trends or trends_uint table */
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	int		clock;
+	int		num;
+	double		value_min;
+	double		value_avg;
+	double		value_max;
+	unsigned char	value_type;
+}
+mock_trend_t;
+
+ZBX_VECTOR_DECL(mock_trend, mock_trend_t)
+ZBX_VECTOR_IMPL(mock_trend, mock_trend_t)
+
+static zbx_timespec_t		mock_ts;
+static zbx_vector_mock_trend_t	mock_trends;
+static int			mock_statements;
+
+static zbx_uint32_t		mock_mysql_version;
+static int			mock_mariadb = OFF;
+
+zbx_uint32_t	__wrap_zbx_dbms_version_get(void);
+int	__wrap_zbx_dbms_mariadb_used(void);
+void	__wrap_zbx_timespec(zbx_timespec_t *ts);
+int	__wrap_zbx_mutex_create(zbx_mutex_t *mutex, zbx_mutex_name_t name, char **error);
+int	__wrap_zbx_history_requires_trends(int value_type);
+void	__wrap_zbx_config_get(zbx_config_t *cfg, zbx_uint64_t flags);
+int	__wrap_DBexecute(const char *fmt, ...);
+void	__wrap_DBbegin(void);
+int	__wrap_DBcommit(void);
+
+zbx_uint32_t	__wrap_zbx_dbms_version_get(void)
+{
+	return mock_mysql_version;
+}
+
+int	__wrap_zbx_dbms_mariadb_used(void)
+{
+	return mock_mariadb;
+}
+
+void	__wrap_zbx_timespec(zbx_timespec_t *ts)
+{
+	*ts = mock_ts;
+}
+
+int	__wrap_zbx_mutex_create(zbx_mutex_t *mutex, zbx_mutex_name_t name, char **error)
+{
+	ZBX_UNUSED(name);
+	ZBX_UNUSED(error);
+
+	*mutex = ZBX_MUTEX_NULL;
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_history_requires_trends(int value_type)
+{
+	return ITEM_VALUE_TYPE_FLOAT == value_type || ITEM_VALUE_TYPE_UINT64 == value_type ? SUCCEED : FAIL;
+}
+
+void	__wrap_zbx_config_get(zbx_config_t *cfg, zbx_uint64_t flags)
+{
+	ZBX_UNUSED(flags);
+
+	/* history compression is disabled */
+	memset(cfg, 0, sizeof(zbx_config_t));
+}
+
+void	__wrap_DBbegin(void)
+{
+}
+
+int	__wrap_DBcommit(void)
+{
+	return ZBX_DB_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_trends_check_clause                                         *
+ *                                                                            *
+ * Purpose: checks that the record merging clause of trends upsert matches    *
+ *          the database backend and version                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_trends_check_clause(const char *clause)
+{
+	const char	*expected;
+
+#if defined(HAVE_POSTGRESQL)
+	expected = " on conflict (itemid,clock) do update set";
+#elif defined(HAVE_MYSQL)
+	if (ON != mock_mariadb && 80019 <= mock_mysql_version)
+		expected = " as new on duplicate key update value_min=least(value_min,new.value_min),";
+	else
+		expected = " on duplicate key update value_min=least(value_min,values(value_min)),";
+#else
+	expected = "";
+#endif
+	if (0 != strncmp(clause, expected, strlen(expected)))
+		fail_msg("expected trends upsert clause \"%s\" but got \"%s\"", expected, clause);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_trends_upsert                                               *
+ *                                                                            *
+ * Purpose: merges trend record with the existing record of the same item     *
+ *          hour in mocked trends table                                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_trends_upsert(const mock_trend_t *trend)
+{
+	int		i;
+	mock_trend_t	*row;
+
+	for (i = 0; i < mock_trends.values_num; i++)
+	{
+		row = &mock_trends.values[i];
+
+		if (row->itemid != trend->itemid || row->clock != trend->clock || row->value_type != trend->value_type)
+			continue;
+
+		row->value_avg = row->value_avg / (row->num + trend->num) * row->num +
+				trend->value_avg / (row->num + trend->num) * trend->num;
+		row->num += trend->num;
+
+		if (trend->value_min < row->value_min)
+			row->value_min = trend->value_min;
+
+		if (trend->value_max > row->value_max)
+			row->value_max = trend->value_max;
+
+		return;
+	}
+
+	zbx_vector_mock_trend_append_ptr(&mock_trends, (mock_trend_t *)trend);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_trends_execute                                              *
+ *                                                                            *
+ * Purpose: parses trends insert statement and applies it to mocked trends    *
+ *          tables                                                            *
+ *                                                                            *
+ * Comments: Like the database, fails if the statement updates the same       *
+ *           record twice.                                                    *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_trends_execute(const char *sql)
+{
+	const char			*ptr;
+	char				*end = NULL;
+	mock_trend_t			trend;
+	zbx_vector_uint64_pair_t	keys;
+	zbx_uint64_pair_t		key;
+
+	if (0 == strncmp(sql, "insert into trends_uint ", ZBX_CONST_STRLEN("insert into trends_uint ")))
+		trend.value_type = ITEM_VALUE_TYPE_UINT64;
+	else if (0 == strncmp(sql, "insert into trends ", ZBX_CONST_STRLEN("insert into trends ")))
+		trend.value_type = ITEM_VALUE_TYPE_FLOAT;
+	else
+		fail_msg("unexpected statement \"%s\"", sql);
+
+	if (NULL == (ptr = strstr(sql, " (itemid,clock,num,value_min,value_avg,value_max) values (")))
+		fail_msg("unexpected trends insert statement \"%s\"", sql);
+
+	ptr = strchr(ptr, '(');
+	zbx_vector_uint64_pair_create(&keys);
+
+	while (NULL != (ptr = strchr(ptr + 1, '(')))
+	{
+		trend.itemid = strtoull(ptr + 1, &end, 10);
+		trend.clock = (int)strtol(end + 1, &end, 10);
+		trend.num = (int)strtol(end + 1, &end, 10);
+		trend.value_min = strtod(end + 1, &end);
+		trend.value_avg = strtod(end + 1, &end);
+		trend.value_max = strtod(end + 1, &end);
+
+		if (')' != *end)
+			fail_msg("cannot parse trend record in statement \"%s\"", sql);
+
+		key.first = trend.itemid;
+		key.second = (zbx_uint64_t)trend.clock;
+
+		if (FAIL != zbx_vector_uint64_pair_search(&keys, key, ZBX_DEFAULT_UINT64_PAIR_COMPARE_FUNC))
+			fail_msg("record of item " ZBX_FS_UI64 " hour %d is updated twice", trend.itemid, trend.clock);
+
+		zbx_vector_uint64_pair_append(&keys, key);
+		mock_trends_upsert(&trend);
+
+		if (',' != end[1])
+			break;
+
+		ptr = end + 1;
+	}
+
+	zbx_vector_uint64_pair_destroy(&keys);
+
+	if (NULL == ptr)
+		fail_msg("cannot parse trends insert statement \"%s\"", sql);
+
+	mock_trends_check_clause(end + 1);
+}
+
+int	__wrap_DBexecute(const char *fmt, ...)
+{
+	va_list	args;
+	char	*sql;
+
+	va_start(args, fmt);
+	sql = zbx_dvsprintf(NULL, fmt, args);
+	va_end(args);
+
+	mock_trends_execute(sql);
+	mock_statements++;
+
+	zbx_free(sql);
+
+	return ZBX_DB_OK;
+}
+
+static int	mock_trend_compare(const void *d1, const void *d2)
+{
+	const mock_trend_t	*t1 = (const mock_trend_t *)d1;
+	const mock_trend_t	*t2 = (const mock_trend_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(t1->itemid, t2->itemid);
+	ZBX_RETURN_IF_NOT_EQUAL(t1->clock, t2->clock);
+
+	return 0;
+}
+
+static int	mock_read_time(zbx_mock_handle_t handle, const char *name)
+{
+	zbx_timespec_t	ts;
+	const char	*strtime;
+
+	strtime = zbx_mock_get_object_member_string(handle, name);
+
+	if (ZBX_MOCK_SUCCESS != zbx_strtime_to_timespec(strtime, &ts))
+		fail_msg("invalid time \"%s\"", strtime);
+
+	return ts.sec;
+}
+
+static void	mock_trends_add(int step, zbx_mock_handle_t hstep)
+{
+	zbx_mock_handle_t	hvalues, hvalue;
+	zbx_mock_error_t	err;
+	ZBX_DC_HISTORY		history[MOCK_TRENDS_VALUES_MAX], *h;
+	int			history_num = 0;
+
+	mock_ts.sec = mock_read_time(hstep, "time");
+	mock_ts.ns = 0;
+
+	hvalues = zbx_mock_get_object_member_handle(hstep, "values");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hvalues, &hvalue)))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read value: %s", step, zbx_mock_error_string(err));
+
+		if (MOCK_TRENDS_VALUES_MAX == history_num)
+			fail_msg("[%d] too many values", step);
+
+		h = &history[history_num++];
+		memset(h, 0, sizeof(ZBX_DC_HISTORY));
+
+		h->itemid = zbx_mock_get_object_member_uint64(hvalue, "itemid");
+		h->value_type = zbx_mock_str_to_value_type(zbx_mock_get_object_member_string(hvalue, "value_type"));
+		h->ts.sec = mock_read_time(hvalue, "ts");
+
+		if (ITEM_VALUE_TYPE_FLOAT == h->value_type)
+			h->value.dbl = zbx_mock_get_object_member_float(hvalue, "value");
+		else
+			h->value.ui64 = zbx_mock_get_object_member_uint64(hvalue, "value");
+	}
+
+	zbx_dc_trends_add_test(history, history_num);
+}
+
+static void	mock_trends_check_table(int step, zbx_mock_handle_t hstep)
+{
+	zbx_mock_handle_t	hrows, hrow;
+	zbx_mock_error_t	err;
+	mock_trend_t		*trend;
+	int			i = 0;
+	char			prefix[MAX_STRING_LEN];
+
+	zbx_vector_mock_trend_sort(&mock_trends, mock_trend_compare);
+
+	hrows = zbx_mock_get_object_member_handle(hstep, "rows");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hrows, &hrow)))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read row: %s", step, zbx_mock_error_string(err));
+
+		if (i == mock_trends.values_num)
+			fail_msg("[%d] expected more than %d trend records", step, i);
+
+		trend = &mock_trends.values[i++];
+
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] itemid of record #%d", step, i);
+		zbx_mock_assert_uint64_eq(prefix, zbx_mock_get_object_member_uint64(hrow, "itemid"), trend->itemid);
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] clock of record #%d", step, i);
+		zbx_mock_assert_int_eq(prefix, mock_read_time(hrow, "clock"), trend->clock);
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] num of record #%d", step, i);
+		zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hrow, "num"), trend->num);
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] value_min of record #%d", step, i);
+		zbx_mock_assert_double_eq(prefix, zbx_mock_get_object_member_float(hrow, "min"), trend->value_min);
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] value_avg of record #%d", step, i);
+		zbx_mock_assert_double_eq(prefix, zbx_mock_get_object_member_float(hrow, "avg"), trend->value_avg);
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] value_max of record #%d", step, i);
+		zbx_mock_assert_double_eq(prefix, zbx_mock_get_object_member_float(hrow, "max"), trend->value_max);
+	}
+
+	zbx_snprintf(prefix, sizeof(prefix), "[%d] number of trend records", step);
+	zbx_mock_assert_int_eq(prefix, i, mock_trends.values_num);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_handle_t	hin, hsteps, hstep;
+	zbx_mock_error_t	err;
+	char			*error = NULL, prefix[MAX_STRING_LEN];
+	const char		*op;
+	int			step = 1;
+
+	ZBX_UNUSED(state);
+
+#if !defined(HAVE_POSTGRESQL) && !defined(HAVE_MYSQL)
+	skip();
+#endif
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("in.mysql_version"))
+		mock_mysql_version = (zbx_uint32_t)zbx_mock_get_parameter_uint64("in.mysql_version");
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("in.mariadb"))
+		mock_mariadb = 0 == strcmp(zbx_mock_get_parameter_string("in.mariadb"), "yes") ? ON : OFF;
+
+	zbx_vector_mock_trend_create(&mock_trends);
+
+	hin = zbx_mock_get_parameter_handle("in");
+
+	if (SUCCEED != zbx_dc_trends_init_test(zbx_mock_get_object_member_uint64(hin, "cache_size"), &error))
+		fail_msg("cannot initialize trend cache: %s", error);
+
+	hsteps = zbx_mock_get_object_member_handle(hin, "steps");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hsteps, &hstep)))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read step: %s", step, zbx_mock_error_string(err));
+
+		op = zbx_mock_get_object_member_string(hstep, "op");
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] %s", step, op);
+
+		if (0 == strcmp(op, "add"))
+		{
+			mock_trends_add(step, hstep);
+		}
+		else if (0 == strcmp(op, "sync"))
+		{
+			zbx_dc_trends_sync_test();
+		}
+		else if (0 == strcmp(op, "queue"))
+		{
+			zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hstep, "value"),
+					zbx_dc_trends_queue_test());
+		}
+		else if (0 == strcmp(op, "lag"))
+		{
+			zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hstep, "value"),
+					zbx_dc_trends_lag_test());
+		}
+		else if (0 == strcmp(op, "statements"))
+		{
+			zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hstep, "value"),
+					mock_statements);
+		}
+		else if (0 == strcmp(op, "table"))
+		{
+			mock_trends_check_table(step, hstep);
+		}
+		else
+			fail_msg("[%d] unknown operation \"%s\"", step, op);
+
+		step++;
+	}
+
+	zbx_vector_mock_trend_destroy(&mock_trends);
+}
@@ -39,8 +39,10 @@ int	zbx_vc_get_cached_values(zbx_uint64_t itemid, unsigned char value_type, zbx_
 
 	for (chunk = item->tail; NULL != chunk; chunk = chunk->next)
 	{
+		zbx_history_record_t	*slots = vch_item_chunk_slots(item, chunk);
+
 		for (i = chunk->first_value; i <= chunk->last_value; i++)
-			vc_history_record_vector_append(values, value_type, &chunk->slots[i]);
+			vc_history_record_vector_append(values, value_type, &slots[i]);
 	}
 
 	return SUCCEED;
@@ -104,3 +106,29 @@ int	zbx_vc_get_cache_state(int *mode, zbx_uint64_t *hits, zbx_uint64_t *misses)
 
 	return SUCCEED;
 }
+
+int	zbx_vc_pack_values(const zbx_history_record_t *values, int values_num, int value_type,
+		zbx_history_record_t *unpacked)
+{
+	unsigned char	*data;
+	zbx_vc_chunk_t	*chunk;
+	int		size;
+
+	data = (unsigned char *)zbx_calloc(NULL, (size_t)values_num + 1, ZBX_VC_PACKED_VALUE_MAX_SIZE);
+	size = vch_chunk_pack(values, values_num, value_type, data);
+
+	/* allocate chunk of the exact compressed size to detect reading past the compressed data */
+	chunk = (zbx_vc_chunk_t *)zbx_malloc(NULL, ZBX_VC_CHUNK_HEADER_SIZE + (size_t)size);
+	memset(chunk, 0, ZBX_VC_CHUNK_HEADER_SIZE);
+	memcpy(chunk->slots, data, (size_t)size);
+	chunk->slots_num = values_num;
+	chunk->last_value = values_num - 1;
+	chunk->packed_size = size;
+
+	vch_chunk_unpack(chunk, value_type, unpacked);
+
+	zbx_free(chunk);
+	zbx_free(data);
+
+	return size;
+}
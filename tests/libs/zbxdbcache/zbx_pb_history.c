@@ -0,0 +1,408 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "log.h"
+#include "mutexs.h"
+#include "zbxalgo.h"
+#include "zbxproxybuf.h"
+
+#define MOCK_PB_RECORDS_MAX	16
+
+/* segment file header layout, see proxybuf.c */
+typedef struct
+{
+	zbx_uint32_t	magic;
+	zbx_uint32_t	version;
+	zbx_uint64_t	first_id;
+	zbx_uint64_t	size;
+	int		clock;
+}
+mock_pb_segment_header_t;
+
+#define MOCK_PB_SEGMENT_DATA_OFFSET	((sizeof(mock_pb_segment_header_t) + 7) & ~(zbx_uint64_t)7)
+
+static char		pb_dir[] = "/tmp/zbx_pb_history_XXXXXX";
+static zbx_uint64_t	segment_size;
+static int		local_buffer;
+
+static void	mock_pb_init(void)
+{
+	char	*error = NULL;
+
+	if (SUCCEED != zbx_pb_init(pb_dir, segment_size, local_buffer, &error))
+		fail_msg("cannot initialize proxy buffer: %s", error);
+}
+
+static void	mock_pb_list_segments(zbx_vector_uint64_t *segments)
+{
+	DIR		*dir;
+	struct dirent	*d;
+	zbx_uint64_t	segment;
+
+	if (NULL == (dir = opendir(pb_dir)))
+		fail_msg("cannot open \"%s\": %s", pb_dir, zbx_strerror(errno));
+
+	while (NULL != (d = readdir(dir)))
+	{
+		if (0 == strncmp(d->d_name, "history.", ZBX_CONST_STRLEN("history.")) &&
+				SUCCEED == is_uint64(d->d_name + ZBX_CONST_STRLEN("history."), &segment))
+		{
+			zbx_vector_uint64_append(segments, segment);
+		}
+	}
+
+	closedir(dir);
+
+	zbx_vector_uint64_sort(segments, ZBX_DEFAULT_UINT64_COMPARE_FUNC);
+}
+
+static zbx_uint64_t	mock_pb_last_segment(void)
+{
+	zbx_vector_uint64_t	segments;
+	zbx_uint64_t		segment;
+
+	zbx_vector_uint64_create(&segments);
+	mock_pb_list_segments(&segments);
+
+	if (0 == segments.values_num)
+		fail_msg("no segment files in \"%s\"", pb_dir);
+
+	segment = segments.values[segments.values_num - 1];
+	zbx_vector_uint64_destroy(&segments);
+
+	return segment;
+}
+
+static int	mock_pb_open_segment(zbx_uint64_t segment, int flags)
+{
+	char	path[MAX_STRING_LEN];
+	int	fd;
+
+	zbx_snprintf(path, sizeof(path), "%s/history." ZBX_FS_UI64, pb_dir, segment);
+
+	if (-1 == (fd = open(path, flags, S_IRUSR | S_IWUSR)))
+		fail_msg("cannot open \"%s\": %s", path, zbx_strerror(errno));
+
+	return fd;
+}
+
+static zbx_uint64_t	mock_pb_committed_size(zbx_uint64_t segment)
+{
+	mock_pb_segment_header_t	header;
+	int				fd;
+
+	fd = mock_pb_open_segment(segment, O_RDONLY);
+
+	if (sizeof(header) != pread(fd, &header, sizeof(header), 0))
+		fail_msg("cannot read segment " ZBX_FS_UI64 " header", segment);
+
+	close(fd);
+
+	return header.size;
+}
+
+static int	mock_pb_get_flag(zbx_mock_handle_t hstep, const char *name, int default_value)
+{
+	zbx_mock_handle_t	hflag;
+	const char		*flag;
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_object_member(hstep, name, &hflag))
+		return default_value;
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_string(hflag, &flag))
+		fail_msg("cannot read \"%s\" flag", name);
+
+	return 0 == strcmp(flag, "yes") ? SUCCEED : FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_pb_write                                                    *
+ *                                                                            *
+ * Purpose: writes records to proxy buffer, optionally simulating a crash     *
+ *          before the new committed size reached the segment header and a    *
+ *          torn last record                                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_pb_write(int step, zbx_mock_handle_t hstep)
+{
+	zbx_pb_history_t	records[MOCK_PB_RECORDS_MAX];
+	zbx_mock_handle_t	hvalues, hvalue;
+	zbx_mock_error_t	err;
+	zbx_uint64_t		segment, size_old, size_new;
+	char			*error = NULL, zeros[16];
+	int			records_num = 0, fd;
+
+	hvalues = zbx_mock_get_object_member_handle(hstep, "values");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hvalues, &hvalue)))
+	{
+		if (MOCK_PB_RECORDS_MAX == records_num)
+			fail_msg("[%d] too many records", step);
+
+		memset(&records[records_num], 0, sizeof(zbx_pb_history_t));
+
+		if (ZBX_MOCK_SUCCESS != err || ZBX_MOCK_SUCCESS != (err = zbx_mock_string(hvalue,
+				&records[records_num].value)))
+		{
+			fail_msg("[%d] cannot read record value: %s", step, zbx_mock_error_string(err));
+		}
+
+		records[records_num].itemid = 1;
+		records[records_num].source = "";
+		records[records_num++].clock = 1;
+	}
+
+	segment = mock_pb_last_segment();
+	size_old = mock_pb_committed_size(segment);
+
+	if (SUCCEED != zbx_pb_history_write(records, records_num, &error))
+		fail_msg("[%d] cannot write records: %s", step, error);
+
+	if (SUCCEED == mock_pb_get_flag(hstep, "commit", SUCCEED))
+		return;
+
+	if (segment != mock_pb_last_segment())
+	{
+		segment = mock_pb_last_segment();
+		size_old = MOCK_PB_SEGMENT_DATA_OFFSET;
+	}
+
+	size_new = mock_pb_committed_size(segment);
+	fd = mock_pb_open_segment(segment, O_RDWR);
+
+	if (sizeof(size_old) != pwrite(fd, &size_old, sizeof(size_old),
+			offsetof(mock_pb_segment_header_t, size)))
+	{
+		fail_msg("[%d] cannot revert committed size: %s", step, zbx_strerror(errno));
+	}
+
+	/* the last record value is always within the last 16 bytes of the aligned record */
+	if (SUCCEED == mock_pb_get_flag(hstep, "torn", FAIL))
+	{
+		memset(zeros, 0, sizeof(zeros));
+
+		if (sizeof(zeros) != pwrite(fd, zeros, sizeof(zeros), (off_t)(size_new - sizeof(zeros))))
+			fail_msg("[%d] cannot tear last record: %s", step, zbx_strerror(errno));
+	}
+
+	close(fd);
+}
+
+static void	mock_pb_read(int step, zbx_mock_handle_t hstep)
+{
+	zbx_pb_history_t	records[MOCK_PB_RECORDS_MAX];
+	zbx_mock_handle_t	hrecords, hrecord;
+	zbx_mock_error_t	err;
+	char			prefix[MAX_STRING_LEN];
+	int			records_num, i;
+
+	records_num = zbx_pb_history_read(zbx_mock_get_object_member_uint64(hstep, "lastid"), records,
+			MOCK_PB_RECORDS_MAX);
+
+	hrecords = zbx_mock_get_object_member_handle(hstep, "records");
+
+	for (i = 0; ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hrecords, &hrecord)); i++)
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read expected record: %s", step, zbx_mock_error_string(err));
+
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] record #%d", step, i);
+
+		if (i >= records_num)
+			fail_msg("%s was not read", prefix);
+
+		zbx_mock_assert_uint64_eq(prefix, zbx_mock_get_object_member_uint64(hrecord, "id"), records[i].id);
+		zbx_mock_assert_str_eq(prefix, zbx_mock_get_object_member_string(hrecord, "value"), records[i].value);
+	}
+
+	zbx_snprintf(prefix, sizeof(prefix), "[%d] number of records read", step);
+	zbx_mock_assert_int_eq(prefix, i, records_num);
+}
+
+static void	mock_pb_check_segments(int step, zbx_mock_handle_t hstep)
+{
+	zbx_vector_uint64_t	segments;
+	zbx_mock_handle_t	hsegments, hsegment;
+	zbx_mock_error_t	err;
+	const char		*segment;
+	char			prefix[MAX_STRING_LEN];
+	int			i;
+
+	zbx_vector_uint64_create(&segments);
+	mock_pb_list_segments(&segments);
+
+	hsegments = zbx_mock_get_object_member_handle(hstep, "segments");
+
+	for (i = 0; ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hsegments, &hsegment)); i++)
+	{
+		if (ZBX_MOCK_SUCCESS != err || ZBX_MOCK_SUCCESS != (err = zbx_mock_string(hsegment, &segment)))
+			fail_msg("[%d] cannot read expected segment: %s", step, zbx_mock_error_string(err));
+
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] segment #%d", step, i);
+
+		if (i >= segments.values_num)
+			fail_msg("%s does not exist", prefix);
+
+		zbx_mock_assert_uint64_eq(prefix, (zbx_uint64_t)atoll(segment), segments.values[i]);
+	}
+
+	zbx_snprintf(prefix, sizeof(prefix), "[%d] number of segments", step);
+	zbx_mock_assert_int_eq(prefix, i, segments.values_num);
+
+	zbx_vector_uint64_destroy(&segments);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_pb_create_invalid_segment                                   *
+ *                                                                            *
+ * Purpose: simulates a crash while the next segment was being created        *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_pb_create_invalid_segment(void)
+{
+	int	fd;
+
+	fd = mock_pb_open_segment(mock_pb_last_segment() + 1, O_WRONLY | O_CREAT | O_TRUNC);
+
+	if (4 != write(fd, "PBSG", 4))
+		fail_msg("cannot write invalid segment: %s", zbx_strerror(errno));
+
+	close(fd);
+}
+
+static void	mock_pb_cleanup(void)
+{
+	DIR		*dir;
+	struct dirent	*d;
+	char		path[MAX_STRING_LEN];
+
+	if (NULL == (dir = opendir(pb_dir)))
+		return;
+
+	while (NULL != (d = readdir(dir)))
+	{
+		if ('.' == *d->d_name)
+			continue;
+
+		zbx_snprintf(path, sizeof(path), "%s/%s", pb_dir, d->d_name);
+		unlink(path);
+	}
+
+	closedir(dir);
+	rmdir(pb_dir);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_handle_t	hin, hsteps, hstep;
+	zbx_mock_error_t	err;
+	char			*error = NULL, prefix[MAX_STRING_LEN];
+	const char		*op;
+	int			step = 1, now;
+
+	ZBX_UNUSED(state);
+
+	if (SUCCEED != zbx_locks_create(&error))
+		fail_msg("cannot create locks: %s", error);
+
+	if (NULL == mkdtemp(pb_dir))
+		fail_msg("cannot create buffer directory: %s", zbx_strerror(errno));
+
+	hin = zbx_mock_get_parameter_handle("in");
+	segment_size = zbx_mock_get_object_member_uint64(hin, "segment size");
+	local_buffer = (int)zbx_mock_get_object_member_uint64(hin, "local buffer");
+
+	mock_pb_init();
+
+	hsteps = zbx_mock_get_object_member_handle(hin, "steps");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hsteps, &hstep)))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read step: %s", step, zbx_mock_error_string(err));
+
+		op = zbx_mock_get_object_member_string(hstep, "op");
+		zbx_snprintf(prefix, sizeof(prefix), "[%d] %s", step, op);
+
+		if (0 == strcmp(op, "write"))
+		{
+			mock_pb_write(step, hstep);
+		}
+		else if (0 == strcmp(op, "read"))
+		{
+			mock_pb_read(step, hstep);
+		}
+		else if (0 == strcmp(op, "set lastid"))
+		{
+			zbx_pb_history_set_lastid(zbx_mock_get_object_member_uint64(hstep, "lastid"));
+		}
+		else if (0 == strcmp(op, "lastid"))
+		{
+			zbx_mock_assert_uint64_eq(prefix, zbx_mock_get_object_member_uint64(hstep, "value"),
+					zbx_pb_history_get_lastid());
+		}
+		else if (0 == strcmp(op, "count"))
+		{
+			zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hstep, "value"),
+					zbx_pb_history_get_count());
+		}
+		else if (0 == strcmp(op, "segments"))
+		{
+			mock_pb_check_segments(step, hstep);
+		}
+		else if (0 == strcmp(op, "housekeep"))
+		{
+			/* clocks are relative to the current time, segments were written just now */
+			now = (int)time(NULL);
+
+			zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hstep, "return"),
+					zbx_pb_history_housekeep(now + atoi(zbx_mock_get_object_member_string(hstep,
+					"local")), now + atoi(zbx_mock_get_object_member_string(hstep, "offline"))));
+		}
+		else if (0 == strcmp(op, "create invalid segment"))
+		{
+			mock_pb_create_invalid_segment();
+		}
+		else if (0 == strcmp(op, "restart"))
+		{
+			/* destroyed mutex cannot be created again, new proxy process starts with new locks */
+			zbx_pb_destroy();
+
+			if (SUCCEED != zbx_locks_create(&error))
+				fail_msg("cannot create locks: %s", error);
+
+			mock_pb_init();
+		}
+		else
+			fail_msg("[%d] unknown operation \"%s\"", step, op);
+
+		step++;
+	}
+
+	zbx_pb_destroy();
+	mock_pb_cleanup();
+}
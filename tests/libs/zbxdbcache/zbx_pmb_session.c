@@ -0,0 +1,216 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "mutexs.h"
+#include "zbxproxybuf.h"
+
+#define PMB_SESSIONS_MAX	2
+#define PMB_READ_MAX		16
+
+/* server side data session, see zbx_dc_get_or_create_data_session() */
+typedef struct
+{
+	const char	*token;
+	zbx_uint64_t	last_valueid;
+}
+zbx_mock_session_t;
+
+static zbx_mock_session_t	sessions[PMB_SESSIONS_MAX];
+static int			sessions_num = 0, values_accepted = 0, values_rejected = 0;
+
+const char	*__wrap_zbx_dc_get_session_token(void);
+
+const char	*__wrap_zbx_dc_get_session_token(void)
+{
+	return "00000000000000000000000000000000";
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: server_process_value                                             *
+ *                                                                            *
+ * Purpose: checks value for duplicates the same way as server does when      *
+ *          processing history data received from proxy                       *
+ *                                                                            *
+ ******************************************************************************/
+static void	server_process_value(const char *token, zbx_uint64_t id)
+{
+	zbx_mock_session_t	*session;
+	int			i;
+
+	for (i = 0; i < sessions_num && 0 != strcmp(sessions[i].token, token); i++)
+		;
+
+	if (i == sessions_num)
+	{
+		if (PMB_SESSIONS_MAX == sessions_num)
+			fail_msg("unexpected data session \"%s\"", token);
+
+		sessions[sessions_num].token = token;
+		sessions[sessions_num++].last_valueid = 0;
+	}
+
+	session = &sessions[i];
+
+	if (0 != id && id <= session->last_valueid)
+	{
+		printf("value " ZBX_FS_UI64 " was discarded as duplicate in session \"%s\"\n", id, token);
+		values_rejected++;
+	}
+	else
+		values_accepted++;
+
+	session->last_valueid = id;
+}
+
+static int	pmb_write_value(const char *value)
+{
+	zbx_pb_history_t	h;
+
+	memset(&h, 0, sizeof(h));
+	h.itemid = 1;
+	h.value = value;
+	h.source = "";
+
+	return zbx_pmb_history_write(&h, 1);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_send_memory                                                  *
+ *                                                                            *
+ * Purpose: sends and acknowledges all unacknowledged buffer records          *
+ *                                                                            *
+ ******************************************************************************/
+static void	pmb_send_memory(void)
+{
+	zbx_pb_history_t	records[PMB_READ_MAX];
+	zbx_uint64_t		lastid;
+	int			i, records_num;
+
+	while (ZBX_PMB_READ_MEMORY == zbx_pmb_read_begin(ZBX_PMB_HISTORY, &lastid))
+	{
+		if (0 == (records_num = zbx_pmb_history_read(lastid, records, PMB_READ_MAX)))
+			fail_msg("no records were read from memory buffer");
+
+		for (i = 0; i < records_num; i++)
+			server_process_value(zbx_pmb_get_session_token(), records[i].id);
+
+		zbx_mock_assert_int_eq("acknowledge buffer records", SUCCEED,
+				zbx_pmb_set_lastid(ZBX_PMB_HISTORY, records[records_num - 1].id));
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: pmb_send_database                                                *
+ *                                                                            *
+ * Purpose: switches history to database mode by filling the buffer, sends   *
+ *          the buffer records and then the specified number of database      *
+ *          records                                                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	pmb_send_database(int values_num, zbx_uint64_t *db_lastid)
+{
+	char		value[ZBX_KIBIBYTE];
+	zbx_uint64_t	lastid;
+	int		i;
+
+	memset(value, 'x', sizeof(value) - 1);
+	value[sizeof(value) - 1] = '\0';
+
+	while (SUCCEED == pmb_write_value(value))
+		;
+
+	zbx_pmb_db_release();
+
+	pmb_send_memory();
+
+	zbx_mock_assert_int_eq("history data source", ZBX_PMB_READ_DATABASE,
+			zbx_pmb_read_begin(ZBX_PMB_HISTORY, &lastid));
+
+	for (i = 0; i < values_num; i++)
+		server_process_value(zbx_pmb_get_session_token(), ++(*db_lastid));
+
+	/* database has no more records, switch back to memory mode */
+	zbx_mock_assert_int_eq("history data source", ZBX_PMB_READ_DATABASE,
+			zbx_pmb_read_begin(ZBX_PMB_HISTORY, &lastid));
+	zbx_pmb_database_drained(ZBX_PMB_HISTORY);
+}
+
+static void	pmb_send_buffer(int values_num)
+{
+	int	i;
+
+	for (i = 0; i < values_num; i++)
+		zbx_mock_assert_int_eq("buffer write", SUCCEED, pmb_write_value("value"));
+
+	pmb_send_memory();
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_handle_t	hsteps, hstep;
+	zbx_mock_error_t	err;
+	zbx_uint64_t		db_lastid = 0, lastid;
+	char			*error = NULL;
+	const char		*source;
+	int			values_num;
+
+	ZBX_UNUSED(state);
+
+	if (SUCCEED != zbx_locks_create(&error))
+		fail_msg("cannot create locks: %s", error);
+
+	if (SUCCEED != zbx_pmb_init(zbx_mock_get_parameter_uint64("in.size"), 0, &error))
+		fail_msg("cannot initialize proxy memory buffer: %s", error);
+
+	/* history starts in database mode to send records left by previous proxy run */
+	zbx_mock_assert_int_eq("initial history data source", ZBX_PMB_READ_DATABASE,
+			zbx_pmb_read_begin(ZBX_PMB_HISTORY, &lastid));
+	zbx_pmb_database_drained(ZBX_PMB_HISTORY);
+
+	hsteps = zbx_mock_get_parameter_handle("in.steps");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = zbx_mock_vector_element(hsteps, &hstep)))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("cannot read step: %s", zbx_mock_error_string(err));
+
+		source = zbx_mock_get_object_member_string(hstep, "source");
+		values_num = (int)zbx_mock_get_object_member_uint64(hstep, "values");
+
+		if (0 == strcmp(source, "database"))
+			pmb_send_database(values_num, &db_lastid);
+		else if (0 == strcmp(source, "memory"))
+			pmb_send_buffer(values_num);
+		else
+			fail_msg("unknown data source \"%s\"", source);
+	}
+
+	zbx_mock_assert_int_eq("discarded values", 0, values_rejected);
+	zbx_mock_assert_int_ne("accepted values", 0, values_accepted);
+
+	zbx_pmb_destroy();
+}
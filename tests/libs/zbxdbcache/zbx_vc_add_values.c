@@ -52,6 +52,7 @@ void	zbx_mock_test_entry(void **state)
 
 	/* set small cache size to force smaller cache free request size (5% of cache size) */
 	CONFIG_VALUE_CACHE_SIZE = ZBX_KIBIBYTE;
+	zbx_vcmock_set_compression(zbx_mock_get_parameter_handle("in"), "compression");
 
 	err = zbx_locks_create(&error);
 	zbx_mock_assert_result_eq("Lock initialization failed", SUCCEED, err);
@@ -158,6 +159,8 @@ void	zbx_mock_test_entry(void **state)
 	zbx_mock_assert_int_eq("cache.mode", zbx_vcmock_str_to_cache_mode(zbx_mock_get_parameter_string("out.cache.mode")),
 			cache_mode);
 
+	zbx_vcmock_check_packed_values(zbx_mock_get_parameter_handle("out.cache"), "packed values");
+
 	/* cleanup */
 
 	zbx_vector_history_record_destroy(&returned);
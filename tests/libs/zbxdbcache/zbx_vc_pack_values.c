@@ -0,0 +1,80 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "log.h"
+#include "valuecache.h"
+#include "valuecache_test.h"
+#include "mocks/valuecache/valuecache_mock.h"
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_mock_test_entry                                              *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_vector_history_record_t	values;
+	zbx_history_record_t		*unpacked;
+	unsigned char			value_type;
+	int				i, size;
+	char				prefix[MAX_STRING_LEN];
+
+	ZBX_UNUSED(state);
+
+	if (0 != setenv("TZ", "UTC", 1))
+		fail_msg("Cannot set 'TZ' environment variable: %s", zbx_strerror(errno));
+
+	tzset();
+
+	value_type = zbx_mock_str_to_value_type(zbx_mock_get_parameter_string("in.value_type"));
+
+	zbx_history_record_vector_create(&values);
+	zbx_vcmock_read_values(zbx_mock_get_parameter_handle("in.values"), value_type, &values);
+
+	unpacked = (zbx_history_record_t *)zbx_malloc(NULL, sizeof(zbx_history_record_t) * (values.values_num + 1));
+	size = zbx_vc_pack_values(values.values, values.values_num, value_type, unpacked);
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("out.size"))
+		zbx_mock_assert_int_eq("compressed size", (int)zbx_mock_get_parameter_uint64("out.size"), size);
+
+	for (i = 0; i < values.values_num; i++)
+	{
+		zbx_snprintf(prefix, sizeof(prefix), "value #%d", i + 1);
+		zbx_mock_assert_timespec_eq(prefix, &values.values[i].timestamp, &unpacked[i].timestamp);
+
+		/* values must be restored bit by bit, including negative zero, infinities and NaN */
+		if (0 != memcmp(&values.values[i].value, &unpacked[i].value, sizeof(history_value_t)))
+		{
+			char	expected[MAX_STRING_LEN], returned[MAX_STRING_LEN];
+
+			zbx_history_value2str(expected, sizeof(expected), &values.values[i].value, value_type);
+			zbx_history_value2str(returned, sizeof(returned), &unpacked[i].value, value_type);
+			fail_msg("%s: expected \"%s\" while returned \"%s\"", prefix, expected, returned);
+		}
+	}
+
+	zbx_free(unpacked);
+	zbx_history_record_vector_destroy(&values, value_type);
+}
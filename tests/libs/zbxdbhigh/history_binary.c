@@ -0,0 +1,236 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "history_binary_test.h"
+
+#define HISTORY_BINARY_VALUES_MAX	256
+
+static int	mock_get_object_member_int(zbx_mock_handle_t object, const char *name, int default_value)
+{
+	zbx_mock_handle_t	hmember;
+	const char		*str;
+	zbx_mock_error_t	err;
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_object_member(object, name, &hmember))
+		return default_value;
+
+	if (ZBX_MOCK_SUCCESS != (err = zbx_mock_string(hmember, &str)))
+		fail_msg("Cannot read \"%s\": %s", name, zbx_mock_error_string(err));
+
+	return atoi(str);
+}
+
+static const char	*mock_get_object_member_str(zbx_mock_handle_t object, const char *name)
+{
+	zbx_mock_handle_t	hmember;
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_object_member(object, name, &hmember))
+		return NULL;
+
+	return zbx_mock_get_object_member_string(object, name);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_read_values                                                 *
+ *                                                                            *
+ * Purpose: reads item values from test case data, optional log and meta      *
+ *          fields are set only if present                                    *
+ *                                                                            *
+ ******************************************************************************/
+static int	mock_read_values(const char *path, zbx_agent_value_t *values, zbx_uint64_t *itemids)
+{
+	zbx_mock_handle_t	hvalues, hvalue, hmember;
+	const char		*str;
+	int			values_num = 0;
+
+	hvalues = zbx_mock_get_parameter_handle(path);
+
+	while (ZBX_MOCK_SUCCESS == zbx_mock_vector_element(hvalues, &hvalue))
+	{
+		zbx_agent_value_t	*av;
+
+		if (HISTORY_BINARY_VALUES_MAX == values_num)
+			fail_msg("too many values in test case data");
+
+		av = &values[values_num];
+		memset(av, 0, sizeof(zbx_agent_value_t));
+
+		av->id = zbx_mock_get_object_member_uint64(hvalue, "id");
+		itemids[values_num] = zbx_mock_get_object_member_uint64(hvalue, "itemid");
+		av->ts.sec = mock_get_object_member_int(hvalue, "clock", 0);
+		av->ts.ns = mock_get_object_member_int(hvalue, "ns", 0);
+
+		if (NULL != (str = mock_get_object_member_str(hvalue, "value")))
+			av->value = zbx_strdup(NULL, str);
+
+		if (NULL != (str = mock_get_object_member_str(hvalue, "source")))
+			av->source = zbx_strdup(NULL, str);
+
+		av->timestamp = mock_get_object_member_int(hvalue, "timestamp", 0);
+		av->severity = mock_get_object_member_int(hvalue, "severity", 0);
+		av->logeventid = mock_get_object_member_int(hvalue, "logeventid", 0);
+
+		if (NULL != (str = mock_get_object_member_str(hvalue, "state")) && 0 == strcmp(str, "notsupported"))
+			av->state = ITEM_STATE_NOTSUPPORTED;
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hvalue, "lastlogsize", &hmember))
+		{
+			av->meta = 1;
+			av->lastlogsize = zbx_mock_get_object_member_uint64(hvalue, "lastlogsize");
+			av->mtime = mock_get_object_member_int(hvalue, "mtime", 0);
+		}
+
+		values_num++;
+	}
+
+	return values_num;
+}
+
+static void	mock_compare_str(int row, const char *name, const char *expected, const char *returned)
+{
+	char	prefix[MAX_STRING_LEN];
+
+	zbx_snprintf(prefix, sizeof(prefix), "row #%d %s", row + 1, name);
+
+	if (NULL == expected || NULL == returned)
+	{
+		if (expected != returned)
+			fail_msg("%s: expected %s while returned %s", prefix, ZBX_NULL2STR(expected), ZBX_NULL2STR(returned));
+
+		return;
+	}
+
+	zbx_mock_assert_str_eq(prefix, expected, returned);
+}
+
+static void	mock_compare_values(const zbx_agent_value_t *expected, const zbx_uint64_t *expected_itemids,
+		int expected_num, const zbx_agent_value_t *returned, const zbx_uint64_t *returned_itemids,
+		int returned_num)
+{
+	int	i;
+
+	zbx_mock_assert_int_eq("number of decoded values", expected_num, returned_num);
+
+	for (i = 0; i < expected_num; i++)
+	{
+		const zbx_agent_value_t	*e = &expected[i], *r = &returned[i];
+
+		zbx_mock_assert_uint64_eq("id", e->id, r->id);
+		zbx_mock_assert_uint64_eq("itemid", expected_itemids[i], returned_itemids[i]);
+		zbx_mock_assert_int_eq("clock", e->ts.sec, r->ts.sec);
+		zbx_mock_assert_int_eq("ns", e->ts.ns, r->ts.ns);
+		zbx_mock_assert_int_eq("state", e->state, r->state);
+		mock_compare_str(i, "value", e->value, r->value);
+		mock_compare_str(i, "source", e->source, r->source);
+		zbx_mock_assert_int_eq("timestamp", e->timestamp, r->timestamp);
+		zbx_mock_assert_int_eq("severity", e->severity, r->severity);
+		zbx_mock_assert_int_eq("logeventid", e->logeventid, r->logeventid);
+		zbx_mock_assert_int_eq("meta", e->meta, r->meta);
+		zbx_mock_assert_uint64_eq("lastlogsize", e->lastlogsize, r->lastlogsize);
+		zbx_mock_assert_int_eq("mtime", e->mtime, r->mtime);
+	}
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_agent_value_t	values[HISTORY_BINARY_VALUES_MAX], decoded[HISTORY_BINARY_VALUES_MAX];
+	zbx_uint64_t		itemids[HISTORY_BINARY_VALUES_MAX], decoded_itemids[HISTORY_BINARY_VALUES_MAX];
+	int			values_num = 0, decoded_num, ret, expected_ret;
+	char			*data = NULL, *error = NULL;
+	const char		*block;
+	size_t			data_len, block_len;
+	zbx_mock_handle_t	handle;
+	zbx_mock_error_t	err;
+
+	ZBX_UNUSED(state);
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("in.values"))
+	{
+		values_num = mock_read_values("in.values", values, itemids);
+		history_binary_encode_test(values, itemids, values_num, &data, &data_len);
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("out.block"))
+		{
+			if (ZBX_MOCK_SUCCESS != (err = zbx_mock_binary(zbx_mock_get_parameter_handle("out.block"),
+					&block, &block_len)))
+			{
+				fail_msg("Cannot read expected block: %s", zbx_mock_error_string(err));
+			}
+
+			zbx_mock_assert_uint64_eq("encoded block size", block_len, data_len);
+
+			if (0 != memcmp(block, data, data_len))
+				fail_msg("encoded block does not match expected block");
+		}
+
+		/* remove the specified number of bytes from the end to simulate truncated data */
+		if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("in.truncate"))
+			data_len -= (size_t)zbx_mock_get_parameter_uint64("in.truncate");
+	}
+	else
+	{
+		handle = zbx_mock_get_parameter_handle("in.block");
+
+		if (ZBX_MOCK_SUCCESS != (err = zbx_mock_binary(handle, &block, &block_len)))
+			fail_msg("Cannot read block: %s", zbx_mock_error_string(err));
+
+		/* copy block so that reading past its end can be detected by memory checkers */
+		data = (char *)zbx_malloc(NULL, block_len + 1);
+		memcpy(data, block, block_len);
+		data_len = block_len;
+	}
+
+	ret = history_binary_decode_test(data, data_len, decoded, decoded_itemids, &decoded_num, &error);
+	expected_ret = zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.return"));
+
+	if (SUCCEED != ret && SUCCEED == expected_ret)
+		fail_msg("Cannot decode binary history data: %s", error);
+
+	zbx_mock_assert_int_eq("decode return value", expected_ret, ret);
+
+	if (SUCCEED == ret)
+	{
+		if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("out.values"))
+		{
+			zbx_agent_value_t	expected[HISTORY_BINARY_VALUES_MAX];
+			zbx_uint64_t		expected_itemids[HISTORY_BINARY_VALUES_MAX];
+			int			expected_num;
+
+			expected_num = mock_read_values("out.values", expected, expected_itemids);
+			mock_compare_values(expected, expected_itemids, expected_num, decoded, decoded_itemids,
+					decoded_num);
+			history_binary_values_clean_test(expected, expected_num);
+		}
+		else
+			mock_compare_values(values, itemids, values_num, decoded, decoded_itemids, decoded_num);
+
+		history_binary_values_clean_test(decoded, decoded_num);
+	}
+
+	history_binary_values_clean_test(values, values_num);
+	zbx_free(data);
+	zbx_free(error);
+}
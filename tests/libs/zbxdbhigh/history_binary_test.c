@@ -0,0 +1,107 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "history_binary_test.h"
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_encode_test                                       *
+ *                                                                            *
+ * Purpose: encodes item values into binary history data block in the same    *
+ *          way as proxy encodes history table records                        *
+ *                                                                            *
+ ******************************************************************************/
+void	history_binary_encode_test(const zbx_agent_value_t *values, const zbx_uint64_t *itemids, int values_num,
+		char **data, size_t *data_len)
+{
+	zbx_history_binary_t	bin;
+	zbx_history_data_t	hd;
+	char			*string_buffer = NULL;
+	size_t			string_buffer_alloc = 0, string_buffer_offset;
+	int			i;
+
+	memset(&bin, 0, sizeof(bin));
+
+	for (i = 0; i < values_num; i++)
+	{
+		const zbx_agent_value_t	*av = &values[i];
+
+		memset(&hd, 0, sizeof(hd));
+
+		hd.id = av->id;
+		hd.itemid = itemids[i];
+		hd.clock = av->ts.sec;
+		hd.ns = av->ts.ns;
+		hd.timestamp = av->timestamp;
+		hd.severity = av->severity;
+		hd.logeventid = av->logeventid;
+		hd.state = av->state;
+
+		if (NULL == av->value)
+			hd.flags |= PROXY_HISTORY_FLAG_NOVALUE;
+
+		if (0 != av->meta)
+		{
+			hd.flags |= PROXY_HISTORY_FLAG_META;
+			hd.lastlogsize = av->lastlogsize;
+			hd.mtime = av->mtime;
+		}
+
+		/* value and source are stored in string buffer as separate null terminated strings */
+		string_buffer_offset = 0;
+		zbx_strcpy_alloc(&string_buffer, &string_buffer_alloc, &string_buffer_offset,
+				ZBX_NULL2EMPTY_STR(av->value));
+		hd.source_offset = ++string_buffer_offset;
+		zbx_strcpy_alloc(&string_buffer, &string_buffer_alloc, &string_buffer_offset,
+				ZBX_NULL2EMPTY_STR(av->source));
+
+		history_binary_add_row(&bin, &hd, string_buffer);
+	}
+
+	history_binary_finish(&bin, data, data_len);
+	history_binary_clear(&bin);
+
+	zbx_free(string_buffer);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: history_binary_decode_test                                       *
+ *                                                                            *
+ * Purpose: decodes up to ZBX_HISTORY_VALUES_MAX item values from binary      *
+ *          history data block in the same way as server decodes them         *
+ *                                                                            *
+ ******************************************************************************/
+int	history_binary_decode_test(const char *data, size_t size, zbx_agent_value_t *values, zbx_uint64_t *itemids,
+		int *values_num, char **error)
+{
+	zbx_history_binary_reader_t	reader;
+
+	*values_num = 0;
+
+	if (SUCCEED != history_binary_reader_init(&reader, data, size, error))
+		return FAIL;
+
+	return parse_history_data_binary(&reader, values, itemids, values_num, error);
+}
+
+void	history_binary_values_clean_test(zbx_agent_value_t *values, int values_num)
+{
+	zbx_agent_values_clean(values, (size_t)values_num);
+}
@@ -0,0 +1,31 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef HISTORY_BINARY_TEST_H
+#define HISTORY_BINARY_TEST_H
+
+#include "dbcache.h"
+
+void	history_binary_encode_test(const zbx_agent_value_t *values, const zbx_uint64_t *itemids, int values_num,
+		char **data, size_t *data_len);
+int	history_binary_decode_test(const char *data, size_t size, zbx_agent_value_t *values, zbx_uint64_t *itemids,
+		int *values_num, char **error);
+void	history_binary_values_clean_test(zbx_agent_value_t *values, int values_num);
+
+#endif
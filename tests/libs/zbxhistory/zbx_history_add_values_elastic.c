@@ -0,0 +1,558 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "zbxalgo.h"
+#include "zbxjson.h"
+#include "zbxhistory.h"
+#include "db.h"
+#include "dbcache.h"
+
+extern char	*CONFIG_HISTORY_STORAGE_URL;
+extern char	*CONFIG_HISTORY_STORAGE_OPTS;
+extern int	CONFIG_HISTORY_STORAGE_CONCURRENCY;
+
+void	__wrap_zbx_sleep_loop(int sleeptime);
+zbx_uint64_t	__wrap_DCget_nextid(const char *table_name, int num);
+int	__wrap_zbx_interface_availability_is_set(const zbx_interface_availability_t *ha);
+int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_t objectid,
+		const zbx_timespec_t *timespec, int value, const char *trigger_description,
+		const char *trigger_expression, const char *trigger_recovery_expression, unsigned char trigger_priority,
+		unsigned char trigger_type, const zbx_vector_ptr_t *trigger_tags,
+		unsigned char trigger_correlation_mode, const char *trigger_correlation_tag,
+		unsigned char trigger_value, const char *trigger_opdata, const char *error);
+int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock);
+void	__wrap_zbx_clean_events(void);
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted);
+
+void	__wrap_zbx_sleep_loop(int sleeptime)
+{
+	ZBX_UNUSED(sleeptime);
+}
+
+zbx_uint64_t	__wrap_DCget_nextid(const char *table_name, int num)
+{
+	ZBX_UNUSED(table_name);
+	ZBX_UNUSED(num);
+
+	return 0;
+}
+
+int	__wrap_zbx_interface_availability_is_set(const zbx_interface_availability_t *ha)
+{
+	ZBX_UNUSED(ha);
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_t objectid,
+		const zbx_timespec_t *timespec, int value, const char *trigger_description,
+		const char *trigger_expression, const char *trigger_recovery_expression, unsigned char trigger_priority,
+		unsigned char trigger_type, const zbx_vector_ptr_t *trigger_tags,
+		unsigned char trigger_correlation_mode, const char *trigger_correlation_tag,
+		unsigned char trigger_value, const char *trigger_opdata, const char *error)
+{
+	ZBX_UNUSED(source);
+	ZBX_UNUSED(object);
+	ZBX_UNUSED(objectid);
+	ZBX_UNUSED(timespec);
+	ZBX_UNUSED(value);
+	ZBX_UNUSED(trigger_description);
+	ZBX_UNUSED(trigger_expression);
+	ZBX_UNUSED(trigger_recovery_expression);
+	ZBX_UNUSED(trigger_priority);
+	ZBX_UNUSED(trigger_type);
+	ZBX_UNUSED(trigger_tags);
+	ZBX_UNUSED(trigger_correlation_mode);
+	ZBX_UNUSED(trigger_correlation_tag);
+	ZBX_UNUSED(trigger_value);
+	ZBX_UNUSED(trigger_opdata);
+	ZBX_UNUSED(error);
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock)
+{
+	ZBX_UNUSED(trigger_diff);
+	ZBX_UNUSED(triggerids_lock);
+
+	return SUCCEED;
+}
+
+void	__wrap_zbx_clean_events(void)
+{
+}
+
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted)
+{
+	ZBX_UNUSED(clock);
+	ZBX_UNUSED(host);
+	ZBX_UNUSED(ip);
+	ZBX_UNUSED(dns);
+	ZBX_UNUSED(port);
+	ZBX_UNUSED(host_metadata);
+	ZBX_UNUSED(flags);
+	ZBX_UNUSED(tls_accepted);
+
+	return FAIL;
+}
+
+
+#if defined(HAVE_LIBCURL) && LIBCURL_VERSION_NUM >= 0x071c00
+
+/* the largest bulk request - the bulk size and one value */
+#define MOCK_ES_BULK_MAX	(ZBX_MEBIBYTE + 256)
+
+CURL	*__wrap_curl_easy_init(void);
+void	__wrap_curl_easy_cleanup(CURL *handle);
+CURLcode	__wrap_curl_easy_setopt(CURL *handle, CURLoption option, ...);
+CURLcode	__wrap_curl_easy_getinfo(CURL *handle, CURLINFO info, ...);
+CURLM	*__wrap_curl_multi_init(void);
+CURLMcode	__wrap_curl_multi_cleanup(CURLM *multi_handle);
+CURLMcode	__wrap_curl_multi_add_handle(CURLM *multi_handle, CURL *handle);
+CURLMcode	__wrap_curl_multi_remove_handle(CURLM *multi_handle, CURL *handle);
+CURLMcode	__wrap_curl_multi_perform(CURLM *multi_handle, int *running_handles);
+CURLMcode	__wrap_curl_multi_wait(CURLM *multi_handle, struct curl_waitfd extra_fds[], unsigned int extra_nfds,
+		int timeout_ms, int *ret);
+CURLMsg	*__wrap_curl_multi_info_read(CURLM *multi_handle, int *msgs_in_queue);
+unsigned int	__wrap_sleep(unsigned int seconds);
+
+/* the bulk request handle */
+typedef struct
+{
+	curl_write_callback	write_cb;
+	void			*write_data;
+	void			*private_data;
+	const char		*body;
+	long			body_size;
+	CURLcode		result;
+}
+zbx_mock_es_handle_t;
+
+/* the mocked Elasticsearch, serving bulk requests sent through cURL multi handle */
+typedef struct
+{
+	/* the sent requests, completed one at a time when the writer waits for network activity */
+	zbx_vector_ptr_t	running;
+	zbx_vector_ptr_t	done;
+	int			running_max;
+
+	/* the number of times each value was stored */
+	int			*stored;
+	int			values_num;
+
+	/* the request numbers failing with transport error, storage error or rejected by storage */
+	zbx_vector_uint64_t	fail;
+	zbx_vector_uint64_t	error;
+	zbx_vector_uint64_t	reject;
+
+	int			requests;
+	int			sleeps;
+	int			multi;
+	CURLMsg			msg;
+}
+zbx_mock_es_t;
+
+static zbx_mock_es_t	es;
+
+static void	mock_es_read_requests(const char *path, zbx_vector_uint64_t *requests)
+{
+	zbx_mock_handle_t	hrequests, hrequest;
+	zbx_uint64_t		request;
+
+	zbx_vector_uint64_create(requests);
+
+	hrequests = zbx_mock_get_parameter_handle(path);
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hrequests, &hrequest))
+	{
+		if (ZBX_MOCK_SUCCESS != zbx_mock_uint64(hrequest, &request))
+			fail_msg("invalid request number in \"%s\"", path);
+
+		zbx_vector_uint64_append(requests, request);
+	}
+}
+
+static void	mock_es_init(int values_num)
+{
+	memset(&es, 0, sizeof(es));
+
+	zbx_vector_ptr_create(&es.running);
+	zbx_vector_ptr_create(&es.done);
+
+	es.values_num = values_num;
+	es.stored = (int *)zbx_calloc(NULL, (size_t)values_num, sizeof(int));
+
+	mock_es_read_requests("in.fail", &es.fail);
+	mock_es_read_requests("in.error", &es.error);
+	mock_es_read_requests("in.reject", &es.reject);
+}
+
+static void	mock_es_clear(void)
+{
+	zbx_vector_ptr_destroy(&es.running);
+	zbx_vector_ptr_destroy(&es.done);
+	zbx_vector_uint64_destroy(&es.fail);
+	zbx_vector_uint64_destroy(&es.error);
+	zbx_vector_uint64_destroy(&es.reject);
+	zbx_free(es.stored);
+}
+
+static void	mock_es_respond(zbx_mock_es_handle_t *h, const char *data)
+{
+	h->write_cb((char *)data, 1, strlen(data), h->write_data);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_es_store                                                    *
+ *                                                                            *
+ * Purpose: stores values from bulk request body                              *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_es_store(const zbx_mock_es_handle_t *h)
+{
+	const char		*ptr, *end;
+	struct zbx_json_parse	jp;
+	char			buf[MAX_STRING_LEN], *doc = NULL;
+	zbx_uint64_t		itemid;
+
+	if (MOCK_ES_BULK_MAX < h->body_size)
+		fail_msg("bulk request size %ld exceeds bulk size", h->body_size);
+
+	if (0 == h->body_size || '\n' != h->body[h->body_size - 1])
+		fail_msg("bulk request is not terminated by newline");
+
+	for (ptr = h->body; ptr < h->body + h->body_size; ptr = end + 1)
+	{
+		end = strchr(ptr, '\n');
+
+		if (0 != strncmp(ptr, "{\"index\":{\"_index\":\"uint\"}}\n", (size_t)(end - ptr + 1)))
+			fail_msg("unexpected bulk action \"%.*s\"", (int)(end - ptr), ptr);
+
+		ptr = end + 1;
+		end = strchr(ptr, '\n');
+		doc = zbx_dsprintf(doc, "%.*s", (int)(end - ptr), ptr);
+
+		if (SUCCEED != zbx_json_open(doc, &jp) ||
+				SUCCEED != zbx_json_value_by_name(&jp, "itemid", buf, sizeof(buf), NULL) ||
+				SUCCEED != is_uint64(buf, &itemid))
+		{
+			fail_msg("invalid history document \"%s\"", doc);
+		}
+
+		if (0 == itemid || itemid > (zbx_uint64_t)es.values_num)
+			fail_msg("unexpected itemid " ZBX_FS_UI64, itemid);
+
+		es.stored[itemid - 1]++;
+	}
+
+	zbx_free(doc);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_es_complete                                                 *
+ *                                                                            *
+ * Purpose: completes the oldest running request                              *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_es_complete(void)
+{
+	zbx_mock_es_handle_t	*h;
+	zbx_uint64_t		request;
+
+	if (0 == es.running.values_num)
+		return;
+
+	h = (zbx_mock_es_handle_t *)es.running.values[0];
+	zbx_vector_ptr_remove(&es.running, 0);
+
+	request = (zbx_uint64_t)++es.requests;
+	h->result = CURLE_OK;
+
+	if (FAIL != zbx_vector_uint64_search(&es.fail, request, ZBX_DEFAULT_UINT64_COMPARE_FUNC))
+	{
+		h->result = CURLE_COULDNT_CONNECT;
+	}
+	else if (FAIL != zbx_vector_uint64_search(&es.reject, request, ZBX_DEFAULT_UINT64_COMPARE_FUNC))
+	{
+		h->result = CURLE_HTTP_RETURNED_ERROR;
+	}
+	else if (FAIL != zbx_vector_uint64_search(&es.error, request, ZBX_DEFAULT_UINT64_COMPARE_FUNC))
+	{
+		mock_es_respond(h, "{\"took\":1,\"errors\":true,\"items\":[{\"index\":{\"_index\":\"uint\","
+				"\"status\":429,\"error\":{\"type\":\"es_rejected_execution_exception\","
+				"\"reason\":\"rejected execution\"}}}]}");
+	}
+	else
+	{
+		mock_es_store(h);
+		mock_es_respond(h, "{\"took\":1,\"errors\":false,\"items\":[]}");
+	}
+
+	zbx_vector_ptr_append(&es.done, h);
+}
+
+CURL	*__wrap_curl_easy_init(void)
+{
+	return (CURL *)zbx_calloc(NULL, 1, sizeof(zbx_mock_es_handle_t));
+}
+
+void	__wrap_curl_easy_cleanup(CURL *handle)
+{
+	zbx_free(handle);
+}
+
+CURLcode	__wrap_curl_easy_setopt(CURL *handle, CURLoption option, ...)
+{
+	va_list			args;
+	const char		*str;
+	zbx_mock_es_handle_t	*h = (zbx_mock_es_handle_t *)handle;
+
+	va_start(args, option);
+
+	switch (option)
+	{
+		case CURLOPT_URL:
+			str = va_arg(args, const char *);
+			zbx_mock_assert_str_eq("bulk request url", "http://localhost:9200/_bulk?refresh=true", str);
+			break;
+		case CURLOPT_WRITEFUNCTION:
+			h->write_cb = va_arg(args, curl_write_callback);
+			break;
+		case CURLOPT_WRITEDATA:
+			h->write_data = va_arg(args, void *);
+			break;
+		case CURLOPT_PRIVATE:
+			h->private_data = va_arg(args, void *);
+			break;
+		case CURLOPT_POSTFIELDS:
+			h->body = va_arg(args, const char *);
+			break;
+		case CURLOPT_POSTFIELDSIZE:
+			h->body_size = va_arg(args, long);
+			break;
+		default:
+			break;
+	}
+
+	va_end(args);
+
+	return CURLE_OK;
+}
+
+CURLcode	__wrap_curl_easy_getinfo(CURL *handle, CURLINFO info, ...)
+{
+	va_list			args;
+	zbx_mock_es_handle_t	*h = (zbx_mock_es_handle_t *)handle;
+
+	va_start(args, info);
+
+	switch (info)
+	{
+		case CURLINFO_PRIVATE:
+			*va_arg(args, char **) = (char *)h->private_data;
+			break;
+		case CURLINFO_RESPONSE_CODE:
+			*va_arg(args, long *) = 400;
+			break;
+		default:
+			fail_msg("unexpected cURL info %d", (int)info);
+	}
+
+	va_end(args);
+
+	return CURLE_OK;
+}
+
+CURLM	*__wrap_curl_multi_init(void)
+{
+	return (CURLM *)&es.multi;
+}
+
+CURLMcode	__wrap_curl_multi_cleanup(CURLM *multi_handle)
+{
+	ZBX_UNUSED(multi_handle);
+
+	return CURLM_OK;
+}
+
+CURLMcode	__wrap_curl_multi_add_handle(CURLM *multi_handle, CURL *handle)
+{
+	ZBX_UNUSED(multi_handle);
+
+	zbx_vector_ptr_append(&es.running, handle);
+
+	if (es.running_max < es.running.values_num)
+		es.running_max = es.running.values_num;
+
+	return CURLM_OK;
+}
+
+CURLMcode	__wrap_curl_multi_remove_handle(CURLM *multi_handle, CURL *handle)
+{
+	int	i;
+
+	ZBX_UNUSED(multi_handle);
+
+	if (FAIL != (i = zbx_vector_ptr_search(&es.running, handle, ZBX_DEFAULT_PTR_COMPARE_FUNC)))
+		zbx_vector_ptr_remove(&es.running, i);
+
+	if (FAIL != (i = zbx_vector_ptr_search(&es.done, handle, ZBX_DEFAULT_PTR_COMPARE_FUNC)))
+		zbx_vector_ptr_remove(&es.done, i);
+
+	return CURLM_OK;
+}
+
+CURLMcode	__wrap_curl_multi_perform(CURLM *multi_handle, int *running_handles)
+{
+	ZBX_UNUSED(multi_handle);
+
+	*running_handles = es.running.values_num;
+
+	return CURLM_OK;
+}
+
+CURLMcode	__wrap_curl_multi_wait(CURLM *multi_handle, struct curl_waitfd extra_fds[], unsigned int extra_nfds,
+		int timeout_ms, int *ret)
+{
+	ZBX_UNUSED(multi_handle);
+	ZBX_UNUSED(extra_fds);
+	ZBX_UNUSED(extra_nfds);
+	ZBX_UNUSED(timeout_ms);
+
+	mock_es_complete();
+	*ret = 1;
+
+	return CURLM_OK;
+}
+
+CURLMsg	*__wrap_curl_multi_info_read(CURLM *multi_handle, int *msgs_in_queue)
+{
+	zbx_mock_es_handle_t	*h;
+
+	ZBX_UNUSED(multi_handle);
+
+	if (0 == es.done.values_num)
+	{
+		*msgs_in_queue = 0;
+		return NULL;
+	}
+
+	h = (zbx_mock_es_handle_t *)es.done.values[0];
+	zbx_vector_ptr_remove(&es.done, 0);
+	*msgs_in_queue = es.done.values_num;
+
+	es.msg.msg = CURLMSG_DONE;
+	es.msg.easy_handle = (CURL *)h;
+	es.msg.data.result = h->result;
+
+	return &es.msg;
+}
+
+unsigned int	__wrap_sleep(unsigned int seconds)
+{
+	ZBX_UNUSED(seconds);
+
+	es.sleeps++;
+
+	return 0;
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	char			*error = NULL;
+	int			err, i, values_num, stored = 0;
+	zbx_vector_ptr_t	history;
+	ZBX_DC_HISTORY		*h;
+
+	ZBX_UNUSED(state);
+
+	CONFIG_HISTORY_STORAGE_URL = zbx_strdup(NULL, "http://localhost:9200");
+	CONFIG_HISTORY_STORAGE_OPTS = zbx_strdup(NULL, "dbl,str,log,uint,text");
+	CONFIG_HISTORY_STORAGE_CONCURRENCY = (int)zbx_mock_get_parameter_uint64("in.concurrency");
+
+	err = zbx_history_init(&error);
+	zbx_mock_assert_result_eq("zbx_history_init()", SUCCEED, err);
+
+	values_num = (int)zbx_mock_get_parameter_uint64("in.values");
+	mock_es_init(values_num);
+
+	zbx_vector_ptr_create(&history);
+	h = (ZBX_DC_HISTORY *)zbx_calloc(NULL, (size_t)values_num, sizeof(ZBX_DC_HISTORY));
+
+	for (i = 0; i < values_num; i++)
+	{
+		h[i].itemid = (zbx_uint64_t)i + 1;
+		h[i].value_type = ITEM_VALUE_TYPE_UINT64;
+		h[i].value.ui64 = (zbx_uint64_t)i;
+		h[i].ts.sec = 1609459200 + i;
+		h[i].ts.ns = 0;
+		h[i].ttl = 604800;
+		zbx_vector_ptr_append(&history, &h[i]);
+	}
+
+	err = zbx_history_add_values(&history);
+	zbx_mock_assert_result_eq("zbx_history_add_values()", SUCCEED, err);
+
+	if (0 != es.running.values_num || 0 != es.done.values_num)
+		fail_msg("requests are left running after history is flushed");
+
+	zbx_mock_assert_int_eq("sent requests", (int)zbx_mock_get_parameter_uint64("out.requests"), es.requests);
+	zbx_mock_assert_int_eq("running requests", (int)zbx_mock_get_parameter_uint64("out.running"),
+			es.running_max);
+	zbx_mock_assert_int_eq("retries", (int)zbx_mock_get_parameter_uint64("out.retries"), es.sleeps);
+
+	for (i = 0; i < values_num; i++)
+	{
+		if (1 < es.stored[i])
+			fail_msg("value %d is stored more than once", i);
+
+		stored += es.stored[i];
+	}
+
+	zbx_mock_assert_int_eq("stored values", (int)zbx_mock_get_parameter_uint64("out.values"), stored);
+
+	zbx_history_destroy();
+
+	mock_es_clear();
+
+	zbx_free(h);
+	zbx_vector_ptr_destroy(&history);
+
+	zbx_free(CONFIG_HISTORY_STORAGE_OPTS);
+	zbx_free(CONFIG_HISTORY_STORAGE_URL);
+}
+#else
+void	zbx_mock_test_entry(void **state)
+{
+	ZBX_UNUSED(state);
+
+	skip();
+}
+#endif
@@ -40,6 +40,8 @@ int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_
 		unsigned char trigger_value, const char *trigger_opdata, const char *error);
 int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock);
 void	__wrap_zbx_clean_events(void);
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted);
 void	zbx_vcmock_read_values(zbx_mock_handle_t hdata, unsigned char value_type, zbx_vector_history_record_t *values);
 void	zbx_vcmock_check_records(const char *prefix, unsigned char value_type,
 		const zbx_vector_history_record_t *expected_values, const zbx_vector_history_record_t *returned_values);
@@ -100,6 +102,21 @@ void	__wrap_zbx_clean_events(void)
 {
 }
 
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted)
+{
+	ZBX_UNUSED(clock);
+	ZBX_UNUSED(host);
+	ZBX_UNUSED(ip);
+	ZBX_UNUSED(dns);
+	ZBX_UNUSED(port);
+	ZBX_UNUSED(host_metadata);
+	ZBX_UNUSED(flags);
+	ZBX_UNUSED(tls_accepted);
+
+	return FAIL;
+}
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_vcmock_history_dump                                          *
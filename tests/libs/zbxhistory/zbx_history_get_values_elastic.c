@@ -0,0 +1,640 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "zbxalgo.h"
+#include "zbxjson.h"
+#include "zbxhistory.h"
+#include "db.h"
+
+extern char	*CONFIG_HISTORY_STORAGE_URL;
+extern char	*CONFIG_HISTORY_STORAGE_OPTS;
+
+void	__wrap_zbx_sleep_loop(int sleeptime);
+zbx_uint64_t	__wrap_DCget_nextid(const char *table_name, int num);
+int	__wrap_zbx_interface_availability_is_set(const zbx_interface_availability_t *ha);
+int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_t objectid,
+		const zbx_timespec_t *timespec, int value, const char *trigger_description,
+		const char *trigger_expression, const char *trigger_recovery_expression, unsigned char trigger_priority,
+		unsigned char trigger_type, const zbx_vector_ptr_t *trigger_tags,
+		unsigned char trigger_correlation_mode, const char *trigger_correlation_tag,
+		unsigned char trigger_value, const char *trigger_opdata, const char *error);
+int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock);
+void	__wrap_zbx_clean_events(void);
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted);
+
+void	__wrap_zbx_sleep_loop(int sleeptime)
+{
+	ZBX_UNUSED(sleeptime);
+}
+
+zbx_uint64_t	__wrap_DCget_nextid(const char *table_name, int num)
+{
+	ZBX_UNUSED(table_name);
+	ZBX_UNUSED(num);
+
+	return 0;
+}
+
+int	__wrap_zbx_interface_availability_is_set(const zbx_interface_availability_t *ha)
+{
+	ZBX_UNUSED(ha);
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_t objectid,
+		const zbx_timespec_t *timespec, int value, const char *trigger_description,
+		const char *trigger_expression, const char *trigger_recovery_expression, unsigned char trigger_priority,
+		unsigned char trigger_type, const zbx_vector_ptr_t *trigger_tags,
+		unsigned char trigger_correlation_mode, const char *trigger_correlation_tag,
+		unsigned char trigger_value, const char *trigger_opdata, const char *error)
+{
+	ZBX_UNUSED(source);
+	ZBX_UNUSED(object);
+	ZBX_UNUSED(objectid);
+	ZBX_UNUSED(timespec);
+	ZBX_UNUSED(value);
+	ZBX_UNUSED(trigger_description);
+	ZBX_UNUSED(trigger_expression);
+	ZBX_UNUSED(trigger_recovery_expression);
+	ZBX_UNUSED(trigger_priority);
+	ZBX_UNUSED(trigger_type);
+	ZBX_UNUSED(trigger_tags);
+	ZBX_UNUSED(trigger_correlation_mode);
+	ZBX_UNUSED(trigger_correlation_tag);
+	ZBX_UNUSED(trigger_value);
+	ZBX_UNUSED(trigger_opdata);
+	ZBX_UNUSED(error);
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock)
+{
+	ZBX_UNUSED(trigger_diff);
+	ZBX_UNUSED(triggerids_lock);
+
+	return SUCCEED;
+}
+
+void	__wrap_zbx_clean_events(void)
+{
+}
+
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted)
+{
+	ZBX_UNUSED(clock);
+	ZBX_UNUSED(host);
+	ZBX_UNUSED(ip);
+	ZBX_UNUSED(dns);
+	ZBX_UNUSED(port);
+	ZBX_UNUSED(host_metadata);
+	ZBX_UNUSED(flags);
+	ZBX_UNUSED(tls_accepted);
+
+	return FAIL;
+}
+
+#if defined(HAVE_LIBCURL) && LIBCURL_VERSION_NUM >= 0x071c00
+
+CURLcode	__wrap_curl_easy_setopt(CURL *handle, CURLoption option, ...);
+CURLcode	__wrap_curl_easy_perform(CURL *handle);
+
+/* history document stored in the mocked Elasticsearch indices */
+typedef struct
+{
+	int		clock;
+	int		ns;
+
+	/* the unique document number, returned as _shard_doc sort value */
+	zbx_uint64_t	doc;
+}
+zbx_mock_es_doc_t;
+
+/* the mocked Elasticsearch, serving requests sent through the read handle */
+typedef struct
+{
+	zbx_mock_es_doc_t	*docs;
+	int			docs_num;
+
+	/* the Elasticsearch version, point in time is supported starting with 7.12 */
+	const char		*version;
+	int			pit;
+
+	/* the read handle options */
+	curl_write_callback	write_cb;
+	void			*write_data;
+	char			*url;
+	char			*method;
+	const char		*body;
+
+	/* the point in time id that must be used by the next request */
+	char			*pit_id;
+	int			pits_opened;
+	int			pits_closed;
+
+	int			searches;
+	int			fail_search;
+}
+zbx_mock_es_t;
+
+static zbx_mock_es_t	es;
+
+/* documents are returned in clock, ns, _shard_doc descending order */
+static int	mock_es_doc_compare(const void *d1, const void *d2)
+{
+	const zbx_mock_es_doc_t	*doc1 = (const zbx_mock_es_doc_t *)d1;
+	const zbx_mock_es_doc_t	*doc2 = (const zbx_mock_es_doc_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(doc2->clock, doc1->clock);
+	ZBX_RETURN_IF_NOT_EQUAL(doc2->ns, doc1->ns);
+	ZBX_RETURN_IF_NOT_EQUAL(doc2->doc, doc1->doc);
+
+	return 0;
+}
+
+static void	mock_es_init(void)
+{
+	zbx_mock_handle_t	hdocs, hdoc;
+	zbx_uint64_t		i, repeat;
+	int			clock, ns;
+
+	memset(&es, 0, sizeof(es));
+
+	hdocs = zbx_mock_get_parameter_handle("in.documents");
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hdocs, &hdoc))
+	{
+		clock = atoi(zbx_mock_get_object_member_string(hdoc, "clock"));
+		ns = atoi(zbx_mock_get_object_member_string(hdoc, "ns"));
+		repeat = zbx_mock_get_object_member_uint64(hdoc, "repeat");
+
+		es.docs = (zbx_mock_es_doc_t *)zbx_realloc(es.docs, sizeof(zbx_mock_es_doc_t) *
+				(size_t)(es.docs_num + (int)repeat));
+
+		for (i = 0; i < repeat; i++)
+		{
+			es.docs[es.docs_num].clock = clock;
+			es.docs[es.docs_num].ns = ns;
+			es.docs[es.docs_num].doc = (zbx_uint64_t)es.docs_num;
+			es.docs_num++;
+		}
+	}
+
+	qsort(es.docs, (size_t)es.docs_num, sizeof(zbx_mock_es_doc_t), mock_es_doc_compare);
+
+	es.fail_search = (int)zbx_mock_get_parameter_uint64("in['fail search']");
+
+	es.version = zbx_mock_get_parameter_string("in.version");
+	es.pit = (0 <= zbx_strcmp_natural(es.version, "7.12.0"));
+}
+
+static void	mock_es_clear(void)
+{
+	zbx_free(es.docs);
+	zbx_free(es.url);
+	zbx_free(es.method);
+	zbx_free(es.pit_id);
+}
+
+static void	mock_es_respond(const char *data)
+{
+	es.write_cb((char *)data, 1, strlen(data), es.write_data);
+}
+
+static void	mock_es_check_pit_id(const char *pit_id)
+{
+	if (NULL == es.pit_id)
+		fail_msg("point in time \"%s\" is used while none is open", pit_id);
+
+	zbx_mock_assert_str_eq("point in time id", es.pit_id, pit_id);
+}
+
+static void	mock_es_version(void)
+{
+	char	*version;
+
+	version = zbx_dsprintf(NULL, "{\"version\":{\"number\":\"%s\"}}", es.version);
+	mock_es_respond(version);
+	zbx_free(version);
+}
+
+static void	mock_es_open_pit(void)
+{
+	char	*pit_id;
+
+	if (0 == es.pit)
+		fail_msg("point in time is opened in Elasticsearch %s", es.version);
+
+	if (NULL != es.pit_id)
+		fail_msg("point in time is opened while \"%s\" is still open", es.pit_id);
+
+	es.pit_id = zbx_dsprintf(NULL, "pit-%d-0", ++es.pits_opened);
+
+	pit_id = zbx_dsprintf(NULL, "{\"id\":\"%s\"}", es.pit_id);
+	mock_es_respond(pit_id);
+	zbx_free(pit_id);
+}
+
+static void	mock_es_close_pit(void)
+{
+	struct zbx_json_parse	jp;
+	char			id[MAX_STRING_LEN];
+
+	if (SUCCEED != zbx_json_open(es.body, &jp) || SUCCEED != zbx_json_value_by_name(&jp, "id", id, sizeof(id),
+			NULL))
+	{
+		fail_msg("invalid close point in time request \"%s\"", es.body);
+	}
+
+	mock_es_check_pit_id(id);
+
+	zbx_free(es.pit_id);
+	es.pits_closed++;
+
+	mock_es_respond("{\"succeeded\":true,\"num_freed\":1}");
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_es_search_after                                             *
+ *                                                                            *
+ * Purpose: checks if document follows the search_after values                *
+ *                                                                            *
+ * Parameters: doc       - [IN] the document                                  *
+ *             after     - [IN] the search_after values                       *
+ *             after_num - [IN] the number of search_after values, the same   *
+ *                              as the number of requested sort fields        *
+ *                                                                            *
+ * Comments: Only the requested sort fields are compared, so without unique   *
+ *           tiebreaker the documents sharing the sort values are skipped     *
+ *           like by Elasticsearch.                                           *
+ *                                                                            *
+ ******************************************************************************/
+static int	mock_es_search_after(const zbx_mock_es_doc_t *doc, const zbx_uint64_t *after, int after_num)
+{
+	zbx_uint64_t	values[3];
+	int		i;
+
+	values[0] = (zbx_uint64_t)doc->clock * 1000;
+	values[1] = (zbx_uint64_t)doc->ns;
+	values[2] = doc->doc;
+
+	for (i = 0; i < after_num; i++)
+	{
+		if (values[i] != after[i])
+			return values[i] < after[i] ? SUCCEED : FAIL;
+	}
+
+	return FAIL;
+}
+
+static void	mock_es_search(void)
+{
+	struct zbx_json_parse	jp, jp_pit, jp_sort, jp_after, jp_range;
+	char			buf[MAX_STRING_LEN], *response = NULL;
+	size_t			response_alloc = 0, response_offset = 0;
+	const char		*p;
+	int			i, size, sort_num, after_num = 0, start = 0, end = INT_MAX, hits = 0, fields;
+	zbx_uint64_t		after[3];
+
+	es.searches++;
+
+	if (SUCCEED != zbx_json_open(es.body, &jp))
+		fail_msg("invalid search request \"%s\"", es.body);
+
+	fields = (NULL != strstr(es.url, "hits.hits.fields"));
+
+	if (0 != es.pit)
+	{
+		if (SUCCEED != zbx_json_brackets_by_name(&jp, "pit", &jp_pit) ||
+				SUCCEED != zbx_json_value_by_name(&jp_pit, "id", buf, sizeof(buf), NULL))
+		{
+			fail_msg("search request without point in time \"%s\"", es.body);
+		}
+
+		mock_es_check_pit_id(buf);
+	}
+	else if (SUCCEED == zbx_json_brackets_by_name(&jp, "pit", &jp_pit))
+		fail_msg("search request with point in time in Elasticsearch %s \"%s\"", es.version, es.body);
+
+	if (SUCCEED != zbx_json_value_by_name(&jp, "size", buf, sizeof(buf), NULL))
+		fail_msg("search request without size \"%s\"", es.body);
+
+	size = atoi(buf);
+
+	/* _shard_doc sort is available only in point in time */
+	if (SUCCEED != zbx_json_brackets_by_name(&jp, "sort", &jp_sort) ||
+			(0 != es.pit ? 3 : 2) < (sort_num = zbx_json_count(&jp_sort)) || 2 > sort_num)
+	{
+		fail_msg("unexpected search sort order \"%s\"", es.body);
+	}
+
+	if (SUCCEED == zbx_json_brackets_by_name(&jp, "search_after", &jp_after))
+	{
+		for (p = NULL; NULL != (p = zbx_json_next_value(&jp_after, p, buf, sizeof(buf), NULL));)
+		{
+			if (after_num == sort_num || SUCCEED != is_uint64(buf, &after[after_num++]))
+				fail_msg("invalid search_after values \"%s\"", es.body);
+		}
+
+		if (after_num != sort_num)
+			fail_msg("search_after does not match sort order \"%s\"", es.body);
+	}
+
+	if (SUCCEED == zbx_json_open_path(&jp, "$.query.bool.filter[0].range.clock", &jp_range))
+	{
+		if (SUCCEED == zbx_json_value_by_name(&jp_range, "gt", buf, sizeof(buf), NULL))
+			start = atoi(buf);
+
+		if (SUCCEED == zbx_json_value_by_name(&jp_range, "lte", buf, sizeof(buf), NULL))
+			end = atoi(buf);
+	}
+
+	if (es.searches == es.fail_search)
+		return;
+
+	zbx_chrcpy_alloc(&response, &response_alloc, &response_offset, '{');
+
+	/* every response is returned with a new point in time id */
+	if (0 != es.pit)
+	{
+		zbx_free(es.pit_id);
+		es.pit_id = zbx_dsprintf(NULL, "pit-%d-%d", es.pits_opened, es.searches);
+
+		zbx_snprintf_alloc(&response, &response_alloc, &response_offset, "\"pit_id\":\"%s\",", es.pit_id);
+	}
+
+	for (i = 0; i < es.docs_num && hits < size; i++)
+	{
+		const zbx_mock_es_doc_t	*doc = &es.docs[i];
+
+		if (doc->clock <= start || doc->clock > end)
+			continue;
+
+		if (0 != after_num && SUCCEED != mock_es_search_after(doc, after, after_num))
+			continue;
+
+		zbx_strcpy_alloc(&response, &response_alloc, &response_offset,
+				0 == hits++ ? "\"hits\":{\"hits\":[" : ",");
+
+		zbx_snprintf_alloc(&response, &response_alloc, &response_offset, "{\"sort\":[" ZBX_FS_UI64 ",%d",
+				(zbx_uint64_t)doc->clock * 1000, doc->ns);
+
+		if (3 == sort_num)
+			zbx_snprintf_alloc(&response, &response_alloc, &response_offset, "," ZBX_FS_UI64, doc->doc);
+
+		if (0 != fields)
+		{
+			zbx_snprintf_alloc(&response, &response_alloc, &response_offset,
+					"],\"fields\":{\"clock\":[\"%d\"],\"ns\":[%d],\"value\":[" ZBX_FS_UI64 "]}}",
+					doc->clock, doc->ns, doc->doc);
+		}
+		else
+		{
+			zbx_snprintf_alloc(&response, &response_alloc, &response_offset,
+					"],\"_source\":{\"clock\":%d,\"ns\":%d,\"value\":\"" ZBX_FS_UI64 "\"}}",
+					doc->clock, doc->ns, doc->doc);
+		}
+	}
+
+	/* filtered response does not have hits object if nothing was found */
+	if (0 != hits)
+		zbx_strcpy_alloc(&response, &response_alloc, &response_offset, "]}");
+	else if (',' == response[response_offset - 1])
+		response_offset--;
+
+	zbx_chrcpy_alloc(&response, &response_alloc, &response_offset, '}');
+
+	mock_es_respond(response);
+	zbx_free(response);
+}
+
+CURLcode	__wrap_curl_easy_setopt(CURL *handle, CURLoption option, ...)
+{
+	va_list		args;
+	const char	*str;
+
+	ZBX_UNUSED(handle);
+
+	va_start(args, option);
+
+	switch (option)
+	{
+		case CURLOPT_WRITEFUNCTION:
+			es.write_cb = va_arg(args, curl_write_callback);
+			break;
+		case CURLOPT_WRITEDATA:
+			es.write_data = va_arg(args, void *);
+			break;
+		case CURLOPT_URL:
+			es.url = zbx_strdup(es.url, va_arg(args, const char *));
+			break;
+		case CURLOPT_CUSTOMREQUEST:
+			str = va_arg(args, const char *);
+			zbx_free(es.method);
+			if (NULL != str)
+				es.method = zbx_strdup(NULL, str);
+			break;
+		case CURLOPT_POSTFIELDS:
+			es.body = va_arg(args, const char *);
+			break;
+		default:
+			break;
+	}
+
+	va_end(args);
+
+	return CURLE_OK;
+}
+
+CURLcode	__wrap_curl_easy_perform(CURL *handle)
+{
+	ZBX_UNUSED(handle);
+
+	if (NULL == es.url || NULL == es.write_cb)
+		fail_msg("request is sent without url or write callback");
+
+	if (0 == strcmp(es.url, "http://localhost:9200/"))
+	{
+		mock_es_version();
+		return CURLE_OK;
+	}
+
+	if (NULL == es.body)
+		fail_msg("request is sent without body");
+
+	if (NULL != es.method)
+	{
+		if (0 != strcmp(es.method, "DELETE") || 0 != strcmp(es.url, "http://localhost:9200/_pit"))
+			fail_msg("unexpected %s request to \"%s\"", es.method, es.url);
+
+		mock_es_close_pit();
+	}
+	else if (0 == strcmp(es.url, "http://localhost:9200/uint*/_pit?keep_alive=1m") ||
+			0 == strcmp(es.url, "http://localhost:9200/str*/_pit?keep_alive=1m"))
+	{
+		mock_es_open_pit();
+	}
+	else if (0 != es.pit ? 0 == strncmp(es.url, "http://localhost:9200/_search?",
+			ZBX_CONST_STRLEN("http://localhost:9200/_search?")) :
+			(0 == strncmp(es.url, "http://localhost:9200/uint*/_search?",
+			ZBX_CONST_STRLEN("http://localhost:9200/uint*/_search?")) ||
+			0 == strncmp(es.url, "http://localhost:9200/str*/_search?",
+			ZBX_CONST_STRLEN("http://localhost:9200/str*/_search?"))))
+	{
+		mock_es_search();
+
+		if (es.searches == es.fail_search)
+			return CURLE_HTTP_RETURNED_ERROR;
+	}
+	else
+		fail_msg("unexpected request to \"%s\"", es.url);
+
+	return CURLE_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_check_values                                                *
+ *                                                                            *
+ * Purpose: checks that the newest documents are returned exactly once and    *
+ *          in the descending timestamp order                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_check_values(unsigned char value_type, int start, int end,
+		const zbx_vector_history_record_t *values)
+{
+	int		i, j, matched = 0;
+	zbx_uint64_t	doc;
+	unsigned char	*returned;
+
+	returned = (unsigned char *)zbx_calloc(NULL, (size_t)es.docs_num + 1, 1);
+
+	for (i = 0; i < values->values_num; i++)
+	{
+		const zbx_history_record_t	*rec = &values->values[i];
+
+		if (ITEM_VALUE_TYPE_UINT64 == value_type)
+			doc = rec->value.ui64;
+		else if (SUCCEED != is_uint64(rec->value.str, &doc))
+			fail_msg("unexpected returned value \"%s\"", rec->value.str);
+
+		if (doc >= (zbx_uint64_t)es.docs_num)
+			fail_msg("returned value " ZBX_FS_UI64 " is not stored", doc);
+
+		if (0 != returned[doc])
+			fail_msg("value " ZBX_FS_UI64 " is returned more than once", doc);
+
+		returned[doc] = 1;
+
+		if (0 < i && 0 < zbx_history_record_compare_desc_func(&values->values[i - 1], rec))
+			fail_msg("value %d is returned out of descending timestamp order", i);
+	}
+
+	/* the returned values must be the newest documents in the requested period */
+	for (j = 0; j < es.docs_num && matched < values->values_num; j++)
+	{
+		const zbx_mock_es_doc_t	*d = &es.docs[j];
+
+		if (d->clock <= start || (0 < end && d->clock > end))
+			continue;
+
+		if (0 == returned[d->doc])
+			fail_msg("newer value " ZBX_FS_UI64 " is not returned", d->doc);
+
+		matched++;
+	}
+
+	zbx_free(returned);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	char				*error = NULL;
+	int				err, start, end, count, expected_ret, pits;
+	unsigned char			value_type;
+	zbx_uint64_t			itemid;
+	zbx_vector_history_record_t	values;
+	struct zbx_json			json;
+
+	ZBX_UNUSED(state);
+
+	CONFIG_HISTORY_STORAGE_URL = zbx_strdup(NULL, "http://localhost:9200/");
+	CONFIG_HISTORY_STORAGE_OPTS = zbx_strdup(NULL, "uint,str");
+
+	err = zbx_history_init(&error);
+	zbx_mock_assert_result_eq("zbx_history_init()", SUCCEED, err);
+
+	mock_es_init();
+
+	zbx_json_init(&json, ZBX_JSON_STAT_BUF_LEN);
+	zbx_history_check_version(&json);
+	zbx_json_free(&json);
+
+	itemid = zbx_mock_get_parameter_uint64("in.itemid");
+	value_type = zbx_mock_str_to_value_type(zbx_mock_get_parameter_string("in['value type']"));
+	start = (int)zbx_mock_get_parameter_uint64("in.start");
+	count = (int)zbx_mock_get_parameter_uint64("in.count");
+	end = (int)zbx_mock_get_parameter_uint64("in.end");
+	expected_ret = zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.return"));
+
+	zbx_history_record_vector_create(&values);
+
+	err = zbx_history_get_values(itemid, value_type, start, count, end, &values);
+	zbx_mock_assert_result_eq("zbx_history_get_values()", expected_ret, err);
+
+	pits = (int)zbx_mock_get_parameter_uint64("out['points in time']");
+	zbx_mock_assert_int_eq("opened points in time", pits, es.pits_opened);
+	zbx_mock_assert_int_eq("closed points in time", pits, es.pits_closed);
+	zbx_mock_assert_int_eq("search requests", (int)zbx_mock_get_parameter_uint64("out.searches"),
+			es.searches);
+
+	if (SUCCEED == err)
+	{
+		zbx_mock_assert_int_eq("returned values", (int)zbx_mock_get_parameter_uint64("out.values"),
+				values.values_num);
+		mock_check_values(value_type, start, end, &values);
+	}
+
+	zbx_history_record_vector_destroy(&values, value_type);
+
+	zbx_history_destroy();
+
+	mock_es_clear();
+
+	zbx_free(CONFIG_HISTORY_STORAGE_OPTS);
+	zbx_free(CONFIG_HISTORY_STORAGE_URL);
+}
+#else
+void	zbx_mock_test_entry(void **state)
+{
+	ZBX_UNUSED(state);
+
+	skip();
+}
+#endif
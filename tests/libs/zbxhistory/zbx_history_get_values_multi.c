@@ -0,0 +1,227 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+#include "zbxmockdb.h"
+
+#include "common.h"
+#include "zbxalgo.h"
+#include "zbxhistory.h"
+#include "zbxdb.h"
+#include "db.h"
+
+void	__wrap_zbx_sleep_loop(int sleeptime);
+zbx_uint64_t	__wrap_DCget_nextid(const char *table_name, int num);
+int	__wrap_zbx_interface_availability_is_set(const zbx_interface_availability_t *ha);
+int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_t objectid,
+		const zbx_timespec_t *timespec, int value, const char *trigger_description,
+		const char *trigger_expression, const char *trigger_recovery_expression, unsigned char trigger_priority,
+		unsigned char trigger_type, const zbx_vector_ptr_t *trigger_tags,
+		unsigned char trigger_correlation_mode, const char *trigger_correlation_tag,
+		unsigned char trigger_value, const char *trigger_opdata, const char *error);
+int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock);
+void	__wrap_zbx_clean_events(void);
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted);
+
+void	__wrap_zbx_sleep_loop(int sleeptime)
+{
+	ZBX_UNUSED(sleeptime);
+}
+
+zbx_uint64_t	__wrap_DCget_nextid(const char *table_name, int num)
+{
+	ZBX_UNUSED(table_name);
+	ZBX_UNUSED(num);
+	return 0;
+}
+
+int	__wrap_zbx_interface_availability_is_set(const zbx_interface_availability_t *ha)
+{
+	ZBX_UNUSED(ha);
+	return SUCCEED;
+}
+
+int	__wrap_zbx_add_event(unsigned char source, unsigned char object, zbx_uint64_t objectid,
+		const zbx_timespec_t *timespec, int value, const char *trigger_description,
+		const char *trigger_expression, const char *trigger_recovery_expression, unsigned char trigger_priority,
+		unsigned char trigger_type, const zbx_vector_ptr_t *trigger_tags,
+		unsigned char trigger_correlation_mode, const char *trigger_correlation_tag,
+		unsigned char trigger_value, const char *trigger_opdata, const char *error)
+{
+	ZBX_UNUSED(source);
+	ZBX_UNUSED(object);
+	ZBX_UNUSED(objectid);
+	ZBX_UNUSED(timespec);
+	ZBX_UNUSED(value);
+	ZBX_UNUSED(trigger_description);
+	ZBX_UNUSED(trigger_expression);
+	ZBX_UNUSED(trigger_recovery_expression);
+	ZBX_UNUSED(trigger_priority);
+	ZBX_UNUSED(trigger_type);
+	ZBX_UNUSED(trigger_tags);
+	ZBX_UNUSED(trigger_correlation_mode);
+	ZBX_UNUSED(trigger_correlation_tag);
+	ZBX_UNUSED(trigger_value);
+	ZBX_UNUSED(trigger_opdata);
+	ZBX_UNUSED(error);
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_process_events(zbx_vector_ptr_t *trigger_diff, zbx_vector_uint64_t *triggerids_lock)
+{
+	ZBX_UNUSED(trigger_diff);
+	ZBX_UNUSED(triggerids_lock);
+
+	return SUCCEED;
+}
+
+void	__wrap_zbx_clean_events(void)
+{
+}
+
+int	__wrap_zbx_pmb_autoreg_write(int clock, const char *host, const char *ip, const char *dns, int port,
+		const char *host_metadata, int flags, unsigned int tls_accepted)
+{
+	ZBX_UNUSED(clock);
+	ZBX_UNUSED(host);
+	ZBX_UNUSED(ip);
+	ZBX_UNUSED(dns);
+	ZBX_UNUSED(port);
+	ZBX_UNUSED(host_metadata);
+	ZBX_UNUSED(flags);
+	ZBX_UNUSED(tls_accepted);
+
+	return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_check_values                                                *
+ *                                                                            *
+ * Purpose: compares values returned for history request with expected        *
+ *          [clock, ns, value] rows                                           *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_check_values(int index, zbx_mock_handle_t hvalues, zbx_vector_history_record_t *values)
+{
+	zbx_mock_handle_t	hrow, hfield;
+	zbx_mock_error_t	err;
+	const char		*fields[3];
+	char			prefix[MAX_STRING_LEN];
+	int			i = 0, j;
+
+	zbx_vector_history_record_sort(values, (zbx_compare_func_t)zbx_history_record_compare_asc_func);
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hvalues, &hrow))))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("cannot read expected value of request #%d: %s", index, zbx_mock_error_string(err));
+
+		for (j = 0; j < 3; j++)
+		{
+			if (ZBX_MOCK_SUCCESS != (err = zbx_mock_vector_element(hrow, &hfield)) ||
+					ZBX_MOCK_SUCCESS != (err = zbx_mock_string(hfield, &fields[j])))
+			{
+				fail_msg("cannot read expected value field of request #%d: %s", index,
+						zbx_mock_error_string(err));
+			}
+		}
+
+		zbx_snprintf(prefix, sizeof(prefix), "request #%d value #%d", index, i);
+
+		if (i >= values->values_num)
+			fail_msg("%s was not returned", prefix);
+
+		zbx_mock_assert_int_eq(prefix, atoi(fields[0]), values->values[i].timestamp.sec);
+		zbx_mock_assert_int_eq(prefix, atoi(fields[1]), values->values[i].timestamp.ns);
+		zbx_mock_assert_uint64_eq(prefix, (zbx_uint64_t)atoll(fields[2]), values->values[i].value.ui64);
+		i++;
+	}
+
+	zbx_snprintf(prefix, sizeof(prefix), "number of values returned for request #%d", index);
+	zbx_mock_assert_int_eq(prefix, i, values->values_num);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	char			*error = NULL;
+	int			i, ret;
+	zbx_mock_handle_t	hrequests, hrequest;
+	zbx_mock_error_t	err;
+	zbx_vector_ptr_t	requests;
+	zbx_history_request_t	*request;
+
+	ZBX_UNUSED(state);
+
+	zbx_mockdb_init();
+
+	ret = zbx_history_init(&error);
+	zbx_mock_assert_result_eq("zbx_history_init()", SUCCEED, ret);
+
+	zbx_vector_ptr_create(&requests);
+
+	hrequests = zbx_mock_get_parameter_handle("in.requests");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hrequests, &hrequest))))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("cannot read history request: %s", zbx_mock_error_string(err));
+
+		request = (zbx_history_request_t *)zbx_malloc(NULL, sizeof(zbx_history_request_t));
+		request->itemid = zbx_mock_get_object_member_uint64(hrequest, "itemid");
+		request->value_type = ITEM_VALUE_TYPE_UINT64;
+		request->start = (int)zbx_mock_get_object_member_uint64(hrequest, "start");
+		request->end = (int)zbx_mock_get_object_member_uint64(hrequest, "end");
+		zbx_history_record_vector_create(&request->values);
+
+		zbx_vector_ptr_append(&requests, request);
+	}
+
+	ret = zbx_history_get_values_multi(&requests);
+	zbx_mock_assert_result_eq("zbx_history_get_values_multi()", SUCCEED, ret);
+
+	hrequests = zbx_mock_get_parameter_handle("out.requests");
+
+	for (i = 0; ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hrequests, &hrequest))); i++)
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("cannot read history request result: %s", zbx_mock_error_string(err));
+
+		if (i >= requests.values_num)
+			fail_msg("too many history request results");
+
+		request = (zbx_history_request_t *)requests.values[i];
+		mock_check_values(i, zbx_mock_get_object_member_handle(hrequest, "values"), &request->values);
+	}
+
+	for (i = 0; i < requests.values_num; i++)
+	{
+		request = (zbx_history_request_t *)requests.values[i];
+		zbx_history_record_vector_destroy(&request->values, request->value_type);
+		zbx_free(request);
+	}
+
+	zbx_vector_ptr_destroy(&requests);
+	zbx_history_destroy();
+}
@@ -0,0 +1,71 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "json_scan.h"
+
+/* the scanners work with 16 and 32 byte aligned blocks, the data is placed at all offsets within two blocks */
+#define MOCK_SCAN_ALIGN		32
+#define MOCK_SCAN_SHIFT_MAX	(MOCK_SCAN_ALIGN * 2)
+
+void	zbx_mock_test_entry(void **state)
+{
+	const char	*data, *cls, *ptr;
+	char		*buffer, *base, prefix[MAX_STRING_LEN];
+	size_t		size;
+	int		shift, expected;
+
+	ZBX_UNUSED(state);
+
+	if (ZBX_MOCK_SUCCESS != zbx_mock_binary(zbx_mock_get_parameter_handle("in.data"), &data, &size))
+		fail_msg("cannot read input data");
+
+	cls = zbx_mock_get_parameter_string("in.class");
+	expected = (int)zbx_mock_get_parameter_uint64("out.offset");
+
+	/* the scanned data is followed by garbage up to the end of the last block like in real buffers */
+	buffer = (char *)zbx_malloc(NULL, size + 1 + MOCK_SCAN_SHIFT_MAX + MOCK_SCAN_ALIGN * 2);
+	base = (char *)(((uintptr_t)buffer + MOCK_SCAN_ALIGN - 1) & ~(uintptr_t)(MOCK_SCAN_ALIGN - 1));
+
+	for (shift = 0; shift < MOCK_SCAN_SHIFT_MAX; shift++)
+	{
+		memset(base, '"', size + 1 + MOCK_SCAN_SHIFT_MAX + MOCK_SCAN_ALIGN);
+		memcpy(base + shift, data, size);
+		base[shift + size] = '\0';
+
+		if (0 == strcmp(cls, "string"))
+			ptr = json_scan_string(base + shift);
+		else if (0 == strcmp(cls, "quote"))
+			ptr = json_scan_quote(base + shift);
+		else if (0 == strcmp(cls, "structural"))
+			ptr = json_scan_structural(base + shift);
+		else
+			fail_msg("unknown character class \"%s\"", cls);
+
+		zbx_snprintf(prefix, sizeof(prefix), "offset of data placed at block offset %d", shift);
+		zbx_mock_assert_int_eq(prefix, expected, (int)(ptr - (base + shift)));
+	}
+
+	zbx_free(buffer);
+}
@@ -51,6 +51,37 @@ static void	check_indefinite_path_result(zbx_mock_handle_t handle, const char *r
 	zbx_mock_assert_json_eq("Indefinite query result", expected_output, returned_output);
 }
 
+static void	check_indexed_query_result(const struct zbx_json_parse *jp, const char *path, const char *output)
+{
+	zbx_jsonpath_t		jsonpath;
+	zbx_jsonpath_index_t	*index;
+	char			*indexed_output;
+	int			i;
+
+	if (FAIL == zbx_jsonpath_compile(path, &jsonpath))
+		fail_msg("Cannot compile jsonpath: %s", zbx_json_strerror());
+
+	index = zbx_jsonpath_index_create();
+
+	/* the first query fills the index, the second one uses it */
+	for (i = 0; i < 2; i++)
+	{
+		indexed_output = NULL;
+		zbx_mock_assert_result_eq("zbx_jsonpath_query_compiled() return value", SUCCEED,
+				zbx_jsonpath_query_compiled(jp, &jsonpath, index, &indexed_output));
+
+		if (NULL == output)
+			zbx_mock_assert_ptr_eq("Indexed query result", NULL, indexed_output);
+		else
+			zbx_mock_assert_str_eq("Indexed query result", output, indexed_output);
+
+		zbx_free(indexed_output);
+	}
+
+	zbx_jsonpath_index_free(index);
+	zbx_jsonpath_clear(&jsonpath);
+}
+
 void	zbx_mock_test_entry(void **state)
 {
 	const char		*data, *path;
@@ -92,6 +123,8 @@ void	zbx_mock_test_entry(void **state)
 		}
 		else
 			zbx_mock_assert_ptr_eq("Query result", NULL, output);
+
+		check_indexed_query_result(&jp, path, output);
 	}
 	else
 		zbx_mock_assert_str_ne("tzbx_jsonpath_query() error", "", zbx_json_strerror());
@@ -0,0 +1,183 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "zbxtrends.h"
+#include "log.h"
+#include "trends.h"
+
+#include "mocks/trends/trends_mock.h"
+
+extern zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE;
+
+static int	mock_get_step_time(zbx_mock_handle_t hstep, const char *name)
+{
+	zbx_timespec_t	ts;
+
+	if (ZBX_MOCK_SUCCESS != zbx_strtime_to_timespec(zbx_mock_get_object_member_string(hstep, name), &ts))
+		fail_msg("invalid step %s time", name);
+
+	return ts.sec;
+}
+
+static void	mock_assert_value_eq(const char *prefix, double expected, double returned)
+{
+	/* the average is calculated in different order by the oracle and by the evaluated functions */
+	if (fabs(expected - returned) > fabs(expected) * 1e-12 + ZBX_DOUBLE_EPSILON)
+		fail_msg("%s: expected " ZBX_FS_DBL " while returned " ZBX_FS_DBL, prefix, expected, returned);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_check_partials                                              *
+ *                                                                            *
+ * Purpose: check that exactly the specified days have cached partial         *
+ *          aggregates                                                        *
+ *                                                                            *
+ * Parameters: itemid    - [IN] the itemid                                    *
+ *             hpartials - [IN] vector of [first, last] day ranges            *
+ *             from      - [IN] the first day to check                        *
+ *             to        - [IN] the last day to check                         *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_check_partials(zbx_uint64_t itemid, zbx_mock_handle_t hpartials, int from, int to)
+{
+	zbx_mock_handle_t	hrange, hday;
+	zbx_timespec_t		ts;
+	zbx_vector_uint64_t	days;
+	int			day, range[2], i, expected, returned;
+	char			prefix[MAX_STRING_LEN];
+
+	zbx_vector_uint64_create(&days);
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hpartials, &hrange))
+	{
+		const char	*strtime;
+
+		for (i = 0; i < 2; i++)
+		{
+			if (ZBX_MOCK_SUCCESS != zbx_mock_vector_element(hrange, &hday) ||
+					ZBX_MOCK_SUCCESS != zbx_mock_string(hday, &strtime) ||
+					ZBX_MOCK_SUCCESS != zbx_strtime_to_timespec(strtime, &ts))
+			{
+				fail_msg("invalid partial day range");
+			}
+
+			range[i] = ts.sec;
+		}
+
+		for (day = range[0]; day <= range[1]; day += SEC_PER_DAY)
+			zbx_vector_uint64_append(&days, (zbx_uint64_t)day);
+	}
+
+	for (day = from - from % SEC_PER_DAY; day <= to; day += SEC_PER_DAY)
+	{
+		expected = FAIL == zbx_vector_uint64_search(&days, (zbx_uint64_t)day, ZBX_DEFAULT_UINT64_COMPARE_FUNC) ?
+				FAIL : SUCCEED;
+		returned = zbx_tfc_has_value(itemid, day, day + SEC_PER_DAY - 1, ZBX_TREND_FUNCTION_PARTIAL);
+
+		zbx_snprintf(prefix, sizeof(prefix), "cached partial aggregate of day %s",
+				zbx_date2str((time_t)day, "UTC"));
+		zbx_mock_assert_result_eq(prefix, expected, returned);
+	}
+
+	zbx_vector_uint64_destroy(&days);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_handle_t	hsteps, hstep, hdata;
+	const char		*function;
+	char			*error = NULL, prefix[MAX_STRING_LEN];
+	int			start, end, step = 0, expected_ret, returned_ret, rows;
+	zbx_uint64_t		itemid;
+	double			expected_value, returned_value;
+
+	ZBX_UNUSED(state);
+
+	if (0 != setenv("TZ", zbx_mock_get_parameter_string("in.timezone"), 1))
+		fail_msg("Cannot set 'TZ' environment variable: %s", zbx_strerror(errno));
+
+	tzset();
+
+	CONFIG_TREND_FUNC_CACHE_SIZE = zbx_mock_get_parameter_uint64("in.cache_size");
+
+	if (SUCCEED != zbx_tfc_init(&error))
+		fail_msg("cannot initialize trend function cache: %s", error);
+
+	zbx_trmock_init(zbx_mock_get_parameter_handle("in.trends"));
+
+	hsteps = zbx_mock_get_parameter_handle("in.steps");
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hsteps, &hstep))
+	{
+		step++;
+		function = zbx_mock_get_object_member_string(hstep, "function");
+		itemid = zbx_mock_get_object_member_uint64(hstep, "itemid");
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hstep, "param", &hdata))
+		{
+			if (SUCCEED != zbx_trends_parse_range(mock_get_step_time(hstep, "time"),
+					zbx_mock_get_object_member_string(hstep, "param"), &start, &end, &error))
+			{
+				fail_msg("step %d: cannot parse period: %s", step, error);
+			}
+		}
+		else
+		{
+			start = mock_get_step_time(hstep, "start");
+			end = mock_get_step_time(hstep, "end");
+		}
+
+		expected_ret = zbx_trmock_eval(function, itemid, start, end, &expected_value);
+		rows = zbx_trmock_get_rows();
+		returned_ret = zbx_trmock_trends_eval(function, itemid, start, end, &returned_value, &error);
+
+		zbx_snprintf(prefix, sizeof(prefix), "step %d: %s() return value", step, function);
+		zbx_mock_assert_result_eq(prefix, expected_ret, returned_ret);
+
+		if (SUCCEED == returned_ret)
+		{
+			zbx_snprintf(prefix, sizeof(prefix), "step %d: %s() value", step, function);
+			mock_assert_value_eq(prefix, expected_value, returned_value);
+		}
+		else
+			zbx_free(error);
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hstep, "rows", &hdata))
+		{
+			zbx_snprintf(prefix, sizeof(prefix), "step %d: %s() records read", step, function);
+			zbx_mock_assert_int_eq(prefix, (int)zbx_mock_get_object_member_uint64(hstep, "rows"),
+					zbx_trmock_get_rows() - rows);
+		}
+
+		if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hstep, "partials", &hdata))
+		{
+			mock_check_partials(itemid, hdata, mock_get_step_time(hstep, "check from"),
+					mock_get_step_time(hstep, "check to"));
+		}
+	}
+
+	zbx_trmock_destroy();
+}
@@ -0,0 +1,232 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "zbxtrends.h"
+#include "log.h"
+
+#include "mocks/trends/trends_mock.h"
+
+extern zbx_uint64_t	CONFIG_TREND_FUNC_CACHE_SIZE;
+
+typedef struct
+{
+	const char	*function;
+	int		start;
+	int		end;
+	zbx_uint64_t	itemid;
+	int		ret;
+	double		value;
+}
+zbx_mock_request_t;
+
+static int	mock_get_request_time(zbx_mock_handle_t hrequest, const char *name)
+{
+	zbx_timespec_t	ts;
+
+	if (ZBX_MOCK_SUCCESS != zbx_strtime_to_timespec(zbx_mock_get_object_member_string(hrequest, name), &ts))
+		fail_msg("invalid request %s time", name);
+
+	return ts.sec;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_read_requests                                               *
+ *                                                                            *
+ * Purpose: read trend function requests, each request has function, period   *
+ *          and list of itemids                                               *
+ *                                                                            *
+ * Parameters: path     - [IN] the requests parameter path                    *
+ *             requests - [OUT] the requests of single items                  *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_read_requests(const char *path, zbx_vector_ptr_t *requests)
+{
+	zbx_mock_handle_t	hrequests, hrequest, hitemids, hitemid;
+	zbx_mock_request_t	*request;
+	const char		*function;
+	int			start, end;
+	zbx_uint64_t		itemid;
+
+	hrequests = zbx_mock_get_parameter_handle(path);
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hrequests, &hrequest))
+	{
+		function = zbx_mock_get_object_member_string(hrequest, "function");
+		start = mock_get_request_time(hrequest, "start");
+		end = mock_get_request_time(hrequest, "end");
+		hitemids = zbx_mock_get_object_member_handle(hrequest, "itemids");
+
+		while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(hitemids, &hitemid))
+		{
+			if (ZBX_MOCK_SUCCESS != zbx_mock_uint64(hitemid, &itemid))
+				fail_msg("invalid request itemid");
+
+			request = (zbx_mock_request_t *)zbx_malloc(NULL, sizeof(zbx_mock_request_t));
+			request->function = function;
+			request->start = start;
+			request->end = end;
+			request->itemid = itemid;
+			zbx_vector_ptr_append(requests, request);
+		}
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_eval_requests                                               *
+ *                                                                            *
+ * Purpose: evaluate the requests of items with the specified itemid offset   *
+ *          one by one                                                        *
+ *                                                                            *
+ ******************************************************************************/
+static void	mock_eval_requests(zbx_vector_ptr_t *requests, zbx_uint64_t offset)
+{
+	int			i;
+	char			*error = NULL;
+	zbx_mock_request_t	*request;
+
+	for (i = 0; i < requests->values_num; i++)
+	{
+		request = (zbx_mock_request_t *)requests->values[i];
+		request->ret = zbx_trmock_trends_eval(request->function, request->itemid + offset, request->start,
+				request->end, &request->value, &error);
+
+		if (SUCCEED != request->ret)
+			zbx_free(error);
+	}
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_vector_ptr_t		requests, prefetched;
+	zbx_vector_trend_prefetch_t	prefetch;
+	zbx_trend_prefetch_t		request_prefetch;
+	zbx_mock_request_t		*request, *request_prefetched;
+	zbx_uint64_t			offset;
+	char				*error = NULL, prefix[MAX_STRING_LEN];
+	int				i, queries, expected_ret;
+	double				expected_value;
+
+	ZBX_UNUSED(state);
+
+	if (0 != setenv("TZ", zbx_mock_get_parameter_string("in.timezone"), 1))
+		fail_msg("Cannot set 'TZ' environment variable: %s", zbx_strerror(errno));
+
+	tzset();
+
+	CONFIG_TREND_FUNC_CACHE_SIZE = zbx_mock_get_parameter_uint64("in.cache_size");
+
+	if (SUCCEED != zbx_tfc_init(&error))
+		fail_msg("cannot initialize trend function cache: %s", error);
+
+	zbx_trmock_init(zbx_mock_get_parameter_handle("in.trends"));
+
+	/* the items with itemids shifted by offset have the same trend records and are prefetched */
+	offset = zbx_mock_get_parameter_uint64("in.offset");
+
+	zbx_vector_ptr_create(&requests);
+	zbx_vector_ptr_create(&prefetched);
+	zbx_vector_trend_prefetch_create(&prefetch);
+
+	mock_read_requests("in.requests", &requests);
+	mock_read_requests("in.requests", &prefetched);
+
+	mock_eval_requests(&requests, 0);
+
+	/* some of the prefetched items might have the values or daily partial aggregates already cached */
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("in.cached"))
+	{
+		zbx_vector_ptr_t	cached;
+
+		zbx_vector_ptr_create(&cached);
+		mock_read_requests("in.cached", &cached);
+		mock_eval_requests(&cached, offset);
+		zbx_vector_ptr_clear_ext(&cached, zbx_ptr_free);
+		zbx_vector_ptr_destroy(&cached);
+	}
+
+	for (i = 0; i < prefetched.values_num; i++)
+	{
+		request = (zbx_mock_request_t *)prefetched.values[i];
+
+		request_prefetch.itemid = request->itemid + offset;
+		request_prefetch.table = "trends";
+		request_prefetch.function = request->function;
+		request_prefetch.start = request->start;
+		request_prefetch.end = request->end;
+		zbx_vector_trend_prefetch_append(&prefetch, request_prefetch);
+	}
+
+	queries = zbx_trmock_get_queries();
+	zbx_trends_prefetch_values(&prefetch);
+	zbx_mock_assert_int_eq("prefetch queries", (int)zbx_mock_get_parameter_uint64("out.prefetch_queries"),
+			zbx_trmock_get_queries() - queries);
+
+	queries = zbx_trmock_get_queries();
+	mock_eval_requests(&prefetched, offset);
+	zbx_mock_assert_int_eq("queries after prefetch", (int)zbx_mock_get_parameter_uint64("out.eval_queries"),
+			zbx_trmock_get_queries() - queries);
+
+	for (i = 0; i < requests.values_num; i++)
+	{
+		request = (zbx_mock_request_t *)requests.values[i];
+		request_prefetched = (zbx_mock_request_t *)prefetched.values[i];
+
+		zbx_snprintf(prefix, sizeof(prefix), "%s() of item " ZBX_FS_UI64 " return value", request->function,
+				request->itemid);
+		zbx_mock_assert_result_eq(prefix, request->ret, request_prefetched->ret);
+
+		expected_ret = zbx_trmock_eval(request->function, request->itemid, request->start, request->end,
+				&expected_value);
+		zbx_mock_assert_result_eq(prefix, expected_ret, request->ret);
+
+		if (SUCCEED != request->ret)
+			continue;
+
+		/* prefetched values must be identical to the values evaluated one by one */
+		zbx_snprintf(prefix, sizeof(prefix), "%s() of item " ZBX_FS_UI64 " value", request->function,
+				request->itemid);
+		if (request->value != request_prefetched->value)
+		{
+			fail_msg("%s: evaluated " ZBX_FS_DBL " while prefetched " ZBX_FS_DBL, prefix, request->value,
+					request_prefetched->value);
+		}
+
+		if (fabs(expected_value - request->value) > fabs(expected_value) * 1e-12 + ZBX_DOUBLE_EPSILON)
+		{
+			fail_msg("%s: expected " ZBX_FS_DBL " while returned " ZBX_FS_DBL, prefix, expected_value,
+					request->value);
+		}
+	}
+
+	zbx_vector_trend_prefetch_destroy(&prefetch);
+	zbx_vector_ptr_clear_ext(&prefetched, zbx_ptr_free);
+	zbx_vector_ptr_destroy(&prefetched);
+	zbx_vector_ptr_clear_ext(&requests, zbx_ptr_free);
+	zbx_vector_ptr_destroy(&requests);
+
+	zbx_trmock_destroy();
+}
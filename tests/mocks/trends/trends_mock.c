@@ -0,0 +1,934 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "common.h"
+#include "zbxalgo.h"
+#include "mutexs.h"
+#include "memalloc.h"
+#include "db.h"
+#include "zbxtrends.h"
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "mocks/trends/trends_mock.h"
+
+/*
+ * The trends mock serves trend records from yaml through a small interpreter of the select statements issued
+ * by trend function evaluation. The records are generated hourly with changing values, so that different
+ * periods give different results.
+ */
+
+int	__wrap_zbx_mutex_create(zbx_mutex_t *mutex, zbx_mutex_name_t name, char **error);
+int	__wrap_zbx_mem_create(zbx_mem_info_t **info, zbx_uint64_t size, const char *descr, const char *param,
+		int allow_oom, char **error);
+void	*__wrap___zbx_mem_malloc(const char *file, int line, zbx_mem_info_t *info, const void *old, size_t size);
+void	*__wrap___zbx_mem_realloc(const char *file, int line, zbx_mem_info_t *info, void *old, size_t size);
+void	__wrap___zbx_mem_free(const char *file, int line, zbx_mem_info_t *info, void *ptr);
+DB_RESULT	__wrap_DBselect(const char *fmt, ...);
+DB_ROW	__wrap_DBfetch(DB_RESULT result);
+int	__wrap_DBis_null(const char *field);
+void	__wrap_DBfree_result(DB_RESULT result);
+
+typedef struct
+{
+	zbx_uint64_t	itemid;
+	int		clock;
+	int		num;
+	double		value_avg;
+	double		value_min;
+	double		value_max;
+}
+zbx_trmock_trend_t;
+
+typedef enum
+{
+	ZBX_TRMOCK_COLUMN_ITEMID,
+	ZBX_TRMOCK_COLUMN_CLOCK,
+	ZBX_TRMOCK_COLUMN_NUM,
+	ZBX_TRMOCK_COLUMN_VALUE_AVG,
+	ZBX_TRMOCK_COLUMN_VALUE_MIN,
+	ZBX_TRMOCK_COLUMN_VALUE_MAX
+}
+zbx_trmock_column_t;
+
+typedef enum
+{
+	ZBX_TRMOCK_NODE_COLUMN,
+	ZBX_TRMOCK_NODE_NUMBER,
+	ZBX_TRMOCK_NODE_SUM,
+	ZBX_TRMOCK_NODE_MIN,
+	ZBX_TRMOCK_NODE_MAX,
+	ZBX_TRMOCK_NODE_MINUS,
+	ZBX_TRMOCK_NODE_AND,
+	ZBX_TRMOCK_NODE_OR,
+	ZBX_TRMOCK_NODE_EQ,
+	ZBX_TRMOCK_NODE_GE,
+	ZBX_TRMOCK_NODE_LE,
+	ZBX_TRMOCK_NODE_BETWEEN,
+	ZBX_TRMOCK_NODE_IN
+}
+zbx_trmock_node_type_t;
+
+/* select list expression or where clause condition */
+typedef struct zbx_trmock_node
+{
+	zbx_trmock_node_type_t	type;
+	zbx_trmock_column_t	column;
+	double			value;
+	double			value_to;
+	zbx_vector_uint64_t	values;
+	struct zbx_trmock_node	*left;
+	struct zbx_trmock_node	*right;
+}
+zbx_trmock_node_t;
+
+typedef struct
+{
+	const char	*sql;
+	const char	*ptr;
+	char		token[MAX_STRING_LEN];
+}
+zbx_trmock_parser_t;
+
+struct zbx_db_result
+{
+	char	**values;
+	int	columns_num;
+	int	rows_num;
+	int	row;
+};
+
+static zbx_trmock_trend_t	*trends;
+static int			trends_num;
+static int			trmock_queries;
+static int			trmock_rows;
+static zbx_mem_info_t		trmock_mem;
+
+static int	trmock_trend_compare(const void *d1, const void *d2)
+{
+	const zbx_trmock_trend_t	*t1 = (const zbx_trmock_trend_t *)d1;
+	const zbx_trmock_trend_t	*t2 = (const zbx_trmock_trend_t *)d2;
+
+	ZBX_RETURN_IF_NOT_EQUAL(t1->itemid, t2->itemid);
+	ZBX_RETURN_IF_NOT_EQUAL(t1->clock, t2->clock);
+
+	return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_trmock_init                                                  *
+ *                                                                            *
+ * Purpose: generates trend records                                           *
+ *                                                                            *
+ * Parameters: htrends - [IN] vector of trend record series with itemid,      *
+ *                            start time, number of hours, num, value and     *
+ *                            value step per hour                             *
+ *                                                                            *
+ * Comments: The value_avg of record i is value + step * i, value_min and     *
+ *           value_max are spread around it by i % 3 and i % 5.               *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_trmock_init(zbx_mock_handle_t htrends)
+{
+	zbx_mock_handle_t	hseries;
+	zbx_timespec_t		ts;
+	zbx_uint64_t		itemid;
+	int			i, hours, num;
+	double			value, step;
+
+	trends = NULL;
+	trends_num = 0;
+	trmock_queries = 0;
+	trmock_rows = 0;
+
+	while (ZBX_MOCK_END_OF_VECTOR != zbx_mock_vector_element(htrends, &hseries))
+	{
+		itemid = zbx_mock_get_object_member_uint64(hseries, "itemid");
+		hours = (int)zbx_mock_get_object_member_uint64(hseries, "hours");
+		num = (int)zbx_mock_get_object_member_uint64(hseries, "num");
+		value = atof(zbx_mock_get_object_member_string(hseries, "value"));
+		step = atof(zbx_mock_get_object_member_string(hseries, "step"));
+
+		if (ZBX_MOCK_SUCCESS != zbx_strtime_to_timespec(zbx_mock_get_object_member_string(hseries, "start"),
+				&ts))
+		{
+			fail_msg("invalid trend series start time");
+		}
+
+		trends = (zbx_trmock_trend_t *)zbx_realloc(trends, sizeof(zbx_trmock_trend_t) *
+				(size_t)(trends_num + hours));
+
+		for (i = 0; i < hours; i++)
+		{
+			zbx_trmock_trend_t	*trend = &trends[trends_num++];
+
+			trend->itemid = itemid;
+			trend->clock = ts.sec + i * SEC_PER_HOUR;
+			trend->num = num;
+			trend->value_avg = value + step * i;
+			trend->value_min = trend->value_avg - i % 3;
+			trend->value_max = trend->value_avg + i % 5;
+		}
+	}
+
+	qsort(trends, (size_t)trends_num, sizeof(zbx_trmock_trend_t), trmock_trend_compare);
+}
+
+void	zbx_trmock_destroy(void)
+{
+	zbx_free(trends);
+	trends_num = 0;
+}
+
+int	zbx_trmock_get_queries(void)
+{
+	return trmock_queries;
+}
+
+int	zbx_trmock_get_rows(void)
+{
+	return trmock_rows;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_trmock_eval                                                  *
+ *                                                                            *
+ * Purpose: evaluates trend function directly from the trend records          *
+ *                                                                            *
+ * Return value: SUCCEED - the function was evaluated                         *
+ *               FAIL    - there are no records in the period                 *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_trmock_eval(const char *function, zbx_uint64_t itemid, int start, int end, double *value)
+{
+	int	i, found = 0;
+	double	sum = 0, num = 0, min = 0, max = 0;
+
+	for (i = 0; i < trends_num; i++)
+	{
+		const zbx_trmock_trend_t	*trend = &trends[i];
+
+		if (trend->itemid != itemid || trend->clock < start || trend->clock > end)
+			continue;
+
+		if (0 == found || trend->value_min < min)
+			min = trend->value_min;
+
+		if (0 == found || trend->value_max > max)
+			max = trend->value_max;
+
+		sum += trend->value_avg * trend->num;
+		num += trend->num;
+		found = 1;
+	}
+
+	if (0 == strcmp(function, "count"))
+	{
+		*value = num;
+		return SUCCEED;
+	}
+
+	if (0 == strcmp(function, "sum"))
+	{
+		*value = sum;
+		return SUCCEED;
+	}
+
+	if (0 == found)
+		return FAIL;
+
+	if (0 == strcmp(function, "avg"))
+		*value = sum / num;
+	else if (0 == strcmp(function, "delta"))
+		*value = max - min;
+	else if (0 == strcmp(function, "max"))
+		*value = max;
+	else if (0 == strcmp(function, "min"))
+		*value = min;
+	else
+		fail_msg("unknown trend function \"%s\"", function);
+
+	return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_trmock_trends_eval                                           *
+ *                                                                            *
+ * Purpose: evaluates trend function with zbx_trends_eval_*() function        *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_trmock_trends_eval(const char *function, zbx_uint64_t itemid, int start, int end, double *value,
+		char **error)
+{
+	if (0 == strcmp(function, "avg"))
+		return zbx_trends_eval_avg("trends", itemid, start, end, value, error);
+	if (0 == strcmp(function, "count"))
+		return zbx_trends_eval_count("trends", itemid, start, end, value, error);
+	if (0 == strcmp(function, "delta"))
+		return zbx_trends_eval_delta("trends", itemid, start, end, value, error);
+	if (0 == strcmp(function, "max"))
+		return zbx_trends_eval_max("trends", itemid, start, end, value, error);
+	if (0 == strcmp(function, "min"))
+		return zbx_trends_eval_min("trends", itemid, start, end, value, error);
+	if (0 == strcmp(function, "sum"))
+		return zbx_trends_eval_sum("trends", itemid, start, end, value, error);
+
+	fail_msg("unknown trend function \"%s\"", function);
+
+	return FAIL;
+}
+
+/*
+ * select statement interpreter
+ */
+
+static void	trmock_next_token(zbx_trmock_parser_t *parser)
+{
+	const char	*ptr;
+
+	while (' ' == *parser->ptr)
+		parser->ptr++;
+
+	ptr = parser->ptr;
+
+	if (0 != isalpha((unsigned char)*ptr) || '_' == *ptr)
+	{
+		while (0 != isalnum((unsigned char)*ptr) || '_' == *ptr)
+			ptr++;
+	}
+	else if (0 != isdigit((unsigned char)*ptr))
+	{
+		while (0 != isdigit((unsigned char)*ptr) || '.' == *ptr)
+			ptr++;
+	}
+	else if (('>' == *ptr || '<' == *ptr) && '=' == ptr[1])
+		ptr += 2;
+	else if ('\0' != *ptr)
+		ptr++;
+
+	zbx_strlcpy(parser->token, parser->ptr, MIN((size_t)(ptr - parser->ptr) + 1, sizeof(parser->token)));
+	parser->ptr = ptr;
+}
+
+static int	trmock_token_is(const zbx_trmock_parser_t *parser, const char *token)
+{
+	return 0 == strcmp(parser->token, token) ? SUCCEED : FAIL;
+}
+
+static void	trmock_expect(zbx_trmock_parser_t *parser, const char *token)
+{
+	if (SUCCEED != trmock_token_is(parser, token))
+		fail_msg("expected \"%s\" instead of \"%s\" in \"%s\"", token, parser->token, parser->sql);
+
+	trmock_next_token(parser);
+}
+
+static double	trmock_parse_number(zbx_trmock_parser_t *parser)
+{
+	double	value;
+
+	if (0 == isdigit((unsigned char)*parser->token))
+		fail_msg("expected number instead of \"%s\" in \"%s\"", parser->token, parser->sql);
+
+	value = atof(parser->token);
+	trmock_next_token(parser);
+
+	return value;
+}
+
+static zbx_trmock_column_t	trmock_parse_column(zbx_trmock_parser_t *parser)
+{
+	const char		*columns[] = {"itemid", "clock", "num", "value_avg", "value_min", "value_max"};
+	zbx_trmock_column_t	i;
+
+	for (i = ZBX_TRMOCK_COLUMN_ITEMID; i <= ZBX_TRMOCK_COLUMN_VALUE_MAX; i++)
+	{
+		if (SUCCEED == trmock_token_is(parser, columns[i]))
+		{
+			trmock_next_token(parser);
+			return i;
+		}
+	}
+
+	fail_msg("unknown column \"%s\" in \"%s\"", parser->token, parser->sql);
+
+	return ZBX_TRMOCK_COLUMN_ITEMID;
+}
+
+static zbx_trmock_node_t	*trmock_node_create(zbx_trmock_node_type_t type)
+{
+	zbx_trmock_node_t	*node;
+
+	node = (zbx_trmock_node_t *)zbx_malloc(NULL, sizeof(zbx_trmock_node_t));
+	memset(node, 0, sizeof(zbx_trmock_node_t));
+	node->type = type;
+	zbx_vector_uint64_create(&node->values);
+
+	return node;
+}
+
+static void	trmock_node_free(zbx_trmock_node_t *node)
+{
+	if (NULL == node)
+		return;
+
+	trmock_node_free(node->left);
+	trmock_node_free(node->right);
+	zbx_vector_uint64_destroy(&node->values);
+	zbx_free(node);
+}
+
+static zbx_trmock_node_t	*trmock_parse_expression(zbx_trmock_parser_t *parser);
+
+static zbx_trmock_node_t	*trmock_parse_term(zbx_trmock_parser_t *parser)
+{
+	zbx_trmock_node_t	*node;
+	zbx_trmock_node_type_t	type;
+
+	if (0 != isdigit((unsigned char)*parser->token))
+	{
+		node = trmock_node_create(ZBX_TRMOCK_NODE_NUMBER);
+		node->value = trmock_parse_number(parser);
+		return node;
+	}
+
+	if (SUCCEED == trmock_token_is(parser, "sum"))
+		type = ZBX_TRMOCK_NODE_SUM;
+	else if (SUCCEED == trmock_token_is(parser, "min"))
+		type = ZBX_TRMOCK_NODE_MIN;
+	else if (SUCCEED == trmock_token_is(parser, "max"))
+		type = ZBX_TRMOCK_NODE_MAX;
+	else
+		type = ZBX_TRMOCK_NODE_COLUMN;
+
+	if (ZBX_TRMOCK_NODE_COLUMN == type)
+	{
+		node = trmock_node_create(ZBX_TRMOCK_NODE_COLUMN);
+		node->column = trmock_parse_column(parser);
+		return node;
+	}
+
+	trmock_next_token(parser);
+	trmock_expect(parser, "(");
+	node = trmock_node_create(type);
+	node->left = trmock_parse_expression(parser);
+	trmock_expect(parser, ")");
+
+	return node;
+}
+
+static zbx_trmock_node_t	*trmock_parse_expression(zbx_trmock_parser_t *parser)
+{
+	zbx_trmock_node_t	*node, *left;
+
+	node = trmock_parse_term(parser);
+
+	while (SUCCEED == trmock_token_is(parser, "-"))
+	{
+		trmock_next_token(parser);
+		left = node;
+		node = trmock_node_create(ZBX_TRMOCK_NODE_MINUS);
+		node->left = left;
+		node->right = trmock_parse_term(parser);
+	}
+
+	return node;
+}
+
+static zbx_trmock_node_t	*trmock_parse_or(zbx_trmock_parser_t *parser);
+
+static zbx_trmock_node_t	*trmock_parse_condition(zbx_trmock_parser_t *parser)
+{
+	zbx_trmock_node_t	*node;
+	zbx_trmock_column_t	column;
+
+	if (SUCCEED == trmock_token_is(parser, "("))
+	{
+		trmock_next_token(parser);
+		node = trmock_parse_or(parser);
+		trmock_expect(parser, ")");
+
+		return node;
+	}
+
+	column = trmock_parse_column(parser);
+
+	if (SUCCEED == trmock_token_is(parser, "="))
+		node = trmock_node_create(ZBX_TRMOCK_NODE_EQ);
+	else if (SUCCEED == trmock_token_is(parser, ">="))
+		node = trmock_node_create(ZBX_TRMOCK_NODE_GE);
+	else if (SUCCEED == trmock_token_is(parser, "<="))
+		node = trmock_node_create(ZBX_TRMOCK_NODE_LE);
+	else if (SUCCEED == trmock_token_is(parser, "between"))
+		node = trmock_node_create(ZBX_TRMOCK_NODE_BETWEEN);
+	else if (SUCCEED == trmock_token_is(parser, "in"))
+		node = trmock_node_create(ZBX_TRMOCK_NODE_IN);
+	else
+		fail_msg("unknown operator \"%s\" in \"%s\"", parser->token, parser->sql);
+
+	node->column = column;
+	trmock_next_token(parser);
+
+	switch (node->type)
+	{
+		case ZBX_TRMOCK_NODE_BETWEEN:
+			node->value = trmock_parse_number(parser);
+			trmock_expect(parser, "and");
+			node->value_to = trmock_parse_number(parser);
+			break;
+		case ZBX_TRMOCK_NODE_IN:
+			trmock_expect(parser, "(");
+
+			do
+			{
+				if (SUCCEED == trmock_token_is(parser, ","))
+					trmock_next_token(parser);
+
+				zbx_vector_uint64_append(&node->values, (zbx_uint64_t)trmock_parse_number(parser));
+			}
+			while (SUCCEED == trmock_token_is(parser, ","));
+
+			trmock_expect(parser, ")");
+			break;
+		default:
+			node->value = trmock_parse_number(parser);
+	}
+
+	return node;
+}
+
+static zbx_trmock_node_t	*trmock_parse_and(zbx_trmock_parser_t *parser)
+{
+	zbx_trmock_node_t	*node, *left;
+
+	node = trmock_parse_condition(parser);
+
+	while (SUCCEED == trmock_token_is(parser, "and"))
+	{
+		trmock_next_token(parser);
+		left = node;
+		node = trmock_node_create(ZBX_TRMOCK_NODE_AND);
+		node->left = left;
+		node->right = trmock_parse_condition(parser);
+	}
+
+	return node;
+}
+
+static zbx_trmock_node_t	*trmock_parse_or(zbx_trmock_parser_t *parser)
+{
+	zbx_trmock_node_t	*node, *left;
+
+	node = trmock_parse_and(parser);
+
+	while (SUCCEED == trmock_token_is(parser, "or"))
+	{
+		trmock_next_token(parser);
+		left = node;
+		node = trmock_node_create(ZBX_TRMOCK_NODE_OR);
+		node->left = left;
+		node->right = trmock_parse_and(parser);
+	}
+
+	return node;
+}
+
+static double	trmock_trend_column(const zbx_trmock_trend_t *trend, zbx_trmock_column_t column)
+{
+	switch (column)
+	{
+		case ZBX_TRMOCK_COLUMN_ITEMID:
+			return (double)trend->itemid;
+		case ZBX_TRMOCK_COLUMN_CLOCK:
+			return trend->clock;
+		case ZBX_TRMOCK_COLUMN_NUM:
+			return trend->num;
+		case ZBX_TRMOCK_COLUMN_VALUE_AVG:
+			return trend->value_avg;
+		case ZBX_TRMOCK_COLUMN_VALUE_MIN:
+			return trend->value_min;
+		default:
+			return trend->value_max;
+	}
+}
+
+static int	trmock_match(const zbx_trmock_node_t *node, const zbx_trmock_trend_t *trend)
+{
+	double	value;
+
+	if (NULL == node)
+		return SUCCEED;
+
+	switch (node->type)
+	{
+		case ZBX_TRMOCK_NODE_AND:
+			if (SUCCEED != trmock_match(node->left, trend))
+				return FAIL;
+			return trmock_match(node->right, trend);
+		case ZBX_TRMOCK_NODE_OR:
+			if (SUCCEED == trmock_match(node->left, trend))
+				return SUCCEED;
+			return trmock_match(node->right, trend);
+		case ZBX_TRMOCK_NODE_IN:
+			return FAIL == zbx_vector_uint64_search(&node->values, trend->itemid,
+					ZBX_DEFAULT_UINT64_COMPARE_FUNC) ? FAIL : SUCCEED;
+		default:
+			break;
+	}
+
+	value = trmock_trend_column(trend, node->column);
+
+	switch (node->type)
+	{
+		case ZBX_TRMOCK_NODE_EQ:
+			return value == node->value ? SUCCEED : FAIL;
+		case ZBX_TRMOCK_NODE_GE:
+			return value >= node->value ? SUCCEED : FAIL;
+		case ZBX_TRMOCK_NODE_LE:
+			return value <= node->value ? SUCCEED : FAIL;
+		case ZBX_TRMOCK_NODE_BETWEEN:
+			return value >= node->value && value <= node->value_to ? SUCCEED : FAIL;
+		default:
+			fail_msg("unexpected condition node type %d", (int)node->type);
+	}
+
+	return FAIL;
+}
+
+static int	trmock_is_aggregate(const zbx_trmock_node_t *node)
+{
+	if (NULL == node)
+		return FAIL;
+
+	if (ZBX_TRMOCK_NODE_SUM == node->type || ZBX_TRMOCK_NODE_MIN == node->type ||
+			ZBX_TRMOCK_NODE_MAX == node->type)
+	{
+		return SUCCEED;
+	}
+
+	if (SUCCEED == trmock_is_aggregate(node->left))
+		return SUCCEED;
+
+	return trmock_is_aggregate(node->right);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: trmock_evaluate                                                  *
+ *                                                                            *
+ * Purpose: evaluates select list expression over group of records            *
+ *                                                                            *
+ * Parameters: node       - [IN] the expression                               *
+ *             group      - [IN] the records, columns outside aggregate       *
+ *                               functions are taken from the first record    *
+ *             group_num  - [IN] the number of records                        *
+ *             value      - [OUT] the expression value                        *
+ *                                                                            *
+ * Return value: SUCCEED - the expression was evaluated                       *
+ *               FAIL    - the expression value is NULL                       *
+ *                                                                            *
+ ******************************************************************************/
+static int	trmock_evaluate(const zbx_trmock_node_t *node, const zbx_trmock_trend_t **group, int group_num,
+		double *value)
+{
+	double	left, right;
+	int	i;
+
+	switch (node->type)
+	{
+		case ZBX_TRMOCK_NODE_NUMBER:
+			*value = node->value;
+			return SUCCEED;
+		case ZBX_TRMOCK_NODE_COLUMN:
+			if (0 == group_num)
+				return FAIL;
+
+			*value = trmock_trend_column(group[0], node->column);
+			return SUCCEED;
+		case ZBX_TRMOCK_NODE_MINUS:
+			if (SUCCEED != trmock_evaluate(node->left, group, group_num, &left) ||
+					SUCCEED != trmock_evaluate(node->right, group, group_num, &right))
+			{
+				return FAIL;
+			}
+
+			*value = left - right;
+			return SUCCEED;
+		default:
+			break;
+	}
+
+	if (0 == group_num)
+		return FAIL;
+
+	for (i = 0; i < group_num; i++)
+	{
+		if (SUCCEED != trmock_evaluate(node->left, &group[i], 1, &right))
+			return FAIL;
+
+		if (0 == i)
+		{
+			*value = right;
+			continue;
+		}
+
+		switch (node->type)
+		{
+			case ZBX_TRMOCK_NODE_SUM:
+				*value += right;
+				break;
+			case ZBX_TRMOCK_NODE_MIN:
+				if (right < *value)
+					*value = right;
+				break;
+			case ZBX_TRMOCK_NODE_MAX:
+				if (right > *value)
+					*value = right;
+				break;
+			default:
+				fail_msg("unexpected expression node type %d", (int)node->type);
+		}
+	}
+
+	return SUCCEED;
+}
+
+static void	trmock_result_add_row(DB_RESULT result, const zbx_vector_ptr_t *select,
+		const zbx_trmock_trend_t **group, int group_num)
+{
+	int	i;
+	double	value;
+
+	result->values = (char **)zbx_realloc(result->values, sizeof(char *) *
+			(size_t)((result->rows_num + 1) * result->columns_num));
+
+	for (i = 0; i < select->values_num; i++)
+	{
+		char	**field = &result->values[result->rows_num * result->columns_num + i];
+
+		if (SUCCEED == trmock_evaluate((const zbx_trmock_node_t *)select->values[i], group, group_num, &value))
+			*field = zbx_dsprintf(NULL, "%.17g", value);
+		else
+			*field = NULL;
+	}
+
+	result->rows_num++;
+}
+
+DB_RESULT	__wrap_DBselect(const char *fmt, ...)
+{
+	va_list			args;
+	char			*sql;
+	zbx_trmock_parser_t	parser;
+	zbx_vector_ptr_t	select;
+	zbx_trmock_node_t	*where = NULL;
+	DB_RESULT		result;
+	const zbx_trmock_trend_t	**matched;
+	int			i, j, matched_num = 0, group_by = 0, aggregate = FAIL;
+
+	va_start(args, fmt);
+	sql = zbx_dvsprintf(NULL, fmt, args);
+	va_end(args);
+
+	trmock_queries++;
+
+	parser.sql = sql;
+	parser.ptr = sql;
+	trmock_next_token(&parser);
+
+	zbx_vector_ptr_create(&select);
+
+	trmock_expect(&parser, "select");
+
+	do
+	{
+		if (SUCCEED == trmock_token_is(&parser, ","))
+			trmock_next_token(&parser);
+
+		zbx_vector_ptr_append(&select, trmock_parse_expression(&parser));
+
+		if (SUCCEED == trmock_is_aggregate((const zbx_trmock_node_t *)select.values[select.values_num - 1]))
+			aggregate = SUCCEED;
+	}
+	while (SUCCEED == trmock_token_is(&parser, ","));
+
+	trmock_expect(&parser, "from");
+
+	if (SUCCEED != trmock_token_is(&parser, "trends") && SUCCEED != trmock_token_is(&parser, "trends_uint"))
+		fail_msg("unexpected table \"%s\" in \"%s\"", parser.token, sql);
+
+	trmock_next_token(&parser);
+
+	if (SUCCEED == trmock_token_is(&parser, "where"))
+	{
+		trmock_next_token(&parser);
+		where = trmock_parse_or(&parser);
+	}
+
+	if (SUCCEED == trmock_token_is(&parser, "group"))
+	{
+		trmock_next_token(&parser);
+		trmock_expect(&parser, "by");
+		trmock_expect(&parser, "itemid");
+		group_by = 1;
+	}
+
+	if ('\0' != *parser.token)
+		fail_msg("unexpected \"%s\" in \"%s\"", parser.token, sql);
+
+	matched = (const zbx_trmock_trend_t **)zbx_malloc(NULL, sizeof(zbx_trmock_trend_t *) * (size_t)(trends_num + 1));
+
+	for (i = 0; i < trends_num; i++)
+	{
+		if (SUCCEED == trmock_match(where, &trends[i]))
+			matched[matched_num++] = &trends[i];
+	}
+
+	trmock_rows += matched_num;
+
+	result = (DB_RESULT)zbx_malloc(NULL, sizeof(struct zbx_db_result));
+	result->values = NULL;
+	result->columns_num = select.values_num;
+	result->rows_num = 0;
+	result->row = 0;
+
+	if (SUCCEED != aggregate)
+	{
+		for (i = 0; i < matched_num; i++)
+			trmock_result_add_row(result, &select, &matched[i], 1);
+	}
+	else if (0 == group_by)
+	{
+		trmock_result_add_row(result, &select, matched, matched_num);
+	}
+	else
+	{
+		/* the records are sorted by itemid */
+		for (i = 0; i < matched_num; i = j)
+		{
+			for (j = i + 1; j < matched_num && matched[j]->itemid == matched[i]->itemid; j++)
+				;
+
+			trmock_result_add_row(result, &select, &matched[i], j - i);
+		}
+	}
+
+	zbx_free(matched);
+	trmock_node_free(where);
+
+	for (i = 0; i < select.values_num; i++)
+		trmock_node_free((zbx_trmock_node_t *)select.values[i]);
+
+	zbx_vector_ptr_destroy(&select);
+	zbx_free(sql);
+
+	return result;
+}
+
+DB_ROW	__wrap_DBfetch(DB_RESULT result)
+{
+	if (NULL == result || result->row == result->rows_num)
+		return NULL;
+
+	return &result->values[result->row++ * result->columns_num];
+}
+
+int	__wrap_DBis_null(const char *field)
+{
+	return NULL == field ? SUCCEED : FAIL;
+}
+
+void	__wrap_DBfree_result(DB_RESULT result)
+{
+	int	i;
+
+	if (NULL == result)
+		return;
+
+	for (i = 0; i < result->rows_num * result->columns_num; i++)
+		zbx_free(result->values[i]);
+
+	zbx_free(result->values);
+	zbx_free(result);
+}
+
+/*
+ * trend function cache is allocated in process memory
+ */
+
+int	__wrap_zbx_mutex_create(zbx_mutex_t *mutex, zbx_mutex_name_t name, char **error)
+{
+	ZBX_UNUSED(name);
+	ZBX_UNUSED(error);
+
+	*mutex = ZBX_MUTEX_NULL;
+
+	return SUCCEED;
+}
+
+int	__wrap_zbx_mem_create(zbx_mem_info_t **info, zbx_uint64_t size, const char *descr, const char *param,
+		int allow_oom, char **error)
+{
+	ZBX_UNUSED(size);
+	ZBX_UNUSED(descr);
+	ZBX_UNUSED(param);
+	ZBX_UNUSED(allow_oom);
+	ZBX_UNUSED(error);
+
+	*info = &trmock_mem;
+
+	return SUCCEED;
+}
+
+void	*__wrap___zbx_mem_malloc(const char *file, int line, zbx_mem_info_t *info, const void *old, size_t size)
+{
+	ZBX_UNUSED(file);
+	ZBX_UNUSED(line);
+
+	zbx_mock_assert_ptr_eq("Unknown memory info block in memory allocator", &trmock_mem, info);
+	zbx_mock_assert_ptr_eq("Allocating unfreed memory", NULL, old);
+
+	return zbx_malloc(NULL, size);
+}
+
+void	*__wrap___zbx_mem_realloc(const char *file, int line, zbx_mem_info_t *info, void *old, size_t size)
+{
+	ZBX_UNUSED(file);
+	ZBX_UNUSED(line);
+
+	zbx_mock_assert_ptr_eq("Unknown memory info block in memory reallocator", &trmock_mem, info);
+
+	return zbx_realloc(old, size);
+}
+
+void	__wrap___zbx_mem_free(const char *file, int line, zbx_mem_info_t *info, void *ptr)
+{
+	ZBX_UNUSED(file);
+	ZBX_UNUSED(line);
+
+	zbx_mock_assert_ptr_eq("Unknown memory info block in memory destructor", &trmock_mem, info);
+
+	zbx_free(ptr);
+}
@@ -0,0 +1,33 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#ifndef TRENDS_MOCK_H
+#define TRENDS_MOCK_H
+
+void	zbx_trmock_init(zbx_mock_handle_t htrends);
+void	zbx_trmock_destroy(void);
+
+int	zbx_trmock_eval(const char *function, zbx_uint64_t itemid, int start, int end, double *value);
+int	zbx_trmock_trends_eval(const char *function, zbx_uint64_t itemid, int start, int end, double *value,
+		char **error);
+
+int	zbx_trmock_get_queries(void);
+int	zbx_trmock_get_rows(void);
+
+#endif
@@ -38,6 +38,8 @@
 /*
  * data source
  */
+extern int	CONFIG_VALUE_CACHE_COMPRESSION;
+
 static zbx_vcmock_ds_t	vc_ds;
 static zbx_timespec_t	vcmock_ts;
 
@@ -56,6 +58,7 @@ int	__wrap_zbx_history_sql_init(zbx_history_iface_t *hist, unsigned char value_t
 int	__wrap_zbx_history_elastic_init(zbx_history_iface_t *hist, unsigned char value_type, char **error);
 void	__wrap_zbx_elastic_version_extract(void);
 int	__wrap_zbx_elastic_version_get(void);
+int	__wrap_DBconnect(int flag);
 time_t	__wrap_time(time_t *ptr);
 void	__wrap_zbx_timespec(zbx_timespec_t *ts);
 
@@ -696,6 +699,13 @@ int	__wrap_zbx_elastic_version_get(void)
 	return ZBX_DBVERSION_UNDEFINED;
 }
 
+int	__wrap_DBconnect(int flag)
+{
+	ZBX_UNUSED(flag);
+
+	return ZBX_DB_OK;
+}
+
 /*
  * cache allocator size limit handling
  */
@@ -797,6 +807,52 @@ void	zbx_vcmock_set_mode(zbx_mock_handle_t hitem, const char *key)
 	}
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vcmock_set_compression                                       *
+ *                                                                            *
+ * Purpose: sets value cache chunk compression if the specified key is        *
+ *          present in input data                                             *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vcmock_set_compression(zbx_mock_handle_t hitem, const char *key)
+{
+	zbx_mock_handle_t	hcompression;
+	zbx_uint64_t		compression;
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hitem, key, &hcompression))
+	{
+		if (ZBX_MOCK_SUCCESS != zbx_mock_uint64(hcompression, &compression) || 1 < compression)
+			fail_msg("Cannot read \"%s\" parameter", key);
+
+		CONFIG_VALUE_CACHE_COMPRESSION = (int)compression;
+	}
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_vcmock_check_packed_values                                   *
+ *                                                                            *
+ * Purpose: checks the number of values stored in compressed chunks if the    *
+ *          specified key is present in output data                           *
+ *                                                                            *
+ ******************************************************************************/
+void	zbx_vcmock_check_packed_values(zbx_mock_handle_t hcache, const char *key)
+{
+	zbx_mock_handle_t	hpacked;
+	zbx_uint64_t		expected, items_num, values_num, packed_values_num, packed_size;
+	int			mode;
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_object_member(hcache, key, &hpacked))
+	{
+		if (ZBX_MOCK_SUCCESS != zbx_mock_uint64(hpacked, &expected))
+			fail_msg("Cannot read \"%s\" parameter", key);
+
+		zbx_vc_get_diag_stats(&items_num, &values_num, &mode, &packed_values_num, &packed_size);
+		zbx_mock_assert_uint64_eq("cache.packed values", expected, packed_values_num);
+	}
+}
+
 /*
  * time() emulation
  */
@@ -0,0 +1,133 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "sysinfo.h"
+
+#include "../../../src/zabbix_server/poller/checks_agent.h"
+
+#define MOCK_AGENT_ADDR		"127.0.0.1"
+#define MOCK_AGENT_PORT		10050
+#define MOCK_AGENT_BUF_SIZE	(16 * ZBX_KIBIBYTE)
+
+/******************************************************************************
+ *                                                                            *
+ * Function: mock_agent_packet_recv                                           *
+ *                                                                            *
+ * Purpose: receives response the same way as asynchronous agent poller,      *
+ *          each chunk is the data returned by one read() call                *
+ *                                                                            *
+ * Return value: SUCCEED - the response was received or connection closed    *
+ *               FAIL    - the response header is invalid                     *
+ *                                                                            *
+ ******************************************************************************/
+static int	mock_agent_packet_recv(zbx_agent_packet_t *packet, zbx_mock_handle_t hchunks, char **error)
+{
+	zbx_mock_handle_t	hchunk;
+	zbx_mock_error_t	err;
+	const char		*chunk;
+	size_t			chunk_len, chunk_offset, n;
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hchunks, &hchunk))))
+	{
+		if (ZBX_MOCK_SUCCESS != err || ZBX_MOCK_SUCCESS != (err = zbx_mock_binary(hchunk, &chunk, &chunk_len)))
+			fail_msg("cannot read response chunk: %s", zbx_mock_error_string(err));
+
+		for (chunk_offset = 0; chunk_offset < chunk_len; chunk_offset += n)
+		{
+			/* poller reads no more than fits into buffer with terminating zero, */
+			/* reading nothing is handled as closed connection                   */
+			if (0 == (n = MIN(chunk_len - chunk_offset, packet->buffer_alloc - packet->buffer_offset - 1)))
+				return SUCCEED;
+
+			memcpy(packet->buffer + packet->buffer_offset, chunk + chunk_offset, n);
+			packet->buffer_offset += n;
+
+			if (SUCCEED != zbx_agent_packet_parse_header(packet, MOCK_AGENT_ADDR, MOCK_AGENT_PORT, error))
+				return FAIL;
+
+			if (0 != packet->buffer_size && packet->buffer_offset >= packet->buffer_size)
+				return SUCCEED;
+		}
+	}
+
+	return SUCCEED;
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_agent_packet_t	packet;
+	AGENT_RESULT		result;
+	char			*error = NULL;
+	const char		*expected;
+	int			ret, expected_ret;
+
+	ZBX_UNUSED(state);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.buffer_alloc = MOCK_AGENT_BUF_SIZE;
+
+	if (ZBX_MOCK_SUCCESS == zbx_mock_parameter_exists("in.buffer size"))
+		packet.buffer_alloc = (size_t)zbx_mock_get_parameter_uint64("in.buffer size");
+
+	packet.buffer = (char *)zbx_malloc(NULL, packet.buffer_alloc);
+
+	ret = mock_agent_packet_recv(&packet, zbx_mock_get_parameter_handle("in.response"), &error);
+	zbx_mock_assert_result_eq("zbx_agent_packet_parse_header() return value",
+			zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.header")), ret);
+
+	if (SUCCEED != ret)
+	{
+		zbx_mock_assert_str_eq("header error", zbx_mock_get_parameter_string("out.error"), error);
+		zbx_free(error);
+		goto out;
+	}
+
+	init_result(&result);
+
+	ret = zbx_agent_packet_parse_response(&packet, MOCK_AGENT_ADDR, MOCK_AGENT_PORT, &result);
+	expected_ret = zbx_mock_str_to_return_code(zbx_mock_get_parameter_string("out.return"));
+	zbx_mock_assert_result_eq("zbx_agent_packet_parse_response() return value", expected_ret, ret);
+
+	if (SUCCEED == ret)
+	{
+		if (NULL == GET_TEXT_RESULT(&result))
+			fail_msg("response value was not set");
+
+		expected = zbx_mock_get_parameter_string("out.value");
+		zbx_mock_assert_str_eq("response value", expected, *GET_TEXT_RESULT(&result));
+	}
+	else
+	{
+		if (NULL == GET_MSG_RESULT(&result))
+			fail_msg("response error was not set");
+
+		expected = zbx_mock_get_parameter_string("out.error");
+		zbx_mock_assert_str_eq("response error", expected, *GET_MSG_RESULT(&result));
+	}
+
+	free_result(&result);
+out:
+	zbx_free(packet.buffer);
+}
@@ -0,0 +1,195 @@
+/*
+** Zabbix
+** Copyright (C) 2001-2021 Zabbix SIA
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+#include "zbxmocktest.h"
+#include "zbxmockdata.h"
+#include "zbxmockassert.h"
+#include "zbxmockutil.h"
+
+#include "common.h"
+#include "preproc.h"
+
+#include "../../../src/zabbix_server/preprocessor/preproc_ring.h"
+
+extern zbx_uint64_t	CONFIG_PREPROCESSOR_RING_SIZE;
+
+#define MOCK_RING_RESERVED_MAX	8
+
+/* slot reserved by a producer which has not published it yet */
+typedef struct
+{
+	const char	*data;
+	zbx_uint64_t	pos;
+	unsigned char	*slot_data;
+}
+mock_ring_reserved_t;
+
+static mock_ring_reserved_t	reserved[MOCK_RING_RESERVED_MAX];
+static int			reserved_num;
+
+static void	mock_ring_reserve(int step, zbx_mock_handle_t hstep)
+{
+	const char	*data;
+	int		ret;
+
+	data = zbx_mock_get_object_member_string(hstep, "data");
+
+	if (MOCK_RING_RESERVED_MAX == reserved_num)
+		fail_msg("[%d] too many reserved slots", step);
+
+	ret = preproc_ring_reserve(0, (zbx_uint32_t)strlen(data), &reserved[reserved_num].pos,
+			&reserved[reserved_num].slot_data);
+
+	zbx_mock_assert_result_eq("preproc_ring_reserve() return value",
+			zbx_mock_str_to_return_code(zbx_mock_get_object_member_string(hstep, "return")), ret);
+
+	if (SUCCEED == ret)
+		reserved[reserved_num++].data = data;
+}
+
+static void	mock_ring_publish(int step, zbx_mock_handle_t hstep)
+{
+	const char	*data;
+	int		i, notify;
+
+	data = zbx_mock_get_object_member_string(hstep, "data");
+
+	for (i = 0; i < reserved_num; i++)
+	{
+		if (0 == strcmp(reserved[i].data, data))
+			break;
+	}
+
+	if (i == reserved_num)
+		fail_msg("[%d] slot \"%s\" was not reserved", step, data);
+
+	memcpy(reserved[i].slot_data, data, strlen(data));
+	preproc_ring_publish(0, reserved[i].pos, (zbx_uint32_t)strlen(data), &notify);
+
+	zbx_mock_assert_int_eq("notify flag", (int)zbx_mock_get_object_member_uint64(hstep, "notify"), notify);
+
+	reserved[i] = reserved[--reserved_num];
+}
+
+static void	mock_ring_write(zbx_mock_handle_t hstep)
+{
+	const char	*data;
+	int		ret, notify = 0;
+
+	data = zbx_mock_get_object_member_string(hstep, "data");
+	ret = preproc_ring_write(0, (const unsigned char *)data, (zbx_uint32_t)strlen(data), &notify);
+
+	zbx_mock_assert_result_eq("preproc_ring_write() return value",
+			zbx_mock_str_to_return_code(zbx_mock_get_object_member_string(hstep, "return")), ret);
+
+	if (SUCCEED == ret)
+		zbx_mock_assert_int_eq("notify flag", (int)zbx_mock_get_object_member_uint64(hstep, "notify"), notify);
+}
+
+static void	mock_ring_read(int step, zbx_mock_handle_t hstep)
+{
+	zbx_mock_handle_t	hvalues, hvalue;
+	zbx_mock_error_t	err;
+	unsigned char		*data;
+	zbx_uint32_t		size;
+	const char		*expected;
+	char			*value;
+
+	hvalues = zbx_mock_get_object_member_handle(hstep, "data");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hvalues, &hvalue))))
+	{
+		if (ZBX_MOCK_SUCCESS != err || ZBX_MOCK_SUCCESS != (err = zbx_mock_string(hvalue, &expected)))
+			fail_msg("[%d] cannot read expected slot data: %s", step, zbx_mock_error_string(err));
+
+		if (SUCCEED != preproc_ring_read(0, &data, &size))
+			fail_msg("[%d] expected slot \"%s\" was not read", step, expected);
+
+		value = zbx_malloc(NULL, size + 1);
+		memcpy(value, data, size);
+		value[size] = '\0';
+		preproc_ring_release(0);
+
+		zbx_mock_assert_str_eq("slot data", expected, value);
+		zbx_free(value);
+	}
+
+	if (SUCCEED == preproc_ring_read(0, &data, &size))
+		fail_msg("[%d] unexpected slot was read", step);
+}
+
+void	zbx_mock_test_entry(void **state)
+{
+	zbx_mock_handle_t	hsteps, hstep;
+	zbx_mock_error_t	err;
+	char			*error = NULL;
+	const char		*op;
+	int			step = 1;
+
+	ZBX_UNUSED(state);
+
+#ifndef HAVE_ATOMIC_BUILTINS
+	skip();
+#endif
+	CONFIG_PREPROCESSOR_RING_SIZE = zbx_mock_get_parameter_uint64("in.size");
+
+	if (SUCCEED != zbx_preprocessor_ring_init(&error))
+		fail_msg("cannot initialize preprocessing ring: %s", error);
+
+	hsteps = zbx_mock_get_parameter_handle("in.steps");
+
+	while (ZBX_MOCK_END_OF_VECTOR != (err = (zbx_mock_vector_element(hsteps, &hstep))))
+	{
+		if (ZBX_MOCK_SUCCESS != err)
+			fail_msg("[%d] cannot read step: %s", step, zbx_mock_error_string(err));
+
+		op = zbx_mock_get_object_member_string(hstep, "op");
+
+		if (0 == strcmp(op, "reserve"))
+		{
+			mock_ring_reserve(step, hstep);
+		}
+		else if (0 == strcmp(op, "publish"))
+		{
+			mock_ring_publish(step, hstep);
+		}
+		else if (0 == strcmp(op, "write"))
+		{
+			mock_ring_write(hstep);
+		}
+		else if (0 == strcmp(op, "read"))
+		{
+			mock_ring_read(step, hstep);
+		}
+		else if (0 == strcmp(op, "reset notify"))
+		{
+			preproc_ring_reset_notify(0);
+		}
+		else if (0 == strcmp(op, "drained"))
+		{
+			zbx_mock_assert_result_eq("preproc_ring_drained() return value",
+					zbx_mock_str_to_return_code(zbx_mock_get_object_member_string(hstep, "return")),
+					preproc_ring_drained(0));
+		}
+		else
+			fail_msg("[%d] unknown operation \"%s\"", step, op);
+
+		step++;
+	}
+}